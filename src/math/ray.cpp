@@ -20,6 +20,11 @@ namespace math
       tmin = std::max (tmin, std::min (tx1, tx2));
       tmax = std::min (tmax, std::max (tx1, tx2));
     }
+    else if (_origin.x < min.x || _origin.x > max.x)
+    {
+      // parallel to the slab, and outside of it
+      return boost::none;
+    }
 
     if (_direction.y != 0.0f)
     {
@@ -29,6 +34,11 @@ namespace math
       tmin = std::max (tmin, std::min (ty1, ty2));
       tmax = std::min (tmax, std::max (ty1, ty2));
     }
+    else if (_origin.y < min.y || _origin.y > max.y)
+    {
+      // parallel to the slab, and outside of it
+      return boost::none;
+    }
 
     if (_direction.z != 0.0f)
     {
@@ -38,6 +48,11 @@ namespace math
       tmin = std::max (tmin, std::min (tz1, tz2));
       tmax = std::min (tmax, std::max (tz1, tz2));
     }
+    else if (_origin.z < min.z || _origin.z > max.z)
+    {
+      // parallel to the slab, and outside of it
+      return boost::none;
+    }
 
     if (tmax >= tmin)
     {
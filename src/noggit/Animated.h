@@ -5,9 +5,9 @@
 #include <math/quaternion.hpp>
 #include <noggit/MPQ.h>
 #include <noggit/ModelHeaders.h>
+#include <noggit/bone_animation.hpp>
 
 #include <cassert>
-#include <map>
 #include <vector>
 #include <memory>
 
@@ -75,12 +75,13 @@ namespace Animation
 
     Animation::Interpolation::Type::Type_t _interpolationType;
 
-    std::map<AnimationIdType, TimestampTypeVectorType> times;
-    std::map<AnimationIdType, AnimatedTypeVectorType> data;
+    // indexed by animation
+    std::vector<TimestampTypeVectorType> times;
+    std::vector<AnimatedTypeVectorType> data;
 
     // for nonlinear interpolations:
-    std::map<AnimationIdType, AnimatedTypeVectorType> in;
-    std::map<AnimationIdType, AnimatedTypeVectorType> out;
+    std::vector<AnimatedTypeVectorType> in;
+    std::vector<AnimatedTypeVectorType> out;
 
   public:
     bool uses(AnimationIdType anim)
@@ -90,7 +91,7 @@ namespace Animation
         anim = AnimationIdType();
       }
 
-      return !data[anim].empty();
+      return anim < data.size() && !data[anim].empty();
     }
 
     AnimatedType getValue (AnimationIdType anim, TimestampType time, int animtime)
@@ -108,16 +109,14 @@ namespace Animation
         anim = AnimationIdType();
       }
 
-      TimestampTypeVectorType& timestampVector = times[anim];
-      AnimatedTypeVectorType& dataVector = data[anim];
-      AnimatedTypeVectorType& inVector = in[anim];
-      AnimatedTypeVectorType& outVector = out[anim];
-
-      if (dataVector.empty())
+      if (anim >= data.size() || anim >= times.size() || data[anim].empty())
       {
         return AnimatedType();
       }
 
+      TimestampTypeVectorType const& timestampVector = times[anim];
+      AnimatedTypeVectorType const& dataVector = data[anim];
+
       AnimatedType result = dataVector[0];
 
       if (!timestampVector.empty())
@@ -132,15 +131,7 @@ namespace Animation
           time = TimestampType();
         }
 
-        size_t pos = 0;
-        for (size_t i = 0; i < timestampVector.size() - 1; ++i)
-        {
-          if (time >= timestampVector[i] && time < timestampVector[i + 1])
-          {
-            pos = i;
-            break;
-          }
-        }
+        size_t pos = noggit::keyframe_before (timestampVector, time);
 
         if (pos == timestampVector.size() - 1 || _interpolationType == Animation::Interpolation::Type::NONE)
         {
@@ -162,7 +153,7 @@ namespace Animation
 
           case Animation::Interpolation::Type::HERMITE:
           {
-            result = math::interpolation::hermite(percentage, dataVector[pos], dataVector[pos + 1], inVector[pos], outVector[pos]);
+            result = math::interpolation::hermite(percentage, dataVector[pos], dataVector[pos + 1], in[anim][pos], out[anim][pos]);
           }
             break;
           }
@@ -189,6 +180,14 @@ namespace Animation
       const AnimationBlockHeader* timestampHeaders = file.get<AnimationBlockHeader>(animationBlock.ofsTimes);
       const AnimationBlockHeader* keyHeaders = file.get<AnimationBlockHeader>(animationBlock.ofsKeys);
 
+      times.resize(animationBlock.nTimes);
+      data.resize(animationBlock.nKeys);
+      if (_interpolationType == Animation::Interpolation::Type::HERMITE)
+      {
+        in.resize(animationBlock.nKeys);
+        out.resize(animationBlock.nKeys);
+      }
+
       for (size_t j = 0; j < animationBlock.nTimes; ++j)
       {
         const TimestampType* timestamps = j < animation_files.size() && animation_files[j] ?
@@ -5,7 +5,6 @@
 #include <noggit/settings.hpp>
 
 #include <algorithm>
-#include <list>
 
 AsyncLoader* AsyncLoader::instance;
 
@@ -16,145 +15,95 @@ void AsyncLoader::setup(int threads)
   instance = new AsyncLoader(std::max(1, threads));
 }
 
-void AsyncLoader::process()
+void AsyncLoader::process (AsyncObject* object)
 {
-  AsyncObject* object = nullptr;
+  bool const additional_log (NoggitSettings.editor().additional_file_loading_log);
 
-  bool additional_log = NoggitSettings.value("additional_file_loading_log", false).toBool();
-
-  while (!_stop)
+  try
   {
+    if (additional_log)
     {
-      std::unique_lock<std::mutex> lock (_guard);
-
-      _state_changed.wait
-      ( lock
-      , [&]
-        {
-          return !!_stop || std::any_of ( _to_load.begin(), _to_load.end()
-                                        , [](auto const& to_load) { return !to_load.empty(); }
-                                        );
-        }
-      );
-
-      if (_stop)
-      {
-        return;
-      }
-
-      for (auto& to_load : _to_load)
-      {
-        if (to_load.empty())
-        {
-          continue;
-        }
-
-        object = to_load.front();
-        _currently_loading.emplace_back (object);
-        to_load.pop_front();
-
-        break;
-      }
+      std::lock_guard<std::mutex> const lock(_log_guard);
+      LogDebug << "Loading '" << object->filename << "'" << std::endl;
     }
 
-    try
+    object->finishLoading();
+
+    if (additional_log)
     {
-      if (additional_log)
-      {
-        std::lock_guard<std::mutex> const lock(_guard);
-        LogDebug << "Loading '" << object->filename << "'" << std::endl;
-      }
-
-      object->finishLoading();
-
-      if (additional_log)
-      {
-        std::lock_guard<std::mutex> const lock(_guard);
-        LogDebug << "Loaded  '" << object->filename << "'" << std::endl;
-      }
-
-      {
-        std::lock_guard<std::mutex> const lock (_guard);
-        _currently_loading.remove (object);
-        _state_changed.notify_all();
-
-        _object_queued_count--;
-      }
+      std::lock_guard<std::mutex> const lock(_log_guard);
+      LogDebug << "Loaded  '" << object->filename << "'" << std::endl;
     }
-    catch (...)
-    {
-      std::lock_guard<std::mutex> const lock(_guard);
-      object->error_on_loading();
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> const lock(_log_guard);
+    object->error_on_loading();
 
-      if (object->is_required_when_saving())
-      {
-        _important_object_failed_loading = true;
-      }
+    if (object->is_required_when_saving())
+    {
+      _important_object_failed_loading = true;
     }
   }
+
+  // whoever looks at the object from now on has nothing left to wait for
+  std::lock_guard<std::mutex> const lock (object->_mutex);
+  object->_loading_job = nullptr;
 }
 
 void AsyncLoader::queue_for_load (AsyncObject* object)
 {
-  std::lock_guard<std::mutex> const lock (_guard);
-  _to_load[(size_t)object->loading_priority()].push_back (object);
-  _state_changed.notify_one();
-
-  _object_queued_count++;
+  // held while scheduling: the job can't get to the point of clearing
+  // the handle before it is stored, and cancel() or ensure_deletable()
+  // never see the object queued without its job
+  std::lock_guard<std::mutex> const lock (object->_mutex);
+  object->_loading_job = _scheduler.schedule ( [this, object] { process (object); }
+                                             , static_cast<std::size_t> (object->loading_priority())
+                                             );
 }
 
 void AsyncLoader::ensure_deletable (AsyncObject* object)
 {
-  std::unique_lock<std::mutex> lock (_guard);
-  _state_changed.wait
-  ( lock
-  , [&]
-    {
-      auto& to_load = _to_load[(size_t)object->loading_priority()];
-      auto const& it = std::find (to_load.begin(), to_load.end(), object);
-
-      // don't load it if it's just to delete it afterward
-      if (it != to_load.end())
-      {
-        to_load.erase(it);
-        return true;
-      }
-      else
-      {
-        return std::find (_currently_loading.begin(), _currently_loading.end(), object) == _currently_loading.end();
-      }
-    }
-  );
-}
+  noggit::job_scheduler::handle job;
+  {
+    std::lock_guard<std::mutex> const lock (object->_mutex);
+    job = object->_loading_job;
+  }
 
-void AsyncLoader::wait_queue_empty()
-{
-  std::unique_lock<std::mutex> lock (_guard);
-  _state_changed.wait
-  ( lock
-  , [&]
-    {
-      return _object_queued_count.load() == 0;
-    }
-  );
+  // don't load it if it's just to delete it afterward
+  if (job && !_scheduler.cancel (job))
+  {
+    _scheduler.wait (job);
+  }
 }
 
-AsyncLoader::AsyncLoader(int numThreads)
-  : _stop (false)
+bool AsyncLoader::cancel (AsyncObject* object)
 {
-  for (int i = 0; i < numThreads; ++i)
+  noggit::job_scheduler::handle job;
   {
-    _threads.emplace_back (&AsyncLoader::process, this);
+    std::lock_guard<std::mutex> const lock (object->_mutex);
+    job = object->_loading_job;
   }
-}
 
-AsyncLoader::~AsyncLoader()
-{
-  _stop = true;
-  _state_changed.notify_all();
+  if (!job || !_scheduler.cancel (job))
+  {
+    return false;
+  }
 
-  for (auto& thread : _threads)
+  std::lock_guard<std::mutex> const lock (object->_mutex);
+  if (object->_loading_job == job)
   {
-    thread.join();
+    object->_loading_job = nullptr;
   }
+  return true;
+}
+
+void AsyncLoader::wait_queue_empty()
+{
+  _scheduler.wait_idle();
+}
+
+AsyncLoader::AsyncLoader(int numThreads)
+  : _scheduler (numThreads, static_cast<std::size_t> (async_priority::count))
+{
 }
@@ -3,13 +3,10 @@
 #pragma once
 
 #include <noggit/AsyncObject.h>
+#include <noggit/job_scheduler.hpp>
 
-#include <array>
 #include <atomic>
-#include <condition_variable>
-#include <list>
-#include <memory>
-#include <thread>
+#include <mutex>
 
 class AsyncLoader
 {
@@ -22,28 +19,35 @@ class AsyncLoader
 
   //! Ownership is _not_ transferred. Call ensure_deletable to ensure
   //! that a previously enqueued object can be destroyed.
+  //! Objects queued from within another object's finishLoading() are
+  //! loaded by the same thread right after, e.g. a model's textures.
   void queue_for_load (AsyncObject*);
 
+  //! O(1) if the object did not start loading yet, otherwise waits
+  //! until it is done.
   void ensure_deletable (AsyncObject*);
 
+  //! Drop the object from the queue if it did not start loading yet,
+  //! never waits. False if it started or was never queued.
+  bool cancel (AsyncObject*);
+
   // wait until everything is loaded
   void wait_queue_empty();
 
   AsyncLoader(int numThreads);
-  ~AsyncLoader();
+  ~AsyncLoader() = default;
 
   bool important_object_failed_loading() const { return _important_object_failed_loading; }
   void reset_object_fail() { _important_object_failed_loading = false; }
 
+  //! Held while logging from the loader's threads. Other code logging
+  //! from worker threads, e.g. tiles serializing, takes it too.
+  std::mutex& log_guard() { return _log_guard; }
+
 private:
-  void process();
-
-  std::mutex _guard;
-  std::condition_variable _state_changed;
-  std::atomic<bool> _stop;
-  std::atomic<int> _object_queued_count = { 0 };
-  std::array<std::list<AsyncObject*>, (size_t)async_priority::count> _to_load;
-  std::list<AsyncObject*> _currently_loading;
-  std::list<std::thread> _threads;
-  bool _important_object_failed_loading = false;
+  void process (AsyncObject*);
+
+  std::mutex _log_guard;
+  std::atomic<bool> _important_object_failed_loading = {false};
+  noggit::job_scheduler _scheduler;
 };
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <noggit/Log.h>
+#include <noggit/job_scheduler.hpp>
 
 #include <atomic>
 #include <condition_variable>
@@ -17,10 +18,16 @@ enum class async_priority : int
   count
 };
 
+class AsyncLoader;
+
 class AsyncObject
 {
 private:
+  friend class AsyncLoader;
+
   bool _loading_failed = false;
+  //! guarded by _mutex
+  noggit::job_scheduler::handle _loading_job;
 protected:
   std::atomic<bool> finished = {false};
   std::mutex _mutex;
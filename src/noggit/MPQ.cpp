@@ -3,6 +3,8 @@
 #include <noggit/AsyncLoader.h> // AsyncLoader
 #include <noggit/Log.h>
 #include <noggit/MPQ.h>
+#include <noggit/archive_index.hpp>
+#include <noggit/mapped_file.hpp>
 #include <noggit/settings.hpp>
 
 #include <boost/algorithm/string.hpp>
@@ -10,14 +12,19 @@
 #include <boost/thread.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <list>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace
@@ -27,23 +34,89 @@ namespace
   ArchivesMap _openArchives;
 
   boost::mutex gListfileLoadingMutex;
-  boost::mutex gMPQFileMutex;
+
+  DWORD const archive_open_flags = MPQ_OPEN_NO_LISTFILE | STREAM_FLAG_READ_ONLY;
+
+  //! Built once by MPQArchive::allFinishLoading() and immutable after,
+  //! so readers only ever load the pointer.
+  struct merged_archive_index
+  {
+    noggit::archive_index index;
+    //! in load order, numbered like in index
+    std::vector<MPQArchive const*> archives;
+    //! archives without (listfile) with their load order position,
+    //! newest first. They still have to be asked directly.
+    std::vector<std::pair<std::size_t, MPQArchive const*>> unindexed;
+  };
+
+  boost::filesystem::path gListfileCachePath;
+  std::unique_ptr<noggit::listfile_cache> gListfileCache;
+
+  boost::mutex gArchiveIndexMutex;
+  std::unique_ptr<merged_archive_index const> gArchiveIndexStorage;
+  std::atomic<merged_archive_index const*> gArchiveIndex = {nullptr};
+
+  //! What asking every archive gave for the names the merged index does
+  //! not have, by normalized name. Cleared with the index.
+  boost::mutex gUnlistedMutex;
+  std::unordered_map<std::string, MPQArchive const*> gUnlisted;
+
+  void forget_unlisted()
+  {
+    boost::mutex::scoped_lock const lock (gUnlistedMutex);
+    gUnlisted.clear();
+  }
+
+  std::size_t thread_handle_hint()
+  {
+    static std::atomic<std::size_t> next_thread = {0};
+    thread_local std::size_t const hint = next_thread++;
+    return hint;
+  }
 }
 
 std::unordered_set<std::string> gListfile;
 
+struct MPQArchive::handle_slot
+{
+  std::mutex guard;
+  HANDLE handle = nullptr;
+};
+
+void MPQArchive::useListfileCache (boost::filesystem::path const& cache_file)
+{
+  gListfileCachePath = cache_file;
+  gListfileCache = std::make_unique<noggit::listfile_cache> (cache_file);
+
+  LogDebug << "Listfile cache '" << cache_file.string() << "' knows "
+           << gListfileCache->size() << " archives" << std::endl;
+}
+
 void MPQArchive::loadMPQ (AsyncLoader* loader, std::string const& filename, bool doListfile)
 {
   _openArchives.emplace_back (filename, std::make_unique<MPQArchive> (filename, doListfile));
-  loader->queue_for_load(_openArchives.back().second.get());
+  MPQArchive* archive (_openArchives.back().second.get());
+
+  // its listfile is only read if the cached index turns out not to be
+  // of these archives after all
+  archive->_listfile_from_cache
+    = doListfile && gListfileCache && gListfileCache->has (_openArchives.size() - 1, filename);
+
+  loader->queue_for_load(archive);
 }
 
 MPQArchive::MPQArchive(std::string const& filename_, bool doListfile)
   : AsyncObject(filename_)
-  ,_archiveHandle(nullptr)
+  , _opened(false)
 {
-  if (!SFileOpenArchive (filename.c_str(), 0, MPQ_OPEN_NO_LISTFILE | STREAM_FLAG_READ_ONLY, &_archiveHandle))
+  for (unsigned i = 0; i < std::max (1u, std::thread::hardware_concurrency()); ++i)
   {
+    _handles.emplace_back (std::make_unique<handle_slot>());
+  }
+
+  if (!SFileOpenArchive (filename.c_str(), 0, archive_open_flags, &_handles.front()->handle))
+  {
+    _handles.front()->handle = nullptr;
     LogError << "Error opening archive: " << filename << std::endl;
     return;
   }
@@ -52,51 +125,63 @@ MPQArchive::MPQArchive(std::string const& filename_, bool doListfile)
     LogDebug << "Opened archive " << filename << std::endl;
   }
 
+  _opened = true;
   finished = !doListfile;
 }
 
-void MPQArchive::finishLoading()
+template<typename Fun>
+  bool MPQArchive::with_handle (Fun&& fun) const
 {
-  if (finished)
-    return;
-
-  HANDLE fh;
-
-  boost::mutex::scoped_lock lock2(gMPQFileMutex);
-  boost::mutex::scoped_lock lock(gListfileLoadingMutex);
-
-  if (SFileOpenFileEx(_archiveHandle, "(listfile)", 0, &fh))
+  if (!_opened)
   {
-    size_t filesize = SFileGetFileSize(fh, nullptr); //last nullptr for newer version of StormLib
-
-    std::vector<char> readbuffer (filesize);
-    SFileReadFile(fh, readbuffer.data(), filesize, nullptr, nullptr); //last nullptrs for newer version of StormLib
-    SFileCloseFile(fh);
+    return false;
+  }
 
-    std::string current;
-    for (char c : readbuffer)
-    {
-      if (c == '\r')
+  auto const use
+    ( [&] (handle_slot& slot)
       {
-        continue;
+        if (!slot.handle && !SFileOpenArchive (filename.c_str(), 0, archive_open_flags, &slot.handle))
+        {
+          slot.handle = nullptr;
+          return false;
+        }
+        return static_cast<bool> (fun (slot.handle));
       }
-      if (c == '\n')
-      {
-        gListfile.emplace (noggit::mpq::normalized_filename (current));
-        current.resize (0);
-      }
-      else
-      {
-        current += c;
-      }
-    }
+    );
 
-    if (!current.empty())
+  std::size_t const home (thread_handle_hint() % _handles.size());
+
+  for (std::size_t offset = 0; offset < _handles.size(); ++offset)
+  {
+    handle_slot& slot (*_handles[(home + offset) % _handles.size()]);
+    std::unique_lock<std::mutex> const lock (slot.guard, std::try_to_lock);
+    if (lock.owns_lock())
     {
-      gListfile.emplace (noggit::mpq::normalized_filename (current));
+      return use (slot);
     }
   }
 
+  handle_slot& slot (*_handles[home]);
+  std::lock_guard<std::mutex> const lock (slot.guard);
+  return use (slot);
+}
+
+void MPQArchive::finishLoading()
+{
+  if (finished)
+    return;
+
+  // allFinishLoading() may get here while a loader thread is too
+  std::lock_guard<std::mutex> const lock (_mutex);
+
+  if (finished)
+    return;
+
+  if (!_listfile_from_cache)
+  {
+    read_listfile();
+  }
+
   finished = true;
   _state_changed.notify_all();
 
@@ -106,10 +191,39 @@ void MPQArchive::finishLoading()
   }
 }
 
+void MPQArchive::read_listfile()
+{
+  std::vector<char> readbuffer;
+
+  if (readFile ("(listfile)", readbuffer))
+  {
+    _listfile = noggit::parse_listfile (readbuffer.data(), readbuffer.size());
+
+    // listfiles may name files which are not (or no longer) in the
+    // archive, the index must not
+    with_handle ( [&] (HANDLE handle)
+                  {
+                    for (std::size_t i = 0; i < _listfile.names.size(); ++i)
+                    {
+                      _listfile.present[i] = SFileHasFile
+                        (handle, noggit::mpq::normalized_filename_insane (_listfile.names[i]).c_str());
+                    }
+                    return true;
+                  }
+                );
+  }
+
+  boost::mutex::scoped_lock const listfile_lock (gListfileLoadingMutex);
+  gListfile.insert (_listfile.names.begin(), _listfile.names.end());
+}
+
 MPQArchive::~MPQArchive()
 {
-  if (_archiveHandle)
-    SFileCloseArchive(_archiveHandle);
+  for (auto& slot : _handles)
+  {
+    if (slot->handle)
+      SFileCloseArchive(slot->handle);
+  }
 }
 
 bool MPQArchive::allFinishedLoading()
@@ -128,33 +242,158 @@ void MPQArchive::allFinishLoading()
   {
     archive.second->finishLoading();
   }
+
+  boost::mutex::scoped_lock const lock (gArchiveIndexMutex);
+
+  if (gArchiveIndex.load())
+  {
+    return;
+  }
+
+  if (gListfileCache)
+  {
+    std::vector<boost::filesystem::path> paths;
+    for (auto const& archive : _openArchives)
+    {
+      paths.emplace_back (archive.first);
+    }
+
+    auto cached (gListfileCache->find (paths));
+    gListfileCache.reset();
+
+    if (cached)
+    {
+      std::vector<MPQArchive const*> archives;
+      std::vector<std::pair<std::size_t, MPQArchive const*>> unindexed;
+
+      for (auto const& archive : _openArchives)
+      {
+        if (!cached->has_listfile[archives.size()] && archive.second->_opened)
+        {
+          unindexed.emplace (unindexed.begin(), archives.size(), archive.second.get());
+        }
+        archives.emplace_back (archive.second.get());
+      }
+
+      {
+        boost::mutex::scoped_lock const listfile_lock (gListfileLoadingMutex);
+        cached->index.for_each_name ([] (std::string_view name) { gListfile.emplace (name); });
+      }
+
+      gArchiveIndexStorage = std::make_unique<merged_archive_index const>
+        (merged_archive_index {std::move (cached->index), std::move (archives), std::move (unindexed)});
+      gArchiveIndex = gArchiveIndexStorage.get();
+      forget_unlisted();
+
+      LogDebug << "Took the index of " << gArchiveIndexStorage->index.size() << " files in "
+               << gArchiveIndexStorage->archives.size() << " archives from the listfile cache" << std::endl;
+      return;
+    }
+
+    // some archives changed after all: those that skipped their listfile
+    // still have to read it
+    for (auto const& archive : _openArchives)
+    {
+      if (archive.second->_listfile_from_cache)
+      {
+        archive.second->_listfile_from_cache = false;
+        archive.second->read_listfile();
+      }
+    }
+  }
+
+  std::vector<noggit::listfile_cache::archive> cached_archives;
+  std::vector<std::vector<std::string>> names_by_archive;
+  std::vector<MPQArchive const*> archives;
+  std::vector<std::pair<std::size_t, MPQArchive const*>> unindexed;
+
+  for (auto& archive : _openArchives)
+  {
+    noggit::archive_listfile& listfile (archive.second->_listfile);
+    cached_archives.push_back ({archive.first, listfile.has_listfile});
+
+    if (!listfile.has_listfile && archive.second->_opened)
+    {
+      unindexed.emplace (unindexed.begin(), archives.size(), archive.second.get());
+    }
+
+    names_by_archive.emplace_back();
+    for (std::size_t i = 0; i < listfile.names.size(); ++i)
+    {
+      if (listfile.present[i])
+      {
+        names_by_archive.back().emplace_back (std::move (listfile.names[i]));
+      }
+    }
+    listfile = noggit::archive_listfile();
+    archives.emplace_back (archive.second.get());
+  }
+
+  gArchiveIndexStorage = std::make_unique<merged_archive_index const>
+    (merged_archive_index {noggit::archive_index (names_by_archive), std::move (archives), std::move (unindexed)});
+  gArchiveIndex = gArchiveIndexStorage.get();
+  forget_unlisted();
+
+  LogDebug << "Indexed " << gArchiveIndexStorage->index.size() << " files in "
+           << gArchiveIndexStorage->archives.size() << " archives" << std::endl;
+
+  if (!gListfileCachePath.empty())
+  {
+    try
+    {
+      noggit::listfile_cache::write (gListfileCachePath, cached_archives, gArchiveIndexStorage->index);
+    }
+    catch (std::runtime_error const& error)
+    {
+      LogError << "Could not write listfile cache: " << error.what() << std::endl;
+    }
+  }
 }
 
 void MPQArchive::unloadAllMPQs()
 {
+  boost::mutex::scoped_lock const lock (gArchiveIndexMutex);
+  gArchiveIndex = nullptr;
+  gArchiveIndexStorage.reset();
+  forget_unlisted();
+
   _openArchives.clear();
 }
 
 bool MPQArchive::hasFile(std::string const& file) const
 {
-  return SFileHasFile(_archiveHandle, noggit::mpq::normalized_filename_insane (file).c_str());
+  std::string const name (noggit::mpq::normalized_filename_insane (file));
+  return with_handle ([&] (HANDLE handle) { return SFileHasFile (handle, name.c_str()); });
 }
 
 void MPQArchive::unloadMPQ(std::string const& filename)
 {
-  for (auto it = _openArchives.begin(); it != _openArchives.end(); ++it)
-  {
-    if (it->first == filename)
-    {
-      _openArchives.erase(it);
-    }
-  }
+  boost::mutex::scoped_lock const lock (gArchiveIndexMutex);
+  gArchiveIndex = nullptr;
+  gArchiveIndexStorage.reset();
+  forget_unlisted();
+
+  _openArchives.remove_if ([&] (ArchiveEntry const& archive) { return archive.first == filename; });
 }
 
-bool MPQArchive::openFile(std::string const& file, HANDLE* fileHandle) const
+bool MPQArchive::readFile(std::string const& file, std::vector<char>& buffer) const
 {
-  assert(fileHandle);
-  return SFileOpenFileEx(_archiveHandle, noggit::mpq::normalized_filename_insane (file).c_str(), 0, fileHandle);
+  std::string const name (noggit::mpq::normalized_filename_insane (file));
+  return with_handle
+    ( [&] (HANDLE handle)
+      {
+        HANDLE fileHandle;
+        if (!SFileOpenFileEx (handle, name.c_str(), 0, &fileHandle))
+        {
+          return false;
+        }
+
+        buffer.resize (SFileGetFileSize (fileHandle, nullptr));
+        SFileReadFile (fileHandle, buffer.data(), buffer.size(), nullptr, nullptr); //last nullptrs for newer version of StormLib
+        SFileCloseFile (fileHandle);
+        return true;
+      }
+    );
 }
 
 namespace
@@ -165,14 +404,77 @@ namespace
       / normalized_filename;
   }
 
+  //! asks every open archive, newest first
+  MPQArchive const* probeArchives (std::string const& filename)
+  {
+    for (auto archive = _openArchives.rbegin(); archive != _openArchives.rend(); ++archive)
+    {
+      if (archive->second->hasFile (filename))
+      {
+        return archive->second.get();
+      }
+    }
+    return nullptr;
+  }
+
+  //! Listfiles don't have to name every file of their archive, so names
+  //! missing from the merged index are asked for, but only once: files
+  //! that don't exist at all are looked up all the time.
+  MPQArchive const* findUnlisted (std::string const& filename)
+  {
+    std::string name (noggit::mpq::normalized_filename (filename));
+
+    {
+      boost::mutex::scoped_lock const lock (gUnlistedMutex);
+      auto const known (gUnlisted.find (name));
+      if (known != gUnlisted.end())
+      {
+        return known->second;
+      }
+    }
+
+    MPQArchive const* const archive (probeArchives (filename));
+
+    boost::mutex::scoped_lock const lock (gUnlistedMutex);
+    gUnlisted.emplace (std::move (name), archive);
+    return archive;
+  }
+
+  //! the newest archive containing filename, nullptr if there is none
+  MPQArchive const* findArchive (std::string const& filename)
+  {
+    merged_archive_index const* merged (gArchiveIndex.load());
+
+    if (!merged)
+    {
+      return probeArchives (filename);
+    }
+
+    std::size_t const found (merged->index.find (filename));
+
+    for (auto const& unindexed : merged->unindexed)
+    {
+      if (found != noggit::archive_index::not_found && unindexed.first < found)
+      {
+        break;
+      }
+      if (unindexed.second->hasFile (filename))
+      {
+        return unindexed.second;
+      }
+    }
+
+    if (found == noggit::archive_index::not_found)
+    {
+      return findUnlisted (filename);
+    }
+
+    return merged->archives[found];
+  }
+
   bool existsInMPQ (std::string const& filename)
   {
-    return std::any_of ( _openArchives.begin(), _openArchives.end()
-                       , [&] (ArchiveEntry const& archive)
-                         {
-                           return archive.second->hasFile (filename);
-                         }
-                       );
+    return findArchive (filename) != nullptr;
   }
 }
 
@@ -181,6 +483,7 @@ namespace
 */
 MPQFile::MPQFile(std::string const& filename)
   : eof(true)
+  , _size(0)
   , pointer(0)
   , External(false)
   , _filename(noggit::mpq::normalized_filename(filename))
@@ -189,42 +492,41 @@ MPQFile::MPQFile(std::string const& filename)
   if (filename.empty())
     throw std::runtime_error("MPQFile: filename empty");
 
-  std::ifstream input(_disk_path.string(), std::ios_base::binary | std::ios_base::in);
-  if (input.is_open())
+  if (auto contents = noggit::read_file_contents (_disk_path))
   {
     External = true;
     eof = false;
 
-    input.seekg(0, std::ios::end);
-    buffer.resize (input.tellg());
-    input.seekg(0, std::ios::beg);
-
-    input.read(buffer.data(), buffer.size());
-
-    input.close();
+    _buffer = std::move (contents->data);
+    _size = contents->size;
     return;
   }
 
-  boost::mutex::scoped_lock lock(gMPQFileMutex);
-
-  for (ArchivesMap::reverse_iterator i = _openArchives.rbegin(); i != _openArchives.rend(); ++i)
+  if (MPQArchive const* archive = findArchive (filename))
   {
-    HANDLE fileHandle;
-
-    if (!i->second->openFile(filename, &fileHandle))
-      continue;
-
-    eof = false;
-    buffer.resize (SFileGetFileSize(fileHandle, nullptr));
-    SFileReadFile(fileHandle, buffer.data(), buffer.size(), nullptr, nullptr); //last nullptrs for newer version of StormLib
-    SFileCloseFile(fileHandle);
-
-    return;
+    std::vector<char> buffer;
+    if (archive->readFile (filename, buffer))
+    {
+      eof = false;
+      set_owned_buffer (std::move (buffer));
+      return;
+    }
   }
 
   throw std::invalid_argument ("File '" + filename + "' does not exist.");
 }
 
+MPQFile::MPQFile(MPQFile const& other, size_t position)
+  : eof(position >= other._size)
+  , _buffer(other._buffer)
+  , _size(other._size)
+  , pointer(position)
+  , External(other.External)
+  , _filename(other._filename)
+  , _disk_path(other._disk_path)
+{
+}
+
 MPQFile::~MPQFile()
 {
   close();
@@ -238,6 +540,10 @@ bool MPQFile::existsOnDisk (std::string const& filename)
 {
   return boost::filesystem::exists (getDiskPath (filename));
 }
+boost::filesystem::path MPQFile::disk_path (std::string const& filename)
+{
+  return getDiskPath (noggit::mpq::normalized_filename (filename));
+}
 
 size_t MPQFile::read(void* dest, size_t bytes)
 {
@@ -245,12 +551,12 @@ size_t MPQFile::read(void* dest, size_t bytes)
     return 0;
 
   size_t rpos = pointer + bytes;
-  if (rpos > buffer.size()) {
-    bytes = buffer.size() - pointer;
+  if (rpos > _size) {
+    bytes = _size - pointer;
     eof = true;
   }
 
-  memcpy(dest, &(buffer[pointer]), bytes);
+  memcpy(dest, _buffer.get() + pointer, bytes);
 
   pointer = rpos;
 
@@ -265,13 +571,13 @@ bool MPQFile::isEof() const
 void MPQFile::seek(size_t offset)
 {
   pointer = offset;
-  eof = (pointer >= buffer.size());
+  eof = (pointer >= _size);
 }
 
 void MPQFile::seekRelative(size_t offset)
 {
   pointer += offset;
-  eof = (pointer >= buffer.size());
+  eof = (pointer >= _size);
 }
 
 void MPQFile::close()
@@ -281,7 +587,7 @@ void MPQFile::close()
 
 size_t MPQFile::getSize() const
 {
-  return buffer.size();
+  return _size;
 }
 
 size_t MPQFile::getPos() const
@@ -291,12 +597,19 @@ size_t MPQFile::getPos() const
 
 char const* MPQFile::getBuffer() const
 {
-  return buffer.data();
+  return _buffer.get();
 }
 
 char const* MPQFile::getPointer() const
 {
-  return buffer.data() + pointer;
+  return _buffer.get() + pointer;
+}
+
+void MPQFile::set_owned_buffer (std::vector<char> buffer)
+{
+  auto owned (std::make_shared<std::vector<char>> (std::move (buffer)));
+  _size = owned->size();
+  _buffer = std::shared_ptr<char const> (owned, owned->data());
 }
 
 
@@ -309,25 +622,17 @@ void MPQFile::save_file(boost::filesystem::path& path)
 {
   LogDebug << "Save file to: " << path << std::endl;
 
-  auto const directory_name(path.parent_path());
-  boost::system::error_code ec;
-  boost::filesystem::create_directories(directory_name, ec);
-
-  if (ec)
-  {
-    LogError << "Creating directory \"" << directory_name << "\" failed: " << ec << ". Saving is highly likely to fail." << std::endl;
-  }
-
-  std::ofstream output(path.string(), std::ios_base::binary | std::ios_base::out);
-  if (output.is_open())
+  try
   {
-    NOGGIT_LOG << "Saving file \"" << path << "\"." << std::endl;
-
-    output.write(buffer.data(), buffer.size());
-    output.close();
+    noggit::write_file_atomically (path, _buffer.get(), _size);
 
+    NOGGIT_LOG << "Saved file \"" << path << "\"." << std::endl;
     External = true;
   }
+  catch (std::exception const& exception)
+  {
+    LogError << "Saving \"" << path << "\" failed: " << exception.what() << std::endl;
+  }
 }
 
 void MPQFile::SaveFile()
@@ -3,11 +3,13 @@
 #pragma once
 
 #include <noggit/AsyncObject.h>
+#include <noggit/listfile_cache.hpp>
 
 #include <StormLib.h>
 
 #include <boost/filesystem/path.hpp>
 
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -21,7 +23,21 @@ extern std::unordered_set<std::string> gListfile;
 
 class MPQArchive : public AsyncObject
 {
-  HANDLE _archiveHandle;
+  //! StormLib handles can't be used by several threads at once, so
+  //! every archive has a few of them, opened on demand. Threads each
+  //! prefer their own one and only wait when all of them are busy.
+  struct handle_slot;
+  std::vector<std::unique_ptr<handle_slot>> _handles;
+  bool _opened;
+
+  //! (listfile), kept until the merged index is built. Not read at all
+  //! if the listfile cache is likely to have the index already.
+  noggit::archive_listfile _listfile;
+  bool _listfile_from_cache = false;
+
+  template<typename Fun>
+    bool with_handle (Fun&&) const;
+  void read_listfile();
 
 public:
   MPQArchive(const std::string& filename, bool doListfile);
@@ -29,14 +45,21 @@ class MPQArchive : public AsyncObject
   ~MPQArchive();
 
   bool hasFile(const std::string& filename) const;
-  bool openFile(const std::string& filename, HANDLE* fileHandle) const;
+  bool readFile(const std::string& filename, std::vector<char>& buffer) const;
 
   void finishLoading();
 
   static bool allFinishedLoading();
+  //! Also builds the merged index of all archives, after which finding
+  //! a file no longer needs to ask every archive for it.
   static void allFinishLoading();
 
+  //! Take the merged index from cache_file if it was written for the
+  //! same archives, all unchanged since, and write it there otherwise.
+  //! Has to be called before loading the archives.
+  static void useListfileCache (boost::filesystem::path const& cache_file);
   static void loadMPQ (AsyncLoader*, const std::string& filename, bool doListfile = false);
+  //! Neither of those may be called while files are being read.
   static void unloadAllMPQs();
   static void unloadMPQ(const std::string& filename);
 
@@ -47,7 +70,11 @@ class MPQArchive : public AsyncObject
 class MPQFile
 {
   bool eof;
-  std::vector<char> buffer;
+  //! Either a read-only mapping of a loose file or a buffer of our own.
+  //! Borrowers get a reference via shared_buffer(), so setBuffer()
+  //! replaces it rather than write to it.
+  std::shared_ptr<char const> _buffer;
+  size_t _size;
   size_t pointer;
 
 
@@ -58,6 +85,9 @@ class MPQFile
 
 public:
   explicit MPQFile(const std::string& pFilename);  // filenames are not case sensitive, the are if u dont use a filesystem which is kinda shitty...
+  //! Another read position in \a other's contents, which it shares, so
+  //! that several threads can read parts of the same file.
+  MPQFile(MPQFile const& other, size_t position);
 
   MPQFile() = delete;
   ~MPQFile();
@@ -83,12 +113,19 @@ class MPQFile
   template<typename T>
   const T* get(size_t offset) const
   {
-    return reinterpret_cast<T const*>(buffer.data() + offset);
+    return reinterpret_cast<T const*>(_buffer.get() + offset);
+  }
+
+  //! Keeps the current contents alive independently of this file, so
+  //! pointers into them can be used after closing or mutating it.
+  std::shared_ptr<char const> shared_buffer() const
+  {
+    return _buffer;
   }
 
   void setBuffer (std::vector<char> const& vec)
   {
-    buffer = vec;
+    set_owned_buffer (std::vector<char> (vec));
   }
 
 
@@ -98,8 +135,13 @@ class MPQFile
 
   static bool exists (std::string const& filename);
   static bool existsOnDisk (std::string const& filename);
+  //! where SaveFile() writes filename to
+  static boost::filesystem::path disk_path (std::string const& filename);
 
   friend class MPQArchive;
+
+private:
+  void set_owned_buffer (std::vector<char>);
 };
 
 namespace noggit
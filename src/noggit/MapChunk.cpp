@@ -9,8 +9,11 @@
 #include <noggit/Log.h>
 #include <noggit/MapChunk.h>
 #include <noggit/MapHeaders.h>
+#include <noggit/mcnk_vertices.hpp>
 #include <noggit/Misc.h>
 #include <noggit/World.h>
+#include <noggit/terrain_normals.hpp>
+#include <noggit/tile_cache.hpp>
 #include <noggit/alphamap.hpp>
 #include <noggit/texture_set.hpp>
 #include <noggit/tool_enums.hpp>
@@ -20,8 +23,22 @@
 #include <algorithm>
 #include <iostream>
 #include <map>
+#include <stdexcept>
 
-MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode)
+namespace
+{
+  // the next size bytes of the file, which are read in one go
+  char const* next_bytes (MPQFile const* f, std::size_t size, char const* chunk)
+  {
+    if (f->getPos() + size > f->getSize())
+    {
+      throw std::runtime_error (std::string (chunk) + " goes past the end of the file");
+    }
+    return f->getPointer();
+  }
+}
+
+MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode, noggit::tile_cache::cached_chunk const* cached)
   : _mode(mode)
   , mt(maintile)
   , use_big_alphamap(bigAlpha)
@@ -68,28 +85,23 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode)
 
     assert(fourcc == 'MCVT');
 
-    chunk_vertex* cv_ptr = vertices.data();
-
-    // vertices
-    for (int j = 0; j < 17; ++j)
+    if (cached)
     {
-      for (int i = 0; i < ((j % 2) ? 8 : 9); ++i)
-      {
-        float h, xpos, zpos;
-        f->read(&h, 4);
-        xpos = i * UNITSIZE;
-        zpos = j * 0.5f * UNITSIZE;
-        if (j % 2)
-        {
-          xpos += UNITSIZE * 0.5f;
-        }
-        cv_ptr->position = math::vector_3d(xbase + xpos, ybase + h, zbase + zpos);
-
-        vmin.y = std::min(vmin.y, cv_ptr->position.y);
-        vmax.y = std::max(vmax.y, cv_ptr->position.y);
-
-        cv_ptr++;
-      }
+      cached->copy_vertices(vertices.data());
+      vmin.y = cached->min_height;
+      vmax.y = cached->max_height;
+    }
+    else
+    {
+      auto const heights
+        ( noggit::mcnk_vertices::read_heights
+            ( next_bytes (f, noggit::mcnk_vertices::mcvt_size, "MCVT")
+            , {xbase, ybase, zbase}
+            , vertices.data()
+            )
+        );
+      vmin.y = heights.min;
+      vmax.y = heights.max;
     }
 
     vmin.x = xbase;
@@ -104,6 +116,7 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode)
     header.ypos = 0.0f;
   }
   // - MCNR ----------------------------------------------
+  if (!cached)
   {
     f->seek(base + header.ofsNormal);
     f->read(&fourcc, 4);
@@ -111,14 +124,8 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode)
 
     assert(fourcc == 'MCNR');
 
-    char nor[3];
-    chunk_vertex* cv_ptr = vertices.data();
-    for (int i = 0; i< mapbufsize; ++i)
-    {
-      f->read(nor, 3);
-      cv_ptr->normal = math::vector_3d(nor[0] / 127.0f, nor[2] / 127.0f, nor[1] / 127.0f);
-      cv_ptr++;
-    }
+    noggit::mcnk_vertices::read_normals
+      (next_bytes (f, noggit::mcnk_vertices::mcnr_size, "MCNR"), vertices.data());
   }
   // - MCSH ----------------------------------------------
   if(header.ofsShadow && header.sizeShadow)
@@ -154,7 +161,11 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode)
     }
   }
 
-  texture_set = std::make_unique<TextureSet>(header, f, base, maintile, bigAlpha, !!header.flags.flags.do_not_fix_alpha_map, mode == tile_mode::uid_fix_all, _chunk_shadow ? _chunk_shadow.get() : nullptr);
+  texture_set = std::make_unique<TextureSet>( header, f, base, maintile, bigAlpha
+                                            , !!header.flags.flags.do_not_fix_alpha_map
+                                            , mode == tile_mode::uid_fix_all
+                                            , cached ? &cached->alphamaps : nullptr
+                                            );
 
   // - MCCV ----------------------------------------------
   if(header.ofsMCCV)
@@ -172,14 +183,13 @@ MapChunk::MapChunk(MapTile *maintile, MPQFile *f, bool bigAlpha, tile_mode mode)
 
     _has_mccv = true;
 
-    unsigned char t[4];
-    for (int i = 0; i < mapbufsize; ++i)
+    if (!cached)
     {
-      f->read(t, 4);
-      vertices[i].color = math::vector_3d((float)t[2] / 127.0f, (float)t[1] / 127.0f, (float)t[0] / 127.0f);
+      noggit::mcnk_vertices::read_colors
+        (next_bytes (f, noggit::mcnk_vertices::mccv_size, "MCCV"), vertices.data());
     }
   }
-  else
+  else if (!cached)
   {
     math::vector_3d mccv_default(1.f, 1.f, 1.f);
     for (int i = 0; i < mapbufsize; ++i)
@@ -289,7 +299,7 @@ void MapChunk::override_data(noggit::chunk_data& data, noggit::chunk_override_pa
   // force update
   _need_indice_buffer_update = true;
   _need_lod_update = true;
-  _need_vao_update = true;
+  require_vertices_buffer_update();
   _need_visibility_update = true;
   _shader_data_need_update = true;
 
@@ -347,7 +357,7 @@ void MapChunk::set_preview_data(noggit::chunk_data& data, noggit::chunk_override
   // force update
   _need_indice_buffer_update = true;
   _need_lod_update = true;
-  _need_vao_update = true;
+  require_vertices_buffer_update();
   _need_visibility_update = true;
   _shader_data_need_update = true;
 
@@ -376,7 +386,7 @@ void MapChunk::set_is_in_paste_zone(bool v)
     // force update
     _need_indice_buffer_update = true;
     _need_lod_update = true;
-    _need_vao_update = true;
+    require_vertices_buffer_update();
     _need_visibility_update = true;
     _shader_data_need_update = true;
 
@@ -407,7 +417,9 @@ void MapChunk::update_intersect_points()
   _intersect_points.clear();
   _intersect_points = misc::intersection_points(vmin, vmax);
 
-  mt->need_chunk_data_update();
+  _height_quadtree.refit([&] (int vertex) -> math::vector_3d const& { return vertices[vertex].position; });
+
+  mt->dirty_regions().mark(chunk_index());
 }
 
 int MapChunk::get_lod_level(math::vector_3d const& camera_pos, display_mode display) const
@@ -487,12 +499,9 @@ int MapChunk::indices_count(int lod_level) const
   return count;
 }
 
-std::vector<chunk_indice> MapChunk::strip_without_holes = {};
 
 void MapChunk::initStrip()
 {
-  bool init_strip_without_holes = strip_without_holes.size() == 0;
-
   _indice_strips.clear();
 
   std::array<int, indice_buffer_count> index_count;
@@ -509,22 +518,6 @@ void MapChunk::initStrip()
   {
     for (int y = 0; y<8; ++y)
     {
-      if (init_strip_without_holes)
-      {
-        strip_without_holes.emplace_back(indexLoD(y, x)); //9
-        strip_without_holes.emplace_back(indexNoLoD(y, x)); //0
-        strip_without_holes.emplace_back(indexNoLoD(y + 1, x)); //17
-        strip_without_holes.emplace_back(indexLoD(y, x)); //9
-        strip_without_holes.emplace_back(indexNoLoD(y + 1, x)); //17
-        strip_without_holes.emplace_back(indexNoLoD(y + 1, x + 1)); //18
-        strip_without_holes.emplace_back(indexLoD(y, x)); //9
-        strip_without_holes.emplace_back(indexNoLoD(y + 1, x + 1)); //18
-        strip_without_holes.emplace_back(indexNoLoD(y, x + 1)); //1
-        strip_without_holes.emplace_back(indexLoD(y, x)); //9
-        strip_without_holes.emplace_back(indexNoLoD(y, x + 1)); //1
-        strip_without_holes.emplace_back(indexNoLoD(y, x)); //0
-      }
-
       if (isHole(x / 2, y / 2))
         continue;
 
@@ -563,7 +556,7 @@ void MapChunk::initStrip()
 
   _need_indice_buffer_update = true;
 
-  mt->need_chunk_data_update();
+  mt->dirty_regions().mark(chunk_index());
 }
 
 bool MapChunk::GetVertex(float x, float z, math::vector_3d *V)
@@ -643,8 +636,6 @@ void MapChunk::clearHeight()
   update_intersect_points();
 
   require_vertices_buffer_update();
-
-  mt->need_chunk_data_update();
 }
 
 bool MapChunk::is_visible ( const float& cull_distance
@@ -682,10 +673,15 @@ void MapChunk::update_visibility ( const float& cull_distance
   _lod_level = lod;
 }
 
+void MapChunk::require_vertices_buffer_update(noggit::vertex_range const& vertices)
+{
+  mt->dirty_regions().mark_vertices(chunk_index(), vertices);
+}
+
 void MapChunk::require_shader_data_update()
 {
   _shader_data_need_update = true;
-  mt->need_chunk_data_update();
+  mt->dirty_regions().mark(chunk_index());
 }
 
 void MapChunk::texture_set_changed()
@@ -700,6 +696,8 @@ void MapChunk::update_shader_data ( bool selected_texture_changed
                                   , std::string const& current_texture
                                   , std::map<int, misc::random_color>& area_id_colors
                                   , noggit::tileset_array_handler& tileset_handler
+                                  , noggit::tile_upload_functions const& upload
+                                  , noggit::upload_counters& uploads
                                   , bool force_update
                                   )
 {
@@ -714,7 +712,7 @@ void MapChunk::update_shader_data ( bool selected_texture_changed
     {
       if (!mt->use_no_alpha_alphamap())
       {
-        update_alpha_shadow_map();
+        update_alpha_shadow_map(upload, uploads);
       }
 
       for (int i = 0; i < texture_count; ++i)
@@ -748,7 +746,7 @@ void MapChunk::update_shader_data ( bool selected_texture_changed
     {
       if (!mt->use_no_alpha_alphamap())
       {
-        update_alpha_shadow_map();
+        update_alpha_shadow_map(upload, uploads);
       }
 
       for (int i = 0; i < texture_count; ++i)
@@ -810,6 +808,9 @@ void MapChunk::prepare_draw ( const math::vector_3d& camera
                             , noggit::tileset_array_handler& tileset_handler
                             , std::vector<void*>& indices_offsets
                             , std::vector<int>& indices_count
+                            , noggit::vertex_range const& vertices
+                            , noggit::tile_upload_functions const& upload
+                            , noggit::upload_counters& uploads
                             )
 {
   if (need_visibility_update || _need_lod_update)
@@ -831,6 +832,8 @@ void MapChunk::prepare_draw ( const math::vector_3d& camera
                       , current_texture
                       , area_id_colors
                       , tileset_handler
+                      , upload
+                      , uploads
                       );
   }
 
@@ -854,11 +857,13 @@ void MapChunk::prepare_draw ( const math::vector_3d& camera
     indices_count[chunk_index()] = _indices_count_per_lod_level[_lod_level];
   }
 
-  if (_need_vao_update)
-  {
-    gl.bufferSubData(GL_ARRAY_BUFFER, vertex_offset() * sizeof(chunk_vertex),  mapbufsize * sizeof(chunk_vertex), _preview_data ? _preview_data->vertices.data() : vertices.data());
-    _need_vao_update = false;
-  }
+  noggit::upload_vertices ( upload
+                          , uploads
+                          , vertex_offset()
+                          , vertices
+                          , sizeof(chunk_vertex)
+                          , _preview_data ? _preview_data->vertices.data() : this->vertices.data()
+                          );
 }
 
 void* MapChunk::lod_indices_ptr(int lod) const
@@ -880,39 +885,25 @@ void MapChunk::intersect (math::ray const& ray, selection_result* results, bool
     return;
   }
 
-  // regen indices when needed (only with fps camera so no need to keep them in memory all the time)
-  if(!ignore_terrain_holes && _indice_strips.empty())
-  {
-    initStrip();
-  }
-
-  std::vector<chunk_indice> const& indices = ignore_terrain_holes ? strip_without_holes : _indice_strips[0];
-  chunk_indice offset = ignore_terrain_holes ? 0 : vertex_offset();
-
-  for (int i (0); i < indices.size(); i += 3)
-  {
-    if ( auto distance = ray.intersect_triangle ( vertices[indices[i + 0] - offset].position
-                                                , vertices[indices[i + 1] - offset].position
-                                                , vertices[indices[i + 2] - offset].position
-                                                )
-       )
-    {
-      results->emplace_back
-        ( *distance
-        , selected_chunk_type
-            ( this
-            , std::make_tuple ( indices[i + 0] - offset
-                              , indices[i + 1] - offset
-                              , indices[i + 2] - offset
-                              )
-            , ray.position (*distance)
-            )
-        );
-    }
-  }
+  _height_quadtree.intersect
+    ( ray
+    , [&] (int vertex) -> math::vector_3d const& { return vertices[vertex].position; }
+    , [&] (int row, int column) { return !ignore_terrain_holes && isHole(column / 2, row / 2); }
+    , [&] (float distance, int a, int b, int c)
+      {
+        results->emplace_back
+          ( distance
+          , selected_chunk_type
+              ( this
+              , std::make_tuple (a, b, c)
+              , ray.position (distance)
+              )
+          );
+      }
+    );
 }
 
-void MapChunk::updateVerticesData()
+void MapChunk::updateVerticesData(noggit::vertex_range const& changed)
 {
   vmin.y = std::numeric_limits<float>::max();
   vmax.y = std::numeric_limits<float>::lowest();
@@ -930,60 +921,38 @@ void MapChunk::updateVerticesData()
   }
 
   update_intersect_points();
-  require_vertices_buffer_update();
+  require_vertices_buffer_update(changed);
 
   // update adt extents each time the min/max height of a chunk might have changed
   mt->chunk_height_changed();
 }
 
-void MapChunk::recalcNorms (std::function<boost::optional<float> (float, float)> height)
+void MapChunk::recalcNorms (noggit::chunk_normals const& normals)
 {
-  auto point
-  (
-    [&] (math::vector_3d& v, float xdiff, float zdiff)
-    {
-      return math::vector_3d
-             ( v.x + xdiff
-             , height (v.x + xdiff, v.z + zdiff).get_value_or (v.y)
-             , v.z + zdiff
-             );
-    }
-  );
+  std::array<math::vector_3d, mapbufsize> computed;
+  normals.compute (computed.data());
 
-  float const half_unit = UNITSIZE / 2.f;
+  // only the normals next to an edit change
+  noggit::vertex_range changed;
 
   for (int i = 0; i<mapbufsize; ++i)
   {
-    math::vector_3d const P1 (point(vertices[i].position, -half_unit, -half_unit));
-    math::vector_3d const P2 (point(vertices[i].position,  half_unit, -half_unit));
-    math::vector_3d const P3 (point(vertices[i].position,  half_unit,  half_unit));
-    math::vector_3d const P4 (point(vertices[i].position, -half_unit,  half_unit));
-
-    math::vector_3d const N1 ((P2 - vertices[i].position) % (P1 - vertices[i].position));
-    math::vector_3d const N2 ((P3 - vertices[i].position) % (P2 - vertices[i].position));
-    math::vector_3d const N3 ((P4 - vertices[i].position) % (P3 - vertices[i].position));
-    math::vector_3d const N4 ((P1 - vertices[i].position) % (P4 - vertices[i].position));
-
-    math::vector_3d Norm (N1 + N2 + N3 + N4);
-    Norm.normalize();
-
-    Norm.x = std::floor(Norm.x * 127) / 127;
-    Norm.y = std::floor(Norm.y * 127) / 127;
-    Norm.z = std::floor(Norm.z * 127) / 127;
-
     //! \todo: find out why recalculating normals without changing the terrain result in slightly different normals
-    vertices[i].normal = {-Norm.z, Norm.y, -Norm.x};
+    if (!(vertices[i].normal == computed[i]))
+    {
+      vertices[i].normal = computed[i];
+      changed.add(i);
+    }
   }
 
-   require_vertices_buffer_update();
-
-   mt->need_chunk_data_update();
+  require_vertices_buffer_update(changed);
 }
 
 bool MapChunk::changeTerrain(math::vector_3d const& pos, float change, float radius, int BrushType, float inner_radius, terrain_edit_mode edit_mode)
 {
   float dist, xdiff, zdiff;
   bool changed = false;
+  noggit::vertex_range changed_vertices;
 
   for (int i = 0; i < mapbufsize; ++i)
   {
@@ -1014,6 +983,7 @@ bool MapChunk::changeTerrain(math::vector_3d const& pos, float change, float rad
         dist = std::sqrt(xdiff*xdiff + zdiff*zdiff);
         vertices[i].position.y += change * (1.0f - dist * inner_radius / radius);
         changed = true;
+        changed_vertices.add(i);
       }
     }
     else
@@ -1022,6 +992,7 @@ bool MapChunk::changeTerrain(math::vector_3d const& pos, float change, float rad
       if (dist < radius)
       {
         changed = true;
+        changed_vertices.add(i);
 
         switch (BrushType)
         {
@@ -1054,7 +1025,7 @@ bool MapChunk::changeTerrain(math::vector_3d const& pos, float change, float rad
   }
   if (changed)
   {
-    updateVerticesData();
+    updateVerticesData(changed_vertices);
   }
   return changed;
 }
@@ -1087,9 +1058,12 @@ bool MapChunk::ChangeMCCV(math::vector_3d const& pos, math::vector_4d const& col
 {
   float dist;
   bool changed = false;
+  noggit::vertex_range changed_vertices;
 
   if (!_has_mccv)
   {
+    changed_vertices = noggit::vertex_range::whole();
+
     for (int i = 0; i < mapbufsize; ++i)
     {
       vertices[i].color.x = 1.0f; // set default shaders
@@ -1126,12 +1100,11 @@ bool MapChunk::ChangeMCCV(math::vector_3d const& pos, math::vector_4d const& col
       vertices[i].color.z = std::min(std::max(vertices[i].color.z, 0.0f), 2.0f);
 
       changed = true;
+      changed_vertices.add(i);
     }
   }
 
-  require_vertices_buffer_update();
-
-  mt->need_chunk_data_update();
+  require_vertices_buffer_update(changed_vertices);
 
   return changed;
 }
@@ -1172,6 +1145,7 @@ bool MapChunk::flattenTerrain ( math::vector_3d const& pos
                               )
 {
   bool changed (false);
+  noggit::vertex_range changed_vertices;
 
   for (int i(0); i < mapbufsize; ++i)
   {
@@ -1199,6 +1173,7 @@ bool MapChunk::flattenTerrain ( math::vector_3d const& pos
 	  {
 		  vertices[i].position.y = origin.y;
 		  changed = true;
+		  changed_vertices.add(i);
 		  continue;
 	  }
 
@@ -1212,11 +1187,12 @@ bool MapChunk::flattenTerrain ( math::vector_3d const& pos
       );
 
     changed = true;
+    changed_vertices.add(i);
   }
 
   if (changed)
   {
-    updateVerticesData();
+    updateVerticesData(changed_vertices);
   }
 
   return changed;
@@ -1231,6 +1207,7 @@ bool MapChunk::blurTerrain ( math::vector_3d const& pos
                            )
 {
   bool changed (false);
+  noggit::vertex_range changed_vertices;
 
   if (BrushType == eFlattenType_Origin)
   {
@@ -1285,11 +1262,12 @@ bool MapChunk::blurTerrain ( math::vector_3d const& pos
       );
 
     changed = true;
+    changed_vertices.add(i);
   }
 
   if (changed)
   {
-    updateVerticesData();
+    updateVerticesData(changed_vertices);
   }
 
   return changed;
@@ -1415,56 +1393,22 @@ void MapChunk::setFlag(bool changeto, uint32_t flag)
   require_shader_data_update();
 }
 
-void MapChunk::save( util::sExtendableArray &lADTFile
-                   , int &lCurrentPosition
-                   , int &lMCIN_Position
-                   , std::map<std::string, int> &lTextures
-                   , std::vector<WMOInstance> &lObjectInstances
-                   , std::vector<ModelInstance>& lModelInstances
-                   , bool use_mclq_liquids
-                   )
+noggit::adt::mcnk MapChunk::save_data( std::map<std::string, int> const& textures
+                                     , std::vector<WMOInstance> const& objects
+                                     , std::vector<ModelInstance> const& models
+                                     , bool use_mclq_liquids
+                                     )
 {
-  int lID;
-  int lMCNK_Size = 0x80;
-  int lMCNK_Position = lCurrentPosition;
-  lADTFile.Extend(8 + 0x80);  // This is only the size of the header. More chunks will increase the size.
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCNK', lMCNK_Size);
-  lADTFile.GetPointer<MCIN>(lMCIN_Position + 8)->mEntries[py * 16 + px].offset = lCurrentPosition; // check this
-
-                                                                                                   // MCNK data
-  lADTFile.Insert(lCurrentPosition + 8, 0x80, reinterpret_cast<char*>(&(header)));
-  auto const lMCNK_header = lADTFile.GetPointer<MapChunkHeader>(lCurrentPosition + 8);
+  noggit::adt::mcnk chunk;
 
   header.flags.flags.do_not_fix_alpha_map = use_mclq_liquids ? 0 : 1;
 
-  lMCNK_header->flags = header.flags;
-  lMCNK_header->holes = _4x4_holes;
-  lMCNK_header->areaid = _area_id;
-
-  lMCNK_header->nLayers = -1;
-  lMCNK_header->nDoodadRefs = -1;
-  lMCNK_header->ofsHeight = -1;
-  lMCNK_header->ofsNormal = -1;
-  lMCNK_header->ofsLayer = -1;
-  lMCNK_header->ofsRefs = -1;
-  lMCNK_header->ofsAlpha = -1;
-  lMCNK_header->sizeAlpha = -1;
-  lMCNK_header->ofsShadow = -1;
-  lMCNK_header->sizeShadow = -1;
-  lMCNK_header->nMapObjRefs = -1;
-  lMCNK_header->ofsMCCV = -1;
-
-  //! \todo  Implement sound emitter support. Or not.
-  lMCNK_header->ofsSndEmitters = 0;
-  lMCNK_header->nSndEmitters = 0;
-
-  lMCNK_header->ofsLiquid = 0;
-  //! \todo Is this still 8 if no chunk is present? Or did they correct that?
-  lMCNK_header->sizeLiquid = 8;
+  chunk.header = header;
+  chunk.header.holes = _4x4_holes;
+  chunk.header.areaid = _area_id;
+  chunk.header.ypos = vertices[0].position.y;
 
-  lMCNK_header->ypos = vertices[0].position.y;
-
-  memset(lMCNK_header->low_quality_texture_map, 0, 0x10);
+  memset(chunk.header.low_quality_texture_map, 0, 0x10);
 
   std::vector<uint8_t> lod_texture_map = texture_set->lod_texture_map();
 
@@ -1475,276 +1419,116 @@ void MapChunk::save( util::sExtendableArray &lADTFile
     // this means writing to the highest bits of the uint8 first
     const size_t bit_index((3 - ((i) % 4)) * 2);
 
-    lMCNK_header->low_quality_texture_map[array_index] |= ((lod_texture_map[i] & 3) << bit_index);
+    chunk.header.low_quality_texture_map[array_index] |= ((lod_texture_map[i] & 3) << bit_index);
   }
 
-  lCurrentPosition += 8 + 0x80;
-
   // MCVT
-  int lMCVT_Size = mapbufsize * 4;
-
-  lADTFile.Extend(8 + lMCVT_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCVT', lMCVT_Size);
-
-  auto header_ptr = lADTFile.GetPointer<MapChunkHeader>(lMCNK_Position + 8);
-
-  header_ptr->ofsHeight = lCurrentPosition - lMCNK_Position;
-
-  auto const lHeightmap = lADTFile.GetPointer<float>(lCurrentPosition + 8);
-
   for (int i = 0; i < mapbufsize; ++i)
-    lHeightmap[i] = vertices[i].position.y - vertices[0].position.y;
-
-  lCurrentPosition += 8 + lMCVT_Size;
-  lMCNK_Size += 8 + lMCVT_Size;
+    chunk.heights[i] = vertices[i].position.y - vertices[0].position.y;
 
   // MCCV
-  int lMCCV_Size = 0;
   if (_has_mccv)
   {
-    lMCCV_Size = mapbufsize * sizeof(unsigned int);
-    lADTFile.Extend(8 + lMCCV_Size);
-    SetChunkHeader(lADTFile, lCurrentPosition, 'MCCV', lMCCV_Size);
-    header_ptr->ofsMCCV = lCurrentPosition - lMCNK_Position;
-
-    auto const lmccv = lADTFile.GetPointer<unsigned int>(lCurrentPosition + 8);
+    chunk.vertex_colors.emplace();
 
     for (int i = 0; i < mapbufsize; ++i)
     {
-      lmccv[i] = (((unsigned char)(vertices[i].color.z * 127.0f) & 0xFF) << 0)
-               + (((unsigned char)(vertices[i].color.y * 127.0f) & 0xFF) <<  8)
-               + (((unsigned char)(vertices[i].color.x * 127.0f) & 0xFF) << 16);
+      (*chunk.vertex_colors)[i] = (((unsigned char)(vertices[i].color.z * 127.0f) & 0xFF) << 0)
+                                + (((unsigned char)(vertices[i].color.y * 127.0f) & 0xFF) <<  8)
+                                + (((unsigned char)(vertices[i].color.x * 127.0f) & 0xFF) << 16);
     }
-
-    lCurrentPosition += 8 + lMCCV_Size;
-    lMCNK_Size += 8 + lMCCV_Size;
-  }
-  else
-  {
-    header_ptr->ofsMCCV = 0;
   }
 
   // MCNR
-  int lMCNR_Size = mapbufsize * 3;
-
-  lADTFile.Extend(8 + lMCNR_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCNR', lMCNR_Size);
-
-  header_ptr->ofsNormal = lCurrentPosition - lMCNK_Position;
-
-  auto const lNormals = lADTFile.GetPointer<char>(lCurrentPosition + 8);
-
   for (int i = 0; i < mapbufsize; ++i)
   {
-    lNormals[i * 3 + 0] = static_cast<char>(vertices[i].normal.x * 127);
-    lNormals[i * 3 + 1] = static_cast<char>(vertices[i].normal.z * 127);
-    lNormals[i * 3 + 2] = static_cast<char>(vertices[i].normal.y * 127);
+    chunk.normals[i * 3 + 0] = static_cast<char>(vertices[i].normal.x * 127);
+    chunk.normals[i * 3 + 1] = static_cast<char>(vertices[i].normal.z * 127);
+    chunk.normals[i * 3 + 2] = static_cast<char>(vertices[i].normal.y * 127);
   }
 
-  lCurrentPosition += 8 + lMCNR_Size;
-  lMCNK_Size += 8 + lMCNR_Size;
-  //        }
-
-  // Unknown MCNR bytes
-  // These are not in as we have data or something but just to make the files more blizzlike.
-  //        {
-  lADTFile.Extend(13);
-  lCurrentPosition += 13;
-  lMCNK_Size += 13;
-  //        }
+  // MCLY and MCAL
+  chunk.alphamaps = texture_set->save_alpha(use_big_alphamap);
 
-  // MCLY
-  //        {
-  size_t lMCLY_Size = texture_set->num() * 0x10;
-
-  lADTFile.Extend(8 + lMCLY_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCLY', lMCLY_Size);
-
-  header_ptr->ofsLayer = lCurrentPosition - lMCNK_Position;
-  header_ptr->nLayers = texture_set->num();
-
-  std::vector<std::vector<uint8_t>> alphamaps = texture_set->save_alpha(use_big_alphamap);
-  int lMCAL_Size = 0;
-
-  // MCLY data
   for (size_t j = 0; j < texture_set->num(); ++j)
   {
-    auto const lLayer = lADTFile.GetPointer<ENTRY_MCLY>(lCurrentPosition + 8 + 0x10 * j);
+    ENTRY_MCLY layer;
 
-    lLayer->textureID = lTextures.find(texture_set->texture(j))->second;
-    lLayer->flags = texture_set->flag(j);
-    lLayer->ofsAlpha = lMCAL_Size;
-    lLayer->effectID = texture_set->effect(j);
+    layer.textureID = textures.find(texture_set->texture(j))->second;
+    layer.flags = texture_set->flag(j);
+    layer.effectID = texture_set->effect(j);
 
     if (j == 0)
     {
-      lLayer->flags &= ~(FLAG_USE_ALPHA | FLAG_ALPHA_COMPRESSED);
+      layer.flags &= ~(FLAG_USE_ALPHA | FLAG_ALPHA_COMPRESSED);
     }
     else
     {
-      lLayer->flags |= FLAG_USE_ALPHA;
+      layer.flags |= FLAG_USE_ALPHA;
       //! \todo find out why compression fuck up textures ingame
-      lLayer->flags &= ~FLAG_ALPHA_COMPRESSED;
-
-      lMCAL_Size += alphamaps[j - 1].size();
+      layer.flags &= ~FLAG_ALPHA_COMPRESSED;
     }
-  }
 
-  lCurrentPosition += 8 + lMCLY_Size;
-  lMCNK_Size += 8 + lMCLY_Size;
-  //        }
+    chunk.layers.push_back(layer);
+  }
 
   // MCRF
-  //        {
-  std::list<int> lDoodadIDs;
-  std::list<int> lObjectIDs;
-
   math::vector_3d lChunkExtents[2];
   lChunkExtents[0] = math::vector_3d(xbase, 0.0f, zbase);
   lChunkExtents[1] = math::vector_3d(xbase + CHUNKSIZE, 0.0f, zbase + CHUNKSIZE);
 
-  // search all wmos that are inside this chunk
-  lID = 0;
-  for(auto const& wmo : lObjectInstances)
+  // search all models that are inside this chunk
+  for (std::size_t id = 0; id < models.size(); ++id)
   {
-    if (wmo.isInsideRect(lChunkExtents))
+    if (models[id].isInsideRect(lChunkExtents))
     {
-      lObjectIDs.push_back(lID);
+      chunk.doodad_refs.push_back(id);
     }
-
-    lID++;
   }
 
-  // search all models that are inside this chunk
-  lID = 0;
-  for(auto const& model : lModelInstances)
+  // search all wmos that are inside this chunk
+  for (std::size_t id = 0; id < objects.size(); ++id)
   {
-    if (model.isInsideRect (lChunkExtents))
+    if (objects[id].isInsideRect(lChunkExtents))
     {
-      lDoodadIDs.push_back(lID);
+      chunk.object_refs.push_back(id);
     }
-    lID++;
-  }
-
-  int lMCRF_Size = 4 * (lDoodadIDs.size() + lObjectIDs.size());
-  lADTFile.Extend(8 + lMCRF_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCRF', lMCRF_Size);
-
-  header_ptr->ofsRefs = lCurrentPosition - lMCNK_Position;
-  header_ptr->nDoodadRefs = lDoodadIDs.size();
-  header_ptr->nMapObjRefs = lObjectIDs.size();
-
-  // MCRF data
-  auto const lReferences = lADTFile.GetPointer<int>(lCurrentPosition + 8);
-
-  lID = 0;
-  for (std::list<int>::iterator it = lDoodadIDs.begin(); it != lDoodadIDs.end(); ++it)
-  {
-    lReferences[lID] = *it;
-    lID++;
-  }
-
-  for (std::list<int>::iterator it = lObjectIDs.begin(); it != lObjectIDs.end(); ++it)
-  {
-    lReferences[lID] = *it;
-    lID++;
   }
 
-  lCurrentPosition += 8 + lMCRF_Size;
-  lMCNK_Size += 8 + lMCRF_Size;
-  //        }
-
   // MCSH
   if (!shadow_map_is_empty())
   {
     header.flags.flags.has_mcsh = 1;
 
-    int lMCSH_Size = 0x200;
-    lADTFile.Extend(8 + lMCSH_Size);
-    SetChunkHeader(lADTFile, lCurrentPosition, 'MCSH', lMCSH_Size);
-
-    header_ptr->ofsShadow = lCurrentPosition - lMCNK_Position;
-    header_ptr->sizeShadow = 0x200;
-
-    auto const lLayer = lADTFile.GetPointer<char>(lCurrentPosition + 8);
-
-    memcpy(lLayer.get(), _chunk_shadow->data.data(), 0x200);
-
-    lCurrentPosition += 8 + lMCSH_Size;
-    lMCNK_Size += 8 + lMCSH_Size;
+    chunk.shadow.emplace();
+    memcpy(chunk.shadow->data(), _chunk_shadow->data.data(), 0x200);
   }
   else
   {
     header.flags.flags.has_mcsh = 0;
-    header_ptr->ofsShadow = 0;
-    header_ptr->sizeShadow = 0;
   }
 
-  // MCAL
-  lADTFile.Extend(8 + lMCAL_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCAL', lMCAL_Size);
-
-  header_ptr->ofsAlpha = lCurrentPosition - lMCNK_Position;
-  header_ptr->sizeAlpha = 8 + lMCAL_Size;
-
-  auto lAlphaMaps = lADTFile.GetPointer<char>(lCurrentPosition + 8);
-
-  for (auto alpha : alphamaps)
-  {
-    memcpy(lAlphaMaps.get(), alpha.data(), alpha.size());
-    lAlphaMaps += alpha.size();
-  }
-
-  lCurrentPosition += 8 + lMCAL_Size;
-  lMCNK_Size += 8 + lMCAL_Size;
-
+  // MCLQ
   if (use_mclq_liquids)
   {
+    // no liquid, vanilla adt still have an empty chunk
+    chunk.liquids.emplace();
+
     auto liquids = liquid_chunk();
 
     if (liquids && liquids->displayed_layer_count() > 0)
     {
-      int liquids_size = 8 + liquids->displayed_layer_count() * sizeof(mclq);
-
-      lMCNK_Size += liquids_size;
-
-      header_ptr->sizeLiquid = liquids_size;
-      header_ptr->ofsLiquid = lCurrentPosition - lMCNK_Position;
-
-      // current position updated inside
-      liquids->save_mclq(lADTFile, lMCNK_Position, lCurrentPosition);
+      *chunk.liquids = liquids->save_mclq(chunk.header.flags);
     }
-    // no liquid, vanilla adt still have an empty chunk
-    else
-    {
-      lADTFile.Extend(8);
-      // size seems to be 0 in vanilla adts in the mclq chunk's header and set right in the mcnk header (layer_size * n_layer + 8)
-      SetChunkHeader(lADTFile, lCurrentPosition, 'MCLQ', 0);
-
-      header_ptr->sizeLiquid = 8;
-      header_ptr->ofsLiquid = lCurrentPosition - lMCNK_Position;
 
+    if (chunk.liquids->empty())
+    {
       // clear MCLQ liquid flags (0x4, 0x8, 0x10, 0x20)
-      header_ptr->flags.value &= 0xFFFFFFC3;
-
-      lCurrentPosition += 8;
-      lMCNK_Size += 8;
+      chunk.header.flags.value &= 0xFFFFFFC3;
     }
   }
 
-  // MCSE
-  int lMCSE_Size = 0;
-  lADTFile.Extend(8 + lMCSE_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCSE', lMCSE_Size);
-
-  header_ptr->ofsSndEmitters = lCurrentPosition - lMCNK_Position;
-  header_ptr->nSndEmitters = lMCSE_Size / 0x1C;
-
-  lCurrentPosition += 8 + lMCSE_Size;
-  lMCNK_Size += 8 + lMCSE_Size;
-
-  lADTFile.GetPointer<sChunkHeader>(lMCNK_Position)->mSize = lMCNK_Size;
-  lADTFile.GetPointer<MCIN>(lMCIN_Position + 8)->mEntries[py * 16 + px].size = lMCNK_Size + sizeof (sChunkHeader);
+  return chunk;
 }
 
 
@@ -1882,7 +1666,14 @@ liquid_chunk* MapChunk::liquid_chunk() const
   return mt->Water.getChunk(px, py);
 }
 
-void MapChunk::update_alpha_shadow_map()
+void MapChunk::update_alpha_shadow_map(noggit::tile_upload_functions const& upload, noggit::upload_counters& uploads)
+{
+  std::uint8_t* texels = mt->alpha_shadow_staging().texels(1);
+
+  noggit::upload_alpha_shadow_map(upload, uploads, chunk_index(), pack_alpha_shadow_map(texels), texels);
+}
+
+noggit::texel_rect MapChunk::pack_alpha_shadow_map(std::uint8_t* texels)
 {
   if (_preview_data)
   {
@@ -1903,10 +1694,10 @@ void MapChunk::update_alpha_shadow_map()
       }
     }
 
-    texture_set->update_alpha_shadow_map_if_needed(px, py, shadow, _preview_params->alphamaps ? _preview_data.get() : nullptr);
+    return texture_set->pack_alpha_shadow_map_if_needed(texels, shadow, _preview_params->alphamaps ? _preview_data.get() : nullptr);
   }
   else
   {
-    texture_set->update_alpha_shadow_map_if_needed(px, py, _chunk_shadow ? _chunk_shadow.get() : nullptr, nullptr);
+    return texture_set->pack_alpha_shadow_map_if_needed(texels, _chunk_shadow ? _chunk_shadow.get() : nullptr, nullptr);
   }
 }
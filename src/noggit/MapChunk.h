@@ -6,17 +6,19 @@
 
 #include <math/quaternion.hpp> // math::vector_4d
 #include <noggit/Misc.h>
+#include <noggit/adt_file.hpp>
+#include <noggit/chunk_height_quadtree.hpp>
 #include <noggit/ModelInstance.h>
 #include <noggit/Selection.h>
 #include <noggit/TextureManager.h>
 #include <noggit/WMOInstance.h>
 #include <noggit/map_enums.hpp>
 #include <noggit/texture_set.hpp>
+#include <noggit/tile_dirty_set.hpp>
 #include <noggit/tileset_array_handler.hpp>
 #include <noggit/tool_enums.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/texture.hpp>
-#include <util/sExtendableArray.hpp>
 
 #include <map>
 #include <memory>
@@ -35,6 +37,11 @@ class MapTile;
 namespace noggit
 {
   class chunk_data;
+  class chunk_normals;
+  namespace tile_cache
+  {
+    struct cached_chunk;
+  }
 }
 
 class MapChunk
@@ -59,8 +66,6 @@ class MapChunk
   }
 
 private:
-  static std::vector<chunk_indice> strip_without_holes; // it's always the same, no need to recreate it each time
-
   chunk_shader_data _shader_data;
   tile_mode _mode;
 
@@ -82,6 +87,7 @@ class MapChunk
   int indexLoD(int z, int x);
 
   std::vector<math::vector_3d> _intersect_points;
+  noggit::chunk_height_quadtree _height_quadtree;
 
   void update_intersect_points();
 
@@ -90,7 +96,6 @@ class MapChunk
   bool _uploaded = false;
   bool _need_indice_buffer_update = true;
   bool _need_lod_update = true;
-  bool _need_vao_update = true;
 
   bool _is_copied = false;
   bool _is_in_paste_zone = false;
@@ -98,7 +103,9 @@ class MapChunk
   std::unique_ptr<noggit::chunk_data> _preview_data;
   std::unique_ptr<noggit::chunk_override_params> _preview_params;
 public:
-  MapChunk(MapTile* mt, MPQFile* f, bool bigAlpha, tile_mode mode);
+  //! \a cached has the vertices and alphamaps as they are after
+  //! loading, which then aren't decoded from the file
+  MapChunk(MapTile* mt, MPQFile* f, bool bigAlpha, tile_mode mode, noggit::tile_cache::cached_chunk const* cached = nullptr);
   noggit::chunk_data get_chunk_data();
   void override_data(noggit::chunk_data& data, noggit::chunk_override_params const& params);
   void set_preview_data(noggit::chunk_data& data, noggit::chunk_override_params const& params);
@@ -148,7 +155,8 @@ class MapChunk
   bool _shader_data_need_update = true;
   bool _texture_set_need_update = true;
 public:
-  void require_vertices_buffer_update() { _need_vao_update = true; }
+  //! upload \a vertices again before the next draw
+  void require_vertices_buffer_update(noggit::vertex_range const& vertices = noggit::vertex_range::whole());
   void require_shader_data_update();
   void texture_set_changed();
 
@@ -156,9 +164,13 @@ class MapChunk
                           , std::string const& current_texture
                           , std::map<int, misc::random_color>& area_id_colors
                           , noggit::tileset_array_handler& tileset_handler
+                          , noggit::tile_upload_functions const& upload
+                          , noggit::upload_counters& uploads
                           , bool force_update = false
                           );
 
+  //! \a vertices are the ones edited since the last time, taken from
+  //! the tile's dirty_regions()
   void prepare_draw( const math::vector_3d& camera
                    , bool need_visibility_update
                    , bool selected_texture_changed
@@ -168,6 +180,9 @@ class MapChunk
                    , noggit::tileset_array_handler& tileset_handler
                    , std::vector<void*>& indices_offsets
                    , std::vector<int>& indices_count
+                   , noggit::vertex_range const& vertices
+                   , noggit::tile_upload_functions const& upload
+                   , noggit::upload_counters& uploads
                    );
 
   void intersect (math::ray const& ray, selection_result* results, bool ignore_terrain_holes);
@@ -180,8 +195,10 @@ class MapChunk
 
   liquid_chunk* liquid_chunk() const;
 
-  void updateVerticesData();
-  void recalcNorms (std::function<boost::optional<float> (float, float)> height);
+  //! after the heights of \a changed changed
+  void updateVerticesData(noggit::vertex_range const& changed = noggit::vertex_range::whole());
+  //! \a normals has to be gathered from the vertices of this chunk
+  void recalcNorms (noggit::chunk_normals const& normals);
 
   //! \todo implement Action stack for these
   bool changeTerrain(math::vector_3d const& pos, float change, float radius, int BrushType, float inner_radius, terrain_edit_mode edit_mode);
@@ -225,15 +242,13 @@ class MapChunk
 
   void clearHeight();
 
-  //! \todo this is ugly create a build struct or sth
-  void save( util::sExtendableArray &lADTFile
-           , int &lCurrentPosition
-           , int &lMCIN_Position
-           , std::map<std::string, int> &lTextures
-           , std::vector<WMOInstance> &lObjectInstances
-           , std::vector<ModelInstance>& lModelInstances
-           , bool use_mclq_liquids
-           );
+  //! What to write for this chunk, textures maps the tile's texture
+  //! names to their ids, objects and models are the tile's instances.
+  noggit::adt::mcnk save_data( std::map<std::string, int> const& textures
+                             , std::vector<WMOInstance> const& objects
+                             , std::vector<ModelInstance> const& models
+                             , bool use_mclq_liquids
+                             );
 
   // fix the gaps with the chunk to the left
   bool fixGapLeft(const MapChunk* chunk);
@@ -242,5 +257,8 @@ class MapChunk
 
   void selectVertex(math::vector_3d const& minPos, math::vector_3d const& maxPos, std::set<math::vector_3d*>& selected_vertices);
 
-  void update_alpha_shadow_map();
+  void update_alpha_shadow_map(noggit::tile_upload_functions const& upload, noggit::upload_counters& uploads);
+  //! the chunk's layer of the tile's alpha/shadow texture, and the part
+  //! of it that changed since the last time
+  noggit::texel_rect pack_alpha_shadow_map(std::uint8_t* texels);
 };
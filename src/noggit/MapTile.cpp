@@ -1,6 +1,8 @@
 // This file is part of Noggit3, licensed under GNU General Public License (version 3).
 
+#include <noggit/AsyncLoader.h>
 #include <noggit/Log.h>
+#include <noggit/MPQ.h>
 #include <noggit/MapChunk.h>
 #include <noggit/MapTile.h>
 #include <noggit/Misc.h>
@@ -10,22 +12,54 @@
 #include <noggit/settings.hpp>
 #include <noggit/WMOInstance.h> // WMOInstance
 #include <noggit/World.h>
+#include <noggit/adt_file.hpp>
 #include <noggit/alphamap.hpp>
+#include <noggit/job_scheduler.hpp>
 #include <noggit/map_index.hpp>
 #include <noggit/texture_set.hpp>
+#include <noggit/tile_cache.hpp>
+#include <noggit/tile_dirty_set.hpp>
 #include <noggit/tileset_array_handler.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/shader.hpp>
-#include <util/sExtendableArray.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
+namespace
+{
+  noggit::tile_upload_functions const& gl_upload_functions()
+  {
+    static noggit::tile_upload_functions const functions
+      { [] (std::size_t offset, std::size_t size, void const* data)
+        {
+          gl.bufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+        }
+      , [] (noggit::texel_rect const& rect, int layer, std::uint8_t const* texels)
+        {
+          opengl::texture::set_active_texture(0);
+          gl.pixelStorei(GL_UNPACK_ROW_LENGTH, noggit::texel_rect::side);
+          gl.texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, rect.x0, rect.y0, layer, rect.width(), rect.height(), 1, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+          gl.pixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+      };
+
+    return functions;
+  }
+}
+
 MapTile::MapTile( int pX
                 , int pZ
                 , std::string const& pFilename
@@ -48,6 +82,11 @@ MapTile::MapTile( int pX
   , _load_models(pLoadModels)
   , _world(world)
 {
+  // only for editing, the other modes rewrite the tiles anyway
+  if (_mode == tile_mode::edit && _load_models && NoggitSettings.editor().tile_cache)
+  {
+    _cache_file = boost::filesystem::path(NoggitSettings.editor().project_path) / "noggit_cache" / (filename + ".cache");
+  }
 }
 
 MapTile::~MapTile()
@@ -55,12 +94,70 @@ MapTile::~MapTile()
   _world->remove_models_if_needed(uids);
 }
 
+void MapTile::write_cache(noggit::tile_cache::source const& source)
+{
+  static_assert(sizeof(chunk_vertex) == sizeof(noggit::tile_cache::vertex), "chunk vertices are cached as they are");
+
+  auto contents(std::make_shared<noggit::tile_cache::tile_contents>());
+  contents->textures = mTextureFilenames;
+  contents->models = mModelFilenames;
+  contents->objects = mWMOFilenames;
+  contents->chunks.resize(256);
+
+  for (std::size_t i = 0; i < 256; ++i)
+  {
+    MapChunk const& chunk(*mChunks[i / 16][i % 16]);
+    noggit::tile_cache::chunk_contents& cached(contents->chunks[i]);
+
+    std::memcpy(cached.vertices.data(), chunk.vertices.data(), sizeof(cached.vertices));
+    cached.min_height = chunk.vmin.y;
+    cached.max_height = chunk.vmax.y;
+
+    for (std::size_t layer = 1; layer < chunk.texture_set->num(); ++layer)
+    {
+      if (std::uint8_t const* alphamap = chunk.texture_set->alphamap(layer))
+      {
+        cached.alphamaps[layer - 1].assign(alphamap, alphamap + noggit::tile_cache::alphamap_size);
+      }
+    }
+  }
+
+  // off the loading thread, a tile without cache loads like it always did
+  noggit::compute_scheduler().schedule
+    ( [cache_file = _cache_file, source, contents]
+      {
+        if (!noggit::tile_cache::write(cache_file, source, *contents))
+        {
+          LogError << "Could not write the editor cache " << cache_file.string() << std::endl;
+        }
+      }
+    , 1
+    );
+}
+
 void MapTile::finishLoading()
 {
   MPQFile theFile(filename);
 
   NOGGIT_LOG << "Opening tile " << index.x << ", " << index.z << " (\"" << filename << "\") from " << (theFile.isExternal() ? "disk" : "MPQ") << "." << std::endl;
 
+  // - Editor cache --------------------------------------
+
+  // what's decoded from the file can come from the tile's cache instead
+  boost::optional<noggit::tile_cache::source> cache_source;
+  boost::optional<noggit::tile_cache::cached_tile> cache;
+
+  if (!_cache_file.empty())
+  {
+    cache_source = noggit::tile_cache::identify(theFile.shared_buffer().get(), theFile.getSize(), mBigAlpha);
+    cache = noggit::tile_cache::cached_tile::open(_cache_file, *cache_source);
+
+    if (cache && cache->chunk_count() != 256)
+    {
+      cache.reset();
+    }
+  }
+
   // - Parsing the file itself. --------------------------
 
   // We store this data to load it at the end.
@@ -116,6 +213,11 @@ void MapTile::finishLoading()
 
   assert(fourcc == 'MTEX');
 
+  if (cache)
+  {
+    mTextureFilenames = cache->textures();
+  }
+  else
   {
     char const* lCurPos = reinterpret_cast<char const*>(theFile.getPointer());
     char const* lEnd = lCurPos + size;
@@ -137,6 +239,11 @@ void MapTile::finishLoading()
 
     assert(fourcc == 'MMDX');
 
+    if (cache)
+    {
+      mModelFilenames = cache->models();
+    }
+    else
     {
       char const* lCurPos = reinterpret_cast<char const*>(theFile.getPointer());
       char const* lEnd = lCurPos + size;
@@ -156,6 +263,11 @@ void MapTile::finishLoading()
 
     assert(fourcc == 'MWMO');
 
+    if (cache)
+    {
+      mWMOFilenames = cache->objects();
+    }
+    else
     {
       char const* lCurPos = reinterpret_cast<char const*>(theFile.getPointer());
       char const* lEnd = lCurPos + size;
@@ -292,14 +404,25 @@ void MapTile::finishLoading()
 
   // - Load chunks ---------------------------------------
 
-  for (int nextChunk = 0; nextChunk < 256; ++nextChunk)
-  {
-    theFile.seek(lMCNKOffsets[nextChunk]);
-    mChunks[nextChunk / 16][nextChunk % 16] = std::make_unique<MapChunk> (this, &theFile, mBigAlpha, _mode);
-  }
+  // the chunks only read their own part of the file, each through its
+  // own position in it
+  noggit::compute_scheduler().parallel_for
+    ( 0, 256
+    , [&] (std::size_t nextChunk)
+      {
+        MPQFile chunkFile(theFile, lMCNKOffsets[nextChunk]);
+        mChunks[nextChunk / 16][nextChunk % 16] = std::make_unique<MapChunk>
+          (this, &chunkFile, mBigAlpha, _mode, cache ? &cache->chunk(nextChunk) : nullptr);
+      }
+    );
 
   theFile.close();
 
+  if (cache_source && !cache)
+  {
+    write_cache(*cache_source);
+  }
+
   // no or one texture only means we don't need to generate an alphamap bigger than 1x1 per layer
   if (mTextureFilenames.size() <= 1)
   {
@@ -322,6 +445,33 @@ bool MapTile::isTile(int pX, int pZ)
   return pX == index.x && pZ == index.z;
 }
 
+std::size_t MapTile::estimated_memory_usage() const
+{
+  std::size_t bytes (sizeof (MapTile));
+
+  for (auto const& row : mChunks)
+  {
+    for (auto const& chunk : row)
+    {
+      if (!chunk)
+      {
+        continue;
+      }
+
+      // the chunk with its vertices, their copy in the tile's vertex
+      // buffer, its rgba8 alpha/shadow layer and the alphamaps kept for
+      // editing
+      bytes += sizeof (MapChunk) + sizeof (chunk->vertices) + 64 * 64 * 4;
+      if (chunk->texture_set)
+      {
+        bytes += chunk->texture_set->num() * 64 * 64;
+      }
+    }
+  }
+
+  return bytes;
+}
+
 void MapTile::convert_alphamap(bool to_big_alpha)
 {
   if (mBigAlpha != to_big_alpha)
@@ -351,6 +501,7 @@ void MapTile::draw ( math::frustum const& frustum
                    , std::map<int, misc::random_color>& area_id_colors
                    , display_mode display
                    , noggit::tileset_array_handler& tileset_handler
+                   , noggit::upload_counters& uploads
                    )
 {
   if (!finished)
@@ -366,7 +517,7 @@ void MapTile::draw ( math::frustum const& frustum
   if (need_visibility_update || _need_visibility_update)
   {
     update_visibility(cull_distance, frustum, camera, display);
-    _need_chunk_data_update = true;
+    _dirty.mark_all();
   }
 
   if (!_is_visible)
@@ -408,7 +559,7 @@ void MapTile::draw ( math::frustum const& frustum
       opengl::texture::set_active_texture(0);
     }
 
-    _need_chunk_data_update = true;
+    _dirty.mark_all();
   }
 
   _adt_alphamap.bind();
@@ -416,29 +567,35 @@ void MapTile::draw ( math::frustum const& frustum
   gl.bindBufferBase(GL_UNIFORM_BUFFER, 0, _chunks_data_ubo);
   gl.bindVertexArray(_vao);
 
-  if (_need_chunk_data_update || selected_texture_changed)
+  if (selected_texture_changed)
+  {
+    _dirty.mark_all();
+  }
+
+  // only the chunks edited since the last frame, and of those only what
+  // was edited is uploaded
+  if (!_dirty.empty())
   {
     gl.bindBuffer(GL_ARRAY_BUFFER, _vertices_vbo);
     gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices_vbo);
 
-    for (int z = 0; z < 16; ++z)
-    {
-      for (int x = 0; x < 16; ++x)
-      {
-        mChunks[z][x]->prepare_draw( camera
-                                   , need_visibility_update
-                                   , selected_texture_changed
-                                   , current_texture
-                                   , area_id_colors
-                                   , display
-                                   , tileset_handler
-                                   , _indices_offsets
-                                   , _indices_count
-                                   );
-      }
-    }
-
-    _need_chunk_data_update = false;
+    _dirty.drain ( [&] (std::size_t chunk, noggit::vertex_range const& vertices)
+                   {
+                     mChunks[chunk / 16][chunk % 16]->prepare_draw( camera
+                                                                  , need_visibility_update
+                                                                  , selected_texture_changed
+                                                                  , current_texture
+                                                                  , area_id_colors
+                                                                  , display
+                                                                  , tileset_handler
+                                                                  , _indices_offsets
+                                                                  , _indices_count
+                                                                  , vertices
+                                                                  , gl_upload_functions()
+                                                                  , uploads
+                                                                  );
+                   }
+                 );
   }
 
   gl.multiDrawElements(GL_TRIANGLES, _indices_count.data(), GL_UNSIGNED_SHORT, _indices_offsets.data(), 256);
@@ -621,18 +778,48 @@ bool MapTile::GetVertex(float x, float z, math::vector_3d *V)
 
 void MapTile::saveTile(World* world)
 {
-  save(world, false);
+  noggit::file_save_batch batch (noggit::compute_scheduler());
+  queue_save (batch, world);
+  batch.wait_serialized();
+  batch.wait();
 
-  if (NoggitSettings.value("use_mclq_liquids_export", false).toBool())
+  for (auto const& failure : batch.failures())
   {
-    save(world, true);
+    LogError << "Saving ADT \"" << failure.first << "\" failed: " << failure.second << std::endl;
   }
 }
 
-void MapTile::save(World* world, bool save_using_mclq_liquids)
+std::size_t MapTile::queue_save (noggit::file_save_batch& batch, World* world)
 {
   NOGGIT_LOG << "Saving ADT \"" << filename << "\"." << std::endl;
 
+  boost::filesystem::path const destination (MPQFile::disk_path (filename));
+  boost::optional<boost::filesystem::path> mclq_destination;
+
+  noggit::editor_settings const& settings(NoggitSettings.editor());
+  if (settings.use_mclq_liquids_export)
+  {
+    mclq_destination = boost::filesystem::path (settings.mclq_liquids_path)
+      / noggit::mpq::normalized_filename (filename);
+  }
+
+  // both variants in the same job: serializing updates the chunks
+  return batch.add ( filename
+                   , [this, world, destination, mclq_destination]
+                     {
+                       std::vector<noggit::serialized_file> files;
+                       files.push_back ({destination, serialize (world, false)});
+                       if (mclq_destination)
+                       {
+                         files.push_back ({*mclq_destination, serialize (world, true)});
+                       }
+                       return files;
+                     }
+                   );
+}
+
+std::vector<char> MapTile::serialize(World* world, bool save_using_mclq_liquids)
+{
   int lID;  // This is a global counting variable. Do not store something in here you need later.
   std::vector<WMOInstance> lObjectInstances;
   std::vector<ModelInstance> lModelInstances;
@@ -650,6 +837,7 @@ void MapTile::save(World* world, bool save_using_mclq_liquids)
     if (!model)
     {
       // todo: save elsewhere if this happens ? it shouldn't but still
+      std::lock_guard<std::mutex> const lock (AsyncLoader::instance->log_guard());
       LogError << "Could not fine model with uid=" << uid << " when saving " << filename << std::endl;
     }
     else
@@ -668,10 +856,9 @@ void MapTile::save(World* world, bool save_using_mclq_liquids)
   struct filenameOffsetThing
   {
     int nameID;
-    int filenamePosition;
   };
 
-  filenameOffsetThing nullyThing = { 0, 0 };
+  filenameOffsetThing nullyThing = { 0 };
 
   std::map<std::string, filenameOffsetThing> lModels;
 
@@ -726,135 +913,33 @@ void MapTile::save(World* world, bool save_using_mclq_liquids)
   for (auto& texture : lTextures)
     texture.second = lID++;
 
-  // Now write the file.
-  util::sExtendableArray lADTFile;
-
-  int lCurrentPosition = 0;
-
-  // MVER
-  lADTFile.Extend(8 + 0x4);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MVER', 4);
-
-  // MVER data
-  *(lADTFile.GetPointer<int>(8)) = 18;
-  lCurrentPosition += 8 + 0x4;
-
-  // MHDR
-  int lMHDR_Position = lCurrentPosition;
-  lADTFile.Extend(8 + 0x40);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MHDR', 0x40);
-
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->flags = mFlags;
+  // Now gather what to write.
+  noggit::adt::tile lADT;
 
-  lCurrentPosition += 8 + 0x40;
+  lADT.flags = mFlags;
 
-
-  // MCIN
-  int lMCIN_Position = lCurrentPosition;
-
-  lADTFile.Extend(8 + 256 * 0x10);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MCIN', 256 * 0x10);
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mcin = lCurrentPosition - 0x14;
-
-  lCurrentPosition += 8 + 256 * 0x10;
-
-  // MTEX
-  int lMTEX_Position = lCurrentPosition;
-  lADTFile.Extend(8 + 0);  // We don't yet know how big this will be.
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MTEX');
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mtex = lCurrentPosition - 0x14;
-
-  lCurrentPosition += 8 + 0;
-
-  // MTEX data
   for (auto const& texture : lTextures)
   {
-    lADTFile.Insert(lCurrentPosition, texture.first.size() + 1, texture.first.c_str());
-
-    lCurrentPosition += texture.first.size() + 1;
-    lADTFile.GetPointer<sChunkHeader>(lMTEX_Position)->mSize += texture.first.size() + 1;
+    lADT.textures.push_back(texture.first);
+    std::lock_guard<std::mutex> const lock (AsyncLoader::instance->log_guard());
     LogDebug << "Added texture \"" << texture.first << "\"." << std::endl;
   }
 
-  // MMDX
-  int lMMDX_Position = lCurrentPosition;
-  lADTFile.Extend(8 + 0);  // We don't yet know how big this will be.
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MMDX');
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mmdx = lCurrentPosition - 0x14;
-
-  lCurrentPosition += 8 + 0;
-
-  // MMDX data
-  for (auto it = lModels.begin(); it != lModels.end(); ++it)
-  {
-    it->second.filenamePosition = lADTFile.GetPointer<sChunkHeader>(lMMDX_Position)->mSize;
-    lADTFile.Insert(lCurrentPosition, it->first.size() + 1, misc::normalize_adt_filename(it->first).c_str());
-    lCurrentPosition += it->first.size() + 1;
-    lADTFile.GetPointer<sChunkHeader>(lMMDX_Position)->mSize += it->first.size() + 1;
-    LogDebug << "Added model \"" << it->first << "\"." << std::endl;
-  }
-
-  // MMID
-  // M2 model names
-  int lMMID_Size = 4 * lModels.size();
-  lADTFile.Extend(8 + lMMID_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MMID', lMMID_Size);
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mmid = lCurrentPosition - 0x14;
-
-  // MMID data
-  // WMO model names
-  auto const lMMID_Data = lADTFile.GetPointer<int>(lCurrentPosition + 8);
-
-  lID = 0;
   for (auto const& model : lModels)
   {
-    lMMID_Data[lID] = model.second.filenamePosition;
-    lID++;
+    lADT.models.push_back(misc::normalize_adt_filename(model.first));
+    std::lock_guard<std::mutex> const lock (AsyncLoader::instance->log_guard());
+    LogDebug << "Added model \"" << model.first << "\"." << std::endl;
   }
-  lCurrentPosition += 8 + lMMID_Size;
 
-  // MWMO
-  int lMWMO_Position = lCurrentPosition;
-  lADTFile.Extend(8 + 0);  // We don't yet know how big this will be.
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MWMO');
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mwmo = lCurrentPosition - 0x14;
-
-  lCurrentPosition += 8 + 0;
-
-  // MWMO data
-  for (auto& object : lObjects)
+  for (auto const& object : lObjects)
   {
-    object.second.filenamePosition = lADTFile.GetPointer<sChunkHeader>(lMWMO_Position)->mSize;
-    lADTFile.Insert(lCurrentPosition, object.first.size() + 1, misc::normalize_adt_filename(object.first).c_str());
-    lCurrentPosition += object.first.size() + 1;
-    lADTFile.GetPointer<sChunkHeader>(lMWMO_Position)->mSize += object.first.size() + 1;
+    lADT.objects.push_back(misc::normalize_adt_filename(object.first));
+    std::lock_guard<std::mutex> const lock (AsyncLoader::instance->log_guard());
     LogDebug << "Added object \"" << object.first << "\"." << std::endl;
   }
 
-  // MWID
-  int lMWID_Size = 4 * lObjects.size();
-  lADTFile.Extend(8 + lMWID_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MWID', lMWID_Size);
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mwid = lCurrentPosition - 0x14;
-
-  // MWID data
-  auto const lMWID_Data = lADTFile.GetPointer<int>(lCurrentPosition + 8);
-
-  lID = 0;
-  for (auto const& object : lObjects)
-    lMWID_Data[lID++] = object.second.filenamePosition;
-
-  lCurrentPosition += 8 + lMWID_Size;
-
   // MDDF
-  int lMDDF_Size = 0x24 * lModelInstances.size();
-  lADTFile.Extend(8 + lMDDF_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MDDF', lMDDF_Size);
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mddf = lCurrentPosition - 0x14;
-
-  // MDDF data
-  auto const lMDDF_Data = lADTFile.GetPointer<ENTRY_MDDF>(lCurrentPosition + 8);
-
   if(world->mapIndex.sort_models_by_size_class())
   {
     std::sort(lModelInstances.begin(), lModelInstances.end(), [](ModelInstance const& m1, ModelInstance const& m2)
@@ -863,156 +948,108 @@ void MapTile::save(World* world, bool save_using_mclq_liquids)
     });
   }
 
-  lID = 0;
+  lADT.doodads.reserve(lModelInstances.size());
+
   for (auto const& model : lModelInstances)
   {
     auto filename_to_offset_and_name = lModels.find(model.model->filename);
     if (filename_to_offset_and_name == lModels.end())
     {
-      LogError << "There is a problem with saving the doodads. We have a doodad that somehow changed the name during the saving function. However this got produced, you can get a reward from schlumpf by pasting him this line." << std::endl;
-      return;
+      throw std::logic_error ("There is a problem with saving the doodads. We have a doodad that somehow changed the name during the saving function. However this got produced, you can get a reward from schlumpf by pasting him this line.");
     }
 
-    lMDDF_Data[lID].nameID = filename_to_offset_and_name->second.nameID;
-    lMDDF_Data[lID].uniqueID = model.uid;
-    lMDDF_Data[lID].pos[0] = model.pos.x;
-    lMDDF_Data[lID].pos[1] = model.pos.y;
-    lMDDF_Data[lID].pos[2] = model.pos.z;
-    lMDDF_Data[lID].rot[0] = model.dir.x._;
-    lMDDF_Data[lID].rot[1] = model.dir.y._;
-    lMDDF_Data[lID].rot[2] = model.dir.z._;
-    lMDDF_Data[lID].scale = (uint16_t)(model.scale * 1024);
-    lMDDF_Data[lID].flags = 0;
-    lID++;
+    ENTRY_MDDF entry;
+    entry.nameID = filename_to_offset_and_name->second.nameID;
+    entry.uniqueID = model.uid;
+    entry.pos[0] = model.pos.x;
+    entry.pos[1] = model.pos.y;
+    entry.pos[2] = model.pos.z;
+    entry.rot[0] = model.dir.x._;
+    entry.rot[1] = model.dir.y._;
+    entry.rot[2] = model.dir.z._;
+    entry.scale = (uint16_t)(model.scale * 1024);
+    entry.flags = 0;
+    lADT.doodads.push_back(entry);
   }
 
-  lCurrentPosition += 8 + lMDDF_Size;
-
-  LogDebug << "Added " << lID << " doodads to MDDF" << std::endl;
+  {
+    std::lock_guard<std::mutex> const lock (AsyncLoader::instance->log_guard());
+    LogDebug << "Added " << lADT.doodads.size() << " doodads to MDDF" << std::endl;
+  }
 
   // MODF
-  int lMODF_Size = 0x40 * lObjectInstances.size();
-  lADTFile.Extend(8 + lMODF_Size);
-  SetChunkHeader(lADTFile, lCurrentPosition, 'MODF', lMODF_Size);
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->modf = lCurrentPosition - 0x14;
+  lADT.wmos.reserve(lObjectInstances.size());
 
-  // MODF data
-  auto const lMODF_Data = lADTFile.GetPointer<ENTRY_MODF>(lCurrentPosition + 8);
-
-  lID = 0;
   for (auto const& object : lObjectInstances)
   {
     auto filename_to_offset_and_name = lObjects.find(object.wmo->filename);
     if (filename_to_offset_and_name == lObjects.end())
     {
-      LogError << "There is a problem with saving the objects. We have an object that somehow changed the name during the saving function. However this got produced, you can get a reward from schlumpf by pasting him this line." << std::endl;
-      return;
+      throw std::logic_error ("There is a problem with saving the objects. We have an object that somehow changed the name during the saving function. However this got produced, you can get a reward from schlumpf by pasting him this line.");
     }
 
-    lMODF_Data[lID].nameID = filename_to_offset_and_name->second.nameID;
-    lMODF_Data[lID].uniqueID = object.mUniqueID;
-    lMODF_Data[lID].pos[0] = object.pos.x;
-    lMODF_Data[lID].pos[1] = object.pos.y;
-    lMODF_Data[lID].pos[2] = object.pos.z;
-    lMODF_Data[lID].rot[0] = object.dir.x._;
-    lMODF_Data[lID].rot[1] = object.dir.y._;
-    lMODF_Data[lID].rot[2] = object.dir.z._;
-
-    lMODF_Data[lID].extents[0][0] = object.extents[0].x;
-    lMODF_Data[lID].extents[0][1] = object.extents[0].y;
-    lMODF_Data[lID].extents[0][2] = object.extents[0].z;
-
-    lMODF_Data[lID].extents[1][0] = object.extents[1].x;
-    lMODF_Data[lID].extents[1][1] = object.extents[1].y;
-    lMODF_Data[lID].extents[1][2] = object.extents[1].z;
-
-    lMODF_Data[lID].flags = object.mFlags;
-    lMODF_Data[lID].doodadSet = object.doodadset();
-    lMODF_Data[lID].nameSet = object.mNameset;
-    lMODF_Data[lID].unknown = object.mUnknown;
-    lID++;
+    ENTRY_MODF entry;
+    entry.nameID = filename_to_offset_and_name->second.nameID;
+    entry.uniqueID = object.mUniqueID;
+    entry.pos[0] = object.pos.x;
+    entry.pos[1] = object.pos.y;
+    entry.pos[2] = object.pos.z;
+    entry.rot[0] = object.dir.x._;
+    entry.rot[1] = object.dir.y._;
+    entry.rot[2] = object.dir.z._;
+
+    entry.extents[0][0] = object.extents[0].x;
+    entry.extents[0][1] = object.extents[0].y;
+    entry.extents[0][2] = object.extents[0].z;
+
+    entry.extents[1][0] = object.extents[1].x;
+    entry.extents[1][1] = object.extents[1].y;
+    entry.extents[1][2] = object.extents[1].z;
+
+    entry.flags = object.mFlags;
+    entry.doodadSet = object.doodadset();
+    entry.nameSet = object.mNameset;
+    entry.unknown = object.mUnknown;
+    lADT.wmos.push_back(entry);
   }
 
-  LogDebug << "Added " << lID << " wmos to MODF" << std::endl;
-
-  lCurrentPosition += 8 + lMODF_Size;
+  {
+    std::lock_guard<std::mutex> const lock (AsyncLoader::instance->log_guard());
+    LogDebug << "Added " << lADT.wmos.size() << " wmos to MODF" << std::endl;
+  }
 
   //MH2O
   if (!save_using_mclq_liquids)
   {
-    Water.saveToFile(lADTFile, lMHDR_Position, lCurrentPosition);
+    lADT.water = Water.save();
   }
 
   // MCNK
+  lADT.chunks.reserve(16 * 16);
+
   for (int y = 0; y < 16; ++y)
   {
     for (int x = 0; x < 16; ++x)
     {
-      mChunks[y][x]->save(lADTFile, lCurrentPosition, lMCIN_Position, lTextures, lObjectInstances, lModelInstances, save_using_mclq_liquids);
+      lADT.chunks.push_back(mChunks[y][x]->save_data(lTextures, lObjectInstances, lModelInstances, save_using_mclq_liquids));
     }
   }
 
   // MFBO
   if (mFlags & 1)
   {
-    size_t chunkSize = sizeof(int16_t) * 9 * 2;
-    lADTFile.Extend(8 + chunkSize);
-    SetChunkHeader(lADTFile, lCurrentPosition, 'MFBO', chunkSize);
-    lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mfbo = lCurrentPosition - 0x14;
-
-    auto const lMFBO_Data = lADTFile.GetPointer<int16_t>(lCurrentPosition + 8);
-
-    lID = 0;
+    lADT.flight_bounds.emplace();
 
     for (int i = 0; i < 9; ++i)
-      lMFBO_Data[lID++] = (int16_t)mMaximumValues[i].y;
+      (*lADT.flight_bounds)[i] = (int16_t)mMaximumValues[i].y;
 
     for (int i = 0; i < 9; ++i)
-      lMFBO_Data[lID++] = (int16_t)mMinimumValues[i].y;
-
-    lCurrentPosition += 8 + chunkSize;
+      (*lADT.flight_bounds)[9 + i] = (int16_t)mMinimumValues[i].y;
   }
 
   //! \todo Do not do bullshit here in MTFX.
-#if 0
-  if (!mTextureEffects.empty()) {
-    //! \todo check if nTexEffects == nTextures, correct order etc.
-    lADTFile.Extend(8 + 4 * mTextureEffects.size());
-    SetChunkHeader(lADTFile, lCurrentPosition, 'MTFX', 4 * mTextureEffects.size());
-    lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mtfx = lCurrentPosition - 0x14;
-
-    auto const lMTFX_Data = lADTFile.GetPointer<uint32_t>(lCurrentPosition + 8);
-
-    lID = 0;
-    //they should be in the correct order...
-    for (auto const& effect : mTextureEffects)
-    {
-      lMTFX_Data[lID] = effect;
-      ++lID;
-    }
-    lCurrentPosition += 8 + sizeof(uint32_t) * mTextureEffects.size();
-  }
-#endif
-
-  {
-    MPQFile f(filename);
-    // \todo This sounds wrong. There shouldn't *be* unused nulls to
-    // begin with.
-    f.setBuffer(lADTFile.data_up_to (lCurrentPosition)); // cleaning unused nulls at the end of file
 
-    if (save_using_mclq_liquids)
-    {
-      f.save_file_to_folder(NoggitSettings.value("project/mclq_liquids_path").toString().toStdString());
-    }
-    else
-    {
-      f.SaveFile();
-    }
-  }
-
-  lObjectInstances.clear();
-  lModelInstances.clear();
-  lModels.clear();
+  return noggit::adt::write(lADT);
 }
 
 
@@ -1087,13 +1124,41 @@ void MapTile::create_combined_alpha_shadow_map()
     }
 
 
+    // pack all the chunks at once and upload the consecutive ones in a
+    // single call, the staging memory is only needed that long
+    std::uint8_t* texels = _alpha_shadow_staging.texels(256);
+    std::array<bool, 256> packed;
+
     for (size_t i = 0; i < 16; i++)
     {
       for (size_t j = 0; j < 16; j++)
       {
-        mChunks[i][j]->update_alpha_shadow_map();
+        MapChunk* chunk = mChunks[i][j].get();
+        int const layer = chunk->px + 16 * chunk->py;
+
+        packed[layer] = !chunk->pack_alpha_shadow_map(texels + layer * noggit::alpha_shadow_map_bytes).empty();
       }
     }
+
+    for (int first = 0; first < 256;)
+    {
+      if (!packed[first])
+      {
+        ++first;
+        continue;
+      }
+
+      int last = first;
+      while (last + 1 < 256 && packed[last + 1])
+      {
+        ++last;
+      }
+
+      gl.texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, first, 64, 64, last - first + 1, GL_RGBA, GL_UNSIGNED_BYTE, texels + first * noggit::alpha_shadow_map_bytes);
+      first = last + 1;
+    }
+
+    _alpha_shadow_staging.release();
   }
 
   _alphamap_created = true;
@@ -1112,6 +1177,8 @@ void MapTile::upload()
   {
     _indices_offsets.push_back(static_cast<char*>(0) + i * MapChunk::total_indices_count_with_lods() * sizeof(chunk_indice));
     _indices_count.push_back(mChunks[i / 16][i % 16]->current_lod_indices_count());
+    // the buffer was just created, all of it has to be filled
+    _dirty.mark_vertices(i, noggit::vertex_range::whole());
   }
 
   _uploaded = true;
@@ -3,17 +3,24 @@
 #pragma once
 
 #include <math/ray.hpp>
+#include <noggit/alpha_shadow_map.hpp>
 #include <noggit/map_enums.hpp>
 #include <noggit/MapChunk.h>
 #include <noggit/MapHeaders.h>
 #include <noggit/Selection.h>
+#include <noggit/file_save_batch.hpp>
 #include <noggit/liquid_tile.hpp>
+#include <noggit/tile_cache.hpp>
+#include <noggit/tile_dirty_set.hpp>
 #include <noggit/tile_index.hpp>
 #include <noggit/tileset_array_handler.hpp>
 #include <noggit/tool_enums.hpp>
 #include <opengl/shader.fwd.hpp>
 #include <noggit/Misc.h>
 
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
@@ -68,6 +75,7 @@ class MapTile : public AsyncObject
             , std::map<int, misc::random_color>& area_id_colors
             , display_mode display
             , noggit::tileset_array_handler& tileset_handler
+            , noggit::upload_counters& uploads
             );
   void intersect (math::ray const& ray, selection_result* results, bool ignore_terrain_holes);
   void intersect_liquids (math::ray const&, selection_result*);
@@ -91,14 +99,22 @@ class MapTile : public AsyncObject
 	void CropWater();
 
   void saveTile(World* world);
+  //! Add this tile's file(s) to batch and return their index in it. The
+  //! tile is serialized on batch's workers and must not be changed until
+  //! batch.wait_serialized() returned.
+  std::size_t queue_save (noggit::file_save_batch& batch, World* world);
 
 private:
-  void save(World* world, bool save_using_mclq_liquids);
+  std::vector<char> serialize (World* world, bool save_using_mclq_liquids);
 
 public:
 
   bool isTile(int pX, int pZ);
 
+  //! Rough bytes the loaded tile takes on the cpu and gpu, models and
+  //! textures it shares with other tiles aside.
+  std::size_t estimated_memory_usage() const;
+
   virtual async_priority loading_priority() const
   {
     return async_priority::high;
@@ -117,10 +133,15 @@ class MapTile : public AsyncObject
   bool tile_is_being_reloaded() const { return _tile_is_being_reloaded; }
   bool use_no_alpha_alphamap() const { return _use_no_alpha_alphamap; }
   void require_regular_alphamap();
+  //! where the chunks pack their alpha/shadow maps before uploading them
+  noggit::alpha_shadow_staging& alpha_shadow_staging() { return _alpha_shadow_staging; }
 private:
   opengl::texture_array _adt_alphamap;
-  bool _use_no_alpha_alphamap = false;
-  bool _alphamap_created = false;
+  noggit::alpha_shadow_staging _alpha_shadow_staging;
+  // the flags below are set by chunk edits, which may run on several
+  // chunks of the tile at once
+  std::atomic<bool> _use_no_alpha_alphamap = {false};
+  std::atomic<bool> _alphamap_created = {false};
   void create_combined_alpha_shadow_map();
 
   void upload();
@@ -128,20 +149,23 @@ class MapTile : public AsyncObject
 public:
   // todo: store extent for each part and only update the relevant one and then update the "global" extents
   void water_height_changed() { _need_recalc_extents = true; }
-  void chunk_height_changed() { _need_recalc_extents = true; _need_visibility_update = true; _need_chunk_data_update = true; }
-  void need_chunk_data_update() { _need_chunk_data_update = true; }
+  void chunk_height_changed() { _need_recalc_extents = true; _need_visibility_update = true; }
+  //! every chunk has to be prepared for drawing again
+  void need_chunk_data_update() { _dirty.mark_all(); }
+  //! the chunks and vertices to upload before the next draw
+  noggit::tile_dirty_set& dirty_regions() { return _dirty; }
 
   bool is_visible() const { return _is_visible; }
 private:
-  bool _need_chunk_data_update = true;
+  noggit::tile_dirty_set _dirty;
 
   std::array<math::vector_3d, 2> extents;
   std::vector<math::vector_3d> _intersect_points;
 
-  bool _need_recalc_extents = true;
+  std::atomic<bool> _need_recalc_extents = {true};
   void recalc_extents();
 
-  bool _need_visibility_update = true;
+  std::atomic<bool> _need_visibility_update = {true};
   bool _is_visible = false;
 
   void update_visibility( const float& cull_distance
@@ -153,6 +177,10 @@ class MapTile : public AsyncObject
   tile_mode _mode;
   bool _tile_is_being_reloaded;
 
+  //! where this tile's tile_cache goes, empty if none is used
+  boost::filesystem::path _cache_file;
+  void write_cache(noggit::tile_cache::source const& source);
+
   // MFBO:
   math::vector_3d mMinimumValues[3 * 3];
   math::vector_3d mMaximumValues[3 * 3];
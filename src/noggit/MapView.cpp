@@ -54,6 +54,7 @@
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QMenuBar>
 #include <QtWidgets/QMessageBox>
+#include <QtWidgets/QProgressDialog>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QStatusBar>
 #include <QtWidgets/QComboBox>
@@ -1850,12 +1851,15 @@ void MapView::tick (float dt)
 	_mod_num_down = QApplication::keyboardModifiers().testFlag(Qt::KeypadModifier);
 
 
-  // start unloading tiles
-  _world->mapIndex.enterTile (tile_index (_camera.position));
-  _world->mapIndex.unloadTiles (tile_index (_camera.position));
-
   dt = std::min(dt, 1.0f);
 
+  _world->mapIndex.update_streaming
+    ( _camera.position
+    , _camera.direction()
+    , std::atan (std::tan (_camera.fov()._ * 0.5f) * aspect_ratio())
+    , dt
+    );
+
   if (_locked_cursor_mode.get())
   {
     switch (terrainMode)
@@ -1873,7 +1877,7 @@ void MapView::tick (float dt)
     update_cursor_pos();
   }
 
-  if (_tablet_active && NoggitSettings.value ("tablet/enabled", false).toBool())
+  if (_tablet_active && NoggitSettings.editor().tablet)
   {
     switch (terrainMode)
     {
@@ -2015,14 +2019,15 @@ void MapView::tick (float dt)
             if (_rotate_along_ground_random.get())
             {
               float minX = 0, maxX = 0, minY = 0, maxY = 0, minZ = 0, maxZ = 0;
+              noggit::editor_settings const& settings (NoggitSettings.editor());
 
-              if (NoggitSettings.value("model/random_rotation", false).toBool())
+              if (settings.random_rotation)
               {
                 minY = _object_paste_params.minRotation;
                 maxY = _object_paste_params.maxRotation;
               }
 
-              if (NoggitSettings.value("model/random_tilt", false).toBool())
+              if (settings.random_tilt)
               {
                 minX = _object_paste_params.minTilt;
                 maxX = _object_paste_params.maxTilt;
@@ -2032,7 +2037,7 @@ void MapView::tick (float dt)
 
               _world->rotate_selected_models_randomly(minX, maxX, minY, maxY, minZ, maxZ);
 
-              if (NoggitSettings.value("model/random_size", false).toBool())
+              if (settings.random_size)
               {
                 float min = _object_paste_params.minScale;
                 float max = _object_paste_params.maxScale;
@@ -2421,12 +2426,15 @@ void MapView::tick (float dt)
                         )
       / qreal (_last_frame_durations.size())
       );
+    qreal const avg_terrain_upload (_terrain_upload_bytes / qreal (_last_frame_durations.size()));
     _status_fps->setText ( "FPS: " + QString::number (int (1. / avg_frame_duration))
                          + " - Average frame time: " + QString::number(avg_frame_duration*1000.0) + "ms"
+                         + " - Terrain upload: " + QString::number(avg_terrain_upload / 1024.0, 'f', 1) + "KiB/frame"
                          );
     _status_model_instances->setText(QString::number(_world->model_instance_count()) + " model instances");
 
     _last_frame_durations.clear();
+    _terrain_upload_bytes = 0;
     _last_fps_update = 0.f;
   }
 
@@ -2735,7 +2743,7 @@ math::matrix_4x4 MapView::model_view(bool use_debug_cam) const
 }
 math::matrix_4x4 MapView::projection() const
 {
-  float far_z = NoggitSettings.value("view_distance", 2048).toFloat();
+  float far_z = NoggitSettings.editor().view_distance;
 
   if (_display_mode == display_mode::in_2D)
   {
@@ -2861,6 +2869,8 @@ void MapView::draw_map()
 
   // reset after each world::draw call
   _camera_moved_since_last_draw = false;
+
+  _terrain_upload_bytes += _world->terrain_uploads().bytes;
 }
 
 void MapView::keyPressEvent (QKeyEvent *event)
@@ -3493,17 +3503,34 @@ void MapView::save(save_mode mode)
     makeCurrent();
     opengl::context::scoped_setter const _ (::gl, context());
 
+    // only shows up when writing the files takes a while. Serializing
+    // the tiles doesn't run the event loop, so neither the dialog nor
+    // the update timer get to run before the files are being written.
+    QProgressDialog progress ("Saving map...", "Cancel", 0, 0, this);
+    progress.setWindowModality (Qt::WindowModal);
+    progress.setMinimumDuration (500);
+
+    auto const on_progress
+      ( [&] (noggit::file_save_batch::progress const& state)
+        {
+          progress.setMaximum (static_cast<int> (state.total));
+          progress.setValue (static_cast<int> (state.saved + state.failed + state.cancelled));
+          return !progress.wasCanceled();
+        }
+      );
+
     switch (mode)
     {
     case save_mode::current: _world->mapIndex.saveTile(tile_index(_camera.position), _world.get()); break;
-    case save_mode::changed: _world->mapIndex.saveChanged(_world.get()); break;
-    case save_mode::all:     _world->mapIndex.saveall(_world.get()); break;
+    case save_mode::changed: _world->mapIndex.saveChanged(_world.get(), on_progress); break;
+    case save_mode::all:     _world->mapIndex.saveall(_world.get(), on_progress); break;
     }
 
     AsyncLoader::instance->reset_object_fail();
 
 
-    _main_window->statusBar()->showMessage("Map saved", 2000);
+    _main_window->statusBar()->showMessage
+      (progress.wasCanceled() ? "Saving cancelled, the remaining tiles are still unsaved" : "Map saved", 2000);
 
   }
   else
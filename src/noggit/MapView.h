@@ -248,6 +248,8 @@ public slots:
   int _target_frametime;
   qreal _last_update = 0.f;
   std::list<qreal> _last_frame_durations;
+  //! uploaded by the terrain over the frames of _last_frame_durations
+  std::size_t _terrain_upload_bytes = 0;
 
   float _last_fps_update = 0.f;
 
@@ -196,13 +196,6 @@ namespace misc
   }
 }
 
-void SetChunkHeader(util::sExtendableArray& pArray, int pPosition, int pMagix, int pSize)
-{
-  auto const Header = pArray.GetPointer<sChunkHeader>(pPosition);
-  Header->mMagic = pMagix;
-  Header->mSize = pSize;
-}
-
 bool pointInside(math::vector_3d point, math::vector_3d extents[2])
 {
   minmax(&extents[0], &extents[1]);
@@ -7,7 +7,6 @@
 #include <math/vector_3d.hpp>
 #include <math/vector_4d.hpp>
 #include <noggit/Log.h>
-#include <util/sExtendableArray.hpp>
 
 #include <algorithm>
 #include <cassert>
@@ -117,13 +116,5 @@ namespace misc
 
 //! \todo collect all lose functions/classes/structs for now, sort them later
 
-struct sChunkHeader
-{
-  int mMagic;
-  int mSize;
-};
-
-void SetChunkHeader(util::sExtendableArray& pArray, int pPosition, int pMagix, int pSize = 0);
-
 bool pointInside(math::vector_3d point, math::vector_3d extents[2]);
 void minmax(math::vector_3d* a, math::vector_3d* b);
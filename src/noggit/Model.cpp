@@ -7,6 +7,7 @@
 #include <noggit/ModelInstance.h>
 #include <noggit/TextureManager.h> // TextureManager, Texture
 #include <noggit/World.h>
+#include <noggit/bone_animation.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/shader.hpp>
 
@@ -151,6 +152,26 @@ void Model::finishLoading()
 
   f.close();
 
+  {
+    std::vector<uint16_t> triangles;
+
+    for (auto const& pass : _render_passes)
+    {
+      auto const first (_indices.begin() + std::min<std::size_t> (pass.index_start, _indices.size()));
+      triangles.insert (triangles.end(), first, first + std::min<std::size_t> (pass.index_count, _indices.end() - first));
+    }
+
+    // animated geometry is only known once animated, start from the bind pose
+    auto const& vertices (animGeometry ? _vertices : _current_vertices);
+    _picking_bvh = noggit::triangle_bvh
+      (triangles, [&] (std::uint32_t vertex) -> math::vector_3d const& { return vertices[vertex].position; });
+  }
+
+  if (animGeometry)
+  {
+    _skinning = noggit::model_skinning (_vertices);
+  }
+
   finished = true;
   _state_changed.notify_all();
 }
@@ -1168,6 +1189,13 @@ void Model::initAnimated(const MPQFile& f)
     {
       bones.emplace_back(f, mb[i], _global_sequences.data(), animation_files);
     }
+
+    std::vector<int> parents;
+    for (auto const& bone : bones)
+    {
+      parents.push_back (bone.parent);
+    }
+    _bone_order = noggit::parent_first_order (parents);
   }
 
   if (animTextures)
@@ -1222,11 +1250,7 @@ void Model::calcBones( math::matrix_4x4 const& model_view
                      , int animation_time
                      )
 {
-  for (size_t i = 0; i<header.nBones; ++i) {
-    bones[i].calc = false;
-  }
-
-  for (size_t i = 0; i<header.nBones; ++i) {
+  for (std::size_t i : _bone_order) {
     bones[i].calcMatrix(model_view, bones.data(), _anim, time, animation_time);
   }
 }
@@ -1239,9 +1263,8 @@ void Model::animate(math::matrix_4x4 const& model_view, int anim_id, int anim_ti
     if (_current_vertices.empty())
     {
       _current_vertices = _vertices;
-
-      opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder(_vertices_buffer);
-      gl.bufferData(GL_ARRAY_BUFFER, _current_vertices.size() * sizeof(ModelVertex), _current_vertices.data(), GL_STATIC_DRAW);
+      _picking_bvh_outdated = true;
+      _current_vertices_outdated = true;
     }
 
     return;
@@ -1276,31 +1299,23 @@ void Model::animate(math::matrix_4x4 const& model_view, int anim_id, int anim_ti
 
   if (animGeometry)
   {
-    // transform vertices
-    _current_vertices = _vertices;
-
-    for (auto& vertex : _current_vertices)
+    // only positions and normals change, the rest stays the bind pose's
+    if (_current_vertices.size() != _vertices.size())
     {
-      ::math::vector_3d v(0, 0, 0), n(0, 0, 0);
-
-      for (size_t b (0); b < 4; ++b)
-      {
-        if (vertex.weights[b] <= 0)
-          continue;
-
-        ::math::vector_3d tv = bones[vertex.bones[b]].mat * vertex.position;
-        ::math::vector_3d tn = bones[vertex.bones[b]].mrot * vertex.normal;
-
-        v += tv * (static_cast<float> (vertex.weights[b]) / 255.0f);
-        n += tn * (static_cast<float> (vertex.weights[b]) / 255.0f);
-      }
+      _current_vertices = _vertices;
+    }
+    _picking_bvh_outdated = true;
 
-      vertex.position = v;
-      vertex.normal = n.normalized();
+    _bone_matrices.resize (bones.size(), math::matrix_4x4::unit);
+    _bone_normal_matrices.resize (bones.size(), math::matrix_4x4::unit);
+    for (std::size_t i (0); i < bones.size(); ++i)
+    {
+      _bone_matrices[i] = bones[i].mat;
+      _bone_normal_matrices[i] = bones[i].mrot;
     }
 
-    opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder (_vertices_buffer);
-    gl.bufferData (GL_ARRAY_BUFFER, _current_vertices.size() * sizeof (ModelVertex), _current_vertices.data(), GL_STREAM_DRAW);
+    _skinning.skin (_bone_matrices, _bone_normal_matrices, _current_vertices.data());
+    _current_vertices_outdated = true;
   }
 
   for (size_t i=0; i<header.nLights; ++i)
@@ -1330,6 +1345,39 @@ void Model::animate(math::matrix_4x4 const& model_view, int anim_id, int anim_ti
   }
 }
 
+void Model::prepare_animation(math::matrix_4x4 const& model_view, int animtime)
+{
+  if (!finishedLoading() || loading_failed())
+  {
+    return;
+  }
+
+  // billboarded models depend on the camera of the draw, which animates
+  // them again anyway
+  if (animated && !animcalc && !_per_instance_animation)
+  {
+    animate(model_view, 0, animtime);
+    animcalc = true;
+  }
+}
+
+void Model::upload_animated_vertices()
+{
+  if (!_current_vertices_outdated)
+  {
+    return;
+  }
+
+  opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const binder (_vertices_buffer);
+  gl.bufferData ( GL_ARRAY_BUFFER
+                , _current_vertices.size() * sizeof (ModelVertex)
+                , _current_vertices.data()
+                , animGeometry ? GL_STREAM_DRAW : GL_STATIC_DRAW
+                );
+
+  _current_vertices_outdated = false;
+}
+
 void TextureAnim::calc(int anim, int time, int animtime)
 {
   mat = math::matrix_4x4::unit;
@@ -1427,8 +1475,6 @@ void Bone::calcMatrix( math::matrix_4x4 const& model_view
                      , int animtime
                      )
 {
-  if (calc) return;
-
   math::matrix_4x4 m {math::matrix_4x4::unit};
   math::quaternion q;
 
@@ -1439,44 +1485,29 @@ void Bone::calcMatrix( math::matrix_4x4 const& model_view
     || flags.cylindrical_billboard_lock_z
       )
   {
-    m = {math::matrix_4x4::translation, pivot};
-
-    if (trans.uses(anim))
-    {
-      m *= math::matrix_4x4 (math::matrix_4x4::translation, trans.getValue (anim, time, animtime));
-    }
-
     if (rot.uses(anim))
     {
-      m *= math::matrix_4x4 (math::matrix_4x4::rotation, q = rot.getValue (anim, time, animtime));
+      q = rot.getValue (anim, time, animtime);
     }
 
-    if (scale.uses(anim))
-    {
-      m *= math::matrix_4x4 (math::matrix_4x4::scale, scale.getValue (anim, time, animtime));
-    }
+    // pivot * translation * rotation * scale * -pivot
+    m = noggit::affine_transform ( trans.uses(anim) ? pivot + trans.getValue (anim, time, animtime) : pivot
+                                 , q
+                                 , scale.uses(anim) ? scale.getValue (anim, time, animtime) : math::vector_3d (1.0f, 1.0f, 1.0f)
+                                 );
 
     if (flags.billboard)
     {
-      math::vector_3d vRight (model_view[0], model_view[4], model_view[8]);
-      math::vector_3d vUp (model_view[1], model_view[5], model_view[9]); // Spherical billboarding
-      //math::vector_3d vUp = math::vector_3d(0,1,0); // Cylindrical billboarding
-      vRight = vRight * -1;
-      m (0, 2, vRight.x);
-      m (1, 2, vRight.y);
-      m (2, 2, vRight.z);
-      m (0, 1, vUp.x);
-      m (1, 1, vUp.y);
-      m (2, 1, vUp.z);
+      noggit::billboard (m, model_view);
     }
 
-    m *= math::matrix_4x4 (math::matrix_4x4::translation, -pivot);
+    noggit::affine_translate (m, -pivot);
   }
 
+  // the parent has already been calculated, see Model::calcBones()
   if (parent >= 0)
   {
-    allbones[parent].calcMatrix (model_view, allbones, anim, time, animtime);
-    mat = allbones[parent].mat * m;
+    mat = noggit::affine_product (allbones[parent].mat, m);
   }
   else
   {
@@ -1488,7 +1519,7 @@ void Bone::calcMatrix( math::matrix_4x4 const& model_view
   {
     if (parent >= 0)
     {
-      mrot = allbones[parent].mrot * math::matrix_4x4 (math::matrix_4x4::rotation, q);
+      mrot = noggit::affine_product (allbones[parent].mrot, math::matrix_4x4 (math::matrix_4x4::rotation, q));
     }
     else
     {
@@ -1499,8 +1530,6 @@ void Bone::calcMatrix( math::matrix_4x4 const& model_view
   {
     mrot = math::matrix_4x4::unit;
   }
-
-  calc = true;
 }
 
 void Model::draw( math::matrix_4x4 const& model_view
@@ -1558,6 +1587,8 @@ void Model::draw( math::matrix_4x4 const& model_view
     animcalc = true;
   }
 
+  upload_animated_vertices();
+
   opengl::scoped::vao_binder const _ (_vao);
 
   m2_shader.uniform("transform", instance.transform_matrix_transposed());
@@ -1578,19 +1609,14 @@ void Model::draw( math::matrix_4x4 const& model_view
 }
 
 void Model::draw ( math::matrix_4x4 const& model_view
-                 , std::vector<ModelInstance*> instances
+                 , std::vector<math::matrix_4x4> const* visible_transforms
                  , opengl::scoped::use_program& m2_shader
-                 , math::frustum const& frustum
-                 , const float& cull_distance
-                 , const math::vector_3d& camera
                  , bool // draw_fog
                  , int animtime
                  , bool draw_particles
                  , bool all_boxes
                  , std::unordered_map<Model*, std::size_t>& models_with_particles
                  , std::unordered_map<Model*, std::size_t>& model_boxes_to_draw
-                 , display_mode display
-                 , bool update_transform_matrix_buffer
                  , noggit::texture_array_handler& texture_handler
                  , opengl_model_state_changer& ogl_state
                  )
@@ -1632,27 +1658,20 @@ void Model::draw ( math::matrix_4x4 const& model_view
     return;
   }
 
+  // World::draw animates the visible models beforehand (see
+  // prepare_animation), this catches the ones it did not know of and
+  // the billboarded ones, which need this draw's model_view
   if (animated && (!animcalc || (_per_instance_animation && draw_particles)))
   {
     animate(model_view, 0, animtime);
     animcalc = true;
   }
 
-  std::vector<math::matrix_4x4> transform_matrix;
+  upload_animated_vertices();
 
-  if (update_transform_matrix_buffer || _need_transform_buffer_update)
+  if (visible_transforms)
   {
-    transform_matrix.reserve(instances.size());
-
-    for (ModelInstance* mi : instances)
-    {
-      if (mi->is_visible(frustum, cull_distance, camera, display))
-      {
-        transform_matrix.push_back(mi->transform_matrix_transposed());
-      }
-    }
-
-    _instance_visible = transform_matrix.size();
+    _instance_visible = visible_transforms->size();
   }
 
   if (_instance_visible == 0)
@@ -1673,10 +1692,16 @@ void Model::draw ( math::matrix_4x4 const& model_view
 
   opengl::scoped::vao_binder const _ (_vao);
 
-  if (update_transform_matrix_buffer || _need_transform_buffer_update)
+  if (visible_transforms)
   {
     opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const transform_binder (_transform_buffer);
-    gl.bufferData(GL_ARRAY_BUFFER, _instance_visible * sizeof(::math::matrix_4x4), transform_matrix.data(), GL_STATIC_DRAW);
+
+    if (_transform_buffer_capacity < visible_transforms->size())
+    {
+      _transform_buffer_capacity = visible_transforms->size() + visible_transforms->size() / 2;
+      gl.bufferData(GL_ARRAY_BUFFER, _transform_buffer_capacity * sizeof(::math::matrix_4x4), nullptr, GL_DYNAMIC_DRAW);
+    }
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, _instance_visible * sizeof(::math::matrix_4x4), visible_transforms->data());
 
     _need_transform_buffer_update = false;
   }
@@ -1784,21 +1809,27 @@ std::vector<float> Model::intersect (math::matrix_4x4 const& model_view, math::r
     return results;
   }
 
-  for (auto&& pass : _render_passes)
-  {
-    for (size_t i (pass.index_start); i < pass.index_start + pass.index_count; i += 3)
-    {
-      if ( auto distance
-          = ray.intersect_triangle( _current_vertices[_indices[i + 0]].position,
-                                    _current_vertices[_indices[i + 1]].position,
-                                    _current_vertices[_indices[i + 2]].position)
-          )
+  auto const position
+    ( [&] (std::uint32_t vertex) -> math::vector_3d const&
       {
-        results.emplace_back (*distance);
+        return _current_vertices[vertex].position;
       }
-    }
+    );
+
+  if (_picking_bvh_outdated)
+  {
+    _picking_bvh.refit (position);
+    _picking_bvh_outdated = false;
   }
 
+  _picking_bvh.intersect ( ray
+                         , position
+                         , [&] (float distance, std::uint32_t)
+                           {
+                             results.emplace_back (distance);
+                           }
+                         );
+
   return results;
 }
 
@@ -11,9 +11,11 @@
 #include <noggit/AsyncObject.h> // AsyncObject
 #include <noggit/MPQ.h>
 #include <noggit/ModelHeaders.h>
+#include <noggit/model_skinning.hpp>
 #include <noggit/Particle.h>
 #include <noggit/texture_array_handler.hpp>
 #include <noggit/tool_enums.hpp>
+#include <noggit/triangle_bvh.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/shader.fwd.hpp>
 
@@ -74,7 +76,7 @@ class Bone {
   math::matrix_4x4 mat = math::matrix_4x4::uninitialized;
   math::matrix_4x4 mrot = math::matrix_4x4::uninitialized;
 
-  bool calc;
+  //! the parent's matrices have to be calculated already
   void calcMatrix( math::matrix_4x4 const& model_view
                  , Bone* allbones
                  , int anim
@@ -277,20 +279,18 @@ class Model : public AsyncObject
            , noggit::texture_array_handler& texture_handler
            , opengl_model_state_changer& ogl_state
            );
+  //! \a visible_transforms are the transposed transforms of the visible
+  //! instances (see noggit::instance_culling), null to draw the same
+  //! instances as the last time
   void draw ( math::matrix_4x4 const& model_view
-            , std::vector<ModelInstance*> instances
+            , std::vector<math::matrix_4x4> const* visible_transforms
             , opengl::scoped::use_program& m2_shader
-            , math::frustum const& frustum
-            , const float& cull_distance
-            , const math::vector_3d& camera
             , bool draw_fog
             , int animtime
             , bool draw_particles
             , bool all_boxes
             , std::unordered_map<Model*, std::size_t>& models_with_particles
             , std::unordered_map<Model*, std::size_t>& model_boxes_to_draw
-            , display_mode display
-            , bool update_transform_matrix_buffer
             , noggit::texture_array_handler& texture_handler
             , opengl_model_state_changer& ogl_state
             );
@@ -310,6 +310,12 @@ class Model : public AsyncObject
 
   void updateEmitters(float dt);
 
+  //! CPU side of animate() if the model has not been animated since the
+  //! last resetAnim, for the simulate phase before drawing. Touches only
+  //! this model, so different models can be prepared on different
+  //! threads. The vertices get uploaded by the next draw.
+  void prepare_animation(math::matrix_4x4 const& model_view, int animtime);
+
   virtual void finishLoading();
 
   bool is_hidden() const { return _hidden; }
@@ -324,6 +330,7 @@ class Model : public AsyncObject
   }
 
   void require_transform_buffer_update() { _need_transform_buffer_update = true; }
+  bool need_transform_buffer_update() const { return _need_transform_buffer_update; }
 
   // ===============================
   // Toggles
@@ -371,6 +378,7 @@ class Model : public AsyncObject
   void compute_pixel_shader_ids();
 
   void animate(math::matrix_4x4 const& model_view, int anim_id, int anim_time);
+  void upload_animated_vertices();
   void calcBones(math::matrix_4x4 const& model_view, int anim, int time, int animation_time);
 
   void lightsOn(opengl::light lbase);
@@ -380,6 +388,8 @@ class Model : public AsyncObject
 
   bool _finished_upload;
   bool _need_transform_buffer_update = true;
+  // in instances, the buffer only gets reallocated when it has to grow
+  std::size_t _transform_buffer_capacity = 0;
 
   std::vector<math::vector_3d> _vertex_box_points;
 
@@ -401,12 +411,26 @@ class Model : public AsyncObject
 
   std::vector<ModelVertex> _vertices;
   std::vector<ModelVertex> _current_vertices;
+  // animate() changed _current_vertices, upload them before drawing
+  bool _current_vertices_outdated = false;
 
   std::vector<uint16_t> _indices;
 
   std::vector<ModelRenderPass> _render_passes;
   boost::optional<FakeGeometry> _fake_geometry;
 
+  // bones' indices, parents before their children
+  std::vector<std::size_t> _bone_order;
+
+  // bind pose of animated geometry, and the bones' matrices to skin it
+  noggit::model_skinning _skinning;
+  std::vector<math::matrix_4x4> _bone_matrices;
+  std::vector<math::matrix_4x4> _bone_normal_matrices;
+
+  // over the render passes' triangles, refit after animating the vertices
+  noggit::triangle_bvh _picking_bvh;
+  bool _picking_bvh_outdated = false;
+
   // ===============================
   // Animation
   // ===============================
@@ -4,6 +4,7 @@
 #include <noggit/Log.h> // LogDebug
 #include <noggit/Model.h> // Model
 #include <noggit/ModelManager.h> // ModelManager
+#include <noggit/parallel_simulation.hpp>
 
 #include <algorithm>
 
@@ -51,11 +52,23 @@ void ModelManager::resetAnim()
 
 void ModelManager::updateEmitters(float dt)
 {
+  std::vector<Model*> models;
   _.apply ( [&] (std::string const&, Model& model)
             {
-              model.updateEmitters (dt);
+              models.push_back (&model);
             }
           );
+
+  // in steps of at most 0.1s so that long frames don't burst particles
+  noggit::simulate_parallel ( noggit::compute_scheduler()
+                            , models
+                            , dt
+                            , 0.1f
+                            , [] (Model& model, float step)
+                              {
+                                model.updateEmitters (step);
+                              }
+                            );
 }
 
 void ModelManager::clear_hidden_models()
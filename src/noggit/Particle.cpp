@@ -5,17 +5,12 @@
 #include <opengl/context.hpp>
 #include <opengl/shader.hpp>
 
+#include <cstdlib>
 #include <list>
+#include <random>
 
 static const unsigned int MAX_PARTICLES = 10000;
 
-template<class T>
-T lifeRamp(float life, float mid, const T &a, const T &b, const T &c)
-{
-  if (life <= mid) return math::interpolation::linear(life / mid, a, b);
-  else return math::interpolation::linear((life - mid) / (1.0f - mid), b, c);
-}
-
 ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParticleEmitterDef &mta, int *globals)
   : model (model_)
   , emitter_type(mta.EmitterType)
@@ -38,6 +33,7 @@ ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParti
   , slowdown (mta.p.slowdown)
   , pos (fixCoordSystem(mta.pos))
   , _texture_id (mta.texture)
+  , particles (MAX_PARTICLES)
   , blend (mta.blend)
   , order (mta.ParticleType > 0 ? -1 : 0)
   , type (mta.ParticleType)
@@ -49,6 +45,7 @@ ParticleSystem::ParticleSystem(Model* model_, const MPQFile& f, const ModelParti
   , rem(0)
   , parent (&model->bones[mta.bone])
   , flags(mta.flags)
+  , _random (static_cast<unsigned int> (std::rand()))
   , tofs (misc::frand())
 {
   math::vector_3d colors2[3];
@@ -107,6 +104,8 @@ ParticleSystem::ParticleSystem(ParticleSystem const& other)
   , rem(other.rem)
   , parent(other.parent)
   , flags(other.flags)
+  // a copy drawing the same numbers would emit exactly the same particles
+  , _random (static_cast<unsigned int> (std::rand()))
   , tofs(other.tofs)
 {
 
@@ -147,6 +146,7 @@ ParticleSystem::ParticleSystem(ParticleSystem&& other)
   , rem(other.rem)
   , parent(other.parent)
   , flags(other.flags)
+  , _random(other._random)
   , tofs(other.tofs)
 {
 
@@ -196,8 +196,8 @@ void ParticleSystem::update(float dt)
     else {
       int tospawn = (int)ftospawn;
 
-      if ((tospawn + particles.size()) > MAX_PARTICLES) // Error check to prevent the program from trying to load insane amounts of particles.
-        tospawn = particles.size() - MAX_PARTICLES;
+      if ((tospawn + particles.size()) > particles.capacity()) // Error check to prevent the program from trying to load insane amounts of particles.
+        tospawn = static_cast<int> (particles.capacity() - particles.size());
 
       rem = ftospawn - static_cast<float>(tospawn);
 
@@ -218,39 +218,23 @@ void ParticleSystem::update(float dt)
           Particle p = emitter->newParticle(this, manim, mtime, manimtime, w, l, spd, var, spr, spr2);
           // sanity check:
           //if (particles.size() < MAX_PARTICLES) // No need to check this every loop iteration. Already checked above.
-          particles.push_back(p);
+          particles.add(p);
         }
       }
     }
   }
 
-  float mspeed = 1.0f;
-
-  for (ParticleList::iterator it = particles.begin(); it != particles.end();) {
-    Particle &p = *it;
-    p.speed += p.down * grav * dt - p.dir * deaccel * dt;
-
-    if (slowdown>0) {
-      mspeed = expf(-1.0f * slowdown * p.life);
-    }
-    p.pos += p.speed * mspeed * dt;
+  particles.update(dt, grav, deaccel, slowdown, {mid, sizes, colors});
+}
 
-    p.life += dt;
-    float rlife = p.life / p.maxlife;
-    // calculate size and color based on lifetime
-    p.size = lifeRamp<float>(rlife, mid, sizes[0], sizes[1], sizes[2]);
-    p.color = lifeRamp<math::vector_4d>(rlife, mid, colors[0], colors[1], colors[2]);
+float ParticleSystem::randfloat(float lower, float upper)
+{
+  return lower + (upper - lower) * std::uniform_real_distribution<float> (0.0f, 1.0f) (_random);
+}
 
-    // kill off old particles
-    if (rlife >= 1.0f)
-    {
-      it = particles.erase (it);
-    }
-    else
-    {
-      ++it;
-    }
-  }
+int ParticleSystem::randint(int lower, int upper)
+{
+  return std::uniform_int_distribution<int> (lower, upper) (_random);
 }
 
 void ParticleSystem::setup(int anim, int time, int animtime)
@@ -319,11 +303,17 @@ void ParticleSystem::draw( math::matrix_4x4 const& model_view
   math::vector_3d bv0 = math::vector_3d(-f, +f, 0);
   math::vector_3d bv1 = math::vector_3d(+f, +f, 0);
 
-  std::vector<std::uint16_t> indices;
-  std::vector<math::vector_3d> vertices;
-  std::vector<math::vector_3d> offsets;
-  std::vector<math::vector_4d> colors_data;
-  std::vector<math::vector_2d> texcoords;
+  std::vector<std::uint16_t>& indices = _staging_indices;
+  std::vector<math::vector_3d>& vertices = _staging_vertices;
+  std::vector<math::vector_3d>& offsets = _staging_offsets;
+  std::vector<math::vector_4d>& colors_data = _staging_colors;
+  std::vector<math::vector_2d>& texcoords = _staging_texcoords;
+
+  indices.clear();
+  vertices.clear();
+  offsets.clear();
+  colors_data.clear();
+  texcoords.clear();
 
   std::uint16_t indice = 0;
 
@@ -362,62 +352,62 @@ void ParticleSystem::draw( math::matrix_4x4 const& model_view
     if (billboard)
     {
       //! \todo per-particle rotation in a non-expensive way?? :|
-      for (ParticleList::iterator it = particles.begin(); it != particles.end(); ++it)
+      for (std::size_t i = 0; i < particles.size(); ++i)
       {
-        if (tiles.size() - 1 < it->tile) // Alfred, 2009.08.07, error prevent
+        if (tiles.size() - 1 < particles.tile(i)) // Alfred, 2009.08.07, error prevent
         {
           break;
         }
 
-        const float size = it->size;// / 2;
+        const float size = particles.particle_size(i);// / 2;
 
-        texcoords.push_back(tiles[it->tile].tc[0]);
-        vertices.push_back(it->pos);
+        texcoords.push_back(tiles[particles.tile(i)].tc[0]);
+        vertices.push_back(particles.position(i));
         offsets.push_back(-(vRight + vUp) * size);
-        colors_data.push_back(it->color);
+        colors_data.push_back(particles.color(i));
 
-        texcoords.push_back(tiles[it->tile].tc[1]);
-        vertices.push_back(it->pos);
+        texcoords.push_back(tiles[particles.tile(i)].tc[1]);
+        vertices.push_back(particles.position(i));
         offsets.push_back((vRight - vUp) * size);
-        colors_data.push_back(it->color);
+        colors_data.push_back(particles.color(i));
 
-        texcoords.push_back(tiles[it->tile].tc[2]);
-        vertices.push_back(it->pos);
+        texcoords.push_back(tiles[particles.tile(i)].tc[2]);
+        vertices.push_back(particles.position(i));
         offsets.push_back((vRight + vUp) * size);
-        colors_data.push_back(it->color);
+        colors_data.push_back(particles.color(i));
 
-        texcoords.push_back(tiles[it->tile].tc[3]);
-        vertices.push_back(it->pos);
+        texcoords.push_back(tiles[particles.tile(i)].tc[3]);
+        vertices.push_back(particles.position(i));
         offsets.push_back(-(vRight - vUp) * size);
-        colors_data.push_back(it->color);
+        colors_data.push_back(particles.color(i));
 
         add_quad_indices(indice);
       }
     }
     else
     {
-      for (ParticleList::iterator it = particles.begin(); it != particles.end(); ++it)
+      for (std::size_t i = 0; i < particles.size(); ++i)
       {
-        if (tiles.size() - 1 < it->tile) // Alfred, 2009.08.07, error prevent
+        if (tiles.size() - 1 < particles.tile(i)) // Alfred, 2009.08.07, error prevent
         {
           break;
         }
 
-        texcoords.push_back(tiles[it->tile].tc[0]);
-        vertices.push_back(it->pos + it->corners[0] * it->size);
-        colors_data.push_back(it->color);
+        texcoords.push_back(tiles[particles.tile(i)].tc[0]);
+        vertices.push_back(particles.position(i) + particles.corners(i)[0] * particles.particle_size(i));
+        colors_data.push_back(particles.color(i));
 
-        texcoords.push_back(tiles[it->tile].tc[1]);
-        vertices.push_back(it->pos + it->corners[1] * it->size);
-        colors_data.push_back(it->color);
+        texcoords.push_back(tiles[particles.tile(i)].tc[1]);
+        vertices.push_back(particles.position(i) + particles.corners(i)[1] * particles.particle_size(i));
+        colors_data.push_back(particles.color(i));
 
-        texcoords.push_back(tiles[it->tile].tc[2]);
-        vertices.push_back(it->pos + it->corners[2] * it->size);
-        colors_data.push_back(it->color);
+        texcoords.push_back(tiles[particles.tile(i)].tc[2]);
+        vertices.push_back(particles.position(i) + particles.corners(i)[2] * particles.particle_size(i));
+        colors_data.push_back(particles.color(i));
 
-        texcoords.push_back(tiles[it->tile].tc[3]);
-        vertices.push_back(it->pos + it->corners[3] * it->size);
-        colors_data.push_back(it->color);
+        texcoords.push_back(tiles[particles.tile(i)].tc[3]);
+        vertices.push_back(particles.position(i) + particles.corners(i)[3] * particles.particle_size(i));
+        colors_data.push_back(particles.color(i));
 
         add_quad_indices(indice);
       }
@@ -435,28 +425,28 @@ void ParticleSystem::draw( math::matrix_4x4 const& model_view
     bv1 = mbb * math::vector_3d(1.0f,0,0);
     */
 
-    for (ParticleList::iterator it = particles.begin(); it != particles.end(); ++it)
+    for (std::size_t i = 0; i < particles.size(); ++i)
     {
-      if (tiles.size() - 1 < it->tile) // Alfred, 2009.08.07, error prevent
+      if (tiles.size() - 1 < particles.tile(i)) // Alfred, 2009.08.07, error prevent
       {
         break;
       }
 
-      texcoords.push_back(tiles[it->tile].tc[0]);
-      vertices.push_back(it->pos + bv0 * it->size);
-      colors_data.push_back(it->color);
+      texcoords.push_back(tiles[particles.tile(i)].tc[0]);
+      vertices.push_back(particles.position(i) + bv0 * particles.particle_size(i));
+      colors_data.push_back(particles.color(i));
 
-      texcoords.push_back(tiles[it->tile].tc[1]);
-      vertices.push_back(it->pos + bv1 * it->size);
-      colors_data.push_back(it->color);
+      texcoords.push_back(tiles[particles.tile(i)].tc[1]);
+      vertices.push_back(particles.position(i) + bv1 * particles.particle_size(i));
+      colors_data.push_back(particles.color(i));
 
-      texcoords.push_back(tiles[it->tile].tc[2]);
-      vertices.push_back(it->origin + bv1 * it->size);
-      colors_data.push_back(it->color);
+      texcoords.push_back(tiles[particles.tile(i)].tc[2]);
+      vertices.push_back(particles.origin(i) + bv1 * particles.particle_size(i));
+      colors_data.push_back(particles.color(i));
 
-      texcoords.push_back(tiles[it->tile].tc[3]);
-      vertices.push_back(it->origin + bv0 * it->size);
-      colors_data.push_back(it->color);
+      texcoords.push_back(tiles[particles.tile(i)].tc[3]);
+      vertices.push_back(particles.origin(i) + bv0 * particles.particle_size(i));
+      colors_data.push_back(particles.color(i));
 
       add_quad_indices(indice);
     }
@@ -501,15 +491,15 @@ void ParticleSystem::upload()
 namespace
 {
   //Generates the rotation matrix based on spread
-  math::matrix_4x4 CalcSpreadMatrix(float Spread1, float Spread2, float w, float l)
+  math::matrix_4x4 CalcSpreadMatrix(ParticleSystem* sys, float Spread1, float Spread2, float w, float l)
   {
     int i, j;
     float a[2], c[2], s[2];
 
     math::matrix_4x4 SpreadMat (math::matrix_4x4::unit);
 
-    a[0] = misc::randfloat(-Spread1, Spread1) / 2.0f;
-    a[1] = misc::randfloat(-Spread2, Spread2) / 2.0f;
+    a[0] = sys->randfloat(-Spread1, Spread1) / 2.0f;
+    a[1] = sys->randfloat(-Spread2, Spread2) / 2.0f;
 
     /*SpreadMat.m[0][0]*=l;
     SpreadMat.m[1][1]*=l;
@@ -594,12 +584,12 @@ Particle PlaneParticleEmitter::newParticle(ParticleSystem* sys, int anim, int ti
   Particle p;
 
   //Spread Calculation
-  auto mrot = sys->parent->mrot*CalcSpreadMatrix(spr, spr, 1.0f, 1.0f);
+  auto mrot = sys->parent->mrot*CalcSpreadMatrix(sys, spr, spr, 1.0f, 1.0f);
 
   if (sys->flags == 1041) { // Trans Halo
-    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(misc::randfloat(-l, l), 0, misc::randfloat(-w, w)));
+    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(sys->randfloat(-l, l), 0, sys->randfloat(-w, w)));
 
-    const float t = misc::randfloat(0.0f, 2.0f * (float)math::constants::pi);
+    const float t = sys->randfloat(0.0f, 2.0f * (float)math::constants::pi);
 
     p.pos = math::vector_3d(0.0f, sys->pos.y + 0.15f, sys->pos.z) + math::vector_3d(cos(t) / 8, 0.0f, sin(t) / 8); // Need to manually correct for the halo - why?
 
@@ -609,10 +599,10 @@ Particle PlaneParticleEmitter::newParticle(ParticleSystem* sys, int anim, int ti
     math::vector_3d dir(0.0f, 1.0f, 0.0f);
     p.dir = dir;
 
-    p.speed = dir.normalize() * spd * misc::randfloat(0, var);
+    p.speed = dir.normalize() * spd * sys->randfloat(0, var);
   }
   else if (sys->flags == 25 && sys->parent->parent<1) { // Weapon Flame
-    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(misc::randfloat(-l, l), misc::randfloat(-l, l), misc::randfloat(-w, w)));
+    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(sys->randfloat(-l, l), sys->randfloat(-l, l), sys->randfloat(-w, w)));
     math::vector_3d dir = mrot * math::vector_3d(0.0f, 1.0f, 0.0f);
     p.dir = dir.normalize();
     //math::vector_3d dir = sys->model->bones[sys->parent->parent].mrot * sys->parent->mrot * math::vector_3d(0.0f, 1.0f, 0.0f);
@@ -620,19 +610,19 @@ Particle PlaneParticleEmitter::newParticle(ParticleSystem* sys, int anim, int ti
 
   }
   else if (sys->flags == 25 && sys->parent->parent > 0) { // Weapon with built-in Flame (Avenger lightsaber!)
-    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(misc::randfloat(-l, l), misc::randfloat(-l, l), misc::randfloat(-w, w)));
+    p.pos = sys->parent->mat * (sys->pos + math::vector_3d(sys->randfloat(-l, l), sys->randfloat(-l, l), sys->randfloat(-w, w)));
     math::vector_3d dir = math::vector_3d(sys->parent->mat (1, 0), sys->parent->mat (1, 1), sys->parent->mat (1, 2)) + math::vector_3d(0.0f, 1.0f, 0.0f);
-    p.speed = dir.normalize() * spd * misc::randfloat(0, var * 2);
+    p.speed = dir.normalize() * spd * sys->randfloat(0, var * 2);
 
   }
   else if (sys->flags == 17 && sys->parent->parent<1) { // Weapon Glow
-    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(misc::randfloat(-l, l), misc::randfloat(-l, l), misc::randfloat(-w, w)));
+    p.pos = sys->parent->pivot + (sys->pos + math::vector_3d(sys->randfloat(-l, l), sys->randfloat(-l, l), sys->randfloat(-w, w)));
     math::vector_3d dir = mrot * math::vector_3d(0, 1, 0);
     p.dir = dir.normalize();
 
   }
   else {
-    p.pos = sys->pos + math::vector_3d(misc::randfloat(-l, l), 0, misc::randfloat(-w, w));
+    p.pos = sys->pos + math::vector_3d(sys->randfloat(-l, l), 0, sys->randfloat(-w, w));
     p.pos = sys->parent->mat * p.pos;
 
     //math::vector_3d dir = mrot * math::vector_3d(0,1,0);
@@ -640,7 +630,7 @@ Particle PlaneParticleEmitter::newParticle(ParticleSystem* sys, int anim, int ti
 
     p.dir = dir;//.normalize();
     p.down = math::vector_3d(0, -1.0f, 0); // dir * -1.0f;
-    p.speed = dir.normalize() * spd * (1.0f + misc::randfloat(-var, var));
+    p.speed = dir.normalize() * spd * (1.0f + sys->randfloat(-var, var));
   }
 
   if (!sys->billboard)  {
@@ -655,7 +645,7 @@ Particle PlaneParticleEmitter::newParticle(ParticleSystem* sys, int anim, int ti
 
   p.origin = p.pos;
 
-  p.tile = misc::randint(0, sys->rows*sys->cols - 1);
+  p.tile = sys->randint(0, sys->rows*sys->cols - 1);
   return p;
 }
 
@@ -665,21 +655,21 @@ Particle SphereParticleEmitter::newParticle(ParticleSystem* sys, int anim, int t
   math::vector_3d dir;
   float radius;
 
-  radius = misc::randfloat(0, 1);
+  radius = sys->randfloat(0, 1);
 
   // Old method
-  //float t = misc::randfloat(0,2*math::constants::pi);
+  //float t = sys->randfloat(0,2*math::constants::pi);
 
   // New
   // Spread should never be zero for sphere particles ?
   math::radians t (0);
   if (spr == 0)
-    t._ = misc::randfloat((float)-math::constants::pi, (float)math::constants::pi);
+    t._ = sys->randfloat((float)-math::constants::pi, (float)math::constants::pi);
   else
-    t._ = misc::randfloat(-spr, spr);
+    t._ = sys->randfloat(-spr, spr);
 
   //Spread Calculation
-  auto mrot =  sys->parent->mrot*CalcSpreadMatrix(spr * 2, spr2 * 2, w, l);
+  auto mrot =  sys->parent->mrot*CalcSpreadMatrix(sys, spr * 2, spr2 * 2, w, l);
 
   // New
   // Length should never technically be zero ?
@@ -697,11 +687,11 @@ Particle SphereParticleEmitter::newParticle(ParticleSystem* sys, int anim, int t
 
 
   float theta_range = sys->spread.getValue(anim, time, animtime);
-  float theta = -0.5f* theta_range + misc::randfloat(0, theta_range);
+  float theta = -0.5f* theta_range + sys->randfloat(0, theta_range);
   math::vector_3d bdir(0, l*math::cos(theta), w*math::sin(theta));
 
   float phi_range = sys->lat.getValue(anim, time, animtime);
-  float phi = misc::randfloat(0, phi_range);
+  float phi = sys->randfloat(0, phi_range);
   rotate(0,0, &bdir.z, &bdir.x, phi);
   */
 
@@ -715,7 +705,7 @@ Particle SphereParticleEmitter::newParticle(ParticleSystem* sys, int anim, int t
       p.speed = math::vector_3d(0, 0, 0);
     else {
       dir = sys->parent->mrot * (bdir.normalize());//mrot * math::vector_3d(0, 1.0f,0);
-      p.speed = dir.normalize() * spd * (1.0f + misc::randfloat(-var, var));   // ?
+      p.speed = dir.normalize() * spd * (1.0f + sys->randfloat(-var, var));   // ?
     }
 
   }
@@ -747,7 +737,7 @@ Particle SphereParticleEmitter::newParticle(ParticleSystem* sys, int anim, int t
       else
         dir = bdir.normalize();
 
-      p.speed = dir.normalize() * spd * (1.0f + misc::randfloat(-var, var));   // ?
+      p.speed = dir.normalize() * spd * (1.0f + sys->randfloat(-var, var));   // ?
     }
   }
 
@@ -759,7 +749,7 @@ Particle SphereParticleEmitter::newParticle(ParticleSystem* sys, int anim, int t
 
   p.origin = p.pos;
 
-  p.tile = misc::randint(0, sys->rows*sys->cols - 1);
+  p.tile = sys->randint(0, sys->rows*sys->cols - 1);
   return p;
 }
 
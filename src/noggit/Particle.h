@@ -5,12 +5,14 @@
 #include <noggit/Animated.h> // Animation::M2Value
 #include <noggit/Model.h>
 #include <noggit/TextureManager.h>
+#include <noggit/particle_pool.hpp>
 #include <noggit/texture_array_handler.hpp>
 #include <opengl/scoped.hpp>
 #include <opengl/shader.fwd.hpp>
 
 #include <list>
 #include <memory>
+#include <random>
 #include <vector>
 
 class Bone;
@@ -18,17 +20,6 @@ class Model;
 class ParticleSystem;
 class RibbonEmitter;
 
-struct Particle {
-  math::vector_3d pos, speed, down, origin, dir;
-  math::vector_3d  corners[4];
-  //math::vector_3d tpos;
-  float size, life, maxlife;
-  unsigned int tile;
-  math::vector_4d color;
-};
-
-typedef std::list<Particle> ParticleList;
-
 class ParticleEmitter {
 public:
   explicit ParticleEmitter() {}
@@ -64,7 +55,7 @@ class ParticleSystem
   float mid, slowdown;
   math::vector_3d pos;
   uint16_t _texture_id;
-  ParticleList particles;
+  noggit::particle_pool particles;
   int blend, order, type;
   int manim, mtime;
   int manimtime;
@@ -80,6 +71,10 @@ class ParticleSystem
   Bone *parent;
   int32_t flags;
 
+  // every system draws from its own generator so that systems can be
+  // updated on different threads
+  std::minstd_rand _random;
+
 public:
   float tofs;
 
@@ -91,6 +86,9 @@ class ParticleSystem
 
   void update(float dt);
 
+  float randfloat(float lower, float upper);
+  int randint(int lower, int upper);
+
   void setup(int anim, int time, int animtime);
   void draw( math::matrix_4x4 const& model_view
            , opengl::scoped::use_program& shader
@@ -114,6 +112,13 @@ class ParticleSystem
   GLuint const& _colors_vbo = _buffers[2];
   GLuint const& _texcoord_vbo = _buffers[3];
   GLuint const& _indices_vbo = _buffers[4];
+
+  // filled again every frame, kept to not allocate every frame
+  std::vector<std::uint16_t> _staging_indices;
+  std::vector<math::vector_3d> _staging_vertices;
+  std::vector<math::vector_3d> _staging_offsets;
+  std::vector<math::vector_4d> _staging_colors;
+  std::vector<math::vector_2d> _staging_texcoords;
 };
 
 
@@ -1,19 +1,20 @@
 // This file is part of Noggit3, licensed under GNU General Public License (version 3).
 
-#include <math/vector_2d.hpp>
 #include <noggit/TextureManager.h>
 #include <noggit/Log.h> // LogDebug
+#include <noggit/blp_decoder.hpp>
+#include <noggit/job_scheduler.hpp>
 #include <opengl/context.hpp>
-#include <opengl/scoped.hpp>
-#include <opengl/shader.hpp>
 
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMetaObject>
+#include <QtCore/QPointer>
 #include <QtCore/QString>
-#include <QtGui/QOffscreenSurface>
-#include <QtGui/QOpenGLFramebufferObjectFormat>
+#include <QtGui/QImage>
 #include <QtGui/QPixmap>
-#include <QtOpenGL/QGLPixelBuffer>
 
 #include <algorithm>
+#include <cstring>
 
 std::atomic<int> blp_texture::blp_tex_counter = {0};
 
@@ -30,24 +31,6 @@ void TextureManager::report()
   LogDebug << output;
 }
 
-#include <cstdint>
-//! \todo Cross-platform syntax for packed structs.
-#pragma pack(push,1)
-struct BLPHeader
-{
-  int32_t magix;
-  int32_t version;
-  uint8_t attr_0_compression;
-  uint8_t attr_1_alphadepth;
-  uint8_t attr_2_alphatype;
-  uint8_t attr_3_mipmaplevels;
-  int32_t resx;
-  int32_t resy;
-  int32_t offsets[16];
-  int32_t sizes[16];
-};
-#pragma pack(pop)
-
 #include <boost/thread.hpp>
 #include <noggit/MPQ.h>
 
@@ -91,7 +74,7 @@ void blp_texture::upload()
   {
     for (int i = 0; i < _compressed_data.size(); ++i)
     {
-      gl.compressedTexImage2D(GL_TEXTURE_2D, i, _compression_format.get(), width, height, 0, _compressed_data[i].size(), _compressed_data[i].data());
+      gl.compressedTexImage2D(GL_TEXTURE_2D, i, _compression_format.get(), width, height, 0, _compressed_data[i].second, _compressed_data[i].first);
 
       width = std::max(width >> 1, 1);
       height = std::max(height >> 1, 1);
@@ -99,6 +82,8 @@ void blp_texture::upload()
 
     gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _compressed_data.size() - 1);
     _compressed_data.clear();
+    _padded_mips.clear();
+    _compressed_file.reset();
   }
 
   gl.texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -124,7 +109,7 @@ void blp_texture::upload_to_currently_bound_array(GLint array_layer, int startin
   {
     for (int i = starting_level; i < _compressed_data.size(); ++i)
     {
-      gl.compressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i - starting_level, 0, 0, array_layer, width, height, 1, _compression_format.get(), _compressed_data[i].size(), _compressed_data[i].data());
+      gl.compressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i - starting_level, 0, 0, array_layer, width, height, 1, _compression_format.get(), _compressed_data[i].second, _compressed_data[i].first);
       width = std::max(width >> 1, 1);
       height = std::max(height >> 1, 1);
     }
@@ -233,7 +218,7 @@ void blp_texture::loadFromUncompressedData(BLPHeader const* lHeader, char const*
   }
 }
 
-void blp_texture::loadFromCompressedData(BLPHeader const* lHeader, char const* lData)
+void blp_texture::loadFromCompressedData(BLPHeader const* lHeader, std::shared_ptr<char const> lData)
 {
   //                         0 (0000) & 3 == 0                1 (0001) & 3 == 1                    7 (0111) & 3 == 3
   const int alphatypes[] = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT };
@@ -249,7 +234,7 @@ void blp_texture::loadFromCompressedData(BLPHeader const* lHeader, char const* l
   {
     if (lHeader->sizes[i] <= 0 || lHeader->offsets[i] <= 0)
     {
-      return;
+      break;
     }
 
     // make sure the vector is of the right size, blizzard seems to fuck those up for some small mipmaps
@@ -258,17 +243,32 @@ void blp_texture::loadFromCompressedData(BLPHeader const* lHeader, char const* l
     if (size < lHeader->sizes[i])
     {
       LogDebug << "mipmap size mismatch in '" << filename << "'" << std::endl;
-      return;
+      break;
     }
 
-    _compressed_data[i].resize(size);
+    char const* start = lData.get() + lHeader->offsets[i];
 
-    char const* start = lData + lHeader->offsets[i];
-    std::copy(start, start + lHeader->sizes[i], _compressed_data[i].begin());
+    if (size == lHeader->sizes[i])
+    {
+      _compressed_data[i] = {start, static_cast<std::size_t> (size)};
+    }
+    else
+    {
+      auto& padded (_padded_mips[i]);
+      padded.resize(size);
+      std::copy(start, start + lHeader->sizes[i], padded.begin());
+      _compressed_data[i] = {padded.data(), padded.size()};
+    }
 
     width = std::max(width >> 1, 1);
     height = std::max(height >> 1, 1);
   }
+
+  // the mips borrow from the file's buffer until they are uploaded
+  if (_compressed_data.size() > _padded_mips.size())
+  {
+    _compressed_file = std::move (lData);
+  }
 }
 
 blp_texture::blp_texture(const std::string& filenameArg)
@@ -304,7 +304,7 @@ void blp_texture::finishLoading()
   }
   else if (lHeader->attr_0_compression == 2)
   {
-    loadFromCompressedData(lHeader, lData);
+    loadFromCompressedData(lHeader, f.shared_buffer());
     _layer_count = _compressed_data.size();
   }
   else
@@ -323,7 +323,7 @@ void blp_texture::finishLoading()
     }
     else if (lHeader_f->attr_0_compression == 2)
     {
-      loadFromCompressedData(lHeader_f, lData_f);
+      loadFromCompressedData(lHeader_f, fallback.shared_buffer());
       _layer_count = _compressed_data.size();
     }
     else
@@ -344,145 +344,125 @@ void blp_texture::finishLoading()
 
 namespace noggit
 {
-  QPixmap render_blp_to_pixmap ( std::string const& blp_filename
-                               , int width
-                               , int height
-                               )
+  namespace
   {
-    if (!MPQFile::exists(blp_filename))
+    thumbnail_cache& thumbnails()
     {
-      LogError << "Texture not found: " << blp_filename << std::endl;
-      return QPixmap(1, 1);
+      static thumbnail_cache cache (64 << 20);
+      return cache;
     }
 
-    opengl::context::save_current_context const context_save (::gl);
-
-    QOpenGLContext context;
-    context.create();
-
-    QOpenGLFramebufferObjectFormat fmt;
-    fmt.setSamples(1);
-    fmt.setInternalTextureFormat(GL_RGBA8);
-
-    QOffscreenSurface surface;
-    surface.create();
-
-    context.makeCurrent(&surface);
-
-    opengl::context::scoped_setter const context_set (::gl, &context);
-
-    opengl::scoped::bool_setter<GL_CULL_FACE, GL_FALSE> cull;
-    opengl::scoped::bool_setter<GL_DEPTH_TEST, GL_FALSE> depth;
-
-    opengl::scoped::deferred_upload_vertex_arrays<1> vao;
-    vao.upload();
-    opengl::scoped::deferred_upload_buffers<3> buffers;
-    buffers.upload();
-    GLuint const& indices_vbo = buffers[0];
-    GLuint const& vertices_vbo = buffers[1];
-    GLuint const& texcoords_vbo = buffers[2];
-
-    opengl::texture::set_active_texture(0);
-    blp_texture texture(blp_filename);
-    texture.finishLoading();
-
-    width = width == -1 ? texture.width() : width;
-    height = height == -1 ? texture.height() : height;
-
-    float h = static_cast<float>(height);
-    float w = static_cast<float>(width);
-    float half_h = h * 0.5f;
-    float half_w = w * 0.5f;
-
-    std::vector<math::vector_2d> vertices =
-    {
-       {-half_w, -half_h}
-      ,{-half_w, half_h}
-      ,{ half_w, half_h}
-      ,{ half_w, -half_h}
-    };
-    std::vector<math::vector_2d> texcoords =
+    std::shared_ptr<rgba_image const> cached_thumbnail ( std::string const& blp_filename
+                                                       , int width
+                                                       , int height
+                                                       )
     {
-       {0.f, 0.f}
-      ,{0.f, h}
-      ,{w, h}
-      ,{w, 0.f}
-    };
-    std::vector<std::uint16_t> indices = {0,1,2, 2,3,0};
-
-    gl.bufferData<GL_ARRAY_BUFFER, math::vector_2d>(vertices_vbo, vertices, GL_STATIC_DRAW);
-    gl.bufferData<GL_ARRAY_BUFFER, math::vector_2d>(texcoords_vbo, texcoords, GL_STATIC_DRAW);
-    gl.bufferData<GL_ELEMENT_ARRAY_BUFFER, std::uint16_t>(indices_vbo, indices, GL_STATIC_DRAW);
-
-    QOpenGLFramebufferObject pixel_buffer(width, height, fmt);
-    pixel_buffer.bind();
-
-    gl.viewport(0, 0, w, h);
-    gl.clearColor(.0f, .0f, .0f, 1.f);
-    gl.clear(GL_COLOR_BUFFER_BIT);
-
-    opengl::program program
-    (
+      if (auto cached = thumbnails().find (blp_filename, width, height))
       {
-        {
-          GL_VERTEX_SHADER, R"code(
-#version 330 core
-
-in vec4 position;
-in vec2 tex_coord;
-out vec2 f_tex_coord;
-
-void main()
-{
-f_tex_coord = vec2(tex_coord.x, -tex_coord.y);
-gl_Position = position;
-}
-)code"
-        },
-        {
-          GL_FRAGMENT_SHADER,
-          R"code(
-#version 330 core
-
-uniform sampler2D tex;
-
-in vec2 f_tex_coord;
-
-layout(location = 0) out vec4 out_color;
-
-void main()
-{
-out_color = vec4(texture(tex, f_tex_coord/2.f + vec2(0.5)).rgb, 1.);
-}
-)code"
-        }
+        return cached;
       }
-    );
 
-    opengl::scoped::use_program shader (program);
+      if (!MPQFile::exists(blp_filename))
+      {
+        LogError << "Texture not found: " << blp_filename << std::endl;
+        return nullptr;
+      }
 
-    shader.uniform("tex", 0);
-    texture.bind();
+      try
+      {
+        MPQFile f (blp_filename);
+
+        BLPHeader header {};
+        std::memcpy (&header, f.getBuffer(), std::min (sizeof (header), f.getSize()));
+
+        auto thumbnail
+          ( std::make_shared<rgba_image const>
+              ( blp_thumbnail ( decode_blp ( f.getBuffer()
+                                           , f.getSize()
+                                           , blp_mip_for_size (header, width, height)
+                                           )
+                              , width
+                              , height
+                              )
+              )
+          );
+        thumbnails().insert (blp_filename, width, height, thumbnail);
+        return thumbnail;
+      }
+      catch (std::exception const& e)
+      {
+        LogError << "failed rendering " << blp_filename << " to pixmap: " << e.what() << std::endl;
+        return nullptr;
+      }
+    }
 
-    opengl::scoped::vao_binder const _ (vao[0]);
+    QPixmap to_pixmap (rgba_image const* thumbnail)
+    {
+      if (!thumbnail)
+      {
+        return QPixmap(1, 1);
+      }
 
-    shader.attrib(_, "position", vertices_vbo, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    shader.attrib(_, "tex_coord", texcoords_vbo, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    opengl::scoped::buffer_binder<GL_ELEMENT_ARRAY_BUFFER> indices_binder(indices_vbo);
+      return QPixmap::fromImage
+        ( QImage ( thumbnail->pixels.data()
+                 , thumbnail->width
+                 , thumbnail->height
+                 , thumbnail->width * 4
+                 , QImage::Format_RGBX8888
+                 )
+        );
+    }
+  }
 
-    gl.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices_vbo);
+  QPixmap render_blp_to_pixmap ( std::string const& blp_filename
+                               , int width
+                               , int height
+                               )
+  {
+    return to_pixmap (cached_thumbnail (blp_filename, width, height).get());
+  }
 
-    QPixmap pixmap (QPixmap::fromImage (pixel_buffer.toImage()));
+  void render_blp_to_pixmap_async ( std::string const& blp_filename
+                                  , int width
+                                  , int height
+                                  , QObject* receiver
+                                  , std::function<void (QPixmap const&)> done
+                                  )
+  {
+    QPointer<QObject> const guarded_receiver (receiver);
 
-    pixel_buffer.release();
+    // pixmaps can only be made on the gui thread, which is also the only
+    // one the receiver can be destroyed on
+    auto const deliver
+      ( [guarded_receiver, done] (std::shared_ptr<rgba_image const> thumbnail)
+        {
+          QMetaObject::invokeMethod
+            ( QCoreApplication::instance()
+            , [guarded_receiver, thumbnail, done]
+              {
+                if (guarded_receiver)
+                {
+                  done (to_pixmap (thumbnail.get()));
+                }
+              }
+            , Qt::QueuedConnection
+            );
+        }
+      );
 
-    if (pixmap.isNull())
+    if (auto cached = thumbnails().find (blp_filename, width, height))
     {
-      throw std::runtime_error
-        ("failed rendering " + blp_filename + " to pixmap");
+      deliver (std::move (cached));
+      return;
     }
 
-    return pixmap;
+    compute_scheduler().schedule
+      ( [=]
+        {
+          deliver (cached_thumbnail (blp_filename, width, height));
+        }
+      , 1
+      );
   }
 }
 
@@ -8,10 +8,14 @@
 
 #include <boost/optional.hpp>
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+class QObject;
 struct BLPHeader;
 
 struct blp_texture : public opengl::texture, AsyncObject
@@ -20,7 +24,7 @@ struct blp_texture : public opengl::texture, AsyncObject
   void finishLoading();
 
   void loadFromUncompressedData(BLPHeader const* lHeader, char const* lData);
-  void loadFromCompressedData(BLPHeader const* lHeader, char const* lData);
+  void loadFromCompressedData(BLPHeader const* lHeader, std::shared_ptr<char const> lData);
 
   int width() const { return _width; }
   int height() const { return _height; }
@@ -52,7 +56,12 @@ struct blp_texture : public opengl::texture, AsyncObject
 
 private:
   std::map<int, std::vector<uint32_t>> _data;
-  std::map<int, std::vector<uint8_t>> _compressed_data;
+  //! (pointer, size) of each compressed mip. They point into
+  //! _compressed_file, which is kept until upload, or into
+  //! _padded_mips for mips stored shorter than their dimensions need.
+  std::map<int, std::pair<char const*, std::size_t>> _compressed_data;
+  std::map<int, std::vector<char>> _padded_mips;
+  std::shared_ptr<char const> _compressed_file;
   boost::optional<GLint> _compression_format;
 
   static std::atomic<int> blp_tex_counter;
@@ -97,8 +106,20 @@ struct scoped_blp_texture_reference
 
 namespace noggit
 {
+  //! Decoded on the cpu from the mip closest to the size, without a gl
+  //! context. Thumbnails are kept in a cache of the most recently used
+  //! ones.
   QPixmap render_blp_to_pixmap ( std::string const& blp_filename
                                , int width = -1
                                , int height = -1
                                );
+  //! The same decoded on the compute scheduler's workers. \a done is
+  //! called from the gui thread's event loop unless \a receiver is gone
+  //! by then, even if the thumbnail was in the cache.
+  void render_blp_to_pixmap_async ( std::string const& blp_filename
+                                  , int width
+                                  , int height
+                                  , QObject* receiver
+                                  , std::function<void (QPixmap const&)> done
+                                  );
 }
@@ -332,7 +332,7 @@ void WMO::finishLoading ()
 void WMO::draw_instanced( opengl::scoped::use_program& wmo_shader
                         , math::matrix_4x4 const& model_view
                         , math::matrix_4x4 const& projection
-                        , std::vector<WMOInstance*>& instances
+                        , std::vector<math::matrix_4x4> const* visible_transforms
                         , bool boundingbox
                         , math::frustum const& frustum
                         , const float& cull_distance
@@ -342,11 +342,9 @@ void WMO::draw_instanced( opengl::scoped::use_program& wmo_shader
                         , liquid_render& render
                         , int animtime
                         , bool world_has_skies
-                        , display_mode display
                         , wmo_group_uniform_data& wmo_uniform_data
                         , std::vector<std::pair<wmo_liquid*, math::matrix_4x4>>& wmo_liquids_to_draw
                         , noggit::texture_array_handler& texture_handler
-                        , bool update_transform_matrix_buffer
                         )
 {
   if (!finishedLoading() || loading_failed())
@@ -401,21 +399,9 @@ void WMO::draw_instanced( opengl::scoped::use_program& wmo_shader
     _uploaded = true;
   }
 
-  std::vector<math::matrix_4x4> transform_matrix;
-
-  if (update_transform_matrix_buffer || _need_transform_buffer_update)
+  if (visible_transforms)
   {
-    transform_matrix.reserve(instances.size());
-
-    for (WMOInstance* mi : instances)
-    {
-      if (mi->is_visible(frustum, cull_distance, camera, display))
-      {
-        transform_matrix.push_back(mi->transform_matrix_transposed());
-      }
-    }
-
-    _instance_visible = transform_matrix.size();
+    _instance_visible = visible_transforms->size();
   }
 
   if (_instance_visible == 0)
@@ -423,10 +409,16 @@ void WMO::draw_instanced( opengl::scoped::use_program& wmo_shader
     return;
   }
 
-  if (update_transform_matrix_buffer || _need_transform_buffer_update)
+  if (visible_transforms)
   {
     opengl::scoped::buffer_binder<GL_ARRAY_BUFFER> const transform_binder(_transform_buffer);
-    gl.bufferData(GL_ARRAY_BUFFER, _instance_visible * sizeof(::math::matrix_4x4), transform_matrix.data(), GL_STATIC_DRAW);
+
+    if (_transform_buffer_capacity < visible_transforms->size())
+    {
+      _transform_buffer_capacity = visible_transforms->size() + visible_transforms->size() / 2;
+      gl.bufferData(GL_ARRAY_BUFFER, _transform_buffer_capacity * sizeof(::math::matrix_4x4), nullptr, GL_DYNAMIC_DRAW);
+    }
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, _instance_visible * sizeof(::math::matrix_4x4), visible_transforms->data());
 
     _need_transform_buffer_update = false;
   }
@@ -449,9 +441,9 @@ void WMO::draw_instanced( opengl::scoped::use_program& wmo_shader
               );
 
 
-    if (group.liquid)
+    if (group.liquid && visible_transforms)
     {
-      for (math::matrix_4x4 const& m : transform_matrix)
+      for (math::matrix_4x4 const& m : *visible_transforms)
       {
         wmo_liquids_to_draw.emplace_back(group.liquid.get(), m);
       }
@@ -709,6 +701,7 @@ WMOGroup::WMOGroup(WMOGroup const& other)
   , _texcoords_2(other._texcoords_2)
   , _vertex_colors(other._vertex_colors)
   , _indices(other._indices)
+  , _picking_bvh(other._picking_bvh)
   , _ubo(other._ubo)
 {
   if (other.liquid)
@@ -865,6 +858,19 @@ void WMOGroup::load()
   _batches.resize (size / sizeof (wmo_batch));
   f.read (_batches.data (), size);
 
+  {
+    std::vector<uint16_t> triangles;
+
+    for (auto const& batch : _batches)
+    {
+      auto const first (_indices.begin() + std::min<std::size_t> (batch.index_start, _indices.size()));
+      triangles.insert (triangles.end(), first, first + std::min<std::size_t> (batch.index_count, _indices.end() - first));
+    }
+
+    _picking_bvh = noggit::triangle_bvh
+      (triangles, [&] (std::uint32_t vertex) -> math::vector_3d const& { return _vertices[vertex]; });
+  }
+
   // - MOLR ----------------------------------------------
   if (header.flags.has_light)
   {
@@ -1453,21 +1459,13 @@ void WMOGroup::intersect (math::ray const& ray, std::vector<float>* results) con
   }
 
   //! \todo Also allow clicking on doodads and liquids.
-  for (auto&& batch : _batches)
-  {
-    for (size_t i (batch.index_start); i < batch.index_start + batch.index_count; i += 3)
-    {
-      if ( auto&& distance
-         = ray.intersect_triangle ( _vertices[_indices[i + 0]]
-                                  , _vertices[_indices[i + 1]]
-                                  , _vertices[_indices[i + 2]]
-                                  )
-         )
-      {
-        results->emplace_back (*distance);
-      }
-    }
-  }
+  _picking_bvh.intersect ( ray
+                         , [&] (std::uint32_t vertex) -> math::vector_3d const& { return _vertices[vertex]; }
+                         , [&] (float distance, std::uint32_t)
+                           {
+                             results->emplace_back (distance);
+                           }
+                         );
 }
 
 void WMOGroup::setupFog (bool draw_fog, std::function<void (bool)> setup_fog)
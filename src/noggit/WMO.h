@@ -12,6 +12,7 @@
 #include <noggit/TextureManager.h>
 #include <noggit/texture_array_handler.hpp>
 #include <noggit/tool_enums.hpp>
+#include <noggit/triangle_bvh.hpp>
 #include <noggit/wmo_liquid.hpp>
 #include <noggit/wmo_headers.hpp>
 
@@ -134,6 +135,9 @@ class WMOGroup
   std::vector<::math::vector_4d> _vertex_colors;
   std::vector<uint16_t> _indices;
 
+  // over the batches' triangles
+  noggit::triangle_bvh _picking_bvh;
+
   GLuint _ubo;
 
   bool _uploaded = false;
@@ -179,10 +183,13 @@ class WMO : public AsyncObject
 public:
   explicit WMO(const std::string& name);
 
+  //! \a visible_transforms are the transposed transforms of the visible
+  //! instances (see noggit::instance_culling), null to draw the same
+  //! instances as the last time
   void draw_instanced ( opengl::scoped::use_program& wmo_shader
                       , math::matrix_4x4 const& model_view
                       , math::matrix_4x4 const& projection
-                      , std::vector<WMOInstance*>& instances
+                      , std::vector<math::matrix_4x4> const* visible_transforms
                       , bool boundingbox
                       , math::frustum const& frustum
                       , const float& cull_distance
@@ -192,11 +199,9 @@ class WMO : public AsyncObject
                       , liquid_render& render
                       , int animtime
                       , bool world_has_skies
-                      , display_mode display
                       , wmo_group_uniform_data& wmo_uniform_data
                       , std::vector<std::pair<wmo_liquid*, math::matrix_4x4>>& wmo_liquids_to_draw
                       , noggit::texture_array_handler& texture_handler
-                      , bool update_transform_matrix_buffer
                       );
 
   void draw_boxes_instanced(opengl::scoped::use_program& wmo_box_shader);
@@ -259,6 +264,7 @@ class WMO : public AsyncObject
   }
 
   void require_transform_buffer_update() { _need_transform_buffer_update = true; }
+  bool need_transform_buffer_update() const { return _need_transform_buffer_update; }
 
   bool has_liquids() const { return _has_liquids; }
 
@@ -272,6 +278,8 @@ class WMO : public AsyncObject
   bool _bbox_uploaded = false;
 
   int _instance_visible = 0;
+  // in instances, the buffer only gets reallocated when it has to grow
+  std::size_t _transform_buffer_capacity = 0;
 
   opengl::scoped::deferred_upload_buffers<6> _buffers;
   opengl::scoped::deferred_upload_vertex_arrays<2> _vertex_arrays;
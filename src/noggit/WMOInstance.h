@@ -111,6 +111,9 @@ class WMOInstance
   math::matrix_4x4 transform_matrix_inverted() const { return _transform_mat_inverted; }
   math::matrix_4x4 transform_matrix_transposed() const { return _transform_mat_transposed; }
 
+  math::vector_3d const& aabb_center() const { return _aabb_center; }
+  float aabb_radius() const { return _aabb_radius; }
+
   void intersect (math::ray const&, selection_result*);
 
   void recalcExtents();
@@ -4,6 +4,7 @@
 
 #include <math/frustum.hpp>
 #include <noggit/Brush.h> // brush
+#include <noggit/chunk_edit.hpp>
 #include <noggit/chunk_mover.hpp>
 #include <noggit/liquid_chunk.hpp>
 #include <noggit/DBC.h>
@@ -13,10 +14,12 @@
 #include <noggit/Misc.h>
 #include <noggit/ModelManager.h> // ModelManager
 #include <noggit/settings.hpp>
+#include <noggit/terrain_normals.hpp>
 #include <noggit/TextureManager.h>
 #include <noggit/liquid_tile.hpp>// tile water
 #include <noggit/WMOInstance.h> // WMOInstance
 #include <noggit/map_index.hpp>
+#include <noggit/job_scheduler.hpp>
 #include <noggit/texture_set.hpp>
 #include <noggit/tool_enums.hpp>
 #include <noggit/ui/ObjectEditor.h>
@@ -108,7 +111,16 @@ World::World(const std::string& name, int map_id)
   , skies(nullptr)
   , outdoorLightStats(OutdoorLightStats())
   , _current_selection()
-  , _view_distance(NoggitSettings.value ("view_distance", 1000.f).toFloat() + TILE_RADIUS) // add adt radius to make sure tiles aren't culled too soon, todo: improve adt culling to prevent that from happening
+  , _view_distance(NoggitSettings.editor().view_distance + TILE_RADIUS) // add adt radius to make sure tiles aren't culled too soon, todo: improve adt culling to prevent that from happening
+  , _settings_subscription
+      ( NoggitSettings.on_editor_settings_change
+          ( [this] (noggit::editor_settings const& settings)
+            {
+              _view_distance = settings.view_distance + TILE_RADIUS;
+              _need_wireframe_settings_update = true;
+            }
+          )
+      )
 {
   LogDebug << "Loading world \"" << name << "\"." << std::endl;
 }
@@ -292,6 +304,7 @@ void World::raise_models_terrain_brush(math::vector_3d const& pos, float change,
 {
   std::vector<math::vector_3d*> model_positions;
   std::vector<math::degrees::vec3*> model_rotations;
+  std::vector<std::uint32_t> model_uids;
 
   need_model_updates = true;
 
@@ -301,6 +314,7 @@ void World::raise_models_terrain_brush(math::vector_3d const& pos, float change,
     {
       model_positions.push_back(&model_instance.pos);
       model_rotations.push_back(&model_instance.dir);
+      model_uids.push_back(model_instance.uid);
       model_instance.require_extents_recalc();
     }
   });
@@ -311,6 +325,7 @@ void World::raise_models_terrain_brush(math::vector_3d const& pos, float change,
     {
       model_positions.push_back(&wmo_instance.pos);
       model_rotations.push_back(&wmo_instance.dir);
+      model_uids.push_back(wmo_instance.mUniqueID);
 
       wmo_instance.require_extents_recalc();
     }
@@ -372,6 +387,11 @@ void World::raise_models_terrain_brush(math::vector_3d const& pos, float change,
       }
     }
   }
+
+  for (std::uint32_t uid : model_uids)
+  {
+    _model_instance_storage.update_spatial_index(uid);
+  }
 }
 
 void World::snap_selected_models_to_the_ground()
@@ -846,6 +866,8 @@ void World::draw ( math::matrix_4x4 const& model_view
   // but should be 32 for most computers for the fragment shader
   static int fragment_shader_max_texture_unit = 16;
 
+  _terrain_uploads = {};
+
   if (!_display_initialized)
   {
     initDisplay();
@@ -867,6 +889,9 @@ void World::draw ( math::matrix_4x4 const& model_view
 
   cursor_mode cursor = static_cast<cursor_mode>(cursor_type);
 
+  // only the instances added or removed since the last frame
+  update_instance_buckets();
+
   if (!_m2_program)
   {
     _m2_program.reset
@@ -949,14 +974,6 @@ void World::draw ( math::matrix_4x4 const& model_view
     {
       mcnk_shader.uniform("texture_arrays[" + std::to_string(i) + "]", i + 1);
     }
-
-    mcnk_shader.uniform("wireframe_type", NoggitSettings.value("wireframe/type", 0).toInt());
-    mcnk_shader.uniform("wireframe_radius", NoggitSettings.value("wireframe/radius", 1.5f).toFloat());
-    mcnk_shader.uniform("wireframe_width", NoggitSettings.value("wireframe/width", 1.f).toFloat());
-    // !\ todo store the color somewhere ?
-    QColor c = NoggitSettings.value("wireframe/color").value<QColor>();
-    math::vector_4d wireframe_color(c.redF(), c.greenF(), c.blueF(), c.alphaF());
-    mcnk_shader.uniform("wireframe_color", wireframe_color);
   }
   if (!_mfbo_program)
   {
@@ -1103,6 +1120,16 @@ void World::draw ( math::matrix_4x4 const& model_view
 
     mcnk_shader.uniform ("draw_wireframe", (int)draw_wireframe);
 
+    if (_need_wireframe_settings_update)
+    {
+      noggit::editor_settings const& settings (NoggitSettings.editor());
+      mcnk_shader.uniform("wireframe_type", settings.wireframe_type);
+      mcnk_shader.uniform("wireframe_radius", settings.wireframe_radius);
+      mcnk_shader.uniform("wireframe_width", settings.wireframe_width);
+      mcnk_shader.uniform("wireframe_color", settings.wireframe_color);
+      _need_wireframe_settings_update = false;
+    }
+
     mcnk_shader.uniform ("draw_fog", (int)draw_fog);
     mcnk_shader.uniform ("fog_color", math::vector_4d(skies->color_set[FOG_COLOR], 1));
     // !\ todo use light dbcs values
@@ -1158,6 +1185,7 @@ void World::draw ( math::matrix_4x4 const& model_view
                  , area_id_colors
                  , display
                  , _tileset_handler
+                 , _terrain_uploads
                  );
     }
 
@@ -1229,17 +1257,109 @@ void World::draw ( math::matrix_4x4 const& model_view
       _model_display_mode = models_display_mode;
     }
 
-    std::unordered_map<std::string, std::vector<ModelInstance*>>* models_to_draw =
-      (draw_models && draw_doodads_wmo) ? &_models_by_filename_with_wmo_doodads :
-      (draw_models ? &_models_by_filename : &_wmo_doodads_by_filename);
+    noggit::instance_buckets<Model, ModelInstance> const* models_to_draw =
+      (draw_models && draw_doodads_wmo) ? &_model_and_wmo_doodad_buckets :
+      (draw_models ? &_model_buckets : &_wmo_doodad_buckets);
 
+    if (need_model_updates)
+    {
+      update_wmo_instances();
+      update_transform_buffers = true;
+    }
     // don't check every frame when models are loading to avoid big performance drop
-    if (need_model_updates || (_models_still_loading && _last_unloaded_doodad_check++ > 60))
+    else if (!_wmos_still_loading.empty() && _last_unloaded_doodad_check++ > 60)
     {
-      update_models_by_filename();
+      update_loading_wmo_instances();
       update_transform_buffers = true;
     }
 
+    // the models drawn with their group in the culling, if loaded
+    std::vector<std::pair<Model*, std::size_t>> drawn_models;
+    std::vector<std::vector<ModelInstance*> const*> culled_instances;
+    std::vector<std::size_t> culled_group_sizes;
+    std::size_t const not_culled (-1);
+    bool need_culling = update_transform_buffers;
+
+    for (auto const& it : *models_to_draw)
+    {
+      Model* model = it.first;
+
+      if (draw_hidden_models || !model->is_hidden())
+      {
+        if (model->finishedLoading() && !model->loading_failed())
+        {
+          // the instances changed since the last gathering
+          _model_culling_outdated = _model_culling_outdated || model->need_transform_buffer_update();
+          need_culling = need_culling || model->need_transform_buffer_update();
+
+          drawn_models.emplace_back(model, culled_instances.size());
+          culled_instances.push_back(&it.second);
+          culled_group_sizes.push_back(it.second.size());
+        }
+        else
+        {
+          drawn_models.emplace_back(model, not_culled);
+        }
+      }
+    }
+
+    _model_culling_outdated = _model_culling_outdated
+                           || culled_instances != _model_culling_groups
+                           || culled_group_sizes != _model_culling_sizes;
+
+    // simulate every model about to be drawn on all cores first, the
+    // draws below then only upload the results
+    if (draw_model_animations)
+    {
+      noggit::compute_scheduler().parallel_for
+        ( 0, drawn_models.size()
+        , [&] (std::size_t i)
+          {
+            drawn_models[i].first->prepare_animation(model_view, animtime);
+          }
+        );
+    }
+
+    // gather and cull the instances on all cores too, every group only
+    // touches its own model and instances
+    if (_model_culling_outdated)
+    {
+      _model_culling.reset(culled_group_sizes);
+      noggit::compute_scheduler().parallel_for
+        ( 0, culled_instances.size()
+        , [&] (std::size_t group)
+          {
+            std::size_t const begin = _model_culling.group_begin(group);
+            std::vector<ModelInstance*> const& instances = *culled_instances[group];
+
+            for (std::size_t i = 0; i < instances.size(); ++i)
+            {
+              ModelInstance* mi = instances[i];
+              if (mi->need_recalc_extents())
+              {
+                mi->recalcExtents();
+              }
+              _model_culling.set ( begin + i
+                                 , mi->get_pos()
+                                 , mi->model->rad * mi->scale
+                                 , mi->size_cat
+                                 , mi->transform_matrix_transposed()
+                                 );
+            }
+          }
+        );
+
+      _model_culling_groups = culled_instances;
+      _model_culling_sizes = culled_group_sizes;
+      _model_culling_outdated = false;
+      need_culling = true;
+    }
+
+    if (need_culling)
+    {
+      _model_culling.cull(noggit::compute_scheduler(), frustum, culldistance, camera_pos, display);
+    }
+
     std::unordered_map<Model*, std::size_t> model_boxes_to_draw;
 
     {
@@ -1261,28 +1381,20 @@ void World::draw ( math::matrix_4x4 const& model_view
       m2_shader.uniform("ambient_color", ambient_color);
 
 
-      for (auto& it : *models_to_draw)
+      for (auto const& drawn : drawn_models)
       {
-        if (draw_hidden_models || !it.second[0]->model->is_hidden())
-        {
-          it.second[0]->model->draw( model_view
-                                    , it.second
-                                    , m2_shader
-                                    , frustum
-                                    , culldistance
-                                    , camera_pos
-                                    , false
-                                    , animtime
-                                    , draw_model_animations
-                                    , draw_models_with_box
-                                    , model_with_particles
-                                    , model_boxes_to_draw
-                                    , display
-                                    , update_transform_buffers
-                                    , _model_texture_handler
-                                    , ogl_state
-                                    );
-        }
+        drawn.first->draw( model_view
+                         , !need_culling || drawn.second == not_culled ? nullptr : &_model_culling.visible_transforms(drawn.second)
+                         , m2_shader
+                         , false
+                         , animtime
+                         , draw_model_animations
+                         , draw_models_with_box
+                         , model_with_particles
+                         , model_boxes_to_draw
+                         , _model_texture_handler
+                         , ogl_state
+                         );
       }
     }
 
@@ -1334,7 +1446,10 @@ void World::draw ( math::matrix_4x4 const& model_view
     // visually until the camera moves when moving a wmo with liquids
     if (need_model_updates || _need_wmo_liquid_update)
     {
-      update_models_by_filename();
+      if (need_model_updates)
+      {
+        update_wmo_instances();
+      }
       update_transform_buffers = true;
       _need_wmo_liquid_update = false;
     }
@@ -1367,34 +1482,93 @@ void World::draw ( math::matrix_4x4 const& model_view
       _wmo_liquids_to_draw.clear();
     }
 
-    for (auto& it : _wmos_by_filename)
+    // same as for the models above
+    std::vector<std::pair<WMO*, std::size_t>> drawn_wmos;
+    std::vector<std::vector<WMOInstance*> const*> culled_instances;
+    std::vector<std::size_t> culled_group_sizes;
+    std::size_t const not_culled (-1);
+    bool need_culling = update_transform_buffers;
+
+    for (auto const& it : _wmo_buckets)
     {
-      WMO* wmo = it.second[0]->wmo.get();
+      WMO* wmo = it.first;
 
       if (draw_hidden_models || !wmo->is_hidden())
       {
-        wmo->draw_instanced ( wmo_program
-                            , model_view
-                            , projection
-                            , it.second
-                            , false
-                            , frustum
-                            , culldistance
-                            , camera_pos
-                            , draw_wmo_doodads
-                            , draw_fog
-                            , _liquid_render.get()
-                            , animtime
-                            , skies->hasSkies()
-                            , display
-                            , wmo_uniform_data
-                            , _wmo_liquids_to_draw
-                            , _model_texture_handler
-                            , update_transform_buffers
-                            );
+        if (wmo->finishedLoading() && !wmo->loading_failed())
+        {
+          _wmo_culling_outdated = _wmo_culling_outdated || wmo->need_transform_buffer_update();
+          need_culling = need_culling || wmo->need_transform_buffer_update();
+
+          drawn_wmos.emplace_back(wmo, culled_instances.size());
+          culled_instances.push_back(&it.second);
+          culled_group_sizes.push_back(it.second.size());
+        }
+        else
+        {
+          drawn_wmos.emplace_back(wmo, not_culled);
+        }
       }
     }
 
+    _wmo_culling_outdated = _wmo_culling_outdated
+                         || culled_instances != _wmo_culling_groups
+                         || culled_group_sizes != _wmo_culling_sizes;
+
+    if (_wmo_culling_outdated)
+    {
+      _wmo_culling.reset(culled_group_sizes);
+      noggit::compute_scheduler().parallel_for
+        ( 0, culled_instances.size()
+        , [&] (std::size_t group)
+          {
+            std::size_t const begin = _wmo_culling.group_begin(group);
+            std::vector<WMOInstance*> const& instances = *culled_instances[group];
+
+            for (std::size_t i = 0; i < instances.size(); ++i)
+            {
+              _wmo_culling.set ( begin + i
+                               , instances[i]->aabb_center()
+                               , instances[i]->aabb_radius()
+                               , 0.f
+                               , instances[i]->transform_matrix_transposed()
+                               );
+            }
+          }
+        );
+
+      _wmo_culling_groups = culled_instances;
+      _wmo_culling_sizes = culled_group_sizes;
+      _wmo_culling_outdated = false;
+      need_culling = true;
+    }
+
+    if (need_culling)
+    {
+      _wmo_culling.cull(noggit::compute_scheduler(), frustum, culldistance, camera_pos, display);
+    }
+
+    for (auto const& drawn : drawn_wmos)
+    {
+      drawn.first->draw_instanced ( wmo_program
+                                  , model_view
+                                  , projection
+                                  , !need_culling || drawn.second == not_culled ? nullptr : &_wmo_culling.visible_transforms(drawn.second)
+                                  , false
+                                  , frustum
+                                  , culldistance
+                                  , camera_pos
+                                  , draw_wmo_doodads
+                                  , draw_fog
+                                  , _liquid_render.get()
+                                  , animtime
+                                  , skies->hasSkies()
+                                  , wmo_uniform_data
+                                  , _wmo_liquids_to_draw
+                                  , _model_texture_handler
+                                  );
+    }
+
     gl.enable(GL_BLEND);
     gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     gl.enable(GL_CULL_FACE);
@@ -1410,7 +1584,7 @@ void World::draw ( math::matrix_4x4 const& model_view
       opengl::scoped::bool_setter<GL_LINE_SMOOTH, GL_TRUE> const line_smooth;
       gl.hint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
-      for (auto& it : _wmos_by_filename)
+      for (auto const& it : _wmo_buckets)
       {
         bool hidden = it.second[0]->wmo->is_hidden();
 
@@ -1663,29 +1837,25 @@ selection_result World::intersect ( math::matrix_4x4 const& model_view
     }
   }
 
-  if (!pOnlyMap && do_objects)
+  if (!pOnlyMap && do_objects && (draw_models || draw_wmo))
   {
-    if (draw_models)
-    {
-      _model_instance_storage.for_each_m2_instance([&] (ModelInstance& model_instance)
-      {
-        if (draw_hidden_models || !model_instance.model->is_hidden())
+    _model_instance_storage.for_each_instance_on_ray
+      ( ray
+      , [&] (ModelInstance& model_instance)
         {
-          model_instance.intersect(model_view, ray, &results, animtime);
+          if (draw_models && (draw_hidden_models || !model_instance.model->is_hidden()))
+          {
+            model_instance.intersect(model_view, ray, &results, animtime);
+          }
         }
-      });
-    }
-
-    if (draw_wmo)
-    {
-      _model_instance_storage.for_each_wmo_instance([&] (WMOInstance& wmo_instance)
-      {
-        if (draw_hidden_models || !wmo_instance.wmo->is_hidden())
+      , [&] (WMOInstance& wmo_instance)
         {
-          wmo_instance.intersect(ray, &results);
+          if (draw_wmo && (draw_hidden_models || !wmo_instance.wmo->is_hidden()))
+          {
+            wmo_instance.intersect(ray, &results);
+          }
         }
-      });
-    }
+      );
   }
 
   std::sort ( results.begin()
@@ -1701,11 +1871,6 @@ selection_result World::intersect ( math::matrix_4x4 const& model_view
 
 void World::update_models_emitters(float dt)
 {
-  while (dt > 0.1f)
-  {
-    ModelManager::updateEmitters(0.1f);
-    dt -= 0.1f;
-  }
   ModelManager::updateEmitters(dt);
 }
 
@@ -1719,15 +1884,17 @@ void World::clearHeight(math::vector_3d const& pos)
   for_all_chunks_on_tile(pos, [](MapChunk* chunk) {
     chunk->clearHeight();
   });
-  for_all_chunks_on_tile(pos, [this] (MapChunk* chunk) {
-      recalc_norms (chunk);
+  std::vector<MapChunk*> chunks;
+  for_all_chunks_on_tile(pos, [&] (MapChunk* chunk) {
+      chunks.push_back (chunk);
   });
+  recalc_norms (chunks);
 }
 
 void World::clearAllModelsOnADT(tile_index const& tile)
 {
   _model_instance_storage.delete_instances_from_tile(tile, true, true);
-  update_models_by_filename();
+  update_instance_buckets();
 }
 
 void World::CropWaterADT(const tile_index& pos)
@@ -1902,6 +2069,40 @@ template<typename Fun, typename Post>
 
   return changed;
 }
+template<typename Fun, typename Post>
+  bool World::edit_chunks_in_range (math::vector_3d const& pos, float radius, Fun&& fun, Post&& post)
+{
+  std::vector<std::pair<MapTile*, MapChunk*>> chunks;
+
+  for (MapTile* tile : mapIndex.tiles_in_range (pos, radius))
+  {
+    if (!tile->finishedLoading())
+    {
+      continue;
+    }
+
+    for (MapChunk* chunk : tile->chunks_in_range (pos, radius))
+    {
+      chunks.emplace_back (tile, chunk);
+    }
+  }
+
+  bool const parallel (NoggitSettings.editor().parallel_chunk_edits);
+
+  return noggit::edit_chunks
+    ( parallel ? &noggit::compute_scheduler() : nullptr
+    , chunks
+    , [&] (std::pair<MapTile*, MapChunk*> const& chunk)
+      {
+        return fun (chunk.second);
+      }
+    , [&] (std::pair<MapTile*, MapChunk*> const& chunk)
+      {
+        mapIndex.setChanged (chunk.first);
+        post (chunk.second);
+      }
+    );
+}
 
   void World::load_full_map()
   {
@@ -1924,12 +2125,13 @@ template<typename Fun, typename Post>
 
 void World::changeShader(math::vector_3d const& pos, math::vector_4d const& color, float change, float radius, bool editMode)
 {
-  for_all_chunks_in_range
+  edit_chunks_in_range
     ( pos, radius
     , [&] (MapChunk* chunk)
       {
         return chunk->ChangeMCCV(pos, color, change, radius, editMode);
       }
+    , [] (MapChunk*) {}
     );
 }
 
@@ -1950,36 +2152,46 @@ math::vector_3d World::pickShaderColor(math::vector_3d const& pos)
 
 void World::changeTerrain(math::vector_3d const& pos, float change, float radius, int BrushType, float inner_radius, terrain_edit_mode edit_mode)
 {
-  for_all_chunks_in_range
+  std::vector<MapChunk*> changed_chunks;
+
+  edit_chunks_in_range
     ( pos, radius
     , [&] (MapChunk* chunk)
       {
         return chunk->changeTerrain(pos, change, radius, BrushType, inner_radius, edit_mode);
       }
-    , [this] (MapChunk* chunk)
+    , [&] (MapChunk* chunk)
       {
-        recalc_norms (chunk);
+        changed_chunks.push_back (chunk);
       }
     );
+
+  recalc_norms (changed_chunks);
 }
 
 void World::flattenTerrain(math::vector_3d const& pos, float remain, float radius, int BrushType, flatten_mode const& mode, const math::vector_3d& origin, math::degrees angle, math::degrees orientation)
 {
-  for_all_chunks_in_range
+  std::vector<MapChunk*> changed_chunks;
+
+  edit_chunks_in_range
     ( pos, radius
     , [&] (MapChunk* chunk)
       {
         return chunk->flattenTerrain(pos, remain, radius, BrushType, mode, origin, angle, orientation);
       }
-    , [this] (MapChunk* chunk)
+    , [&] (MapChunk* chunk)
       {
-        recalc_norms (chunk);
+        changed_chunks.push_back (chunk);
       }
     );
+
+  recalc_norms (changed_chunks);
 }
 
 void World::blurTerrain(math::vector_3d const& pos, float remain, float radius, int BrushType, flatten_mode const& mode)
 {
+  std::vector<MapChunk*> changed_chunks;
+
   for_all_chunks_in_range
     ( pos, radius
     , [&] (MapChunk* chunk)
@@ -1997,32 +2209,66 @@ void World::blurTerrain(math::vector_3d const& pos, float remain, float radius,
                                     }
                                   );
       }
-    , [this] (MapChunk* chunk)
+    , [&] (MapChunk* chunk)
       {
-        recalc_norms (chunk);
+        changed_chunks.push_back (chunk);
       }
     );
+
+  recalc_norms (changed_chunks);
 }
 
 void World::recalc_norms (MapChunk* chunk) const
 {
-  chunk->recalcNorms ( [this] (float x, float z) -> boost::optional<float>
-                       {
-                         math::vector_3d vec;
-                         auto res (GetVertex (x, z, &vec));
-                         return boost::make_optional (res, vec.y);
-                       }
-                     );
+  recalc_norms (std::vector<MapChunk*> {chunk});
+}
+
+void World::recalc_norms (std::vector<MapChunk*> const& chunks) const
+{
+  noggit::compute_scheduler().parallel_for
+    ( 0, chunks.size()
+    , [&] (std::size_t i)
+      {
+        // same as GetVertex, only looking the tile up again when the
+        // point is on another one, the chunk's own vertices aren't looked up
+        tile_index last_tile (64, 64);
+        MapTile* last_adt = nullptr;
+
+        noggit::chunk_normals normals;
+        normals.gather ( chunks[i]->vertices
+                       , [&] (float x, float z) -> boost::optional<float>
+                         {
+                           tile_index const tile ({x, 0, z});
+
+                           if (!(tile == last_tile))
+                           {
+                             last_tile = tile;
+                             last_adt = mapIndex.tileLoaded(tile) ? mapIndex.getTile(tile) : nullptr;
+                           }
+
+                           math::vector_3d vec;
+                           bool const res ( last_adt
+                                         && last_adt->finishedLoading()
+                                         && last_adt->GetVertex (x, z, &vec)
+                                          );
+                           return boost::make_optional (res, vec.y);
+                         }
+                       );
+
+        chunks[i]->recalcNorms (normals);
+      }
+    );
 }
 
 bool World::paintTexture(math::vector_3d const& pos, Brush* brush, float strength, float pressure, scoped_blp_texture_reference texture)
 {
-  return for_all_chunks_in_range
+  return edit_chunks_in_range
     ( pos, brush->get_radius()
     , [&] (MapChunk* chunk)
       {
         return chunk->paintTexture(pos, brush, strength, pressure, texture);
       }
+    , [] (MapChunk*) {}
     );
 }
 
@@ -2344,10 +2590,12 @@ void World::unload_every_model_and_wmo_instance()
   _model_instance_storage.clear();
 
   _wmos_with_skybox.clear();
-  _wmos_by_filename.clear();
-  _models_by_filename.clear();
-  _wmo_doodads_by_filename.clear();
-  _models_by_filename_with_wmo_doodads.clear();
+  _wmo_buckets.clear();
+  _model_buckets.clear();
+  _wmo_doodad_buckets.clear();
+  _model_and_wmo_doodad_buckets.clear();
+  _doodads_per_wmo.clear();
+  _wmos_still_loading.clear();
 }
 
 ModelInstance* World::addM2 ( std::string const& filename
@@ -2366,14 +2614,16 @@ ModelInstance* World::addM2 ( std::string const& filename
 
   if (paste_params)
   {
-    if (NoggitSettings.value("model/random_rotation", false).toBool())
+    noggit::editor_settings const& settings (NoggitSettings.editor());
+
+    if (settings.random_rotation)
     {
       float min = paste_params->minRotation;
       float max = paste_params->maxRotation;
       model_instance.dir.y += math::degrees(misc::randfloat(min, max));
     }
 
-    if (NoggitSettings.value("model/random_tilt", false).toBool())
+    if (settings.random_tilt)
     {
       float min = paste_params->minTilt;
       float max = paste_params->maxTilt;
@@ -2381,7 +2631,7 @@ ModelInstance* World::addM2 ( std::string const& filename
       model_instance.dir.z += math::degrees(misc::randfloat(min, max));
     }
 
-    if (NoggitSettings.value("model/random_size", false).toBool())
+    if (settings.random_size)
     {
       float min = paste_params->minScale;
       float max = paste_params->maxScale;
@@ -2394,12 +2644,7 @@ ModelInstance* World::addM2 ( std::string const& filename
   model_instance.recalcExtents();
 
   std::uint32_t uid = _model_instance_storage.add_model_instance(std::move(model_instance), true);
-  auto model = _model_instance_storage.get_model_instance(uid).get();
-
-  _models_by_filename[filename].push_back(model);
-  _models_by_filename_with_wmo_doodads[filename].push_back(model);
-
-  return model;
+  return _model_instance_storage.get_model_instance(uid).get();
 }
 
 WMOInstance* World::addWMO ( std::string const& filename
@@ -2420,13 +2665,6 @@ WMOInstance* World::addWMO ( std::string const& filename
   std::uint32_t uid = _model_instance_storage.add_wmo_instance(std::move(wmo_instance), true);
   auto wmo = _model_instance_storage.get_wmo_instance(uid).get();
 
-  _wmos_by_filename[filename].push_back(wmo);
-
-  if (wmo->wmo->skybox)
-  {
-    _wmos_with_skybox.push_back(wmo);
-  }
-
   need_model_updates = true;
 
   return wmo;
@@ -2506,6 +2744,11 @@ void World::updateTilesWMO(WMOInstance* wmo, model_update type)
 {
   _tile_update_queue.queue_update(wmo, type);
 
+  if (type == model_update::add)
+  {
+    _model_instance_storage.update_spatial_index(wmo->mUniqueID);
+  }
+
   if (wmo->wmo->has_liquids())
   {
     _need_wmo_liquid_update = true;
@@ -2519,6 +2762,11 @@ void World::updateTilesWMO(WMOInstance* wmo, model_update type)
 void World::updateTilesModel(ModelInstance* m2, model_update type)
 {
   _tile_update_queue.queue_update(m2, type);
+
+  if (type == model_update::add)
+  {
+    _model_instance_storage.update_spatial_index(m2->uid);
+  }
 }
 
 void World::wait_for_all_tile_updates()
@@ -2696,10 +2944,7 @@ void World::fixAllGaps()
     }
   }
 
-  for (MapChunk* chunk : chunks)
-  {
-    recalc_norms (chunk);
-  }
+  recalc_norms (chunks);
 }
 
 bool World::isUnderMap(math::vector_3d const& pos)
@@ -2842,8 +3087,9 @@ void World::updateSelectedVertices()
   for (MapChunk* chunk : _vertex_chunks)
   {
     chunk->updateVerticesData();
-    recalc_norms (chunk);
   }
+
+  recalc_norms (std::vector<MapChunk*> (_vertex_chunks.begin(), _vertex_chunks.end()));
 }
 
 void World::orientVertices ( math::vector_3d const& ref_pos
@@ -2915,72 +3161,170 @@ std::set<MapChunk*>& World::vertexBorderChunks()
   return _vertex_border_chunks;
 }
 
-void World::update_models_by_filename()
+bool World::update_instance_buckets()
 {
-  _wmos_with_skybox.clear();
-  _wmos_by_filename.clear();
-  _models_by_filename.clear();
-  _wmo_doodads_by_filename.clear();
-  _models_by_filename_with_wmo_doodads.clear();
-
-  _models_still_loading = false;
+  auto const m2_changes = _model_instance_storage.take_m2_changes();
+  auto const wmo_changes = _model_instance_storage.take_wmo_changes();
 
-  _model_instance_storage.for_each_m2_instance([&] (ModelInstance& model_instance)
+  if (m2_changes.empty() && wmo_changes.empty())
   {
-    _models_by_filename[model_instance.model->filename].push_back(&model_instance);
-    _models_by_filename_with_wmo_doodads[model_instance.model->filename].push_back(&model_instance);
+    return false;
+  }
 
-    // to make sure the transform matrix are up to date
-    if(model_instance.need_recalc_extents())
+  // removed instances may already be destroyed, and instances added
+  // may have been removed by a later change
+  for (auto const& change : m2_changes)
+  {
+    if (change.second)
     {
-      if (!model_instance.recalcExtents())
-      {
-        _models_still_loading = true;
-      }
+      _model_buckets.add(change.second, change.first);
+      _model_and_wmo_doodad_buckets.add(change.second, change.first);
     }
-  });
+    else
+    {
+      _model_buckets.remove(change.first);
+      _model_and_wmo_doodad_buckets.remove(change.first);
+    }
+  }
 
+  for (auto const& change : wmo_changes)
+  {
+    remove_wmo_doodads(change.first);
 
-  _last_unloaded_doodad_check = 0;
+    if (change.second)
+    {
+      _wmo_buckets.add(change.second, change.first);
+    }
+    else
+    {
+      _wmo_buckets.remove(change.first);
+      _wmos_with_skybox.erase ( std::remove(_wmos_with_skybox.begin(), _wmos_with_skybox.end(), change.first)
+                              , _wmos_with_skybox.end()
+                              );
+    }
+  }
 
-  _model_instance_storage.for_each_wmo_instance([&](WMOInstance& wmo_instance)
+  // only the instances still stored can be accessed
+  for (auto const& change : m2_changes)
   {
-    _wmos_by_filename[wmo_instance.wmo->filename].push_back(&wmo_instance);
+    // to make sure the transform matrix are up to date
+    if (change.second && _model_buckets.contains(change.first) && change.first->need_recalc_extents())
+    {
+      change.first->recalcExtents();
+    }
+  }
 
-    if (wmo_instance.wmo->skybox)
+  for (auto const& change : wmo_changes)
+  {
+    if (change.second && _wmo_buckets.contains(change.first))
     {
-      _wmos_with_skybox.push_back(&wmo_instance);
+      update_wmo_instance(change.first);
     }
+  }
+
+  _model_culling_outdated = true;
+  _wmo_culling_outdated = true;
 
-    if (wmo_instance.need_recalc_extents())
+  return true;
+}
+
+void World::update_wmo_instances()
+{
+  for (auto const& it : _wmo_buckets)
+  {
+    for (WMOInstance* wmo : it.second)
     {
-      wmo_instance.recalcExtents();
+      update_wmo_instance(wmo);
     }
+  }
+
+  // some instances may need their extents to be recalculated
+  _model_culling_outdated = true;
+  _wmo_culling_outdated = true;
+  _last_unloaded_doodad_check = 0;
+
+  need_model_updates = false;
+}
+
+void World::update_loading_wmo_instances()
+{
+  // updating them changes the set
+  std::vector<WMOInstance*> const wmos(_wmos_still_loading.begin(), _wmos_still_loading.end());
+
+  for (WMOInstance* wmo : wmos)
+  {
+    update_wmo_instance(wmo);
+  }
+
+  _last_unloaded_doodad_check = 0;
+}
+
+void World::update_wmo_instance(WMOInstance* wmo_instance)
+{
+  // the doodads are recreated when the doodad set changes
+  remove_wmo_doodads(wmo_instance);
+
+  bool still_loading = !wmo_instance->wmo->finishedLoading();
+
+  if (wmo_instance->need_recalc_extents())
+  {
+    wmo_instance->recalcExtents();
+  }
 
-    if(wmo_instance.need_doodads_update())
+  if(wmo_instance->need_doodads_update())
+  {
+    wmo_instance->update_doodads();
+  }
+
+  if ( !still_loading && wmo_instance->wmo->skybox
+    && std::find(_wmos_with_skybox.begin(), _wmos_with_skybox.end(), wmo_instance) == _wmos_with_skybox.end()
+     )
+  {
+    _wmos_with_skybox.push_back(wmo_instance);
+  }
+
+  std::vector<ModelInstance*>& doodads = _doodads_per_wmo[wmo_instance];
+
+  for (auto& doodad : wmo_instance->get_current_doodads())
+  {
+    if (!doodad->model->finishedLoading())
     {
-      wmo_instance.update_doodads();
+      still_loading = true;
+      continue;
     }
 
-    for (auto& doodad : wmo_instance.get_current_doodads())
+    _wmo_doodad_buckets.add(doodad->model.get(), doodad);
+    _model_and_wmo_doodad_buckets.add(doodad->model.get(), doodad);
+    doodads.push_back(doodad);
+
+    if (doodad->need_matrix_update())
     {
-      if (!doodad->model->finishedLoading())
-      {
-        _models_still_loading = true;
-        continue;
-      }
+      doodad->update_transform_matrix_wmo(wmo_instance);
+    }
+  }
 
-      _wmo_doodads_by_filename[doodad->model->filename].push_back(doodad);
-      _models_by_filename_with_wmo_doodads[doodad->model->filename].push_back(doodad);
+  if (still_loading)
+  {
+    _wmos_still_loading.emplace(wmo_instance);
+  }
+}
 
-      if (doodad->need_matrix_update())
-      {
-        doodad->update_transform_matrix_wmo(&wmo_instance);
-      }
+void World::remove_wmo_doodads(WMOInstance* wmo_instance)
+{
+  auto it = _doodads_per_wmo.find(wmo_instance);
+
+  if (it != _doodads_per_wmo.end())
+  {
+    for (ModelInstance* doodad : it->second)
+    {
+      _wmo_doodad_buckets.remove(doodad);
+      _model_and_wmo_doodad_buckets.remove(doodad);
     }
-  });
 
-  need_model_updates = false;
+    _doodads_per_wmo.erase(it);
+  }
+
+  _wmos_still_loading.erase(wmo_instance);
 }
 
 void World::select_chunks_in_range(math::vector_3d const& pos, float radius, bool square_select, bool deselect, noggit::chunk_mover& chunk_mover)
@@ -11,8 +11,13 @@
 #include <noggit/Selection.h>
 #include <noggit/Sky.h> // Skies, OutdoorLighting, OutdoorLightStats
 #include <noggit/WMO.h> // WMOManager
+#include <noggit/editor_settings.hpp>
+#include <noggit/instance_buckets.hpp>
+#include <noggit/instance_culling.hpp>
 #include <noggit/map_horizon.h>
 #include <noggit/map_index.hpp>
+#include <noggit/published.hpp>
+#include <noggit/tile_dirty_set.hpp>
 #include <noggit/tile_index.hpp>
 #include <noggit/texture_array_handler.hpp>
 #include <noggit/tileset_array_handler.hpp>
@@ -26,6 +31,7 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -49,13 +55,29 @@ class World
   int _model_display_mode = 0;
 
   std::vector<WMOInstance*> _wmos_with_skybox;
-  std::unordered_map<std::string, std::vector<WMOInstance*>> _wmos_by_filename;
-  std::unordered_map<std::string, std::vector<ModelInstance*>> _models_by_filename;
-  std::unordered_map<std::string, std::vector<ModelInstance*>> _wmo_doodads_by_filename;
-  std::unordered_map<std::string, std::vector<ModelInstance*>> _models_by_filename_with_wmo_doodads;
+  // the instances drawn with each model/wmo, updated with the instances
+  // added and removed from the storage instead of being rebuilt
+  noggit::instance_buckets<WMO, WMOInstance> _wmo_buckets;
+  noggit::instance_buckets<Model, ModelInstance> _model_buckets;
+  noggit::instance_buckets<Model, ModelInstance> _wmo_doodad_buckets;
+  noggit::instance_buckets<Model, ModelInstance> _model_and_wmo_doodad_buckets;
+  std::unordered_map<WMOInstance*, std::vector<ModelInstance*>> _doodads_per_wmo;
+  // wmos whose model or doodads aren't loaded yet, checked again now and then
+  std::unordered_set<WMOInstance*> _wmos_still_loading;
 
   std::vector<std::pair<wmo_liquid*, math::matrix_4x4>> _wmo_liquids_to_draw;
 
+  // bounding spheres of the drawn instances, gathered again only when
+  // the instance lists change so that moving the camera only culls
+  noggit::instance_culling _model_culling {true};
+  noggit::instance_culling _wmo_culling {false};
+  std::vector<std::vector<ModelInstance*> const*> _model_culling_groups;
+  std::vector<std::vector<WMOInstance*> const*> _wmo_culling_groups;
+  std::vector<std::size_t> _model_culling_sizes;
+  std::vector<std::size_t> _wmo_culling_sizes;
+  bool _model_culling_outdated = true;
+  bool _wmo_culling_outdated = true;
+
   noggit::world_model_instances_storage _model_instance_storage;
   noggit::world_tile_update_queue _tile_update_queue;
 
@@ -145,6 +167,8 @@ class World
             , int water_layer
             , display_mode display
             );
+  //! what the last draw() uploaded of the terrain's chunks
+  noggit::upload_counters const& terrain_uploads() const { return _terrain_uploads; }
 
   unsigned int getAreaID (math::vector_3d const&);
   void setAreaID(math::vector_3d const& pos, int id, bool adt);
@@ -233,6 +257,15 @@ class World
                                  , Fun&& /* MapChunk* -> bool changed */
                                  , Post&& /* MapChunk* -> void; called for all changed chunks */
                                  );
+  // same, but with parallel chunk edits enabled in the settings fun runs
+  // for several chunks at once and must only touch the chunk it is given,
+  // post and flagging the tiles as changed happen afterwards, serially
+  template<typename Fun, typename Post>
+    bool edit_chunks_in_range ( math::vector_3d const& pos
+                              , float radius
+                              , Fun&& /* MapChunk* -> bool changed */
+                              , Post&& /* MapChunk* -> void; called for all changed chunks */
+                              );
   template<typename Fun>
     void for_all_chunks_on_tile (math::vector_3d const& pos, Fun&&);
 
@@ -395,6 +428,8 @@ class World
   math::vector_3d const& vertexCenter();
 
   void recalc_norms (MapChunk*) const;
+  // on all cores, every chunk's normals only depend on heights
+  void recalc_norms (std::vector<MapChunk*> const& chunks) const;
 
   bool need_model_updates = false;
 
@@ -407,11 +442,18 @@ class World
                      );
 
 
-  void update_models_by_filename();
+  // apply the instances added and removed since the last call to the
+  // buckets, return whether there was any
+  bool update_instance_buckets();
+  // update the doodads of every wmo, after a doodad set change for example
+  void update_wmo_instances();
+  void update_loading_wmo_instances();
+  // the wmo must be alive, the one to remove may already be destroyed
+  void update_wmo_instance(WMOInstance* wmo);
+  void remove_wmo_doodads(WMOInstance* wmo);
 
   bool _need_wmo_liquid_update = true;
 
-  bool _models_still_loading = true;
   int _last_unloaded_doodad_check = 0;
 
   std::set<MapChunk*>& vertexBorderChunks();
@@ -429,6 +471,9 @@ class World
   bool _display_initialized = false;
 
   float _view_distance;
+  bool _need_wireframe_settings_update = true;
+
+  noggit::upload_counters _terrain_uploads;
 
   std::unique_ptr<opengl::program> _mcnk_program;;
   std::unique_ptr<opengl::program> _mfbo_program;
@@ -444,4 +489,6 @@ class World
   opengl::primitives::square _square_render;
 
   boost::optional<liquid_render> _liquid_render = boost::none;
+
+  noggit::published<noggit::editor_settings>::subscription _settings_subscription;
 };
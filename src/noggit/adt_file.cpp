@@ -0,0 +1,379 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/adt_file.hpp>
+
+#include <util/chunk_writer.hpp>
+
+#include <stdexcept>
+
+namespace noggit
+{
+  namespace adt
+  {
+    namespace
+    {
+      using util::chunk_writer;
+
+      // MHDR offsets are relative to the MHDR's data
+      constexpr std::size_t mhdr_data_position = 0x14;
+
+      std::size_t names_size (std::vector<std::string> const& names)
+      {
+        std::size_t size (0);
+        for (auto const& name : names)
+        {
+          size += name.size() + 1;
+        }
+        return size;
+      }
+
+      std::size_t data_size (mh2o_layer const& layer)
+      {
+        return (layer.mask ? sizeof (std::uint64_t) : 0)
+          + layer.heights.size() * sizeof (float)
+          + layer.uvs.size() * sizeof (mh2o_uv)
+          + layer.depths.size() * sizeof (std::uint8_t);
+      }
+
+      std::size_t data_size (mh2o_chunk const& chunk)
+      {
+        if (chunk.layers.empty())
+        {
+          return 0;
+        }
+
+        std::size_t size ( (chunk.attributes ? sizeof (MH2O_Attributes) : 0)
+                         + chunk.layers.size() * sizeof (MH2O_Information)
+                         );
+        for (auto const& layer : chunk.layers)
+        {
+          size += data_size (layer);
+        }
+        return size;
+      }
+
+      std::size_t mh2o_size (std::vector<mh2o_chunk> const& water)
+      {
+        std::size_t size (water.size() * sizeof (MH2O_Header));
+        for (auto const& chunk : water)
+        {
+          size += data_size (chunk);
+        }
+        return size;
+      }
+
+      std::size_t alphamaps_size (mcnk const& chunk)
+      {
+        std::size_t size (0);
+        for (auto const& alphamap : chunk.alphamaps)
+        {
+          size += alphamap.size();
+        }
+        return size;
+      }
+
+      //! chunk's header as written, returns the MCNK's data size
+      std::size_t layout (mcnk const& chunk, MapChunkHeader& header)
+      {
+        header = chunk.header;
+
+        // relative to the MCNK's chunk header
+        std::size_t offset (chunk_writer::chunk_size (sizeof (MapChunkHeader)));
+
+        header.ofsHeight = offset;
+        offset += chunk_writer::chunk_size (sizeof (chunk.heights));
+
+        header.ofsMCCV = chunk.vertex_colors ? offset : 0;
+        if (chunk.vertex_colors)
+        {
+          offset += chunk_writer::chunk_size (sizeof (*chunk.vertex_colors));
+        }
+
+        header.ofsNormal = offset;
+        // followed by 13 unknown bytes, like blizzard's
+        offset += chunk_writer::chunk_size (sizeof (chunk.normals)) + 13;
+
+        header.ofsLayer = offset;
+        header.nLayers = chunk.layers.size();
+        offset += chunk_writer::chunk_size (chunk.layers.size() * sizeof (ENTRY_MCLY));
+
+        header.ofsRefs = offset;
+        header.nDoodadRefs = chunk.doodad_refs.size();
+        header.nMapObjRefs = chunk.object_refs.size();
+        offset += chunk_writer::chunk_size
+          ((chunk.doodad_refs.size() + chunk.object_refs.size()) * sizeof (std::uint32_t));
+
+        header.ofsShadow = chunk.shadow ? offset : 0;
+        header.sizeShadow = chunk.shadow ? sizeof (*chunk.shadow) : 0;
+        if (chunk.shadow)
+        {
+          offset += chunk_writer::chunk_size (sizeof (*chunk.shadow));
+        }
+
+        header.ofsAlpha = offset;
+        header.sizeAlpha = chunk_writer::chunk_size (alphamaps_size (chunk));
+        offset += header.sizeAlpha;
+
+        //! \todo Is this still 8 if no chunk is present? Or did they correct that?
+        header.ofsLiquid = 0;
+        header.sizeLiquid = chunk_writer::chunk_size (0);
+        if (chunk.liquids)
+        {
+          header.ofsLiquid = offset;
+          header.sizeLiquid = chunk_writer::chunk_size (chunk.liquids->size() * sizeof (mclq));
+          offset += header.sizeLiquid;
+        }
+
+        //! \todo  Implement sound emitter support. Or not.
+        header.ofsSndEmitters = offset;
+        header.nSndEmitters = 0;
+        offset += chunk_writer::chunk_size (0);
+
+        return offset - chunk_writer::header_size;
+      }
+
+      void write_mh2o_data (chunk_writer& writer, mh2o_chunk const& chunk, std::size_t base)
+      {
+        if (chunk.layers.empty())
+        {
+          return;
+        }
+
+        if (chunk.attributes)
+        {
+          writer.value (*chunk.attributes);
+        }
+
+        std::size_t offset ( writer.position() - base
+                           + chunk.layers.size() * sizeof (MH2O_Information)
+                           );
+
+        for (auto const& layer : chunk.layers)
+        {
+          MH2O_Information information (layer.information);
+
+          information.ofsInfoMask = layer.mask ? offset : 0;
+          if (layer.mask)
+          {
+            offset += sizeof (std::uint64_t);
+          }
+          information.ofsHeightMap = layer.has_height_map_offset ? offset : 0;
+          offset += data_size (layer) - (layer.mask ? sizeof (std::uint64_t) : 0);
+
+          writer.value (information);
+        }
+
+        for (auto const& layer : chunk.layers)
+        {
+          if (layer.mask)
+          {
+            writer.value (*layer.mask);
+          }
+          writer.values (layer.heights);
+          writer.values (layer.uvs);
+          writer.values (layer.depths);
+        }
+      }
+
+      void write_mh2o (chunk_writer& writer, std::vector<mh2o_chunk> const& water)
+      {
+        writer.chunk_header ('MH2O', mh2o_size (water));
+
+        std::size_t const base (writer.position());
+        std::size_t offset (water.size() * sizeof (MH2O_Header));
+
+        for (auto const& chunk : water)
+        {
+          MH2O_Header header;
+
+          if (!chunk.layers.empty())
+          {
+            header.nLayers = chunk.layers.size();
+            header.ofsRenderMask = chunk.attributes ? offset : 0;
+            header.ofsInformation = offset + (chunk.attributes ? sizeof (MH2O_Attributes) : 0);
+            offset += data_size (chunk);
+          }
+
+          writer.value (header);
+        }
+
+        for (auto const& chunk : water)
+        {
+          write_mh2o_data (writer, chunk, base);
+        }
+      }
+
+      void write_mcnk (chunk_writer& writer, mcnk const& chunk)
+      {
+        MapChunkHeader header;
+        writer.chunk_header ('MCNK', layout (chunk, header));
+        writer.value (header);
+
+        writer.chunk_header ('MCVT', sizeof (chunk.heights));
+        writer.value (chunk.heights);
+
+        if (chunk.vertex_colors)
+        {
+          writer.chunk_header ('MCCV', sizeof (*chunk.vertex_colors));
+          writer.value (*chunk.vertex_colors);
+        }
+
+        writer.chunk_header ('MCNR', sizeof (chunk.normals));
+        writer.value (chunk.normals);
+        writer.zeros (13);
+
+        writer.chunk_header ('MCLY', chunk.layers.size() * sizeof (ENTRY_MCLY));
+        std::uint32_t alpha_offset (0);
+        for (std::size_t i (0); i < chunk.layers.size(); ++i)
+        {
+          ENTRY_MCLY layer (chunk.layers[i]);
+          layer.ofsAlpha = alpha_offset;
+          if (i > 0 && i <= chunk.alphamaps.size())
+          {
+            alpha_offset += chunk.alphamaps[i - 1].size();
+          }
+          writer.value (layer);
+        }
+
+        writer.chunk_header
+          ('MCRF', (chunk.doodad_refs.size() + chunk.object_refs.size()) * sizeof (std::uint32_t));
+        writer.values (chunk.doodad_refs);
+        writer.values (chunk.object_refs);
+
+        if (chunk.shadow)
+        {
+          writer.chunk_header ('MCSH', sizeof (*chunk.shadow));
+          writer.value (*chunk.shadow);
+        }
+
+        writer.chunk_header ('MCAL', alphamaps_size (chunk));
+        for (auto const& alphamap : chunk.alphamaps)
+        {
+          writer.values (alphamap);
+        }
+
+        if (chunk.liquids)
+        {
+          // size seems to be 0 in vanilla adts in the mclq chunk's header and set right in the mcnk header (layer_size * n_layer + 8)
+          writer.chunk_header ('MCLQ', 0);
+          writer.values (*chunk.liquids);
+        }
+
+        writer.chunk_header ('MCSE', 0);
+      }
+
+      void write_names (chunk_writer& writer, std::uint32_t magic, std::vector<std::string> const& names)
+      {
+        writer.chunk_header (magic, names_size (names));
+        for (auto const& name : names)
+        {
+          writer.bytes (name.c_str(), name.size() + 1);
+        }
+      }
+
+      void write_name_offsets (chunk_writer& writer, std::uint32_t magic, std::vector<std::string> const& names)
+      {
+        writer.chunk_header (magic, names.size() * sizeof (std::uint32_t));
+        std::uint32_t offset (0);
+        for (auto const& name : names)
+        {
+          writer.value (offset);
+          offset += name.size() + 1;
+        }
+      }
+    }
+
+    std::vector<char> write (tile const& adt)
+    {
+      if (adt.chunks.size() != 16 * 16 || (!adt.water.empty() && adt.water.size() != 16 * 16))
+      {
+        throw std::logic_error ("adt::write: a tile has exactly 16 * 16 chunks");
+      }
+
+      // first pass: where everything goes
+      MHDR mhdr {};
+      MCIN mcin {};
+
+      std::size_t position (chunk_writer::chunk_size (sizeof (std::uint32_t)));
+      auto const place
+        ( [&] (std::uint32_t& offset, std::size_t data_size)
+          {
+            offset = position - mhdr_data_position;
+            position += chunk_writer::chunk_size (data_size);
+          }
+        );
+
+      mhdr.flags = adt.flags;
+      position += chunk_writer::chunk_size (sizeof (MHDR));
+      place (mhdr.mcin, sizeof (MCIN));
+      place (mhdr.mtex, names_size (adt.textures));
+      place (mhdr.mmdx, names_size (adt.models));
+      place (mhdr.mmid, adt.models.size() * sizeof (std::uint32_t));
+      place (mhdr.mwmo, names_size (adt.objects));
+      place (mhdr.mwid, adt.objects.size() * sizeof (std::uint32_t));
+      place (mhdr.mddf, adt.doodads.size() * sizeof (ENTRY_MDDF));
+      place (mhdr.modf, adt.wmos.size() * sizeof (ENTRY_MODF));
+
+      if (!adt.water.empty())
+      {
+        place (mhdr.mh2o, mh2o_size (adt.water));
+      }
+
+      MapChunkHeader header;
+      for (std::size_t i (0); i < adt.chunks.size(); ++i)
+      {
+        std::size_t const size (chunk_writer::chunk_size (layout (adt.chunks[i], header)));
+        mcin.mEntries[i].offset = position;
+        mcin.mEntries[i].size = size;
+        position += size;
+      }
+
+      if (adt.flight_bounds)
+      {
+        place (mhdr.mfbo, sizeof (*adt.flight_bounds));
+      }
+
+      // second pass: front to back
+      chunk_writer writer (position);
+
+      writer.chunk_header ('MVER', sizeof (std::uint32_t));
+      writer.value (std::uint32_t (18));
+
+      writer.chunk_header ('MHDR', sizeof (MHDR));
+      writer.value (mhdr);
+
+      writer.chunk_header ('MCIN', sizeof (MCIN));
+      writer.value (mcin);
+
+      write_names (writer, 'MTEX', adt.textures);
+      write_names (writer, 'MMDX', adt.models);
+      write_name_offsets (writer, 'MMID', adt.models);
+      write_names (writer, 'MWMO', adt.objects);
+      write_name_offsets (writer, 'MWID', adt.objects);
+
+      writer.chunk_header ('MDDF', adt.doodads.size() * sizeof (ENTRY_MDDF));
+      writer.values (adt.doodads);
+
+      writer.chunk_header ('MODF', adt.wmos.size() * sizeof (ENTRY_MODF));
+      writer.values (adt.wmos);
+
+      if (!adt.water.empty())
+      {
+        write_mh2o (writer, adt.water);
+      }
+
+      for (auto const& chunk : adt.chunks)
+      {
+        write_mcnk (writer, chunk);
+      }
+
+      if (adt.flight_bounds)
+      {
+        writer.chunk_header ('MFBO', sizeof (*adt.flight_bounds));
+        writer.value (*adt.flight_bounds);
+      }
+
+      return writer.finish();
+    }
+  }
+}
@@ -0,0 +1,82 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/MapHeaders.h>
+
+#include <boost/optional.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  //! The contents of an ADT file as they end up on disk, gathered from
+  //! the editor's tile, chunks and liquids, and the writer for them.
+  //! Offsets, counts and sizes are left to the writer: it measures the
+  //! whole tile first and then writes it front to back into one buffer.
+  namespace adt
+  {
+    struct mh2o_layer
+    {
+      //! ofsInfoMask and ofsHeightMap are filled in by the writer
+      MH2O_Information information;
+      boost::optional<std::uint64_t> mask;
+      //! fatigue layers without any vertex data point nowhere
+      bool has_height_map_offset = true;
+      std::vector<float> heights;
+      std::vector<mh2o_uv> uvs;
+      std::vector<std::uint8_t> depths;
+    };
+
+    struct mh2o_chunk
+    {
+      //! not written for fatigue chunks
+      boost::optional<MH2O_Attributes> attributes;
+      //! none: the chunk has no liquid
+      std::vector<mh2o_layer> layers;
+    };
+
+    struct mcnk
+    {
+      static constexpr std::size_t vertex_count = 9 * 9 + 8 * 8;
+
+      //! counts, offsets and sizes are filled in by the writer
+      MapChunkHeader header;
+      std::array<float, vertex_count> heights;
+      boost::optional<std::array<std::uint32_t, vertex_count>> vertex_colors;
+      std::array<char, vertex_count * 3> normals;
+      //! ofsAlpha is filled in by the writer
+      std::vector<ENTRY_MCLY> layers;
+      //! one for every layer but the first
+      std::vector<std::vector<std::uint8_t>> alphamaps;
+      std::vector<std::uint32_t> doodad_refs;
+      std::vector<std::uint32_t> object_refs;
+      boost::optional<std::array<std::uint8_t, 0x200>> shadow;
+      //! only in the MCLQ variant, which has the chunk even when empty
+      boost::optional<std::vector<mclq>> liquids;
+    };
+
+    struct tile
+    {
+      std::uint32_t flags = 0;
+      std::vector<std::string> textures;
+      //! ENTRY_MDDF::nameID and ENTRY_MODF::nameID index these
+      std::vector<std::string> models;
+      std::vector<std::string> objects;
+      std::vector<ENTRY_MDDF> doodads;
+      std::vector<ENTRY_MODF> wmos;
+      //! empty or one per chunk: without it, there is no MH2O chunk
+      std::vector<mh2o_chunk> water;
+      //! 16 * 16, row by row
+      std::vector<mcnk> chunks;
+      //! MFBO: 9 maximum then 9 minimum heights
+      boost::optional<std::array<std::int16_t, 18>> flight_bounds;
+    };
+
+    std::vector<char> write (tile const&);
+  }
+}
@@ -0,0 +1,401 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/alpha_painting.hpp>
+#include <noggit/MapHeaders.h>
+#include <util/sse.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+std::uint16_t tmp_edit_alpha_values::to_fixed (float alpha)
+{
+  return static_cast<std::uint16_t> (std::lround (std::max (0.f, std::min (255.f, alpha)) * one));
+}
+
+namespace noggit
+{
+  namespace
+  {
+    using texel_weights = std::array<std::int32_t, 64>;
+
+    struct brush
+    {
+      brush (float radius_, float inner_radius, float pressure)
+        : radius (radius_)
+        , inner (inner_radius)
+        , inverse_outer (radius_ > inner_radius ? 1.f / (radius_ - inner_radius) : 0.f)
+        , scale (pressure * 32768.f)
+      {}
+
+      float radius;
+      float inner;
+      float inverse_outer;
+      //! pressure in 1.15 fixed point
+      float scale;
+    };
+
+    // squared distances along one axis from the point to the texels of a
+    // row, like misc::getShortestDist. The texel positions are summed up
+    // the same way TextureSet::paintTexture always did.
+    std::array<float, 64> squared_distances (float base, float point)
+    {
+      std::array<float, 64> result;
+      float position (base);
+
+      for (std::size_t i (0); i < 64; ++i)
+      {
+        float nearest;
+        if (point >= position && point < position + TEXDETAILSIZE)
+        {
+          nearest = point;
+        }
+        else
+        {
+          nearest = position < point ? position + TEXDETAILSIZE : position;
+        }
+
+        float const diff (nearest - point);
+        result[i] = diff * diff;
+        position += TEXDETAILSIZE;
+      }
+
+      return result;
+    }
+
+    // brush weight of every texel of a row in 1.15 fixed point, -1 for
+    // the ones out of range
+    void row_weights_scalar ( std::array<float, 64> const& dx2
+                            , float dz2
+                            , brush const& b
+                            , texel_weights& weights
+                            )
+    {
+      for (std::size_t i (0); i < 64; ++i)
+      {
+        float const dist (std::sqrt (dx2[i] + dz2));
+        float const falloff (std::max (0.f, std::min (1.f, 1.f - (dist - b.inner) * b.inverse_outer)));
+
+        weights[i] = dist <= b.radius ? static_cast<std::int32_t> (std::nearbyint (falloff * b.scale)) : -1;
+      }
+    }
+
+#ifdef NOGGIT_SSE
+    void row_weights_sse ( std::array<float, 64> const& dx2
+                         , float dz2
+                         , brush const& b
+                         , texel_weights& weights
+                         )
+    {
+      __m128 const dz (_mm_set1_ps (dz2));
+      __m128 const radius (_mm_set1_ps (b.radius));
+      __m128 const inner (_mm_set1_ps (b.inner));
+      __m128 const inverse_outer (_mm_set1_ps (b.inverse_outer));
+      __m128 const scale (_mm_set1_ps (b.scale));
+      __m128 const zero (_mm_setzero_ps());
+      __m128 const one (_mm_set1_ps (1.f));
+      __m128i const out_of_range (_mm_set1_epi32 (-1));
+
+      for (std::size_t i (0); i < 64; i += 4)
+      {
+        __m128 const dist (_mm_sqrt_ps (_mm_add_ps (_mm_loadu_ps (&dx2[i]), dz)));
+        __m128 const falloff
+          (_mm_max_ps (zero, _mm_min_ps (one, _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (dist, inner), inverse_outer)))));
+        __m128i const weight (_mm_cvtps_epi32 (_mm_mul_ps (falloff, scale)));
+        __m128i const in_range (_mm_castps_si128 (_mm_cmple_ps (dist, radius)));
+
+        _mm_storeu_si128 ( reinterpret_cast<__m128i*> (&weights[i])
+                         , _mm_or_si128 (_mm_and_si128 (in_range, weight), _mm_andnot_si128 (in_range, out_of_range))
+                         );
+      }
+    }
+#endif
+
+    // the four layers of a texel next to each other
+    using texel_alphas = std::array<std::int32_t, 4>;
+
+    // the rare cases of TextureSet::paintTexture: the other layers of
+    // the texel amount to less than 1
+    void paint_over_nothing ( texel_alphas& values
+                            , std::size_t texture_count
+                            , std::size_t layer
+                            , std::int32_t change
+                            )
+    {
+      if (change > 0)
+      {
+        for (std::size_t l (0); l < texture_count; ++l)
+        {
+          values[l] = l == layer ? tmp_edit_alpha_values::full : 0;
+        }
+        return;
+      }
+
+      // take the change from the first other layer, clear the rest
+      bool change_applied (false);
+
+      for (std::size_t l (0); l < texture_count; ++l)
+      {
+        if (l == layer)
+        {
+          values[l] += change;
+        }
+        else
+        {
+          if (!change_applied)
+          {
+            values[l] -= change;
+          }
+          else
+          {
+            values[layer] += values[l];
+            values[l] = 0;
+          }
+
+          change_applied = true;
+        }
+      }
+    }
+
+    // failsafe in case the alphas of the texel didn't sum up to 255 to
+    // begin with
+    void rescale (texel_alphas& values, std::size_t layer)
+    {
+      std::int32_t const full (tmp_edit_alpha_values::full);
+      std::int32_t total (0);
+      for (std::int32_t value : values)
+      {
+        total += value;
+      }
+
+      if (total <= 0)
+      {
+        values.fill (0);
+        values[layer] = full;
+        return;
+      }
+
+      std::int32_t scaled_total (0);
+      for (std::int32_t& value : values)
+      {
+        value = static_cast<std::int32_t> (static_cast<std::int64_t> (value) * full / total);
+        scaled_total += value;
+      }
+      values[layer] += full - scaled_total;
+    }
+
+    std::int32_t clamp_alpha (std::int32_t value)
+    {
+      return std::max (0, std::min<std::int32_t> (tmp_edit_alpha_values::full, value));
+    }
+
+    // one texel the way TextureSet::paintTexture always blended the
+    // layers, in fixed point. The painted layer is kept apart and the
+    // others are only ever indexed by constants: storing to values[layer]
+    // and summing the layers right after made every texel wait for the
+    // store to reach the cache.
+    bool paint_texel ( texel_alphas& texel
+                     , std::size_t texture_count
+                     , std::size_t layer
+                     , std::int32_t target
+                     , std::int32_t weight
+                     )
+    {
+      std::int32_t const one (tmp_edit_alpha_values::one);
+      std::int32_t const full (tmp_edit_alpha_values::full);
+
+      std::int32_t const current (texel[layer]);
+
+      if (current == target)
+      {
+        return false;
+      }
+
+      std::int32_t const others (texel[0] + texel[1] + texel[2] + texel[3] - current);
+
+      // rounded away from 0, the floats never ignored a change either
+      std::int64_t const scaled_change (static_cast<std::int64_t> (target - current) * weight);
+      std::int32_t change
+        (static_cast<std::int32_t> ((scaled_change + (scaled_change > 0 ? 32767 : -32767)) / 32768));
+
+      // alpha too low, set it to 0 directly
+      if (change < 0 && current + change < one)
+      {
+        change = -current;
+      }
+
+      if (others < one)
+      {
+        texel_alphas values (texel);
+        paint_over_nothing (values, texture_count, layer, change);
+        rescale (values, layer);
+
+        for (std::size_t n (0); n < 4; ++n)
+        {
+          texel[n] = clamp_alpha (values[n]);
+        }
+        return true;
+      }
+
+      // the share of its alpha every other layer gives, in 16.16 fixed
+      // point: one division per texel instead of one per layer. Any
+      // increase of the layer takes something from the others, like it
+      // did with floats, so that an alpha of exactly 1 is cleared below.
+      std::uint32_t const magnitude (static_cast<std::uint32_t> (change < 0 ? -change : change) << 16);
+      std::uint32_t const divisor (static_cast<std::uint32_t> (others));
+      std::uint64_t const share (change > 0 ? (magnitude + divisor - 1) / divisor : magnitude / divisor);
+      std::uint64_t const round_up (change > 0 ? 0xffff : 0);
+      std::int32_t const sign (change > 0 ? -1 : 1);
+
+      std::int32_t painted (current + change);
+      std::int32_t total_others (0);
+      texel_alphas values;
+
+      for (std::size_t l (0); l < 4; ++l)
+      {
+        std::uint64_t const given ((share * static_cast<std::uint32_t> (texel[l]) + round_up) >> 16);
+        std::int32_t const value (texel[l] + sign * static_cast<std::int32_t> (given));
+        bool const other (l != layer && l < texture_count);
+
+        // clear values too low to be visible
+        bool const cleared (other && value < one);
+        painted += cleared ? value : 0;
+        values[l] = !other ? texel[l] : cleared ? 0 : value;
+        total_others += l != layer ? values[l] : 0;
+      }
+
+      // what got lost rounding the divisions goes to the painted layer
+      std::int32_t const residue (full - total_others - painted);
+
+      if (painted + residue < 0)
+      {
+        values[layer] = painted;
+        rescale (values, layer);
+        painted = values[layer];
+      }
+      else
+      {
+        painted += residue;
+      }
+
+      for (std::size_t n (0); n < 4; ++n)
+      {
+        texel[n] = clamp_alpha (n == layer ? painted : values[n]);
+      }
+
+      return true;
+    }
+
+    template<typename RowWeights>
+      bool paint ( tmp_edit_alpha_values& amaps
+                 , std::size_t texture_count
+                 , std::size_t layer
+                 , float xbase
+                 , float zbase
+                 , float x
+                 , float z
+                 , float radius
+                 , float inner_radius
+                 , float strength
+                 , float pressure
+                 , RowWeights&& row_weights
+                 )
+    {
+      std::array<float, 64> const dx2 (squared_distances (xbase, x));
+      std::array<float, 64> const dz2 (squared_distances (zbase, z));
+      brush const b (radius, inner_radius, pressure);
+      std::int32_t const target (tmp_edit_alpha_values::to_fixed (strength));
+
+      texel_weights weights;
+      bool changed (false);
+
+      for (std::size_t j (0); j < 64; ++j)
+      {
+        // no texel of the row is in range
+        if (std::sqrt (dz2[j]) > radius)
+        {
+          continue;
+        }
+
+        row_weights (dx2, dz2[j], b, weights);
+
+        // the four layers of the row next to each other, blending them in
+        // place, 8 KiB apart, is measurably slower
+        std::array<texel_alphas, 64> row;
+        for (std::size_t n (0); n < 4; ++n)
+        {
+          for (std::size_t i (0); i < 64; ++i)
+          {
+            row[i][n] = amaps.map[n][i + 64 * j];
+          }
+        }
+
+        bool row_changed (false);
+        for (std::size_t i (0); i < 64; ++i)
+        {
+          if (weights[i] >= 0)
+          {
+            row_changed = paint_texel (row[i], texture_count, layer, target, weights[i]) || row_changed;
+          }
+        }
+
+        if (row_changed)
+        {
+          for (std::size_t n (0); n < 4; ++n)
+          {
+            for (std::size_t i (0); i < 64; ++i)
+            {
+              amaps.map[n][i + 64 * j] = static_cast<std::uint16_t> (row[i][n]);
+            }
+          }
+          changed = true;
+        }
+      }
+
+      return changed;
+    }
+  }
+
+  bool paint_alphas_scalar ( tmp_edit_alpha_values& amaps
+                           , std::size_t texture_count
+                           , std::size_t layer
+                           , float xbase
+                           , float zbase
+                           , float x
+                           , float z
+                           , float radius
+                           , float inner_radius
+                           , float strength
+                           , float pressure
+                           )
+  {
+    return paint ( amaps, texture_count, layer, xbase, zbase, x, z
+                 , radius, inner_radius, strength, pressure
+                 , row_weights_scalar
+                 );
+  }
+
+  bool paint_alphas ( tmp_edit_alpha_values& amaps
+                    , std::size_t texture_count
+                    , std::size_t layer
+                    , float xbase
+                    , float zbase
+                    , float x
+                    , float z
+                    , float radius
+                    , float inner_radius
+                    , float strength
+                    , float pressure
+                    )
+  {
+#ifdef NOGGIT_SSE
+    return paint ( amaps, texture_count, layer, xbase, zbase, x, z
+                 , radius, inner_radius, strength, pressure
+                 , row_weights_sse
+                 );
+#else
+    return paint_alphas_scalar ( amaps, texture_count, layer, xbase, zbase, x, z
+                               , radius, inner_radius, strength, pressure
+                               );
+#endif
+  }
+}
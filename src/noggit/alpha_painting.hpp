@@ -0,0 +1,80 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//! The alphas of the four layers of a chunk while it is being edited,
+//! the base layer included, from 0 to 255 in 8.8 fixed point. They are
+//! rounded back into the chunk's alphamaps once the edit is done.
+struct tmp_edit_alpha_values
+{
+  using alpha_layer = std::array<std::uint16_t, 64 * 64>;
+
+  //! an alpha of 1 and of 255
+  static constexpr std::uint16_t one = 256;
+  static constexpr std::uint16_t full = 255 * one;
+
+  // use 4 "alphamaps" for an easier editing
+  std::array<alpha_layer, 4> map;
+
+  alpha_layer& operator[](std::size_t i)
+  {
+    return map.at(i);
+  }
+  alpha_layer const& operator[](std::size_t i) const
+  {
+    return map.at(i);
+  }
+
+  float alpha (std::size_t layer, std::size_t texel) const
+  {
+    return map.at (layer)[texel] / static_cast<float> (one);
+  }
+  void set_alpha (std::size_t layer, std::size_t texel, float value)
+  {
+    map.at (layer)[texel] = to_fixed (value);
+  }
+
+  //! clamped to [0, 255], rounded to the nearest step
+  static std::uint16_t to_fixed (float alpha);
+};
+
+namespace noggit
+{
+  //! TextureSet::paintTexture on the texels of the chunk at xbase, zbase:
+  //! every texel within \a radius of (x, z) moves \a layer towards
+  //! \a strength (0 to 255) by \a pressure times the brush falloff, which
+  //! is 1 up to \a inner_radius and linearly goes down to 0 at \a radius.
+  //! The other ones of the first \a texture_count layers give way in
+  //! proportion to their alpha. Returns false if no texel in range had
+  //! to change.
+  bool paint_alphas ( tmp_edit_alpha_values& amaps
+                    , std::size_t texture_count
+                    , std::size_t layer
+                    , float xbase
+                    , float zbase
+                    , float x
+                    , float z
+                    , float radius
+                    , float inner_radius
+                    , float strength
+                    , float pressure
+                    );
+
+  //! the same without sse, for comparison
+  bool paint_alphas_scalar ( tmp_edit_alpha_values& amaps
+                           , std::size_t texture_count
+                           , std::size_t layer
+                           , float xbase
+                           , float zbase
+                           , float x
+                           , float z
+                           , float radius
+                           , float inner_radius
+                           , float strength
+                           , float pressure
+                           );
+}
@@ -0,0 +1,161 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/alpha_shadow_map.hpp>
+#include <util/sse.hpp>
+
+#include <algorithm>
+
+namespace noggit
+{
+  namespace
+  {
+    std::uint8_t shadow_value (shadow_bits const* shadow, std::size_t texel)
+    {
+      return shadow && (((*shadow)[texel / 64] >> (texel % 64)) & 1) ? 255 : 0;
+    }
+
+    std::uint8_t rounded_alpha (std::uint16_t value)
+    {
+      return static_cast<std::uint8_t>
+        (std::min (255, (value + tmp_edit_alpha_values::one / 2) / tmp_edit_alpha_values::one));
+    }
+
+#ifdef NOGGIT_SSE
+    // 0xff in every byte whose bit of \a bits is set, lowest bit first
+    __m128i expand_bits (std::uint32_t bits)
+    {
+      __m128i const mask (_mm_setr_epi8 (1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128));
+      __m128i const bytes ( _mm_unpacklo_epi64 ( _mm_set1_epi8 (static_cast<char> (bits & 0xff))
+                                               , _mm_set1_epi8 (static_cast<char> ((bits >> 8) & 0xff))
+                                               )
+                          );
+
+      return _mm_cmpeq_epi8 (_mm_and_si128 (bytes, mask), mask);
+    }
+
+    // 16 texels starting at \a texel
+    __m128i shadow_values (shadow_bits const* shadow, std::size_t texel)
+    {
+      return shadow
+        ? expand_bits (static_cast<std::uint32_t> ((*shadow)[texel / 64] >> (texel % 64)))
+        : _mm_setzero_si128();
+    }
+
+    void store_interleaved (std::uint8_t* texels, __m128i r, __m128i g, __m128i b, __m128i a)
+    {
+      __m128i const rg_low (_mm_unpacklo_epi8 (r, g));
+      __m128i const rg_high (_mm_unpackhi_epi8 (r, g));
+      __m128i const ba_low (_mm_unpacklo_epi8 (b, a));
+      __m128i const ba_high (_mm_unpackhi_epi8 (b, a));
+
+      __m128i* out (reinterpret_cast<__m128i*> (texels));
+      _mm_storeu_si128 (out, _mm_unpacklo_epi16 (rg_low, ba_low));
+      _mm_storeu_si128 (out + 1, _mm_unpackhi_epi16 (rg_low, ba_low));
+      _mm_storeu_si128 (out + 2, _mm_unpacklo_epi16 (rg_high, ba_high));
+      _mm_storeu_si128 (out + 3, _mm_unpackhi_epi16 (rg_high, ba_high));
+    }
+
+    __m128i load_alphas (std::uint8_t const* alphas, std::size_t texel)
+    {
+      return alphas
+        ? _mm_loadu_si128 (reinterpret_cast<__m128i const*> (alphas + texel))
+        : _mm_setzero_si128();
+    }
+
+    __m128i load_rounded_alphas (tmp_edit_alpha_values::alpha_layer const& layer, std::size_t texel)
+    {
+      __m128i const half (_mm_set1_epi16 (tmp_edit_alpha_values::one / 2));
+      __m128i const low (_mm_loadu_si128 (reinterpret_cast<__m128i const*> (layer.data() + texel)));
+      __m128i const high (_mm_loadu_si128 (reinterpret_cast<__m128i const*> (layer.data() + texel + 8)));
+
+      return _mm_packus_epi16 ( _mm_srli_epi16 (_mm_adds_epu16 (low, half), 8)
+                              , _mm_srli_epi16 (_mm_adds_epu16 (high, half), 8)
+                              );
+    }
+#endif
+  }
+
+  void pack_alpha_shadow_map_scalar ( std::uint8_t* texels
+                                    , std::array<std::uint8_t const*, 3> const& alphas
+                                    , shadow_bits const* shadow
+                                    )
+  {
+    for (std::size_t i (0); i < 64 * 64; ++i)
+    {
+      for (std::size_t layer (0); layer < 3; ++layer)
+      {
+        texels[i * 4 + layer] = alphas[layer] ? alphas[layer][i] : 0;
+      }
+      texels[i * 4 + 3] = shadow_value (shadow, i);
+    }
+  }
+
+  void pack_alpha_shadow_map_scalar ( std::uint8_t* texels
+                                    , tmp_edit_alpha_values const& alphas
+                                    , shadow_bits const* shadow
+                                    )
+  {
+    for (std::size_t i (0); i < 64 * 64; ++i)
+    {
+      for (std::size_t layer (0); layer < 3; ++layer)
+      {
+        texels[i * 4 + layer] = rounded_alpha (alphas[layer + 1][i]);
+      }
+      texels[i * 4 + 3] = shadow_value (shadow, i);
+    }
+  }
+
+  void pack_alpha_shadow_map ( std::uint8_t* texels
+                             , std::array<std::uint8_t const*, 3> const& alphas
+                             , shadow_bits const* shadow
+                             )
+  {
+#ifdef NOGGIT_SSE
+    for (std::size_t i (0); i < 64 * 64; i += 16)
+    {
+      store_interleaved ( texels + i * 4
+                        , load_alphas (alphas[0], i)
+                        , load_alphas (alphas[1], i)
+                        , load_alphas (alphas[2], i)
+                        , shadow_values (shadow, i)
+                        );
+    }
+#else
+    pack_alpha_shadow_map_scalar (texels, alphas, shadow);
+#endif
+  }
+
+  void pack_alpha_shadow_map ( std::uint8_t* texels
+                             , tmp_edit_alpha_values const& alphas
+                             , shadow_bits const* shadow
+                             )
+  {
+#ifdef NOGGIT_SSE
+    for (std::size_t i (0); i < 64 * 64; i += 16)
+    {
+      store_interleaved ( texels + i * 4
+                        , load_rounded_alphas (alphas[1], i)
+                        , load_rounded_alphas (alphas[2], i)
+                        , load_rounded_alphas (alphas[3], i)
+                        , shadow_values (shadow, i)
+                        );
+    }
+#else
+    pack_alpha_shadow_map_scalar (texels, alphas, shadow);
+#endif
+  }
+
+  std::uint8_t* alpha_shadow_staging::texels (std::size_t chunk_count)
+  {
+    if (_texels.size() < chunk_count * alpha_shadow_map_bytes)
+    {
+      _texels.resize (chunk_count * alpha_shadow_map_bytes);
+    }
+    return _texels.data();
+  }
+
+  void alpha_shadow_staging::release()
+  {
+    std::vector<std::uint8_t>().swap (_texels);
+  }
+}
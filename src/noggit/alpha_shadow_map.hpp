@@ -0,0 +1,59 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/alpha_painting.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace noggit
+{
+  //! bytes of the texels of one chunk in a tile's alpha/shadow texture
+  //! array, 64x64 rgba8
+  constexpr std::size_t alpha_shadow_map_bytes = 4 * 64 * 64;
+
+  //! chunk_shadow::data, one bit per texel, a row per value
+  using shadow_bits = std::array<std::uint64_t, 64>;
+
+  //! The texels of a chunk's layer of the alpha/shadow texture array: the
+  //! alphamaps of the texture layers 1 to 3 in r, g and b, 0 for the null
+  //! ones, and 255 in a where \a shadow, if any, has its bit set.
+  void pack_alpha_shadow_map ( std::uint8_t* texels
+                             , std::array<std::uint8_t const*, 3> const& alphas
+                             , shadow_bits const* shadow
+                             );
+  //! the same from the alphas of a chunk being edited, rounded to the
+  //! nearest step like the alphamaps will be once the edit is done
+  void pack_alpha_shadow_map ( std::uint8_t* texels
+                             , tmp_edit_alpha_values const& alphas
+                             , shadow_bits const* shadow
+                             );
+
+  //! without sse, for comparison
+  void pack_alpha_shadow_map_scalar ( std::uint8_t* texels
+                                    , std::array<std::uint8_t const*, 3> const& alphas
+                                    , shadow_bits const* shadow
+                                    );
+  void pack_alpha_shadow_map_scalar ( std::uint8_t* texels
+                                    , tmp_edit_alpha_values const& alphas
+                                    , shadow_bits const* shadow
+                                    );
+
+  //! Memory the alpha/shadow maps of a tile's chunks are packed into
+  //! before uploading them, kept from one update to the next.
+  class alpha_shadow_staging
+  {
+  public:
+    //! room for the texels of \a chunk_count chunks one after the other,
+    //! valid until the next call
+    std::uint8_t* texels (std::size_t chunk_count);
+    //! gives the memory back, after the whole tile has been uploaded
+    void release();
+
+  private:
+    std::vector<std::uint8_t> _texels;
+  };
+}
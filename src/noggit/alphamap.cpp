@@ -1,10 +1,9 @@
 // This file is part of Noggit3, licensed under GNU General Public License (version 3).
 
 #include <noggit/alphamap.hpp>
+#include <noggit/mcal_compression.hpp>
 #include <opengl/context.hpp>
 
-#include <boost/optional/optional.hpp>
-
 Alphamap::Alphamap()
 {
   reset();
@@ -32,58 +31,18 @@ Alphamap::Alphamap(MPQFile *f, unsigned int flags, bool use_big_alphamaps, bool
   }
 }
 
-namespace
-{
-  struct compressed_mcal_entry
-  {
-    enum mode_t
-    {
-      copy = 0,              // append value[0..count - 1]
-      fill = 1,              // append value[0] count times
-    };
-    uint8_t count : 7;
-    uint8_t mode : 1;
-
-    uint8_t value[];
-  };
-}
-
 void Alphamap::readCompressed(MPQFile *f)
 {
-  // compressed
-  char const* input = f->getPointer();
-
-  for (std::size_t offset_output(0); offset_output < 4096;)
+  auto const result
+    ( noggit::mcal::decompress ( reinterpret_cast<std::uint8_t const*>(f->getPointer())
+                               , f->getSize() - f->getPos()
+                               , amap.data()
+                               )
+    );
+
+  if (!result.valid)
   {
-    compressed_mcal_entry const* e = reinterpret_cast<compressed_mcal_entry const*>(input);
-
-    int count = e->count;
-
-    if (offset_output + count > 4096)
-    {
-      LogError << "Invalid MCAL, uncompressed size is greater than 4096" << std::endl;
-      count = 4096 - offset_output;
-    }
-
-    ++input;
-
-    if (count == 0)
-    {
-      continue;
-    }
-
-    if (e->mode == compressed_mcal_entry::fill)
-    {
-      memset(&amap[offset_output], e->value[0], count);
-      ++input;
-    }
-    else
-    {
-      memcpy(&amap[offset_output], e->value, count);
-      input += count;
-    }
-
-    offset_output += count;
+    LogError << "Invalid MCAL, uncompressed size is not 4096" << std::endl;
   }
 }
 
@@ -155,85 +114,7 @@ const std::uint8_t *Alphamap::getAlpha()
 
 std::vector<uint8_t> Alphamap::compress() const
 {
-  std::vector<uint8_t> data(amap.data(), amap.data() + 4096);
-  auto current (data.begin());
-  auto const end (data.end());
-  int column_pos = 0;
-
-  auto const consume_fill
-  (
-    [&]
-    {
-      int8_t count (0);
-      column_pos %= 64;
-
-      while ((current + 1 < end) && *current == *(current + 1) && column_pos < 63)
-      {
-        ++current;
-        ++count;
-        ++column_pos;
-      }
-
-      // include current (current is incremented in the for loop)
-      if (count)
-      {
-        ++count;
-        ++column_pos;
-      }
-
-      return count;
-    }
-  );
-
-  std::vector<uint8_t> result;
-  boost::optional<std::size_t> current_copy_entry_offset (boost::none);
-  auto const current_copy_entry
-  (
-    [&]
-    {
-      return reinterpret_cast<compressed_mcal_entry*> (&*(result.begin() + *current_copy_entry_offset));
-    }
-  );
-
-  for (; current != end; ++current)
-  {
-    auto const fill (consume_fill());
-    if (fill)
-    {
-      current_copy_entry_offset = boost::none;
-
-      result.emplace_back();
-      result.emplace_back(*current);
-
-      compressed_mcal_entry* e (reinterpret_cast<compressed_mcal_entry*> (&*(result.rbegin() + 1)));
-      e->mode = compressed_mcal_entry::fill;
-      e->count = fill;
-
-      column_pos %= 64;
-    }
-    else
-    {
-      if ( current_copy_entry_offset == boost::none
-          || column_pos == 64
-          )
-      {
-        current_copy_entry_offset = result.size();
-        result.emplace_back();
-        result.emplace_back(*current);
-        current_copy_entry()->mode = compressed_mcal_entry::copy;
-        current_copy_entry()->count = 1;
-
-        column_pos %= 64;
-      }
-      else
-      {
-        result.emplace_back(*current);
-        current_copy_entry()->count++;
-      }
-
-      column_pos++;
-    }
-  }
-
+  std::vector<uint8_t> result(noggit::mcal::max_compressed_size);
+  result.resize(noggit::mcal::compress(amap.data(), result.data()));
   return result;
 }
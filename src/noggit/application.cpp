@@ -35,6 +35,7 @@
 #include <QtGui/QOffscreenSurface>
 #include <QtOpenGL/QGLFormat>
 #include <QtCore/QDir>
+#include <QtCore/QStandardPaths>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QLabel>
@@ -103,6 +104,14 @@ void Noggit::loadMPQs()
     }
   }
 
+  {
+    QString const cache_folder (QStandardPaths::writableLocation (QStandardPaths::CacheLocation));
+    if (!cache_folder.isEmpty())
+    {
+      MPQArchive::useListfileCache (boost::filesystem::path (cache_folder.toStdString()) / "listfile.cache");
+    }
+  }
+
   std::vector<std::string> archiveNames;
   archiveNames.push_back("common.MPQ");
   archiveNames.push_back("common-2.MPQ");
@@ -297,6 +306,7 @@ Noggit::Noggit(int argc, char *argv[])
 
   NoggitSettings.set_value ("project/game_path", path.absolutePath());
   NoggitSettings.set_value ("project/path", QString::fromStdString(project_path));
+  NoggitSettings.sync();
 
   loadMPQs(); // listfiles are not available straight away! They are async! Do not rely on anything at this point!
   OpenDBs();
@@ -345,6 +355,7 @@ Noggit::Noggit(int argc, char *argv[])
 
   // ensure all MPQs are loaded fully so the listfile is complete
   AsyncLoader::instance->wait_queue_empty();
+  MPQArchive::allFinishLoading();
 
   main_window = std::make_unique<noggit::ui::main_window>();
   if (fullscreen)
@@ -0,0 +1,186 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/archive_index.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace noggit
+{
+  namespace
+  {
+    char normalized (char c)
+    {
+      return c == '\\' ? '/' : (c >= 'A' && c <= 'Z') ? static_cast<char> (c - 'A' + 'a') : c;
+    }
+
+    std::uint64_t normalized_hash (std::string_view name)
+    {
+      // FNV-1a
+      std::uint64_t hash (14695981039346656037ull);
+      for (char c : name)
+      {
+        hash = (hash ^ static_cast<unsigned char> (normalized (c))) * 1099511628211ull;
+      }
+      return hash;
+    }
+
+    template<typename T>
+      void append (std::string& bytes, T const& value)
+    {
+      bytes.append (reinterpret_cast<char const*> (&value), sizeof (T));
+    }
+
+    bool normalized_equal (std::string_view normalized_name, std::string_view name)
+    {
+      return normalized_name.size() == name.size()
+        && std::equal ( normalized_name.begin(), normalized_name.end(), name.begin()
+                      , [] (char lhs, char rhs) { return lhs == normalized (rhs); }
+                      );
+    }
+  }
+
+  archive_index::archive_index (std::vector<std::vector<std::string>> const& names_by_archive)
+  {
+    std::size_t name_count (0);
+    for (auto const& names : names_by_archive)
+    {
+      name_count += names.size();
+    }
+
+    // keep the load factor at or below 1/2 so probe sequences stay short
+    std::size_t capacity (16);
+    while (capacity < 2 * name_count)
+    {
+      capacity *= 2;
+    }
+    _entries.resize (capacity);
+    _mask = capacity - 1;
+
+    for (std::size_t archive (0); archive < names_by_archive.size(); ++archive)
+    {
+      for (auto const& name : names_by_archive[archive])
+      {
+        std::uint64_t const hash (normalized_hash (name));
+        std::size_t slot (hash & _mask);
+
+        while (_entries[slot].archive != empty)
+        {
+          auto const& existing (_entries[slot]);
+          if ( existing.hash == hash
+            && normalized_equal (std::string_view (_names).substr (existing.name_offset, existing.name_length), name)
+             )
+          {
+            break;
+          }
+          slot = (slot + 1) & _mask;
+        }
+
+        entry& target (_entries[slot]);
+        if (target.archive == empty)
+        {
+          target.hash = hash;
+          target.name_offset = static_cast<std::uint32_t> (_names.size());
+          target.name_length = static_cast<std::uint32_t> (name.size());
+          std::transform (name.begin(), name.end(), std::back_inserter (_names), &normalized);
+          ++_size;
+        }
+        // later archives override earlier ones
+        target.archive = static_cast<std::uint32_t> (archive);
+      }
+    }
+  }
+
+  archive_index::entry const* archive_index::find_entry (std::string_view name, std::uint64_t hash) const
+  {
+    for (std::size_t slot (hash & _mask); ; slot = (slot + 1) & _mask)
+    {
+      entry const& candidate (_entries[slot]);
+      if (candidate.archive == empty)
+      {
+        return nullptr;
+      }
+      if ( candidate.hash == hash
+        && normalized_equal (std::string_view (_names).substr (candidate.name_offset, candidate.name_length), name)
+         )
+      {
+        return &candidate;
+      }
+    }
+  }
+
+  std::size_t archive_index::find (std::string_view filename) const
+  {
+    entry const* const found (find_entry (filename, normalized_hash (filename)));
+    return found ? found->archive : not_found;
+  }
+
+  std::string archive_index::serialized() const
+  {
+    static_assert (std::is_trivially_copyable<entry>::value, "entries are written as they are");
+
+    std::string bytes;
+    append (bytes, static_cast<std::uint64_t> (_entries.size()));
+    append (bytes, static_cast<std::uint64_t> (_size));
+    append (bytes, static_cast<std::uint64_t> (_names.size()));
+    bytes.append (reinterpret_cast<char const*> (_entries.data()), _entries.size() * sizeof (entry));
+    bytes.append (_names);
+    return bytes;
+  }
+
+  boost::optional<archive_index> archive_index::deserialized
+    (char const* data, std::size_t size, std::size_t archive_count)
+  {
+    std::uint64_t header[3];
+    if (size < sizeof (header))
+    {
+      return boost::none;
+    }
+    std::memcpy (header, data, sizeof (header));
+
+    std::uint64_t const entry_count (header[0]);
+    std::uint64_t const names_size (header[2]);
+
+    // a power of two, and not so large the sizes below overflow
+    if ( entry_count == 0 || (entry_count & (entry_count - 1))
+      || entry_count > (size / sizeof (entry)) || names_size > size
+      || size - sizeof (header) != entry_count * sizeof (entry) + names_size
+       )
+    {
+      return boost::none;
+    }
+
+    archive_index index ({});
+    index._entries.resize (entry_count);
+    std::memcpy (index._entries.data(), data + sizeof (header), entry_count * sizeof (entry));
+    index._names.assign (data + sizeof (header) + entry_count * sizeof (entry), names_size);
+    index._mask = entry_count - 1;
+    index._size = header[1];
+
+    std::size_t used (0);
+    for (auto const& slot : index._entries)
+    {
+      if (slot.archive == empty)
+      {
+        continue;
+      }
+      if ( slot.archive >= archive_count
+        || slot.name_offset > names_size || slot.name_length > names_size - slot.name_offset
+         )
+      {
+        return boost::none;
+      }
+      ++used;
+    }
+
+    // lookups end at the first empty slot, so there has to be one
+    if (used != index._size || used == entry_count)
+    {
+      return boost::none;
+    }
+
+    return index;
+  }
+}
@@ -0,0 +1,75 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace noggit
+{
+  //! Immutable map from file name to the archive providing that file,
+  //! which is the last archive in load order listing it. Names are
+  //! compared the way mpq::normalized_filename would (case-insensitive,
+  //! '\\' == '/') without building normalized copies, and lookups are a
+  //! single probe sequence over one flat table, so any number of
+  //! threads can use it without locking.
+  class archive_index
+  {
+  public:
+    static constexpr std::size_t const not_found = std::numeric_limits<std::size_t>::max();
+
+    //! names_by_archive[i] are the files in archive i, in load order
+    archive_index (std::vector<std::vector<std::string>> const& names_by_archive);
+
+    //! number of the archive providing filename, or not_found
+    std::size_t find (std::string_view filename) const;
+
+    std::size_t size() const { return _size; }
+
+    //! fun (name) for every name in the index, normalized
+    template<typename Fun>
+      void for_each_name (Fun&& fun) const
+    {
+      for (auto const& slot : _entries)
+      {
+        if (slot.archive != empty)
+        {
+          fun (std::string_view (_names).substr (slot.name_offset, slot.name_length));
+        }
+      }
+    }
+
+    //! The index as bytes, to be turned back into it with deserialized()
+    //! by the same build, e.g. from a cache on disk.
+    std::string serialized() const;
+    //! boost::none if data isn't an index of at most archive_count
+    //! archives serialized() before
+    static boost::optional<archive_index> deserialized
+      (char const* data, std::size_t size, std::size_t archive_count);
+
+  private:
+
+    struct entry
+    {
+      std::uint64_t hash = 0;
+      std::uint32_t name_offset = 0;
+      std::uint32_t name_length = 0;
+      std::uint32_t archive = empty;
+    };
+
+    static constexpr std::uint32_t const empty = std::numeric_limits<std::uint32_t>::max();
+
+    entry const* find_entry (std::string_view, std::uint64_t hash) const;
+
+    std::vector<entry> _entries;
+    std::string _names;
+    std::size_t _mask = 0;
+    std::size_t _size = 0;
+  };
+}
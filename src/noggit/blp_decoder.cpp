@@ -0,0 +1,446 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/blp_decoder.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace noggit
+{
+  namespace
+  {
+    using color = std::array<std::uint8_t, 4>;
+
+    int mip_size (int size, int mip)
+    {
+      return std::max (1, size >> mip);
+    }
+
+    std::uint16_t read_u16 (std::uint8_t const* data)
+    {
+      return static_cast<std::uint16_t> (data[0] | data[1] << 8);
+    }
+
+    color from_565 (std::uint16_t value)
+    {
+      int const r ((value >> 11) & 0x1f);
+      int const g ((value >> 5) & 0x3f);
+      int const b (value & 0x1f);
+      return {{ static_cast<std::uint8_t> (r << 3 | r >> 2)
+              , static_cast<std::uint8_t> (g << 2 | g >> 4)
+              , static_cast<std::uint8_t> (b << 3 | b >> 2)
+              , 255
+             }};
+    }
+
+    color mix (color const& a, int a_weight, color const& b, int b_weight)
+    {
+      color result;
+      for (std::size_t i (0); i < 3; ++i)
+      {
+        result[i] = static_cast<std::uint8_t> ((a[i] * a_weight + b[i] * b_weight) / (a_weight + b_weight));
+      }
+      result[3] = 255;
+      return result;
+    }
+
+    //! the four colors of a dxt color block, the dxt1 ones with less
+    //! colors if the first one isn't the bigger one
+    std::array<color, 4> block_colors (std::uint8_t const* block, bool dxt1, bool punch_through)
+    {
+      std::uint16_t const c0 (read_u16 (block));
+      std::uint16_t const c1 (read_u16 (block + 2));
+      color const a (from_565 (c0));
+      color const b (from_565 (c1));
+
+      if (!dxt1 || c0 > c1)
+      {
+        return {{a, b, mix (a, 2, b, 1), mix (a, 1, b, 2)}};
+      }
+      return {{a, b, mix (a, 1, b, 1), {{0, 0, 0, static_cast<std::uint8_t> (punch_through ? 0 : 255)}}}};
+    }
+
+    //! the 16 alphas of a dxt5 alpha block
+    std::array<std::uint8_t, 16> interpolated_alphas (std::uint8_t const* block)
+    {
+      int const a0 (block[0]);
+      int const a1 (block[1]);
+      std::array<std::uint8_t, 8> values;
+      values[0] = static_cast<std::uint8_t> (a0);
+      values[1] = static_cast<std::uint8_t> (a1);
+
+      if (a0 > a1)
+      {
+        for (int i (2); i < 8; ++i)
+        {
+          values[i] = static_cast<std::uint8_t> (((8 - i) * a0 + (i - 1) * a1) / 7);
+        }
+      }
+      else
+      {
+        for (int i (2); i < 6; ++i)
+        {
+          values[i] = static_cast<std::uint8_t> (((6 - i) * a0 + (i - 1) * a1) / 5);
+        }
+        values[6] = 0;
+        values[7] = 255;
+      }
+
+      std::uint64_t indices (0);
+      for (int i (0); i < 6; ++i)
+      {
+        indices |= std::uint64_t (block[2 + i]) << (8 * i);
+      }
+
+      std::array<std::uint8_t, 16> alphas;
+      for (std::size_t i (0); i < 16; ++i)
+      {
+        alphas[i] = values[(indices >> (3 * i)) & 7];
+      }
+      return alphas;
+    }
+
+    //! explicit 4 bit alphas of a dxt3 alpha block
+    std::array<std::uint8_t, 16> explicit_alphas (std::uint8_t const* block)
+    {
+      std::array<std::uint8_t, 16> alphas;
+      for (std::size_t i (0); i < 16; ++i)
+      {
+        alphas[i] = static_cast<std::uint8_t> (((block[i / 2] >> (4 * (i % 2))) & 0xf) * 17);
+      }
+      return alphas;
+    }
+
+    void decode_dxt ( std::uint8_t const* blocks
+                    , int alpha_type
+                    , bool punch_through
+                    , rgba_image& image
+                    )
+    {
+      bool const dxt1 (alpha_type == 0);
+      std::size_t const block_size (dxt1 ? 8 : 16);
+      int const blocks_x ((image.width + 3) / 4);
+      int const blocks_y ((image.height + 3) / 4);
+
+      for (int by (0); by < blocks_y; ++by)
+      {
+        for (int bx (0); bx < blocks_x; ++bx, blocks += block_size)
+        {
+          std::uint8_t const* const color_block (dxt1 ? blocks : blocks + 8);
+          std::array<color, 4> const colors (block_colors (color_block, dxt1, punch_through));
+          std::uint32_t const indices ( color_block[4] | color_block[5] << 8
+                                      | color_block[6] << 16 | std::uint32_t (color_block[7]) << 24
+                                      );
+
+          std::array<std::uint8_t, 16> alphas {};
+          if (alpha_type == 1)
+          {
+            alphas = explicit_alphas (blocks);
+          }
+          else if (alpha_type == 3)
+          {
+            alphas = interpolated_alphas (blocks);
+          }
+
+          for (int y (0); y < 4 && by * 4 + y < image.height; ++y)
+          {
+            for (int x (0); x < 4 && bx * 4 + x < image.width; ++x)
+            {
+              std::size_t const i (y * 4 + x);
+              color c (colors[(indices >> (2 * i)) & 3]);
+              if (!dxt1)
+              {
+                c[3] = alphas[i];
+              }
+              std::memcpy ( &image.pixels[4 * ((by * 4 + y) * std::size_t (image.width) + bx * 4 + x)]
+                          , c.data()
+                          , 4
+                          );
+            }
+          }
+        }
+      }
+    }
+
+    void decode_palettized ( std::uint8_t const* palette
+                           , std::uint8_t const* indices
+                           , int alpha_depth
+                           , rgba_image& image
+                           )
+    {
+      std::size_t const count (std::size_t (image.width) * image.height);
+      std::uint8_t const* const alphas (indices + count);
+
+      for (std::size_t i (0); i < count; ++i)
+      {
+        // the palette is bgra, its alpha unused
+        std::uint8_t const* const entry (palette + 4 * indices[i]);
+        std::uint8_t* const pixel (&image.pixels[4 * i]);
+        pixel[0] = entry[2];
+        pixel[1] = entry[1];
+        pixel[2] = entry[0];
+
+        switch (alpha_depth)
+        {
+        case 8:
+          pixel[3] = alphas[i];
+          break;
+        case 4:
+          pixel[3] = static_cast<std::uint8_t> (((alphas[i / 2] >> (4 * (i % 2))) & 0xf) * 17);
+          break;
+        case 1:
+          pixel[3] = (alphas[i / 8] >> (i % 8)) & 1 ? 255 : 0;
+          break;
+        default:
+          pixel[3] = 255;
+          break;
+        }
+      }
+    }
+
+    //! for every pixel of a row or column of the thumbnail the two
+    //! pixels of the image around its center and the weight of the
+    //! second one, out of 256
+    struct sample
+    {
+      int first;
+      int second;
+      int weight;
+    };
+
+    std::vector<sample> samples (int from, int to)
+    {
+      std::vector<sample> result (to);
+      for (int i (0); i < to; ++i)
+      {
+        // center of the thumbnail pixel in image pixels, in 1/256
+        std::int64_t const position ((std::int64_t (2 * i + 1) * from * 256) / (2 * to) - 128);
+        std::int64_t const whole (position >= 0 ? position / 256 : -((-position + 255) / 256));
+        result[i].first = static_cast<int> ((whole % from + from) % from);
+        result[i].second = (result[i].first + 1) % from;
+        result[i].weight = static_cast<int> (position - whole * 256);
+      }
+      return result;
+    }
+  }
+
+  int blp_mip_count (BLPHeader const& header)
+  {
+    int count (0);
+    while (count < 16 && header.offsets[count] > 0 && header.sizes[count] > 0)
+    {
+      ++count;
+    }
+    return count;
+  }
+
+  int blp_mip_for_size (BLPHeader const& header, int width, int height)
+  {
+    if (width == -1 || height == -1)
+    {
+      return 0;
+    }
+
+    int mip (0);
+    int const count (blp_mip_count (header));
+    while ( mip + 1 < count
+         && mip_size (header.resx, mip + 1) >= width
+         && mip_size (header.resy, mip + 1) >= height
+          )
+    {
+      ++mip;
+    }
+    return mip;
+  }
+
+  rgba_image decode_blp (char const* data, std::size_t size, int mip)
+  {
+    if (size < sizeof (BLPHeader))
+    {
+      throw std::runtime_error ("blp is smaller than its header");
+    }
+
+    BLPHeader header;
+    std::memcpy (&header, data, sizeof (header));
+
+    if (header.resx <= 0 || header.resy <= 0 || header.resx > 1 << 16 || header.resy > 1 << 16)
+    {
+      throw std::runtime_error ("blp has an invalid size");
+    }
+    if (mip < 0 || mip >= blp_mip_count (header))
+    {
+      throw std::runtime_error ("blp has no mip " + std::to_string (mip));
+    }
+    if (std::size_t (header.offsets[mip]) > size)
+    {
+      throw std::runtime_error ("blp mip is past the end of the file");
+    }
+
+    rgba_image image;
+    image.width = mip_size (header.resx, mip);
+    image.height = mip_size (header.resy, mip);
+    image.pixels.resize (4 * std::size_t (image.width) * image.height);
+
+    auto const input (reinterpret_cast<std::uint8_t const*> (data));
+    std::size_t const offset (header.offsets[mip]);
+    std::size_t const available (std::min<std::size_t> (header.sizes[mip], size - offset));
+
+    if (header.attr_0_compression == 1)
+    {
+      std::size_t const count (std::size_t (image.width) * image.height);
+      std::size_t const needed (count + (count * header.attr_1_alphadepth + 7) / 8);
+      if (sizeof (BLPHeader) + 256 * 4 > size || available < needed)
+      {
+        throw std::runtime_error ("palettized blp is cut short");
+      }
+
+      decode_palettized ( input + sizeof (BLPHeader)
+                        , input + offset
+                        , header.attr_1_alphadepth
+                        , image
+                        );
+    }
+    else if (header.attr_0_compression == 2)
+    {
+      int const alpha_type (header.attr_2_alphatype & 3);
+      if (alpha_type == 2)
+      {
+        throw std::runtime_error ("blp has an unknown dxt alpha type");
+      }
+
+      std::size_t const blocks ( std::size_t ((image.width + 3) / 4) * ((image.height + 3) / 4)
+                               * (alpha_type == 0 ? 8 : 16)
+                               );
+
+      // some small mips are stored shorter than their size needs, the
+      // rest is zeros just like when they are uploaded to gl
+      if (available < blocks)
+      {
+        std::vector<std::uint8_t> padded (blocks);
+        std::copy (input + offset, input + offset + available, padded.begin());
+        decode_dxt (padded.data(), alpha_type, header.attr_1_alphadepth == 1, image);
+      }
+      else
+      {
+        decode_dxt (input + offset, alpha_type, header.attr_1_alphadepth == 1, image);
+      }
+    }
+    else
+    {
+      throw std::runtime_error ( "unsupported blp compression "
+                               + std::to_string (header.attr_0_compression)
+                               );
+    }
+
+    return image;
+  }
+
+  rgba_image blp_thumbnail (rgba_image const& image, int width, int height)
+  {
+    rgba_image thumbnail;
+    thumbnail.width = width == -1 ? image.width : width;
+    thumbnail.height = height == -1 ? image.height : height;
+    thumbnail.pixels.resize (4 * std::size_t (thumbnail.width) * thumbnail.height);
+
+    if (thumbnail.width == image.width && thumbnail.height == image.height)
+    {
+      thumbnail.pixels = image.pixels;
+      for (std::size_t i (3); i < thumbnail.pixels.size(); i += 4)
+      {
+        thumbnail.pixels[i] = 255;
+      }
+      return thumbnail;
+    }
+
+    std::vector<sample> const columns (samples (image.width, thumbnail.width));
+    std::vector<sample> const rows (samples (image.height, thumbnail.height));
+
+    std::uint8_t* output (thumbnail.pixels.data());
+    for (sample const& row : rows)
+    {
+      std::uint8_t const* const top (&image.pixels[4 * std::size_t (row.first) * image.width]);
+      std::uint8_t const* const bottom (&image.pixels[4 * std::size_t (row.second) * image.width]);
+
+      for (sample const& column : columns)
+      {
+        for (int channel (0); channel < 3; ++channel)
+        {
+          int const upper ( top[4 * column.first + channel] * (256 - column.weight)
+                          + top[4 * column.second + channel] * column.weight
+                          );
+          int const lower ( bottom[4 * column.first + channel] * (256 - column.weight)
+                          + bottom[4 * column.second + channel] * column.weight
+                          );
+          *output++ = static_cast<std::uint8_t>
+            ((upper * (256 - row.weight) + lower * row.weight + (1 << 15)) >> 16);
+        }
+        *output++ = 255;
+      }
+    }
+
+    return thumbnail;
+  }
+
+  thumbnail_cache::thumbnail_cache (std::size_t capacity)
+    : _capacity (capacity)
+  {}
+
+  std::shared_ptr<rgba_image const> thumbnail_cache::find
+    (std::string const& filename, int width, int height)
+  {
+    std::lock_guard<std::mutex> const lock (_mutex);
+
+    auto const it (_index.find (key (filename, width, height)));
+    if (it == _index.end())
+    {
+      return nullptr;
+    }
+
+    _entries.splice (_entries.begin(), _entries, it->second);
+    return it->second->second;
+  }
+
+  void thumbnail_cache::insert ( std::string const& filename
+                               , int width
+                               , int height
+                               , std::shared_ptr<rgba_image const> image
+                               )
+  {
+    std::lock_guard<std::mutex> const lock (_mutex);
+
+    key k (filename, width, height);
+    auto const existing (_index.find (k));
+    if (existing != _index.end())
+    {
+      _bytes -= existing->second->second->pixels.size();
+      _entries.erase (existing->second);
+      _index.erase (existing);
+    }
+
+    _bytes += image->pixels.size();
+    _entries.emplace_front (k, std::move (image));
+    _index.emplace (std::move (k), _entries.begin());
+
+    // the newest one is kept even if it alone is over the budget
+    while (_bytes > _capacity && _entries.size() > 1)
+    {
+      _bytes -= _entries.back().second->pixels.size();
+      _index.erase (_entries.back().first);
+      _entries.pop_back();
+    }
+  }
+
+  std::size_t thumbnail_cache::size() const
+  {
+    std::lock_guard<std::mutex> const lock (_mutex);
+    return _entries.size();
+  }
+
+  std::size_t thumbnail_cache::bytes() const
+  {
+    std::lock_guard<std::mutex> const lock (_mutex);
+    return _bytes;
+  }
+}
@@ -0,0 +1,83 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//! \todo Cross-platform syntax for packed structs.
+#pragma pack(push,1)
+struct BLPHeader
+{
+  int32_t magix;
+  int32_t version;
+  uint8_t attr_0_compression;
+  uint8_t attr_1_alphadepth;
+  uint8_t attr_2_alphatype;
+  uint8_t attr_3_mipmaplevels;
+  int32_t resx;
+  int32_t resy;
+  int32_t offsets[16];
+  int32_t sizes[16];
+};
+#pragma pack(pop)
+
+namespace noggit
+{
+  //! rgba8, row by row from the top
+  struct rgba_image
+  {
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> pixels;
+  };
+
+  //! Number of mips stored in the blp, the ones up to the first missing one.
+  int blp_mip_count (BLPHeader const&);
+  //! The smallest mip at least \a width x \a height, the largest one if
+  //! none is, the first one if either is -1.
+  int blp_mip_for_size (BLPHeader const&, int width, int height);
+
+  //! Decodes a mip of the palettized or dxt1/3/5 compressed blp in the
+  //! \a size bytes at \a data, without a gl context. Throws
+  //! std::runtime_error for other formats and for files cut short.
+  rgba_image decode_blp (char const* data, std::size_t size, int mip);
+
+  //! \a image scaled to \a width x \a height with bilinear filtering,
+  //! wrapping around at the edges like a repeating texture, and opaque
+  //! like the textures on the terrain. Without resizing for -1.
+  rgba_image blp_thumbnail (rgba_image const& image, int width, int height);
+
+  //! Thumbnails by file and size, forgetting the least recently used ones
+  //! beyond a budget of bytes. Safe to use from several threads.
+  class thumbnail_cache
+  {
+  public:
+    explicit thumbnail_cache (std::size_t capacity);
+
+    std::shared_ptr<rgba_image const> find (std::string const& filename, int width, int height);
+    void insert (std::string const& filename, int width, int height, std::shared_ptr<rgba_image const>);
+
+    std::size_t size() const;
+    std::size_t bytes() const;
+
+  private:
+    using key = std::tuple<std::string, int, int>;
+    using entry = std::pair<key, std::shared_ptr<rgba_image const>>;
+
+    std::size_t const _capacity;
+    mutable std::mutex _mutex;
+    std::size_t _bytes = 0;
+    //! most recently used first
+    std::list<entry> _entries;
+    std::map<key, std::list<entry>::iterator> _index;
+  };
+}
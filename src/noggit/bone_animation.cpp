@@ -0,0 +1,125 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/bone_animation.hpp>
+
+#include <algorithm>
+
+namespace noggit
+{
+  std::size_t keyframe_before (std::vector<std::uint32_t> const& timestamps, std::uint32_t time)
+  {
+    auto const after (std::upper_bound (timestamps.begin(), timestamps.end(), time));
+
+    if (after == timestamps.begin() || after == timestamps.end())
+    {
+      return 0;
+    }
+
+    return after - timestamps.begin() - 1;
+  }
+
+  std::vector<std::size_t> parent_first_order (std::vector<int> const& parents)
+  {
+    std::vector<std::size_t> order;
+    order.reserve (parents.size());
+
+    std::vector<std::vector<std::size_t>> children (parents.size());
+    std::vector<bool> ordered (parents.size(), false);
+
+    for (std::size_t bone (0); bone < parents.size(); ++bone)
+    {
+      int const parent (parents[bone]);
+
+      if (parent < 0 || static_cast<std::size_t> (parent) >= parents.size())
+      {
+        order.push_back (bone);
+        ordered[bone] = true;
+      }
+      else
+      {
+        children[parent].push_back (bone);
+      }
+    }
+
+    // breadth first: every level only needs the ones before
+    for (std::size_t i (0); i < order.size(); ++i)
+    {
+      for (std::size_t child : children[order[i]])
+      {
+        order.push_back (child);
+        ordered[child] = true;
+      }
+    }
+
+    for (std::size_t bone (0); bone < parents.size(); ++bone)
+    {
+      if (!ordered[bone])
+      {
+        order.push_back (bone);
+      }
+    }
+
+    return order;
+  }
+
+  math::matrix_4x4 affine_transform ( math::vector_3d const& offset
+                                    , math::quaternion const& q
+                                    , math::vector_3d const& scale
+                                    )
+  {
+    // math::matrix_4x4 (rotation, q) with the columns scaled
+    return { (1.0f - 2.0f * q.y * q.y - 2.0f * q.z * q.z) * scale.x
+           , (2.0f * q.x * q.y + 2.0f * q.w * q.z) * scale.y
+           , (2.0f * q.x * q.z - 2.0f * q.w * q.y) * scale.z
+           , offset.x
+           , (2.0f * q.x * q.y - 2.0f * q.w * q.z) * scale.x
+           , (1.0f - 2.0f * q.x * q.x - 2.0f * q.z * q.z) * scale.y
+           , (2.0f * q.y * q.z + 2.0f * q.w * q.x) * scale.z
+           , offset.y
+           , (2.0f * q.x * q.z + 2.0f * q.w * q.y) * scale.x
+           , (2.0f * q.y * q.z - 2.0f * q.w * q.x) * scale.y
+           , (1.0f - 2.0f * q.x * q.x - 2.0f * q.y * q.y) * scale.z
+           , offset.z
+           , 0.0f, 0.0f, 0.0f, 1.0f
+           };
+  }
+
+  void affine_translate (math::matrix_4x4& matrix, math::vector_3d const& offset)
+  {
+    for (std::size_t row (0); row < 3; ++row)
+    {
+      matrix (row, 3, matrix (row, 0) * offset.x + matrix (row, 1) * offset.y + matrix (row, 2) * offset.z + matrix (row, 3));
+    }
+  }
+
+  math::matrix_4x4 affine_product (math::matrix_4x4 const& lhs, math::matrix_4x4 const& rhs)
+  {
+    math::matrix_4x4 result (math::matrix_4x4::uninitialized);
+
+    for (std::size_t row (0); row < 3; ++row)
+    {
+      for (std::size_t column (0); column < 4; ++column)
+      {
+        result (row, column, lhs (row, 0) * rhs (0, column) + lhs (row, 1) * rhs (1, column) + lhs (row, 2) * rhs (2, column));
+      }
+      result (row, 3, result (row, 3) + lhs (row, 3));
+    }
+
+    result (3, 0, 0.0f);
+    result (3, 1, 0.0f);
+    result (3, 2, 0.0f);
+    result (3, 3, 1.0f);
+
+    return result;
+  }
+
+  void billboard (math::matrix_4x4& matrix, math::matrix_4x4 const& model_view)
+  {
+    // columns 2 and 1: the camera's right (negated) and up
+    for (std::size_t row (0); row < 3; ++row)
+    {
+      matrix (row, 2, -model_view[row * 4]);
+      matrix (row, 1, model_view[row * 4 + 1]);
+    }
+  }
+}
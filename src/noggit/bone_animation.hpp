@@ -0,0 +1,40 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/matrix_4x4.hpp>
+#include <math/quaternion.hpp>
+#include <math/vector_3d.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace noggit
+{
+  //! the i for which timestamps[i] <= time < timestamps[i + 1], or 0 if
+  //! there is none. \a timestamps are sorted, as they are in models.
+  std::size_t keyframe_before (std::vector<std::uint32_t> const& timestamps, std::uint32_t time);
+
+  //! the bones' indices, every bone coming after its parent so they can
+  //! be evaluated in one pass. A parent of -1 (or out of range) is a
+  //! root. Bones in a loop, which models should not have, come last.
+  std::vector<std::size_t> parent_first_order (std::vector<int> const& parents);
+
+  // The matrices below are affine: their last row is 0 0 0 1, which
+  // is left out of the computations.
+
+  //! translation (\a offset) * rotation (\a rotation) * scale (\a scale)
+  math::matrix_4x4 affine_transform ( math::vector_3d const& offset
+                                    , math::quaternion const& rotation
+                                    , math::vector_3d const& scale
+                                    );
+  //! \a matrix * translation (\a offset)
+  void affine_translate (math::matrix_4x4& matrix, math::vector_3d const& offset);
+  //! \a lhs * \a rhs
+  math::matrix_4x4 affine_product (math::matrix_4x4 const& lhs, math::matrix_4x4 const& rhs);
+
+  //! turn \a matrix to face the camera of \a model_view, for the bones
+  //! flagged billboard (spherical billboarding)
+  void billboard (math::matrix_4x4& matrix, math::matrix_4x4 const& model_view);
+}
@@ -14,7 +14,7 @@ namespace noggit
     , _roll (0.0f)
     , _yaw (0.f)
     , _pitch (0.f)
-    , _fov (math::degrees (NoggitSettings.value("fov", 54.f).toFloat()))
+    , _fov (math::degrees (NoggitSettings.editor().fov))
   {
     //! \note ensure ranges
     yaw (yaw_);
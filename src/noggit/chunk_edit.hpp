@@ -0,0 +1,57 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/job_scheduler.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace noggit
+{
+  //! Brush passes over chunks in two phases: \a edit (item) -> bool changed
+  //! runs for every item, on all cores of \a scheduler if given, then
+  //! \a changed (item) runs on the calling thread for every item edit
+  //! returned true for, in the order of \a items. The result is the same
+  //! either way as long as edit only touches the chunk of its own item.
+  template<typename Item, typename Edit, typename Changed>
+    bool edit_chunks ( job_scheduler* scheduler
+                     , std::vector<Item> const& items
+                     , Edit&& edit
+                     , Changed&& changed
+                     )
+  {
+    // not std::vector<bool>, its elements can't be written concurrently
+    std::vector<char> edited (items.size(), 0);
+
+    if (scheduler && items.size() > 1)
+    {
+      scheduler->parallel_for
+        ( 0, items.size()
+        , [&] (std::size_t i)
+          {
+            edited[i] = edit (items[i]);
+          }
+        );
+    }
+    else
+    {
+      for (std::size_t i (0); i < items.size(); ++i)
+      {
+        edited[i] = edit (items[i]);
+      }
+    }
+
+    bool any (false);
+    for (std::size_t i (0); i < items.size(); ++i)
+    {
+      if (edited[i])
+      {
+        any = true;
+        changed (items[i]);
+      }
+    }
+
+    return any;
+  }
+}
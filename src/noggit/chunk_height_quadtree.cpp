@@ -0,0 +1,51 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/chunk_height_quadtree.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace noggit
+{
+  void chunk_height_quadtree::complete_bounds()
+  {
+    // a flat quad has a box without any height, widen it a bit so that
+    // rounding in the box test can't reject a ray hitting the triangles
+    for (int row (0); row < quads_per_side; ++row)
+    {
+      for (int column (0); column < quads_per_side; ++column)
+      {
+        bounds& quad (_nodes[node_index (leaf_level, row, column)]);
+
+        float magnitude (1.f);
+        for (int axis (0); axis < 3; ++axis)
+        {
+          magnitude = std::max ({magnitude, std::abs (quad.min[axis]), std::abs (quad.max[axis])});
+        }
+
+        math::vector_3d const padding (math::vector_3d (1.f, 1.f, 1.f) * (magnitude * 1e-5f));
+        quad.min = quad.min - padding;
+        quad.max = quad.max + padding;
+      }
+    }
+
+    for (int level (leaf_level - 1); level >= 0; --level)
+    {
+      for (int row (0); row < (1 << level); ++row)
+      {
+        for (int column (0); column < (1 << level); ++column)
+        {
+          bounds& node (_nodes[node_index (level, row, column)]);
+          node = _nodes[node_index (level + 1, row * 2, column * 2)];
+
+          for (int child (1); child < 4; ++child)
+          {
+            bounds const& other (_nodes[node_index (level + 1, row * 2 + child / 2, column * 2 + child % 2)]);
+            node.min = math::min (node.min, other.min);
+            node.max = math::max (node.max, other.max);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,129 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/ray.hpp>
+#include <math/vector_3d.hpp>
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+
+namespace noggit
+{
+  //! Bounds of a chunk's terrain in a quadtree over its 8 * 8 quads, so
+  //! picking only tests the triangles of the quads near the ray instead
+  //! of all 256. Vertices are laid out like MapChunk::vertices: rows of
+  //! 9 outer then 8 inner vertices, the inner one being every quad's
+  //! center. Refit whenever the heights change.
+  class chunk_height_quadtree
+  {
+  public:
+    static constexpr int quads_per_side = 8;
+
+    static constexpr int outer_vertex (int row, int column)
+    {
+      return row * 17 + column;
+    }
+    static constexpr int inner_vertex (int row, int column)
+    {
+      return row * 17 + 9 + column;
+    }
+
+    //! \a position (vertex) returns the vertex' position
+    template<typename Position>
+      void refit (Position&& position)
+    {
+      for (int row (0); row < quads_per_side; ++row)
+      {
+        for (int column (0); column < quads_per_side; ++column)
+        {
+          bounds& quad (_nodes[node_index (leaf_level, row, column)]);
+
+          quad.min = quad.max = position (inner_vertex (row, column));
+          for (int corner : { outer_vertex (row, column), outer_vertex (row, column + 1)
+                            , outer_vertex (row + 1, column), outer_vertex (row + 1, column + 1)
+                            }
+              )
+          {
+            quad.min = math::min (quad.min, position (corner));
+            quad.max = math::max (quad.max, position (corner));
+          }
+        }
+      }
+
+      complete_bounds();
+    }
+
+    //! calls \a hit (distance, vertex, vertex, vertex) for every triangle
+    //! the ray hits in quads for which \a is_hole (row, column) is false,
+    //! the vertices being the same and in the same order as in the
+    //! chunk's index strip
+    template<typename Position, typename IsHole, typename Hit>
+      void intersect (math::ray const& ray, Position&& position, IsHole&& is_hole, Hit&& hit) const
+    {
+      intersect (ray, position, is_hole, hit, 0, 0, 0);
+    }
+
+  private:
+    struct bounds
+    {
+      math::vector_3d min;
+      math::vector_3d max;
+    };
+
+    static constexpr int leaf_level = 3;
+    static constexpr std::size_t node_count = 1 + 4 + 16 + 64;
+
+    static constexpr std::size_t node_index (int level, int row, int column)
+    {
+      // 1 + 4 + 16 nodes before the leaves
+      return ((1 << (2 * level)) - 1) / 3 + row * (1 << level) + column;
+    }
+
+    template<typename Position, typename IsHole, typename Hit>
+      void intersect ( math::ray const& ray, Position& position, IsHole& is_hole, Hit& hit
+                     , int level, int row, int column
+                     ) const
+    {
+      bounds const& node (_nodes[node_index (level, row, column)]);
+
+      if (!ray.intersect_bounds (node.min, node.max))
+      {
+        return;
+      }
+
+      if (level < leaf_level)
+      {
+        for (int child (0); child < 4; ++child)
+        {
+          intersect (ray, position, is_hole, hit, level + 1, row * 2 + child / 2, column * 2 + child % 2);
+        }
+        return;
+      }
+
+      if (is_hole (row, column))
+      {
+        return;
+      }
+
+      int const center (inner_vertex (row, column));
+      std::array<int, 5> const ring {{ outer_vertex (row, column), outer_vertex (row + 1, column)
+                                     , outer_vertex (row + 1, column + 1), outer_vertex (row, column + 1)
+                                     , outer_vertex (row, column)
+                                    }};
+
+      for (int i (0); i < 4; ++i)
+      {
+        if (auto distance = ray.intersect_triangle (position (center), position (ring[i]), position (ring[i + 1])))
+        {
+          hit (*distance, center, ring[i], ring[i + 1]);
+        }
+      }
+    }
+
+    void complete_bounds();
+
+    std::array<bounds, node_count> _nodes;
+  };
+}
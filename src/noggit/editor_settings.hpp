@@ -0,0 +1,46 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_4d.hpp>
+
+#include <string>
+
+namespace noggit
+{
+  //! The settings read while editing, typed and with their defaults.
+  //! noggit::settings publishes them anew each time they are saved, see
+  //! settings::editor().
+  struct editor_settings
+  {
+    std::string project_path = "./";
+
+    float fov = 54.f;
+    float view_distance = 1000.f;
+    bool tablet = false;
+
+    int wireframe_type = 0;
+    float wireframe_radius = 1.5f;
+    float wireframe_width = 1.f;
+    math::vector_4d wireframe_color = {0.f, 0.f, 0.f, 1.f};
+
+    bool parallel_chunk_edits = false;
+
+    bool random_rotation = false;
+    bool random_tilt = false;
+    bool random_size = false;
+
+    int loading_radius = 1;
+    //! seconds
+    float tile_lookahead = 3.f;
+    //! MiB
+    int tile_memory_budget = 1024;
+    bool tile_cache = false;
+    bool additional_file_loading_log = false;
+
+    bool use_mclq_liquids_export = false;
+    std::string mclq_liquids_path;
+
+    bool mysql_enabled = false;
+  };
+}
@@ -0,0 +1,239 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/file_save_batch.hpp>
+
+#include <boost/optional.hpp>
+
+#include <exception>
+
+namespace noggit
+{
+  file_save_batch::file_save_batch (job_scheduler& scheduler)
+    : _scheduler (scheduler)
+  {}
+
+  file_save_batch::~file_save_batch()
+  {
+    cancel();
+
+    std::unique_lock<std::mutex> lock (_guard);
+    _progressed.wait (lock, [&] { return _progress.finished(); });
+  }
+
+  std::size_t file_save_batch::add (std::string name, serializer fun)
+  {
+    std::lock_guard<std::mutex> const lock (_guard);
+
+    _units.emplace_back (std::make_unique<unit>());
+    unit& added (*_units.back());
+    added.name = std::move (name);
+    ++_progress.total;
+
+    if (_cancelled)
+    {
+      complete (added, state::cancelled);
+    }
+    else
+    {
+      added.serialize_job = _scheduler.schedule ( [this, &added, fun]
+                                                  {
+                                                    serialize (added, fun);
+                                                  }
+                                                , 0
+                                                );
+    }
+
+    return _units.size() - 1;
+  }
+
+  void file_save_batch::serialize (unit& target, serializer const& fun)
+  {
+    auto files (std::make_shared<std::vector<serialized_file>>());
+    boost::optional<std::string> error;
+
+    try
+    {
+      *files = fun();
+    }
+    catch (std::exception const& exception)
+    {
+      error = std::string (exception.what());
+    }
+    catch (...)
+    {
+      error = std::string ("unknown error while serializing");
+    }
+
+    std::lock_guard<std::mutex> const lock (_guard);
+
+    if (error)
+    {
+      complete (target, state::failed, std::move (*error));
+      return;
+    }
+    if (_cancelled)
+    {
+      complete (target, state::cancelled);
+      return;
+    }
+
+    // coming from a worker, this goes to the front of its own deque: the
+    // bytes are written and freed next instead of piling up
+    target.current = state::writing;
+    target.write_job = _scheduler.schedule ( [this, &target, files]
+                                             {
+                                               write (target, *files);
+                                             }
+                                           , 0
+                                           );
+  }
+
+  void file_save_batch::write (unit& target, std::vector<serialized_file> const& files)
+  {
+    boost::optional<std::string> error;
+
+    try
+    {
+      for (auto const& file : files)
+      {
+        write_file_atomically (file.destination, file.data.data(), file.data.size());
+      }
+    }
+    catch (std::exception const& exception)
+    {
+      error = std::string (exception.what());
+    }
+
+    std::lock_guard<std::mutex> const lock (_guard);
+    if (error)
+    {
+      complete (target, state::failed, std::move (*error));
+    }
+    else
+    {
+      complete (target, state::saved);
+    }
+  }
+
+  void file_save_batch::complete (unit& target, state new_state, std::string error)
+  {
+    target.current = new_state;
+    target.error = std::move (error);
+
+    switch (new_state)
+    {
+    case state::saved: ++_progress.saved; break;
+    case state::failed: ++_progress.failed; break;
+    case state::cancelled: ++_progress.cancelled; break;
+    default: break;
+    }
+
+    _progressed.notify_all();
+  }
+
+  void file_save_batch::wait_serialized()
+  {
+    std::vector<job_scheduler::handle> jobs;
+    {
+      std::lock_guard<std::mutex> const lock (_guard);
+      for (auto const& added : _units)
+      {
+        if (added->serialize_job)
+        {
+          jobs.emplace_back (added->serialize_job);
+        }
+      }
+    }
+
+    for (auto const& job : jobs)
+    {
+      _scheduler.run_or_wait (job);
+    }
+  }
+
+  file_save_batch::progress file_save_batch::wait (std::function<bool (progress const&)> on_progress)
+  {
+    std::unique_lock<std::mutex> lock (_guard);
+    progress reported;
+
+    while (true)
+    {
+      _progressed.wait
+        ( lock
+        , [&]
+          {
+            return _progress.finished()
+              || ( on_progress
+                && ( _progress.saved != reported.saved
+                  || _progress.failed != reported.failed
+                  || _progress.cancelled != reported.cancelled
+                   )
+                 );
+          }
+        );
+
+      reported = _progress;
+
+      if (on_progress)
+      {
+        lock.unlock();
+        bool const keep_going (on_progress (reported));
+        if (!keep_going)
+        {
+          cancel();
+        }
+        lock.lock();
+      }
+
+      if (_progress.finished())
+      {
+        return _progress;
+      }
+    }
+  }
+
+  void file_save_batch::cancel()
+  {
+    std::lock_guard<std::mutex> const lock (_guard);
+    _cancelled = true;
+
+    for (auto const& added : _units)
+    {
+      if (added->current == state::serializing && added->serialize_job && _scheduler.cancel (added->serialize_job))
+      {
+        complete (*added, state::cancelled);
+      }
+      else if (added->current == state::writing && _scheduler.cancel (added->write_job))
+      {
+        complete (*added, state::cancelled);
+      }
+    }
+  }
+
+  file_save_batch::progress file_save_batch::current_progress() const
+  {
+    std::lock_guard<std::mutex> const lock (_guard);
+    return _progress;
+  }
+
+  bool file_save_batch::saved (std::size_t index) const
+  {
+    std::lock_guard<std::mutex> const lock (_guard);
+    return _units.at (index)->current == state::saved;
+  }
+
+  std::vector<std::pair<std::string, std::string>> file_save_batch::failures() const
+  {
+    std::lock_guard<std::mutex> const lock (_guard);
+
+    std::vector<std::pair<std::string, std::string>> failed;
+    for (auto const& added : _units)
+    {
+      if (added->current == state::failed)
+      {
+        failed.emplace_back (added->name, added->error);
+      }
+    }
+    return failed;
+  }
+}
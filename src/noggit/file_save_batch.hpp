@@ -0,0 +1,113 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/job_scheduler.hpp>
+#include <noggit/mapped_file.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  struct serialized_file
+  {
+    boost::filesystem::path destination;
+    std::vector<char> data;
+  };
+
+  //! Serializes and writes sets of files (e.g. one ADT tile, in one or
+  //! more variants) using a job_scheduler. Every set is written by the
+  //! worker that serialized it right after, so only the sets currently
+  //! in flight are held in memory. Serializers usually read editor state:
+  //! that state must not change until wait_serialized() returned.
+  //! Everything after that only touches the serialized bytes, so e.g. the
+  //! UI may run during wait().
+  class file_save_batch
+  {
+  public:
+    using serializer = std::function<std::vector<serialized_file>()>;
+
+    struct progress
+    {
+      std::size_t saved = 0;
+      std::size_t failed = 0;
+      std::size_t cancelled = 0;
+      std::size_t total = 0;
+
+      bool finished() const { return saved + failed + cancelled == total; }
+    };
+
+    file_save_batch (job_scheduler&);
+    //! Cancels whatever did not start yet and waits for the rest.
+    ~file_save_batch();
+
+    file_save_batch (file_save_batch const&) = delete;
+    file_save_batch (file_save_batch&&) = delete;
+    file_save_batch& operator= (file_save_batch const&) = delete;
+    file_save_batch& operator= (file_save_batch&&) = delete;
+
+    //! Start saving what serialize returns, as one unit: it only counts
+    //! as saved once all of its files are. A serializer that throws marks
+    //! it as failed. name identifies it in failures(). Not thread-safe,
+    //! only the thread owning the batch may add. Returns the index of the
+    //! new unit.
+    std::size_t add (std::string name, serializer serialize);
+
+    //! Block until every serializer ran or got cancelled, running the
+    //! ones no worker picked up yet on the calling thread.
+    void wait_serialized();
+    //! Block until everything is saved, failed or cancelled. on_progress
+    //! is called on the calling thread whenever that changed, returning
+    //! false from it cancels the batch.
+    progress wait (std::function<bool (progress const&)> on_progress = nullptr);
+    //! Everything not serialized or not written yet is dropped. What is
+    //! being written right now still completes.
+    void cancel();
+
+    progress current_progress() const;
+    bool saved (std::size_t index) const;
+    //! Name and reason of everything that failed so far.
+    std::vector<std::pair<std::string, std::string>> failures() const;
+
+  private:
+    enum class state
+    {
+      serializing,
+      writing,
+      saved,
+      failed,
+      cancelled,
+    };
+
+    struct unit
+    {
+      std::string name;
+      state current = state::serializing;
+      std::string error;
+      job_scheduler::handle serialize_job;
+      job_scheduler::handle write_job;
+    };
+
+    void serialize (unit&, serializer const&);
+    void write (unit&, std::vector<serialized_file> const&);
+    //! call with _guard held
+    void complete (unit&, state, std::string error = {});
+
+    job_scheduler& _scheduler;
+
+    mutable std::mutex _guard;
+    std::condition_variable _progressed;
+    std::vector<std::unique_ptr<unit>> _units;
+    progress _progress;
+    bool _cancelled = false;
+  };
+}
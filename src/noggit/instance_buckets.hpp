@@ -0,0 +1,100 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  //! Instances grouped by the model or wmo they are drawn with, one
+  //! bucket per key, kept up to date one instance at a time instead of
+  //! being rebuilt. Every instance remembers its slot in its bucket, so
+  //! adding and removing one is O(1): removing moves the last instance
+  //! of the bucket into the freed slot. Empty buckets are dropped, every
+  //! bucket has at least one instance.
+  template<typename Key, typename Instance>
+    class instance_buckets
+  {
+  public:
+    using bucket = std::vector<Instance*>;
+    using map_type = std::unordered_map<Key*, bucket>;
+
+    //! an instance already stored moves to the bucket of the new key
+    void add (Key* key, Instance* instance)
+    {
+      auto const slot (_slots.find (instance));
+
+      if (slot != _slots.end())
+      {
+        if (slot->second.first == key)
+        {
+          return;
+        }
+
+        remove (instance);
+      }
+
+      bucket& instances (_buckets[key]);
+      _slots.emplace (instance, std::make_pair (key, instances.size()));
+      instances.push_back (instance);
+    }
+
+    //! does nothing for instances not stored, the instance isn't accessed
+    //! so it may already be destroyed
+    void remove (Instance* instance)
+    {
+      auto const slot (_slots.find (instance));
+
+      if (slot == _slots.end())
+      {
+        return;
+      }
+
+      auto const it (_buckets.find (slot->second.first));
+      bucket& instances (it->second);
+      std::size_t const index (slot->second.second);
+
+      if (index + 1 != instances.size())
+      {
+        instances[index] = instances.back();
+        _slots.at (instances[index]).second = index;
+      }
+
+      instances.pop_back();
+      _slots.erase (slot);
+
+      if (instances.empty())
+      {
+        _buckets.erase (it);
+      }
+    }
+
+    bool contains (Instance* instance) const
+    {
+      return _slots.find (instance) != _slots.end();
+    }
+
+    void clear()
+    {
+      _buckets.clear();
+      _slots.clear();
+    }
+
+    std::size_t size() const { return _slots.size(); }
+    bool empty() const { return _slots.empty(); }
+
+    //! buckets are nodes of the map, their address stays the same while
+    //! they hold instances
+    map_type const& buckets() const { return _buckets; }
+
+    typename map_type::const_iterator begin() const { return _buckets.begin(); }
+    typename map_type::const_iterator end() const { return _buckets.end(); }
+
+  private:
+    map_type _buckets;
+    std::unordered_map<Instance*, std::pair<Key*, std::size_t>> _slots;
+  };
+}
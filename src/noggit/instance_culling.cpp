@@ -0,0 +1,131 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/instance_culling.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace noggit
+{
+  namespace
+  {
+    // enough instances per job to not spend more time scheduling than culling
+    std::size_t const instances_per_job (4096);
+  }
+
+  instance_culling::instance_culling (bool cull_by_size_category)
+    : _cull_by_size_category (cull_by_size_category)
+  {}
+
+  void instance_culling::reset (std::vector<std::size_t> const& group_sizes)
+  {
+    _group_begin.resize (group_sizes.size() + 1);
+    _group_begin[0] = 0;
+    for (std::size_t group (0); group < group_sizes.size(); ++group)
+    {
+      _group_begin[group + 1] = _group_begin[group] + group_sizes[group];
+    }
+
+    std::size_t const count (size());
+    for (auto* member : {&_x, &_y, &_z, &_radius, &_size_category})
+    {
+      member->resize (count);
+    }
+    _transforms.resize (count, math::matrix_4x4::unit);
+    _visible.resize (count);
+
+    // the groups' vectors keep their memory even when there are fewer groups
+    if (_visible_transforms.size() < group_sizes.size())
+    {
+      _visible_transforms.resize (group_sizes.size());
+    }
+  }
+
+  void instance_culling::set ( std::size_t instance
+                             , math::vector_3d const& center
+                             , float radius
+                             , float size_category
+                             , math::matrix_4x4 const& transform
+                             )
+  {
+    _x[instance] = center.x;
+    _y[instance] = center.y;
+    _z[instance] = center.z;
+    _radius[instance] = radius;
+    _size_category[instance] = size_category;
+    _transforms[instance] = transform;
+  }
+
+  bool instance_culling::is_visible ( std::size_t i
+                                    , math::frustum const& frustum
+                                    , float cull_distance
+                                    , math::vector_3d const& camera
+                                    , display_mode display
+                                    ) const
+  {
+    math::vector_3d const center (_x[i], _y[i], _z[i]);
+
+    float const dist ( display == display_mode::in_3D
+                     ? (center - camera).length() - _radius[i]
+                     : std::abs (center.y - camera.y) - _radius[i]
+                     );
+
+    if (dist >= cull_distance)
+    {
+      return false;
+    }
+
+    if (_cull_by_size_category)
+    {
+      float const size_category (_size_category[i]);
+      if ( (size_category < 1.f && dist > 30.f)
+        || (size_category < 4.f && dist > 150.f)
+        || (size_category < 25.f && dist > 300.f)
+         )
+      {
+        return false;
+      }
+    }
+
+    return frustum.intersectsSphere (center, _radius[i]);
+  }
+
+  void instance_culling::cull ( job_scheduler& scheduler
+                              , math::frustum const& frustum
+                              , float cull_distance
+                              , math::vector_3d const& camera
+                              , display_mode display
+                              )
+  {
+    std::size_t const count (size());
+
+    scheduler.parallel_for
+      ( 0, (count + instances_per_job - 1) / instances_per_job
+      , [&] (std::size_t job)
+        {
+          std::size_t const end (std::min (count, (job + 1) * instances_per_job));
+          for (std::size_t i (job * instances_per_job); i < end; ++i)
+          {
+            _visible[i] = is_visible (i, frustum, cull_distance, camera, display);
+          }
+        }
+      );
+
+    scheduler.parallel_for
+      ( 0, group_count()
+      , [&] (std::size_t group)
+        {
+          std::vector<math::matrix_4x4>& visible_transforms (_visible_transforms[group]);
+          visible_transforms.clear();
+
+          for (std::size_t i (_group_begin[group]); i < _group_begin[group + 1]; ++i)
+          {
+            if (_visible[i])
+            {
+              visible_transforms.push_back (_transforms[i]);
+            }
+          }
+        }
+      );
+  }
+}
@@ -0,0 +1,78 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/frustum.hpp>
+#include <math/matrix_4x4.hpp>
+#include <math/vector_3d.hpp>
+#include <noggit/job_scheduler.hpp>
+#include <noggit/tool_enums.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace noggit
+{
+  //! Frustum and distance culling of all instances at once, giving the
+  //! same results as ModelInstance::is_visible and WMOInstance::is_visible
+  //! would one by one. Instances come in groups, the instances of one
+  //! model or wmo, and every group gets the transforms of its visible
+  //! instances compacted, in order, ready to be uploaded as instance data.
+  //! Bounding spheres and transforms are kept one array per member, and
+  //! the memory is kept from one cull to the next.
+  class instance_culling
+  {
+  public:
+    //! models also skip small instances farther than their size category
+    //! allows, wmos don't
+    explicit instance_culling (bool cull_by_size_category);
+
+    //! forget the instances and lay out new groups
+    void reset (std::vector<std::size_t> const& group_sizes);
+
+    std::size_t size() const { return _group_begin.back(); }
+    std::size_t group_count() const { return _group_begin.size() - 1; }
+    std::size_t group_begin (std::size_t group) const { return _group_begin[group]; }
+
+    //! safe to call from different threads for different instances
+    void set ( std::size_t instance
+             , math::vector_3d const& center
+             , float radius
+             , float size_category
+             , math::matrix_4x4 const& transform
+             );
+
+    void cull ( job_scheduler&
+              , math::frustum const&
+              , float cull_distance
+              , math::vector_3d const& camera
+              , display_mode
+              );
+
+    bool visible (std::size_t instance) const { return _visible[instance]; }
+    std::vector<math::matrix_4x4> const& visible_transforms (std::size_t group) const
+    {
+      return _visible_transforms[group];
+    }
+
+  private:
+    bool is_visible ( std::size_t instance
+                    , math::frustum const&
+                    , float cull_distance
+                    , math::vector_3d const& camera
+                    , display_mode
+                    ) const;
+
+    bool _cull_by_size_category;
+
+    std::vector<std::size_t> _group_begin = {0};
+
+    std::vector<float> _x, _y, _z;
+    std::vector<float> _radius;
+    std::vector<float> _size_category;
+    std::vector<math::matrix_4x4> _transforms;
+
+    std::vector<char> _visible;
+    std::vector<std::vector<math::matrix_4x4>> _visible_transforms;
+  };
+}
@@ -0,0 +1,209 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/instance_grid.hpp>
+
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace noggit
+{
+  namespace
+  {
+    // far outside of any map, only there to keep garbage positions
+    // from overflowing the cell coordinates
+    constexpr float cell_coordinate_limit = 1 << 20;
+
+    // positions are compared against chunk borders by the callers, make
+    // sure rounding never puts an instance into a cell that isn't visited
+    constexpr float rect_margin = 1.f;
+
+    void grow (instance_grid::bounds& all, instance_grid::bounds const& other)
+    {
+      all.min = math::min (all.min, other.min);
+      all.max = math::max (all.max, other.max);
+    }
+  }
+
+  int instance_grid::cell_coordinate (float position)
+  {
+    float const cell (std::floor (position / CHUNKSIZE));
+
+    // also catches nan
+    if (!(std::abs (cell) < cell_coordinate_limit))
+    {
+      return cell > 0.f ? cell_coordinate_limit : -cell_coordinate_limit;
+    }
+
+    return static_cast<int> (cell);
+  }
+
+  std::uint64_t instance_grid::cell_key (int x, int z)
+  {
+    return (std::uint64_t (std::uint32_t (x)) << 32) | std::uint32_t (z);
+  }
+
+  void instance_grid::insert ( std::uint32_t uid
+                             , math::vector_3d const& pos
+                             , boost::optional<bounds> const& instance_bounds
+                             )
+  {
+    std::uint64_t const key (cell_key (cell_coordinate (pos.x), cell_coordinate (pos.z)));
+
+    if (!_instances.emplace (uid, instance {key, instance_bounds}).second)
+    {
+      return;
+    }
+
+    cell& bucket (_cells[key]);
+    bucket.uids.push_back (uid);
+
+    if (!instance_bounds)
+    {
+      ++bucket.unbounded;
+    }
+    else if (!bucket.outdated_bounds)
+    {
+      if (bucket.bounded)
+      {
+        grow (bucket.all, *instance_bounds);
+      }
+      else
+      {
+        bucket.all = *instance_bounds;
+        bucket.bounded = true;
+      }
+    }
+  }
+
+  void instance_grid::update ( std::uint32_t uid
+                             , math::vector_3d const& pos
+                             , boost::optional<bounds> const& instance_bounds
+                             )
+  {
+    remove (uid);
+    insert (uid, pos, instance_bounds);
+  }
+
+  void instance_grid::remove (std::uint32_t uid)
+  {
+    auto const it (_instances.find (uid));
+
+    if (it == _instances.end())
+    {
+      return;
+    }
+
+    auto const bucket_it (_cells.find (it->second.cell));
+    cell& bucket (bucket_it->second);
+
+    if (bucket.uids.size() == 1)
+    {
+      _cells.erase (bucket_it);
+    }
+    else
+    {
+      auto const pos (std::find (bucket.uids.begin(), bucket.uids.end(), uid));
+      *pos = bucket.uids.back();
+      bucket.uids.pop_back();
+
+      if (it->second.instance_bounds)
+      {
+        bucket.outdated_bounds = true;
+      }
+      else
+      {
+        --bucket.unbounded;
+      }
+    }
+
+    _instances.erase (it);
+  }
+
+  void instance_grid::clear()
+  {
+    _instances.clear();
+    _cells.clear();
+  }
+
+  std::vector<std::uint32_t> instance_grid::in_rect (float min_x, float min_z, float max_x, float max_z) const
+  {
+    std::vector<std::uint32_t> uids;
+
+    int const first_x (cell_coordinate (min_x - rect_margin));
+    int const first_z (cell_coordinate (min_z - rect_margin));
+    int const last_x (cell_coordinate (max_x + rect_margin));
+    int const last_z (cell_coordinate (max_z + rect_margin));
+
+    if (first_x > last_x || first_z > last_z)
+    {
+      return uids;
+    }
+
+    auto const add
+      ( [&] (cell const& bucket)
+        {
+          uids.insert (uids.end(), bucket.uids.begin(), bucket.uids.end());
+        }
+      );
+
+    // a huge rectangle is cheaper to answer by looking at what is there
+    if (double (last_x - first_x + 1) * double (last_z - first_z + 1) > _cells.size())
+    {
+      for (auto const& it : _cells)
+      {
+        int const x (static_cast<std::int32_t> (it.first >> 32));
+        int const z (static_cast<std::int32_t> (it.first & 0xFFFFFFFF));
+
+        if (x >= first_x && x <= last_x && z >= first_z && z <= last_z)
+        {
+          add (it.second);
+        }
+      }
+    }
+    else
+    {
+      for (int x (first_x); x <= last_x; ++x)
+      {
+        for (int z (first_z); z <= last_z; ++z)
+        {
+          auto const it (_cells.find (cell_key (x, z)));
+
+          if (it != _cells.end())
+          {
+            add (it->second);
+          }
+        }
+      }
+    }
+
+    return uids;
+  }
+
+  void instance_grid::update_bounds (cell& bucket)
+  {
+    bucket.bounded = false;
+    bucket.outdated_bounds = false;
+
+    for (std::uint32_t uid : bucket.uids)
+    {
+      auto const& instance_bounds (_instances.at (uid).instance_bounds);
+
+      if (!instance_bounds)
+      {
+        continue;
+      }
+
+      if (bucket.bounded)
+      {
+        grow (bucket.all, *instance_bounds);
+      }
+      else
+      {
+        bucket.all = *instance_bounds;
+        bucket.bounded = true;
+      }
+    }
+  }
+}
@@ -0,0 +1,117 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace noggit
+{
+  //! Spatial index over the model and object instances of a map, so
+  //! that chunk, range and ray queries look at what is near them rather
+  //! than at every loaded instance. Instances are bucketed by the map
+  //! chunk their position is in, and every bucket keeps the union of
+  //! its instances' bounds so rays can skip whole chunks.
+  //! Not thread safe: the instance storage owning it locks.
+  class instance_grid
+  {
+  public:
+    struct bounds
+    {
+      math::vector_3d min;
+      math::vector_3d max;
+    };
+
+    //! \a instance_bounds is none while they aren't known, e.g. when
+    //! the model isn't loaded yet: such instances match every ray
+    void insert ( std::uint32_t uid
+                , math::vector_3d const& pos
+                , boost::optional<bounds> const& instance_bounds
+                );
+    //! insert, or move to the new position and bounds
+    void update ( std::uint32_t uid
+                , math::vector_3d const& pos
+                , boost::optional<bounds> const& instance_bounds
+                );
+    void remove (std::uint32_t uid);
+    void clear();
+
+    std::size_t size() const { return _instances.size(); }
+    bool contains (std::uint32_t uid) const { return _instances.count (uid); }
+
+    //! every instance in a chunk overlapping the rectangle in x and z,
+    //! along with a few more: callers check the actual positions
+    std::vector<std::uint32_t> in_rect (float min_x, float min_z, float max_x, float max_z) const;
+
+    //! every instance whose bounds \a hits (min, max) accepts, and all
+    //! of those without bounds
+    template<typename Hits>
+      std::vector<std::uint32_t> hit_candidates (Hits&& hits)
+    {
+      std::vector<std::uint32_t> uids;
+
+      for (auto& it : _cells)
+      {
+        cell& bucket (it.second);
+
+        if (bucket.outdated_bounds)
+        {
+          update_bounds (bucket);
+        }
+
+        bool const bucket_hit (bucket.bounded && hits (bucket.all.min, bucket.all.max));
+
+        if (!bucket_hit && !bucket.unbounded)
+        {
+          continue;
+        }
+
+        for (std::uint32_t uid : bucket.uids)
+        {
+          auto const& instance_bounds (_instances.at (uid).instance_bounds);
+
+          if (!instance_bounds || (bucket_hit && hits (instance_bounds->min, instance_bounds->max)))
+          {
+            uids.push_back (uid);
+          }
+        }
+      }
+
+      return uids;
+    }
+
+    //! chunk coordinates over the whole map, i.e. tile * 16 + chunk
+    static int cell_coordinate (float position);
+
+  private:
+    struct instance
+    {
+      std::uint64_t cell;
+      boost::optional<bounds> instance_bounds;
+    };
+
+    struct cell
+    {
+      std::vector<std::uint32_t> uids;
+      //! union of the instances' bounds, if any has some
+      bounds all;
+      bool bounded = false;
+      //! an instance left: the union may be too big until recomputed
+      bool outdated_bounds = false;
+      std::size_t unbounded = 0;
+    };
+
+    static std::uint64_t cell_key (int x, int z);
+
+    void update_bounds (cell&);
+
+    std::unordered_map<std::uint32_t, instance> _instances;
+    std::unordered_map<std::uint64_t, cell> _cells;
+  };
+}
@@ -0,0 +1,243 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/job_scheduler.hpp>
+
+#include <cassert>
+
+namespace noggit
+{
+  namespace
+  {
+    thread_local job_scheduler const* current_scheduler = nullptr;
+    thread_local std::size_t current_worker = 0;
+  }
+
+  struct job_scheduler::worker
+  {
+    worker (std::size_t priority_count) : queues (priority_count) {}
+
+    std::mutex guard;
+    std::vector<std::deque<handle>> queues;
+  };
+
+  job_scheduler::job_scheduler (std::size_t thread_count, std::size_t priority_count)
+    : _priority_count (std::max<std::size_t> (1, priority_count))
+    , _queued_by_priority (std::make_unique<std::atomic<std::size_t>[]> (_priority_count))
+  {
+    // make sure there's always at least one thread, otherwise nothing
+    // would ever run
+    thread_count = std::max<std::size_t> (1, thread_count);
+
+    for (std::size_t i (0); i < thread_count; ++i)
+    {
+      _workers.emplace_back (std::make_unique<worker> (_priority_count));
+    }
+    for (std::size_t i (0); i < thread_count; ++i)
+    {
+      _threads.emplace_back (&job_scheduler::process, this, i);
+    }
+  }
+
+  job_scheduler::~job_scheduler()
+  {
+    {
+      std::lock_guard<std::mutex> const lock (_idle_guard);
+      _stop = true;
+    }
+    _work_available.notify_all();
+
+    for (auto& thread : _threads)
+    {
+      thread.join();
+    }
+  }
+
+  job_scheduler::handle job_scheduler::schedule (std::function<void()> fun, std::size_t priority)
+  {
+    auto new_job (std::make_shared<job> (std::move (fun)));
+    priority = std::min (priority, _priority_count - 1);
+
+    ++_unfinished;
+
+    if (current_scheduler == this)
+    {
+      worker& own (*_workers[current_worker]);
+      std::lock_guard<std::mutex> const lock (own.guard);
+      own.queues[priority].push_front (new_job);
+    }
+    else
+    {
+      worker& target (*_workers[_next_worker++ % _workers.size()]);
+      std::lock_guard<std::mutex> const lock (target.guard);
+      target.queues[priority].push_back (new_job);
+    }
+
+    ++_queued_by_priority[priority];
+    ++_queued;
+    wake_one();
+
+    return new_job;
+  }
+
+  bool job_scheduler::cancel (handle const& to_cancel)
+  {
+    auto expected (job::state::queued);
+    if (!to_cancel->_state.compare_exchange_strong (expected, job::state::cancelled))
+    {
+      return false;
+    }
+
+    // the entry stays in its deque until a worker comes across it, but
+    // whatever the job captured can go right now
+    to_cancel->_fun = nullptr;
+    finished();
+
+    return true;
+  }
+
+  void job_scheduler::wait (handle const& to_wait_for)
+  {
+    if (to_wait_for->finished())
+    {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock (_done_guard);
+    ++_done_waiters;
+    _job_done.wait (lock, [&] { return to_wait_for->finished(); });
+    --_done_waiters;
+  }
+
+  void job_scheduler::run_or_wait (handle const& to_run)
+  {
+    if (to_run->claim())
+    {
+      execute (*to_run);
+    }
+    else
+    {
+      wait (to_run);
+    }
+  }
+
+  void job_scheduler::wait_idle()
+  {
+    if (_unfinished.load() == 0)
+    {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock (_done_guard);
+    ++_done_waiters;
+    _job_done.wait (lock, [&] { return _unfinished.load() == 0; });
+    --_done_waiters;
+  }
+
+  void job_scheduler::process (std::size_t index)
+  {
+    current_scheduler = this;
+    current_worker = index;
+
+    while (!_stop)
+    {
+      if (handle next = take (index))
+      {
+        if (next->claim())
+        {
+          execute (*next);
+        }
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock (_idle_guard);
+      ++_sleeping;
+      _work_available.wait (lock, [&] { return _stop || _queued.load() > 0; });
+      --_sleeping;
+    }
+  }
+
+  job_scheduler::handle job_scheduler::take (std::size_t index)
+  {
+    std::size_t const count (_workers.size());
+
+    for (std::size_t priority (0); priority < _priority_count; ++priority)
+    {
+      if (_queued_by_priority[priority].load() == 0)
+      {
+        continue;
+      }
+
+      {
+        worker& own (*_workers[index]);
+        std::lock_guard<std::mutex> const lock (own.guard);
+        auto& queue (own.queues[priority]);
+        if (!queue.empty())
+        {
+          handle next (std::move (queue.front()));
+          queue.pop_front();
+          --_queued_by_priority[priority];
+          --_queued;
+          return next;
+        }
+      }
+
+      // steal from the back, the owner works on the front
+      for (std::size_t offset (1); offset < count; ++offset)
+      {
+        worker& victim (*_workers[(index + offset) % count]);
+        std::lock_guard<std::mutex> const lock (victim.guard);
+        auto& queue (victim.queues[priority]);
+        if (!queue.empty())
+        {
+          handle next (std::move (queue.back()));
+          queue.pop_back();
+          --_queued_by_priority[priority];
+          --_queued;
+          return next;
+        }
+      }
+    }
+
+    return nullptr;
+  }
+
+  void job_scheduler::execute (job& to_run)
+  {
+    assert (to_run._state.load() == job::state::running);
+
+    to_run._fun();
+    to_run._fun = nullptr;
+    to_run._state = job::state::done;
+
+    finished();
+  }
+
+  void job_scheduler::finished()
+  {
+    --_unfinished;
+
+    if (_done_waiters.load() > 0)
+    {
+      std::lock_guard<std::mutex> const lock (_done_guard);
+      _job_done.notify_all();
+    }
+  }
+
+  void job_scheduler::wake_one()
+  {
+    if (_sleeping.load() > 0)
+    {
+      std::lock_guard<std::mutex> const lock (_idle_guard);
+      _work_available.notify_one();
+    }
+  }
+
+  job_scheduler& compute_scheduler()
+  {
+    static job_scheduler scheduler
+      ( std::max (2u, std::thread::hardware_concurrency()) - 1
+      , 2
+      );
+    return scheduler;
+  }
+}
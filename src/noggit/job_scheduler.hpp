@@ -0,0 +1,197 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace noggit
+{
+  //! Thread pool with one deque per worker and priority. Workers take
+  //! from their own deques first and steal from the others when idle,
+  //! so there is no single lock every job has to go through. Priority 0
+  //! is the most important one; a worker only looks at a lower priority
+  //! once every deque of the higher ones is empty.
+  class job_scheduler
+  {
+  public:
+    class job;
+    //! Cancelling or waiting for a job goes through its handle, which
+    //! stays valid even after the job ran or was dropped.
+    using handle = std::shared_ptr<job>;
+
+    job_scheduler (std::size_t thread_count, std::size_t priority_count);
+    ~job_scheduler();
+
+    job_scheduler() = delete;
+    job_scheduler (job_scheduler const&) = delete;
+    job_scheduler (job_scheduler&&) = delete;
+    job_scheduler& operator= (job_scheduler const&) = delete;
+    job_scheduler& operator= (job_scheduler&&) = delete;
+
+    //! When called from one of the workers, the job goes to the front
+    //! of that worker's own deque so that dependents of the job that is
+    //! currently running (e.g. the textures of a model) are picked up
+    //! next. Other threads distribute their jobs over all workers.
+    //! fun must not throw.
+    handle schedule (std::function<void()> fun, std::size_t priority);
+
+    //! O(1). Returns true if the job did not start and never will.
+    bool cancel (handle const&);
+    //! Block until the job either finished or got cancelled.
+    void wait (handle const&);
+    //! Run the job on the calling thread if no worker picked it up yet,
+    //! wait for it otherwise. Safe to use from inside a job.
+    void run_or_wait (handle const&);
+    //! Block until every job scheduled so far finished or got cancelled.
+    void wait_idle();
+
+    std::size_t thread_count() const { return _workers.size(); }
+    std::size_t priority_count() const { return _priority_count; }
+    //! Number of jobs scheduled and neither finished nor cancelled.
+    std::size_t unfinished() const { return _unfinished.load(); }
+
+    //! Call fun (i) for every i in [begin, end) using the workers and
+    //! the calling thread, return once all of them are done. The first
+    //! exception thrown by fun is rethrown on the calling thread.
+    template<typename Fun>
+      void parallel_for (std::size_t begin, std::size_t end, Fun&& fun);
+
+  private:
+    struct worker;
+
+    void process (std::size_t index);
+    handle take (std::size_t index);
+    void execute (job&);
+    void finished();
+    void wake_one();
+
+    std::size_t const _priority_count;
+    std::vector<std::unique_ptr<worker>> _workers;
+    std::vector<std::thread> _threads;
+
+    std::atomic<bool> _stop = {false};
+    //! entries still sitting in a deque, including cancelled ones, in
+    //! total and per priority so that empty levels are skipped without
+    //! touching every worker's lock
+    std::atomic<std::size_t> _queued = {0};
+    std::unique_ptr<std::atomic<std::size_t>[]> _queued_by_priority;
+    std::atomic<std::size_t> _unfinished = {0};
+    std::atomic<std::size_t> _next_worker = {0};
+
+    std::mutex _idle_guard;
+    std::condition_variable _work_available;
+    std::atomic<std::size_t> _sleeping = {0};
+
+    std::mutex _done_guard;
+    std::condition_variable _job_done;
+    std::atomic<std::size_t> _done_waiters = {0};
+  };
+
+  class job_scheduler::job
+  {
+  public:
+    enum class state : int
+    {
+      queued,
+      running,
+      done,
+      cancelled,
+    };
+
+    job (std::function<void()> fun) : _fun (std::move (fun)) {}
+
+    state current_state() const { return _state.load(); }
+    bool finished() const
+    {
+      auto const s (_state.load());
+      return s == state::done || s == state::cancelled;
+    }
+
+  private:
+    friend class job_scheduler;
+
+    bool claim()
+    {
+      state expected (state::queued);
+      return _state.compare_exchange_strong (expected, state::running);
+    }
+
+    std::function<void()> _fun;
+    std::atomic<state> _state = {state::queued};
+  };
+
+  //! Pool for splitting CPU bound work of the editor itself over all
+  //! cores, e.g. saving tiles. Kept apart from the AsyncLoader's pool so
+  //! that neither starves the other. Created on first use with one
+  //! worker less than there are cores, the thread asking for the work
+  //! is expected to help (see parallel_for and run_or_wait).
+  job_scheduler& compute_scheduler();
+
+  template<typename Fun>
+    void job_scheduler::parallel_for (std::size_t begin, std::size_t end, Fun&& fun)
+  {
+    if (begin >= end)
+    {
+      return;
+    }
+
+    std::size_t const count (end - begin);
+    std::size_t const slices (std::min (count, thread_count() + 1));
+    std::size_t const per_slice ((count + slices - 1) / slices);
+
+    std::mutex exception_guard;
+    std::exception_ptr exception;
+
+    auto const run_slice
+      ( [&] (std::size_t slice)
+        {
+          try
+          {
+            std::size_t const from (begin + slice * per_slice);
+            std::size_t const to (std::min (end, from + per_slice));
+            for (std::size_t i (from); i < to; ++i)
+            {
+              fun (i);
+            }
+          }
+          catch (...)
+          {
+            std::lock_guard<std::mutex> const lock (exception_guard);
+            if (!exception)
+            {
+              exception = std::current_exception();
+            }
+          }
+        }
+      );
+
+    std::vector<handle> jobs;
+    jobs.reserve (slices - 1);
+    for (std::size_t slice (1); slice < slices; ++slice)
+    {
+      jobs.emplace_back (schedule ([&run_slice, slice] { run_slice (slice); }, 0));
+    }
+
+    run_slice (0);
+
+    for (auto const& slice_job : jobs)
+    {
+      run_or_wait (slice_job);
+    }
+
+    if (exception)
+    {
+      std::rethrow_exception (exception);
+    }
+  }
+}
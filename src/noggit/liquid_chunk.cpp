@@ -116,9 +116,9 @@ void liquid_chunk::update_attributes()
   }
 }
 
-void liquid_chunk::save(util::sExtendableArray& adt, int base_pos, int& header_pos, int& current_pos)
+noggit::adt::mh2o_chunk liquid_chunk::save()
 {
-  MH2O_Header header;
+  noggit::adt::mh2o_chunk chunk;
 
   // remove empty layers
   cleanup();
@@ -126,54 +126,33 @@ void liquid_chunk::save(util::sExtendableArray& adt, int base_pos, int& header_p
 
   if (hasData(0))
   {
-    header.nLayers = _layer_count;
-
     // fagique only for single layer ocean chunk
     bool fatigue = _layers[0].has_fatigue();
 
     if (!fatigue)
     {
-      header.ofsRenderMask = current_pos - base_pos;
-      adt.Insert(current_pos, sizeof(MH2O_Attributes), reinterpret_cast<char*>(&attributes));
-      current_pos += sizeof(MH2O_Attributes);
+      chunk.attributes = attributes;
     }
-    else
-    {
-      header.ofsRenderMask = 0;
-    }
-
-    header.ofsInformation = current_pos - base_pos;
-    int info_pos = current_pos;
-
-    std::size_t info_size = sizeof(MH2O_Information) * _layer_count;
-    current_pos += info_size;
 
-    adt.Extend(info_size);
-
-    for (liquid_layer& layer : _layers)
+    for (liquid_layer const& layer : _layers)
     {
-      layer.save(adt, base_pos, info_pos, current_pos);
+      chunk.layers.push_back(layer.save());
     }
   }
 
-  memcpy(adt.GetPointer<char>(header_pos).get(), &header, sizeof(MH2O_Header));
-  header_pos += sizeof(MH2O_Header);
+  return chunk;
 }
 
-void liquid_chunk::save_mclq(util::sExtendableArray& adt, int mcnk_pos, int& current_pos)
+std::vector<mclq> liquid_chunk::save_mclq(mcnk_flags& flags)
 {
+  std::vector<mclq> layers;
+
   // remove empty layers
   cleanup();
   update_attributes();
 
   if (hasData(0))
   {
-    adt.Extend(sizeof(mclq) * _layer_count + 8);
-    // size seems to be 0 in vanilla adts in the mclq chunk's header and set right in the mcnk header (layer_size * n_layer + 8)
-    SetChunkHeader(adt, current_pos, 'MCLQ', 0);
-
-    current_pos += 8;
-
     // it's possible to merge layers when they don't overlap (liquids using the same vertice, but at different height)
     // layer ordering seems to matter, having a lava layer then a river layer causes the lava layer to not render ingame
     // sorting order seems to be dependant on the flag ordering in the mcnk's header
@@ -184,16 +163,16 @@ void liquid_chunk::save_mclq(util::sExtendableArray& adt, int mcnk_pos, int& cur
       switch (layer.mclq_liquid_type())
       {
       case 6: // lava
-        adt.GetPointer<MapChunkHeader>(mcnk_pos + 8)->flags.flags.lq_magma = 1;
+        flags.flags.lq_magma = 1;
         break;
       case 3: // slime
-        adt.GetPointer<MapChunkHeader>(mcnk_pos + 8)->flags.flags.lq_slime = 1;
+        flags.flags.lq_slime = 1;
         break;
       case 1: // ocean
-        adt.GetPointer<MapChunkHeader>(mcnk_pos + 8)->flags.flags.lq_ocean = 1;
+        flags.flags.lq_ocean = 1;
         break;
       default: // river
-        adt.GetPointer<MapChunkHeader>(mcnk_pos + 8)->flags.flags.lq_river = 1;
+        flags.flags.lq_river = 1;
         break;
       }
 
@@ -210,10 +189,11 @@ void liquid_chunk::save_mclq(util::sExtendableArray& adt, int mcnk_pos, int& cur
 
     for (auto const& mclq_layer : mclq_layers)
     {
-      std::memcpy(adt.GetPointer<char>(current_pos).get(), &mclq_layer.first, sizeof(mclq));
-      current_pos += sizeof(mclq);
+      layers.push_back(mclq_layer.first);
     }
   }
+
+  return layers;
 }
 
 void liquid_chunk::copy_data(noggit::chunk_data& data) const
@@ -10,7 +10,6 @@
 #include <noggit/MapHeaders.h>
 #include <noggit/Selection.h>
 #include <noggit/tool_enums.hpp>
-#include <util/sExtendableArray.hpp>
 
 #include <vector>
 #include <set>
@@ -40,8 +39,10 @@ class liquid_chunk
 
   void from_mclq(std::vector<mclq>& layers);
   void fromFile(MPQFile &f, size_t basePos);
-  void save(util::sExtendableArray& adt, int base_pos, int& header_pos, int& current_pos);
-  void save_mclq(util::sExtendableArray& adt, int mcnk_pos, int& current_pos);
+  noggit::adt::mh2o_chunk save();
+  //! sorted the way the client wants them, sets the liquid type flags
+  //! they need in the chunk's flags
+  std::vector<mclq> save_mclq(mcnk_flags& flags);
 
   void copy_data(noggit::chunk_data& data) const;
   void override_data(noggit::chunk_data const& data, noggit::chunk_override_params const& params);
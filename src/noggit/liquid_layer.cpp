@@ -266,7 +266,7 @@ void liquid_layer::create_vertices(float height)
   }
 }
 
-void liquid_layer::save(util::sExtendableArray& adt, int base_pos, int& info_pos, int& current_pos) const
+noggit::adt::mh2o_layer liquid_layer::save() const
 {
   int min_x = 9, min_z = 9, max_x = 0, max_z = 0;
   bool filled = true;
@@ -289,8 +289,8 @@ void liquid_layer::save(util::sExtendableArray& adt, int base_pos, int& info_pos
     }
   }
 
-  MH2O_Information info;
-  std::uint64_t mask = 0;
+  noggit::adt::mh2o_layer layer;
+  MH2O_Information& info = layer.information;
 
   info.liquid_id = _liquid_id;
   info.liquid_vertex_format = _liquid_vertex_format;
@@ -301,12 +301,9 @@ void liquid_layer::save(util::sExtendableArray& adt, int base_pos, int& info_pos
   info.width = max_x - min_x;
   info.height = max_z - min_z;
 
-  if (filled)
-  {
-    info.ofsInfoMask = 0;
-  }
-  else
+  if (!filled)
   {
+    std::uint64_t mask = 0;
     std::uint64_t value = 1;
     for (int z = info.yOffset; z < info.yOffset + info.height; ++z)
     {
@@ -322,37 +319,33 @@ void liquid_layer::save(util::sExtendableArray& adt, int base_pos, int& info_pos
 
     if (mask > 0)
     {
-      info.ofsInfoMask = current_pos - base_pos;
-      adt.Insert(current_pos, 8, reinterpret_cast<char*>(&mask));
-      current_pos += 8;
+      layer.mask = mask;
     }
   }
 
   int vertices_count = (info.width + 1) * (info.height + 1);
-  info.ofsHeightMap = current_pos - base_pos;
 
   if (_liquid_vertex_format == 0 || _liquid_vertex_format == 1)
   {
-    adt.Extend(vertices_count * sizeof(float));
+    layer.heights.reserve(vertices_count);
 
     for (int z = info.yOffset; z <= info.yOffset + info.height; ++z)
     {
       for (int x = info.xOffset; x <= info.xOffset + info.width; ++x)
       {
-        memcpy(adt.GetPointer<char>(current_pos).get(), &_vertices[z * 9 + x].position.y, sizeof(float));
-        current_pos += sizeof(float);
+        layer.heights.push_back(_vertices[z * 9 + x].position.y);
       }
     }
   }
   // no heightmap/depth data for fatigue chunks
   else if(_fatigue_enabled)
   {
-    info.ofsHeightMap = 0;
+    layer.has_height_map_offset = false;
   }
 
   if (_liquid_vertex_format == 1)
   {
-    adt.Extend(vertices_count * sizeof(mh2o_uv));
+    layer.uvs.reserve(vertices_count);
 
     for (int z = info.yOffset; z <= info.yOffset + info.height; ++z)
     {
@@ -362,29 +355,25 @@ void liquid_layer::save(util::sExtendableArray& adt, int base_pos, int& info_pos
         uv.x = static_cast<std::uint16_t>(std::min(_vertices[z * 9 + x].uv.x * 255.f, 65535.f));
         uv.y = static_cast<std::uint16_t>(std::min(_vertices[z * 9 + x].uv.y * 255.f, 65535.f));
 
-        memcpy(adt.GetPointer<char>(current_pos).get(), &uv, sizeof(mh2o_uv));
-        current_pos += sizeof(mh2o_uv);
+        layer.uvs.push_back(uv);
       }
     }
   }
 
   if (_liquid_vertex_format == 0 || (_liquid_vertex_format == 2 && !_fatigue_enabled))
   {
-    adt.Extend(vertices_count * sizeof(std::uint8_t));
+    layer.depths.reserve(vertices_count);
 
     for (int z = info.yOffset; z <= info.yOffset + info.height; ++z)
     {
       for (int x = info.xOffset; x <= info.xOffset + info.width; ++x)
       {
-        std::uint8_t depth = static_cast<std::uint8_t>(std::min(_vertices[z * 9 + x].depth * 255.0f, 255.f));
-        memcpy(adt.GetPointer<char>(current_pos).get(), &depth, sizeof(std::uint8_t));
-        current_pos += sizeof(std::uint8_t);
+        layer.depths.push_back(static_cast<std::uint8_t>(std::min(_vertices[z * 9 + x].depth * 255.0f, 255.f)));
       }
     }
   }
 
-  memcpy(adt.GetPointer<char>(info_pos).get(), &info, sizeof(MH2O_Information));
-  info_pos += sizeof(MH2O_Information);
+  return layer;
 }
 
 void liquid_layer::changeLiquidID(int id)
@@ -8,8 +8,8 @@
 #include <noggit/map_chunk_headers.hpp>
 #include <noggit/MapHeaders.h>
 #include <noggit/Selection.h>
+#include <noggit/adt_file.hpp>
 #include <math/vector_2d.hpp>
-#include <util/sExtendableArray.hpp>
 
 class MapChunk;
 
@@ -31,7 +31,7 @@ class liquid_layer
   liquid_layer& operator=(liquid_layer&&);
   liquid_layer& operator=(liquid_layer const& other);
 
-  void save(util::sExtendableArray& adt, int base_pos, int& info_pos, int& current_pos) const;
+  noggit::adt::mh2o_layer save() const;
   mclq to_mclq(MH2O_Attributes& attributes) const;
 
   void copy_data(noggit::chunk_data& data) const;
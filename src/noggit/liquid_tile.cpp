@@ -112,34 +112,26 @@ void liquid_tile::update_underground_vertices_depth()
   }
 }
 
-void liquid_tile::saveToFile(util::sExtendableArray &lADTFile, int &lMHDR_Position, int &lCurrentPosition)
+std::vector<noggit::adt::mh2o_chunk> liquid_tile::save()
 {
+  std::vector<noggit::adt::mh2o_chunk> water;
+
   if (!hasData(0))
   {
-    return;
+    return water;
   }
 
-  int ofsW = lCurrentPosition + 0x8; //water Header pos
-
-  lADTFile.GetPointer<MHDR>(lMHDR_Position + 8)->mh2o = lCurrentPosition - 0x14; //setting offset to MH2O data in Header
-
-  int headers_size = 256 * sizeof(MH2O_Header);
-  // 8 empty bytes for the chunk header
-  lADTFile.Extend(8 + headers_size);
-  // set current pos after the mh2o headers
-  lCurrentPosition = ofsW + headers_size;
-  int header_pos = ofsW;
-
+  water.reserve(16 * 16);
 
   for (int z = 0; z < 16; ++z)
   {
     for (int x = 0; x < 16; ++x)
     {
-      chunks[z][x]->save(lADTFile, ofsW, header_pos, lCurrentPosition);
+      water.push_back(chunks[z][x]->save());
     }
   }
 
-  SetChunkHeader(lADTFile, ofsW - 8, 'MH2O', lCurrentPosition - ofsW);
+  return water;
 }
 
 bool liquid_tile::hasData(size_t layer)
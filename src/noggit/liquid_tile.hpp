@@ -8,11 +8,13 @@
 #include <noggit/MPQ.h>
 #include <noggit/MapHeaders.h>
 #include <noggit/Selection.h>
+#include <noggit/adt_file.hpp>
 #include <noggit/tool_enums.hpp>
-#include <util/sExtendableArray.hpp>
 #include <opengl/scoped.hpp>
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 class MapTile;
 
@@ -24,7 +26,8 @@ class liquid_tile
   liquid_chunk* getChunk(int x, int z);
 
   void readFromFile(MPQFile &theFile, size_t basePos);
-  void saveToFile(util::sExtendableArray &lADTFile, int &lMHDR_Position, int &lCurrentPosition);
+  //! MH2O contents, empty if there is no liquid on the tile at all
+  std::vector<noggit::adt::mh2o_chunk> save();
 
   void draw ( math::frustum const& frustum
             , const float& cull_distance
@@ -75,7 +78,8 @@ class liquid_tile
   std::vector<math::vector_3d> _intersect_points;
 
   bool _need_recalc_extents = true;
-  bool _has_liquids = false;
+  // set by the chunks, which load in parallel
+  std::atomic<bool> _has_liquids = {false};
   bool _need_visibility_update = true;
 
   void update_visibility( const float& cull_distance
@@ -86,8 +90,8 @@ class liquid_tile
 
 private:
   bool _uploaded = false;
-  bool _need_buffer_regen = true; // recreate the buffer when a layer is added or removed
-  bool _need_buffer_update = true; // update the buffer when a layer is modified
+  std::atomic<bool> _need_buffer_regen = {true}; // recreate the buffer when a layer is added or removed
+  std::atomic<bool> _need_buffer_update = {true}; // update the buffer when a layer is modified
 
   void upload(opengl::scoped::use_program& water_shader, liquid_render& render);
   void regen_buffer(liquid_render& render);
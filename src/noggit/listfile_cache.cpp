@@ -0,0 +1,239 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/listfile_cache.hpp>
+#include <noggit/mapped_file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace noggit
+{
+  namespace
+  {
+    char const magic[8] = {'N', 'O', 'G', 'G', 'I', 'T', 'L', 'C'};
+
+    struct archive_stamp
+    {
+      std::uint64_t size;
+      std::int64_t modification_time;
+    };
+
+    boost::optional<archive_stamp> stamp_of (boost::filesystem::path const& archive)
+    {
+      boost::system::error_code ec;
+      archive_stamp stamp;
+      stamp.size = boost::filesystem::file_size (archive, ec);
+      if (ec)
+      {
+        return boost::none;
+      }
+      stamp.modification_time = boost::filesystem::last_write_time (archive, ec);
+      if (ec)
+      {
+        return boost::none;
+      }
+      return stamp;
+    }
+
+    struct reader
+    {
+      char const* data;
+      std::size_t size;
+      std::size_t position = 0;
+      bool failed = false;
+
+      template<typename T>
+        T read()
+      {
+        T value {};
+        if (!failed && size - position >= sizeof (T))
+        {
+          std::memcpy (&value, data + position, sizeof (T));
+          position += sizeof (T);
+        }
+        else
+        {
+          failed = true;
+        }
+        return value;
+      }
+
+      char const* skip (std::size_t count)
+      {
+        if (failed || size - position < count)
+        {
+          failed = true;
+          return nullptr;
+        }
+        char const* const start (data + position);
+        position += count;
+        return start;
+      }
+    };
+
+    template<typename T>
+      void write_value (std::string& output, T const& value)
+    {
+      output.append (reinterpret_cast<char const*> (&value), sizeof (T));
+    }
+  }
+
+  archive_listfile parse_listfile (char const* data, std::size_t size)
+  {
+    archive_listfile listfile;
+    listfile.has_listfile = true;
+
+    char const* const end (data + size);
+    while (data < end)
+    {
+      char const* const line_end (std::find (data, end, '\n'));
+
+      std::string name;
+      name.reserve (line_end - data);
+      for (char const* c (data); c != line_end; ++c)
+      {
+        if (*c == '\r')
+        {
+          continue;
+        }
+        name.push_back ( *c == '\\' ? '/'
+                       : (*c >= 'A' && *c <= 'Z') ? static_cast<char> (*c - 'A' + 'a')
+                       : *c
+                       );
+      }
+
+      if (!name.empty())
+      {
+        listfile.names.emplace_back (std::move (name));
+      }
+
+      data = line_end == end ? end : line_end + 1;
+    }
+
+    listfile.present.assign (listfile.names.size(), true);
+    return listfile;
+  }
+
+  listfile_cache::listfile_cache (boost::filesystem::path const& cache_file)
+  {
+    auto contents (read_file_contents (cache_file));
+    if (!contents)
+    {
+      return;
+    }
+
+    reader input {contents->data.get(), contents->size};
+
+    char const* const file_magic (input.skip (sizeof (magic)));
+    if (!file_magic || !std::equal (magic, magic + sizeof (magic), file_magic))
+    {
+      return;
+    }
+    if (input.read<std::uint32_t>() != format_version)
+    {
+      return;
+    }
+
+    std::vector<entry> archives;
+    std::uint32_t const archive_count (input.read<std::uint32_t>());
+
+    for (std::uint32_t i (0); i < archive_count && !input.failed; ++i)
+    {
+      std::uint32_t const path_length (input.read<std::uint32_t>());
+      char const* const path (input.skip (path_length));
+      std::uint64_t const size (input.read<std::uint64_t>());
+      std::int64_t const modification_time (input.read<std::int64_t>());
+      bool const has_listfile (input.read<std::uint8_t>() != 0);
+
+      if (!input.failed)
+      {
+        std::string archive (path, path_length);
+        auto const stamp (stamp_of (archive));
+        bool const unchanged
+          (stamp && stamp->size == size && stamp->modification_time == modification_time);
+
+        archives.push_back ({std::move (archive), unchanged, has_listfile});
+      }
+    }
+
+    std::uint64_t const index_size (input.read<std::uint64_t>());
+    std::size_t const index_offset (input.position);
+    input.skip (index_size);
+
+    if (input.failed || input.position != contents->size)
+    {
+      return;
+    }
+
+    _data = std::move (contents->data);
+    _archives = std::move (archives);
+    _index_offset = index_offset;
+    _index_size = index_size;
+  }
+
+  bool listfile_cache::has (std::size_t position, boost::filesystem::path const& archive) const
+  {
+    return position < _archives.size()
+      && _archives[position].unchanged
+      && _archives[position].path == archive.string();
+  }
+
+  boost::optional<listfile_cache::cached_index> listfile_cache::find
+    (std::vector<boost::filesystem::path> const& archives) const
+  {
+    if (archives.size() != _archives.size())
+    {
+      return boost::none;
+    }
+
+    std::vector<bool> has_listfile;
+    for (std::size_t i (0); i < archives.size(); ++i)
+    {
+      if (!has (i, archives[i]))
+      {
+        return boost::none;
+      }
+      has_listfile.push_back (_archives[i].has_listfile);
+    }
+
+    auto index (archive_index::deserialized (_data.get() + _index_offset, _index_size, archives.size()));
+    if (!index)
+    {
+      return boost::none;
+    }
+
+    return cached_index {std::move (*index), std::move (has_listfile)};
+  }
+
+  void listfile_cache::write ( boost::filesystem::path const& cache_file
+                             , std::vector<archive> const& archives
+                             , archive_index const& index
+                             )
+  {
+    std::string output (magic, sizeof (magic));
+    write_value (output, format_version);
+    write_value (output, static_cast<std::uint32_t> (archives.size()));
+
+    for (auto const& archive : archives)
+    {
+      auto const stamp (stamp_of (archive.path));
+      std::string const path (archive.path.string());
+
+      write_value (output, static_cast<std::uint32_t> (path.size()));
+      output.append (path);
+      // an archive we can't stamp is written with a stamp nothing matches
+      write_value (output, stamp ? stamp->size : std::numeric_limits<std::uint64_t>::max());
+      write_value (output, stamp ? stamp->modification_time : std::numeric_limits<std::int64_t>::min());
+      write_value (output, static_cast<std::uint8_t> (archive.has_listfile));
+    }
+
+    std::string const serialized (index.serialized());
+    write_value (output, static_cast<std::uint64_t> (serialized.size()));
+    output.append (serialized);
+
+    write_file_atomically (cache_file, output.data(), output.size());
+  }
+}
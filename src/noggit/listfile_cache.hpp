@@ -0,0 +1,86 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/archive_index.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  //! What an archive's (listfile) told us.
+  struct archive_listfile
+  {
+    bool has_listfile = false;
+    //! normalized like mpq::normalized_filename
+    std::vector<std::string> names;
+    //! whether names[i] is really in the archive, see MPQArchive
+    std::vector<bool> present;
+  };
+
+  //! Split a (listfile) into normalized names, all marked as present.
+  archive_listfile parse_listfile (char const* data, std::size_t size);
+
+  //! The merged index of the archives of a previous start, so that a
+  //! start with the same archives neither reads their listfiles nor
+  //! builds the index again. It is keyed by the archives in load order,
+  //! and only used if every one of them still has the size and
+  //! modification time it had when the cache was written. The whole
+  //! cache is ignored if it is of another format version or damaged.
+  class listfile_cache
+  {
+  public:
+    static constexpr std::uint32_t const format_version = 2;
+
+    struct archive
+    {
+      boost::filesystem::path path;
+      bool has_listfile;
+    };
+
+    struct cached_index
+    {
+      archive_index index;
+      //! by load order
+      std::vector<bool> has_listfile;
+    };
+
+    //! an empty cache if cache_file can't be used
+    explicit listfile_cache (boost::filesystem::path const& cache_file);
+
+    //! number of archives the cache is of
+    std::size_t size() const { return _archives.size(); }
+    //! whether archive is the one loaded at position the last time and
+    //! unchanged since, so there's a chance find() will have its index
+    bool has (std::size_t position, boost::filesystem::path const& archive) const;
+    //! the index if the cache is of exactly these archives, unchanged
+    boost::optional<cached_index> find (std::vector<boost::filesystem::path> const& archives) const;
+
+    //! Cache the index of the given archives, in load order. Throws
+    //! std::runtime_error if the cache file can't be written.
+    static void write ( boost::filesystem::path const& cache_file
+                      , std::vector<archive> const& archives
+                      , archive_index const& index
+                      );
+
+  private:
+    struct entry
+    {
+      std::string path;
+      bool unchanged;
+      bool has_listfile;
+    };
+
+    std::shared_ptr<char const> _data;
+    std::vector<entry> _archives;
+    std::size_t _index_offset = 0;
+    std::size_t _index_size = 0;
+  };
+}
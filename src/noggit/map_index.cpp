@@ -12,26 +12,44 @@
 #endif
 #include <noggit/map_index.hpp>
 #include <noggit/uid_storage.hpp>
+#include <util/chunk_writer.hpp>
 
 #include <boost/range/adaptor/map.hpp>
 
+#include <algorithm>
 #include <forward_list>
 
+namespace
+{
+  noggit::tile_streaming::settings streaming_settings (noggit::editor_settings const& editor)
+  {
+    noggit::tile_streaming::settings settings;
+    settings.loading_radius = editor.loading_radius;
+    settings.lookahead = editor.tile_lookahead;
+    settings.memory_budget = std::size_t (std::max (0, editor.tile_memory_budget)) << 20;
+    return settings;
+  }
+}
+
 MapIndex::MapIndex (const std::string &pBasename, int map_id, World* world)
   : basename(pBasename)
   , _map_id (map_id)
-  , _last_unload_time((clock() / CLOCKS_PER_SEC)) // to not try to unload right away
+  , _streaming (*this, streaming_settings (NoggitSettings.editor()))
   , mBigAlpha(false)
   , mHasAGlobalWMO(false)
   , changed(false)
   , _sort_models_by_size_class(false)
   , highestGUID(0)
   , _world (world)
+  , _settings_subscription
+      ( NoggitSettings.on_editor_settings_change
+          ( [this] (noggit::editor_settings const& settings)
+            {
+              _streaming.change_settings (streaming_settings (settings));
+            }
+          )
+      )
 {
-  _unload_interval = NoggitSettings.value("unload_interval", 30).toInt();
-  _unload_dist = NoggitSettings.value("unload_dist", 5).toInt();
-  _loading_radius = NoggitSettings.value("loading_radius", 1).toInt();
-
   std::stringstream filename;
   filename << "World\\Maps\\" << basename << "\\" << basename << ".wdt";
 
@@ -134,16 +152,52 @@ MapIndex::MapIndex (const std::string &pBasename, int map_id, World* world)
   theFile.close();
 }
 
-void MapIndex::saveall (World* world)
+void MapIndex::saveall (World* world, save_progress_callback const& on_progress)
 {
   world->wait_for_all_tile_updates();
 
   saveMaxUID();
 
+  std::vector<MapTile*> tiles;
   for (MapTile* tile : loaded_tiles())
   {
-    tile->saveTile(world);
+    tiles.emplace_back (tile);
+  }
+
+  save_tiles (tiles, world, on_progress);
+}
+
+void MapIndex::save_tiles (std::vector<MapTile*> const& tiles, World* world, save_progress_callback const& on_progress)
+{
+  noggit::file_save_batch batch (noggit::compute_scheduler());
+  std::vector<std::pair<tile_index, std::size_t>> queued;
+
+  for (MapTile* tile : tiles)
+  {
+    // cleared up front so that edits made while the files are being
+    // written mark the tile as changed again
     tile->changed = false;
+    queued.emplace_back (tile->index, tile->queue_save (batch, world));
+  }
+
+  // no progress reports until then: they may run the event loop, which
+  // would let the editor change or unload the tiles being serialized
+  batch.wait_serialized();
+  // from here on the tiles may be edited (or even unloaded) again
+  batch.wait (on_progress);
+
+  for (auto const& tile : queued)
+  {
+    MapTile* const still_loaded (getTile (tile.first));
+    if (still_loaded && !batch.saved (tile.second))
+    {
+      still_loaded->changed = true;
+    }
+  }
+
+  for (auto const& failure : batch.failures())
+  {
+    LogError << "Saving ADT \"" << failure.first << "\" failed: " << failure.second << std::endl;
   }
 }
 
@@ -154,95 +208,66 @@ void MapIndex::save()
 
   //NOGGIT_LOG << "Saving WDT \"" << filename << "\"." << std::endl;
 
-  util::sExtendableArray wdtFile;
-  int curPos = 0;
+  using util::chunk_writer;
 
-  // MVER
-  //  {
-  wdtFile.Extend(8 + 0x4);
-  SetChunkHeader(wdtFile, curPos, 'MVER', 4);
+  std::size_t wdt_size = chunk_writer::chunk_size(0x4)
+                       + chunk_writer::chunk_size(sizeof(MPHD))
+                       + chunk_writer::chunk_size(64 * 64 * 8);
+
+  if (mHasAGlobalWMO)
+  {
+    wdt_size += chunk_writer::chunk_size(globalWMOName.size())
+              + chunk_writer::chunk_size(sizeof(ENTRY_MODF));
+  }
 
-  // MVER data
-  *(wdtFile.GetPointer<int>(8)) = 18;
+  chunk_writer wdtFile(wdt_size);
 
-  curPos += 8 + 0x4;
-  //  }
+  // MVER
+  wdtFile.chunk_header('MVER', 4);
+  wdtFile.value(std::uint32_t(18));
 
   // MPHD
-  //  {
-  wdtFile.Extend(8);
-  SetChunkHeader(wdtFile, curPos, 'MPHD', sizeof(MPHD));
-  curPos += 8;
-
-  wdtFile.Insert(curPos, sizeof(MPHD), (char*)&mphd);
-  curPos += sizeof(MPHD);
-  //  }
+  wdtFile.chunk_header('MPHD', sizeof(MPHD));
+  wdtFile.value(mphd);
 
   // MAIN
-  //  {
-  wdtFile.Extend(8);
-  SetChunkHeader(wdtFile, curPos, 'MAIN', 64 * 64 * 8);
-  curPos += 8;
+  wdtFile.chunk_header('MAIN', 64 * 64 * 8);
 
   for (int j = 0; j < 64; ++j)
   {
     for (int i = 0; i < 64; ++i)
     {
-      wdtFile.Insert(curPos, 4, (char*)&mTiles[j][i].flags);
-      wdtFile.Extend(4);
-      curPos += 8;
+      wdtFile.value(mTiles[j][i].flags);
+      wdtFile.zeros(4);
     }
   }
-  //  }
 
   if (mHasAGlobalWMO)
   {
     // MWMO
-    //  {
-    wdtFile.Extend(8);
-    SetChunkHeader(wdtFile, curPos, 'MWMO', globalWMOName.size());
-    curPos += 8;
-
-    wdtFile.Insert(curPos, globalWMOName.size(), globalWMOName.data());
-    curPos += globalWMOName.size();
-    //  }
+    wdtFile.chunk_header('MWMO', globalWMOName.size());
+    wdtFile.bytes(globalWMOName.data(), globalWMOName.size());
 
     // MODF
-    //  {
-    wdtFile.Extend(8);
-    SetChunkHeader(wdtFile, curPos, 'MODF', sizeof(ENTRY_MODF));
-    curPos += 8;
-
-    wdtFile.Insert(curPos, sizeof(ENTRY_MODF), (char*)&wmoEntry);
-    curPos += sizeof(ENTRY_MODF);
-    //  }
+    wdtFile.chunk_header('MODF', sizeof(ENTRY_MODF));
+    wdtFile.value(wmoEntry);
   }
 
   MPQFile f(filename.str());
-  f.setBuffer(wdtFile.all_data());
+  f.setBuffer(wdtFile.finish());
   f.SaveFile();
   f.close();
 
   changed = false;
 }
 
-void MapIndex::enterTile(const tile_index& tile)
+void MapIndex::update_streaming ( math::vector_3d const& camera
+                                , math::vector_3d const& direction
+                                , float half_fov
+                                , float dt
+                                )
 {
-  if (!hasTile(tile))
-  {
-    return;
-  }
-
-  int cx = tile.x;
-  int cz = tile.z;
-
-  for (int pz = std::max(cz - _loading_radius, 0); pz <= std::min(cz + _loading_radius, 63); ++pz)
-  {
-    for (int px = std::max(cx - _loading_radius, 0); px <= std::min(cx + _loading_radius, 63); ++px)
-    {
-      loadTile(tile_index(px, pz));
-    }
-  }
+  _streaming.update (camera, direction, half_fov, dt);
 }
 
 void MapIndex::update_model_tile(const tile_index& tile, model_update type, uint32_t uid)
@@ -349,32 +374,12 @@ void MapIndex::reloadTile(const tile_index& tile)
   }
 }
 
-void MapIndex::unloadTiles(const tile_index& tile)
-{
-  if (((clock() / CLOCKS_PER_SEC) - _last_unload_time) > _unload_interval)
-  {
-    for (MapTile* adt : loaded_tiles())
-    {
-      if (tile.dist(adt->index) > _unload_dist)
-      {
-        //Only unload adts not marked to save
-        if (!adt->changed.load())
-        {
-          unloadTile(adt->index);
-        }
-      }
-    }
-
-    _last_unload_time = clock() / CLOCKS_PER_SEC;
-  }
-}
-
 void MapIndex::unloadTile(const tile_index& tile)
 {
   if (tileLoaded(tile))
   {
     // either log before or don't use a reference for the tile/make a copy
-    // otherwise it can be deleted before the log because it comes from the adt itself (see unloadTiles)
+    // otherwise it can be deleted before the log because it comes from the adt itself
     NOGGIT_LOG << "Unloading Tile " << tile.x << "-" << tile.z << std::endl;
     mTiles[tile.z][tile.x].tile.reset();
   }
@@ -406,7 +411,7 @@ void MapIndex::saveTile(const tile_index& tile, World* world)
 	}
 }
 
-void MapIndex::saveChanged (World* world)
+void MapIndex::saveChanged (World* world, save_progress_callback const& on_progress)
 {
   world->wait_for_all_tile_updates();
 
@@ -417,14 +422,16 @@ void MapIndex::saveChanged (World* world)
 
   saveMaxUID();
 
+  std::vector<MapTile*> tiles;
   for (MapTile* tile : loaded_tiles())
   {
     if (tile->changed.load())
     {
-      tile->saveTile(world);
-      tile->changed = false;
+      tiles.emplace_back (tile);
     }
   }
+
+  save_tiles (tiles, world, on_progress);
 }
 
 bool MapIndex::hasAGlobalWMO()
@@ -448,6 +455,55 @@ bool MapIndex::tileLoaded(const tile_index& tile) const
   return hasTile(tile) && mTiles[tile.z][tile.x].tile && mTiles[tile.z][tile.x].tile->finishedLoading();
 }
 
+bool MapIndex::has_tile (tile_index const& tile) const
+{
+  return hasTile (tile);
+}
+
+bool MapIndex::tile_loaded (tile_index const& tile) const
+{
+  return tileLoaded (tile);
+}
+
+bool MapIndex::load_tile (tile_index const& tile)
+{
+  return !!loadTile (tile);
+}
+
+bool MapIndex::cancel_tile_load (tile_index const& tile)
+{
+  if (!tileAwaitingLoading (tile))
+  {
+    return true;
+  }
+
+  MapTile* adt (mTiles[tile.z][tile.x].tile.get());
+  if (!AsyncLoader::instance->cancel (adt))
+  {
+    return false;
+  }
+
+  AsyncLoader::instance->ensure_deletable (adt);
+  mTiles[tile.z][tile.x].tile.reset();
+
+  return true;
+}
+
+void MapIndex::unload_tile (tile_index const& tile)
+{
+  unloadTile (tile);
+}
+
+bool MapIndex::can_unload_tile (tile_index const& tile) const
+{
+  return !has_unsaved_changes (tile);
+}
+
+std::size_t MapIndex::tile_memory_usage (tile_index const& tile) const
+{
+  return tileLoaded (tile) ? getTile (tile)->estimated_memory_usage() : 0;
+}
+
 MapTile* MapIndex::getTile(const tile_index& tile) const
 {
   return (tile.is_valid() ? mTiles[tile.z][tile.x].tile.get() : nullptr);
@@ -571,7 +627,7 @@ uint32_t MapIndex::newGUID()
   std::unique_lock<std::mutex> lock (_mutex);
 
 #ifdef USE_MYSQL_UID_STORAGE
-  if (NoggitSettings.value ("project/mysql/enabled", false).toBool())
+  if (NoggitSettings.editor().mysql_enabled)
   {
     mysql::updateUIDinDB(_map_id, highestGUID + 1); // update the highest uid in db, note that if the user don't save these uid won't be used (not really a problem tho)
   }
@@ -917,7 +973,7 @@ void MapIndex::searchMaxUID()
 void MapIndex::saveMaxUID()
 {
 #ifdef USE_MYSQL_UID_STORAGE
-  if (NoggitSettings.value ("project/mysql/enabled", false).toBool())
+  if (NoggitSettings.editor().mysql_enabled)
   {
     if (mysql::hasMaxUIDStoredDB(_map_id))
     {
@@ -937,7 +993,7 @@ void MapIndex::loadMaxUID()
 {
   highestGUID = uid_storage::getMaxUID (_map_id);
 #ifdef USE_MYSQL_UID_STORAGE
-  if (NoggitSettings.value ("project/mysql/enabled", false).toBool())
+  if (NoggitSettings.editor().mysql_enabled)
   {
     highestGUID = std::max(mysql::getGUIDFromDB(map_id), highestGUID);
     // save to make sure the db and disk uid are synced
@@ -6,7 +6,10 @@
 #include <noggit/MapHeaders.h>
 #include <noggit/MapTile.h>
 #include <noggit/Misc.h>
+#include <noggit/editor_settings.hpp>
+#include <noggit/published.hpp>
 #include <noggit/tile_index.hpp>
+#include <noggit/tile_streaming.hpp>
 
 #include <boost/range/iterator_range.hpp>
 
@@ -14,6 +17,7 @@
 #include <cstdint>
 #include <ctime>
 #include <fstream>
+#include <functional>
 #include <mutex>
 #include <sstream>
 #include <string>
@@ -42,7 +46,7 @@ class MapTileEntry
   friend class MapIndex;
 };
 
-class MapIndex
+class MapIndex : private noggit::tile_store
 {
 public:
   template<bool Load>
@@ -141,7 +145,13 @@ class MapIndex
 
   MapIndex(const std::string& pBasename, int map_id, World*);
 
-  void enterTile(const tile_index& tile);
+  //! Loads and unloads tiles as the camera moves, once per frame. \a
+  //! half_fov is half of the camera's horizontal field of view.
+  void update_streaming ( math::vector_3d const& camera
+                        , math::vector_3d const& direction
+                        , float half_fov
+                        , float dt
+                        );
   MapTile *loadTile(const tile_index& tile, bool reloading = false);
 
   void update_model_tile(const tile_index& tile, model_update type, uint32_t uid);
@@ -153,10 +163,14 @@ class MapIndex
   void setFlag(bool to, math::vector_3d const& pos, uint32_t flag);
   bool has_unsaved_changes(const tile_index& tile) const;
 
+  //! Called on the saving thread while the tiles' files are written,
+  //! only once every tile is serialized, so it may run the event loop.
+  //! Returning false cancels the tiles not written yet, they stay changed.
+  using save_progress_callback = std::function<bool (noggit::file_save_batch::progress const&)>;
+
   void saveTile(const tile_index& tile, World*);
-  void saveChanged (World*);
+  void saveChanged (World*, save_progress_callback const& on_progress = nullptr);
   void reloadTile(const tile_index& tile);
-  void unloadTiles(const tile_index& tile);  // unloads all tiles more then x adts away from given
   void unloadTile(const tile_index& tile);  // unload given tile
   void markOnDisc(const tile_index& tile, bool mto);
   bool isTileExternal(const tile_index& tile) const;
@@ -167,7 +181,7 @@ class MapIndex
   bool tileLoaded(const tile_index& tile) const;
 
   void save();
-  void saveall (World*);
+  void saveall (World*, save_progress_callback const& on_progress = nullptr);
 
   MapTile* getTile(const tile_index& tile) const;
   MapTile* getTileAbove(MapTile* tile) const;
@@ -198,7 +212,17 @@ class MapIndex
   }
 
 private:
+  bool has_tile (tile_index const&) const override;
+  bool tile_loaded (tile_index const&) const override;
+  bool load_tile (tile_index const&) override;
+  //! drops tiles still queued for loading, which nobody used yet
+  bool cancel_tile_load (tile_index const&) override;
+  void unload_tile (tile_index const&) override;
+  bool can_unload_tile (tile_index const&) const override;
+  std::size_t tile_memory_usage (tile_index const&) const override;
+
 	uint32_t getHighestGUIDFromFile(const std::string& pFilename) const;
+  void save_tiles (std::vector<MapTile*> const& tiles, World*, save_progress_callback const& on_progress);
 
   bool _uid_fix_all_in_progress = false;
 
@@ -210,10 +234,7 @@ class MapIndex
 private:
   std::string globalWMOName;
 
-  int _last_unload_time;
-  int _unload_interval;
-  int _unload_dist;
-  int _loading_radius;
+  noggit::tile_streaming _streaming;
 
   // Is the WDT telling us to use a different alphamap structure.
   bool mBigAlpha;
@@ -235,4 +256,6 @@ class MapIndex
   World* _world;
 
   std::mutex _mutex;
+
+  noggit::published<noggit::editor_settings>::subscription _settings_subscription;
 };
@@ -0,0 +1,244 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/mapped_file.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct file_mapping;
+
+    //! Every live mapping by the file it maps. Windows refuses to replace
+    //! a mapped file but lets it be renamed, so write_file_atomically
+    //! moves it out of the way of the new one first.
+    struct mapping_registry
+    {
+      std::mutex guard;
+      std::multimap<std::string, file_mapping*> mappings;
+    };
+
+    mapping_registry& registry()
+    {
+      // never destroyed: mappings held by other statics may outlive it
+      static mapping_registry* const instance (new mapping_registry);
+      return *instance;
+    }
+
+    std::string registry_key (boost::filesystem::path const& path)
+    {
+      boost::system::error_code ec;
+      auto const canonical (boost::filesystem::canonical (path, ec));
+      return ec ? path.string() : canonical.string();
+    }
+
+    struct file_mapping
+    {
+      file_mapping (boost::filesystem::path const& path)
+        : file (path.string().c_str(), boost::interprocess::read_only)
+        , region (file, boost::interprocess::read_only)
+        , location (path)
+      {
+        std::lock_guard<std::mutex> const lock (registry().guard);
+        registered = registry().mappings.emplace (registry_key (path), this);
+        is_registered = true;
+      }
+
+      ~file_mapping()
+      {
+        std::lock_guard<std::mutex> const lock (registry().guard);
+
+        if (is_registered)
+        {
+          registry().mappings.erase (registered);
+        }
+
+        // unmapped first, or the file moved aside can't be removed
+        region = boost::interprocess::mapped_region();
+        file = boost::interprocess::file_mapping();
+
+        if (remove_when_released)
+        {
+          // fails while another mapping of it is around, which will
+          // then try again
+          boost::system::error_code ignored;
+          boost::filesystem::remove (location, ignored);
+        }
+      }
+
+      boost::interprocess::file_mapping file;
+      boost::interprocess::mapped_region region;
+
+      // guarded by the registry
+      boost::filesystem::path location;
+      std::multimap<std::string, file_mapping*>::iterator registered;
+      bool is_registered = false;
+      bool remove_when_released = false;
+    };
+
+    //! Rename temporary over path. Anything mapping path keeps the old
+    //! file, moved aside and removed once nothing maps it any longer.
+    void replace_file (boost::filesystem::path const& temporary, boost::filesystem::path const& path)
+    {
+      std::lock_guard<std::mutex> const lock (registry().guard);
+      auto const mapped (registry().mappings.equal_range (registry_key (path)));
+
+      boost::system::error_code ec;
+      boost::filesystem::path aside;
+
+      if (mapped.first != mapped.second)
+      {
+        aside = path;
+        aside += "." + boost::filesystem::unique_path().string() + ".replaced";
+
+        boost::filesystem::rename (path, aside, ec);
+        if (ec)
+        {
+          throw std::runtime_error ("could not move " + path.string() + " out of the way: " + ec.message());
+        }
+      }
+
+      boost::filesystem::rename (temporary, path, ec);
+      if (ec)
+      {
+        if (!aside.empty())
+        {
+          boost::system::error_code ignored;
+          boost::filesystem::rename (aside, path, ignored);
+        }
+        throw std::runtime_error ("could not replace " + path.string() + ": " + ec.message());
+      }
+
+      if (aside.empty())
+      {
+        return;
+      }
+
+      // only works right away where mapped files can be removed
+      boost::filesystem::remove (aside, ec);
+
+      for (auto it (mapped.first); it != mapped.second; ++it)
+      {
+        it->second->location = aside;
+        it->second->is_registered = false;
+        it->second->remove_when_released = !!ec;
+      }
+      registry().mappings.erase (mapped.first, mapped.second);
+    }
+
+    boost::optional<file_contents> copy_file_contents
+      (boost::filesystem::path const& path, std::size_t size)
+    {
+      std::ifstream input (path.string(), std::ios_base::binary | std::ios_base::in);
+      if (!input.is_open())
+      {
+        return boost::none;
+      }
+
+      auto buffer (std::make_shared<std::vector<char>> (size));
+      input.read (buffer->data(), buffer->size());
+      if (static_cast<std::size_t> (input.gcount()) != size)
+      {
+        return boost::none;
+      }
+
+      file_contents contents;
+      contents.data = std::shared_ptr<char const> (buffer, buffer->data());
+      contents.size = size;
+      return contents;
+    }
+  }
+
+  boost::optional<file_contents> read_file_contents
+    (boost::filesystem::path const& path)
+  {
+    boost::system::error_code ec;
+    if (!boost::filesystem::is_regular_file (path, ec))
+    {
+      return boost::none;
+    }
+
+    std::size_t const size (boost::filesystem::file_size (path, ec));
+    if (ec)
+    {
+      return boost::none;
+    }
+
+    if (size < minimum_mapped_file_size)
+    {
+      return copy_file_contents (path, size);
+    }
+
+    try
+    {
+      auto mapping (std::make_shared<file_mapping const> (path));
+
+      file_contents contents;
+      contents.data = std::shared_ptr<char const>
+        (mapping, static_cast<char const*> (mapping->region.get_address()));
+      contents.size = mapping->region.get_size();
+      contents.mapped = true;
+      return contents;
+    }
+    catch (boost::interprocess::interprocess_exception const&)
+    {
+      // e.g. out of address space on 32 bit: reading still works
+      return copy_file_contents (path, size);
+    }
+  }
+
+  void write_file_atomically (boost::filesystem::path const& path, char const* data, std::size_t size)
+  {
+    boost::system::error_code ec;
+
+    if (path.has_parent_path())
+    {
+      boost::filesystem::create_directories (path.parent_path(), ec);
+      if (ec)
+      {
+        throw std::runtime_error ("could not create " + path.parent_path().string() + ": " + ec.message());
+      }
+    }
+
+    boost::filesystem::path temporary (path);
+    temporary += ".tmp";
+
+    {
+      std::ofstream output (temporary.string(), std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+      if (!output.is_open())
+      {
+        throw std::runtime_error ("could not open " + temporary.string() + " for writing");
+      }
+
+      output.write (data, size);
+      output.close();
+
+      if (!output)
+      {
+        boost::filesystem::remove (temporary, ec);
+        throw std::runtime_error ("could not write " + temporary.string());
+      }
+    }
+
+    try
+    {
+      replace_file (temporary, path);
+    }
+    catch (std::runtime_error const&)
+    {
+      boost::system::error_code ignored;
+      boost::filesystem::remove (temporary, ignored);
+      throw;
+    }
+  }
+}
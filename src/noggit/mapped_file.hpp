@@ -0,0 +1,41 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <memory>
+
+namespace noggit
+{
+  //! Read-only contents of a file on disk. The bytes stay valid for as
+  //! long as any copy of data is alive, so parsers can keep pointers
+  //! into them instead of copying.
+  struct file_contents
+  {
+    std::shared_ptr<char const> data;
+    std::size_t size = 0;
+    //! true if data is a mapping of the file rather than a copy
+    bool mapped = false;
+  };
+
+  //! Files smaller than this are copied, everything else gets mapped.
+  //! For small files the mapping costs more than it saves.
+  constexpr std::size_t const minimum_mapped_file_size = 16 * 1024;
+
+  //! boost::none if path is not a regular file or can't be read.
+  boost::optional<file_contents> read_file_contents
+    (boost::filesystem::path const& path);
+
+  //! Write to a temporary file next to path and rename it over path once
+  //! complete, so that readers (and a crash) only ever see either the old
+  //! or the new contents. Truncating path in place would pull the pages
+  //! from under the mappings of read_file_contents. Those keep the old
+  //! file, which is moved aside first if it is mapped, as Windows won't
+  //! replace it otherwise, and removed once nothing maps it. Creates
+  //! missing parent directories. Throws std::runtime_error on failure, in
+  //! which case path is left untouched.
+  void write_file_atomically (boost::filesystem::path const& path, char const* data, std::size_t size);
+}
@@ -0,0 +1,254 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/mcal_compression.hpp>
+#include <util/sse.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined (_MSC_VER) && defined (_M_X64)
+  #include <intrin.h>
+#endif
+
+namespace noggit
+{
+  namespace mcal
+  {
+    namespace
+    {
+      // an entry is a byte with the mode in the top bit and the count in
+      // the others, followed by the value to fill with or the values to copy
+      constexpr std::uint8_t fill_mode = 0x80;
+      constexpr std::uint8_t max_count = 0x7f;
+
+      int trailing_zeros (std::uint64_t bits)
+      {
+#if defined (__GNUC__)
+        return __builtin_ctzll (bits);
+#elif defined (_MSC_VER) && defined (_M_X64)
+        unsigned long index;
+        _BitScanForward64 (&index, bits);
+        return static_cast<int> (index);
+#else
+        int index (0);
+        for (; !(bits & 1); bits >>= 1)
+        {
+          ++index;
+        }
+        return index;
+#endif
+      }
+
+      // bit i is set when row[i] == row[i + 1], never for the last alpha
+      std::uint64_t equal_to_next_scalar (std::uint8_t const* row)
+      {
+        std::uint64_t bits (0);
+        for (int i (0); i < 63; ++i)
+        {
+          bits |= std::uint64_t (row[i] == row[i + 1]) << i;
+        }
+        return bits;
+      }
+
+#ifdef NOGGIT_SSE
+      std::uint64_t equal_to_next (std::uint8_t const* row)
+      {
+        auto const load
+          ([&] (int i) { return _mm_loadu_si128 (reinterpret_cast<__m128i const*> (row + i)); });
+        auto const mask
+          ([] (__m128i a, __m128i b) { return std::uint64_t (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b))); });
+
+        __m128i const last (load (48));
+
+        // the last row may be the end of the alphamap, so its last 16
+        // alphas are shifted instead of read one further
+        return ( mask (load (0), load (1))
+               | mask (load (16), load (17)) << 16
+               | mask (load (32), load (33)) << 32
+               | mask (last, _mm_srli_si128 (last, 1)) << 48
+               ) & ~(std::uint64_t (1) << 63);
+      }
+#endif
+
+      class encoder
+      {
+      public:
+        encoder (std::uint8_t* output)
+          : _begin (output)
+          , _output (output)
+        {}
+
+        void fill (std::uint8_t value, int count)
+        {
+          *_output++ = fill_mode | static_cast<std::uint8_t> (count);
+          *_output++ = value;
+          _copy_entry = nullptr;
+        }
+
+        // copies continue the last entry as long as there was no fill
+        // in between, across rows
+        void copy (std::uint8_t const* values, int count)
+        {
+          while (count)
+          {
+            if (!_copy_entry || *_copy_entry == max_count)
+            {
+              _copy_entry = _output++;
+              *_copy_entry = 0;
+            }
+
+            int const n (std::min (count, max_count - *_copy_entry));
+            std::memcpy (_output, values, n);
+            _output += n;
+            *_copy_entry += static_cast<std::uint8_t> (n);
+            values += n;
+            count -= n;
+          }
+        }
+
+        void row (std::uint8_t const* row, std::uint64_t equal_to_next)
+        {
+          for (int column (0); column < 64;)
+          {
+            std::uint64_t const rest (equal_to_next >> column);
+
+            if (rest & 1)
+            {
+              int const count (trailing_zeros (~rest) + 1);
+              fill (row[column], count);
+              column += count;
+            }
+            else
+            {
+              int const end (rest ? column + trailing_zeros (rest) : 64);
+              copy (row + column, end - column);
+              column = end;
+            }
+          }
+        }
+
+        std::size_t size() const
+        {
+          return static_cast<std::size_t> (_output - _begin);
+        }
+
+      private:
+        std::uint8_t* _begin;
+        std::uint8_t* _output;
+        std::uint8_t* _copy_entry = nullptr;
+      };
+    }
+
+    std::size_t compress_scalar (std::uint8_t const* alphas, std::uint8_t* output)
+    {
+      encoder e (output);
+      for (std::size_t row (0); row < 64; ++row)
+      {
+        e.row (alphas + row * 64, equal_to_next_scalar (alphas + row * 64));
+      }
+      return e.size();
+    }
+
+    std::size_t compress (std::uint8_t const* alphas, std::uint8_t* output)
+    {
+#ifdef NOGGIT_SSE
+      encoder e (output);
+      for (std::size_t row (0); row < 64; ++row)
+      {
+        e.row (alphas + row * 64, equal_to_next (alphas + row * 64));
+      }
+      return e.size();
+#else
+      return compress_scalar (alphas, output);
+#endif
+    }
+
+    decompression_result decompress ( std::uint8_t const* input
+                                    , std::size_t input_size
+                                    , std::uint8_t* alphas
+                                    )
+    {
+      std::size_t read (0);
+      std::size_t written (0);
+      bool valid (true);
+
+      while (written < alphamap_size)
+      {
+        if (read == input_size)
+        {
+          return {read, false};
+        }
+
+        std::uint8_t const entry (input[read++]);
+        std::size_t count (entry & max_count);
+
+        if (written + count > alphamap_size)
+        {
+          valid = false;
+          count = alphamap_size - written;
+        }
+
+        // an empty entry has no value, even to fill with
+        if (!count)
+        {
+          continue;
+        }
+
+        if (entry & fill_mode)
+        {
+          if (read == input_size)
+          {
+            return {read, false};
+          }
+
+          std::uint8_t const value (input[read++]);
+#ifdef NOGGIT_SSE
+          // whole vectors as long as they fit, the bytes written past
+          // the entry are overwritten by the next ones
+          if (written + 128 <= alphamap_size)
+          {
+            __m128i const values (_mm_set1_epi8 (static_cast<char> (value)));
+            for (std::size_t i (0); i < count; i += 16)
+            {
+              _mm_storeu_si128 (reinterpret_cast<__m128i*> (alphas + written + i), values);
+            }
+          }
+          else
+#endif
+          {
+            std::memset (alphas + written, value, count);
+          }
+        }
+        else
+        {
+          if (input_size - read < count)
+          {
+            std::memcpy (alphas + written, input + read, input_size - read);
+            return {input_size, false};
+          }
+
+#ifdef NOGGIT_SSE
+          if (written + 128 <= alphamap_size && input_size - read >= 128)
+          {
+            for (std::size_t i (0); i < count; i += 16)
+            {
+              _mm_storeu_si128 ( reinterpret_cast<__m128i*> (alphas + written + i)
+                               , _mm_loadu_si128 (reinterpret_cast<__m128i const*> (input + read + i))
+                               );
+            }
+          }
+          else
+#endif
+          {
+            std::memcpy (alphas + written, input + read, count);
+          }
+          read += count;
+        }
+
+        written += count;
+      }
+
+      return {read, valid};
+    }
+  }
+}
@@ -0,0 +1,42 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace noggit
+{
+  namespace mcal
+  {
+    //! bytes of an uncompressed 64x64 alphamap
+    constexpr std::size_t alphamap_size = 64 * 64;
+    //! the most a compressed alphamap can take: every entry covers at
+    //! least one alpha with one header byte more than it has alphas
+    constexpr std::size_t max_compressed_size = 2 * alphamap_size;
+
+    //! Run length encodes the 64x64 \a alphas into \a output, which has
+    //! room for max_compressed_size bytes, and returns the bytes written.
+    //! Fills never span two rows, copies are cut every 127 alphas.
+    std::size_t compress (std::uint8_t const* alphas, std::uint8_t* output);
+    //! without sse, for comparison
+    std::size_t compress_scalar (std::uint8_t const* alphas, std::uint8_t* output);
+
+    struct decompression_result
+    {
+      //! bytes of the input the alphamap was read from
+      std::size_t bytes_read;
+      //! false if the entries went past 4096 alphas, they are cut off
+      //! there, or if the input ended before all alphas were read, the
+      //! rest of them is undefined then
+      bool valid;
+    };
+
+    //! Reads the alphamap compressed into the \a input_size bytes at
+    //! \a input into the 4096 \a alphas.
+    decompression_result decompress ( std::uint8_t const* input
+                                    , std::size_t input_size
+                                    , std::uint8_t* alphas
+                                    );
+  }
+}
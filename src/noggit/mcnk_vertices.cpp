@@ -0,0 +1,73 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/mcnk_vertices.hpp>
+#include <noggit/MapHeaders.h>
+
+namespace noggit
+{
+  namespace mcnk_vertices
+  {
+    std::array<math::vector_3d, vertex_count> const& offsets()
+    {
+      static auto const table
+        ( []
+          {
+            std::array<math::vector_3d, vertex_count> offsets;
+            std::size_t index (0);
+
+            for (int j (0); j < 17; ++j)
+            {
+              for (int i (0); i < ((j % 2) ? 8 : 9); ++i)
+              {
+                float xpos (i * UNITSIZE);
+                float const zpos (j * 0.5f * UNITSIZE);
+                if (j % 2)
+                {
+                  xpos += UNITSIZE * 0.5f;
+                }
+                offsets[index++] = {xpos, 0.f, zpos};
+              }
+            }
+
+            return offsets;
+          }()
+        );
+
+      return table;
+    }
+
+    std::array<float, 256> const& normal_components()
+    {
+      static auto const table
+        ( []
+          {
+            std::array<float, 256> components;
+            for (int i (0); i < 256; ++i)
+            {
+              components[i] = static_cast<char> (i) / 127.0f;
+            }
+            return components;
+          }()
+        );
+
+      return table;
+    }
+
+    std::array<float, 256> const& color_components()
+    {
+      static auto const table
+        ( []
+          {
+            std::array<float, 256> components;
+            for (int i (0); i < 256; ++i)
+            {
+              components[i] = static_cast<float> (i) / 127.0f;
+            }
+            return components;
+          }()
+        );
+
+      return table;
+    }
+  }
+}
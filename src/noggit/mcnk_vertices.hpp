@@ -0,0 +1,103 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace noggit
+{
+  //! Decoding the MCVT, MCNR and MCCV of a chunk straight from the
+  //! file's buffer, rather than one read() per value. The vertices are
+  //! anything with a position, normal and color, 9x9 outer and 8x8 inner
+  //! ones, row after row. Gives bit for bit what MapChunk computed from
+  //! the single reads.
+  namespace mcnk_vertices
+  {
+    constexpr std::size_t vertex_count = 9 * 9 + 8 * 8;
+
+    constexpr std::size_t mcvt_size = vertex_count * sizeof (float);
+    //! without the 13 bytes of padding some files have after it
+    constexpr std::size_t mcnr_size = vertex_count * 3;
+    constexpr std::size_t mccv_size = vertex_count * 4;
+
+    //! x and z of each vertex relative to the chunk's corner
+    std::array<math::vector_3d, vertex_count> const& offsets();
+    //! a normal component as a float, by its byte taken as char like
+    //! the editor always did
+    std::array<float, 256> const& normal_components();
+    //! a vertex color component as a float, by its byte
+    std::array<float, 256> const& color_components();
+
+    struct height_range
+    {
+      float min;
+      float max;
+    };
+
+    //! \a mcvt are the mcvt_size bytes after the chunk's header, \a
+    //! origin the position of its corner with the base height.
+    template<typename Vertex>
+      height_range read_heights ( char const* mcvt
+                                , math::vector_3d const& origin
+                                , Vertex* vertices
+                                )
+    {
+      std::array<float, vertex_count> heights;
+      std::memcpy (heights.data(), mcvt, mcvt_size);
+
+      auto const& offset (offsets());
+      height_range range {9999999.0f, -9999999.0f};
+
+      for (std::size_t i (0); i < vertex_count; ++i)
+      {
+        math::vector_3d& position (vertices[i].position);
+        position.x = origin.x + offset[i].x;
+        position.y = origin.y + heights[i];
+        position.z = origin.z + offset[i].z;
+
+        range.min = std::min (range.min, position.y);
+        range.max = std::max (range.max, position.y);
+      }
+
+      return range;
+    }
+
+    //! x, z, y
+    template<typename Vertex>
+      void read_normals (char const* mcnr, Vertex* vertices)
+    {
+      auto const& component (normal_components());
+      auto const* bytes (reinterpret_cast<std::uint8_t const*> (mcnr));
+
+      for (std::size_t i (0); i < vertex_count; ++i, bytes += 3)
+      {
+        math::vector_3d& normal (vertices[i].normal);
+        normal.x = component[bytes[0]];
+        normal.y = component[bytes[2]];
+        normal.z = component[bytes[1]];
+      }
+    }
+
+    //! b, g, r, a, alpha is unused
+    template<typename Vertex>
+      void read_colors (char const* mccv, Vertex* vertices)
+    {
+      auto const& component (color_components());
+      auto const* bytes (reinterpret_cast<std::uint8_t const*> (mccv));
+
+      for (std::size_t i (0); i < vertex_count; ++i, bytes += 4)
+      {
+        math::vector_3d& color (vertices[i].color);
+        color.x = component[bytes[2]];
+        color.y = component[bytes[1]];
+        color.z = component[bytes[0]];
+      }
+    }
+  }
+}
@@ -0,0 +1,218 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/model_skinning.hpp>
+#include <util/sse.hpp>
+
+#include <algorithm>
+
+namespace noggit
+{
+  skinning_kernel default_skinning_kernel()
+  {
+    return skinning_kernel_available (skinning_kernel::sse) ? skinning_kernel::sse : skinning_kernel::scalar;
+  }
+
+  bool skinning_kernel_available (skinning_kernel kernel)
+  {
+    switch (kernel)
+    {
+    case skinning_kernel::scalar:
+      return true;
+    case skinning_kernel::sse:
+#ifdef NOGGIT_SSE
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    return false;
+  }
+
+  model_skinning::model_skinning (std::vector<ModelVertex> const& bind_pose)
+    : _size (bind_pose.size())
+  {
+    std::size_t const padded_size ((_size + 3) / 4 * 4);
+
+    for (std::size_t axis (0); axis < 3; ++axis)
+    {
+      _position[axis].resize (padded_size, 0.f);
+      _normal[axis].resize (padded_size, 0.f);
+    }
+    for (std::size_t b (0); b < influences; ++b)
+    {
+      _weight[b].resize (padded_size, 0.f);
+      _bone[b].resize (padded_size, 0);
+    }
+
+    for (std::size_t i (0); i < _size; ++i)
+    {
+      ModelVertex const& vertex (bind_pose[i]);
+
+      for (std::size_t axis (0); axis < 3; ++axis)
+      {
+        _position[axis][i] = vertex.position[axis];
+        _normal[axis][i] = vertex.normal[axis];
+      }
+      for (std::size_t b (0); b < influences; ++b)
+      {
+        _weight[b][i] = static_cast<float> (vertex.weights[b]) / 255.0f;
+        _bone[b][i] = vertex.bones[b];
+      }
+    }
+  }
+
+  void model_skinning::skin ( std::vector<math::matrix_4x4> const& position_matrices
+                            , std::vector<math::matrix_4x4> const& normal_matrices
+                            , ModelVertex* output
+                            , skinning_kernel kernel
+                            )
+  {
+    if (kernel == skinning_kernel::sse && skinning_kernel_available (kernel))
+    {
+      skin_sse (position_matrices, normal_matrices, output);
+    }
+    else
+    {
+      skin_scalar (position_matrices, normal_matrices, output);
+    }
+  }
+
+  void model_skinning::skin_scalar ( std::vector<math::matrix_4x4> const& position_matrices
+                                   , std::vector<math::matrix_4x4> const& normal_matrices
+                                   , ModelVertex* output
+                                   ) const
+  {
+    for (std::size_t i (0); i < _size; ++i)
+    {
+      math::vector_3d const position (_position[0][i], _position[1][i], _position[2][i]);
+      math::vector_3d const normal (_normal[0][i], _normal[1][i], _normal[2][i]);
+      math::vector_3d v (0, 0, 0), n (0, 0, 0);
+
+      for (std::size_t b (0); b < influences; ++b)
+      {
+        float const weight (_weight[b][i]);
+
+        if (weight <= 0)
+        {
+          continue;
+        }
+
+        v += (position_matrices[_bone[b][i]] * position) * weight;
+        n += (normal_matrices[_bone[b][i]] * normal) * weight;
+      }
+
+      output[i].position = v;
+      output[i].normal = n.normalized();
+    }
+  }
+
+  void model_skinning::skin_sse ( std::vector<math::matrix_4x4> const& position_matrices
+                                , std::vector<math::matrix_4x4> const& normal_matrices
+                                , ModelVertex* output
+                                )
+  {
+#ifdef NOGGIT_SSE
+    // blending the bones' matrices first and transforming once gives
+    // the same as blending the transformed vertices, the transformation
+    // being affine
+    std::size_t const bone_count (std::min (position_matrices.size(), normal_matrices.size()));
+    _bone_rows.resize (bone_count * 24);
+
+    for (std::size_t bone (0); bone < bone_count; ++bone)
+    {
+      float* rows (&_bone_rows[bone * 24]);
+      for (std::size_t row (0); row < 3; ++row)
+      {
+        for (std::size_t column (0); column < 4; ++column)
+        {
+          rows[row * 4 + column] = position_matrices[bone] (row, column);
+          rows[12 + row * 4 + column] = normal_matrices[bone] (row, column);
+        }
+      }
+    }
+
+    for (std::size_t first (0); first < _size; first += 4)
+    {
+      // [row][vertex], then [row][column] after transposing
+      __m128 matrices[6][4];
+
+      for (std::size_t lane (0); lane < 4; ++lane)
+      {
+        std::size_t const i (first + lane);
+
+        for (std::size_t row (0); row < 6; ++row)
+        {
+          matrices[row][lane] = _mm_setzero_ps();
+        }
+
+        for (std::size_t b (0); b < influences; ++b)
+        {
+          if (_weight[b][i] <= 0.f)
+          {
+            continue;
+          }
+
+          __m128 const weight (_mm_set1_ps (_weight[b][i]));
+          float const* rows (&_bone_rows[_bone[b][i] * 24]);
+
+          for (std::size_t row (0); row < 6; ++row)
+          {
+            matrices[row][lane] = _mm_add_ps (matrices[row][lane], _mm_mul_ps (_mm_loadu_ps (rows + row * 4), weight));
+          }
+        }
+      }
+
+      for (std::size_t row (0); row < 6; ++row)
+      {
+        _MM_TRANSPOSE4_PS (matrices[row][0], matrices[row][1], matrices[row][2], matrices[row][3]);
+      }
+
+      auto const transform
+        ( [&] (std::size_t first_row, std::vector<float> const (&input)[3], __m128 (&result)[3])
+          {
+            __m128 const x (_mm_loadu_ps (&input[0][first]));
+            __m128 const y (_mm_loadu_ps (&input[1][first]));
+            __m128 const z (_mm_loadu_ps (&input[2][first]));
+
+            for (std::size_t axis (0); axis < 3; ++axis)
+            {
+              __m128 const (&m)[4] (matrices[first_row + axis]);
+              result[axis] = _mm_add_ps ( _mm_add_ps (_mm_mul_ps (m[0], x), _mm_mul_ps (m[1], y))
+                                        , _mm_add_ps (_mm_mul_ps (m[2], z), m[3])
+                                        );
+            }
+          }
+        );
+
+      __m128 position[3];
+      __m128 normal[3];
+      transform (0, _position, position);
+      transform (3, _normal, normal);
+
+      __m128 const length
+        ( _mm_sqrt_ps ( _mm_add_ps ( _mm_add_ps (_mm_mul_ps (normal[0], normal[0]), _mm_mul_ps (normal[1], normal[1]))
+                                   , _mm_mul_ps (normal[2], normal[2])
+                                   )
+                      )
+        );
+      __m128 const inverse_length (_mm_div_ps (_mm_set1_ps (1.0f), length));
+
+      alignas (16) float result[6][4];
+      for (std::size_t axis (0); axis < 3; ++axis)
+      {
+        _mm_store_ps (result[axis], position[axis]);
+        _mm_store_ps (result[3 + axis], _mm_mul_ps (normal[axis], inverse_length));
+      }
+
+      for (std::size_t lane (0); lane < std::min<std::size_t> (4, _size - first); ++lane)
+      {
+        output[first + lane].position = {result[0][lane], result[1][lane], result[2][lane]};
+        output[first + lane].normal = {result[3][lane], result[4][lane], result[5][lane]};
+      }
+    }
+#else
+    skin_scalar (position_matrices, normal_matrices, output);
+#endif
+  }
+}
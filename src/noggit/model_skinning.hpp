@@ -0,0 +1,71 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/matrix_4x4.hpp>
+#include <math/vector_3d.hpp>
+#include <noggit/ModelHeaders.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace noggit
+{
+  enum class skinning_kernel
+  {
+    //! one vertex and bone at a time, like models always were animated
+    scalar,
+    //! four vertices at once
+    sse,
+  };
+
+  //! the fastest kernel this build can run
+  skinning_kernel default_skinning_kernel();
+  bool skinning_kernel_available (skinning_kernel);
+
+  //! The bind pose of a model with animated geometry, split into one
+  //! array per component so several vertices can be skinned at once.
+  class model_skinning
+  {
+  public:
+    model_skinning() = default;
+    explicit model_skinning (std::vector<ModelVertex> const& bind_pose);
+
+    std::size_t size() const { return _size; }
+
+    //! writes the position and normal of every vertex, blended from the
+    //! bones the vertex is weighted to, into \a output which has to be
+    //! size() long. The other members of \a output are left untouched.
+    //! \a position_matrices and \a normal_matrices are indexed by bone.
+    void skin ( std::vector<math::matrix_4x4> const& position_matrices
+              , std::vector<math::matrix_4x4> const& normal_matrices
+              , ModelVertex* output
+              , skinning_kernel kernel = default_skinning_kernel()
+              );
+
+  private:
+    void skin_scalar ( std::vector<math::matrix_4x4> const& position_matrices
+                     , std::vector<math::matrix_4x4> const& normal_matrices
+                     , ModelVertex* output
+                     ) const;
+    void skin_sse ( std::vector<math::matrix_4x4> const& position_matrices
+                  , std::vector<math::matrix_4x4> const& normal_matrices
+                  , ModelVertex* output
+                  );
+
+    static constexpr std::size_t influences = 4;
+
+    std::size_t _size = 0;
+
+    //! padded to a multiple of 4 vertices, with weights of 0
+    std::vector<float> _position[3];
+    std::vector<float> _normal[3];
+    std::vector<float> _weight[influences];
+    std::vector<std::uint8_t> _bone[influences];
+
+    //! the first three rows of every bone's position then normal
+    //! matrix, kept to not allocate on every frame
+    std::vector<float> _bone_rows;
+  };
+}
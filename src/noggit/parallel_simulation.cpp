@@ -0,0 +1,18 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/parallel_simulation.hpp>
+
+namespace noggit
+{
+  std::vector<float> simulation_steps (float dt, float max_step)
+  {
+    std::vector<float> steps;
+    while (dt > max_step)
+    {
+      steps.push_back (max_step);
+      dt -= max_step;
+    }
+    steps.push_back (dt);
+    return steps;
+  }
+}
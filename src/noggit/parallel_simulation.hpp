@@ -0,0 +1,42 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <noggit/job_scheduler.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace noggit
+{
+  //! \a dt cut in steps of \a max_step, the last one being what is left
+  //! (possibly 0), the way emitters always got updated
+  std::vector<float> simulation_steps (float dt, float max_step);
+
+  //! Call update (object, step) for every object and every step of \a
+  //! dt, spreading the objects over the scheduler's workers and the
+  //! calling thread. Every object gets its steps in order, so as long as
+  //! updating an object only touches that object, the result is the
+  //! same as doing every step for all objects on one thread.
+  template<typename T, typename Update>
+    void simulate_parallel ( job_scheduler& scheduler
+                           , std::vector<T*> const& objects
+                           , float dt
+                           , float max_step
+                           , Update&& update
+                           )
+  {
+    std::vector<float> const steps (simulation_steps (dt, max_step));
+
+    scheduler.parallel_for
+      ( 0, objects.size()
+      , [&] (std::size_t i)
+        {
+          for (float step : steps)
+          {
+            update (*objects[i], step);
+          }
+        }
+      );
+  }
+}
@@ -0,0 +1,268 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/particle_pool.hpp>
+#include <util/sse.hpp>
+
+#include <cmath>
+#include <utility>
+
+namespace noggit
+{
+  particle_pool::particle_pool (std::size_t capacity)
+    : _capacity (capacity)
+  {}
+
+  bool particle_pool::add (Particle const& p)
+  {
+    if (_size >= _capacity)
+    {
+      return false;
+    }
+
+    _px.push_back (p.pos.x);
+    _py.push_back (p.pos.y);
+    _pz.push_back (p.pos.z);
+    _vx.push_back (p.speed.x);
+    _vy.push_back (p.speed.y);
+    _vz.push_back (p.speed.z);
+    _life.push_back (p.life);
+    _particle_size.push_back (p.size);
+    _r.push_back (p.color.x);
+    _g.push_back (p.color.y);
+    _b.push_back (p.color.z);
+    _a.push_back (p.color.w);
+    _downx.push_back (p.down.x);
+    _downy.push_back (p.down.y);
+    _downz.push_back (p.down.z);
+    _dirx.push_back (p.dir.x);
+    _diry.push_back (p.dir.y);
+    _dirz.push_back (p.dir.z);
+    _maxlife.push_back (p.maxlife);
+    _origin.push_back (p.origin);
+    _corners.push_back ({{p.corners[0], p.corners[1], p.corners[2], p.corners[3]}});
+    _tile.push_back (p.tile);
+
+    ++_size;
+    return true;
+  }
+
+  void particle_pool::clear()
+  {
+    for (auto* member : { &_px, &_py, &_pz, &_vx, &_vy, &_vz, &_life, &_particle_size
+                        , &_r, &_g, &_b, &_a, &_downx, &_downy, &_downz
+                        , &_dirx, &_diry, &_dirz, &_maxlife
+                        }
+        )
+    {
+      member->clear();
+    }
+    _origin.clear();
+    _corners.clear();
+    _tile.clear();
+
+    _size = 0;
+  }
+
+  Particle particle_pool::get (std::size_t i) const
+  {
+    Particle p;
+    p.pos = position (i);
+    p.speed = {_vx[i], _vy[i], _vz[i]};
+    p.down = {_downx[i], _downy[i], _downz[i]};
+    p.origin = _origin[i];
+    p.dir = {_dirx[i], _diry[i], _dirz[i]};
+    for (std::size_t corner (0); corner < 4; ++corner)
+    {
+      p.corners[corner] = _corners[i][corner];
+    }
+    p.size = _particle_size[i];
+    p.life = _life[i];
+    p.maxlife = _maxlife[i];
+    p.tile = _tile[i];
+    p.color = color (i);
+    return p;
+  }
+
+  void particle_pool::remove (std::size_t i)
+  {
+    std::size_t const last (_size - 1);
+
+    for (auto* member : { &_px, &_py, &_pz, &_vx, &_vy, &_vz, &_life, &_particle_size
+                        , &_r, &_g, &_b, &_a, &_downx, &_downy, &_downz
+                        , &_dirx, &_diry, &_dirz, &_maxlife
+                        }
+        )
+    {
+      (*member)[i] = (*member)[last];
+      member->pop_back();
+    }
+    _origin[i] = _origin[last];
+    _origin.pop_back();
+    _corners[i] = _corners[last];
+    _corners.pop_back();
+    _tile[i] = _tile[last];
+    _tile.pop_back();
+
+    --_size;
+  }
+
+  void particle_pool::update ( float dt, float gravity, float deceleration, float slowdown
+                             , particle_ramp const& ramp
+                             )
+  {
+#ifdef NOGGIT_SSE
+    std::size_t const vectorized (_size / 4 * 4);
+    update_sse (0, vectorized, dt, gravity, deceleration, slowdown, ramp);
+    update_scalar (vectorized, _size, dt, gravity, deceleration, slowdown, ramp);
+#else
+    update_scalar (0, _size, dt, gravity, deceleration, slowdown, ramp);
+#endif
+
+    // kill off old particles
+    for (std::size_t i (0); i < _size;)
+    {
+      if (_life[i] / _maxlife[i] >= 1.0f)
+      {
+        remove (i);
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+
+  // every operation is done in the same order as with the math::vector
+  // types in the former update, so both kernels give the same results
+  void particle_pool::update_scalar ( std::size_t first, std::size_t last
+                                    , float dt, float gravity, float deceleration, float slowdown
+                                    , particle_ramp const& ramp
+                                    )
+  {
+    auto const life_ramp
+      ( [&] (float rlife, float a, float b, float c)
+        {
+          if (rlife <= ramp.mid)
+          {
+            float const t (rlife / ramp.mid);
+            return a * (1.0f - t) + b * t;
+          }
+
+          float const t ((rlife - ramp.mid) / (1.0f - ramp.mid));
+          return b * (1.0f - t) + c * t;
+        }
+      );
+
+    for (std::size_t i (first); i < last; ++i)
+    {
+      _vx[i] += _downx[i] * gravity * dt - _dirx[i] * deceleration * dt;
+      _vy[i] += _downy[i] * gravity * dt - _diry[i] * deceleration * dt;
+      _vz[i] += _downz[i] * gravity * dt - _dirz[i] * deceleration * dt;
+
+      float const mspeed (slowdown > 0 ? std::exp (-1.0f * slowdown * _life[i]) : 1.0f);
+
+      _px[i] += _vx[i] * mspeed * dt;
+      _py[i] += _vy[i] * mspeed * dt;
+      _pz[i] += _vz[i] * mspeed * dt;
+
+      _life[i] += dt;
+      float const rlife (_life[i] / _maxlife[i]);
+
+      _particle_size[i] = life_ramp (rlife, ramp.sizes[0], ramp.sizes[1], ramp.sizes[2]);
+      _r[i] = life_ramp (rlife, ramp.colors[0].x, ramp.colors[1].x, ramp.colors[2].x);
+      _g[i] = life_ramp (rlife, ramp.colors[0].y, ramp.colors[1].y, ramp.colors[2].y);
+      _b[i] = life_ramp (rlife, ramp.colors[0].z, ramp.colors[1].z, ramp.colors[2].z);
+      _a[i] = life_ramp (rlife, ramp.colors[0].w, ramp.colors[1].w, ramp.colors[2].w);
+    }
+  }
+
+  void particle_pool::update_sse ( std::size_t first, std::size_t last
+                                 , float dt, float gravity, float deceleration, float slowdown
+                                 , particle_ramp const& ramp
+                                 )
+  {
+#ifdef NOGGIT_SSE
+    __m128 const time (_mm_set1_ps (dt));
+    __m128 const grav (_mm_set1_ps (gravity));
+    __m128 const deaccel (_mm_set1_ps (deceleration));
+    __m128 const one (_mm_set1_ps (1.0f));
+    __m128 const mid (_mm_set1_ps (ramp.mid));
+    __m128 const after_mid (_mm_set1_ps (1.0f - ramp.mid));
+
+    for (std::size_t i (first); i < last; i += 4)
+    {
+      auto const accelerate
+        ( [&] (float* speed, float const* down, float const* dir)
+          {
+            __m128 const change ( _mm_sub_ps ( _mm_mul_ps (_mm_mul_ps (_mm_loadu_ps (down), grav), time)
+                                             , _mm_mul_ps (_mm_mul_ps (_mm_loadu_ps (dir), deaccel), time)
+                                             )
+                                );
+            _mm_storeu_ps (speed, _mm_add_ps (_mm_loadu_ps (speed), change));
+          }
+        );
+      accelerate (&_vx[i], &_downx[i], &_dirx[i]);
+      accelerate (&_vy[i], &_downy[i], &_diry[i]);
+      accelerate (&_vz[i], &_downz[i], &_dirz[i]);
+
+      __m128 mspeed (one);
+      if (slowdown > 0)
+      {
+        alignas (16) float slow[4];
+        for (std::size_t lane (0); lane < 4; ++lane)
+        {
+          slow[lane] = std::exp (-1.0f * slowdown * _life[i + lane]);
+        }
+        mspeed = _mm_load_ps (slow);
+      }
+
+      auto const move
+        ( [&] (float* position, float const* speed)
+          {
+            _mm_storeu_ps (position, _mm_add_ps (_mm_loadu_ps (position), _mm_mul_ps (_mm_mul_ps (_mm_loadu_ps (speed), mspeed), time)));
+          }
+        );
+      move (&_px[i], &_vx[i]);
+      move (&_py[i], &_vy[i]);
+      move (&_pz[i], &_vz[i]);
+
+      __m128 const life (_mm_add_ps (_mm_loadu_ps (&_life[i]), time));
+      _mm_storeu_ps (&_life[i], life);
+      __m128 const rlife (_mm_div_ps (life, _mm_loadu_ps (&_maxlife[i])));
+
+      __m128 const before_mid (_mm_cmple_ps (rlife, mid));
+      __m128 const t_before (_mm_div_ps (rlife, mid));
+      __m128 const t_after (_mm_div_ps (_mm_sub_ps (rlife, mid), after_mid));
+
+      auto const life_ramp
+        ( [&] (float* output, float a, float b, float c)
+          {
+            __m128 const va (_mm_set1_ps (a));
+            __m128 const vb (_mm_set1_ps (b));
+            __m128 const vc (_mm_set1_ps (c));
+
+            __m128 const first_half ( _mm_add_ps ( _mm_mul_ps (va, _mm_sub_ps (one, t_before))
+                                                 , _mm_mul_ps (vb, t_before)
+                                                 )
+                                    );
+            __m128 const second_half ( _mm_add_ps ( _mm_mul_ps (vb, _mm_sub_ps (one, t_after))
+                                                  , _mm_mul_ps (vc, t_after)
+                                                  )
+                                     );
+
+            _mm_storeu_ps ( output
+                          , _mm_or_ps (_mm_and_ps (before_mid, first_half), _mm_andnot_ps (before_mid, second_half))
+                          );
+          }
+        );
+      life_ramp (&_particle_size[i], ramp.sizes[0], ramp.sizes[1], ramp.sizes[2]);
+      life_ramp (&_r[i], ramp.colors[0].x, ramp.colors[1].x, ramp.colors[2].x);
+      life_ramp (&_g[i], ramp.colors[0].y, ramp.colors[1].y, ramp.colors[2].y);
+      life_ramp (&_b[i], ramp.colors[0].z, ramp.colors[1].z, ramp.colors[2].z);
+      life_ramp (&_a[i], ramp.colors[0].w, ramp.colors[1].w, ramp.colors[2].w);
+    }
+#else
+    update_scalar (first, last, dt, gravity, deceleration, slowdown, ramp);
+#endif
+  }
+}
@@ -0,0 +1,94 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+#include <math/vector_4d.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+struct Particle {
+  math::vector_3d pos, speed, down, origin, dir;
+  math::vector_3d  corners[4];
+  //math::vector_3d tpos;
+  float size, life, maxlife;
+  unsigned int tile;
+  math::vector_4d color;
+};
+
+namespace noggit
+{
+  //! how a particle's size and color change over its life: from the
+  //! first to the second value until \a mid, then to the third one
+  struct particle_ramp
+  {
+    float mid;
+    std::array<float, 3> sizes;
+    std::array<math::vector_4d, 3> colors;
+  };
+
+  //! The particles of one emitter, one array per member so updating
+  //! them runs over contiguous floats. Storage only ever grows up to the
+  //! capacity, so spawning and dying particles never allocate once an
+  //! emitter reached its usual count. Dead particles are replaced by the
+  //! last one, which does not keep the particles' order.
+  class particle_pool
+  {
+  public:
+    explicit particle_pool (std::size_t capacity);
+
+    std::size_t size() const { return _size; }
+    std::size_t capacity() const { return _capacity; }
+    bool empty() const { return !_size; }
+
+    //! false if the pool is full
+    bool add (Particle const&);
+    void clear();
+
+    //! moves the particles, then updates their size and color and
+    //! removes the ones that reached their maximum life, exactly like
+    //! ParticleSystem::update did particle by particle
+    void update (float dt, float gravity, float deceleration, float slowdown, particle_ramp const&);
+
+    math::vector_3d position (std::size_t i) const { return {_px[i], _py[i], _pz[i]}; }
+    math::vector_3d const& origin (std::size_t i) const { return _origin[i]; }
+    std::array<math::vector_3d, 4> const& corners (std::size_t i) const { return _corners[i]; }
+    float particle_size (std::size_t i) const { return _particle_size[i]; }
+    math::vector_4d color (std::size_t i) const { return {_r[i], _g[i], _b[i], _a[i]}; }
+    unsigned int tile (std::size_t i) const { return _tile[i]; }
+
+    //! all of the particle's members, for tests
+    Particle get (std::size_t i) const;
+
+  private:
+    void update_scalar ( std::size_t first, std::size_t last
+                       , float dt, float gravity, float deceleration, float slowdown
+                       , particle_ramp const&
+                       );
+    void update_sse ( std::size_t first, std::size_t last
+                    , float dt, float gravity, float deceleration, float slowdown
+                    , particle_ramp const&
+                    );
+    void remove (std::size_t i);
+
+    std::size_t _capacity;
+    std::size_t _size = 0;
+
+    // moved by update()
+    std::vector<float> _px, _py, _pz;
+    std::vector<float> _vx, _vy, _vz;
+    std::vector<float> _life;
+    std::vector<float> _particle_size;
+    std::vector<float> _r, _g, _b, _a;
+
+    // constant over a particle's life
+    std::vector<float> _downx, _downy, _downz;
+    std::vector<float> _dirx, _diry, _dirz;
+    std::vector<float> _maxlife;
+    std::vector<math::vector_3d> _origin;
+    std::vector<std::array<math::vector_3d, 4>> _corners;
+    std::vector<unsigned int> _tile;
+  };
+}
@@ -0,0 +1,134 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  //! A value that many threads read and one now and then replaces as a
+  //! whole. Reading is a single atomic load that never blocks and never
+  //! sees a value half replaced. Replaced values are kept until the
+  //! published itself goes away, so references from current() stay
+  //! valid: meant for what changes a few times per session, like the
+  //! settings, not for what changes every frame.
+  template<typename T>
+    class published
+  {
+  public:
+    using listener = std::function<void (T const&)>;
+
+    //! Ends the subscription when destroyed. Has to be destroyed on the
+    //! thread publishing, or a listener may be called once more after.
+    class subscription
+    {
+    public:
+      subscription() = default;
+      subscription (subscription const&) = delete;
+      subscription& operator= (subscription const&) = delete;
+      subscription (subscription&& other)
+        : _owner (std::exchange (other._owner, nullptr))
+        , _id (other._id)
+      {}
+      subscription& operator= (subscription&& other)
+      {
+        reset();
+        _owner = std::exchange (other._owner, nullptr);
+        _id = other._id;
+        return *this;
+      }
+      ~subscription()
+      {
+        reset();
+      }
+
+      void reset()
+      {
+        if (_owner)
+        {
+          _owner->unsubscribe (_id);
+          _owner = nullptr;
+        }
+      }
+
+    private:
+      friend class published;
+      subscription (published* owner, std::size_t id)
+        : _owner (owner)
+        , _id (id)
+      {}
+
+      published* _owner = nullptr;
+      std::size_t _id = 0;
+    };
+
+    explicit published (T initial)
+    {
+      _values.emplace_back (std::make_unique<T const> (std::move (initial)));
+      _current.store (_values.back().get(), std::memory_order_release);
+    }
+
+    published (published const&) = delete;
+    published& operator= (published const&) = delete;
+
+    T const& current() const
+    {
+      return *_current.load (std::memory_order_acquire);
+    }
+
+    //! Replace the value, then call every listener with the new one on
+    //! this thread.
+    void publish (T value)
+    {
+      std::vector<listener> listeners;
+      T const* published_value;
+
+      {
+        std::lock_guard<std::mutex> const lock (_mutex);
+        _values.emplace_back (std::make_unique<T const> (std::move (value)));
+        published_value = _values.back().get();
+        _current.store (published_value, std::memory_order_release);
+
+        for (auto const& entry : _listeners)
+        {
+          listeners.emplace_back (entry.second);
+        }
+      }
+
+      for (auto const& fun : listeners)
+      {
+        fun (*published_value);
+      }
+    }
+
+    //! \a fun is called for every value published from now on, not for
+    //! the current one.
+    subscription subscribe (listener fun)
+    {
+      std::lock_guard<std::mutex> const lock (_mutex);
+      std::size_t const id (_next_id++);
+      _listeners.emplace (id, std::move (fun));
+      return {this, id};
+    }
+
+  private:
+    void unsubscribe (std::size_t id)
+    {
+      std::lock_guard<std::mutex> const lock (_mutex);
+      _listeners.erase (id);
+    }
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<T const>> _values;
+    std::atomic<T const*> _current;
+    std::map<std::size_t, listener> _listeners;
+    std::size_t _next_id = 0;
+  };
+}
@@ -109,7 +109,7 @@ namespace noggit
       {
         if (*iter == -1)
           break;
-        ts->tmp_edit_values.get()->operator[](index)[*iter] = alpha;
+        ts->tmp_edit_values.get()->set_alpha(index, *iter, alpha);
       }
     }
 
@@ -139,7 +139,7 @@ namespace noggit
       {
         if (*iter == -1)
           break;
-        sum += ts->tmp_edit_values.get()->operator[](index)[*iter];
+        sum += ts->tmp_edit_values.get()->alpha(index, *iter);
         ++ctr;
       }
       return sum / float(ctr);
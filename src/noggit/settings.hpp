@@ -1,6 +1,10 @@
 #pragma once
 
+#include <noggit/editor_settings.hpp>
+#include <noggit/published.hpp>
+
 #include <QtCore/QSettings>
+#include <QtGui/QColor>
 
 #include <memory>
 
@@ -22,6 +26,8 @@ namespace noggit
       values->setValue("project/path", project_folder);
 
       uids = std::make_unique<QSettings>(project_folder + "uid.ini", QSettings::Format::IniFormat);
+
+      _editor = std::make_unique<published<editor_settings>>(read_editor_settings());
     }
 
     QVariant value(const QString& key, const QVariant& default = QVariant()) const
@@ -34,19 +40,79 @@ namespace noggit
       values->setValue(key, value);
     }
 
-    std::string project_path()
+    std::string project_path() const
     {
-      return values->value("project/path", "./").toString().toStdString();
+      return editor().project_path;
     }
 
+    //! Write the settings to disk and publish the typed ones, call it
+    //! once done changing them.
     void sync()
     {
       values->sync();
+      _editor->publish(read_editor_settings());
+    }
+
+    //! The settings as of the last sync(), for code that runs often or
+    //! off the main thread: no lookup, no lock.
+    editor_settings const& editor() const
+    {
+      return _editor->current();
+    }
+
+    //! \a fun is called on the main thread with the new settings after
+    //! each sync().
+    published<editor_settings>::subscription on_editor_settings_change
+      (published<editor_settings>::listener fun)
+    {
+      return _editor->subscribe(std::move(fun));
     }
 
     std::unique_ptr<QSettings> values;
     std::unique_ptr<QSettings> uids;
 
+  private:
+    editor_settings read_editor_settings() const
+    {
+      editor_settings s;
+
+      s.project_path = values->value("project/path", "./").toString().toStdString();
+      s.fov = values->value("fov", s.fov).toFloat();
+      s.view_distance = values->value("view_distance", s.view_distance).toFloat();
+      s.tablet = values->value("tablet/enabled", s.tablet).toBool();
+
+      s.wireframe_type = values->value("wireframe/type", s.wireframe_type).toInt();
+      s.wireframe_radius = values->value("wireframe/radius", s.wireframe_radius).toFloat();
+      s.wireframe_width = values->value("wireframe/width", s.wireframe_width).toFloat();
+      QColor const wireframe_color(values->value("wireframe/color").value<QColor>());
+      s.wireframe_color = math::vector_4d( wireframe_color.redF(), wireframe_color.greenF()
+                                         , wireframe_color.blueF(), wireframe_color.alphaF()
+                                         );
+
+      s.parallel_chunk_edits = values->value("parallel_chunk_edits", s.parallel_chunk_edits).toBool();
+
+      s.random_rotation = values->value("model/random_rotation", s.random_rotation).toBool();
+      s.random_tilt = values->value("model/random_tilt", s.random_tilt).toBool();
+      s.random_size = values->value("model/random_size", s.random_size).toBool();
+
+      s.loading_radius = values->value("loading_radius", s.loading_radius).toInt();
+      s.tile_lookahead = values->value("tile_lookahead", s.tile_lookahead).toFloat();
+      s.tile_memory_budget = values->value("tile_memory_budget", s.tile_memory_budget).toInt();
+      s.tile_cache = values->value("tile_cache", s.tile_cache).toBool();
+      s.additional_file_loading_log = values->value("additional_file_loading_log", s.additional_file_loading_log).toBool();
+
+      s.use_mclq_liquids_export = values->value("use_mclq_liquids_export", s.use_mclq_liquids_export).toBool();
+      s.mclq_liquids_path = values->value("project/mclq_liquids_path").toString().toStdString();
+
+      s.mysql_enabled = values->value("project/mysql/enabled", s.mysql_enabled).toBool();
+
+      return s;
+    }
+
+    std::unique_ptr<published<editor_settings>> _editor;
+
+  public:
+
     static settings& instance()
     {
       static settings inst;
@@ -0,0 +1,195 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/terrain_normals.hpp>
+#include <util/sse.hpp>
+
+#include <cmath>
+
+namespace noggit
+{
+  std::array<float, 4> const chunk_normals::corner_x = {{-UNITSIZE / 2.f, UNITSIZE / 2.f, UNITSIZE / 2.f, -UNITSIZE / 2.f}};
+  std::array<float, 4> const chunk_normals::corner_z = {{-UNITSIZE / 2.f, -UNITSIZE / 2.f, UNITSIZE / 2.f, UNITSIZE / 2.f}};
+
+  namespace
+  {
+    int outer_vertex (int row, int column)
+    {
+      return 17 * row + column;
+    }
+    int inner_vertex (int row, int column)
+    {
+      return 17 * row + 9 + column;
+    }
+
+    std::array<std::array<int, 4>, chunk_normals::vertex_count> make_inside_vertices()
+    {
+      std::array<std::array<int, 4>, chunk_normals::vertex_count> inside;
+
+      for (int i (0); i < static_cast<int> (chunk_normals::vertex_count); ++i)
+      {
+        int const row (i / 17);
+        bool const is_inner (i % 17 >= 9);
+        int const column (is_inner ? i % 17 - 9 : i % 17);
+
+        for (int corner (0); corner < 4; ++corner)
+        {
+          bool const plus_x (corner == 1 || corner == 2);
+          bool const plus_z (corner >= 2);
+
+          if (is_inner)
+          {
+            // corners of inner vertices are outer vertices, those on the
+            // border may belong to the neighbour chunk as well
+            int const outer_row (row + (plus_z ? 1 : 0));
+            int const outer_column (column + (plus_x ? 1 : 0));
+
+            bool const on_border ( outer_row == 0 || outer_row == 8
+                                || outer_column == 0 || outer_column == 8
+                                 );
+            inside[i][corner] = on_border ? -1 : outer_vertex (outer_row, outer_column);
+          }
+          else
+          {
+            // corners of outer vertices are inner vertices, unless they
+            // are outside of the chunk
+            int const inner_row (row - (plus_z ? 0 : 1));
+            int const inner_column (column - (plus_x ? 0 : 1));
+
+            bool const outside ( inner_row < 0 || inner_row > 7
+                              || inner_column < 0 || inner_column > 7
+                               );
+            inside[i][corner] = outside ? -1 : inner_vertex (inner_row, inner_column);
+          }
+        }
+      }
+
+      return inside;
+    }
+  }
+
+  chunk_normals::chunk_normals()
+  {
+    // the padding is computed too, keep it finite
+    _x.fill (0.f);
+    _y.fill (0.f);
+    _z.fill (0.f);
+    for (auto& heights : _corner_height)
+    {
+      heights.fill (0.f);
+    }
+  }
+
+  std::array<std::array<int, 4>, chunk_normals::vertex_count> const& chunk_normals::inside_vertices()
+  {
+    static std::array<std::array<int, 4>, vertex_count> const inside (make_inside_vertices());
+    return inside;
+  }
+
+  void chunk_normals::compute_scalar (math::vector_3d* normals) const
+  {
+    for (std::size_t i (0); i < vertex_count; ++i)
+    {
+      math::vector_3d const v (_x[i], _y[i], _z[i]);
+
+      math::vector_3d const P1 (v.x + corner_x[0], _corner_height[0][i], v.z + corner_z[0]);
+      math::vector_3d const P2 (v.x + corner_x[1], _corner_height[1][i], v.z + corner_z[1]);
+      math::vector_3d const P3 (v.x + corner_x[2], _corner_height[2][i], v.z + corner_z[2]);
+      math::vector_3d const P4 (v.x + corner_x[3], _corner_height[3][i], v.z + corner_z[3]);
+
+      math::vector_3d const N1 ((P2 - v) % (P1 - v));
+      math::vector_3d const N2 ((P3 - v) % (P2 - v));
+      math::vector_3d const N3 ((P4 - v) % (P3 - v));
+      math::vector_3d const N4 ((P1 - v) % (P4 - v));
+
+      math::vector_3d Norm (N1 + N2 + N3 + N4);
+      Norm.normalize();
+
+      Norm.x = std::floor(Norm.x * 127) / 127;
+      Norm.y = std::floor(Norm.y * 127) / 127;
+      Norm.z = std::floor(Norm.z * 127) / 127;
+
+      normals[i] = {-Norm.z, Norm.y, -Norm.x};
+    }
+  }
+
+#ifdef NOGGIT_SSE
+  namespace
+  {
+    struct sse_vector
+    {
+      __m128 x, y, z;
+    };
+
+    sse_vector cross (sse_vector const& a, sse_vector const& b)
+    {
+      return { _mm_sub_ps (_mm_mul_ps (a.y, b.z), _mm_mul_ps (a.z, b.y))
+             , _mm_sub_ps (_mm_mul_ps (a.z, b.x), _mm_mul_ps (a.x, b.z))
+             , _mm_sub_ps (_mm_mul_ps (a.x, b.y), _mm_mul_ps (a.y, b.x))
+             };
+    }
+
+    sse_vector add (sse_vector const& a, sse_vector const& b)
+    {
+      return {_mm_add_ps (a.x, b.x), _mm_add_ps (a.y, b.y), _mm_add_ps (a.z, b.z)};
+    }
+
+    // std::floor for the normal components, |value| <= 127, keeping -0
+    __m128 floor (__m128 value)
+    {
+      __m128 const sign (_mm_set1_ps (-0.f));
+      __m128 truncated (_mm_cvtepi32_ps (_mm_cvttps_epi32 (value)));
+      truncated = _mm_sub_ps (truncated, _mm_and_ps (_mm_cmpgt_ps (truncated, value), _mm_set1_ps (1.f)));
+      __m128 const is_zero (_mm_cmpeq_ps (truncated, _mm_setzero_ps()));
+      return _mm_or_ps (truncated, _mm_and_ps (is_zero, _mm_and_ps (value, sign)));
+    }
+
+    __m128 quantize (__m128 value)
+    {
+      return _mm_div_ps (floor (_mm_mul_ps (value, _mm_set1_ps (127.f))), _mm_set1_ps (127.f));
+    }
+  }
+
+  void chunk_normals::compute (math::vector_3d* normals) const
+  {
+    __m128 const sign (_mm_set1_ps (-0.f));
+
+    for (std::size_t i (0); i < padded_count; i += 4)
+    {
+      sse_vector const v {_mm_loadu_ps (&_x[i]), _mm_loadu_ps (&_y[i]), _mm_loadu_ps (&_z[i])};
+
+      // the points minus the vertex, rounded like the scalar version
+      sse_vector d[4];
+      for (std::size_t corner (0); corner < 4; ++corner)
+      {
+        d[corner] = { _mm_sub_ps (_mm_add_ps (v.x, _mm_set1_ps (corner_x[corner])), v.x)
+                    , _mm_sub_ps (_mm_loadu_ps (&_corner_height[corner][i]), v.y)
+                    , _mm_sub_ps (_mm_add_ps (v.z, _mm_set1_ps (corner_z[corner])), v.z)
+                    };
+      }
+
+      sse_vector sum (add (add (add (cross (d[1], d[0]), cross (d[2], d[1])), cross (d[3], d[2])), cross (d[0], d[3])));
+
+      __m128 const length_squared
+        (_mm_add_ps (_mm_add_ps (_mm_mul_ps (sum.x, sum.x), _mm_mul_ps (sum.y, sum.y)), _mm_mul_ps (sum.z, sum.z)));
+      __m128 const inverse_length (_mm_div_ps (_mm_set1_ps (1.f), _mm_sqrt_ps (length_squared)));
+
+      alignas (16) float x[4];
+      alignas (16) float y[4];
+      alignas (16) float z[4];
+      _mm_store_ps (x, _mm_xor_ps (quantize (_mm_mul_ps (sum.z, inverse_length)), sign));
+      _mm_store_ps (y, quantize (_mm_mul_ps (sum.y, inverse_length)));
+      _mm_store_ps (z, _mm_xor_ps (quantize (_mm_mul_ps (sum.x, inverse_length)), sign));
+
+      for (std::size_t j (0); j < 4 && i + j < vertex_count; ++j)
+      {
+        normals[i + j] = {x[j], y[j], z[j]};
+      }
+    }
+  }
+#else
+  void chunk_normals::compute (math::vector_3d* normals) const
+  {
+    compute_scalar (normals);
+  }
+#endif
+}
@@ -0,0 +1,83 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <boost/optional.hpp>
+
+#include <array>
+#include <cstddef>
+
+namespace noggit
+{
+  //! The vertices of a chunk with the heights of the four points around
+  //! each of them, half a unit away in the diagonals, laid out one array
+  //! per component so the normals of four vertices are computed at once.
+  //! Gives bit for bit the quantized normals MapChunk::recalcNorms used
+  //! to compute one vertex and one height lookup at a time.
+  class chunk_normals
+  {
+  public:
+    //! 9x9 outer and 8x8 inner vertices, row after row
+    static constexpr std::size_t vertex_count = 9 * 9 + 8 * 8;
+    static constexpr std::size_t padded_count = (vertex_count + 3) / 4 * 4;
+
+    //! offsets of the points around a vertex: -x -z, +x -z, +x +z, -x +z
+    static std::array<float, 4> const corner_x;
+    static std::array<float, 4> const corner_z;
+
+    chunk_normals();
+
+    //! \a vertices are the ones of a chunk, anything with a position.
+    //! Points inside the chunk take the height of its own vertex there,
+    //! points on its border or outside ask \a height (x, z), which has to
+    //! behave like World::GetVertex, and keep the vertex's height if it
+    //! gives none.
+    template<typename Vertices, typename Height>
+      void gather (Vertices const& vertices, Height&& height)
+    {
+      auto const& inside (inside_vertices());
+
+      for (std::size_t i (0); i < vertex_count; ++i)
+      {
+        math::vector_3d const& position (vertices[i].position);
+
+        _x[i] = position.x;
+        _y[i] = position.y;
+        _z[i] = position.z;
+
+        for (std::size_t corner (0); corner < 4; ++corner)
+        {
+          if (inside[i][corner] >= 0)
+          {
+            _corner_height[corner][i] = vertices[inside[i][corner]].position.y;
+          }
+          else
+          {
+            _corner_height[corner][i] = height ( position.x + corner_x[corner]
+                                               , position.z + corner_z[corner]
+                                               ).get_value_or (position.y);
+          }
+        }
+      }
+    }
+
+    //! writes vertex_count normals, already swizzled like the chunk's
+    //! vertex normals
+    void compute (math::vector_3d* normals) const;
+    void compute_scalar (math::vector_3d* normals) const;
+
+    //! for every vertex and corner, the vertex of the same chunk at that
+    //! point when it is far enough from the border to not be looked up,
+    //! or -1
+    static std::array<std::array<int, 4>, vertex_count> const& inside_vertices();
+
+  private:
+    std::array<float, padded_count> _x;
+    std::array<float, padded_count> _y;
+    std::array<float, padded_count> _z;
+    std::array<std::array<float, padded_count>, 4> _corner_height;
+  };
+}
@@ -1,6 +1,7 @@
 // This file is part of Noggit3, licensed under GNU General Public License (version 3).
 
 #include <noggit/Brush.h>
+#include <noggit/alpha_shadow_map.hpp>
 #include <noggit/chunk_mover.hpp>
 #include <noggit/Log.h>
 #include <noggit/MapTile.h>
@@ -22,7 +23,7 @@ TextureSet::TextureSet ( MapChunkHeader const& header
                        , bool use_big_alphamaps
                        , bool do_not_fix_alpha_map
                        , bool do_not_convert_alphamaps
-                       , chunk_shadow* shadow
+                       , std::array<std::uint8_t const*, 3> const* cached_alphamaps
                        )
   : nTextures(header.nLayers)
   , _do_not_convert_alphamaps(do_not_convert_alphamaps)
@@ -48,52 +49,39 @@ TextureSet::TextureSet ( MapChunkHeader const& header
       _textures.push_back(tile->mTextureFilenames[_layers_info[i].textureID]);
     }
 
-    size_t alpha_base = base + header.ofsAlpha + 8;
-
-    for (unsigned int layer = 0; layer < nTextures; ++layer)
+    if (cached_alphamaps)
     {
-      if (_layers_info[layer].flags & 0x100)
+      for (std::size_t layer = 1; layer < nTextures; ++layer)
       {
-        f->seek (alpha_base + _layers_info[layer].ofsAlpha);
-        alphamaps[layer - 1] = std::make_unique<Alphamap> (f, _layers_info[layer].flags, use_big_alphamaps, do_not_fix_alpha_map);
+        if ((*cached_alphamaps)[layer - 1])
+        {
+          alphamaps[layer - 1] = std::make_unique<Alphamap>();
+          alphamaps[layer - 1]->setAlpha((*cached_alphamaps)[layer - 1]);
+        }
       }
     }
-
-    // always use big alpha for editing / rendering
-    if (!use_big_alphamaps && !_do_not_convert_alphamaps)
-    {
-      convertToBigAlpha();
-    }
-
-
-    if (nTextures)
+    else
     {
-      _setup_amap_data = std::make_unique<std::array<std::uint8_t, 4 * 64 * 64>>();
-      std::uint8_t* amap = _setup_amap_data.get()->data();
-      std::uint8_t const* alpha_ptr[3];
-
-      bool use_shadow = shadow != nullptr;
+      size_t alpha_base = base + header.ofsAlpha + 8;
 
-      for (int i = 0; i < nTextures - 1; ++i)
+      for (unsigned int layer = 0; layer < nTextures; ++layer)
       {
-        alpha_ptr[i] = alphamaps[i]->getAlpha();
-      }
-
-      for (int i = 0; i < 64 * 64; ++i)
-      {
-        for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
+        if (_layers_info[layer].flags & 0x100)
         {
-          amap[i * 4 + alpha_id] = ((alpha_id < nTextures - 1)
-            ? *(alpha_ptr[alpha_id]++)
-            : 0
-            );
+          f->seek (alpha_base + _layers_info[layer].ofsAlpha);
+          alphamaps[layer - 1] = std::make_unique<Alphamap> (f, _layers_info[layer].flags, use_big_alphamaps, do_not_fix_alpha_map);
         }
-
-        amap[i * 4 + 3] = use_shadow ? ((shadow->data[i / 64] >> (i % 64)) & 1) * 255 : 0;
       }
-      _first_amap_setup = true;
     }
-    _need_amap_update = true;
+
+    // always use big alpha for editing / rendering, cached ones already are
+    if (!use_big_alphamaps && !_do_not_convert_alphamaps && !cached_alphamaps)
+    {
+      convertToBigAlpha();
+    }
+
+
+    _amap_changed = noggit::texel_rect::whole();
   }
 }
 
@@ -186,7 +174,7 @@ int TextureSet::addTexture (scoped_blp_texture_reference texture)
 
     if (tmp_edit_values && nTextures == 1)
     {
-      tmp_edit_values.get()->map[0].fill(255.f);
+      tmp_edit_values.get()->map[0].fill(tmp_edit_alpha_values::full);
     }
   }
 
@@ -334,7 +322,7 @@ void TextureSet::eraseTexture(size_t id)
   // set the default values for the temporary alphamap too
   if (tmp_edit_values)
   {
-    tmp_edit_values.get()->map[nTextures].fill(0.f);
+    tmp_edit_values.get()->map[nTextures].fill(0);
   }
 
   require_update();
@@ -394,7 +382,7 @@ bool TextureSet::eraseUnusedTextures(float threshold)
       {
         // use 0.01 to account for floating point imprecision
         // while not preventing very low pressure brush from painting correctly
-        if (amaps[layer][i] >= threshold)
+        if (amaps.alpha(layer, i) >= threshold)
         {
           visible_tex.emplace(layer);
           break; // texture visible, go to the next layer
@@ -471,7 +459,7 @@ bool TextureSet::paintTexture(float xbase, float zbase, float x, float z, Brush*
 {
   bool changed = false;
 
-  float zPos, xPos, dist, radius;
+  float radius;
 
   // todo: investigate the root cause
   // shift brush origin to avoid disconnects at the chunks' borders
@@ -513,132 +501,20 @@ bool TextureSet::paintTexture(float xbase, float zbase, float x, float z, Brush*
   create_temporary_alphamaps_if_needed();
   auto& amaps = *tmp_edit_values.get();
 
-  zPos = zbase;
-
-  for (int j = 0; j < 64; j++)
-  {
-    xPos = xbase;
-    for (int i = 0; i < 64; ++i)
-    {
-      dist = misc::getShortestDist(x, z, xPos, zPos, TEXDETAILSIZE);
-
-      if (dist <= radius)
-      {
-        // use double for more precision
-        std::array<double,4> alpha_values;
-        double total = 0.;
-
-        for (int n = 0; n < 4; ++n)
-        {
-          total += alpha_values[n] = amaps[n][i + 64 * j];
-        }
-
-        double current_alpha = alpha_values[tex_layer];
-        double sum_other_alphas = (total - current_alpha);
-        double alpha_change = (strength - current_alpha) * pressure * brush->value_at_dist(dist);
-
-        // alpha too low, set it to 0 directly
-        if (alpha_change < 0. && current_alpha + alpha_change < 1.)
-        {
-          alpha_change = -current_alpha;
-        }
-
-        if (!misc::float_equals(current_alpha, strength))
-        {
-          if (sum_other_alphas < 1.)
-          {
-            // alpha is currently at 254/255 -> set it at 255 and clear the rest of the values
-            if (alpha_change > 0.f)
-            {
-              for (int layer = 0; layer < nTextures; ++layer)
-              {
-                alpha_values[layer] = layer == tex_layer ? 255. : 0.f;
-              }
-            }
-            // all the other textures amount for less an 1/255 -> add the alpha_change (negative) to current texture and remove it from the first non current texture, clear the rest
-            else
-            {
-              bool change_applied = false;
-
-              for (int layer = 0; layer < nTextures; ++layer)
-              {
-                if (layer == tex_layer)
-                {
-                  alpha_values[layer] += alpha_change;
-                }
-                else
-                {
-                  if (!change_applied)
-                  {
-                    alpha_values[layer] -= alpha_change;
-                  }
-                  else
-                  {
-                    alpha_values[tex_layer] += alpha_values[layer];
-                    alpha_values[layer] = 0.;
-                  }
-
-                  change_applied = true;
-                }
-              }
-            }
-          }
-          else
-          {
-            for (int layer = 0; layer < nTextures; ++layer)
-            {
-              if (layer == tex_layer)
-              {
-                alpha_values[layer] += alpha_change;
-              }
-              else
-              {
-                alpha_values[layer] -= alpha_change * alpha_values[layer] / sum_other_alphas;
-
-                // clear values too low to be visible
-                if (alpha_values[layer] < 1.)
-                {
-                  alpha_values[tex_layer] += alpha_values[layer];
-                  alpha_values[layer] = 0.f;
-                }
-              }
-            }
-          }
-
-          double total_final = std::accumulate(alpha_values.begin(), alpha_values.end(), 0.);
-
-          // failsafe in case the sum of all alpha values deviate
-          if (std::abs(total_final - 255.) > 0.001)
-          {
-            for (double& d : alpha_values)
-            {
-              d = d * 255. / total_final;
-            }
-          }
-
-          for (int n = 0; n < 4; ++n)
-          {
-            amaps[n][i + 64 * j] = static_cast<float>(alpha_values[n]);
-          }
-
-          changed = true;
-        }
-      }
-
-      xPos += TEXDETAILSIZE;
-    }
-    zPos += TEXDETAILSIZE;
-  }
+  changed = noggit::paint_alphas ( amaps, nTextures, tex_layer, xbase, zbase, x, z
+                                 , radius, brush->get_inner_radius(), strength, pressure
+                                 );
 
   if (!changed)
   {
     return false;
   }
 
-  // cleanup
+  // cleanup, which requires the whole alphamap when it erases a layer
   eraseUnusedTextures();
 
-  require_update();
+  _amap_changed.merge(noggit::texels_in_range(xbase, zbase, x, z, radius));
+  _need_lod_texture_map_update = true;
 
   return true;
 }
@@ -711,8 +587,9 @@ bool TextureSet::replace_texture( float xbase
       {
         int offset = j * 64 + i;
 
-        amap[new_tex_level][offset] += amap[old_tex_level][offset];
-        amap[old_tex_level][offset] = 0.f;
+        amap[new_tex_level][offset] = std::min<std::uint16_t>
+          (tmp_edit_alpha_values::full, amap[new_tex_level][offset] + amap[old_tex_level][offset]);
+        amap[old_tex_level][offset] = 0;
 
         changed = true;
       }
@@ -981,7 +858,7 @@ void TextureSet::merge_layers(size_t id1, size_t id2)
 
   for (int i = 0; i < 64 * 64; ++i)
   {
-    amap[id1][i] += amap[id2][i];
+    amap[id1][i] = std::min<std::uint16_t>(tmp_edit_alpha_values::full, amap[id1][i] + amap[id2][i]);
     // no need to set the id alphamap to 0, it'll be done in "eraseTexture(id2)"
   }
 
@@ -1103,7 +980,7 @@ bool TextureSet::apply_alpha_changes()
 
     for (int i = 0; i < 64 * 64; ++i)
     {
-      values[i] = float_alpha_to_uint8(new_amaps[alpha_layer + 1][i]);
+      values[i] = float_alpha_to_uint8(new_amaps.alpha(alpha_layer + 1, i));
       totals[i] += values[i];
 
       // remove the possible overflow with rounding
@@ -1143,112 +1020,60 @@ void TextureSet::create_temporary_alphamaps_if_needed()
     {
       float f = static_cast<float>(alphamaps[alpha_layer]->getAlpha(i));
 
-      values[alpha_layer + 1][i] = f;
+      values.set_alpha(alpha_layer + 1, i, f);
       base_alpha -= f;
     }
 
-    values[0][i] = base_alpha;
+    values.set_alpha(0, i, base_alpha);
   }
 }
 
-void TextureSet::update_alpha_shadow_map_if_needed(int chunk_x, int chunk_y, chunk_shadow* shadow, noggit::chunk_data* preview_data)
+noggit::texel_rect TextureSet::pack_alpha_shadow_map_if_needed(std::uint8_t* texels, chunk_shadow const* shadow, noggit::chunk_data* preview_data)
 {
-  if (_need_amap_update)
-  {
-    opengl::texture::set_active_texture(0);
-
-    bool use_shadow = (shadow != nullptr);
+  noggit::texel_rect const changed = _amap_changed;
 
-    if (preview_data)
-    {
-      std::vector<uint8_t> amap(4 * 64 * 64);
-      uint8_t const* alpha_ptr[3];
-      int preview_alpha_count = preview_data->texture_count - 1;
+  if (changed.empty())
+  {
+    return {};
+  }
 
-      for (int i = 0; i < preview_alpha_count; ++i)
-      {
-        alpha_ptr[i] = preview_data->alphamaps[i].getAlpha();
-      }
+  _amap_changed = {};
 
-      for (int i = 0; i < 64 * 64; ++i)
-      {
-        for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
-        {
-          amap[i * 4 + alpha_id] = (alpha_id < preview_alpha_count)
-            ? *(alpha_ptr[alpha_id]++)
-            : 0
-            ;
-        }
+  noggit::shadow_bits const* shadow_bits = shadow ? &shadow->data : nullptr;
+  std::array<std::uint8_t const*, 3> alpha_ptr = {nullptr, nullptr, nullptr};
 
-        amap[i * 4 + 3] = use_shadow ? ((shadow->data[i / 64] >> (i % 64)) & 1) * 255 : 0;
-      }
-
-      gl.texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, chunk_x + 16 * chunk_y, 64, 64, 1, GL_RGBA, GL_UNSIGNED_BYTE, amap.data());
+  if (preview_data)
+  {
+    for (int i = 0; i < preview_data->texture_count - 1; ++i)
+    {
+      alpha_ptr[i] = preview_data->alphamaps[i].getAlpha();
     }
-    else if (nTextures)
+  }
+  else if (!nTextures)
+  {
+    return {};
+  }
+  else if (tmp_edit_values)
+  {
+    noggit::pack_alpha_shadow_map(texels, *tmp_edit_values.get(), shadow_bits);
+    return changed;
+  }
+  else
+  {
+    for (int i = 0; i < nTextures - 1; ++i)
     {
-      if (_first_amap_setup)
-      {
-        gl.texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, chunk_x + 16 * chunk_y, 64, 64, 1, GL_RGBA, GL_UNSIGNED_BYTE, _setup_amap_data->data());
-        _first_amap_setup = false;
-        _setup_amap_data.reset();
-      }
-      else if (tmp_edit_values)
-      {
-        std::vector<float> amap(4 * 64 * 64);
-        auto& tmp_amaps = *tmp_edit_values.get();
-
-        for (int i = 0; i < 64 * 64; ++i)
-        {
-          for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
-          {
-            amap[i * 4 + alpha_id] = tmp_amaps[alpha_id + 1][i] / 255.f;
-          }
-
-          amap[i * 4 + 3] = use_shadow ? (shadow->data[i / 64] >> (i % 64)) & 1 : 0;
-        }
-
-        gl.texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, chunk_x + 16 * chunk_y, 64, 64, 1, GL_RGBA, GL_FLOAT, amap.data());
-      }
-      else
-      {
-        std::vector<uint8_t> amap(4 * 64 * 64);
-        uint8_t const* alpha_ptr[3];
-
-        for (int i = 0; i < nTextures - 1; ++i)
-        {
-          alpha_ptr[i] = alphamaps[i]->getAlpha();
-        }
-
-        for (int i = 0; i < 64 * 64; ++i)
-        {
-          for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
-          {
-            amap[i * 4 + alpha_id] = (alpha_id < nTextures - 1)
-              ? *(alpha_ptr[alpha_id]++)
-              : 0
-              ;
-          }
-
-          amap[i * 4 + 3] = use_shadow ? ((shadow->data[i / 64] >> (i % 64)) & 1) * 255 : 0;
-        }
-
-        gl.texSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, chunk_x + 16 * chunk_y, 64, 64, 1, GL_RGBA, GL_UNSIGNED_BYTE, amap.data());
-      }
+      alpha_ptr[i] = alphamaps[i]->getAlpha();
     }
-
-    _need_amap_update = false;
   }
+
+  noggit::pack_alpha_shadow_map(texels, alpha_ptr, shadow_bits);
+  return changed;
 }
 
 std::array<std::uint8_t, 256 * 256> TextureSet::alpha_convertion_lookup = TextureSet::make_alpha_lookup_array();
 
 void TextureSet::require_update()
 {
-  _need_amap_update = true;
+  _amap_changed = noggit::texel_rect::whole();
   _need_lod_texture_map_update = true;
-  // only used when first setting up the alphamap with pre computed value
-  // from the async loading, need to be cleared for adt using the 1x1 alphamap
-  // as they never have to setup the alphamap from the texture set
-  _first_amap_setup = false;
 }
@@ -3,9 +3,11 @@
 #pragma once
 
 #include <noggit/MPQ.h>
+#include <noggit/alpha_painting.hpp>
 #include <noggit/alphamap.hpp>
 #include <noggit/map_chunk_headers.hpp>
 #include <noggit/MapHeaders.h>
+#include <noggit/tile_dirty_set.hpp>
 
 #include <cstdint>
 #include <array>
@@ -13,18 +15,6 @@
 class Brush;
 class MapTile;
 
-struct tmp_edit_alpha_values
-{
-  using alpha_layer = std::array<float, 64 * 64>;
-  // use 4 "alphamaps" for an easier editing
-  std::array<alpha_layer, 4> map;
-
-  alpha_layer& operator[](std::size_t i)
-  {
-    return map.at(i);
-  }
-};
-
 class TextureSet
 {
 public:
@@ -36,7 +26,9 @@ class TextureSet
             , bool use_big_alphamaps
             , bool do_not_fix_alpha_map
             , bool do_not_convert_alphamaps
-            , chunk_shadow* shadow
+              //! the layers' alphamaps as they are after loading, from a
+              //! tile_cache, instead of reading MCAL
+            , std::array<std::uint8_t const*, 3> const* cached_alphamaps = nullptr
             );
 
   void copy_data(noggit::chunk_data& data);
@@ -86,9 +78,17 @@ class TextureSet
   size_t nTextures;
   std::unique_ptr<tmp_edit_alpha_values> tmp_edit_values;
 
-  void update_alpha_shadow_map_if_needed(int chunk_x, int chunk_y, chunk_shadow* shadow, noggit::chunk_data* preview_data);
+  //! the rgba8 texels of the chunk in the tile's alpha/shadow texture, if
+  //! they changed since the last time. Returns the ones that changed,
+  //! nothing if none did.
+  noggit::texel_rect pack_alpha_shadow_map_if_needed(std::uint8_t* texels, chunk_shadow const* shadow, noggit::chunk_data* preview_data);
 
   std::string const& texture(int id) const { return _textures[id]; }
+  //! the alphamap of a layer but the first, nullptr if it has none
+  std::uint8_t const* alphamap(std::size_t layer) const
+  {
+    return alphamaps[layer - 1] ? alphamaps[layer - 1]->getAlpha() : nullptr;
+  }
 
   void require_update();
 
@@ -105,11 +105,8 @@ class TextureSet
   std::vector<std::string> _textures;
   std::array<std::unique_ptr<Alphamap>, 3> alphamaps;
 
-  // used on loading to prepare the alphamap data to upload in the async loader
-  std::unique_ptr<std::array<std::uint8_t, 4 * 64 * 64>> _setup_amap_data;
-  bool _first_amap_setup = false;
-
-  bool _need_amap_update = true;
+  //! painting only changes the texels around the brush
+  noggit::texel_rect _amap_changed = noggit::texel_rect::whole();
 
   std::vector<uint8_t> _lod_texture_map;
   bool _need_lod_texture_map_update = false;
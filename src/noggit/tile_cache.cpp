@@ -0,0 +1,279 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/mapped_file.hpp>
+#include <noggit/tile_cache.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace noggit
+{
+  namespace tile_cache
+  {
+    namespace
+    {
+      char const magic[8] = {'N', 'O', 'G', 'G', 'I', 'T', 'T', 'C'};
+
+      static_assert (sizeof (vertex) == 9 * sizeof (float), "vertices are written as they are in memory");
+
+      std::uint64_t rotate_left (std::uint64_t value, int bits)
+      {
+        return (value << bits) | (value >> (64 - bits));
+      }
+
+      // murmur3's finalizer
+      std::uint64_t mix (std::uint64_t value)
+      {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+      }
+
+      struct reader
+      {
+        char const* data;
+        std::size_t size;
+        std::size_t position = 0;
+        bool failed = false;
+
+        template<typename T>
+          T read()
+        {
+          T value {};
+          if (!failed && size - position >= sizeof (T))
+          {
+            std::memcpy (&value, data + position, sizeof (T));
+            position += sizeof (T);
+          }
+          else
+          {
+            failed = true;
+          }
+          return value;
+        }
+
+        char const* skip (std::size_t count)
+        {
+          if (failed || size - position < count)
+          {
+            failed = true;
+            return nullptr;
+          }
+          char const* const start (data + position);
+          position += count;
+          return start;
+        }
+      };
+
+      template<typename T>
+        void write_value (std::ostream& output, T const& value)
+      {
+        output.write (reinterpret_cast<char const*> (&value), sizeof (T));
+      }
+
+      void write_names (std::ostream& output, std::vector<std::string> const& names)
+      {
+        write_value (output, static_cast<std::uint32_t> (names.size()));
+        for (std::string const& name : names)
+        {
+          write_value (output, static_cast<std::uint16_t> (name.size()));
+          output.write (name.data(), name.size());
+        }
+      }
+
+      std::vector<std::string> read_names (reader& input)
+      {
+        std::vector<std::string> names;
+        std::uint32_t const count (input.read<std::uint32_t>());
+        for (std::uint32_t i (0); i < count && !input.failed; ++i)
+        {
+          std::uint16_t const length (input.read<std::uint16_t>());
+          char const* const name (input.skip (length));
+          if (name)
+          {
+            names.emplace_back (name, length);
+          }
+        }
+        return names;
+      }
+    }
+
+    source identify (char const* adt, std::size_t size, bool big_alpha)
+    {
+      std::uint64_t const m1 (0x87c37b91114253d5ull);
+      std::uint64_t const m2 (0x4cf5ad432745937full);
+
+      std::uint64_t hash (size * m2);
+      std::size_t const words (size / sizeof (std::uint64_t));
+
+      for (std::size_t i (0); i < words; ++i)
+      {
+        std::uint64_t word;
+        std::memcpy (&word, adt + i * sizeof (std::uint64_t), sizeof (std::uint64_t));
+        hash ^= rotate_left (word * m1, 31) * m2;
+        hash = rotate_left (hash, 27) * 5 + 0x52dce729;
+      }
+
+      std::uint64_t tail (0);
+      std::memcpy (&tail, adt + words * sizeof (std::uint64_t), size % sizeof (std::uint64_t));
+      hash ^= rotate_left (tail * m1, 31) * m2;
+
+      return {mix (hash), size, big_alpha};
+    }
+
+    bool write (boost::filesystem::path const& cache_file, source const& adt, tile_contents const& tile)
+    {
+      for (auto const* names : {&tile.textures, &tile.models, &tile.objects})
+      {
+        for (std::string const& name : *names)
+        {
+          if (name.size() > std::numeric_limits<std::uint16_t>::max())
+          {
+            return false;
+          }
+        }
+      }
+
+      boost::system::error_code ec;
+      boost::filesystem::create_directories (cache_file.parent_path(), ec);
+      if (ec)
+      {
+        return false;
+      }
+
+      // tiles can be reopened before the write of their last cache is done
+      boost::filesystem::path const temporary
+        (boost::filesystem::unique_path (cache_file.string() + ".%%%%-%%%%.tmp", ec));
+      if (ec)
+      {
+        return false;
+      }
+
+      {
+        std::ofstream output (temporary.string(), std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        if (!output.is_open())
+        {
+          return false;
+        }
+
+        output.write (magic, sizeof (magic));
+        write_value (output, format_version);
+        write_value (output, adt.hash);
+        write_value (output, adt.size);
+        write_value (output, static_cast<std::uint8_t> (adt.big_alpha));
+
+        write_names (output, tile.textures);
+        write_names (output, tile.models);
+        write_names (output, tile.objects);
+
+        write_value (output, static_cast<std::uint32_t> (tile.chunks.size()));
+        for (chunk_contents const& chunk : tile.chunks)
+        {
+          std::uint8_t layers (0);
+          for (std::size_t i (0); i < chunk.alphamaps.size(); ++i)
+          {
+            if (chunk.alphamaps[i].size() == alphamap_size)
+            {
+              layers |= 1 << i;
+            }
+          }
+
+          write_value (output, chunk.min_height);
+          write_value (output, chunk.max_height);
+          write_value (output, layers);
+          output.write (reinterpret_cast<char const*> (chunk.vertices.data()), vertex_count * sizeof (vertex));
+
+          for (std::size_t i (0); i < chunk.alphamaps.size(); ++i)
+          {
+            if (layers & (1 << i))
+            {
+              output.write (reinterpret_cast<char const*> (chunk.alphamaps[i].data()), alphamap_size);
+            }
+          }
+        }
+
+        if (!output)
+        {
+          output.close();
+          boost::filesystem::remove (temporary, ec);
+          return false;
+        }
+      }
+
+      boost::filesystem::rename (temporary, cache_file, ec);
+      if (ec)
+      {
+        boost::filesystem::remove (temporary, ec);
+        return false;
+      }
+      return true;
+    }
+
+    boost::optional<cached_tile> cached_tile::open (boost::filesystem::path const& cache_file, source const& adt)
+    {
+      auto contents (read_file_contents (cache_file));
+      if (!contents)
+      {
+        return boost::none;
+      }
+
+      reader input {contents->data.get(), contents->size};
+
+      char const* const file_magic (input.skip (sizeof (magic)));
+      if (!file_magic || !std::equal (magic, magic + sizeof (magic), file_magic))
+      {
+        return boost::none;
+      }
+      if (input.read<std::uint32_t>() != format_version)
+      {
+        return boost::none;
+      }
+
+      std::uint64_t const hash (input.read<std::uint64_t>());
+      std::uint64_t const size (input.read<std::uint64_t>());
+      bool const big_alpha (input.read<std::uint8_t>() != 0);
+      if (input.failed || hash != adt.hash || size != adt.size || big_alpha != adt.big_alpha)
+      {
+        return boost::none;
+      }
+
+      cached_tile tile;
+      tile._textures = read_names (input);
+      tile._models = read_names (input);
+      tile._objects = read_names (input);
+
+      std::uint32_t const chunk_count (input.read<std::uint32_t>());
+      for (std::uint32_t i (0); i < chunk_count && !input.failed; ++i)
+      {
+        cached_chunk chunk;
+        chunk.min_height = input.read<float>();
+        chunk.max_height = input.read<float>();
+        std::uint8_t const layers (input.read<std::uint8_t>());
+        chunk.vertices = input.skip (vertex_count * sizeof (vertex));
+
+        for (std::size_t layer (0); layer < chunk.alphamaps.size(); ++layer)
+        {
+          chunk.alphamaps[layer] = layers & (1 << layer)
+            ? reinterpret_cast<std::uint8_t const*> (input.skip (alphamap_size))
+            : nullptr;
+        }
+
+        tile._chunks.push_back (chunk);
+      }
+
+      if (input.failed || input.position != input.size)
+      {
+        return boost::none;
+      }
+
+      tile._data = std::move (contents->data);
+      return tile;
+    }
+  }
+}
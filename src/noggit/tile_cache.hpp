@@ -0,0 +1,116 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  //! What loading an ADT decodes, kept in a file of its own so that
+  //! reopening the tile can skip the decoding: the vertices of the
+  //! chunks, their alphamaps as the editor uses them and the normalized
+  //! texture and model names. A cache is only used for the exact ADT it
+  //! was written for, as told by a hash of the ADT's bytes, and is laid
+  //! out to be mapped and used in place. Liquids and everything else
+  //! that is cheap to read still come from the ADT.
+  namespace tile_cache
+  {
+    constexpr std::uint32_t const format_version = 1;
+    constexpr std::size_t const vertex_count = 9 * 9 + 8 * 8;
+    constexpr std::size_t const alphamap_size = 64 * 64;
+
+    //! laid out like chunk_vertex
+    struct vertex
+    {
+      math::vector_3d position;
+      math::vector_3d normal;
+      math::vector_3d color;
+    };
+
+    //! The ADT a cache belongs to.
+    struct source
+    {
+      std::uint64_t hash;
+      std::uint64_t size;
+      //! the alphamaps are cached converted for the tile's format
+      bool big_alpha;
+    };
+
+    source identify (char const* adt, std::size_t size, bool big_alpha);
+
+    struct chunk_contents
+    {
+      std::array<vertex, vertex_count> vertices;
+      float min_height;
+      float max_height;
+      //! one per layer but the first, empty for layers without one
+      std::array<std::vector<std::uint8_t>, 3> alphamaps;
+    };
+
+    struct tile_contents
+    {
+      std::vector<std::string> textures;
+      std::vector<std::string> models;
+      std::vector<std::string> objects;
+      //! in the order of the ADT's MCIN
+      std::vector<chunk_contents> chunks;
+    };
+
+    //! Goes through a temporary file so that a crash never leaves a
+    //! half written cache behind. Creates the directories on the way.
+    bool write (boost::filesystem::path const& cache_file, source const&, tile_contents const&);
+
+    //! A chunk in a mapped cache, valid as long as the cached_tile is.
+    struct cached_chunk
+    {
+      //! vertex_count vertices laid out like vertex
+      char const* vertices;
+      float min_height;
+      float max_height;
+      //! one per layer but the first, nullptr for layers without one
+      std::array<std::uint8_t const*, 3> alphamaps;
+
+      template<typename Vertex>
+        void copy_vertices (Vertex* out) const
+      {
+        static_assert (sizeof (Vertex) == sizeof (vertex), "vertices have to be laid out like tile_cache::vertex");
+        std::memcpy (out, vertices, vertex_count * sizeof (vertex));
+      }
+    };
+
+    class cached_tile
+    {
+    public:
+      //! boost::none if there is no cache at \a cache_file, it is
+      //! damaged, of another format version or for another ADT
+      static boost::optional<cached_tile> open (boost::filesystem::path const& cache_file, source const&);
+
+      std::vector<std::string> const& textures() const { return _textures; }
+      std::vector<std::string> const& models() const { return _models; }
+      std::vector<std::string> const& objects() const { return _objects; }
+
+      std::size_t chunk_count() const { return _chunks.size(); }
+      cached_chunk const& chunk (std::size_t index) const { return _chunks[index]; }
+
+    private:
+      cached_tile() = default;
+
+      std::shared_ptr<char const> _data;
+      std::vector<std::string> _textures;
+      std::vector<std::string> _models;
+      std::vector<std::string> _objects;
+      std::vector<cached_chunk> _chunks;
+    };
+  }
+}
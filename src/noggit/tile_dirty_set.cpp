@@ -0,0 +1,172 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/tile_dirty_set.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace noggit
+{
+  void vertex_range::add (std::size_t vertex)
+  {
+    merge ({vertex, vertex + 1});
+  }
+
+  void vertex_range::merge (vertex_range const& other)
+  {
+    if (other.empty())
+    {
+      return;
+    }
+    if (empty())
+    {
+      *this = other;
+      return;
+    }
+
+    first = std::min (first, other.first);
+    last = std::max (last, other.last);
+  }
+
+  void texel_rect::merge (texel_rect const& other)
+  {
+    if (other.empty())
+    {
+      return;
+    }
+    if (empty())
+    {
+      *this = other;
+      return;
+    }
+
+    x0 = std::min (x0, other.x0);
+    y0 = std::min (y0, other.y0);
+    x1 = std::max (x1, other.x1);
+    y1 = std::max (y1, other.y1);
+  }
+
+  namespace
+  {
+    // [begin, end) of the texels of a row within radius of point
+    std::pair<int, int> texel_span (float base, float point, float radius)
+    {
+      auto const clamp
+        ([] (float texel) { return static_cast<int> (std::max (0.f, std::min (float (texel_rect::side), texel))); });
+
+      return { clamp (std::floor ((point - radius - base) / TEXDETAILSIZE) - 1.f)
+             , clamp (std::floor ((point + radius - base) / TEXDETAILSIZE) + 2.f)
+             };
+    }
+  }
+
+  texel_rect texels_in_range (float xbase, float zbase, float x, float z, float radius)
+  {
+    auto const columns (texel_span (xbase, x, radius));
+    auto const rows (texel_span (zbase, z, radius));
+
+    return {columns.first, rows.first, columns.second, rows.second};
+  }
+
+  void tile_dirty_set::mark (std::size_t chunk)
+  {
+    _chunks[chunk / 64].fetch_or (std::uint64_t (1) << (chunk % 64));
+  }
+
+  void tile_dirty_set::mark_all()
+  {
+    for (auto& word : _chunks)
+    {
+      word = ~std::uint64_t (0);
+    }
+  }
+
+  void tile_dirty_set::mark_vertices (std::size_t chunk, vertex_range const& vertices)
+  {
+    {
+      std::lock_guard<std::mutex> const lock (_vertices_mutex);
+      _vertices[chunk].merge (vertices);
+    }
+
+    mark (chunk);
+  }
+
+  bool tile_dirty_set::empty() const
+  {
+    return std::all_of ( _chunks.begin(), _chunks.end()
+                       , [] (std::atomic<std::uint64_t> const& word) { return !word; }
+                       );
+  }
+
+  void tile_dirty_set::drain (std::function<void (std::size_t, vertex_range const&)> const& fun)
+  {
+    for (std::size_t w (0); w < _chunks.size(); ++w)
+    {
+      std::uint64_t word (_chunks[w].exchange (0));
+
+      while (word)
+      {
+        std::size_t bit (0);
+        while (!(word & (std::uint64_t (1) << bit)))
+        {
+          ++bit;
+        }
+        word &= ~(std::uint64_t (1) << bit);
+
+        std::size_t const chunk (w * 64 + bit);
+        vertex_range vertices;
+
+        {
+          std::lock_guard<std::mutex> const lock (_vertices_mutex);
+          std::swap (vertices, _vertices[chunk]);
+        }
+
+        fun (chunk, vertices);
+      }
+    }
+  }
+
+  void upload_vertices ( tile_upload_functions const& upload
+                       , upload_counters& counters
+                       , std::size_t first_vertex
+                       , vertex_range const& vertices
+                       , std::size_t vertex_size
+                       , void const* data
+                       )
+  {
+    if (vertices.empty())
+    {
+      return;
+    }
+
+    std::size_t const size (vertices.size() * vertex_size);
+
+    upload.vertices ( (first_vertex + vertices.first) * vertex_size
+                    , size
+                    , static_cast<char const*> (data) + vertices.first * vertex_size
+                    );
+
+    ++counters.calls;
+    counters.bytes += size;
+  }
+
+  void upload_alpha_shadow_map ( tile_upload_functions const& upload
+                               , upload_counters& counters
+                               , int layer
+                               , texel_rect const& rect
+                               , std::uint8_t const* texels
+                               )
+  {
+    if (rect.empty())
+    {
+      return;
+    }
+
+    upload.alpha_shadow_map (rect, layer, texels + (rect.y0 * texel_rect::side + rect.x0) * 4);
+
+    ++counters.calls;
+    counters.bytes += rect.width() * rect.height() * 4;
+  }
+}
@@ -0,0 +1,120 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace noggit
+{
+  //! The vertices [first, last) of a chunk.
+  struct vertex_range
+  {
+    static constexpr std::size_t chunk_vertices = 145;
+
+    static vertex_range whole() { return {0, chunk_vertices}; }
+
+    bool empty() const { return first >= last; }
+    std::size_t size() const { return empty() ? 0 : last - first; }
+
+    //! grow to contain \a vertex
+    void add (std::size_t vertex);
+    //! grow to contain \a other, the vertices in between included
+    void merge (vertex_range const& other);
+
+    std::size_t first = 0;
+    std::size_t last = 0;
+  };
+
+  //! The texels [x0, x1) x [y0, y1) of a chunk's 64x64 layer of the
+  //! tile's alpha/shadow texture.
+  struct texel_rect
+  {
+    static constexpr int side = 64;
+
+    static texel_rect whole() { return {0, 0, side, side}; }
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+    bool is_whole() const { return x0 <= 0 && y0 <= 0 && x1 >= side && y1 >= side; }
+    int width() const { return empty() ? 0 : x1 - x0; }
+    int height() const { return empty() ? 0 : y1 - y0; }
+
+    //! grow to contain \a other
+    void merge (texel_rect const& other);
+
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+  };
+
+  //! The texels of the chunk at \a xbase, \a zbase a brush of \a radius
+  //! around (x, z) can reach, with one more on each side for rounding.
+  texel_rect texels_in_range (float xbase, float zbase, float x, float z, float radius);
+
+  //! The chunks of a tile edited since the renderer last looked, and the
+  //! vertices edited in each. Edits mark it, possibly from several
+  //! threads at once, and MapTile::draw drains it to upload only those.
+  class tile_dirty_set
+  {
+  public:
+    static constexpr std::size_t chunk_count = 256;
+
+    //! \a chunk has to be prepared again, without any vertex to upload
+    void mark (std::size_t chunk);
+    void mark_all();
+    void mark_vertices (std::size_t chunk, vertex_range const& vertices);
+
+    bool empty() const;
+
+    //! fun (chunk, vertices) for every chunk marked since the last time,
+    //! in order, which are then no longer marked
+    void drain (std::function<void (std::size_t, vertex_range const&)> const& fun);
+
+  private:
+    std::array<std::atomic<std::uint64_t>, chunk_count / 64> _chunks = {{{0}, {0}, {0}, {0}}};
+
+    std::mutex _vertices_mutex;
+    std::array<vertex_range, chunk_count> _vertices;
+  };
+
+  struct upload_counters
+  {
+    std::size_t calls = 0;
+    std::size_t bytes = 0;
+  };
+
+  //! What actually uploads a tile's data to the gpu, so that what would
+  //! be uploaded can be looked at without a context.
+  struct tile_upload_functions
+  {
+    //! \a size bytes at \a offset into the tile's vertex buffer
+    std::function<void (std::size_t offset, std::size_t size, void const* data)> vertices;
+    //! the texels of \a rect in \a layer of the alpha/shadow texture,
+    //! rgba8, \a texels pointing to the first one and the rows
+    //! texel_rect::side texels apart
+    std::function<void (texel_rect const& rect, int layer, std::uint8_t const* texels)> alpha_shadow_map;
+  };
+
+  //! the \a vertices of the chunk whose first vertex is \a first_vertex
+  //! in the tile's vertex buffer, \a data being all of the chunk's
+  void upload_vertices ( tile_upload_functions const& upload
+                       , upload_counters& counters
+                       , std::size_t first_vertex
+                       , vertex_range const& vertices
+                       , std::size_t vertex_size
+                       , void const* data
+                       );
+
+  //! \a rect of \a texels, a whole 64x64 rgba8 layer
+  void upload_alpha_shadow_map ( tile_upload_functions const& upload
+                               , upload_counters& counters
+                               , int layer
+                               , texel_rect const& rect
+                               , std::uint8_t const* texels
+                               );
+}
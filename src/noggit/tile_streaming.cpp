@@ -0,0 +1,304 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/tile_streaming.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace noggit
+{
+  namespace
+  {
+    // how quickly the estimated velocity follows the camera, in seconds
+    float const velocity_smoothing = 0.3f;
+    // moving further than this in one update is a teleport, not a flight
+    float const teleport_distance = 2.f * TILESIZE;
+
+    math::vector_3d flat (math::vector_3d v)
+    {
+      v.y = 0.f;
+      return v;
+    }
+
+    int tile_of (float position)
+    {
+      return static_cast<int> (std::floor (position / TILESIZE));
+    }
+  }
+
+  tile_streaming::tile_streaming (tile_store& store, settings s)
+    : _store (store)
+    , _settings (std::move (s))
+  {}
+
+  void tile_streaming::change_settings (settings s)
+  {
+    _settings = std::move (s);
+  }
+
+  void tile_streaming::reset_motion()
+  {
+    _has_position = false;
+    _velocity = {0.f, 0.f, 0.f};
+  }
+
+  std::size_t tile_streaming::pending_loads() const
+  {
+    return std::count_if ( _tiles.begin(), _tiles.end()
+                         , [] (tile_state const& s) { return s.pending; }
+                         );
+  }
+
+  bool tile_streaming::load_pending (tile_index const& tile) const
+  {
+    return tile.is_valid() && state (tile).pending;
+  }
+
+  void tile_streaming::update ( math::vector_3d const& position
+                              , math::vector_3d const& direction
+                              , float half_fov
+                              , float dt
+                              )
+  {
+    _time += dt;
+
+    if (_has_position && dt > 0.f)
+    {
+      math::vector_3d const moved (flat (position - _last_position));
+
+      if (moved.length() > teleport_distance)
+      {
+        _velocity = {0.f, 0.f, 0.f};
+      }
+      else
+      {
+        float const weight (std::min (1.f, dt / velocity_smoothing));
+        _velocity = _velocity + (moved * (1.f / dt) - _velocity) * weight;
+      }
+    }
+    _last_position = position;
+    _has_position = true;
+
+    collect_wanted (position, direction, half_fov);
+    refresh_residency();
+
+    for (wanted_tile const& wanted : _wanted)
+    {
+      state (wanted.index).last_wanted = _time;
+    }
+
+    cancel_stale_loads();
+    start_loads();
+    evict();
+  }
+
+  void tile_streaming::collect_wanted ( math::vector_3d const& position
+                                      , math::vector_3d const& direction
+                                      , float half_fov
+                                      )
+  {
+    _wanted.clear();
+
+    int const camera_x (tile_of (position.x));
+    int const camera_z (tile_of (position.z));
+    int const radius (_settings.loading_radius + _settings.max_lookahead_tiles);
+    float const max_gap (_settings.max_lookahead_tiles * TILESIZE);
+
+    math::vector_3d const velocity (flat (_velocity));
+    bool const moving (velocity.length() > 0.f && _settings.lookahead > 0.f);
+    math::vector_3d view_direction (flat (direction));
+    bool const has_view (view_direction.length() > 0.f);
+    if (has_view)
+    {
+      view_direction.normalize();
+    }
+
+    for (int z (std::max (0, camera_z - radius)); z <= std::min (63, camera_z + radius); ++z)
+    {
+      for (int x (std::max (0, camera_x - radius)); x <= std::min (63, camera_x + radius); ++x)
+      {
+        tile_index const tile (x, z);
+        if (!_store.has_tile (tile) || state (tile).unavailable)
+        {
+          continue;
+        }
+
+        int const rings (std::max (std::abs (x - camera_x), std::abs (z - camera_z)));
+        if (rings <= _settings.loading_radius)
+        {
+          _wanted.push_back ({tile, static_cast<float> (rings - _settings.loading_radius - 1)});
+          continue;
+        }
+
+        if (!moving)
+        {
+          continue;
+        }
+
+        math::vector_3d const nearest
+          ( std::min (std::max (position.x, x * TILESIZE), (x + 1) * TILESIZE)
+          , 0.f
+          , std::min (std::max (position.z, z * TILESIZE), (z + 1) * TILESIZE)
+          );
+        float const gap (flat (nearest - position).length());
+        if (gap > max_gap)
+        {
+          continue;
+        }
+
+        math::vector_3d const to_center
+          (flat (math::vector_3d ((x + 0.5f) * TILESIZE, 0.f, (z + 0.5f) * TILESIZE) - position));
+        float const distance (to_center.length());
+        math::vector_3d const heading (to_center * (1.f / distance));
+
+        float toward (velocity * heading);
+
+        // tiles outside of the view are wanted later, the camera usually
+        // turns before it flies there
+        if (has_view)
+        {
+          float const angle (std::acos (std::min (1.f, std::max (-1.f, view_direction * heading))));
+          float const tile_angle (std::atan2 (0.71f * TILESIZE, distance));
+          if (angle > half_fov + tile_angle)
+          {
+            toward *= 0.5f;
+          }
+        }
+
+        if (toward <= 0.f)
+        {
+          continue;
+        }
+
+        float const eta (gap / toward);
+        if (eta <= _settings.lookahead)
+        {
+          _wanted.push_back ({tile, eta});
+        }
+      }
+    }
+
+    std::stable_sort ( _wanted.begin(), _wanted.end()
+                     , [] (wanted_tile const& lhs, wanted_tile const& rhs)
+                       {
+                         return lhs.eta < rhs.eta;
+                       }
+                     );
+  }
+
+  void tile_streaming::refresh_residency()
+  {
+    for (std::size_t z (0); z < 64; ++z)
+    {
+      for (std::size_t x (0); x < 64; ++x)
+      {
+        tile_index const tile (x, z);
+        tile_state& s (state (tile));
+        bool const loaded (_store.tile_loaded (tile));
+
+        if (loaded && !s.resident)
+        {
+          s.resident = true;
+          s.pending = false;
+          s.bytes = _store.tile_memory_usage (tile);
+          s.last_wanted = _time;
+          _resident_bytes += s.bytes;
+        }
+        else if (!loaded && s.resident)
+        {
+          s.resident = false;
+          _resident_bytes -= s.bytes;
+          s.bytes = 0;
+        }
+      }
+    }
+  }
+
+  void tile_streaming::cancel_stale_loads()
+  {
+    for (std::size_t z (0); z < 64; ++z)
+    {
+      for (std::size_t x (0); x < 64; ++x)
+      {
+        tile_index const tile (x, z);
+        tile_state& s (state (tile));
+
+        if (s.pending && s.last_wanted < _time && _store.cancel_tile_load (tile))
+        {
+          s.pending = false;
+        }
+      }
+    }
+  }
+
+  void tile_streaming::start_loads()
+  {
+    std::size_t pending (pending_loads());
+
+    for (wanted_tile const& wanted : _wanted)
+    {
+      tile_state& s (state (wanted.index));
+      if (s.resident || s.pending)
+      {
+        continue;
+      }
+
+      // the tiles around the camera come first and are never held back
+      if (wanted.eta >= 0.f && pending >= _settings.max_pending_loads)
+      {
+        break;
+      }
+
+      if (!_store.load_tile (wanted.index))
+      {
+        s.unavailable = true;
+        continue;
+      }
+      s.pending = true;
+      ++pending;
+    }
+  }
+
+  void tile_streaming::evict()
+  {
+    if (_resident_bytes <= _settings.memory_budget)
+    {
+      return;
+    }
+
+    std::vector<tile_index> candidates;
+    for (std::size_t z (0); z < 64; ++z)
+    {
+      for (std::size_t x (0); x < 64; ++x)
+      {
+        tile_index const tile (x, z);
+        tile_state const& s (state (tile));
+        if (s.resident && s.last_wanted < _time && _store.can_unload_tile (tile))
+        {
+          candidates.push_back (tile);
+        }
+      }
+    }
+
+    std::sort ( candidates.begin(), candidates.end()
+              , [this] (tile_index const& lhs, tile_index const& rhs)
+                {
+                  return state (lhs).last_wanted < state (rhs).last_wanted;
+                }
+              );
+
+    for (tile_index const& tile : candidates)
+    {
+      if (_resident_bytes <= _settings.memory_budget)
+      {
+        break;
+      }
+
+      tile_state& s (state (tile));
+      _store.unload_tile (tile);
+      s.resident = false;
+      _resident_bytes -= s.bytes;
+      s.bytes = 0;
+    }
+  }
+}
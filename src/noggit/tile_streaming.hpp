@@ -0,0 +1,128 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/vector_3d.hpp>
+#include <noggit/tile_index.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace noggit
+{
+  //! What tile_streaming needs from the map, MapIndex in the editor.
+  class tile_store
+  {
+  public:
+    virtual ~tile_store() = default;
+
+    virtual bool has_tile (tile_index const&) const = 0;
+    //! loaded and done loading, whoever asked for it
+    virtual bool tile_loaded (tile_index const&) const = 0;
+    //! False if it can't be loaded, it isn't asked for again then.
+    virtual bool load_tile (tile_index const&) = 0;
+    //! Drop a load that did not start yet. False if it already started,
+    //! the tile is left to finish loading then.
+    virtual bool cancel_tile_load (tile_index const&) = 0;
+    virtual void unload_tile (tile_index const&) = 0;
+    //! false for tiles with unsaved changes
+    virtual bool can_unload_tile (tile_index const&) const = 0;
+    //! estimated bytes a loaded tile takes, cpu and gpu
+    virtual std::size_t tile_memory_usage (tile_index const&) const = 0;
+  };
+
+  //! Decides which tiles to load and unload as the camera moves. The
+  //! tiles within loading_radius of the camera's tile are always loaded.
+  //! Beyond those, tiles the camera heads for are loaded ahead in the
+  //! order it is expected to reach them, judging by its velocity and
+  //! favoring the ones in view. Queued loads of tiles nobody wants any
+  //! more are cancelled. Tiles are unloaded once the loaded ones take
+  //! more than the memory budget, least recently wanted first. Wanted
+  //! tiles and unsaved ones are kept even if that exceeds the budget.
+  class tile_streaming
+  {
+  public:
+    struct settings
+    {
+      //! tiles around the camera's one that are always loaded
+      int loading_radius = 1;
+      //! load the tiles the camera reaches within that many seconds
+      float lookahead = 3.f;
+      //! but no more than that many tiles ahead
+      int max_lookahead_tiles = 8;
+      //! loads beyond loading_radius queued at once
+      std::size_t max_pending_loads = 4;
+      //! bytes, as estimated by tile_store::tile_memory_usage
+      std::size_t memory_budget = std::size_t (1) << 30;
+    };
+
+    tile_streaming (tile_store&, settings);
+
+    //! Once per frame, \a dt seconds after the last one. \a direction is
+    //! where the camera looks, \a half_fov half of its horizontal field
+    //! of view in radians.
+    void update ( math::vector_3d const& position
+                , math::vector_3d const& direction
+                , float half_fov
+                , float dt
+                );
+
+    //! Forget the camera's velocity, e.g. after teleporting.
+    void reset_motion();
+
+    settings const& current_settings() const { return _settings; }
+    void change_settings (settings);
+
+    //! estimated by the camera's movement, per second, y ignored
+    math::vector_3d const& velocity() const { return _velocity; }
+    std::size_t resident_bytes() const { return _resident_bytes; }
+    std::size_t pending_loads() const;
+    bool load_pending (tile_index const& tile) const;
+
+  private:
+    struct tile_state
+    {
+      bool pending = false;
+      bool resident = false;
+      bool unavailable = false;
+      //! estimated when it finished loading
+      std::size_t bytes = 0;
+      //! time it was last wanted, or finished loading
+      double last_wanted = 0.;
+    };
+
+    struct wanted_tile
+    {
+      tile_index index;
+      //! seconds until the camera is expected to reach it, negative
+      //! within the loading radius
+      float eta;
+    };
+
+    void collect_wanted ( math::vector_3d const& position
+                        , math::vector_3d const& direction
+                        , float half_fov
+                        );
+    void refresh_residency();
+    void cancel_stale_loads();
+    void start_loads();
+    void evict();
+
+    tile_state& state (tile_index const& tile) { return _tiles[tile.z * 64 + tile.x]; }
+    tile_state const& state (tile_index const& tile) const { return _tiles[tile.z * 64 + tile.x]; }
+
+    tile_store& _store;
+    settings _settings;
+
+    double _time = 0.;
+    bool _has_position = false;
+    math::vector_3d _last_position;
+    math::vector_3d _velocity;
+
+    std::array<tile_state, 64 * 64> _tiles;
+    std::size_t _resident_bytes = 0;
+    //! this update's, most urgent first
+    std::vector<wanted_tile> _wanted;
+  };
+}
@@ -0,0 +1,124 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <noggit/triangle_bvh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace noggit
+{
+  namespace
+  {
+    constexpr std::uint32_t max_triangles_per_leaf = 4;
+
+    // the slab test and the triangle test round differently: without
+    // some room, a hit right on the border of a flat node could be lost
+    constexpr float relative_padding = 1e-5f;
+  }
+
+  void triangle_bvh::grow (bounds& box, bounds const& other)
+  {
+    box.min = math::min (box.min, other.min);
+    box.max = math::max (box.max, other.max);
+  }
+
+  void triangle_bvh::build (std::vector<bounds> triangle_bounds)
+  {
+    _triangles.resize (triangle_bounds.size());
+    std::iota (_triangles.begin(), _triangles.end(), 0);
+    _nodes.clear();
+
+    if (!_triangles.empty())
+    {
+      build (triangle_bounds, 0, _triangles.size());
+      complete_bounds();
+    }
+  }
+
+  std::uint32_t triangle_bvh::build ( std::vector<bounds> const& triangle_bounds
+                                    , std::uint32_t first
+                                    , std::uint32_t count
+                                    )
+  {
+    std::uint32_t const index (_nodes.size());
+    _nodes.push_back ({triangle_bounds[_triangles[first]], first, count});
+
+    auto const begin (_triangles.begin() + first);
+    auto const end (begin + count);
+
+    if (count <= max_triangles_per_leaf)
+    {
+      for (auto it (begin + 1); it != end; ++it)
+      {
+        grow (_nodes[index].box, triangle_bounds[*it]);
+      }
+      return index;
+    }
+
+    // split in two halves along the axis the triangles spread the most
+    auto const centroid
+      ( [&] (std::uint32_t triangle)
+        {
+          return triangle_bounds[triangle].min + triangle_bounds[triangle].max;
+        }
+      );
+
+    math::vector_3d min (centroid (*begin));
+    math::vector_3d max (min);
+    for (auto it (begin + 1); it != end; ++it)
+    {
+      min = math::min (min, centroid (*it));
+      max = math::max (max, centroid (*it));
+    }
+
+    math::vector_3d const spread (max - min);
+    int const axis ( spread.x >= spread.y && spread.x >= spread.z ? 0
+                   : spread.y >= spread.z ? 1
+                   : 2
+                   );
+
+    std::uint32_t const left_count (count / 2);
+    std::nth_element ( begin, begin + left_count, end
+                     , [&] (std::uint32_t lhs, std::uint32_t rhs)
+                       {
+                         return centroid (lhs)[axis] < centroid (rhs)[axis];
+                       }
+                     );
+
+    build (triangle_bounds, first, left_count);
+    std::uint32_t const right (build (triangle_bounds, first + left_count, count - left_count));
+
+    _nodes[index].first = right;
+    _nodes[index].count = 0;
+
+    return index;
+  }
+
+  void triangle_bvh::complete_bounds()
+  {
+    // children always come after their parent
+    for (std::size_t i (_nodes.size()); i-- > 0;)
+    {
+      node& current (_nodes[i]);
+
+      if (current.count)
+      {
+        float magnitude (1.f);
+        for (int axis (0); axis < 3; ++axis)
+        {
+          magnitude = std::max ({magnitude, std::abs (current.box.min[axis]), std::abs (current.box.max[axis])});
+        }
+
+        math::vector_3d const padding (math::vector_3d (1.f, 1.f, 1.f) * (magnitude * relative_padding));
+        current.box.min = current.box.min - padding;
+        current.box.max = current.box.max + padding;
+      }
+      else
+      {
+        current.box = _nodes[i + 1].box;
+        grow (current.box, _nodes[current.first].box);
+      }
+    }
+  }
+}
@@ -0,0 +1,172 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <math/ray.hpp>
+#include <math/vector_3d.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace noggit
+{
+  //! Bounding volume hierarchy over the triangles of a mesh, so ray
+  //! picking only tests the triangles near the ray instead of all of
+  //! them. Built once per mesh; when the vertices move (animations) the
+  //! bounds are refit, keeping the tree.
+  //! Vertices are never copied: every function is given \a position,
+  //! returning the position of a vertex from its index.
+  class triangle_bvh
+  {
+  public:
+    triangle_bvh() = default;
+
+    //! \a indices: three vertices per triangle
+    template<typename Index, typename Position>
+      triangle_bvh (std::vector<Index> const& indices, Position&& position)
+    {
+      std::size_t const triangle_count (indices.size() / 3);
+
+      _indices.reserve (triangle_count * 3);
+      for (std::size_t i (0); i < triangle_count * 3; ++i)
+      {
+        _indices.push_back (indices[i]);
+      }
+
+      std::vector<bounds> triangle_bounds;
+      triangle_bounds.reserve (triangle_count);
+      for (std::size_t i (0); i < triangle_count; ++i)
+      {
+        triangle_bounds.push_back (triangle (i, position));
+      }
+
+      build (std::move (triangle_bounds));
+    }
+
+    bool empty() const { return _triangles.empty(); }
+    std::size_t triangle_count() const { return _triangles.size(); }
+
+    //! update the bounds after the vertices moved
+    template<typename Position>
+      void refit (Position&& position)
+    {
+      for (auto& node : _nodes)
+      {
+        if (node.count)
+        {
+          node.box = triangle (_triangles[node.first], position);
+
+          for (std::uint32_t i (1); i < node.count; ++i)
+          {
+            grow (node.box, triangle (_triangles[node.first + i], position));
+          }
+        }
+      }
+
+      complete_bounds();
+    }
+
+    //! calls \a hit (distance, triangle) for every triangle the ray hits,
+    //! in no particular order, triangle being its number in the indices
+    //! the tree was built with
+    template<typename Position, typename Hit>
+      void intersect (math::ray const& ray, Position&& position, Hit&& hit) const
+    {
+      if (_nodes.empty())
+      {
+        return;
+      }
+
+      std::array<std::uint32_t, max_depth> stack;
+      std::size_t stack_size (0);
+      std::uint32_t node_index (0);
+
+      while (true)
+      {
+        node const& current (_nodes[node_index]);
+
+        if (ray.intersect_bounds (current.box.min, current.box.max))
+        {
+          if (current.count)
+          {
+            for (std::uint32_t i (current.first); i < current.first + current.count; ++i)
+            {
+              std::uint32_t const triangle_index (_triangles[i]);
+
+              if ( auto distance = ray.intersect_triangle ( position (_indices[triangle_index * 3 + 0])
+                                                          , position (_indices[triangle_index * 3 + 1])
+                                                          , position (_indices[triangle_index * 3 + 2])
+                                                          )
+                 )
+              {
+                hit (*distance, triangle_index);
+              }
+            }
+          }
+          else
+          {
+            // left child follows its parent
+            stack[stack_size++] = current.first;
+            node_index = node_index + 1;
+            continue;
+          }
+        }
+
+        if (!stack_size)
+        {
+          break;
+        }
+
+        node_index = stack[--stack_size];
+      }
+    }
+
+  private:
+    struct bounds
+    {
+      math::vector_3d min;
+      math::vector_3d max;
+    };
+
+    struct node
+    {
+      bounds box;
+      //! leaf: first of _triangles, otherwise the right child
+      std::uint32_t first;
+      //! 0 for interior nodes
+      std::uint32_t count;
+    };
+
+    //! splits are balanced, so this is way more than 2^32 triangles need
+    static constexpr std::size_t max_depth = 64;
+
+    template<typename Position>
+      bounds triangle (std::size_t index, Position& position) const
+    {
+      math::vector_3d const& a (position (_indices[index * 3 + 0]));
+      math::vector_3d const& b (position (_indices[index * 3 + 1]));
+      math::vector_3d const& c (position (_indices[index * 3 + 2]));
+
+      return {math::min (a, math::min (b, c)), math::max (a, math::max (b, c))};
+    }
+
+    static void grow (bounds& box, bounds const& other);
+
+    void build (std::vector<bounds> triangle_bounds);
+    //! returns the subtree's root
+    std::uint32_t build ( std::vector<bounds> const& triangle_bounds
+                        , std::uint32_t first
+                        , std::uint32_t count
+                        );
+    //! pads the leaves' bounds and unites them up to the root
+    void complete_bounds();
+
+    std::vector<std::uint32_t> _indices;
+    //! triangle numbers, grouped by leaf
+    std::vector<std::uint32_t> _triangles;
+    //! depth first, the root first
+    std::vector<node> _nodes;
+  };
+}
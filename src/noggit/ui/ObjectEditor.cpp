@@ -241,19 +241,19 @@ namespace noggit
       connect (rotation_group, &QGroupBox::toggled, [&] (int s)
       {
         NoggitSettings.set_value ("model/random_rotation", s);
-        NoggitSettings.values->sync();
+        NoggitSettings.sync();
       });
 
       connect (tilt_group, &QGroupBox::toggled, [&] (int s)
       {
         NoggitSettings.set_value ("model/random_tilt", s);
-        NoggitSettings.values->sync();
+        NoggitSettings.sync();
       });
 
       connect (scale_group, &QGroupBox::toggled, [&] (int s)
       {
         NoggitSettings.set_value ("model/random_size", s);
-        NoggitSettings.values->sync();
+        NoggitSettings.sync();
       });
 
       rotRangeStart->setValue(paste_params->minRotation);
@@ -154,11 +154,11 @@ namespace noggit
                      );
       _view_distance->setRange (0.f, 1048576.f);
 
-      layout->addRow ( "Adt unloading distance (in adt)", _adt_unload_dist = new QSpinBox(this));
-      _adt_unload_dist->setRange(1, 64);
+      layout->addRow ("Adt memory budget (MiB)", _adt_memory_budget = new QSpinBox(this));
+      _adt_memory_budget->setRange(64, 65536);
 
-      layout->addRow ("Adt unloading check interval (sec)", _adt_unload_check_interval = new QSpinBox(this));
-      _adt_unload_check_interval->setMinimum(1);
+      layout->addRow ("Adt lookahead (sec)", _adt_lookahead = new QDoubleSpinBox(this));
+      _adt_lookahead->setRange(0., 10.);
 
       layout->addRow ("Adt loading radius", _adt_loading_radius = new QSpinBox(this));
       _adt_loading_radius->setMinimum(0);
@@ -168,6 +168,9 @@ namespace noggit
       _async_loader_thread_count->setMinimum(1);
       _async_loader_thread_count->setMaximum(16);
 
+      layout->addRow("Edit chunks on all cores", _parallel_chunk_edits = new QCheckBox(this));
+      layout->addRow("Cache decoded adts in the project", _tile_cache = new QCheckBox(this));
+
       layout->addRow ("Always check for max UID", _uid_cb = new QCheckBox(this));
 
       layout->addRow ("Tablet support", tabletModeCheck = new QCheckBox(this));
@@ -234,10 +237,12 @@ namespace noggit
       _vsync_cb->setChecked (NoggitSettings.value ("vsync", false).toBool());
       _anti_aliasing_cb->setChecked (NoggitSettings.value ("anti_aliasing", false).toBool());
       _fullscreen_cb->setChecked (NoggitSettings.value ("fullscreen", false).toBool());
-      _adt_unload_dist->setValue(NoggitSettings.value("unload_dist", 5).toInt());
-      _adt_unload_check_interval->setValue(NoggitSettings.value("unload_interval", 5).toInt());
+      _adt_memory_budget->setValue(NoggitSettings.value("tile_memory_budget", 1024).toInt());
+      _adt_lookahead->setValue(NoggitSettings.value("tile_lookahead", 3.f).toFloat());
       _adt_loading_radius->setValue(NoggitSettings.value("loading_radius", 1).toInt());
       _async_loader_thread_count->setValue(NoggitSettings.value("async_thread_count", 1).toInt());
+      _parallel_chunk_edits->setChecked(NoggitSettings.value("parallel_chunk_edits", false).toBool());
+      _tile_cache->setChecked(NoggitSettings.value("tile_cache", false).toBool());
       _uid_cb->setChecked(NoggitSettings.value("uid_startup_check", true).toBool());
       _additional_file_loading_log->setChecked(NoggitSettings.value("additional_file_loading_log", false).toBool());
       _use_mclq_liquids_export->setChecked(NoggitSettings.value("use_mclq_liquids_export", false).toBool());
@@ -274,10 +279,12 @@ namespace noggit
       NoggitSettings.set_value ("vsync", _vsync_cb->isChecked());
       NoggitSettings.set_value ("anti_aliasing", _anti_aliasing_cb->isChecked());
       NoggitSettings.set_value ("fullscreen", _fullscreen_cb->isChecked());
-      NoggitSettings.set_value ("unload_dist", _adt_unload_dist->value());
-      NoggitSettings.set_value ("unload_interval", _adt_unload_check_interval->value());
+      NoggitSettings.set_value ("tile_memory_budget", _adt_memory_budget->value());
+      NoggitSettings.set_value ("tile_lookahead", _adt_lookahead->value());
       NoggitSettings.set_value ("loading_radius", _adt_loading_radius->value());
       NoggitSettings.set_value ("async_thread_count", _async_loader_thread_count->value());
+      NoggitSettings.set_value ("parallel_chunk_edits", _parallel_chunk_edits->isChecked());
+      NoggitSettings.set_value ("tile_cache", _tile_cache->isChecked());
       NoggitSettings.set_value ("uid_startup_check", _uid_cb->isChecked());
       NoggitSettings.set_value ("additional_file_loading_log", _additional_file_loading_log->isChecked());
       NoggitSettings.set_value ("use_mclq_liquids_export", _use_mclq_liquids_export->isChecked());
@@ -43,10 +43,12 @@ namespace noggit
       util::file_line_edit* mclq_liquids_export_path;
       QDoubleSpinBox* _fov;
       QDoubleSpinBox* _view_distance;
-      QSpinBox* _adt_unload_dist;
-      QSpinBox* _adt_unload_check_interval;
+      QSpinBox* _adt_memory_budget;
+      QDoubleSpinBox* _adt_lookahead;
       QSpinBox* _adt_loading_radius;
       QSpinBox* _async_loader_thread_count;
+      QCheckBox* _parallel_chunk_edits;
+      QCheckBox* _tile_cache;
       QCheckBox* _uid_cb;
 
       QCheckBox* tabletModeCheck;
@@ -47,7 +47,24 @@ namespace noggit
             //! \note The one time Qt is const correct and we don't want that.
             auto that (const_cast<model_item*> (this));
             that->_rendered = true;
-            that->_pixmap = render_blp_to_pixmap (data (Qt::DisplayRole).toString().prepend ("tileset/").toStdString(), 256, 256);
+
+            // only the rows in view are asked for their icon, those are
+            // decoded in parallel and shown once they are done
+            QStandardItemModel* const item_model (model());
+            QPersistentModelIndex const item_index (index());
+            render_blp_to_pixmap_async
+              ( data (Qt::DisplayRole).toString().prepend ("tileset/").toStdString(), 256, 256
+              , item_model
+              , [item_model, item_index] (QPixmap const& pixmap)
+                {
+                  if (item_index.isValid())
+                  {
+                    auto item (static_cast<model_item*> (item_model->itemFromIndex (item_index)));
+                    item->_pixmap = pixmap;
+                    item->emitDataChanged();
+                  }
+                }
+              );
           }
           return QIcon(_pixmap);
         }
@@ -7,6 +7,21 @@
 
 namespace noggit
 {
+  namespace
+  {
+    math::vector_3d instance_pos(selection_type const& instance)
+    {
+      if (instance.which() == eEntry_Model)
+      {
+        return boost::get<selected_model_type>(instance)->pos;
+      }
+      else
+      {
+        return boost::get<selected_wmo_type>(instance)->pos;
+      }
+    }
+  }
+
   world_model_instances_storage::world_model_instances_storage(World* world)
     : _world(world)
   {
@@ -46,8 +61,10 @@ namespace noggit
     }
     else if(!unsafe_uid_is_used(uid))
     {
-      _m2s.emplace(uid, instance);
+      ModelInstance& stored = _m2s.emplace(uid, instance).first->second;
+      _m2_changes.emplace_back(&stored, stored.model.get());
       _instance_count_per_uid[uid] = 1;
+      unsafe_update_spatial_index(uid);
       return uid;
     }
 
@@ -93,8 +110,10 @@ namespace noggit
     }
     else if (!unsafe_uid_is_used(uid))
     {
-      _wmos.emplace(uid, instance);
+      WMOInstance& stored = _wmos.emplace(uid, instance).first->second;
+      _wmo_changes.emplace_back(&stored, stored.wmo.get());
       _instance_count_per_uid[uid] = 1;
+      unsafe_update_spatial_index(uid);
       return uid;
     }
 
@@ -107,26 +126,18 @@ namespace noggit
 
   std::vector<selection_type> world_model_instances_storage::get_instances_on_chunk(math::vector_3d const& chunk_origin)
   {
-    std::vector<selection_type> instances;
+    std::unique_lock<std::mutex> const lock (_mutex);
 
-    for (auto it = _m2s.begin(); it != _m2s.end(); ++it)
-    {
-      math::vector_3d const& inst_position = it->second.pos;
-      math::vector_3d pos_shifted = inst_position - chunk_origin;
+    std::vector<selection_type> instances;
 
-      if (misc::float_in_between(pos_shifted.x, 0.f, CHUNKSIZE) && misc::float_in_between(pos_shifted.z, 0.f, CHUNKSIZE))
-      {
-        instances.push_back(&it->second);
-      }
-    }
-    for (auto it = _wmos.begin(); it != _wmos.end(); ++it)
+    for (std::uint32_t uid : _spatial_index.in_rect(chunk_origin.x, chunk_origin.z, chunk_origin.x + CHUNKSIZE, chunk_origin.z + CHUNKSIZE))
     {
-      math::vector_3d const& inst_position = it->second.pos;
-      math::vector_3d pos_shifted = inst_position - chunk_origin;
+      auto instance = unsafe_get_instance(uid).get();
+      math::vector_3d pos_shifted = instance_pos(instance) - chunk_origin;
 
       if (misc::float_in_between(pos_shifted.x, 0.f, CHUNKSIZE) && misc::float_in_between(pos_shifted.z, 0.f, CHUNKSIZE))
       {
-        instances.push_back(&it->second);
+        instances.push_back(instance);
       }
     }
 
@@ -135,78 +146,43 @@ namespace noggit
 
   void world_model_instances_storage::delete_instances_on_chunk(math::vector_3d const& chunk_origin)
   {
-    std::vector<selection_type> instances_to_remove;
-
-    for (auto it = _m2s.begin(); it != _m2s.end(); ++it)
-    {
-      math::vector_3d const& inst_position = it->second.pos;
-      math::vector_3d pos_shifted = inst_position - chunk_origin;
-
-      if (misc::float_in_between(pos_shifted.x, 0.f, CHUNKSIZE) && misc::float_in_between(pos_shifted.z, 0.f, CHUNKSIZE))
-      {
-        instances_to_remove.push_back(&it->second);
-      }
-    }
-    for (auto it = _wmos.begin(); it != _wmos.end(); ++it)
-    {
-      math::vector_3d const& inst_position = it->second.pos;
-      math::vector_3d pos_shifted = inst_position - chunk_origin;
-
-      if (misc::float_in_between(pos_shifted.x, 0.f, CHUNKSIZE) && misc::float_in_between(pos_shifted.z, 0.f, CHUNKSIZE))
-      {
-        instances_to_remove.push_back(&it->second);
-      }
-    }
-
-    delete_instances(instances_to_remove);
+    delete_instances(get_instances_on_chunk(chunk_origin));
   }
 
   void world_model_instances_storage::delete_instances_from_chunks_in_range(math::vector_3d const& pos, float radius, bool m2s, bool wmos)
   {
     std::vector<selection_type> instances_to_remove;
 
-    math::vector_2d orig = { pos.x, pos.z };
-
-    if (m2s)
     {
-      for (auto it = _m2s.begin(); it != _m2s.end(); ++it)
+      std::unique_lock<std::mutex> const lock (_mutex);
+
+      math::vector_2d orig = { pos.x, pos.z };
+      float const max_dist = radius + MAPCHUNK_RADIUS;
+
+      for (std::uint32_t uid : _spatial_index.in_rect(pos.x - max_dist, pos.z - max_dist, pos.x + max_dist, pos.z + max_dist))
       {
-        float dist = (math::vector_2d(it->second.pos.x, it->second.pos.z) - orig).length();
+        auto instance = unsafe_get_instance(uid).get();
 
-        // in range for sure
-        if (dist < radius)
+        if (instance.which() == eEntry_Model ? !m2s : !wmos)
         {
-          instances_to_remove.push_back(&it->second);
-        }
-        // maybe in range
-        else if (dist < radius + MAPCHUNK_RADIUS)
-        {
-          MapChunk* chunk = _world->get_chunk_at(it->second.pos);
-          if (chunk && misc::getShortestDist(pos.x, pos.z, chunk->xbase, chunk->zbase, CHUNKSIZE) <= radius)
-          {
-            instances_to_remove.push_back(&it->second);
-          }
+          continue;
         }
-      }
-    }
-    if (wmos)
-    {
-      for (auto it = _wmos.begin(); it != _wmos.end(); ++it)
-      {
-        float dist = (math::vector_2d(it->second.pos.x, it->second.pos.z) - orig).length();
+
+        math::vector_3d const inst_pos = instance_pos(instance);
+        float dist = (math::vector_2d(inst_pos.x, inst_pos.z) - orig).length();
 
         // in range for sure
         if (dist < radius)
         {
-          instances_to_remove.push_back(&it->second);
+          instances_to_remove.push_back(instance);
         }
         // maybe in range
-        else if (dist < radius + MAPCHUNK_RADIUS)
+        else if (dist < max_dist)
         {
-          MapChunk* chunk = _world->get_chunk_at(it->second.pos);
+          MapChunk* chunk = _world->get_chunk_at(inst_pos);
           if (chunk && misc::getShortestDist(pos.x, pos.z, chunk->xbase, chunk->zbase, CHUNKSIZE) <= radius)
           {
-            instances_to_remove.push_back(&it->second);
+            instances_to_remove.push_back(instance);
           }
         }
       }
@@ -219,23 +195,24 @@ namespace noggit
   {
     std::vector<selection_type> instances_to_remove;
 
-    if (m2s)
     {
-      for (auto it = _m2s.begin(); it != _m2s.end(); ++it)
+      std::unique_lock<std::mutex> const lock (_mutex);
+
+      float const x = tile.x * TILESIZE;
+      float const z = tile.z * TILESIZE;
+
+      for (std::uint32_t uid : _spatial_index.in_rect(x, z, x + TILESIZE, z + TILESIZE))
       {
-        if (tile_index(it->second.pos) == tile)
+        auto instance = unsafe_get_instance(uid).get();
+
+        if (instance.which() == eEntry_Model ? !m2s : !wmos)
         {
-          instances_to_remove.push_back(&it->second);
+          continue;
         }
-      }
-    }
-    if (wmos)
-    {
-      for (auto it = _wmos.begin(); it != _wmos.end(); ++it)
-      {
-        if (tile_index(it->second.pos) == tile)
+
+        if (tile_index(instance_pos(instance)) == tile)
         {
-          instances_to_remove.push_back(&it->second);
+          instances_to_remove.push_back(instance);
         }
       }
     }
@@ -265,10 +242,30 @@ namespace noggit
   void world_model_instances_storage::delete_instance(std::uint32_t uid)
   {
     std::unique_lock<std::mutex> const lock (_mutex);
+    unsafe_erase_instance(uid);
+  }
 
+  void world_model_instances_storage::unsafe_erase_instance(std::uint32_t uid)
+  {
+    unsafe_remove_from_spatial_index(uid);
     _instance_count_per_uid.erase(uid);
-    _m2s.erase(uid);
-    _wmos.erase(uid);
+
+    auto m2_it = _m2s.find(uid);
+
+    if (m2_it != _m2s.end())
+    {
+      _m2_changes.emplace_back(&m2_it->second, nullptr);
+      _m2s.erase(m2_it);
+      return;
+    }
+
+    auto wmo_it = _wmos.find(uid);
+
+    if (wmo_it != _wmos.end())
+    {
+      _wmo_changes.emplace_back(&wmo_it->second, nullptr);
+      _wmos.erase(wmo_it);
+    }
   }
 
   void world_model_instances_storage::unload_instance_and_remove_from_selection_if_necessary(std::uint32_t uid)
@@ -284,10 +281,7 @@ namespace noggit
     if (--_instance_count_per_uid.at(uid) == 0)
     {
       _world->remove_from_selection(uid);
-
-      _instance_count_per_uid.erase(uid);
-      _m2s.erase(uid);
-      _wmos.erase(uid);
+      unsafe_erase_instance(uid);
     }
   }
 
@@ -295,9 +289,130 @@ namespace noggit
   {
     std::unique_lock<std::mutex> const lock (_mutex);
 
+    _spatial_index.clear();
+    _instances_without_extents.clear();
     _instance_count_per_uid.clear();
     _m2s.clear();
     _wmos.clear();
+    _m2_changes.clear();
+    _wmo_changes.clear();
+  }
+
+  std::vector<std::pair<ModelInstance*, Model*>> world_model_instances_storage::take_m2_changes()
+  {
+    std::unique_lock<std::mutex> const lock (_mutex);
+
+    std::vector<std::pair<ModelInstance*, Model*>> changes;
+    std::swap(changes, _m2_changes);
+    return changes;
+  }
+
+  std::vector<std::pair<WMOInstance*, WMO*>> world_model_instances_storage::take_wmo_changes()
+  {
+    std::unique_lock<std::mutex> const lock (_mutex);
+
+    std::vector<std::pair<WMOInstance*, WMO*>> changes;
+    std::swap(changes, _wmo_changes);
+    return changes;
+  }
+
+  void world_model_instances_storage::update_spatial_index(std::uint32_t uid)
+  {
+    std::unique_lock<std::mutex> const lock (_mutex);
+    unsafe_update_spatial_index(uid);
+  }
+
+  void world_model_instances_storage::unsafe_update_spatial_index(std::uint32_t uid)
+  {
+    boost::optional<instance_grid::bounds> bounds;
+    math::vector_3d pos;
+
+    auto m2_it = _m2s.find(uid);
+
+    if (m2_it != _m2s.end())
+    {
+      ModelInstance& instance = m2_it->second;
+      pos = instance.pos;
+
+      // extents() would calculate them, which may happen on a loading thread here
+      if (!instance.need_recalc_extents())
+      {
+        bounds = instance_grid::bounds {instance.extents()[0], instance.extents()[1]};
+      }
+    }
+    else
+    {
+      auto wmo_it = _wmos.find(uid);
+
+      if (wmo_it == _wmos.end())
+      {
+        return;
+      }
+
+      WMOInstance& instance = wmo_it->second;
+      pos = instance.pos;
+
+      if (!instance.need_recalc_extents())
+      {
+        bounds = instance_grid::bounds {instance.extents[0], instance.extents[1]};
+      }
+    }
+
+    if (bounds)
+    {
+      _instances_without_extents.erase(uid);
+    }
+    else
+    {
+      _instances_without_extents.emplace(uid);
+    }
+
+    _spatial_index.update(uid, pos, bounds);
+  }
+
+  void world_model_instances_storage::unsafe_remove_from_spatial_index(std::uint32_t uid)
+  {
+    _spatial_index.remove(uid);
+    _instances_without_extents.erase(uid);
+  }
+
+  std::vector<std::uint32_t> world_model_instances_storage::unsafe_ray_candidates(math::ray const& ray)
+  {
+    // extents are calculated lazily once the model or wmo is loaded,
+    // index the ones which got theirs since the last ray
+    std::vector<std::uint32_t> now_known;
+
+    for (std::uint32_t uid : _instances_without_extents)
+    {
+      auto m2_it = _m2s.find(uid);
+      bool known;
+
+      if (m2_it != _m2s.end())
+      {
+        // calculates them if the model finished loading
+        m2_it->second.extents();
+        known = !m2_it->second.need_recalc_extents();
+      }
+      else
+      {
+        known = !_wmos.at(uid).need_recalc_extents();
+      }
+
+      if (known)
+      {
+        now_known.push_back(uid);
+      }
+    }
+
+    for (std::uint32_t uid : now_known)
+    {
+      unsafe_update_spatial_index(uid);
+    }
+
+    return _spatial_index.hit_candidates([&] (math::vector_3d const& min, math::vector_3d const& max)
+    {
+      return !!ray.intersect_bounds(min, max);
+    });
   }
 
   boost::optional<ModelInstance*> world_model_instances_storage::get_model_instance(std::uint32_t uid)
@@ -341,7 +456,10 @@ namespace noggit
   boost::optional<selection_type> world_model_instances_storage::get_instance(std::uint32_t uid)
   {
     std::unique_lock<std::mutex> const lock (_mutex);
-
+    return unsafe_get_instance(uid);
+  }
+  boost::optional<selection_type> world_model_instances_storage::unsafe_get_instance(std::uint32_t uid)
+  {
     auto wmo_it = _wmos.find(uid);
 
     if (wmo_it != _wmos.end())
@@ -384,7 +502,9 @@ namespace noggit
         {
           _world->updateTilesWMO(&rhs->second, model_update::remove);
 
+          unsafe_remove_from_spatial_index(rhs->first);
           _instance_count_per_uid.erase(rhs->second.mUniqueID);
+          _wmo_changes.emplace_back(&rhs->second, nullptr);
           rhs = _wmos.erase(rhs);
           deleted_uids++;
         }
@@ -405,7 +525,9 @@ namespace noggit
         {
           _world->updateTilesModel(&rhs->second, model_update::remove);
 
+          unsafe_remove_from_spatial_index(rhs->first);
           _instance_count_per_uid.erase(rhs->second.uid);
+          _m2_changes.emplace_back(&rhs->second, nullptr);
           rhs = _m2s.erase(rhs);
           deleted_uids++;
         }
@@ -2,7 +2,9 @@
 
 #pragma once
 
+#include <math/ray.hpp>
 #include <math/vector_3d.hpp>
+#include <noggit/instance_grid.hpp>
 #include <noggit/ModelInstance.h>
 #include <noggit/Selection.h>
 #include <noggit/tile_index.hpp>
@@ -13,6 +15,9 @@
 #include <functional>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 class World;
 
@@ -50,11 +55,20 @@ namespace noggit
     void delete_instance(std::uint32_t uid);
     void unload_instance_and_remove_from_selection_if_necessary(std::uint32_t uid);
 
+    // call after moving, rotating or scaling an instance
+    void update_spatial_index(std::uint32_t uid);
+
     void clear();
     int size() const { return _m2s.size() + _wmos.size(); }
 
     void clear_duplicates();
 
+    // instances added and removed since the last call, in order, added ones
+    // with their model/wmo and removed ones with null as they may already
+    // be destroyed, for the world to update its draw buckets incrementally
+    std::vector<std::pair<ModelInstance*, Model*>> take_m2_changes();
+    std::vector<std::pair<WMOInstance*, WMO*>> take_wmo_changes();
+
     bool uid_duplicates_found() const
     {
       return _uid_duplicates_found.load();
@@ -67,6 +81,14 @@ namespace noggit
     std::uint32_t unsafe_add_wmo_instance_no_world_upd(WMOInstance instance);
     boost::optional<ModelInstance*> unsafe_get_model_instance(std::uint32_t uid);
     boost::optional<WMOInstance*> unsafe_get_wmo_instance(std::uint32_t uid);
+    boost::optional<selection_type> unsafe_get_instance(std::uint32_t uid);
+
+    void unsafe_erase_instance(std::uint32_t uid);
+
+    void unsafe_update_spatial_index(std::uint32_t uid);
+    void unsafe_remove_from_spatial_index(std::uint32_t uid);
+    // only the instances whose extents the ray hits, and those without extents yet
+    std::vector<std::uint32_t> unsafe_ray_candidates(math::ray const& ray);
 
   public:
     template<typename Fun>
@@ -107,6 +129,27 @@ namespace noggit
       }
     }
 
+    // skips the instances the ray can't hit, without testing them one by one
+    template<typename M2Fun, typename WMOFun>
+      void for_each_instance_on_ray(math::ray const& ray, M2Fun&& m2_function, WMOFun&& wmo_function)
+    {
+      std::unique_lock<std::mutex> const lock (_mutex);
+
+      for (std::uint32_t uid : unsafe_ray_candidates(ray))
+      {
+        auto m2_it = _m2s.find(uid);
+
+        if (m2_it != _m2s.end())
+        {
+          m2_function(m2_it->second);
+        }
+        else
+        {
+          wmo_function(_wmos.at(uid));
+        }
+      }
+    }
+
   private:
     World* _world;
     std::mutex _mutex;
@@ -116,5 +159,12 @@ namespace noggit
     wmo_instance_umap _wmos;
 
     std::unordered_map<std::uint32_t, int> _instance_count_per_uid;
+
+    std::vector<std::pair<ModelInstance*, Model*>> _m2_changes;
+    std::vector<std::pair<WMOInstance*, WMO*>> _wmo_changes;
+
+    instance_grid _spatial_index;
+    // instances whose extents weren't known when they were indexed
+    std::unordered_set<std::uint32_t> _instances_without_extents;
   };
 }
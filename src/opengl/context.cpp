@@ -246,6 +246,11 @@ namespace opengl
     verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
     return _current_context->functions()->glReadPixels (x, y, width, height, format, type, data);
   }
+  void context::pixelStorei (GLenum pname, GLint param)
+  {
+    verify_context_and_check_for_gl_errors const _ (_current_context, BOOST_CURRENT_FUNCTION);
+    return _current_context->functions()->glPixelStorei (pname, param);
+  }
 
   void context::lineWidth (GLfloat width)
   {
@@ -65,6 +65,7 @@ namespace opengl
 
     void readBuffer (GLenum);
     void readPixels (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid* data);
+    void pixelStorei (GLenum pname, GLint param);
 
     void lineWidth (GLfloat);
 
@@ -0,0 +1,64 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#include <util/chunk_writer.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace util
+{
+  chunk_writer::chunk_writer (std::size_t size)
+    : _data (size)
+  {}
+
+  void chunk_writer::chunk_header (std::uint32_t magic, std::size_t data_size)
+  {
+    value (magic);
+    value (static_cast<std::uint32_t> (data_size));
+  }
+
+  void chunk_writer::bytes (void const* data, std::size_t size)
+  {
+    if (size > _data.size() - _position)
+    {
+      throw std::logic_error ( "chunk_writer: writing " + std::to_string (size) + " bytes at "
+                             + std::to_string (_position) + " overflows the measured size "
+                             + std::to_string (_data.size())
+                             );
+    }
+
+    if (size)
+    {
+      std::memcpy (_data.data() + _position, data, size);
+    }
+    _position += size;
+  }
+
+  void chunk_writer::zeros (std::size_t size)
+  {
+    if (size > _data.size() - _position)
+    {
+      throw std::logic_error ( "chunk_writer: padding " + std::to_string (size) + " bytes at "
+                             + std::to_string (_position) + " overflows the measured size "
+                             + std::to_string (_data.size())
+                             );
+    }
+
+    // the buffer starts out zeroed and is never written twice
+    _position += size;
+  }
+
+  std::vector<char> chunk_writer::finish()
+  {
+    if (_position != _data.size())
+    {
+      throw std::logic_error ( "chunk_writer: wrote " + std::to_string (_position)
+                             + " bytes but measured " + std::to_string (_data.size())
+                             );
+    }
+
+    return std::move (_data);
+  }
+}
@@ -0,0 +1,54 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+  //! Writes chunked files (ADT, WDT) front to back into a buffer that is
+  //! allocated once. Callers measure everything first, so every chunk
+  //! header is written with its final size and nothing is ever inserted
+  //! or moved afterwards.
+  class chunk_writer
+  {
+  public:
+    static constexpr std::size_t header_size = 8;
+
+    //! size of a chunk with \a data_size bytes of data, header included
+    static constexpr std::size_t chunk_size (std::size_t data_size)
+    {
+      return header_size + data_size;
+    }
+
+    //! \a size is the exact size of the file, see finish().
+    explicit chunk_writer (std::size_t size);
+
+    std::size_t position() const { return _position; }
+
+    void chunk_header (std::uint32_t magic, std::size_t data_size);
+    void bytes (void const* data, std::size_t size);
+    void zeros (std::size_t size);
+
+    template<typename T>
+      void value (T const& value)
+    {
+      bytes (&value, sizeof (T));
+    }
+    template<typename T>
+      void values (std::vector<T> const& values)
+    {
+      bytes (values.data(), values.size() * sizeof (T));
+    }
+
+    //! The file. Throws std::logic_error if less than the size given on
+    //! construction was written, like writing past it does.
+    std::vector<char> finish();
+
+  private:
+    std::vector<char> _data;
+    std::size_t _position = 0;
+  };
+}
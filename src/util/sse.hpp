@@ -0,0 +1,11 @@
+// This file is part of Noggit3, licensed under GNU General Public License (version 3).
+
+#pragma once
+
+// NOGGIT_SSE is defined when the build targets a cpu with sse2. It is
+// part of every x86-64 cpu, so there is nothing to detect at runtime.
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define NOGGIT_SSE
+  #include <emmintrin.h>
+  #include <xmmintrin.h>
+#endif
@@ -0,0 +1,139 @@
+// Time to write a fully populated tile (256 chunks with 4 texture
+// layers and big alphamaps, vertex colors, shadows, liquids on every
+// chunk, a few hundred doodads), once with the legacy writer growing a
+// util::sExtendableArray and inserting into it, once with adt::write
+// measuring everything first and writing into a single buffer. Only the
+// writing is timed: gathering the data from the editor is the same for
+// both.
+
+#include <noggit/adt_file.hpp>
+
+#include "../noggit/adt_file_legacy.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  noggit::adt::tile full_tile()
+  {
+    noggit::adt::tile tile;
+
+    for (int i (0); i < 16; ++i)
+    {
+      tile.textures.emplace_back ("tileset\\expansion01\\borean\\tileset_" + std::to_string (i) + ".blp");
+    }
+    for (int i (0); i < 60; ++i)
+    {
+      tile.models.emplace_back ("WORLD\\EXPANSION01\\DOODADS\\GENERIC\\TREE_" + std::to_string (i) + ".M2");
+    }
+    for (int i (0); i < 8; ++i)
+    {
+      tile.objects.emplace_back ("WORLD\\WMO\\NORTHREND\\BUILDINGS\\HOUSE_" + std::to_string (i) + ".WMO");
+    }
+    for (std::uint32_t i (0); i < 400; ++i)
+    {
+      tile.doodads.push_back ({i % 60, i, {1.f * i, 2.f, 3.f}, {0.f, 90.f, 0.f}, 1024, 0});
+    }
+    for (std::uint32_t i (0); i < 20; ++i)
+    {
+      tile.wmos.push_back ({i % 8, 1000 + i, {1.f * i, 2.f, 3.f}, {0.f, 0.f, 0.f}, {{0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}}, 0, 0, 0, 0});
+    }
+
+    tile.water.resize (256);
+    for (auto& water : tile.water)
+    {
+      water.attributes = MH2O_Attributes();
+      noggit::adt::mh2o_layer layer;
+      layer.heights.resize (81, 12.f);
+      layer.depths.resize (81, 200);
+      water.layers.push_back (layer);
+    }
+
+    tile.chunks.resize (256);
+    for (std::size_t i (0); i < tile.chunks.size(); ++i)
+    {
+      auto& chunk (tile.chunks[i]);
+      chunk.header = {};
+      chunk.header.ix = i % 16;
+      chunk.header.iy = i / 16;
+      chunk.heights.fill (1.f * i);
+      chunk.vertex_colors.emplace();
+      chunk.vertex_colors->fill (0x7F7F7F);
+      chunk.normals.fill (127);
+
+      for (std::uint32_t layer (0); layer < 4; ++layer)
+      {
+        ENTRY_MCLY entry;
+        entry.textureID = (i + layer) % 16;
+        entry.flags = layer ? FLAG_USE_ALPHA : 0;
+        entry.ofsAlpha = 0;
+        chunk.layers.push_back (entry);
+        if (layer)
+        {
+          chunk.alphamaps.emplace_back (4096, static_cast<std::uint8_t> (i * layer));
+        }
+      }
+
+      chunk.doodad_refs = {std::uint32_t (i % 400), std::uint32_t ((i + 1) % 400)};
+      chunk.object_refs = {std::uint32_t (i % 20)};
+      chunk.shadow.emplace();
+      chunk.shadow->fill (0xAA);
+    }
+
+    tile.flags = 1;
+    tile.flight_bounds.emplace();
+    tile.flight_bounds->fill (100);
+
+    return tile;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const iterations (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 50);
+
+  auto const tile (full_tile());
+
+  std::size_t legacy_bytes (0);
+  double const legacy
+    ( seconds ( [&]
+                {
+                  for (std::size_t i (0); i < iterations; ++i)
+                  {
+                    legacy_bytes += legacy::write (tile).size();
+                  }
+                }
+              )
+    );
+
+  std::size_t bytes (0);
+  double const two_pass
+    ( seconds ( [&]
+                {
+                  for (std::size_t i (0); i < iterations; ++i)
+                  {
+                    bytes += noggit::adt::write (tile).size();
+                  }
+                }
+              )
+    );
+
+  std::printf ("%zu tiles of %.1f KiB\n", iterations, bytes / iterations / 1024.0);
+  std::printf ("legacy   %8.3f s (%.2f ms per tile)\n", legacy, legacy * 1000.0 / iterations);
+  std::printf ("two pass %8.3f s (%.2f ms per tile)\n", two_pass, two_pass * 1000.0 / iterations);
+  std::printf ("speedup %.2fx\n", legacy / two_pass);
+
+  return legacy::write (tile) == noggit::adt::write (tile) && bytes == legacy_bytes ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+// Time for texture brush strokes with a radius of 250 yards over the
+// chunks of a tile, with the loop TextureSet::paintTexture had on float
+// alphamaps, then with paint_alphas in fixed point.
+
+#include <noggit/alpha_painting.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  using legacy_alphas = std::array<std::array<float, 64 * 64>, 4>;
+
+  float legacy_dist (float x1, float z1, float x2, float z2)
+  {
+    float xdiff = x2 - x1, zdiff = z2 - z1;
+    return std::sqrt(xdiff*xdiff + zdiff*zdiff);
+  }
+
+  // misc::getShortestDist
+  float legacy_shortest_dist (float x, float z, float squareX, float squareZ, float unitSize)
+  {
+    float px, pz;
+
+    if (x >= squareX && x < squareX + unitSize)
+    {
+      px = x;
+    }
+    else
+    {
+      px = (squareX < x) ? squareX + unitSize : squareX;
+    }
+
+    if (z >= squareZ && z < squareZ + unitSize)
+    {
+      pz = z;
+    }
+    else
+    {
+      pz = (squareZ < z) ? squareZ + unitSize : squareZ;
+    }
+
+    return (px == x && pz == z) ? 0.0f : legacy_dist(x, z, px, pz);
+  }
+
+  bool legacy_float_equals (float const& a, float const& b)
+  {
+    return std::abs(a - b) < (std::max(1.f, std::max(a, b)) * std::numeric_limits<float>::epsilon());
+  }
+
+  // Brush::value_at_dist
+  float legacy_brush (float dist, float radius, float inner_size)
+  {
+    if (dist > radius)
+    {
+      return 0.0f;
+    }
+    if (dist < inner_size)
+    {
+      return 1.0f;
+    }
+    return 1.0f - ((dist - inner_size) / (radius - inner_size));
+  }
+
+  // the loop of TextureSet::paintTexture before paint_alphas
+  bool legacy_paint ( legacy_alphas& amaps, int nTextures, int tex_layer
+                    , float xbase, float zbase, float x, float z
+                    , float radius, float inner_size, float strength, float pressure
+                    )
+  {
+    bool changed = false;
+    float zPos = zbase;
+
+    for (int j = 0; j < 64; j++)
+    {
+      float xPos = xbase;
+      for (int i = 0; i < 64; ++i)
+      {
+        float dist = legacy_shortest_dist(x, z, xPos, zPos, TEXDETAILSIZE);
+
+        if (dist <= radius)
+        {
+          std::array<double,4> alpha_values;
+          double total = 0.;
+
+          for (int n = 0; n < 4; ++n)
+          {
+            total += alpha_values[n] = amaps[n][i + 64 * j];
+          }
+
+          double current_alpha = alpha_values[tex_layer];
+          double sum_other_alphas = (total - current_alpha);
+          double alpha_change = (strength - current_alpha) * pressure * legacy_brush (dist, radius, inner_size);
+
+          if (alpha_change < 0. && current_alpha + alpha_change < 1.)
+          {
+            alpha_change = -current_alpha;
+          }
+
+          if (!legacy_float_equals(current_alpha, strength))
+          {
+            if (sum_other_alphas < 1.)
+            {
+              if (alpha_change > 0.f)
+              {
+                for (int layer = 0; layer < nTextures; ++layer)
+                {
+                  alpha_values[layer] = layer == tex_layer ? 255. : 0.f;
+                }
+              }
+              else
+              {
+                bool change_applied = false;
+
+                for (int layer = 0; layer < nTextures; ++layer)
+                {
+                  if (layer == tex_layer)
+                  {
+                    alpha_values[layer] += alpha_change;
+                  }
+                  else
+                  {
+                    if (!change_applied)
+                    {
+                      alpha_values[layer] -= alpha_change;
+                    }
+                    else
+                    {
+                      alpha_values[tex_layer] += alpha_values[layer];
+                      alpha_values[layer] = 0.;
+                    }
+
+                    change_applied = true;
+                  }
+                }
+              }
+            }
+            else
+            {
+              for (int layer = 0; layer < nTextures; ++layer)
+              {
+                if (layer == tex_layer)
+                {
+                  alpha_values[layer] += alpha_change;
+                }
+                else
+                {
+                  alpha_values[layer] -= alpha_change * alpha_values[layer] / sum_other_alphas;
+
+                  if (alpha_values[layer] < 1.)
+                  {
+                    alpha_values[tex_layer] += alpha_values[layer];
+                    alpha_values[layer] = 0.f;
+                  }
+                }
+              }
+            }
+
+            double total_final = std::accumulate(alpha_values.begin(), alpha_values.end(), 0.);
+
+            if (std::abs(total_final - 255.) > 0.001)
+            {
+              for (double& d : alpha_values)
+              {
+                d = d * 255. / total_final;
+              }
+            }
+
+            for (int n = 0; n < 4; ++n)
+            {
+              amaps[n][i + 64 * j] = static_cast<float>(alpha_values[n]);
+            }
+
+            changed = true;
+          }
+        }
+
+        xPos += TEXDETAILSIZE;
+      }
+      zPos += TEXDETAILSIZE;
+    }
+
+    return changed;
+  }
+
+  std::uint8_t to_uint8 (float a)
+  {
+    return static_cast<std::uint8_t> (std::max (0.f, std::min (255.f, std::round (a))));
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const strokes (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 20);
+  float const radius (250.f);
+  float const inner (100.f);
+
+  std::mt19937 engine (42);
+  std::uniform_int_distribution<int> alpha (40, 70);
+
+  std::vector<legacy_alphas> floats (16 * 16);
+  std::vector<tmp_edit_alpha_values> fixed (16 * 16);
+  for (std::size_t c (0); c < floats.size(); ++c)
+  {
+    for (int i (0); i < 64 * 64; ++i)
+    {
+      int left (255);
+      for (std::size_t layer (1); layer < 4; ++layer)
+      {
+        int const a (alpha (engine));
+        floats[c][layer][i] = static_cast<float> (a);
+        fixed[c].set_alpha (layer, i, static_cast<float> (a));
+        left -= a;
+      }
+      floats[c][0][i] = static_cast<float> (left);
+      fixed[c].set_alpha (0, i, static_cast<float> (left));
+    }
+  }
+
+  std::uniform_real_distribution<float> position (4.f * CHUNKSIZE, 12.f * CHUNKSIZE);
+  std::uniform_real_distribution<float> unit;
+  struct stroke
+  {
+    float x, z, strength, pressure;
+    int layer;
+  };
+  std::vector<stroke> brush_strokes;
+  for (std::size_t i (0); i < strokes; ++i)
+  {
+    brush_strokes.push_back ( { position (engine), position (engine), 255.f * unit (engine)
+                              , 0.05f + 0.1f * unit (engine), static_cast<int> (i % 4)
+                              }
+                            );
+  }
+
+  std::size_t changed (0);
+  double const old_time
+    ( seconds ( [&]
+                {
+                  for (stroke const& s : brush_strokes)
+                  {
+                    for (std::size_t c (0); c < floats.size(); ++c)
+                    {
+                      changed += legacy_paint ( floats[c], 4, s.layer, (c % 16) * CHUNKSIZE, (c / 16) * CHUNKSIZE
+                                             , s.x, s.z, radius, inner, s.strength, s.pressure
+                                             );
+                    }
+                  }
+                }
+              )
+    );
+
+  double const new_time
+    ( seconds ( [&]
+                {
+                  for (stroke const& s : brush_strokes)
+                  {
+                    for (std::size_t c (0); c < fixed.size(); ++c)
+                    {
+                      changed -= noggit::paint_alphas ( fixed[c], 4, s.layer, (c % 16) * CHUNKSIZE, (c / 16) * CHUNKSIZE
+                                                      , s.x, s.z, radius, inner, s.strength, s.pressure
+                                                      );
+                    }
+                  }
+                }
+              )
+    );
+
+  std::size_t texels (0);
+  std::size_t off_by_more (0);
+  for (std::size_t c (0); c < floats.size(); ++c)
+  {
+    for (std::size_t layer (1); layer < 4; ++layer)
+    {
+      for (int i (0); i < 64 * 64; ++i)
+      {
+        off_by_more += std::abs (to_uint8 (floats[c][layer][i]) - to_uint8 (fixed[c].alpha (layer, i))) > 1;
+        ++texels;
+      }
+    }
+  }
+
+  std::printf ("%zu strokes over %zu chunks, %zu of %zu alphas off by more than 1\n", strokes, floats.size(), off_by_more, texels);
+  std::printf ("floats %8.3f s  fixed point %8.3f s  speedup %.2fx\n", old_time, new_time, old_time / new_time);
+
+  return changed == 0 && off_by_more * 10000 < texels ? 0 : 1;
+}
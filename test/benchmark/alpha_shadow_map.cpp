@@ -0,0 +1,182 @@
+// Time to rebuild the alpha/shadow texture of a whole tile, 256 chunks
+// with three alphamaps and a shadow map each: once with a fresh vector
+// per chunk and the shadow bits taken one at a time like
+// TextureSet::update_alpha_shadow_map_if_needed used to, once packed
+// into an alpha_shadow_staging. The same again for chunks being edited,
+// which used to be staged as floats.
+
+#include <noggit/alpha_shadow_map.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct chunk
+  {
+    std::array<std::array<std::uint8_t, 64 * 64>, 3> alphamaps;
+    noggit::shadow_bits shadow;
+    tmp_edit_alpha_values edit_values;
+  };
+
+  // stands in for glTexSubImage3D
+  std::uint64_t upload (void const* data, std::size_t size)
+  {
+    std::uint64_t sum (0);
+    std::memcpy (&sum, static_cast<char const*> (data) + size / 2, sizeof (sum));
+    return sum;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const rebuilds (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 50);
+
+  std::mt19937_64 engine (42);
+  std::vector<chunk> chunks (256);
+  for (chunk& c : chunks)
+  {
+    for (auto& layer : c.alphamaps)
+    {
+      for (auto& a : layer)
+      {
+        a = static_cast<std::uint8_t> (engine());
+      }
+    }
+    for (auto& row : c.shadow)
+    {
+      row = engine();
+    }
+    for (auto& layer : c.edit_values.map)
+    {
+      for (auto& a : layer)
+      {
+        a = static_cast<std::uint16_t> (engine() % (tmp_edit_alpha_values::full + 1));
+      }
+    }
+  }
+
+  std::uint64_t old_sum (0);
+  std::uint64_t old_edit_sum (0);
+  double const old_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rebuilds; ++r)
+                  {
+                    for (chunk const& c : chunks)
+                    {
+                      std::vector<std::uint8_t> amap (4 * 64 * 64);
+                      std::uint8_t const* alpha_ptr[3] = {c.alphamaps[0].data(), c.alphamaps[1].data(), c.alphamaps[2].data()};
+
+                      for (int i = 0; i < 64 * 64; ++i)
+                      {
+                        for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
+                        {
+                          amap[i * 4 + alpha_id] = *(alpha_ptr[alpha_id]++);
+                        }
+
+                        amap[i * 4 + 3] = ((c.shadow[i / 64] >> (i % 64)) & 1) * 255;
+                      }
+
+                      old_sum += upload (amap.data(), amap.size());
+                    }
+                  }
+                }
+              )
+    );
+
+  noggit::alpha_shadow_staging staging;
+  std::uint64_t new_sum (0);
+  std::uint64_t new_edit_sum (0);
+  double const new_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rebuilds; ++r)
+                  {
+                    std::uint8_t* texels (staging.texels (256));
+                    for (std::size_t i (0); i < chunks.size(); ++i)
+                    {
+                      chunk const& c (chunks[i]);
+                      noggit::pack_alpha_shadow_map
+                        ( texels + i * noggit::alpha_shadow_map_bytes
+                        , std::array<std::uint8_t const*, 3> {{c.alphamaps[0].data(), c.alphamaps[1].data(), c.alphamaps[2].data()}}
+                        , &c.shadow
+                        );
+                    }
+                    for (std::size_t i (0); i < chunks.size(); ++i)
+                    {
+                      new_sum += upload (texels + i * noggit::alpha_shadow_map_bytes, noggit::alpha_shadow_map_bytes);
+                    }
+                    staging.release();
+                  }
+                }
+              )
+    );
+
+  double const old_edit_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rebuilds; ++r)
+                  {
+                    for (chunk const& c : chunks)
+                    {
+                      std::vector<float> amap (4 * 64 * 64);
+
+                      for (int i = 0; i < 64 * 64; ++i)
+                      {
+                        for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
+                        {
+                          amap[i * 4 + alpha_id] = c.edit_values.alpha (alpha_id + 1, i) / 255.f;
+                        }
+
+                        amap[i * 4 + 3] = (c.shadow[i / 64] >> (i % 64)) & 1;
+                      }
+
+                      old_edit_sum += upload (amap.data(), amap.size() * sizeof (float));
+                    }
+                  }
+                }
+              )
+    );
+
+  double const new_edit_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rebuilds; ++r)
+                  {
+                    for (chunk const& c : chunks)
+                    {
+                      std::uint8_t* texels (staging.texels (1));
+                      noggit::pack_alpha_shadow_map (texels, c.edit_values, &c.shadow);
+                      new_edit_sum += upload (texels, noggit::alpha_shadow_map_bytes);
+                    }
+                  }
+                }
+              )
+    );
+
+  std::printf ( "%zu rebuilds of 256 chunks, edit checksums %llx %llx\n", rebuilds
+              , static_cast<unsigned long long> (old_edit_sum), static_cast<unsigned long long> (new_edit_sum)
+              );
+  std::printf ("saved   old %8.3f s  staged %8.3f s  speedup %.2fx\n", old_time, new_time, old_time / new_time);
+  std::printf ("editing old %8.3f s  staged %8.3f s  speedup %.2fx, %zu instead of %zu bytes per chunk\n"
+              , old_edit_time, new_edit_time, old_edit_time / new_edit_time
+              , noggit::alpha_shadow_map_bytes, noggit::alpha_shadow_map_bytes * sizeof (float)
+              );
+
+  return old_sum == new_sum ? 0 : 1;
+}
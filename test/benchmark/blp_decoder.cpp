@@ -0,0 +1,136 @@
+// Time to make the thumbnails of 200 tileset textures, 512x512 dxt5 with
+// all mips, at the 256x256 of the tileset chooser and at icon size: one
+// after the other, then on a job_scheduler, then again from the cache.
+// The gl path this replaces set up a context, framebuffer and shaders per
+// thumbnail and can't run here.
+
+#include <noggit/blp_decoder.hpp>
+#include <noggit/job_scheduler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::vector<char> random_dxt5_blp (std::mt19937& engine, int size)
+  {
+    BLPHeader header {};
+    std::memcpy (&header.magix, "BLP2", 4);
+    header.version = 1;
+    header.attr_0_compression = 2;
+    header.attr_1_alphadepth = 8;
+    header.attr_2_alphatype = 7;
+    header.attr_3_mipmaplevels = 1;
+    header.resx = size;
+    header.resy = size;
+
+    std::vector<char> file (sizeof (header) + 256 * 4);
+    std::uniform_int_distribution<int> byte (0, 255);
+    for (int mip (0); size >> mip; ++mip)
+    {
+      int const blocks (std::max (1, (size >> mip) / 4));
+      header.offsets[mip] = static_cast<std::int32_t> (file.size());
+      header.sizes[mip] = blocks * blocks * 16;
+      for (int i (0); i < header.sizes[mip]; ++i)
+      {
+        file.push_back (static_cast<char> (byte (engine)));
+      }
+    }
+    std::memcpy (file.data(), &header, sizeof (header));
+    return file;
+  }
+
+  std::shared_ptr<noggit::rgba_image const> thumbnail (std::vector<char> const& file, int size)
+  {
+    BLPHeader header;
+    std::memcpy (&header, file.data(), sizeof (header));
+    return std::make_shared<noggit::rgba_image const>
+      ( noggit::blp_thumbnail
+          ( noggit::decode_blp (file.data(), file.size(), noggit::blp_mip_for_size (header, size, size))
+          , size
+          , size
+          )
+      );
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const count (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 200);
+
+  std::mt19937 engine (42);
+  std::vector<std::vector<char>> files;
+  for (std::size_t i (0); i < count; ++i)
+  {
+    files.emplace_back (random_dxt5_blp (engine, 512));
+  }
+
+  noggit::job_scheduler scheduler (std::max (2u, std::thread::hardware_concurrency()) - 1, 1);
+  bool same (true);
+
+  for (int size : {256, 64})
+  {
+    std::vector<std::shared_ptr<noggit::rgba_image const>> sequential (count);
+    std::vector<std::shared_ptr<noggit::rgba_image const>> parallel (count);
+    noggit::thumbnail_cache cache (64 << 20);
+
+    double const sequential_time
+      (seconds ([&] { for (std::size_t i (0); i < count; ++i) { sequential[i] = thumbnail (files[i], size); } }));
+
+    double const parallel_time
+      ( seconds ( [&]
+                  {
+                    scheduler.parallel_for
+                      ( 0, count
+                      , [&] (std::size_t i)
+                        {
+                          parallel[i] = thumbnail (files[i], size);
+                          cache.insert (std::to_string (i), size, size, parallel[i]);
+                        }
+                      );
+                  }
+                )
+      );
+
+    std::size_t hits (0);
+    double const cached_time
+      ( seconds ( [&]
+                  {
+                    for (std::size_t i (0); i < count; ++i)
+                    {
+                      hits += !!cache.find (std::to_string (i), size, size);
+                    }
+                  }
+                )
+      );
+
+    for (std::size_t i (0); i < count; ++i)
+    {
+      same = same && sequential[i]->pixels == parallel[i]->pixels;
+    }
+
+    std::printf ( "%3dx%-3d one by one %7.3f ms  %zu workers %7.3f ms  cached %7.4f ms (%zu hits) per thumbnail\n"
+                , size, size, 1e3 * sequential_time / count, scheduler.thread_count() + 1, 1e3 * parallel_time / count
+                , 1e3 * cached_time / count, hits
+                );
+  }
+
+  return same ? 0 : 1;
+}
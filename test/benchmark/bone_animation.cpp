@@ -0,0 +1,258 @@
+// Time to evaluate the bones of a creature with 250 bones, every one of
+// them animated with 40 keyframes of translation, rotation and scale:
+// once like the legacy Model::calcBones, looking keyframes up in maps
+// with a linear search and recursing into parents with full matrix
+// products, once with the keyframes in flat arrays found by binary
+// search and the bones evaluated parents first with affine products.
+
+#include <noggit/bone_animation.hpp>
+
+#include <math/interpolation.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::size_t const animations (30);
+  std::uint32_t const animation (17);
+
+  template<typename T>
+    struct legacy_channel
+  {
+    std::map<std::uint32_t, std::vector<std::uint32_t>> times;
+    std::map<std::uint32_t, std::vector<T>> data;
+
+    T get (std::uint32_t anim, std::uint32_t time)
+    {
+      std::vector<std::uint32_t>& timestamps (times[anim]);
+      std::vector<T>& values (data[anim]);
+
+      time %= timestamps.back();
+
+      std::size_t pos (0);
+      for (std::size_t i (0); i < timestamps.size() - 1; ++i)
+      {
+        if (time >= timestamps[i] && time < timestamps[i + 1])
+        {
+          pos = i;
+          break;
+        }
+      }
+
+      float const percentage ((time - timestamps[pos]) / static_cast<float> (timestamps[pos + 1] - timestamps[pos]));
+      return math::interpolation::linear (percentage, values[pos], values[pos + 1]);
+    }
+  };
+
+  template<typename T>
+    struct channel
+  {
+    std::vector<std::vector<std::uint32_t>> times;
+    std::vector<std::vector<T>> data;
+
+    T get (std::uint32_t anim, std::uint32_t time) const
+    {
+      std::vector<std::uint32_t> const& timestamps (times[anim]);
+      std::vector<T> const& values (data[anim]);
+
+      time %= timestamps.back();
+
+      std::size_t const pos (noggit::keyframe_before (timestamps, time));
+
+      float const percentage ((time - timestamps[pos]) / static_cast<float> (timestamps[pos + 1] - timestamps[pos]));
+      return math::interpolation::linear (percentage, values[pos], values[pos + 1]);
+    }
+  };
+
+  struct bone
+  {
+    int parent;
+    math::vector_3d pivot;
+    legacy_channel<math::vector_3d> legacy_trans;
+    legacy_channel<math::quaternion> legacy_rot;
+    legacy_channel<math::vector_3d> legacy_scale;
+    channel<math::vector_3d> trans;
+    channel<math::quaternion> rot;
+    channel<math::vector_3d> scale;
+
+    math::matrix_4x4 mat = math::matrix_4x4::unit;
+    math::matrix_4x4 mrot = math::matrix_4x4::unit;
+    bool calc = false;
+  };
+
+  void legacy_calc (std::vector<bone>& bones, std::size_t i, std::uint32_t time)
+  {
+    bone& b (bones[i]);
+    if (b.calc)
+    {
+      return;
+    }
+
+    math::quaternion const q (b.legacy_rot.get (animation, time));
+
+    math::matrix_4x4 m (math::matrix_4x4::translation, b.pivot);
+    m *= math::matrix_4x4 (math::matrix_4x4::translation, b.legacy_trans.get (animation, time));
+    m *= math::matrix_4x4 (math::matrix_4x4::rotation, q);
+    m *= math::matrix_4x4 (math::matrix_4x4::scale, b.legacy_scale.get (animation, time));
+    m *= math::matrix_4x4 (math::matrix_4x4::translation, -b.pivot);
+
+    if (b.parent >= 0)
+    {
+      legacy_calc (bones, b.parent, time);
+      b.mat = bones[b.parent].mat * m;
+      b.mrot = bones[b.parent].mrot * math::matrix_4x4 (math::matrix_4x4::rotation, q);
+    }
+    else
+    {
+      b.mat = m;
+      b.mrot = math::matrix_4x4 (math::matrix_4x4::rotation, q);
+    }
+
+    b.calc = true;
+  }
+
+  void calc (std::vector<bone>& bones, std::size_t i, std::uint32_t time)
+  {
+    bone& b (bones[i]);
+
+    math::quaternion const q (b.rot.get (animation, time));
+    math::matrix_4x4 m (noggit::affine_transform (b.pivot + b.trans.get (animation, time), q, b.scale.get (animation, time)));
+    noggit::affine_translate (m, -b.pivot);
+
+    if (b.parent >= 0)
+    {
+      b.mat = noggit::affine_product (bones[b.parent].mat, m);
+      b.mrot = noggit::affine_product (bones[b.parent].mrot, math::matrix_4x4 (math::matrix_4x4::rotation, q));
+    }
+    else
+    {
+      b.mat = m;
+      b.mrot = math::matrix_4x4 (math::matrix_4x4::rotation, q);
+    }
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const frames (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 5000);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> real (-1.f, 1.f);
+
+  std::vector<bone> bones (250);
+  for (std::size_t i (0); i < bones.size(); ++i)
+  {
+    bone& b (bones[i]);
+    // a spine with limbs hanging off it, listed children first
+    b.parent = i + 1 < bones.size() ? static_cast<int> (i + 1 + (i % 5 ? 0 : 3)) : -1;
+    if (b.parent >= static_cast<int> (bones.size()))
+    {
+      b.parent = -1;
+    }
+    b.pivot = {real (engine), real (engine), real (engine)};
+
+    for (std::uint32_t anim (0); anim < animations; ++anim)
+    {
+      std::uint32_t time (0);
+      for (int key (0); key < 40; ++key)
+      {
+        math::quaternion q (real (engine), real (engine), real (engine), 1.f);
+        q.normalize();
+        math::vector_3d const t (real (engine), real (engine), real (engine));
+        math::vector_3d const s (1.f + real (engine) * 0.1f, 1.f, 1.f);
+
+        b.legacy_trans.times[anim].push_back (time);
+        b.legacy_rot.times[anim].push_back (time);
+        b.legacy_scale.times[anim].push_back (time);
+        b.legacy_trans.data[anim].push_back (t);
+        b.legacy_rot.data[anim].push_back (q);
+        b.legacy_scale.data[anim].push_back (s);
+
+        time += 33;
+      }
+    }
+
+    for (auto const& it : b.legacy_trans.times)
+    {
+      b.trans.times.push_back (it.second);
+      b.rot.times.push_back (it.second);
+      b.scale.times.push_back (it.second);
+      b.trans.data.push_back (b.legacy_trans.data[it.first]);
+      b.rot.data.push_back (b.legacy_rot.data[it.first]);
+      b.scale.data.push_back (b.legacy_scale.data[it.first]);
+    }
+  }
+
+  std::vector<int> parents;
+  for (auto const& b : bones)
+  {
+    parents.push_back (b.parent);
+  }
+  std::vector<std::size_t> const order (noggit::parent_first_order (parents));
+
+  std::vector<math::matrix_4x4> legacy_result;
+  double const legacy
+    ( seconds ( [&]
+                {
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    for (auto& b : bones)
+                    {
+                      b.calc = false;
+                    }
+                    for (std::size_t i (0); i < bones.size(); ++i)
+                    {
+                      legacy_calc (bones, i, frame * 16);
+                    }
+                  }
+                }
+              )
+    );
+  for (auto const& b : bones)
+  {
+    legacy_result.push_back (b.mat);
+  }
+
+  double const flat
+    ( seconds ( [&]
+                {
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    for (std::size_t i : order)
+                    {
+                      calc (bones, i, frame * 16);
+                    }
+                  }
+                }
+              )
+    );
+
+  bool same (true);
+  for (std::size_t i (0); i < bones.size(); ++i)
+  {
+    for (std::size_t element (0); element < 16; ++element)
+    {
+      same = same && std::abs (legacy_result[i][element] - bones[i].mat[element]) < 1e-2f;
+    }
+  }
+
+  std::printf ("%zu frames of %zu bones\n", frames, bones.size());
+  std::printf ("legacy %8.3f s  flat %8.3f s  speedup %.2fx\n", legacy, flat, legacy / flat);
+
+  return same ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Time for brush strokes with a radius of 300 yards over the chunks of
+// two by two tiles, raising then flattening every vertex in range like
+// World::changeTerrain and flattenTerrain do: once chunk after chunk,
+// once with edit_chunks on the compute scheduler.
+
+#include <noggit/chunk_edit.hpp>
+#include <noggit/job_scheduler.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  float const unit_size (100.f / 3.f / 8.f);
+  float const chunk_size (unit_size * 8.f);
+
+  struct chunk
+  {
+    std::array<float, 145> x;
+    std::array<float, 145> y;
+    std::array<float, 145> z;
+  };
+
+  bool stroke (chunk& c, float px, float pz, float radius)
+  {
+    bool changed (false);
+    for (std::size_t i (0); i < c.y.size(); ++i)
+    {
+      float const xdiff (c.x[i] - px);
+      float const zdiff (c.z[i] - pz);
+      float const dist (std::sqrt (xdiff * xdiff + zdiff * zdiff));
+      if (dist < radius)
+      {
+        c.y[i] += 0.5f / (1.0f + dist / radius);
+        float const t (std::pow (0.9f, 1.f + dist / radius));
+        c.y[i] = 10.f * (1.f - t) + c.y[i] * t;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const strokes (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 500);
+  float const radius (300.f);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> height (-50.f, 50.f);
+
+  std::vector<chunk> chunks (32 * 32);
+  for (int py (0); py < 32; ++py)
+  {
+    for (int px (0); px < 32; ++px)
+    {
+      chunk& c (chunks[py * 32 + px]);
+      int v (0);
+      for (int j (0); j < 17; ++j)
+      {
+        for (int i (0); i < ((j % 2) ? 8 : 9); ++i, ++v)
+        {
+          c.x[v] = px * chunk_size + i * unit_size + ((j % 2) ? unit_size * 0.5f : 0.f);
+          c.z[v] = py * chunk_size + j * 0.5f * unit_size;
+          c.y[v] = height (engine);
+        }
+      }
+    }
+  }
+  std::vector<chunk> parallel_chunks (chunks);
+
+  float const center (16.f * chunk_size);
+  auto const in_range
+    ( [&] (std::vector<chunk>& all)
+      {
+        std::vector<chunk*> result;
+        for (chunk& c : all)
+        {
+          float const cx (c.x[0] + chunk_size / 2.f - center);
+          float const cz (c.z[0] + chunk_size / 2.f - center);
+          if (std::sqrt (cx * cx + cz * cz) < radius + chunk_size)
+          {
+            result.push_back (&c);
+          }
+        }
+        return result;
+      }
+    );
+
+  auto const serial_range (in_range (chunks));
+  auto const parallel_range (in_range (parallel_chunks));
+
+  std::size_t changed (0);
+  double const serial
+    ( seconds ( [&]
+                {
+                  for (std::size_t i (0); i < strokes; ++i)
+                  {
+                    noggit::edit_chunks ( nullptr, serial_range
+                                        , [&] (chunk* c) { return stroke (*c, center, center, radius); }
+                                        , [&] (chunk*) { ++changed; }
+                                        );
+                  }
+                }
+              )
+    );
+
+  double const parallel
+    ( seconds ( [&]
+                {
+                  for (std::size_t i (0); i < strokes; ++i)
+                  {
+                    noggit::edit_chunks ( &noggit::compute_scheduler(), parallel_range
+                                        , [&] (chunk* c) { return stroke (*c, center, center, radius); }
+                                        , [&] (chunk*) { --changed; }
+                                        );
+                  }
+                }
+              )
+    );
+
+  bool same (changed == 0);
+  for (std::size_t i (0); i < chunks.size(); ++i)
+  {
+    same = same && !std::memcmp (chunks[i].y.data(), parallel_chunks[i].y.data(), sizeof (chunks[i].y));
+  }
+
+  std::printf ( "%zu strokes over %zu chunks, %zu threads\n"
+              , strokes, serial_range.size(), noggit::compute_scheduler().thread_count() + 1
+              );
+  std::printf ("serial %8.3f s  parallel %8.3f s  speedup %.2fx\n", serial, parallel, serial / parallel);
+
+  return same ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// Time to save a set of synthetic tiles one after the other, the way
+// MapIndex::saveChanged used to, against a file_save_batch on the
+// compute scheduler. Serializing a tile is simulated by filling a buffer
+// of typical ADT size with hashed data.
+
+#include <noggit/file_save_batch.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+  std::vector<char> fake_tile (std::size_t index, std::size_t size)
+  {
+    std::vector<char> data (size);
+    std::uint64_t hash (1469598103934665603ull ^ index);
+    for (std::size_t i (0); i < size; ++i)
+    {
+      hash = (hash ^ i) * 1099511628211ull;
+      data[i] = static_cast<char> (hash >> 32);
+    }
+    return data;
+  }
+
+  boost::filesystem::path tile_path (boost::filesystem::path const& folder, std::size_t index)
+  {
+    return folder / ("bench_" + std::to_string (index % 64) + "_" + std::to_string (index / 64) + ".adt");
+  }
+
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const tile_count (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 128);
+  std::size_t const tile_size (argc > 2 ? std::strtoul (argv[2], nullptr, 10) : 1536 * 1024);
+
+  auto const folder (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+  boost::filesystem::create_directories (folder / "sequential");
+  boost::filesystem::create_directories (folder / "parallel");
+
+  double const sequential
+    ( seconds ( [&]
+                {
+                  for (std::size_t i (0); i < tile_count; ++i)
+                  {
+                    auto const data (fake_tile (i, tile_size));
+                    noggit::write_file_atomically (tile_path (folder / "sequential", i), data.data(), data.size());
+                  }
+                }
+              )
+    );
+
+  double serialized (0.0);
+  double const parallel
+    ( seconds ( [&]
+                {
+                  noggit::file_save_batch batch (noggit::compute_scheduler());
+                  for (std::size_t i (0); i < tile_count; ++i)
+                  {
+                    batch.add ( std::to_string (i)
+                              , [&, i]
+                                {
+                                  return std::vector<noggit::serialized_file>
+                                    ({{tile_path (folder / "parallel", i), fake_tile (i, tile_size)}});
+                                }
+                              );
+                  }
+                  serialized = seconds ([&] { batch.wait_serialized(); });
+                  batch.wait();
+                }
+              )
+    );
+
+  std::printf ( "%zu tiles of %zu KiB, %zu workers + calling thread\n"
+              , tile_count
+              , tile_size / 1024
+              , noggit::compute_scheduler().thread_count()
+              );
+  std::printf ("sequential %8.3f s\n", sequential);
+  std::printf ("parallel   %8.3f s (editor blocked for %.3f s)\n", parallel, serialized);
+  std::printf ("speedup %.2fx\n", sequential / parallel);
+
+  boost::filesystem::remove_all (folder);
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Time to keep the draw lists of 100k instances of 2000 models up to
+// date while one instance is deleted and another added per frame: once
+// rebuilding maps keyed by filename from every instance like World used
+// to, once with instance_buckets only applying the two changes.
+
+#include <noggit/instance_buckets.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct model
+  {
+    std::string filename;
+  };
+
+  struct instance
+  {
+    model* m;
+  };
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const frames (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 200);
+  std::size_t const model_count (2000);
+  std::size_t const instance_count (100000);
+
+  std::mt19937 engine (42);
+  std::uniform_int_distribution<std::size_t> model_index (0, model_count - 1);
+
+  std::vector<model> models (model_count);
+  for (std::size_t i (0); i < model_count; ++i)
+  {
+    models[i].filename = "world\\generic\\doodads\\some_model_" + std::to_string (i) + ".m2";
+  }
+
+  std::unordered_map<std::uint32_t, std::unique_ptr<instance>> storage;
+  std::unordered_map<std::uint32_t, std::unique_ptr<instance>> legacy_storage;
+  std::uint32_t next_uid (0);
+  for (; next_uid < instance_count; ++next_uid)
+  {
+    model* m (&models[model_index (engine)]);
+    storage[next_uid].reset (new instance {m});
+    legacy_storage[next_uid].reset (new instance {m});
+  }
+
+  // the same edits for both
+  std::vector<std::uint32_t> removed;
+  std::vector<model*> added;
+  for (std::size_t frame (0); frame < frames; ++frame)
+  {
+    removed.push_back (static_cast<std::uint32_t> (frame * 7));
+    added.push_back (&models[model_index (engine)]);
+  }
+
+  std::size_t legacy_buckets (0);
+  double const legacy
+    ( seconds ( [&]
+                {
+                  std::unordered_map<std::string, std::vector<instance*>> by_filename;
+                  std::uint32_t uid (next_uid);
+
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    legacy_storage.erase (removed[frame]);
+                    legacy_storage[uid++].reset (new instance {added[frame]});
+
+                    by_filename.clear();
+                    for (auto const& it : legacy_storage)
+                    {
+                      by_filename[it.second->m->filename].push_back (it.second.get());
+                    }
+                  }
+
+                  legacy_buckets = by_filename.size();
+                }
+              )
+    );
+
+  noggit::instance_buckets<model, instance> buckets;
+  for (auto const& it : storage)
+  {
+    buckets.add (it.second->m, it.second.get());
+  }
+
+  double const incremental
+    ( seconds ( [&]
+                {
+                  std::uint32_t uid (next_uid);
+
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    buckets.remove (storage.at (removed[frame]).get());
+                    storage.erase (removed[frame]);
+
+                    auto& stored (storage[uid++]);
+                    stored.reset (new instance {added[frame]});
+                    buckets.add (stored->m, stored.get());
+                  }
+                }
+              )
+    );
+
+  std::printf ("%zu frames, %zu instances of %zu models\n", frames, instance_count, model_count);
+  std::printf ("rebuild %8.3f s  incremental %8.6f s  speedup %.0fx\n", legacy, incremental, legacy / incremental);
+
+  return legacy_buckets == buckets.buckets().size() && buckets.size() == legacy_storage.size() ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+// Time to cull 100k doodads of 2000 different models after a camera
+// move: once like Model::draw used to, checking every heap allocated
+// instance through its pointer and pushing the visible transforms into
+// a new vector per model, once with instance_culling gathering the
+// bounding spheres once, like World does while the instances don't
+// change, and culling them on all cores every frame.
+
+#include <noggit/instance_culling.hpp>
+#include <noggit/job_scheduler.hpp>
+
+#include <math/frustum.hpp>
+#include <math/projection.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct model
+  {
+    float rad;
+  };
+
+  struct instance
+  {
+    model* m;
+    math::vector_3d pos;
+    float scale;
+    float size_cat;
+    math::matrix_4x4 transform = math::matrix_4x4::unit;
+    bool visible = false;
+
+    virtual ~instance() = default;
+    virtual math::vector_3d get_pos() const { return pos; }
+
+    bool is_visible (math::frustum const& frustum, float cull_distance, math::vector_3d const& camera)
+    {
+      visible = false;
+
+      float const dist ((get_pos() - camera).length() - m->rad * scale);
+
+      if (dist >= cull_distance)
+      {
+        return false;
+      }
+
+      if (size_cat < 1.f && dist > 30.f)
+      {
+        return false;
+      }
+      else if (size_cat < 4.f && dist > 150.f)
+      {
+        return false;
+      }
+      else if (size_cat < 25.f && dist > 300.f)
+      {
+        return false;
+      }
+
+      visible = frustum.intersectsSphere (get_pos(), m->rad * scale);
+      return visible;
+    }
+  };
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const frames (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 200);
+  std::size_t const model_count (2000);
+  std::size_t const instance_count (100000);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> position (-1600.f, 1600.f);
+  std::uniform_int_distribution<std::size_t> model_index (0, model_count - 1);
+
+  std::vector<model> models (model_count);
+  for (auto& m : models)
+  {
+    m.rad = std::uniform_real_distribution<float> (0.5f, 20.f) (engine);
+  }
+
+  std::vector<std::unique_ptr<instance>> storage;
+  std::vector<std::vector<instance*>> by_model (model_count);
+  for (std::size_t i (0); i < instance_count; ++i)
+  {
+    std::size_t const index (model_index (engine));
+    storage.emplace_back (std::make_unique<instance>());
+    instance& in (*storage.back());
+    in.m = &models[index];
+    in.pos = {position (engine), position (engine) * 0.05f, position (engine)};
+    in.scale = std::uniform_real_distribution<float> (0.5f, 2.f) (engine);
+    in.size_cat = in.m->rad * in.scale * 2.f;
+    in.transform (0, 3, in.pos.x);
+    in.transform (2, 3, in.pos.z);
+    by_model[index].push_back (&in);
+  }
+
+  // the camera turns around, every frame sees other instances
+  auto const frustum_of_frame
+    ( [&] (std::size_t frame)
+      {
+        float const angle (frame * 0.05f);
+        math::vector_3d const target (std::cos (angle) * 100.f, 0.f, std::sin (angle) * 100.f);
+        return math::frustum ( math::perspective (math::degrees (54.f), 1.6f, 1.f, 2048.f)
+                             * math::look_at ({0.f, 50.f, 0.f}, target, {0.f, 1.f, 0.f})
+                             );
+      }
+    );
+  math::vector_3d const camera (0.f, 50.f, 0.f);
+  float const cull_distance (384.f);
+
+  std::size_t legacy_visible (0);
+  double const legacy
+    ( seconds ( [&]
+                {
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    math::frustum const frustum (frustum_of_frame (frame));
+                    legacy_visible = 0;
+
+                    for (auto const& instances : by_model)
+                    {
+                      std::vector<math::matrix_4x4> transform_matrix;
+                      transform_matrix.reserve (instances.size());
+
+                      for (instance* mi : instances)
+                      {
+                        if (mi->is_visible (frustum, cull_distance, camera))
+                        {
+                          transform_matrix.push_back (mi->transform);
+                        }
+                      }
+
+                      legacy_visible += transform_matrix.size();
+                    }
+                  }
+                }
+              )
+    );
+
+  noggit::instance_culling culling (true);
+  std::size_t culled_visible (0);
+  double const culled
+    ( seconds ( [&]
+                {
+                  std::vector<std::size_t> sizes;
+                  for (auto const& instances : by_model)
+                  {
+                    sizes.push_back (instances.size());
+                  }
+
+                  // the instances don't move, they are only gathered once
+                  culling.reset (sizes);
+                  noggit::compute_scheduler().parallel_for
+                    ( 0, by_model.size()
+                    , [&] (std::size_t group)
+                      {
+                        std::size_t const begin (culling.group_begin (group));
+                        for (std::size_t i (0); i < by_model[group].size(); ++i)
+                        {
+                          instance const& in (*by_model[group][i]);
+                          culling.set (begin + i, in.get_pos(), in.m->rad * in.scale, in.size_cat, in.transform);
+                        }
+                      }
+                    );
+
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    math::frustum const frustum (frustum_of_frame (frame));
+
+                    culling.cull (noggit::compute_scheduler(), frustum, cull_distance, camera, display_mode::in_3D);
+
+                    culled_visible = 0;
+                    for (std::size_t group (0); group < culling.group_count(); ++group)
+                    {
+                      culled_visible += culling.visible_transforms (group).size();
+                    }
+                  }
+                }
+              )
+    );
+
+  std::printf ("%zu frames, %zu instances of %zu models, %zu visible\n", frames, instance_count, model_count, culled_visible);
+  std::printf ("legacy %8.3f s  culling %8.3f s  speedup %.2fx\n", legacy, culled, legacy / culled);
+
+  return legacy_visible == culled_visible ? 0 : 1;
+}
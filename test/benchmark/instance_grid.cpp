@@ -0,0 +1,162 @@
+// Time to answer the queries the editor asks about model instances on
+// a map with 3 * 3 tiles loaded and 40000 instances: which instances
+// are on a chunk, and which ones might a mouse ray hit. Once like the
+// legacy world_model_instances_storage, looking at every instance, once
+// with the instance_grid only looking at the chunks that matter.
+
+#include <noggit/instance_grid.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct instance
+  {
+    math::vector_3d pos;
+    noggit::instance_grid::bounds bounds;
+  };
+
+  bool hits ( math::vector_3d const& origin, math::vector_3d const& direction
+            , math::vector_3d const& min, math::vector_3d const& max
+            )
+  {
+    float tmin (std::numeric_limits<float>::lowest());
+    float tmax (std::numeric_limits<float>::max());
+
+    for (int i (0); i < 3; ++i)
+    {
+      float const t1 ((min[i] - origin[i]) / direction[i]);
+      float const t2 ((max[i] - origin[i]) / direction[i]);
+      tmin = std::max (tmin, std::min (t1, t2));
+      tmax = std::min (tmax, std::max (t1, t2));
+    }
+
+    return tmax >= tmin;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const queries (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 2000);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> coordinate (31.f * TILESIZE, 34.f * TILESIZE);
+  std::uniform_real_distribution<float> size (1.f, 20.f);
+
+  std::unordered_map<std::uint32_t, instance> instances;
+  noggit::instance_grid grid;
+
+  for (std::uint32_t uid (0); uid < 40000; ++uid)
+  {
+    math::vector_3d const pos (coordinate (engine), 0.f, coordinate (engine));
+    float const radius (size (engine));
+    math::vector_3d const extent (radius, radius, radius);
+
+    instances[uid] = {pos, {pos - extent, pos + extent}};
+    grid.insert (uid, pos, instances[uid].bounds);
+  }
+
+  std::vector<math::vector_3d> chunks;
+  std::vector<std::pair<math::vector_3d, math::vector_3d>> rays;
+  for (std::size_t i (0); i < queries; ++i)
+  {
+    chunks.emplace_back ( std::floor (coordinate (engine) / CHUNKSIZE) * CHUNKSIZE
+                        , 0.f
+                        , std::floor (coordinate (engine) / CHUNKSIZE) * CHUNKSIZE
+                        );
+    rays.emplace_back ( math::vector_3d (coordinate (engine), 200.f, coordinate (engine))
+                      , math::vector_3d (0.3f, -1.f, 0.2f).normalized()
+                      );
+  }
+
+  auto const on_chunk
+    ( [] (instance const& inst, math::vector_3d const& origin)
+      {
+        return inst.pos.x >= origin.x && inst.pos.x < origin.x + CHUNKSIZE
+          && inst.pos.z >= origin.z && inst.pos.z < origin.z + CHUNKSIZE;
+      }
+    );
+
+  std::size_t legacy_found (0);
+  double const legacy_chunks
+    ( seconds ( [&]
+                {
+                  for (auto const& origin : chunks)
+                  {
+                    for (auto const& it : instances)
+                    {
+                      legacy_found += on_chunk (it.second, origin);
+                    }
+                  }
+                }
+              )
+    );
+
+  std::size_t found (0);
+  double const grid_chunks
+    ( seconds ( [&]
+                {
+                  for (auto const& origin : chunks)
+                  {
+                    for (std::uint32_t uid : grid.in_rect (origin.x, origin.z, origin.x + CHUNKSIZE, origin.z + CHUNKSIZE))
+                    {
+                      found += on_chunk (instances.at (uid), origin);
+                    }
+                  }
+                }
+              )
+    );
+
+  std::size_t legacy_hit (0);
+  double const legacy_rays
+    ( seconds ( [&]
+                {
+                  for (auto const& ray : rays)
+                  {
+                    for (auto const& it : instances)
+                    {
+                      legacy_hit += hits (ray.first, ray.second, it.second.bounds.min, it.second.bounds.max);
+                    }
+                  }
+                }
+              )
+    );
+
+  std::size_t hit (0);
+  double const grid_rays
+    ( seconds ( [&]
+                {
+                  for (auto const& ray : rays)
+                  {
+                    hit += grid.hit_candidates ( [&] (math::vector_3d const& min, math::vector_3d const& max)
+                                                 {
+                                                   return hits (ray.first, ray.second, min, max);
+                                                 }
+                                               ).size();
+                  }
+                }
+              )
+    );
+
+  std::printf ("%zu queries over %zu instances\n", queries, instances.size());
+  std::printf ("on chunk  legacy %8.3f s  grid %8.3f s  speedup %.2fx\n", legacy_chunks, grid_chunks, legacy_chunks / grid_chunks);
+  std::printf ("ray       legacy %8.3f s  grid %8.3f s  speedup %.2fx\n", legacy_rays, grid_rays, legacy_rays / grid_rays);
+
+  return found == legacy_found && hit == legacy_hit ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Compares noggit::job_scheduler against the loader queue it replaced:
+// one mutex, one condition variable and a std::list per priority, with
+// a linear search to find objects on removal.
+
+#include <noggit/job_scheduler.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  class legacy_loader
+  {
+  public:
+    legacy_loader (std::size_t thread_count)
+    {
+      for (std::size_t i (0); i < thread_count; ++i)
+      {
+        _threads.emplace_back (&legacy_loader::process, this);
+      }
+    }
+    ~legacy_loader()
+    {
+      _stop = true;
+      _state_changed.notify_all();
+      for (auto& thread : _threads)
+      {
+        thread.join();
+      }
+    }
+
+    void queue (std::function<void()>* job, std::size_t priority)
+    {
+      std::lock_guard<std::mutex> const lock (_guard);
+      _to_load[priority].push_back (job);
+      _state_changed.notify_one();
+      _queued++;
+    }
+
+    void wait_queue_empty()
+    {
+      std::unique_lock<std::mutex> lock (_guard);
+      _state_changed.wait (lock, [&] { return _queued.load() == 0; });
+    }
+
+  private:
+    void process()
+    {
+      while (!_stop)
+      {
+        std::function<void()>* job = nullptr;
+        {
+          std::unique_lock<std::mutex> lock (_guard);
+          _state_changed.wait
+            ( lock
+            , [&]
+              {
+                return !!_stop || std::any_of ( _to_load.begin(), _to_load.end()
+                                              , [] (auto const& to_load) { return !to_load.empty(); }
+                                              );
+              }
+            );
+          if (_stop)
+          {
+            return;
+          }
+          for (auto& to_load : _to_load)
+          {
+            if (!to_load.empty())
+            {
+              job = to_load.front();
+              _currently_loading.emplace_back (job);
+              to_load.pop_front();
+              break;
+            }
+          }
+        }
+
+        (*job)();
+
+        std::lock_guard<std::mutex> const lock (_guard);
+        _currently_loading.remove (job);
+        _state_changed.notify_all();
+        _queued--;
+      }
+    }
+
+    std::mutex _guard;
+    std::condition_variable _state_changed;
+    std::atomic<bool> _stop = {false};
+    std::atomic<int> _queued = {0};
+    std::array<std::list<std::function<void()>*>, 3> _to_load;
+    std::list<std::function<void()>*> _currently_loading;
+    std::list<std::thread> _threads;
+  };
+
+  std::atomic<std::uint64_t> sink (0);
+
+  // stand-in for parsing a small file
+  void fake_load (std::size_t work)
+  {
+    std::uint64_t hash (1469598103934665603ull);
+    for (std::size_t i (0); i < work; ++i)
+    {
+      hash = (hash ^ i) * 1099511628211ull;
+    }
+    sink += hash;
+  }
+
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const job_count (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 200000);
+  std::size_t const work (argc > 2 ? std::strtoul (argv[2], nullptr, 10) : 2000);
+
+  std::printf ("%zu jobs, %zu iterations each\n", job_count, work);
+  std::printf ("%8s %14s %14s %8s\n", "threads", "legacy jobs/s", "new jobs/s", "speedup");
+
+  for (std::size_t threads : {1, 2, 4, 8, 16, 32})
+  {
+    std::vector<std::function<void()>> jobs (job_count, [work] { fake_load (work); });
+
+    double const legacy_time
+      ( seconds ( [&]
+                  {
+                    legacy_loader loader (threads);
+                    for (std::size_t i (0); i < job_count; ++i)
+                    {
+                      loader.queue (&jobs[i], i % 3);
+                    }
+                    loader.wait_queue_empty();
+                  }
+                )
+      );
+
+    double const new_time
+      ( seconds ( [&]
+                  {
+                    noggit::job_scheduler scheduler (threads, 3);
+                    for (std::size_t i (0); i < job_count; ++i)
+                    {
+                      scheduler.schedule (jobs[i], i % 3);
+                    }
+                    scheduler.wait_idle();
+                  }
+                )
+      );
+
+    std::printf ( "%8zu %14.0f %14.0f %7.2fx\n"
+                , threads
+                , job_count / legacy_time
+                , job_count / new_time
+                , legacy_time / new_time
+                );
+  }
+
+  return sink.load() == 0;
+}
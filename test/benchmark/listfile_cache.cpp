@@ -0,0 +1,99 @@
+// Time to get the merged index of a synthetic set of archives, once
+// cold (parse every (listfile), build the index and write the cache,
+// like the first start) and once warm (load the index from the cache,
+// like every later start). The existence checks against StormLib a
+// cold start also does are not part of this, so the real difference is
+// larger.
+
+#include <noggit/listfile_cache.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const archive_count (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 20);
+  std::size_t const names_per_archive (argc > 2 ? std::strtoul (argv[2], nullptr, 10) : 50000);
+
+  auto const folder (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+  boost::filesystem::create_directories (folder);
+  auto const cache_file (folder / "listfile.cache");
+
+  std::vector<boost::filesystem::path> archives;
+  std::vector<std::string> listfiles;
+  for (std::size_t i (0); i < archive_count; ++i)
+  {
+    archives.emplace_back (folder / ("patch-" + std::to_string (i) + ".MPQ"));
+    std::ofstream (archives.back().string()) << "archive " << i;
+
+    std::string text;
+    for (std::size_t j (0); j < names_per_archive; ++j)
+    {
+      text += "World\\Maps\\Azeroth\\Azeroth_" + std::to_string (i) + "_" + std::to_string (j) + ".adt\r\n";
+    }
+    listfiles.emplace_back (std::move (text));
+  }
+
+  std::size_t cold_names (0);
+  double const cold
+    ( seconds ( [&]
+                {
+                  std::vector<std::vector<std::string>> names_by_archive;
+                  std::vector<noggit::listfile_cache::archive> entries;
+                  for (std::size_t i (0); i < archive_count; ++i)
+                  {
+                    auto listfile (noggit::parse_listfile (listfiles[i].data(), listfiles[i].size()));
+                    names_by_archive.emplace_back (std::move (listfile.names));
+                    entries.push_back ({archives[i], true});
+                  }
+
+                  noggit::archive_index const index (names_by_archive);
+                  cold_names = index.size();
+                  noggit::listfile_cache::write (cache_file, entries, index);
+                }
+              )
+    );
+
+  std::size_t warm_names (0);
+  double const warm
+    ( seconds ( [&]
+                {
+                  noggit::listfile_cache const cache (cache_file);
+                  if (auto cached = cache.find (archives))
+                  {
+                    warm_names = cached->index.size();
+                  }
+                }
+              )
+    );
+
+  std::printf ("%zu archives, %zu names each, cache of %.1f MiB\n"
+              , archive_count
+              , names_per_archive
+              , boost::filesystem::file_size (cache_file) / (1024.0 * 1024.0)
+              );
+  std::printf ("cold %8.3f s (%zu names)\n", cold, cold_names);
+  std::printf ("warm %8.3f s (%zu names)\n", warm, warm_names);
+  std::printf ("speedup %.2fx\n", cold / warm);
+
+  boost::filesystem::remove_all (folder);
+  return cold_names == warm_names ? 0 : 1;
+}
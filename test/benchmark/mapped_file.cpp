@@ -0,0 +1,163 @@
+// Peak resident memory and time to "load" a synthetic project of loose
+// texture files, once the way MPQFile and blp_texture used to (read the
+// file into a vector, copy the mips out of it) and once borrowing the
+// mips from read_file_contents(). Each mode runs in its own process so
+// that the peak of one does not hide the other.
+
+#include <noggit/mapped_file.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+  // header size of a BLP2, the "mips" are everything after it
+  std::size_t const header_size (148);
+
+  double peak_rss_mib()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo (GetCurrentProcess(), &counters, sizeof (counters));
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#elif defined (__APPLE__)
+    rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#endif
+  }
+
+  std::vector<boost::filesystem::path> files_in (boost::filesystem::path const& folder)
+  {
+    std::vector<boost::filesystem::path> files;
+    for (auto const& entry : boost::filesystem::directory_iterator (folder))
+    {
+      files.push_back (entry.path());
+    }
+    return files;
+  }
+
+  // touch every cache line like an upload would
+  std::uint64_t checksum (char const* data, std::size_t size)
+  {
+    std::uint64_t sum (0);
+    for (std::size_t i (0); i < size; i += 64)
+    {
+      sum += static_cast<unsigned char> (data[i]);
+    }
+    return sum;
+  }
+
+  std::uint64_t load_copying (std::vector<boost::filesystem::path> const& files)
+  {
+    std::vector<std::vector<char>> mips;
+    std::uint64_t sum (0);
+
+    for (auto const& path : files)
+    {
+      std::ifstream input (path.string(), std::ios_base::binary);
+      input.seekg (0, std::ios::end);
+      std::vector<char> buffer (static_cast<std::size_t> (input.tellg()));
+      input.seekg (0, std::ios::beg);
+      input.read (buffer.data(), buffer.size());
+
+      mips.emplace_back (buffer.begin() + header_size, buffer.end());
+    }
+
+    for (auto const& mip : mips)
+    {
+      sum += checksum (mip.data(), mip.size());
+    }
+    return sum;
+  }
+
+  std::uint64_t load_borrowing (std::vector<boost::filesystem::path> const& files)
+  {
+    std::vector<std::pair<std::shared_ptr<char const>, std::size_t>> mips;
+    std::uint64_t sum (0);
+
+    for (auto const& path : files)
+    {
+      auto const contents (noggit::read_file_contents (path));
+      mips.emplace_back ( std::shared_ptr<char const> (contents->data, contents->data.get() + header_size)
+                        , contents->size - header_size
+                        );
+    }
+
+    for (auto const& mip : mips)
+    {
+      sum += checksum (mip.first.get(), mip.second);
+    }
+    return sum;
+  }
+
+  int run (char const* mode, boost::filesystem::path const& folder)
+  {
+    auto const files (files_in (folder));
+
+    auto const start (std::chrono::steady_clock::now());
+    std::uint64_t const sum (std::strcmp (mode, "copy") == 0 ? load_copying (files) : load_borrowing (files));
+    double const time (std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count());
+
+    std::printf ("%-8s %8.1f MiB peak RSS %8.3f s (checksum %llu)\n", mode, peak_rss_mib(), time, static_cast<unsigned long long> (sum));
+    return 0;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  if (argc == 4 && std::strcmp (argv[1], "--run") == 0)
+  {
+    return run (argv[2], argv[3]);
+  }
+
+  std::size_t const file_count (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 1000);
+  std::size_t const file_size (argc > 2 ? std::strtoul (argv[2], nullptr, 10) : 256 * 1024);
+
+  auto const folder (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path());
+  boost::filesystem::create_directories (folder);
+
+  std::vector<char> contents (file_size);
+  for (std::size_t i (0); i < file_count; ++i)
+  {
+    for (std::size_t j (0); j < file_size; ++j)
+    {
+      contents[j] = static_cast<char> (i + j);
+    }
+    std::ofstream ((folder / (std::to_string (i) + ".blp")).string(), std::ios_base::binary)
+      .write (contents.data(), contents.size());
+  }
+
+  std::printf ("%zu loose files of %zu KiB\n", file_count, file_size / 1024);
+  std::fflush (stdout);
+
+  int result (0);
+  for (char const* mode : {"copy", "borrow"})
+  {
+    std::string const command ("\"" + std::string (argv[0]) + "\" --run " + mode + " \"" + folder.string() + "\"");
+    result |= std::system (command.c_str());
+  }
+
+  boost::filesystem::remove_all (folder);
+  return result;
+}
@@ -0,0 +1,246 @@
+// Time to compress and decompress the alphamaps of a tile, 256 chunks
+// with three layers each, with what Alphamap::compress and
+// Alphamap::readCompressed did before, then with mcal::compress and
+// mcal::decompress.
+
+#include <noggit/mcal_compression.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  using alphamap = std::array<std::uint8_t, 64 * 64>;
+
+  struct compressed_mcal_entry
+  {
+    std::uint8_t count : 7;
+    std::uint8_t mode : 1;
+
+    std::uint8_t value[];
+  };
+
+  // Alphamap::compress, without the optional and lambdas
+  std::vector<std::uint8_t> legacy_compress (alphamap const& amap)
+  {
+    std::vector<std::uint8_t> data (amap.begin(), amap.end());
+    auto current (data.begin());
+    auto const end (data.end());
+    int column_pos = 0;
+    bool copying = false;
+    std::size_t copy_entry = 0;
+
+    std::vector<std::uint8_t> result;
+
+    for (; current != end; ++current)
+    {
+      std::int8_t fill (0);
+      column_pos %= 64;
+      while ((current + 1 < end) && *current == *(current + 1) && column_pos < 63)
+      {
+        ++current;
+        ++fill;
+        ++column_pos;
+      }
+      if (fill)
+      {
+        ++fill;
+        ++column_pos;
+      }
+
+      if (fill)
+      {
+        copying = false;
+        result.emplace_back();
+        result.emplace_back (*current);
+        compressed_mcal_entry* e (reinterpret_cast<compressed_mcal_entry*> (&*(result.rbegin() + 1)));
+        e->mode = 1;
+        e->count = fill;
+        column_pos %= 64;
+      }
+      else
+      {
+        if (!copying)
+        {
+          copying = true;
+          copy_entry = result.size();
+          result.emplace_back();
+          result.emplace_back (*current);
+          reinterpret_cast<compressed_mcal_entry*> (&result[copy_entry])->mode = 0;
+          reinterpret_cast<compressed_mcal_entry*> (&result[copy_entry])->count = 1;
+          column_pos %= 64;
+        }
+        else
+        {
+          result.emplace_back (*current);
+          reinterpret_cast<compressed_mcal_entry*> (&result[copy_entry])->count++;
+        }
+        column_pos++;
+      }
+    }
+
+    return result;
+  }
+
+  // Alphamap::readCompressed
+  void legacy_decompress (std::uint8_t const* input, alphamap& amap)
+  {
+    for (std::size_t offset_output (0); offset_output < 4096;)
+    {
+      compressed_mcal_entry const* e = reinterpret_cast<compressed_mcal_entry const*> (input);
+      std::size_t count = std::min<std::size_t> (e->count, 4096 - offset_output);
+      ++input;
+
+      if (count == 0)
+      {
+        continue;
+      }
+
+      if (e->mode)
+      {
+        std::memset (&amap[offset_output], e->value[0], count);
+        ++input;
+      }
+      else
+      {
+        std::memcpy (&amap[offset_output], e->value, count);
+        input += count;
+      }
+
+      offset_output += count;
+    }
+  }
+
+  // painted terrain: runs of a few to a few dozen alphas, some of them
+  // gradients that don't compress
+  alphamap painted_alphamap (std::mt19937& engine)
+  {
+    std::uniform_int_distribution<int> value (0, 255);
+    std::uniform_int_distribution<int> length (1, 40);
+    std::bernoulli_distribution gradient (0.3);
+
+    alphamap alphas;
+    for (std::size_t i (0); i < alphas.size();)
+    {
+      int const a (value (engine));
+      bool const g (gradient (engine));
+      for (int n (length (engine)); n && i < alphas.size(); --n, ++i)
+      {
+        alphas[i] = static_cast<std::uint8_t> (g ? a + n : a);
+      }
+    }
+    return alphas;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const rounds (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 20);
+
+  std::mt19937 engine (42);
+  std::vector<alphamap> alphamaps (256 * 3);
+  for (alphamap& alphas : alphamaps)
+  {
+    alphas = painted_alphamap (engine);
+  }
+
+  std::vector<std::vector<std::uint8_t>> legacy_outputs (alphamaps.size());
+  double const old_compress_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rounds; ++r)
+                  {
+                    for (std::size_t i (0); i < alphamaps.size(); ++i)
+                    {
+                      legacy_outputs[i] = legacy_compress (alphamaps[i]);
+                    }
+                  }
+                }
+              )
+    );
+
+  std::vector<std::uint8_t> output (alphamaps.size() * noggit::mcal::max_compressed_size);
+  std::vector<std::size_t> sizes (alphamaps.size());
+  double const new_compress_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rounds; ++r)
+                  {
+                    for (std::size_t i (0); i < alphamaps.size(); ++i)
+                    {
+                      sizes[i] = noggit::mcal::compress
+                        (alphamaps[i].data(), output.data() + i * noggit::mcal::max_compressed_size);
+                    }
+                  }
+                }
+              )
+    );
+
+  alphamap result;
+  std::size_t old_sum (0);
+  double const old_decompress_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rounds; ++r)
+                  {
+                    for (auto const& compressed : legacy_outputs)
+                    {
+                      legacy_decompress (compressed.data(), result);
+                      old_sum += result[r % result.size()];
+                    }
+                  }
+                }
+              )
+    );
+
+  std::size_t new_sum (0);
+  bool valid (true);
+  double const new_decompress_time
+    ( seconds ( [&]
+                {
+                  for (std::size_t r (0); r < rounds; ++r)
+                  {
+                    for (std::size_t i (0); i < alphamaps.size(); ++i)
+                    {
+                      valid &= noggit::mcal::decompress
+                        (output.data() + i * noggit::mcal::max_compressed_size, sizes[i], result.data()).valid;
+                      new_sum += result[r % result.size()];
+                    }
+                  }
+                }
+              )
+    );
+
+  std::size_t compressed_bytes (0);
+  for (std::size_t size : sizes)
+  {
+    compressed_bytes += size;
+  }
+
+  double const megabytes (rounds * alphamaps.size() * 4096 / 1e6);
+  std::printf ( "%zu rounds of %zu alphamaps, compressed to %.1f%%\n", rounds, alphamaps.size()
+              , 100. * compressed_bytes / (alphamaps.size() * 4096)
+              );
+  std::printf ( "compress   old %8.1f MB/s  new %8.1f MB/s  speedup %.2fx\n"
+              , megabytes / old_compress_time, megabytes / new_compress_time, old_compress_time / new_compress_time
+              );
+  std::printf ( "decompress old %8.1f MB/s  new %8.1f MB/s  speedup %.2fx\n"
+              , megabytes / old_decompress_time, megabytes / new_decompress_time, old_decompress_time / new_decompress_time
+              );
+
+  return valid && old_sum == new_sum ? 0 : 1;
+}
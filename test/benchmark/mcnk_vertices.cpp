@@ -0,0 +1,244 @@
+// Time for the chunk part of loading a tile: the vertices of its 256
+// chunks and three compressed alphamaps each. Once one chunk after the
+// other with a read per value like MapChunk used to, once one chunk
+// after the other reading the vertices in bulk, once with the chunks
+// split over a job_scheduler like MapTile::finishLoading does now. The
+// rest of the chunk (textures, liquids, index strips) isn't part of it.
+
+#include <noggit/job_scheduler.hpp>
+#include <noggit/MapHeaders.h>
+#include <noggit/mcal_compression.hpp>
+#include <noggit/mcnk_vertices.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct vertex
+  {
+    math::vector_3d position;
+    math::vector_3d normal;
+    math::vector_3d color;
+  };
+
+  struct chunk
+  {
+    std::array<vertex, noggit::mcnk_vertices::vertex_count> vertices;
+    std::array<std::array<std::uint8_t, noggit::mcal::alphamap_size>, 3> alphamaps;
+    float min_height;
+    float max_height;
+  };
+
+  struct chunk_file
+  {
+    std::size_t vertices;
+    std::array<std::size_t, 3> alphamaps;
+    std::array<std::size_t, 3> alphamap_sizes;
+  };
+
+  struct tile_file
+  {
+    std::vector<char> data;
+    std::array<chunk_file, 256> chunks;
+  };
+
+  // MPQFile::read
+  struct cursor
+  {
+    void read (void* dest, std::size_t bytes)
+    {
+      std::memcpy (dest, data + position, bytes);
+      position += bytes;
+    }
+
+    char const* data;
+    std::size_t position;
+  };
+
+  tile_file random_tile (std::mt19937& engine)
+  {
+    tile_file tile;
+    std::uniform_real_distribution<float> height (-100.f, 300.f);
+    std::uniform_int_distribution<int> byte (0, 255);
+    std::uniform_int_distribution<int> run (1, 40);
+
+    for (chunk_file& chunk : tile.chunks)
+    {
+      chunk.vertices = tile.data.size();
+      for (std::size_t i (0); i < noggit::mcnk_vertices::vertex_count; ++i)
+      {
+        float const h (height (engine));
+        char bytes[sizeof (float)];
+        std::memcpy (bytes, &h, sizeof (float));
+        tile.data.insert (tile.data.end(), bytes, bytes + sizeof (float));
+      }
+      for (std::size_t i (0); i < noggit::mcnk_vertices::mcnr_size + noggit::mcnk_vertices::mccv_size; ++i)
+      {
+        tile.data.push_back (static_cast<char> (byte (engine)));
+      }
+
+      for (std::size_t layer (0); layer < 3; ++layer)
+      {
+        // painted looking alphas: runs of the same value
+        std::array<std::uint8_t, noggit::mcal::alphamap_size> alphas;
+        for (std::size_t i (0); i < alphas.size();)
+        {
+          std::size_t const end (std::min (alphas.size(), i + run (engine)));
+          std::uint8_t const value (static_cast<std::uint8_t> (byte (engine)));
+          std::fill (alphas.begin() + i, alphas.begin() + end, value);
+          i = end;
+        }
+
+        std::vector<std::uint8_t> compressed (noggit::mcal::max_compressed_size);
+        compressed.resize (noggit::mcal::compress (alphas.data(), compressed.data()));
+
+        chunk.alphamaps[layer] = tile.data.size();
+        chunk.alphamap_sizes[layer] = compressed.size();
+        tile.data.insert (tile.data.end(), compressed.begin(), compressed.end());
+      }
+    }
+
+    return tile;
+  }
+
+  math::vector_3d origin (std::size_t index)
+  {
+    return {17 * TILESIZE + (index % 16) * CHUNKSIZE, 20.f, 31 * TILESIZE + (index / 16) * CHUNKSIZE};
+  }
+
+  void read_alphamaps (tile_file const& tile, chunk_file const& file, chunk& out)
+  {
+    for (std::size_t layer (0); layer < 3; ++layer)
+    {
+      noggit::mcal::decompress
+        ( reinterpret_cast<std::uint8_t const*> (tile.data.data() + file.alphamaps[layer])
+        , file.alphamap_sizes[layer]
+        , out.alphamaps[layer].data()
+        );
+    }
+  }
+
+  // MapChunk's single reads
+  void read_chunk_legacy (tile_file const& tile, std::size_t index, chunk& out)
+  {
+    cursor f {tile.data.data(), tile.chunks[index].vertices};
+    math::vector_3d const base (origin (index));
+
+    out.min_height = 9999999.0f;
+    out.max_height = -9999999.0f;
+
+    vertex* cv_ptr = out.vertices.data();
+    for (int j = 0; j < 17; ++j)
+    {
+      for (int i = 0; i < ((j % 2) ? 8 : 9); ++i)
+      {
+        float h, xpos, zpos;
+        f.read(&h, 4);
+        xpos = i * UNITSIZE;
+        zpos = j * 0.5f * UNITSIZE;
+        if (j % 2)
+        {
+          xpos += UNITSIZE * 0.5f;
+        }
+        cv_ptr->position = math::vector_3d(base.x + xpos, base.y + h, base.z + zpos);
+
+        out.min_height = std::min(out.min_height, cv_ptr->position.y);
+        out.max_height = std::max(out.max_height, cv_ptr->position.y);
+
+        cv_ptr++;
+      }
+    }
+
+    char nor[3];
+    for (vertex& v : out.vertices)
+    {
+      f.read(nor, 3);
+      v.normal = math::vector_3d(nor[0] / 127.0f, nor[2] / 127.0f, nor[1] / 127.0f);
+    }
+
+    unsigned char t[4];
+    for (vertex& v : out.vertices)
+    {
+      f.read(t, 4);
+      v.color = math::vector_3d((float)t[2] / 127.0f, (float)t[1] / 127.0f, (float)t[0] / 127.0f);
+    }
+
+    read_alphamaps (tile, tile.chunks[index], out);
+  }
+
+  void read_chunk (tile_file const& tile, std::size_t index, chunk& out)
+  {
+    char const* data (tile.data.data() + tile.chunks[index].vertices);
+
+    auto const range (noggit::mcnk_vertices::read_heights (data, origin (index), out.vertices.data()));
+    out.min_height = range.min;
+    out.max_height = range.max;
+    data += noggit::mcnk_vertices::mcvt_size;
+    noggit::mcnk_vertices::read_normals (data, out.vertices.data());
+    data += noggit::mcnk_vertices::mcnr_size;
+    noggit::mcnk_vertices::read_colors (data, out.vertices.data());
+
+    read_alphamaps (tile, tile.chunks[index], out);
+  }
+
+  bool same (std::vector<chunk> const& lhs, std::vector<chunk> const& rhs)
+  {
+    return std::memcmp (lhs.data(), rhs.data(), lhs.size() * sizeof (chunk)) == 0;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const tiles (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 20);
+
+  std::mt19937 engine (42);
+  std::vector<tile_file> files;
+  for (std::size_t i (0); i < tiles; ++i)
+  {
+    files.emplace_back (random_tile (engine));
+  }
+
+  noggit::job_scheduler scheduler (std::max (2u, std::thread::hardware_concurrency()) - 1, 1);
+
+  std::vector<chunk> legacy (256);
+  std::vector<chunk> bulk (256);
+  std::vector<chunk> parallel (256);
+  double legacy_time (0.);
+  double bulk_time (0.);
+  double parallel_time (0.);
+  bool all_same (true);
+
+  for (tile_file const& tile : files)
+  {
+    legacy_time += seconds ([&] { for (std::size_t i (0); i < 256; ++i) { read_chunk_legacy (tile, i, legacy[i]); } });
+    bulk_time += seconds ([&] { for (std::size_t i (0); i < 256; ++i) { read_chunk (tile, i, bulk[i]); } });
+    parallel_time += seconds
+      ([&] { scheduler.parallel_for (0, 256, [&] (std::size_t i) { read_chunk (tile, i, parallel[i]); }); });
+
+    all_same = all_same && same (legacy, bulk) && same (legacy, parallel);
+  }
+
+  std::printf ( "per tile: single reads %7.3f ms  bulk %7.3f ms  bulk on %zu workers %7.3f ms\n"
+              , 1e3 * legacy_time / tiles, 1e3 * bulk_time / tiles
+              , scheduler.thread_count() + 1, 1e3 * parallel_time / tiles
+              );
+
+  return all_same ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+// Time to skin the vertices of an animated model with 60 bones, like
+// Model::animate does every frame for every animated model in view:
+// once with the scalar kernel, which is the legacy per vertex loop,
+// once with the best kernel of this build.
+
+#include <noggit/model_skinning.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const frames (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 2000);
+  std::size_t const bone_count (60);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> real (-1.f, 1.f);
+  std::uniform_int_distribution<int> bone (0, bone_count - 1);
+
+  std::vector<math::matrix_4x4> mat, mrot;
+  for (std::size_t i (0); i < bone_count; ++i)
+  {
+    math::matrix_4x4 m (math::matrix_4x4::unit);
+    for (std::size_t row (0); row < 3; ++row)
+    {
+      for (std::size_t column (0); column < 4; ++column)
+      {
+        m (row, column, m (row, column) + real (engine) * 0.3f);
+      }
+    }
+    mat.push_back (m);
+    mrot.push_back (m);
+  }
+
+  // most vertices of creatures follow two bones, some one or three
+  std::vector<ModelVertex> bind_pose (4000);
+  for (std::size_t i (0); i < bind_pose.size(); ++i)
+  {
+    ModelVertex& vertex (bind_pose[i]);
+    vertex.position = {real (engine) * 3.f, real (engine) * 3.f, real (engine) * 3.f};
+    vertex.normal = math::vector_3d (real (engine), real (engine), 1.f).normalized();
+
+    int const influences (i % 8 == 0 ? 1 : i % 8 == 1 ? 3 : 2);
+    for (int b (0); b < 4; ++b)
+    {
+      vertex.bones[b] = b < influences ? bone (engine) : 0;
+      vertex.weights[b] = b < influences ? 255 / influences + (b == 0 ? 255 % influences : 0) : 0;
+    }
+  }
+
+  noggit::model_skinning skinning (bind_pose);
+  std::vector<ModelVertex> scalar_output (bind_pose), output (bind_pose);
+
+  double const scalar
+    ( seconds ( [&]
+                {
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    skinning.skin (mat, mrot, scalar_output.data(), noggit::skinning_kernel::scalar);
+                  }
+                }
+              )
+    );
+
+  double const best
+    ( seconds ( [&]
+                {
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    skinning.skin (mat, mrot, output.data());
+                  }
+                }
+              )
+    );
+
+  bool same (true);
+  for (std::size_t i (0); i < output.size(); ++i)
+  {
+    same = same && (output[i].position - scalar_output[i].position).length() < 1e-3f;
+  }
+
+  std::printf ("%zu frames of %zu vertices\n", frames, bind_pose.size());
+  std::printf ( "scalar %8.3f s  %s %8.3f s  speedup %.2fx\n"
+              , scalar
+              , noggit::default_skinning_kernel() == noggit::skinning_kernel::sse ? "sse   " : "scalar"
+              , best
+              , scalar / best
+              );
+
+  return same ? 0 : 1;
+}
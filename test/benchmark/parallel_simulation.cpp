@@ -0,0 +1,195 @@
+// Time to simulate the frames of a doodad heavy scene, 300 animated
+// models each skinning 1500 vertices and updating two emitters: once
+// serially like the render thread used to, then spread over 2, 4, ...
+// cores with simulate_parallel, to see the frame time scale.
+
+#include <noggit/job_scheduler.hpp>
+#include <noggit/model_skinning.hpp>
+#include <noggit/parallel_simulation.hpp>
+#include <noggit/particle_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::size_t const model_count (300);
+  std::size_t const bone_count (40);
+  float const frame_time (0.016f);
+
+  struct model
+  {
+    model (unsigned seed)
+      : random (seed)
+      , skinning (bind_pose())
+      , vertices (1500)
+      , emitters (2, noggit::particle_pool (10000))
+    {
+      for (std::size_t i (0); i < bone_count; ++i)
+      {
+        math::matrix_4x4 m (math::matrix_4x4::unit);
+        m (0, 3, real (-1.f, 1.f));
+        bones.push_back (m);
+      }
+    }
+
+    std::vector<ModelVertex> bind_pose()
+    {
+      std::vector<ModelVertex> vertices (1500);
+      for (auto& vertex : vertices)
+      {
+        vertex.position = {real (-3.f, 3.f), real (-3.f, 3.f), real (-3.f, 3.f)};
+        vertex.normal = {0.f, 0.f, 1.f};
+        vertex.bones[0] = std::uniform_int_distribution<int> (0, bone_count - 1) (random);
+        vertex.bones[1] = std::uniform_int_distribution<int> (0, bone_count - 1) (random);
+        vertex.bones[2] = vertex.bones[3] = 0;
+        vertex.weights[0] = 128;
+        vertex.weights[1] = 127;
+        vertex.weights[2] = vertex.weights[3] = 0;
+      }
+      return vertices;
+    }
+
+    float real (float min, float max)
+    {
+      return std::uniform_real_distribution<float> (min, max) (random);
+    }
+
+    void update (float dt)
+    {
+      for (auto& bone : bones)
+      {
+        bone (1, 3, bone (1, 3) + dt);
+      }
+      skinning.skin (bones, bones, vertices.data());
+
+      for (auto& emitter : emitters)
+      {
+        for (int i (0); i < 20; ++i)
+        {
+          Particle p;
+          p.pos = p.origin = {real (-1.f, 1.f), real (-1.f, 1.f), real (-1.f, 1.f)};
+          p.speed = p.dir = {real (-3.f, 3.f), real (0.f, 3.f), real (-3.f, 3.f)};
+          p.down = {0.f, -1.f, 0.f};
+          for (auto& corner : p.corners)
+          {
+            corner = {real (-1.f, 1.f), real (-1.f, 1.f), 0.f};
+          }
+          p.size = p.life = 0.f;
+          p.maxlife = real (0.5f, 2.f);
+          p.tile = 0;
+          emitter.add (p);
+        }
+        emitter.update (dt, 9.8f, 0.5f, 0.2f, {0.5f, {{0.1f, 1.f, 0.5f}}, {}});
+      }
+    }
+
+    float checksum() const
+    {
+      float sum (vertices.back().position.y);
+      for (auto const& emitter : emitters)
+      {
+        sum += static_cast<float> (emitter.size());
+      }
+      return sum;
+    }
+
+    std::minstd_rand random;
+    std::vector<math::matrix_4x4> bones;
+    noggit::model_skinning skinning;
+    std::vector<ModelVertex> vertices;
+    std::vector<noggit::particle_pool> emitters;
+  };
+
+  std::vector<std::unique_ptr<model>> make_scene()
+  {
+    std::vector<std::unique_ptr<model>> scene;
+    for (std::size_t i (0); i < model_count; ++i)
+    {
+      scene.emplace_back (std::make_unique<model> (static_cast<unsigned> (i + 1)));
+    }
+    return scene;
+  }
+
+  float checksum (std::vector<std::unique_ptr<model>> const& scene)
+  {
+    float sum (0.f);
+    for (auto const& m : scene)
+    {
+      sum += m->checksum();
+    }
+    return sum;
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const frames (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 200);
+  std::size_t const cores (std::max (2u, std::thread::hardware_concurrency()));
+
+  auto serial_scene (make_scene());
+  double const serial
+    ( seconds ( [&]
+                {
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    for (auto& m : serial_scene)
+                    {
+                      m->update (frame_time);
+                    }
+                  }
+                }
+              )
+    );
+  float const expected (checksum (serial_scene));
+
+  std::printf ("%zu frames of %zu models\n", frames, model_count);
+  std::printf ("1 core   %8.3f ms/frame\n", serial * 1000. / frames);
+
+  bool same (true);
+  for (std::size_t used (2); used <= cores; used *= 2)
+  {
+    auto scene (make_scene());
+    std::vector<model*> models;
+    for (auto& m : scene)
+    {
+      models.push_back (m.get());
+    }
+
+    // the calling thread helps, like the render thread does
+    noggit::job_scheduler scheduler (used - 1, 1);
+    double const parallel
+      ( seconds ( [&]
+                  {
+                    for (std::size_t frame (0); frame < frames; ++frame)
+                    {
+                      noggit::simulate_parallel ( scheduler, models, frame_time, 0.1f
+                                                , [] (model& m, float step) { m.update (step); }
+                                                );
+                    }
+                  }
+                )
+      );
+
+    same = same && checksum (scene) == expected;
+    std::printf ( "%zu cores %8.3f ms/frame  speedup %.2fx\n"
+                , used, parallel * 1000. / frames, serial / parallel
+                );
+  }
+
+  return same ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// Time to simulate and gather the vertices of 10000 emitters spawning 2
+// particles a frame, about 120 particles alive in each: once like the legacy
+// ParticleSystem, with a std::list of particles and vectors allocated
+// again for every draw, once with the particles in a particle_pool and
+// staging vectors kept from one frame to the next.
+
+#include <noggit/particle_pool.hpp>
+
+#include <math/interpolation.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::size_t const emitters (10000);
+  std::size_t const spawned_per_frame (2);
+  float const dt (0.016f);
+
+  template<class T>
+  T lifeRamp(float life, float mid, const T &a, const T &b, const T &c)
+  {
+    if (life <= mid) return math::interpolation::linear(life / mid, a, b);
+    else return math::interpolation::linear((life - mid) / (1.0f - mid), b, c);
+  }
+
+  void legacy_update ( std::list<Particle>& particles, float grav, float deaccel, float slowdown
+                     , noggit::particle_ramp const& ramp
+                     )
+  {
+    float mspeed = 1.0f;
+
+    for (std::list<Particle>::iterator it = particles.begin(); it != particles.end();) {
+      Particle &p = *it;
+      p.speed += p.down * grav * dt - p.dir * deaccel * dt;
+
+      if (slowdown>0) {
+        mspeed = expf(-1.0f * slowdown * p.life);
+      }
+      p.pos += p.speed * mspeed * dt;
+
+      p.life += dt;
+      float rlife = p.life / p.maxlife;
+      p.size = lifeRamp<float>(rlife, ramp.mid, ramp.sizes[0], ramp.sizes[1], ramp.sizes[2]);
+      p.color = lifeRamp<math::vector_4d>(rlife, ramp.mid, ramp.colors[0], ramp.colors[1], ramp.colors[2]);
+
+      if (rlife >= 1.0f)
+      {
+        it = particles.erase (it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  struct staging
+  {
+    std::vector<math::vector_3d> vertices;
+    std::vector<math::vector_4d> colors;
+
+    void clear()
+    {
+      vertices.clear();
+      colors.clear();
+    }
+  };
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const frames (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 50);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> real (-1.f, 1.f);
+
+  std::vector<Particle> spawns;
+  for (std::size_t i (0); i < emitters * spawned_per_frame; ++i)
+  {
+    Particle p;
+    p.pos = p.origin = {real (engine), real (engine), real (engine)};
+    p.speed = {real (engine), real (engine), real (engine)};
+    p.down = {0.f, -1.f, 0.f};
+    p.dir = {real (engine), real (engine), real (engine)};
+    for (auto& corner : p.corners)
+    {
+      corner = {real (engine), real (engine), real (engine)};
+    }
+    p.size = p.life = 0.f;
+    p.maxlife = 0.5f + std::abs (real (engine));
+    p.tile = 0;
+    spawns.push_back (p);
+  }
+
+  noggit::particle_ramp const ramp
+    { 0.5f
+    , {{0.1f, 1.f, 0.5f}}
+    , {{math::vector_4d (1.f, 0.f, 0.f, 0.f), math::vector_4d (1.f, 1.f, 1.f, 1.f), math::vector_4d (0.f, 0.f, 1.f, 0.f)}}
+    };
+
+  float legacy_sum (0.f);
+  double const legacy
+    ( seconds ( [&]
+                {
+                  std::vector<std::list<Particle>> lists (emitters);
+
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    for (std::size_t e (0); e < emitters; ++e)
+                    {
+                      for (std::size_t i (0); i < spawned_per_frame; ++i)
+                      {
+                        lists[e].push_back (spawns[e * spawned_per_frame + i]);
+                      }
+                      legacy_update (lists[e], 9.8f, 0.5f, 0.2f, ramp);
+
+                      staging draw;
+                      for (auto const& p : lists[e])
+                      {
+                        for (auto const& corner : p.corners)
+                        {
+                          draw.vertices.push_back (p.pos + corner * p.size);
+                          draw.colors.push_back (p.color);
+                        }
+                      }
+                      legacy_sum += draw.vertices.empty() ? 0.f : draw.vertices.back().y;
+                    }
+                  }
+                }
+              )
+    );
+
+  float pool_sum (0.f);
+  double const pooled
+    ( seconds ( [&]
+                {
+                  std::vector<noggit::particle_pool> pools (emitters, noggit::particle_pool (1000));
+                  std::vector<staging> draws (emitters);
+
+                  for (std::size_t frame (0); frame < frames; ++frame)
+                  {
+                    for (std::size_t e (0); e < emitters; ++e)
+                    {
+                      noggit::particle_pool& pool (pools[e]);
+                      for (std::size_t i (0); i < spawned_per_frame; ++i)
+                      {
+                        pool.add (spawns[e * spawned_per_frame + i]);
+                      }
+                      pool.update (dt, 9.8f, 0.5f, 0.2f, ramp);
+
+                      staging& draw (draws[e]);
+                      draw.clear();
+                      for (std::size_t i (0); i < pool.size(); ++i)
+                      {
+                        math::vector_3d const position (pool.position (i));
+                        float const size (pool.particle_size (i));
+                        for (auto const& corner : pool.corners (i))
+                        {
+                          draw.vertices.push_back (position + corner * size);
+                          draw.colors.push_back (pool.color (i));
+                        }
+                      }
+                      pool_sum += draw.vertices.empty() ? 0.f : draw.vertices.back().y;
+                    }
+                  }
+                }
+              )
+    );
+
+  std::printf ("%zu frames of %zu emitters\n", frames, emitters);
+  std::printf ("legacy %8.3f s  pool %8.3f s  speedup %.2fx\n", legacy, pooled, legacy / pooled);
+
+  // the pool reorders particles, only check that both simulated something
+  return legacy_sum != 0.f && pool_sum != 0.f ? 0 : 1;
+}
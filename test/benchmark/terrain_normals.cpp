@@ -0,0 +1,175 @@
+// Time to recompute the normals of the 16 by 16 chunks of a tile, which
+// is what a large brush stroke touches: once with a height lookup through
+// a std::function for each of the four points around every vertex like
+// MapChunk::recalcNorms used to, once with chunk_normals only looking up
+// the points on the chunk's border.
+
+#include <noggit/terrain_normals.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  struct vertex
+  {
+    math::vector_3d position;
+    math::vector_3d normal;
+  };
+
+  using chunk = std::array<vertex, noggit::chunk_normals::vertex_count>;
+
+  // MapTile::GetVertex then MapChunk::GetVertex for a tile at the origin
+  boost::optional<float> height (std::vector<chunk> const& chunks, float x, float z)
+  {
+    int const xcol ((int)(x / CHUNKSIZE));
+    int const ycol ((int)(z / CHUNKSIZE));
+    if (x < 0.f || z < 0.f || xcol > 15 || ycol > 15)
+    {
+      return boost::none;
+    }
+
+    float const xdiff (x - xcol * CHUNKSIZE);
+    float const zdiff (z - ycol * CHUNKSIZE);
+    int const row (static_cast<int> (zdiff / (UNITSIZE * 0.5f) + 0.5f));
+    int const column (static_cast<int> ((xdiff - UNITSIZE * 0.5f * (row % 2)) / UNITSIZE + 0.5f));
+    if (row < 0 || column < 0 || row > 16 || column > ((row % 2) ? 8 : 9))
+    {
+      return boost::none;
+    }
+
+    return chunks[ycol * 16 + xcol][17 * (row / 2) + ((row % 2) ? 9 : 0) + column].position.y;
+  }
+
+  void legacy_normals (chunk& vertices, std::function<boost::optional<float> (float, float)> height)
+  {
+    float const half_unit = UNITSIZE / 2.f;
+
+    auto point
+    (
+      [&] (math::vector_3d& v, float xdiff, float zdiff)
+      {
+        return math::vector_3d
+               ( v.x + xdiff
+               , height (v.x + xdiff, v.z + zdiff).get_value_or (v.y)
+               , v.z + zdiff
+               );
+      }
+    );
+
+    for (vertex& v : vertices)
+    {
+      math::vector_3d const P1 (point (v.position, -half_unit, -half_unit));
+      math::vector_3d const P2 (point (v.position,  half_unit, -half_unit));
+      math::vector_3d const P3 (point (v.position,  half_unit,  half_unit));
+      math::vector_3d const P4 (point (v.position, -half_unit,  half_unit));
+
+      math::vector_3d const N1 ((P2 - v.position) % (P1 - v.position));
+      math::vector_3d const N2 ((P3 - v.position) % (P2 - v.position));
+      math::vector_3d const N3 ((P4 - v.position) % (P3 - v.position));
+      math::vector_3d const N4 ((P1 - v.position) % (P4 - v.position));
+
+      math::vector_3d Norm (N1 + N2 + N3 + N4);
+      Norm.normalize();
+
+      Norm.x = std::floor (Norm.x * 127) / 127;
+      Norm.y = std::floor (Norm.y * 127) / 127;
+      Norm.z = std::floor (Norm.z * 127) / 127;
+
+      v.normal = {-Norm.z, Norm.y, -Norm.x};
+    }
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const strokes (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 50);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> height_distribution (-20.f, 20.f);
+
+  std::vector<chunk> chunks (256);
+  for (int py (0); py < 16; ++py)
+  {
+    for (int px (0); px < 16; ++px)
+    {
+      vertex* v (chunks[py * 16 + px].data());
+      for (int j (0); j < 17; ++j)
+      {
+        for (int i (0); i < ((j % 2) ? 8 : 9); ++i)
+        {
+          float const xpos (px * CHUNKSIZE + i * UNITSIZE + ((j % 2) ? UNITSIZE * 0.5f : 0.f));
+          float const zpos (py * CHUNKSIZE + j * 0.5f * UNITSIZE);
+          v->position = math::vector_3d (xpos, height_distribution (engine), zpos);
+          ++v;
+        }
+      }
+    }
+  }
+  std::vector<chunk> legacy_chunks (chunks);
+
+  double const legacy
+    ( seconds ( [&]
+                {
+                  for (std::size_t stroke (0); stroke < strokes; ++stroke)
+                  {
+                    for (chunk& vertices : legacy_chunks)
+                    {
+                      legacy_normals (vertices, [&] (float x, float z) { return height (legacy_chunks, x, z); });
+                    }
+                  }
+                }
+              )
+    );
+
+  noggit::chunk_normals normals;
+  std::array<math::vector_3d, noggit::chunk_normals::vertex_count> computed;
+
+  double const batched
+    ( seconds ( [&]
+                {
+                  for (std::size_t stroke (0); stroke < strokes; ++stroke)
+                  {
+                    for (chunk& vertices : chunks)
+                    {
+                      normals.gather (vertices, [&] (float x, float z) { return height (chunks, x, z); });
+                      normals.compute (computed.data());
+                      for (std::size_t i (0); i < computed.size(); ++i)
+                      {
+                        vertices[i].normal = computed[i];
+                      }
+                    }
+                  }
+                }
+              )
+    );
+
+  bool same (true);
+  for (std::size_t c (0); c < chunks.size(); ++c)
+  {
+    for (std::size_t i (0); i < noggit::chunk_normals::vertex_count; ++i)
+    {
+      same = same && !std::memcmp (&chunks[c][i].normal, &legacy_chunks[c][i].normal, sizeof (math::vector_3d));
+    }
+  }
+
+  std::printf ("%zu strokes over 256 chunks\n", strokes);
+  std::printf ("per point lookup %8.3f s  chunk_normals %8.3f s  speedup %.2fx\n", legacy, batched, legacy / batched);
+
+  return same ? 0 : 1;
+}
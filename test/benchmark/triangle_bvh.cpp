@@ -0,0 +1,135 @@
+// Time to pick a fixed set of rays against meshes of growing triangle
+// counts, like picking doodads and wmo groups does: once like the
+// legacy Model::intersect, testing every triangle, once with the
+// triangle_bvh. Brute force grows linearly with the triangle count,
+// the tree roughly logarithmically.
+
+#include <noggit/triangle_bvh.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+  template<typename Fun>
+    double seconds (Fun&& fun)
+  {
+    auto const start (std::chrono::steady_clock::now());
+    fun();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+  }
+
+  // a bumpy grid of size * size quads over 100 * 100 units
+  void terrain ( int size
+               , std::vector<math::vector_3d>& vertices
+               , std::vector<std::uint32_t>& indices
+               )
+  {
+    std::mt19937 engine (size);
+    std::uniform_real_distribution<float> height (-2.f, 2.f);
+    float const step (100.f / size);
+
+    for (int z (0); z <= size; ++z)
+    {
+      for (int x (0); x <= size; ++x)
+      {
+        vertices.emplace_back (x * step, height (engine), z * step);
+      }
+    }
+    for (int z (0); z < size; ++z)
+    {
+      for (int x (0); x < size; ++x)
+      {
+        std::uint32_t const corner (z * (size + 1) + x);
+        for (int offset : {0, size + 1, size + 2, 0, size + 2, 1})
+        {
+          indices.push_back (corner + offset);
+        }
+      }
+    }
+  }
+}
+
+int main (int argc, char** argv)
+{
+  std::size_t const ray_count (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 1000);
+
+  std::mt19937 engine (42);
+  std::uniform_real_distribution<float> coordinate (0.f, 100.f);
+  std::uniform_real_distribution<float> tilt (-0.5f, 0.5f);
+
+  std::vector<math::ray> rays;
+  for (std::size_t i (0); i < ray_count; ++i)
+  {
+    rays.emplace_back ( math::vector_3d (coordinate (engine), 50.f, coordinate (engine))
+                      , math::vector_3d (tilt (engine), -1.f, tilt (engine))
+                      );
+  }
+
+  bool same (true);
+
+  std::printf ("%zu rays\n", rays.size());
+
+  for (int size : {8, 16, 32, 64, 128, 256})
+  {
+    std::vector<math::vector_3d> vertices;
+    std::vector<std::uint32_t> indices;
+    terrain (size, vertices, indices);
+
+    auto const position
+      ( [&] (std::uint32_t vertex) -> math::vector_3d const&
+        {
+          return vertices[vertex];
+        }
+      );
+
+    noggit::triangle_bvh bvh;
+    double const build
+      ( seconds ( [&]
+                  {
+                    bvh = noggit::triangle_bvh (indices, position);
+                  }
+                )
+      );
+
+    std::size_t legacy_hit (0);
+    double const legacy
+      ( seconds ( [&]
+                  {
+                    for (auto const& ray : rays)
+                    {
+                      for (std::size_t i (0); i < indices.size(); i += 3)
+                      {
+                        legacy_hit += !!ray.intersect_triangle
+                          (vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]);
+                      }
+                    }
+                  }
+                )
+      );
+
+    std::size_t hit (0);
+    double const tree
+      ( seconds ( [&]
+                  {
+                    for (auto const& ray : rays)
+                    {
+                      bvh.intersect (ray, position, [&] (float, std::uint32_t) { ++hit; });
+                    }
+                  }
+                )
+      );
+
+    same = same && hit == legacy_hit;
+
+    std::printf ( "%7zu triangles  build %8.4f s  legacy %8.4f s  bvh %8.4f s  speedup %8.2fx\n"
+                , bvh.triangle_count(), build, legacy, tree, legacy / tree
+                );
+  }
+
+  return same ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#include <boost/test/unit_test.hpp>
+
+#include <math/ray.hpp>
+
+namespace math
+{
+  BOOST_AUTO_TEST_CASE (ray_hits_bounds_it_passes_through)
+  {
+    ray const diagonal ({-1.f, -1.f, -1.f}, {1.f, 1.f, 1.f});
+
+    BOOST_CHECK (diagonal.intersect_bounds ({0.f, 0.f, 0.f}, {1.f, 1.f, 1.f}));
+    BOOST_CHECK (!diagonal.intersect_bounds ({2.f, 0.f, 0.f}, {3.f, 1.f, 1.f}));
+  }
+
+  BOOST_AUTO_TEST_CASE (ray_parallel_to_an_axis_misses_bounds_beside_it)
+  {
+    ray const down ({5.f, 10.f, 5.f}, {0.f, -1.f, 0.f});
+
+    BOOST_CHECK (down.intersect_bounds ({0.f, 0.f, 0.f}, {10.f, 1.f, 10.f}));
+    BOOST_CHECK (down.intersect_bounds ({5.f, 0.f, 5.f}, {5.f, 0.f, 5.f}));
+    BOOST_CHECK (!down.intersect_bounds ({6.f, 0.f, 0.f}, {10.f, 1.f, 10.f}));
+    BOOST_CHECK (!down.intersect_bounds ({0.f, 0.f, -4.f}, {10.f, 1.f, 4.f}));
+  }
+
+  BOOST_AUTO_TEST_CASE (ray_hits_triangles_in_front_of_it)
+  {
+    ray const down ({0.25f, 10.f, 0.25f}, {0.f, -1.f, 0.f});
+
+    auto const distance (down.intersect_triangle ({0.f, 2.f, 0.f}, {0.f, 2.f, 1.f}, {1.f, 2.f, 0.f}));
+    BOOST_REQUIRE (distance);
+    BOOST_CHECK_CLOSE (*distance, 8.f, 0.0001f);
+    BOOST_CHECK (!down.intersect_triangle ({0.f, 12.f, 0.f}, {0.f, 12.f, 1.f}, {1.f, 12.f, 0.f}));
+  }
+}
@@ -0,0 +1,289 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/adt_file.hpp>
+#include <util/chunk_writer.hpp>
+
+#include "adt_file_legacy.hpp"
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct random_tile
+    {
+      random_tile (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+
+      std::uint32_t number (std::uint32_t max)
+      {
+        return std::uniform_int_distribution<std::uint32_t> (0, max) (engine);
+      }
+      std::uint32_t bits()
+      {
+        return static_cast<std::uint32_t> (engine());
+      }
+      bool chance (std::uint32_t percent)
+      {
+        return number (99) < percent;
+      }
+      float real()
+      {
+        return std::uniform_real_distribution<float> (-500.f, 500.f) (engine);
+      }
+
+      std::vector<std::string> names (std::string const& prefix, std::size_t count)
+      {
+        std::vector<std::string> result;
+        for (std::size_t i (0); i < count; ++i)
+        {
+          result.emplace_back (prefix + std::string (number (40), 'a' + i % 26) + std::to_string (i) + ".blp");
+        }
+        return result;
+      }
+
+      adt::mh2o_layer liquid_layer()
+      {
+        adt::mh2o_layer layer;
+        layer.information.liquid_id = number (20);
+        layer.information.liquid_vertex_format = number (2);
+        layer.information.minHeight = real();
+        layer.information.maxHeight = real();
+        layer.information.xOffset = number (4);
+        layer.information.yOffset = number (4);
+        layer.information.width = 1 + number (3);
+        layer.information.height = 1 + number (3);
+
+        if (chance (50))
+        {
+          layer.mask = (std::uint64_t (engine()) << 32) | engine() | 1;
+        }
+
+        std::size_t const vertices ((layer.information.width + 1) * (layer.information.height + 1));
+        switch (layer.information.liquid_vertex_format)
+        {
+        case 0:
+          layer.heights.resize (vertices, real());
+          layer.depths.resize (vertices, number (255));
+          break;
+        case 1:
+          layer.heights.resize (vertices, real());
+          layer.uvs.resize (vertices, mh2o_uv (number (65535), number (65535)));
+          break;
+        default:
+          if (chance (50))
+          {
+            layer.depths.resize (vertices, number (255));
+          }
+          else
+          {
+            layer.has_height_map_offset = false;
+          }
+          break;
+        }
+        return layer;
+      }
+
+      adt::mcnk chunk (std::size_t index, bool mclq)
+      {
+        adt::mcnk chunk;
+        for (std::size_t i (0); i < sizeof (chunk.header); ++i)
+        {
+          reinterpret_cast<char*> (&chunk.header)[i] = static_cast<char> (engine());
+        }
+        chunk.header.ix = index % 16;
+        chunk.header.iy = index / 16;
+
+        for (auto& height : chunk.heights)
+        {
+          height = real();
+        }
+        if (chance (30))
+        {
+          chunk.vertex_colors.emplace();
+          for (auto& color : *chunk.vertex_colors)
+          {
+            color = engine() & 0xFFFFFF;
+          }
+        }
+        for (auto& normal : chunk.normals)
+        {
+          normal = static_cast<char> (engine());
+        }
+
+        std::size_t const layers (number (4));
+        std::size_t const alphamap_size (chance (50) ? 4096 : 2048);
+        for (std::size_t i (0); i < layers; ++i)
+        {
+          ENTRY_MCLY layer;
+          layer.textureID = number (10);
+          layer.flags = engine();
+          layer.ofsAlpha = engine();
+          layer.effectID = number (0xFFFF);
+          chunk.layers.push_back (layer);
+
+          if (i > 0)
+          {
+            chunk.alphamaps.emplace_back (alphamap_size, static_cast<std::uint8_t> (engine()));
+          }
+        }
+
+        chunk.doodad_refs.resize (number (20), engine());
+        chunk.object_refs.resize (number (5), engine());
+
+        if (chance (40))
+        {
+          chunk.shadow.emplace();
+          chunk.shadow->fill (static_cast<std::uint8_t> (engine()));
+        }
+
+        if (mclq)
+        {
+          chunk.liquids.emplace (number (2));
+          for (auto& layer : *chunk.liquids)
+          {
+            for (std::size_t i (0); i < sizeof (mclq); ++i)
+            {
+              reinterpret_cast<char*> (&layer)[i] = static_cast<char> (engine());
+            }
+          }
+        }
+
+        return chunk;
+      }
+
+      adt::tile tile (bool mclq)
+      {
+        adt::tile tile;
+        tile.flags = chance (50);
+        tile.textures = names ("tileset\\", number (12));
+        tile.models = names ("WORLD\\DOODADS\\", number (30));
+        tile.objects = names ("WORLD\\WMO\\", number (6));
+
+        for (std::size_t i (0), count (tile.models.empty() ? 0 : number (200)); i < count; ++i)
+        {
+          ENTRY_MDDF doodad {number (tile.models.size() - 1), bits(), {real(), real(), real()}, {real(), real(), real()}, 1024, 0};
+          tile.doodads.push_back (doodad);
+        }
+        for (std::size_t i (0), count (tile.objects.empty() ? 0 : number (10)); i < count; ++i)
+        {
+          ENTRY_MODF wmo { number (tile.objects.size() - 1), bits()
+                         , {real(), real(), real()}, {real(), real(), real()}
+                         , {{real(), real(), real()}, {real(), real(), real()}}
+                         , 0, 1, 2, 3
+                         };
+          tile.wmos.push_back (wmo);
+        }
+
+        if (!mclq && chance (70))
+        {
+          tile.water.resize (256);
+          for (auto& chunk : tile.water)
+          {
+            if (chance (50))
+            {
+              continue;
+            }
+            if (chance (80))
+            {
+              chunk.attributes = MH2O_Attributes {engine(), engine()};
+            }
+            for (std::size_t i (0), count (1 + number (1)); i < count; ++i)
+            {
+              chunk.layers.push_back (liquid_layer());
+            }
+          }
+        }
+
+        for (std::size_t i (0); i < 256; ++i)
+        {
+          tile.chunks.push_back (chunk (i, mclq));
+        }
+
+        if (tile.flags & 1)
+        {
+          tile.flight_bounds.emplace();
+          for (auto& bound : *tile.flight_bounds)
+          {
+            bound = static_cast<std::int16_t> (real());
+          }
+        }
+
+        return tile;
+      }
+    };
+  }
+
+  BOOST_AUTO_TEST_CASE (adt_file_matches_the_legacy_writer)
+  {
+    for (unsigned seed (0); seed < 40; ++seed)
+    {
+      random_tile generator (seed);
+      auto const tile (generator.tile (seed % 4 == 3));
+
+      BOOST_REQUIRE (adt::write (tile) == legacy::write (tile));
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (adt_file_of_an_empty_tile_matches_the_legacy_writer)
+  {
+    adt::tile tile;
+    tile.chunks.resize (256);
+    for (auto& chunk : tile.chunks)
+    {
+      chunk.header = {};
+      chunk.heights.fill (0.f);
+      chunk.normals.fill (0);
+    }
+
+    BOOST_REQUIRE (adt::write (tile) == legacy::write (tile));
+
+    tile.water.resize (256);
+    for (auto& chunk : tile.chunks)
+    {
+      chunk.liquids.emplace();
+    }
+
+    BOOST_REQUIRE (adt::write (tile) == legacy::write (tile));
+  }
+
+  BOOST_AUTO_TEST_CASE (adt_file_requires_all_chunks)
+  {
+    adt::tile tile;
+    tile.chunks.resize (255);
+
+    BOOST_REQUIRE_THROW (adt::write (tile), std::logic_error);
+  }
+
+  BOOST_AUTO_TEST_CASE (chunk_writer_only_writes_the_measured_size)
+  {
+    {
+      util::chunk_writer writer (util::chunk_writer::chunk_size (4));
+      writer.chunk_header ('MVER', 4);
+      writer.value (std::uint32_t (18));
+
+      auto const data (writer.finish());
+      BOOST_REQUIRE_EQUAL (data.size(), 12);
+      BOOST_REQUIRE_EQUAL (std::string (data.data(), 4), "REVM");
+      BOOST_REQUIRE_EQUAL (data[4], 4);
+      BOOST_REQUIRE_EQUAL (data[8], 18);
+    }
+
+    {
+      util::chunk_writer writer (10);
+      writer.chunk_header ('MVER', 4);
+      BOOST_REQUIRE_THROW (writer.value (std::uint32_t (18)), std::logic_error);
+      BOOST_REQUIRE_THROW (writer.finish(), std::logic_error);
+      writer.zeros (2);
+      BOOST_REQUIRE_EQUAL (writer.finish().size(), 10);
+    }
+  }
+}
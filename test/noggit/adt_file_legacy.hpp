@@ -0,0 +1,509 @@
+// The ADT writer as it was before noggit::adt::write: a
+// util::sExtendableArray grown chunk by chunk, with names, headers and
+// liquid data inserted into the middle of it and sizes patched in
+// afterwards. Same input, so the test can compare the two byte by byte
+// and the benchmark can time them.
+
+#pragma once
+
+#include <noggit/adt_file.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace legacy
+{
+  class sExtendableArray
+  {
+    std::vector<char> data;
+
+  public:
+    void Extend (long pAddition)
+    {
+      data.resize (data.size() + pAddition);
+    }
+    void Insert (unsigned long pPosition, unsigned long pAddition, const char * pAdditionalData)
+    {
+      data.insert (data.begin() + pPosition, pAdditionalData, pAdditionalData + pAddition);
+    }
+
+    template<typename T>
+      T* GetPointer (unsigned long pPosition = 0)
+    {
+      return reinterpret_cast<T*> (data.data() + pPosition);
+    }
+
+    std::vector<char> data_up_to (std::size_t position) const
+    {
+      return std::vector<char> (data.begin(), data.begin() + position);
+    }
+  };
+
+  struct sChunkHeader
+  {
+    int mMagic;
+    int mSize;
+  };
+
+  inline void SetChunkHeader (sExtendableArray& pArray, int pPosition, int pMagix, int pSize = 0)
+  {
+    auto const Header = pArray.GetPointer<sChunkHeader> (pPosition);
+    Header->mMagic = pMagix;
+    Header->mSize = pSize;
+  }
+
+  inline void save_layer (noggit::adt::mh2o_layer const& layer, sExtendableArray& adt, int base_pos, int& info_pos, int& current_pos)
+  {
+    MH2O_Information info (layer.information);
+    info.ofsInfoMask = 0;
+
+    if (layer.mask)
+    {
+      std::uint64_t mask (*layer.mask);
+      info.ofsInfoMask = current_pos - base_pos;
+      adt.Insert (current_pos, 8, reinterpret_cast<char*> (&mask));
+      current_pos += 8;
+    }
+
+    info.ofsHeightMap = current_pos - base_pos;
+
+    if (!layer.heights.empty())
+    {
+      adt.Extend (layer.heights.size() * sizeof (float));
+      for (float height : layer.heights)
+      {
+        memcpy (adt.GetPointer<char> (current_pos), &height, sizeof (float));
+        current_pos += sizeof (float);
+      }
+    }
+    else if (!layer.has_height_map_offset)
+    {
+      info.ofsHeightMap = 0;
+    }
+
+    if (!layer.uvs.empty())
+    {
+      adt.Extend (layer.uvs.size() * sizeof (mh2o_uv));
+      for (mh2o_uv uv : layer.uvs)
+      {
+        memcpy (adt.GetPointer<char> (current_pos), &uv, sizeof (mh2o_uv));
+        current_pos += sizeof (mh2o_uv);
+      }
+    }
+
+    if (!layer.depths.empty())
+    {
+      adt.Extend (layer.depths.size());
+      for (std::uint8_t depth : layer.depths)
+      {
+        memcpy (adt.GetPointer<char> (current_pos), &depth, sizeof (std::uint8_t));
+        current_pos += sizeof (std::uint8_t);
+      }
+    }
+
+    memcpy (adt.GetPointer<char> (info_pos), &info, sizeof (MH2O_Information));
+    info_pos += sizeof (MH2O_Information);
+  }
+
+  inline void save_liquid_chunk (noggit::adt::mh2o_chunk const& chunk, sExtendableArray& adt, int base_pos, int& header_pos, int& current_pos)
+  {
+    MH2O_Header header;
+
+    if (!chunk.layers.empty())
+    {
+      header.nLayers = chunk.layers.size();
+
+      if (chunk.attributes)
+      {
+        MH2O_Attributes attributes (*chunk.attributes);
+        header.ofsRenderMask = current_pos - base_pos;
+        adt.Insert (current_pos, sizeof (MH2O_Attributes), reinterpret_cast<char*> (&attributes));
+        current_pos += sizeof (MH2O_Attributes);
+      }
+      else
+      {
+        header.ofsRenderMask = 0;
+      }
+
+      header.ofsInformation = current_pos - base_pos;
+      int info_pos = current_pos;
+
+      std::size_t info_size = sizeof (MH2O_Information) * chunk.layers.size();
+      current_pos += info_size;
+
+      adt.Extend (info_size);
+
+      for (auto const& layer : chunk.layers)
+      {
+        save_layer (layer, adt, base_pos, info_pos, current_pos);
+      }
+    }
+
+    memcpy (adt.GetPointer<char> (header_pos), &header, sizeof (MH2O_Header));
+    header_pos += sizeof (MH2O_Header);
+  }
+
+  inline void save_liquid_tile (std::vector<noggit::adt::mh2o_chunk> const& water, sExtendableArray& lADTFile, int& lMHDR_Position, int& lCurrentPosition)
+  {
+    int ofsW = lCurrentPosition + 0x8;
+
+    lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->mh2o = lCurrentPosition - 0x14;
+
+    int headers_size = 256 * sizeof (MH2O_Header);
+    lADTFile.Extend (8 + headers_size);
+    lCurrentPosition = ofsW + headers_size;
+    int header_pos = ofsW;
+
+    for (auto const& chunk : water)
+    {
+      save_liquid_chunk (chunk, lADTFile, ofsW, header_pos, lCurrentPosition);
+    }
+
+    SetChunkHeader (lADTFile, ofsW - 8, 'MH2O', lCurrentPosition - ofsW);
+  }
+
+  inline void save_chunk (noggit::adt::mcnk const& chunk, int index, sExtendableArray& lADTFile, int& lCurrentPosition, int& lMCIN_Position)
+  {
+    int lMCNK_Size = 0x80;
+    int lMCNK_Position = lCurrentPosition;
+    lADTFile.Extend (8 + 0x80);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCNK', lMCNK_Size);
+    lADTFile.GetPointer<MCIN> (lMCIN_Position + 8)->mEntries[index].offset = lCurrentPosition;
+
+    MapChunkHeader header (chunk.header);
+    lADTFile.Insert (lCurrentPosition + 8, 0x80, reinterpret_cast<char*> (&header));
+    auto const lMCNK_header = lADTFile.GetPointer<MapChunkHeader> (lCurrentPosition + 8);
+
+    lMCNK_header->nLayers = -1;
+    lMCNK_header->nDoodadRefs = -1;
+    lMCNK_header->ofsHeight = -1;
+    lMCNK_header->ofsNormal = -1;
+    lMCNK_header->ofsLayer = -1;
+    lMCNK_header->ofsRefs = -1;
+    lMCNK_header->ofsAlpha = -1;
+    lMCNK_header->sizeAlpha = -1;
+    lMCNK_header->ofsShadow = -1;
+    lMCNK_header->sizeShadow = -1;
+    lMCNK_header->nMapObjRefs = -1;
+    lMCNK_header->ofsMCCV = -1;
+    lMCNK_header->ofsSndEmitters = 0;
+    lMCNK_header->nSndEmitters = 0;
+    lMCNK_header->ofsLiquid = 0;
+    lMCNK_header->sizeLiquid = 8;
+
+    lCurrentPosition += 8 + 0x80;
+
+    // MCVT
+    int lMCVT_Size = chunk.heights.size() * 4;
+    lADTFile.Extend (8 + lMCVT_Size);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCVT', lMCVT_Size);
+
+    auto header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+    header_ptr->ofsHeight = lCurrentPosition - lMCNK_Position;
+
+    auto const lHeightmap = lADTFile.GetPointer<float> (lCurrentPosition + 8);
+    for (std::size_t i = 0; i < chunk.heights.size(); ++i)
+      lHeightmap[i] = chunk.heights[i];
+
+    lCurrentPosition += 8 + lMCVT_Size;
+    lMCNK_Size += 8 + lMCVT_Size;
+
+    // MCCV
+    if (chunk.vertex_colors)
+    {
+      int lMCCV_Size = chunk.vertex_colors->size() * sizeof (unsigned int);
+      lADTFile.Extend (8 + lMCCV_Size);
+      SetChunkHeader (lADTFile, lCurrentPosition, 'MCCV', lMCCV_Size);
+      header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+      header_ptr->ofsMCCV = lCurrentPosition - lMCNK_Position;
+
+      auto const lmccv = lADTFile.GetPointer<unsigned int> (lCurrentPosition + 8);
+      for (std::size_t i = 0; i < chunk.vertex_colors->size(); ++i)
+        lmccv[i] = (*chunk.vertex_colors)[i];
+
+      lCurrentPosition += 8 + lMCCV_Size;
+      lMCNK_Size += 8 + lMCCV_Size;
+    }
+    else
+    {
+      header_ptr->ofsMCCV = 0;
+    }
+
+    // MCNR
+    int lMCNR_Size = chunk.normals.size();
+    lADTFile.Extend (8 + lMCNR_Size);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCNR', lMCNR_Size);
+    header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+    header_ptr->ofsNormal = lCurrentPosition - lMCNK_Position;
+
+    auto const lNormals = lADTFile.GetPointer<char> (lCurrentPosition + 8);
+    for (std::size_t i = 0; i < chunk.normals.size(); ++i)
+      lNormals[i] = chunk.normals[i];
+
+    lCurrentPosition += 8 + lMCNR_Size;
+    lMCNK_Size += 8 + lMCNR_Size;
+
+    lADTFile.Extend (13);
+    lCurrentPosition += 13;
+    lMCNK_Size += 13;
+
+    // MCLY
+    size_t lMCLY_Size = chunk.layers.size() * 0x10;
+    lADTFile.Extend (8 + lMCLY_Size);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCLY', lMCLY_Size);
+    header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+    header_ptr->ofsLayer = lCurrentPosition - lMCNK_Position;
+    header_ptr->nLayers = chunk.layers.size();
+
+    int lMCAL_Size = 0;
+    for (size_t j = 0; j < chunk.layers.size(); ++j)
+    {
+      auto const lLayer = lADTFile.GetPointer<ENTRY_MCLY> (lCurrentPosition + 8 + 0x10 * j);
+      *lLayer = chunk.layers[j];
+      lLayer->ofsAlpha = lMCAL_Size;
+
+      if (j != 0)
+      {
+        lMCAL_Size += chunk.alphamaps[j - 1].size();
+      }
+    }
+
+    lCurrentPosition += 8 + lMCLY_Size;
+    lMCNK_Size += 8 + lMCLY_Size;
+
+    // MCRF
+    int lMCRF_Size = 4 * (chunk.doodad_refs.size() + chunk.object_refs.size());
+    lADTFile.Extend (8 + lMCRF_Size);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCRF', lMCRF_Size);
+    header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+    header_ptr->ofsRefs = lCurrentPosition - lMCNK_Position;
+    header_ptr->nDoodadRefs = chunk.doodad_refs.size();
+    header_ptr->nMapObjRefs = chunk.object_refs.size();
+
+    auto const lReferences = lADTFile.GetPointer<int> (lCurrentPosition + 8);
+    int lID = 0;
+    for (auto ref : chunk.doodad_refs)
+      lReferences[lID++] = ref;
+    for (auto ref : chunk.object_refs)
+      lReferences[lID++] = ref;
+
+    lCurrentPosition += 8 + lMCRF_Size;
+    lMCNK_Size += 8 + lMCRF_Size;
+
+    // MCSH
+    if (chunk.shadow)
+    {
+      int lMCSH_Size = 0x200;
+      lADTFile.Extend (8 + lMCSH_Size);
+      SetChunkHeader (lADTFile, lCurrentPosition, 'MCSH', lMCSH_Size);
+      header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+      header_ptr->ofsShadow = lCurrentPosition - lMCNK_Position;
+      header_ptr->sizeShadow = 0x200;
+
+      memcpy (lADTFile.GetPointer<char> (lCurrentPosition + 8), chunk.shadow->data(), 0x200);
+
+      lCurrentPosition += 8 + lMCSH_Size;
+      lMCNK_Size += 8 + lMCSH_Size;
+    }
+    else
+    {
+      header_ptr->ofsShadow = 0;
+      header_ptr->sizeShadow = 0;
+    }
+
+    // MCAL
+    lADTFile.Extend (8 + lMCAL_Size);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCAL', lMCAL_Size);
+    header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+    header_ptr->ofsAlpha = lCurrentPosition - lMCNK_Position;
+    header_ptr->sizeAlpha = 8 + lMCAL_Size;
+
+    int alpha_position = lCurrentPosition + 8;
+    for (auto alpha : chunk.alphamaps)
+    {
+      memcpy (lADTFile.GetPointer<char> (alpha_position), alpha.data(), alpha.size());
+      alpha_position += alpha.size();
+    }
+
+    lCurrentPosition += 8 + lMCAL_Size;
+    lMCNK_Size += 8 + lMCAL_Size;
+
+    if (chunk.liquids)
+    {
+      if (!chunk.liquids->empty())
+      {
+        int liquids_size = 8 + chunk.liquids->size() * sizeof (mclq);
+        lMCNK_Size += liquids_size;
+
+        header_ptr->sizeLiquid = liquids_size;
+        header_ptr->ofsLiquid = lCurrentPosition - lMCNK_Position;
+
+        lADTFile.Extend (sizeof (mclq) * chunk.liquids->size() + 8);
+        SetChunkHeader (lADTFile, lCurrentPosition, 'MCLQ', 0);
+        lCurrentPosition += 8;
+
+        for (auto const& layer : *chunk.liquids)
+        {
+          std::memcpy (lADTFile.GetPointer<char> (lCurrentPosition), &layer, sizeof (mclq));
+          lCurrentPosition += sizeof (mclq);
+        }
+      }
+      else
+      {
+        lADTFile.Extend (8);
+        SetChunkHeader (lADTFile, lCurrentPosition, 'MCLQ', 0);
+        header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+        header_ptr->sizeLiquid = 8;
+        header_ptr->ofsLiquid = lCurrentPosition - lMCNK_Position;
+
+        lCurrentPosition += 8;
+        lMCNK_Size += 8;
+      }
+    }
+
+    // MCSE
+    lADTFile.Extend (8);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCSE', 0);
+    header_ptr = lADTFile.GetPointer<MapChunkHeader> (lMCNK_Position + 8);
+    header_ptr->ofsSndEmitters = lCurrentPosition - lMCNK_Position;
+    header_ptr->nSndEmitters = 0;
+
+    lCurrentPosition += 8;
+    lMCNK_Size += 8;
+
+    lADTFile.GetPointer<sChunkHeader> (lMCNK_Position)->mSize = lMCNK_Size;
+    lADTFile.GetPointer<MCIN> (lMCIN_Position + 8)->mEntries[index].size = lMCNK_Size + sizeof (sChunkHeader);
+  }
+
+  inline void save_names ( sExtendableArray& lADTFile
+                         , int& lCurrentPosition
+                         , int lMHDR_Position
+                         , std::uint32_t MHDR::* offset
+                         , int magic
+                         , std::vector<std::string> const& names
+                         , std::vector<int>* positions
+                         )
+  {
+    int lPosition = lCurrentPosition;
+    lADTFile.Extend (8 + 0);
+    SetChunkHeader (lADTFile, lCurrentPosition, magic);
+    lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->*offset = lCurrentPosition - 0x14;
+    lCurrentPosition += 8 + 0;
+
+    for (auto const& name : names)
+    {
+      if (positions)
+      {
+        positions->push_back (lADTFile.GetPointer<sChunkHeader> (lPosition)->mSize);
+      }
+      lADTFile.Insert (lCurrentPosition, name.size() + 1, name.c_str());
+      lCurrentPosition += name.size() + 1;
+      lADTFile.GetPointer<sChunkHeader> (lPosition)->mSize += name.size() + 1;
+    }
+  }
+
+  inline void save_ids ( sExtendableArray& lADTFile
+                       , int& lCurrentPosition
+                       , int lMHDR_Position
+                       , std::uint32_t MHDR::* offset
+                       , int magic
+                       , std::vector<int> const& positions
+                       )
+  {
+    int lSize = 4 * positions.size();
+    lADTFile.Extend (8 + lSize);
+    SetChunkHeader (lADTFile, lCurrentPosition, magic, lSize);
+    lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->*offset = lCurrentPosition - 0x14;
+
+    auto const lData = lADTFile.GetPointer<int> (lCurrentPosition + 8);
+    for (std::size_t i = 0; i < positions.size(); ++i)
+      lData[i] = positions[i];
+
+    lCurrentPosition += 8 + lSize;
+  }
+
+  template<typename Entry>
+    void save_entries ( sExtendableArray& lADTFile
+                      , int& lCurrentPosition
+                      , int lMHDR_Position
+                      , std::uint32_t MHDR::* offset
+                      , int magic
+                      , std::vector<Entry> const& entries
+                      )
+  {
+    int lSize = sizeof (Entry) * entries.size();
+    lADTFile.Extend (8 + lSize);
+    SetChunkHeader (lADTFile, lCurrentPosition, magic, lSize);
+    lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->*offset = lCurrentPosition - 0x14;
+
+    auto const lData = lADTFile.GetPointer<Entry> (lCurrentPosition + 8);
+    for (std::size_t i = 0; i < entries.size(); ++i)
+      lData[i] = entries[i];
+
+    lCurrentPosition += 8 + lSize;
+  }
+
+  inline std::vector<char> write (noggit::adt::tile const& tile)
+  {
+    sExtendableArray lADTFile;
+    int lCurrentPosition = 0;
+
+    // MVER
+    lADTFile.Extend (8 + 0x4);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MVER', 4);
+    *(lADTFile.GetPointer<int> (8)) = 18;
+    lCurrentPosition += 8 + 0x4;
+
+    // MHDR
+    int lMHDR_Position = lCurrentPosition;
+    lADTFile.Extend (8 + 0x40);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MHDR', 0x40);
+    lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->flags = tile.flags;
+    lCurrentPosition += 8 + 0x40;
+
+    // MCIN
+    int lMCIN_Position = lCurrentPosition;
+    lADTFile.Extend (8 + 256 * 0x10);
+    SetChunkHeader (lADTFile, lCurrentPosition, 'MCIN', 256 * 0x10);
+    lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->mcin = lCurrentPosition - 0x14;
+    lCurrentPosition += 8 + 256 * 0x10;
+
+    std::vector<int> model_positions;
+    std::vector<int> object_positions;
+
+    save_names (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::mtex, 'MTEX', tile.textures, nullptr);
+    save_names (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::mmdx, 'MMDX', tile.models, &model_positions);
+    save_ids (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::mmid, 'MMID', model_positions);
+    save_names (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::mwmo, 'MWMO', tile.objects, &object_positions);
+    save_ids (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::mwid, 'MWID', object_positions);
+    save_entries (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::mddf, 'MDDF', tile.doodads);
+    save_entries (lADTFile, lCurrentPosition, lMHDR_Position, &MHDR::modf, 'MODF', tile.wmos);
+
+    if (!tile.water.empty())
+    {
+      save_liquid_tile (tile.water, lADTFile, lMHDR_Position, lCurrentPosition);
+    }
+
+    for (std::size_t i = 0; i < tile.chunks.size(); ++i)
+    {
+      save_chunk (tile.chunks[i], i, lADTFile, lCurrentPosition, lMCIN_Position);
+    }
+
+    if (tile.flight_bounds)
+    {
+      size_t chunkSize = sizeof (int16_t) * 9 * 2;
+      lADTFile.Extend (8 + chunkSize);
+      SetChunkHeader (lADTFile, lCurrentPosition, 'MFBO', chunkSize);
+      lADTFile.GetPointer<MHDR> (lMHDR_Position + 8)->mfbo = lCurrentPosition - 0x14;
+
+      auto const lMFBO_Data = lADTFile.GetPointer<int16_t> (lCurrentPosition + 8);
+      for (std::size_t i = 0; i < 18; ++i)
+        lMFBO_Data[i] = (*tile.flight_bounds)[i];
+
+      lCurrentPosition += 8 + chunkSize;
+    }
+
+    return lADTFile.data_up_to (lCurrentPosition);
+  }
+}
@@ -0,0 +1,414 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/alpha_painting.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace noggit
+{
+  namespace
+  {
+    using legacy_alphas = std::array<std::array<float, 64 * 64>, 4>;
+    using texel_flags = std::array<bool, 64 * 64>;
+
+    // how far from 1 an alpha has to be for the fixed point alphas to
+    // take the same side of the "< 1 gets cleared" thresholds: the
+    // rounding of ten strokes adds up to a few steps of 1/256
+    double const threshold_margin (5. / 256.);
+
+    bool near_one (double alpha)
+    {
+      return std::abs (alpha - 1.) < threshold_margin;
+    }
+
+    float legacy_dist (float x1, float z1, float x2, float z2)
+    {
+      float xdiff = x2 - x1, zdiff = z2 - z1;
+      return std::sqrt(xdiff*xdiff + zdiff*zdiff);
+    }
+
+    // misc::getShortestDist
+    float legacy_shortest_dist (float x, float z, float squareX, float squareZ, float unitSize)
+    {
+      float px, pz;
+
+      if (x >= squareX && x < squareX + unitSize)
+      {
+        px = x;
+      }
+      else
+      {
+        px = (squareX < x) ? squareX + unitSize : squareX;
+      }
+
+      if (z >= squareZ && z < squareZ + unitSize)
+      {
+        pz = z;
+      }
+      else
+      {
+        pz = (squareZ < z) ? squareZ + unitSize : squareZ;
+      }
+
+      return (px == x && pz == z) ? 0.0f : legacy_dist(x, z, px, pz);
+    }
+
+    bool legacy_float_equals (float const& a, float const& b)
+    {
+      return std::abs(a - b) < (std::max(1.f, std::max(a, b)) * std::numeric_limits<float>::epsilon());
+    }
+
+    // Brush::value_at_dist
+    float legacy_brush (float dist, float radius, float inner_size)
+    {
+      if (dist > radius)
+      {
+        return 0.0f;
+      }
+      if (dist < inner_size)
+      {
+        return 1.0f;
+      }
+      return 1.0f - ((dist - inner_size) / (radius - inner_size));
+    }
+
+    // the loop of TextureSet::paintTexture before paint_alphas. Texels
+    // where it decided on an alpha close to 1 whether to clear it are
+    // flagged in near_threshold.
+    bool legacy_paint ( legacy_alphas& amaps, int nTextures, int tex_layer
+                      , float xbase, float zbase, float x, float z
+                      , float radius, float inner_size, float strength, float pressure
+                      , texel_flags& near_threshold
+                      )
+    {
+      bool changed = false;
+      float zPos = zbase;
+
+      for (int j = 0; j < 64; j++)
+      {
+        float xPos = xbase;
+        for (int i = 0; i < 64; ++i)
+        {
+          float dist = legacy_shortest_dist(x, z, xPos, zPos, TEXDETAILSIZE);
+
+          if (dist <= radius)
+          {
+            std::array<double,4> alpha_values;
+            double total = 0.;
+
+            for (int n = 0; n < 4; ++n)
+            {
+              total += alpha_values[n] = amaps[n][i + 64 * j];
+            }
+
+            double current_alpha = alpha_values[tex_layer];
+            double sum_other_alphas = (total - current_alpha);
+            double alpha_change = (strength - current_alpha) * pressure * legacy_brush (dist, radius, inner_size);
+
+            bool& flagged (near_threshold[i + 64 * j]);
+            flagged = flagged || (alpha_change < 0. && near_one (current_alpha + alpha_change)) || near_one (sum_other_alphas);
+
+            if (alpha_change < 0. && current_alpha + alpha_change < 1.)
+            {
+              alpha_change = -current_alpha;
+            }
+
+            if (!legacy_float_equals(current_alpha, strength))
+            {
+              if (sum_other_alphas < 1.)
+              {
+                if (alpha_change > 0.f)
+                {
+                  for (int layer = 0; layer < nTextures; ++layer)
+                  {
+                    alpha_values[layer] = layer == tex_layer ? 255. : 0.f;
+                  }
+                }
+                else
+                {
+                  bool change_applied = false;
+
+                  for (int layer = 0; layer < nTextures; ++layer)
+                  {
+                    if (layer == tex_layer)
+                    {
+                      alpha_values[layer] += alpha_change;
+                    }
+                    else
+                    {
+                      if (!change_applied)
+                      {
+                        alpha_values[layer] -= alpha_change;
+                      }
+                      else
+                      {
+                        alpha_values[tex_layer] += alpha_values[layer];
+                        alpha_values[layer] = 0.;
+                      }
+
+                      change_applied = true;
+                    }
+                  }
+                }
+              }
+              else
+              {
+                for (int layer = 0; layer < nTextures; ++layer)
+                {
+                  if (layer == tex_layer)
+                  {
+                    alpha_values[layer] += alpha_change;
+                  }
+                  else
+                  {
+                    alpha_values[layer] -= alpha_change * alpha_values[layer] / sum_other_alphas;
+                    flagged = flagged || near_one (alpha_values[layer]);
+
+                    if (alpha_values[layer] < 1.)
+                    {
+                      alpha_values[tex_layer] += alpha_values[layer];
+                      alpha_values[layer] = 0.f;
+                    }
+                  }
+                }
+              }
+
+              double total_final = std::accumulate(alpha_values.begin(), alpha_values.end(), 0.);
+
+              if (std::abs(total_final - 255.) > 0.001)
+              {
+                for (double& d : alpha_values)
+                {
+                  d = d * 255. / total_final;
+                }
+              }
+
+              for (int n = 0; n < 4; ++n)
+              {
+                amaps[n][i + 64 * j] = static_cast<float>(alpha_values[n]);
+              }
+
+              changed = true;
+            }
+          }
+
+          xPos += TEXDETAILSIZE;
+        }
+        zPos += TEXDETAILSIZE;
+      }
+
+      return changed;
+    }
+
+    struct chunk_alphas
+    {
+      chunk_alphas (std::mt19937& engine, int textures)
+        : texture_count (textures)
+      {
+        std::uniform_int_distribution<int> alpha (0, 255);
+
+        for (auto& layer : legacy)
+        {
+          layer.fill (0.f);
+        }
+
+        for (int i (0); i < 64 * 64; ++i)
+        {
+          int left (255);
+          for (int layer (1); layer < texture_count; ++layer)
+          {
+            int const a (std::uniform_int_distribution<int> (0, left) (engine));
+            legacy[layer][i] = static_cast<float> (a);
+            left -= a;
+          }
+          legacy[0][i] = static_cast<float> (left);
+        }
+
+        for (std::size_t layer (0); layer < 4; ++layer)
+        {
+          for (int i (0); i < 64 * 64; ++i)
+          {
+            fixed.set_alpha (layer, i, legacy[layer][i]);
+          }
+        }
+        fixed_scalar = fixed;
+        near_threshold.fill (false);
+      }
+
+      int texture_count;
+      legacy_alphas legacy;
+      texel_flags near_threshold;
+      tmp_edit_alpha_values fixed;
+      tmp_edit_alpha_values fixed_scalar;
+    };
+
+    struct stroke
+    {
+      stroke (std::mt19937& engine, float xbase, float zbase, int texture_count)
+      {
+        std::uniform_real_distribution<float> offset (-CHUNKSIZE, 2.f * CHUNKSIZE);
+        std::uniform_real_distribution<float> unit;
+
+        x = xbase + offset (engine);
+        z = zbase + offset (engine);
+        radius = 1.f + unit (engine) * 60.f;
+        inner_size = radius * unit (engine);
+        strength = std::uniform_int_distribution<int> (0, 4) (engine) == 0 ? 0.f : 255.f * unit (engine);
+        pressure = unit (engine);
+        layer = std::uniform_int_distribution<int> (0, texture_count - 1) (engine);
+      }
+
+      float x, z, radius, inner_size, strength, pressure;
+      int layer;
+    };
+
+    // texels not near a threshold with an alpha more than one step (of
+    // 255) away from the float version's
+    int differences (chunk_alphas const& alphas)
+    {
+      int count (0);
+      for (int i (0); i < 64 * 64; ++i)
+      {
+        bool differs (false);
+        for (int layer (0); layer < 4; ++layer)
+        {
+          differs = differs || std::abs (alphas.legacy[layer][i] - alphas.fixed.alpha (layer, i)) > 1.f;
+        }
+        count += differs && !alphas.near_threshold[i];
+      }
+      return count;
+    }
+
+    int near_threshold (chunk_alphas const& alphas)
+    {
+      return static_cast<int> (std::count (alphas.near_threshold.begin(), alphas.near_threshold.end(), true));
+    }
+
+    void paint (chunk_alphas& alphas, stroke const& s, float xbase, float zbase)
+    {
+      bool const legacy_changed
+        ( legacy_paint ( alphas.legacy, alphas.texture_count, s.layer, xbase, zbase, s.x, s.z
+                       , s.radius, s.inner_size, s.strength, s.pressure, alphas.near_threshold
+                       )
+        );
+      bool const changed
+        ( paint_alphas ( alphas.fixed, alphas.texture_count, s.layer, xbase, zbase, s.x, s.z
+                       , s.radius, s.inner_size, s.strength, s.pressure
+                       )
+        );
+      paint_alphas_scalar ( alphas.fixed_scalar, alphas.texture_count, s.layer, xbase, zbase, s.x, s.z
+                          , s.radius, s.inner_size, s.strength, s.pressure
+                          );
+
+      BOOST_REQUIRE_EQUAL (changed, legacy_changed);
+      BOOST_REQUIRE (alphas.fixed.map == alphas.fixed_scalar.map);
+    }
+
+    float const xbase (3.f * TILESIZE + 5.f * CHUNKSIZE);
+    float const zbase (7.f * TILESIZE + 11.f * CHUNKSIZE);
+  }
+
+  BOOST_AUTO_TEST_CASE (edit_values_take_half_the_memory_of_floats)
+  {
+    BOOST_REQUIRE_EQUAL (sizeof (tmp_edit_alpha_values), 4 * 64 * 64 * sizeof (float) / 2);
+  }
+
+  BOOST_AUTO_TEST_CASE (painting_saved_alphas_stays_within_one_alpha_step_of_the_float_version)
+  {
+    std::mt19937 engine (42);
+
+    for (int round (0); round < 2000; ++round)
+    {
+      chunk_alphas alphas (engine, 2 + round % 3);
+      paint (alphas, stroke (engine, xbase, zbase, alphas.texture_count), xbase, zbase);
+
+      BOOST_REQUIRE_EQUAL (differences (alphas), 0);
+    }
+  }
+
+  // an alpha right around 1 gets cleared or not depending on its last
+  // bits, from then on that texel can go its own way. Every other texel
+  // has to stay within one step.
+  BOOST_AUTO_TEST_CASE (long_strokes_stay_within_one_alpha_step_away_from_the_thresholds)
+  {
+    std::mt19937 engine (42);
+    int texels (0);
+    int flagged (0);
+
+    for (int round (0); round < 100; ++round)
+    {
+      chunk_alphas alphas (engine, 2 + round % 3);
+
+      for (int i (0); i < 10; ++i)
+      {
+        paint (alphas, stroke (engine, xbase, zbase, alphas.texture_count), xbase, zbase);
+      }
+
+      BOOST_REQUIRE_EQUAL (differences (alphas), 0);
+      flagged += near_threshold (alphas);
+      texels += 64 * 64;
+    }
+
+    // about 1.4%
+    BOOST_REQUIRE_LT (flagged * 50, texels);
+  }
+
+  BOOST_AUTO_TEST_CASE (layers_always_sum_up_to_255)
+  {
+    std::mt19937 engine (7);
+
+    for (int round (0); round < 20; ++round)
+    {
+      chunk_alphas alphas (engine, 4);
+
+      for (int i (0); i < 50; ++i)
+      {
+        stroke const s (engine, xbase, zbase, alphas.texture_count);
+        paint_alphas ( alphas.fixed, alphas.texture_count, s.layer, xbase, zbase, s.x, s.z
+                     , s.radius, s.inner_size, s.strength, s.pressure
+                     );
+      }
+
+      for (int i (0); i < 64 * 64; ++i)
+      {
+        int sum (0);
+        for (auto const& layer : alphas.fixed.map)
+        {
+          sum += layer[i];
+        }
+        BOOST_REQUIRE_EQUAL (sum, tmp_edit_alpha_values::full);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (full_strength_in_the_inner_radius_paints_the_layer_fully)
+  {
+    std::mt19937 engine (3);
+    chunk_alphas alphas (engine, 3);
+
+    BOOST_REQUIRE ( paint_alphas ( alphas.fixed, 3, 2, 0.f, 0.f, CHUNKSIZE / 2.f, CHUNKSIZE / 2.f
+                                 , CHUNKSIZE * 2.f, CHUNKSIZE * 2.f, 255.f, 1.f
+                                 )
+                  );
+
+    for (int i (0); i < 64 * 64; ++i)
+    {
+      BOOST_REQUIRE_EQUAL (alphas.fixed[2][i], tmp_edit_alpha_values::full);
+      BOOST_REQUIRE_EQUAL (alphas.fixed[0][i], 0);
+      BOOST_REQUIRE_EQUAL (alphas.fixed[1][i], 0);
+    }
+
+    BOOST_REQUIRE ( !paint_alphas ( alphas.fixed, 3, 2, 0.f, 0.f, CHUNKSIZE / 2.f, CHUNKSIZE / 2.f
+                                  , CHUNKSIZE * 2.f, CHUNKSIZE * 2.f, 255.f, 1.f
+                                  )
+                  );
+  }
+}
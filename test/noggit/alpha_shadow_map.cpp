@@ -0,0 +1,188 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/alpha_shadow_map.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    using alphamap = std::array<std::uint8_t, 64 * 64>;
+
+    // TextureSet::update_alpha_shadow_map_if_needed for the saved
+    // alphamaps of nTextures layers
+    std::vector<std::uint8_t> legacy_pack (std::vector<alphamap> const& alphamaps, shadow_bits const* shadow)
+    {
+      int const nTextures (static_cast<int> (alphamaps.size()) + 1);
+      bool use_shadow = (shadow != nullptr);
+
+      std::vector<uint8_t> amap(4 * 64 * 64);
+      uint8_t const* alpha_ptr[3];
+
+      for (int i = 0; i < nTextures - 1; ++i)
+      {
+        alpha_ptr[i] = alphamaps[i].data();
+      }
+
+      for (int i = 0; i < 64 * 64; ++i)
+      {
+        for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
+        {
+          amap[i * 4 + alpha_id] = (alpha_id < nTextures - 1)
+            ? *(alpha_ptr[alpha_id]++)
+            : 0
+            ;
+        }
+
+        amap[i * 4 + 3] = use_shadow ? (((*shadow)[i / 64] >> (i % 64)) & 1) * 255 : 0;
+      }
+
+      return amap;
+    }
+
+    // the same while editing, what glTexSubImage3D made of the floats
+    // uploaded to the rgba8 texture
+    std::vector<std::uint8_t> legacy_pack (tmp_edit_alpha_values const& tmp_amaps, shadow_bits const* shadow)
+    {
+      bool use_shadow = (shadow != nullptr);
+      std::vector<float> amap(4 * 64 * 64);
+
+      for (int i = 0; i < 64 * 64; ++i)
+      {
+        for (int alpha_id = 0; alpha_id < 3; ++alpha_id)
+        {
+          amap[i * 4 + alpha_id] = tmp_amaps.alpha(alpha_id + 1, i) / 255.f;
+        }
+
+        amap[i * 4 + 3] = use_shadow ? ((*shadow)[i / 64] >> (i % 64)) & 1 : 0;
+      }
+
+      std::vector<std::uint8_t> normalized (amap.size());
+      for (std::size_t i (0); i < amap.size(); ++i)
+      {
+        normalized[i] = static_cast<std::uint8_t> (std::lround (std::min (1.f, std::max (0.f, amap[i])) * 255.f));
+      }
+      return normalized;
+    }
+
+    std::vector<alphamap> random_alphamaps (std::mt19937& engine, std::size_t count)
+    {
+      std::uniform_int_distribution<int> alpha (0, 255);
+      std::vector<alphamap> alphamaps (count);
+      for (auto& layer : alphamaps)
+      {
+        for (auto& a : layer)
+        {
+          a = static_cast<std::uint8_t> (alpha (engine));
+        }
+      }
+      return alphamaps;
+    }
+
+    shadow_bits random_shadow (std::mt19937_64& engine)
+    {
+      shadow_bits shadow;
+      for (auto& row : shadow)
+      {
+        row = engine();
+      }
+      shadow[3] = 0;
+      shadow[4] = ~std::uint64_t (0);
+      shadow[5] = 0x8000000000000001;
+      return shadow;
+    }
+
+    std::array<std::uint8_t const*, 3> layers (std::vector<alphamap> const& alphamaps)
+    {
+      std::array<std::uint8_t const*, 3> result {{nullptr, nullptr, nullptr}};
+      for (std::size_t i (0); i < alphamaps.size(); ++i)
+      {
+        result[i] = alphamaps[i].data();
+      }
+      return result;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (saved_alphamaps_are_staged_like_before)
+  {
+    std::mt19937 engine (1);
+    std::mt19937_64 shadow_engine (2);
+
+    for (std::size_t count (0); count <= 3; ++count)
+    {
+      auto const alphamaps (random_alphamaps (engine, count));
+      shadow_bits const shadow (random_shadow (shadow_engine));
+
+      for (shadow_bits const* s : {&shadow, static_cast<shadow_bits const*> (nullptr)})
+      {
+        std::vector<std::uint8_t> const expected (legacy_pack (alphamaps, s));
+        std::vector<std::uint8_t> texels (alpha_shadow_map_bytes);
+        std::vector<std::uint8_t> scalar_texels (alpha_shadow_map_bytes);
+
+        pack_alpha_shadow_map (texels.data(), layers (alphamaps), s);
+        pack_alpha_shadow_map_scalar (scalar_texels.data(), layers (alphamaps), s);
+
+        BOOST_REQUIRE (texels == expected);
+        BOOST_REQUIRE (scalar_texels == expected);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (edited_alphas_are_staged_like_the_floats_were_stored)
+  {
+    std::mt19937 engine (3);
+    std::mt19937_64 shadow_engine (4);
+    std::uniform_int_distribution<int> value (0, tmp_edit_alpha_values::full);
+
+    for (int round (0); round < 10; ++round)
+    {
+      tmp_edit_alpha_values alphas;
+      for (auto& layer : alphas.map)
+      {
+        for (auto& a : layer)
+        {
+          a = static_cast<std::uint16_t> (value (engine));
+        }
+      }
+      // every rounding boundary
+      for (int i (0); i < 64 * 64; ++i)
+      {
+        alphas[1][i] = static_cast<std::uint16_t> (std::min<int> (tmp_edit_alpha_values::full, i * 16));
+      }
+
+      shadow_bits const shadow (random_shadow (shadow_engine));
+
+      for (shadow_bits const* s : {&shadow, static_cast<shadow_bits const*> (nullptr)})
+      {
+        std::vector<std::uint8_t> const expected (legacy_pack (alphas, s));
+        std::vector<std::uint8_t> texels (alpha_shadow_map_bytes);
+        std::vector<std::uint8_t> scalar_texels (alpha_shadow_map_bytes);
+
+        pack_alpha_shadow_map (texels.data(), alphas, s);
+        pack_alpha_shadow_map_scalar (scalar_texels.data(), alphas, s);
+
+        BOOST_REQUIRE (texels == expected);
+        BOOST_REQUIRE (scalar_texels == expected);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (staging_memory_is_kept_until_released)
+  {
+    alpha_shadow_staging staging;
+
+    std::uint8_t* const tile (staging.texels (256));
+    tile[256 * alpha_shadow_map_bytes - 1] = 42;
+    BOOST_REQUIRE_EQUAL (staging.texels (1), tile);
+    BOOST_REQUIRE_EQUAL (staging.texels (256), tile);
+    BOOST_REQUIRE_EQUAL (tile[256 * alpha_shadow_map_bytes - 1], 42);
+
+    staging.release();
+    staging.texels (1)[alpha_shadow_map_bytes - 1] = 1;
+  }
+}
@@ -0,0 +1,133 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/archive_index.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace noggit
+{
+  BOOST_AUTO_TEST_CASE (later_archives_override_earlier_ones)
+  {
+    archive_index const index ({ {"a.blp", "b.blp"}
+                               , {"b.blp", "c.blp"}
+                               , {}
+                               , {"c.blp"}
+                               }
+                              );
+
+    BOOST_REQUIRE_EQUAL (index.size(), 3);
+    BOOST_REQUIRE_EQUAL (index.find ("a.blp"), 0);
+    BOOST_REQUIRE_EQUAL (index.find ("b.blp"), 1);
+    BOOST_REQUIRE_EQUAL (index.find ("c.blp"), 3);
+    BOOST_REQUIRE_EQUAL (index.find ("d.blp"), archive_index::not_found);
+  }
+
+  BOOST_AUTO_TEST_CASE (lookups_are_normalized)
+  {
+    archive_index const index ({{"world/maps/azeroth/azeroth_32_48.adt"}, {"Textures\\ShaneCube.blp"}});
+
+    BOOST_REQUIRE_EQUAL (index.find ("WORLD\\MAPS\\Azeroth\\Azeroth_32_48.adt"), 0);
+    BOOST_REQUIRE_EQUAL (index.find ("textures/shanecube.blp"), 1);
+    BOOST_REQUIRE_EQUAL (index.find ("textures/shanecube.bl"), archive_index::not_found);
+    BOOST_REQUIRE_EQUAL (index.find (""), archive_index::not_found);
+  }
+
+  BOOST_AUTO_TEST_CASE (empty_index_finds_nothing)
+  {
+    archive_index const index ({});
+    BOOST_REQUIRE_EQUAL (index.size(), 0);
+    BOOST_REQUIRE_EQUAL (index.find ("a"), archive_index::not_found);
+  }
+
+  BOOST_AUTO_TEST_CASE (serialized_indices_find_the_same_archives)
+  {
+    archive_index const index ({{"a.blp", "b.blp"}, {"B.blp", "c\\d.blp"}, {}});
+    std::string const bytes (index.serialized());
+
+    auto const read (archive_index::deserialized (bytes.data(), bytes.size(), 3));
+    BOOST_REQUIRE (read);
+    BOOST_REQUIRE_EQUAL (read->size(), 3);
+    BOOST_REQUIRE_EQUAL (read->find ("a.blp"), 0);
+    BOOST_REQUIRE_EQUAL (read->find ("b.blp"), 1);
+    BOOST_REQUIRE_EQUAL (read->find ("C/D.blp"), 1);
+    BOOST_REQUIRE_EQUAL (read->find ("e.blp"), archive_index::not_found);
+
+    std::vector<std::string> names;
+    read->for_each_name ([&] (std::string_view name) { names.emplace_back (name); });
+    std::sort (names.begin(), names.end());
+    BOOST_REQUIRE (names == std::vector<std::string> ({"a.blp", "b.blp", "c/d.blp"}));
+
+    // of more archives than there are
+    BOOST_REQUIRE (!archive_index::deserialized (bytes.data(), bytes.size(), 1));
+    // cut off, or with something after it
+    BOOST_REQUIRE (!archive_index::deserialized (bytes.data(), bytes.size() - 1, 3));
+    BOOST_REQUIRE (!archive_index::deserialized ((bytes + "x").data(), bytes.size() + 1, 3));
+    BOOST_REQUIRE (!archive_index::deserialized (bytes.data(), 4, 3));
+  }
+
+  BOOST_AUTO_TEST_CASE (concurrent_lookups_match_a_reference_map)
+  {
+    std::size_t const archive_count (15);
+    std::mt19937 rng (1234);
+
+    // synthetic archives: the base ones share most names, patches
+    // override a random subset
+    std::vector<std::vector<std::string>> names_by_archive (archive_count);
+    std::unordered_map<std::string, std::size_t> expected;
+    for (std::size_t archive (0); archive < archive_count; ++archive)
+    {
+      std::size_t const count (archive < 4 ? 20000 : 2000);
+      for (std::size_t i (0); i < count; ++i)
+      {
+        std::string const name ("world\\maps\\map_" + std::to_string (rng() % 40000) + ".adt");
+        names_by_archive[archive].push_back (name);
+        expected[std::string (name).replace (5, 1, "/").replace (10, 1, "/")] = archive;
+      }
+    }
+
+    archive_index const index (names_by_archive);
+    BOOST_REQUIRE_EQUAL (index.size(), expected.size());
+
+    std::vector<std::string> queries;
+    for (std::size_t i (0); i < 60000; ++i)
+    {
+      queries.push_back ("WORLD/maps/MAP_" + std::to_string (i) + ".ADT");
+    }
+
+    std::atomic<std::size_t> mismatches (0);
+    std::vector<std::thread> threads;
+    for (std::size_t thread (0); thread < 16; ++thread)
+    {
+      threads.emplace_back
+        ( [&, thread]
+          {
+            for (std::size_t round (0); round < 4; ++round)
+            {
+              for (std::size_t i (thread); i < queries.size(); i += 3)
+              {
+                auto const it (expected.find ("world/maps/map_" + std::to_string (i) + ".adt"));
+                std::size_t const want (it == expected.end() ? archive_index::not_found : it->second);
+                if (index.find (queries[i]) != want)
+                {
+                  ++mismatches;
+                }
+              }
+            }
+          }
+        );
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    BOOST_REQUIRE_EQUAL (mismatches.load(), 0);
+  }
+}
@@ -0,0 +1,357 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/blp_decoder.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    std::vector<char> make_blp ( int compression
+                               , int alpha_depth
+                               , int alpha_type
+                               , int width
+                               , int height
+                               , std::vector<std::vector<std::uint8_t>> const& mips
+                               , std::array<std::uint32_t, 256> const& palette = {}
+                               )
+    {
+      BLPHeader header {};
+      std::memcpy (&header.magix, "BLP2", 4);
+      header.version = 1;
+      header.attr_0_compression = static_cast<std::uint8_t> (compression);
+      header.attr_1_alphadepth = static_cast<std::uint8_t> (alpha_depth);
+      header.attr_2_alphatype = static_cast<std::uint8_t> (alpha_type);
+      header.attr_3_mipmaplevels = mips.size() > 1;
+      header.resx = width;
+      header.resy = height;
+
+      std::vector<char> file (sizeof (header) + sizeof (palette));
+      std::memcpy (file.data() + sizeof (header), palette.data(), sizeof (palette));
+      for (std::size_t i (0); i < mips.size(); ++i)
+      {
+        header.offsets[i] = static_cast<std::int32_t> (file.size());
+        header.sizes[i] = static_cast<std::int32_t> (mips[i].size());
+        file.insert (file.end(), mips[i].begin(), mips[i].end());
+      }
+      std::memcpy (file.data(), &header, sizeof (header));
+      return file;
+    }
+
+    BLPHeader header_of (std::vector<char> const& file)
+    {
+      BLPHeader header;
+      std::memcpy (&header, file.data(), sizeof (header));
+      return header;
+    }
+
+    rgba_image decode (std::vector<char> const& file, int mip = 0)
+    {
+      return decode_blp (file.data(), file.size(), mip);
+    }
+
+    std::array<std::uint8_t, 4> pixel (rgba_image const& image, int x, int y)
+    {
+      std::array<std::uint8_t, 4> result;
+      std::memcpy (result.data(), &image.pixels[4 * (y * image.width + x)], 4);
+      return result;
+    }
+
+    using rgba = std::array<std::uint8_t, 4>;
+
+    // blp_texture::loadFromUncompressedData for a single mip
+    std::vector<std::uint32_t> legacy_palettized (std::vector<char> const& file)
+    {
+      char const* lData (file.data());
+      BLPHeader const header (header_of (file));
+      BLPHeader const* lHeader (&header);
+      unsigned int const* pal = reinterpret_cast<unsigned int const*>(lData + sizeof(BLPHeader));
+      int alphabits = lHeader->attr_1_alphadepth;
+      bool hasalpha = alphabits != 0;
+      int width = lHeader->resx, height = lHeader->resy;
+
+      unsigned char const* buf = reinterpret_cast<unsigned char const*>(&lData[lHeader->offsets[0]]);
+      std::vector<uint32_t> data(width * height);
+
+      int cnt = 0;
+      unsigned int* p = data.data();
+      unsigned char const* c = buf;
+      unsigned char const* a = buf + width*height;
+      for (int y = 0; y<height; y++)
+      {
+        for (int x = 0; x<width; x++)
+        {
+          unsigned int k = pal[*c++];
+          k = ((k & 0x00FF0000) >> 16) | ((k & 0x0000FF00)) | ((k & 0x000000FF) << 16);
+          int alpha = 0xFF;
+          if (hasalpha)
+          {
+            if (alphabits == 8)
+            {
+              alpha = (*a++);
+            }
+            else if (alphabits == 1)
+            {
+              alpha = (*a & (1 << cnt++)) ? 0xff : 0;
+              if (cnt == 8)
+              {
+                cnt = 0;
+                a++;
+              }
+            }
+          }
+
+          k |= alpha << 24;
+          *p++ = k;
+        }
+      }
+      return data;
+    }
+
+    std::array<std::uint32_t, 256> test_palette()
+    {
+      std::array<std::uint32_t, 256> palette;
+      for (std::uint32_t i (0); i < palette.size(); ++i)
+      {
+        palette[i] = i | (255 - i) << 8 | (i * 7 % 256) << 16 | 0x12000000;
+      }
+      return palette;
+    }
+
+    // a block whose pixel i uses color i % 4
+    std::vector<std::uint8_t> color_block (std::uint16_t c0, std::uint16_t c1)
+    {
+      return { static_cast<std::uint8_t> (c0), static_cast<std::uint8_t> (c0 >> 8)
+             , static_cast<std::uint8_t> (c1), static_cast<std::uint8_t> (c1 >> 8)
+             , 0xe4, 0xe4, 0xe4, 0xe4
+             };
+    }
+
+    std::uint16_t const red (0xf800);
+    std::uint16_t const blue (0x001f);
+  }
+
+  BOOST_AUTO_TEST_CASE (palettized_blps_decode_like_the_texture_loader)
+  {
+    int const width (6);
+    int const height (5);
+    std::vector<std::uint8_t> mip (width * height);
+    for (std::size_t i (0); i < mip.size(); ++i)
+    {
+      mip[i] = static_cast<std::uint8_t> (i * 37);
+    }
+
+    for (int depth : {0, 1, 8})
+    {
+      std::vector<std::uint8_t> with_alpha (mip);
+      for (int i (0); i < (width * height * depth + 7) / 8; ++i)
+      {
+        with_alpha.push_back (static_cast<std::uint8_t> (i * 91 + 5));
+      }
+
+      std::vector<char> const file (make_blp (1, depth, 0, width, height, {with_alpha}, test_palette()));
+      rgba_image const image (decode (file));
+      std::vector<std::uint32_t> const expected (legacy_palettized (file));
+
+      BOOST_REQUIRE_EQUAL (image.width, width);
+      BOOST_REQUIRE_EQUAL (image.height, height);
+      BOOST_REQUIRE (std::memcmp (image.pixels.data(), expected.data(), image.pixels.size()) == 0);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (palettized_blps_with_4_bit_alpha)
+  {
+    std::vector<std::uint8_t> mip {0, 1, 2, 3, 0x21, 0xf0};
+    rgba_image const image (decode (make_blp (1, 4, 0, 2, 2, {mip}, test_palette())));
+
+    BOOST_REQUIRE_EQUAL (pixel (image, 0, 0)[3], 0x11);
+    BOOST_REQUIRE_EQUAL (pixel (image, 1, 0)[3], 0x22);
+    BOOST_REQUIRE_EQUAL (pixel (image, 0, 1)[3], 0x00);
+    BOOST_REQUIRE_EQUAL (pixel (image, 1, 1)[3], 0xff);
+  }
+
+  BOOST_AUTO_TEST_CASE (dxt1_blocks_with_four_and_three_colors)
+  {
+    rgba_image const four (decode (make_blp (2, 0, 0, 4, 4, {color_block (red, blue)})));
+    BOOST_REQUIRE ((pixel (four, 0, 0) == rgba {{255, 0, 0, 255}}));
+    BOOST_REQUIRE ((pixel (four, 1, 0) == rgba {{0, 0, 255, 255}}));
+    BOOST_REQUIRE ((pixel (four, 2, 0) == rgba {{170, 0, 85, 255}}));
+    BOOST_REQUIRE ((pixel (four, 3, 3) == rgba {{85, 0, 170, 255}}));
+
+    rgba_image const three (decode (make_blp (2, 0, 0, 4, 4, {color_block (blue, red)})));
+    BOOST_REQUIRE ((pixel (three, 2, 1) == rgba {{127, 0, 127, 255}}));
+    BOOST_REQUIRE ((pixel (three, 3, 1) == rgba {{0, 0, 0, 255}}));
+
+    rgba_image const punch_through (decode (make_blp (2, 1, 0, 4, 4, {color_block (blue, red)})));
+    BOOST_REQUIRE ((pixel (punch_through, 3, 2) == rgba {{0, 0, 0, 0}}));
+  }
+
+  BOOST_AUTO_TEST_CASE (dxt3_and_dxt5_alphas)
+  {
+    std::vector<std::uint8_t> dxt3 {0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe};
+    std::vector<std::uint8_t> const colors (color_block (blue, red));
+    dxt3.insert (dxt3.end(), colors.begin(), colors.end());
+
+    rgba_image const explicit_alpha (decode (make_blp (2, 8, 1, 4, 4, {dxt3})));
+    for (int i (0); i < 16; ++i)
+    {
+      BOOST_REQUIRE_EQUAL (pixel (explicit_alpha, i % 4, i / 4)[3], i * 17);
+    }
+    // the color block of dxt3 and dxt5 always has four colors
+    BOOST_REQUIRE ((pixel (explicit_alpha, 3, 0) == rgba {{170, 0, 85, 0x33}}));
+
+    // index i % 8 for pixel i
+    std::vector<std::uint8_t> const indices {0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa};
+    std::array<std::uint8_t, 8> const eight {{255, 0, 218, 182, 145, 109, 72, 36}};
+    std::array<std::uint8_t, 8> const six {{0, 255, 51, 102, 153, 204, 0, 255}};
+
+    for (auto const& expected : {eight, six})
+    {
+      std::vector<std::uint8_t> dxt5 {expected[0], expected[1]};
+      dxt5.insert (dxt5.end(), indices.begin(), indices.end());
+      dxt5.insert (dxt5.end(), colors.begin(), colors.end());
+
+      rgba_image const interpolated (decode (make_blp (2, 8, 7, 4, 4, {dxt5})));
+      for (int i (0); i < 16; ++i)
+      {
+        BOOST_REQUIRE_EQUAL (pixel (interpolated, i % 4, i / 4)[3], expected[i % 8]);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (small_and_short_mips)
+  {
+    std::vector<std::uint8_t> mip0;
+    for (int i (0); i < 4; ++i)
+    {
+      std::vector<std::uint8_t> const block (color_block (red, blue));
+      mip0.insert (mip0.end(), block.begin(), block.end());
+    }
+    std::vector<std::uint8_t> const mip1 (color_block (red, blue));
+    // stored shorter than a block, the rest is taken as zeros
+    std::vector<std::uint8_t> const mip2 {0x1f, 0x00, 0x00};
+
+    std::vector<char> const file (make_blp (2, 0, 0, 8, 8, {mip0, mip1, mip2}));
+
+    BOOST_REQUIRE_EQUAL (blp_mip_count (header_of (file)), 3);
+    BOOST_REQUIRE ((pixel (decode (file, 0), 5, 4) == rgba {{0, 0, 255, 255}}));
+
+    rgba_image const small (decode (file, 2));
+    BOOST_REQUIRE_EQUAL (small.width, 2);
+    BOOST_REQUIRE_EQUAL (small.height, 2);
+    for (int i (0); i < 4; ++i)
+    {
+      BOOST_REQUIRE ((pixel (small, i % 2, i / 2) == rgba {{0, 0, 255, 255}}));
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (picks_the_smallest_mip_that_is_big_enough)
+  {
+    std::vector<std::vector<std::uint8_t>> mips (9, std::vector<std::uint8_t> (8));
+    BLPHeader const header (header_of (make_blp (2, 0, 0, 256, 128, mips)));
+
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header, -1, -1), 0);
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header, 1000, 1000), 0);
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header, 64, 32), 2);
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header, 65, 32), 1);
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header, 64, 64), 1);
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header, 1, 1), 8);
+
+    mips.resize (3);
+    BOOST_REQUIRE_EQUAL (blp_mip_for_size (header_of (make_blp (2, 0, 0, 256, 128, mips)), 1, 1), 2);
+  }
+
+  BOOST_AUTO_TEST_CASE (broken_and_unsupported_blps_throw)
+  {
+    std::vector<char> const file (make_blp (2, 0, 0, 4, 4, {color_block (red, blue)}));
+
+    BOOST_REQUIRE_THROW (decode_blp (file.data(), sizeof (BLPHeader) - 1, 0), std::runtime_error);
+    BOOST_REQUIRE_THROW (decode (file, 1), std::runtime_error);
+    BOOST_REQUIRE_THROW (decode_blp (file.data(), sizeof (BLPHeader) + 16, 0), std::runtime_error);
+    BOOST_REQUIRE_THROW (decode (make_blp (3, 8, 0, 4, 4, {std::vector<std::uint8_t> (64)})), std::runtime_error);
+    BOOST_REQUIRE_THROW (decode (make_blp (1, 8, 0, 4, 4, {std::vector<std::uint8_t> (20)})), std::runtime_error);
+  }
+
+  BOOST_AUTO_TEST_CASE (thumbnails_are_opaque_and_filtered)
+  {
+    rgba_image checker;
+    checker.width = 8;
+    checker.height = 8;
+    for (int i (0); i < 64; ++i)
+    {
+      std::uint8_t const value ((i % 8 + i / 8) % 2 ? 255 : 0);
+      checker.pixels.insert (checker.pixels.end(), {value, value, value, 17});
+    }
+
+    rgba_image const same (blp_thumbnail (checker, -1, -1));
+    BOOST_REQUIRE_EQUAL (same.width, 8);
+    BOOST_REQUIRE_EQUAL (same.height, 8);
+    for (int i (0); i < 64; ++i)
+    {
+      BOOST_REQUIRE_EQUAL (same.pixels[4 * i], checker.pixels[4 * i]);
+      BOOST_REQUIRE_EQUAL (same.pixels[4 * i + 3], 255);
+    }
+
+    rgba_image const half (blp_thumbnail (checker, 4, 4));
+    BOOST_REQUIRE_EQUAL (half.pixels.size(), 4u * 4 * 4);
+    for (int i (0); i < 16; ++i)
+    {
+      BOOST_REQUIRE_LE (std::abs (half.pixels[4 * i] - 128), 1);
+      BOOST_REQUIRE_EQUAL (half.pixels[4 * i + 3], 255);
+    }
+
+    rgba_image uniform (checker);
+    std::fill (uniform.pixels.begin(), uniform.pixels.end(), 99);
+    rgba_image const odd (blp_thumbnail (uniform, 13, 3));
+    BOOST_REQUIRE_EQUAL (odd.width, 13);
+    BOOST_REQUIRE_EQUAL (odd.height, 3);
+    for (int i (0); i < 13 * 3; ++i)
+    {
+      BOOST_REQUIRE_EQUAL (odd.pixels[4 * i], 99);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (thumbnail_cache_forgets_the_least_recently_used)
+  {
+    auto const image
+      ( [] (std::uint8_t value)
+        {
+          auto result (std::make_shared<rgba_image>());
+          result->width = 5;
+          result->height = 5;
+          result->pixels.assign (100, value);
+          return std::shared_ptr<rgba_image const> (result);
+        }
+      );
+
+    thumbnail_cache cache (300);
+    cache.insert ("a", 5, 5, image (1));
+    cache.insert ("b", 5, 5, image (2));
+    cache.insert ("c", 5, 5, image (3));
+    BOOST_REQUIRE_EQUAL (cache.bytes(), 300u);
+
+    BOOST_REQUIRE_EQUAL (cache.find ("a", 5, 5)->pixels[0], 1);
+    BOOST_REQUIRE (!cache.find ("a", 6, 5));
+
+    cache.insert ("d", 5, 5, image (4));
+    BOOST_REQUIRE_EQUAL (cache.size(), 3u);
+    BOOST_REQUIRE (!cache.find ("b", 5, 5));
+    BOOST_REQUIRE (cache.find ("a", 5, 5));
+
+    cache.insert ("c", 5, 5, image (5));
+    BOOST_REQUIRE_EQUAL (cache.bytes(), 300u);
+    BOOST_REQUIRE_EQUAL (cache.find ("c", 5, 5)->pixels[0], 5);
+
+    auto big (std::make_shared<rgba_image>());
+    big->pixels.resize (1000);
+    cache.insert ("big", 16, 16, big);
+    BOOST_REQUIRE_EQUAL (cache.size(), 1u);
+    BOOST_REQUIRE (cache.find ("big", 16, 16));
+  }
+}
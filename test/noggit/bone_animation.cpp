@@ -0,0 +1,234 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/bone_animation.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct random_bones
+    {
+      random_bones (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+
+      math::vector_3d vector (float min, float max)
+      {
+        return {real (min, max), real (min, max), real (min, max)};
+      }
+
+      math::quaternion rotation()
+      {
+        math::quaternion q (real (-1.f, 1.f), real (-1.f, 1.f), real (-1.f, 1.f), real (-1.f, 1.f));
+        q.normalize();
+        return q;
+      }
+
+      math::matrix_4x4 transform()
+      {
+        return affine_transform (vector (-5.f, 5.f), rotation(), vector (0.5f, 2.f));
+      }
+    };
+
+    void require_close (math::matrix_4x4 const& lhs, math::matrix_4x4 const& rhs, float tolerance)
+    {
+      for (std::size_t row (0); row < 4; ++row)
+      {
+        for (std::size_t column (0); column < 4; ++column)
+        {
+          BOOST_REQUIRE_SMALL (lhs (row, column) - rhs (row, column), tolerance);
+        }
+      }
+    }
+
+    // M2Value::getValue's search before keyframe_before
+    std::size_t linear_keyframe (std::vector<std::uint32_t> const& timestamps, std::uint32_t time)
+    {
+      size_t pos = 0;
+      for (size_t i = 0; i < timestamps.size() - 1; ++i)
+      {
+        if (time >= timestamps[i] && time < timestamps[i + 1])
+        {
+          pos = i;
+          break;
+        }
+      }
+      return pos;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (keyframe_before_finds_the_keyframe_the_linear_search_finds)
+  {
+    std::mt19937 engine (1);
+
+    for (std::size_t count (1); count < 60; ++count)
+    {
+      std::vector<std::uint32_t> timestamps;
+      for (std::size_t i (0); i < count; ++i)
+      {
+        // some keyframes share their time
+        timestamps.push_back (std::uniform_int_distribution<std::uint32_t> (0, count * 20) (engine));
+      }
+      std::sort (timestamps.begin(), timestamps.end());
+
+      for (std::uint32_t time (0); time < count * 20 + 40; ++time)
+      {
+        BOOST_REQUIRE_EQUAL (keyframe_before (timestamps, time), linear_keyframe (timestamps, time));
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parent_first_order_puts_parents_first)
+  {
+    std::mt19937 engine (2);
+
+    for (std::size_t count (1); count < 200; count += 7)
+    {
+      // parents anywhere in the list, not only before their children
+      std::vector<int> parents (count, -1);
+      std::vector<std::size_t> shuffled (count);
+      for (std::size_t i (0); i < count; ++i)
+      {
+        shuffled[i] = i;
+      }
+      std::shuffle (shuffled.begin(), shuffled.end(), engine);
+      for (std::size_t i (1); i < count; ++i)
+      {
+        parents[shuffled[i]] = shuffled[std::uniform_int_distribution<std::size_t> (0, i - 1) (engine)];
+      }
+
+      auto const order (parent_first_order (parents));
+      BOOST_REQUIRE_EQUAL (order.size(), count);
+
+      std::vector<std::size_t> position (count, count);
+      for (std::size_t i (0); i < count; ++i)
+      {
+        BOOST_REQUIRE_EQUAL (position[order[i]], count);
+        position[order[i]] = i;
+      }
+      for (std::size_t bone (0); bone < count; ++bone)
+      {
+        if (parents[bone] >= 0)
+        {
+          BOOST_REQUIRE_LT (position[parents[bone]], position[bone]);
+        }
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parent_first_order_survives_broken_parents)
+  {
+    // 1 is out of range, 2 and 3 are each other's parent
+    auto const order (parent_first_order ({-1, 17, 3, 2, 0}));
+
+    BOOST_REQUIRE ((order == std::vector<std::size_t> {0, 1, 4, 2, 3}));
+  }
+
+  BOOST_AUTO_TEST_CASE (affine_transform_is_the_product_of_its_parts)
+  {
+    random_bones generator (3);
+
+    for (int i (0); i < 200; ++i)
+    {
+      math::vector_3d const pivot (generator.vector (-10.f, 10.f));
+      math::vector_3d const translation (generator.vector (-10.f, 10.f));
+      math::quaternion const rotation (generator.rotation());
+      math::vector_3d const scale (generator.vector (0.1f, 3.f));
+
+      // Bone::calcMatrix before affine_transform
+      math::matrix_4x4 expected (math::matrix_4x4::translation, pivot);
+      expected *= math::matrix_4x4 (math::matrix_4x4::translation, translation);
+      expected *= math::matrix_4x4 (math::matrix_4x4::rotation, rotation);
+      expected *= math::matrix_4x4 (math::matrix_4x4::scale, scale);
+      expected *= math::matrix_4x4 (math::matrix_4x4::translation, -pivot);
+
+      math::matrix_4x4 m (affine_transform (pivot + translation, rotation, scale));
+      affine_translate (m, -pivot);
+
+      require_close (m, expected, 1e-4f);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (affine_product_is_the_matrix_product)
+  {
+    random_bones generator (4);
+
+    for (int i (0); i < 200; ++i)
+    {
+      math::matrix_4x4 const lhs (generator.transform());
+      math::matrix_4x4 const rhs (generator.transform());
+
+      require_close (affine_product (lhs, rhs), lhs * rhs, 1e-4f);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (evaluating_parents_first_matches_the_recursion)
+  {
+    random_bones generator (5);
+    std::size_t const count (120);
+
+    std::vector<int> parents (count, -1);
+    std::vector<math::matrix_4x4> local;
+    for (std::size_t i (0); i < count; ++i)
+    {
+      // children before parents, the worst case for a single pass in order
+      parents[i] = i + 1 < count && i % 9 ? static_cast<int> (i + 1 + i % 3) % static_cast<int> (count) : -1;
+      if (parents[i] >= 0 && static_cast<std::size_t> (parents[i]) <= i)
+      {
+        parents[i] = -1;
+      }
+      local.push_back (generator.transform());
+    }
+
+    // Bone::calcMatrix before parent_first_order
+    std::vector<math::matrix_4x4> expected (count, math::matrix_4x4::unit);
+    std::vector<bool> calc (count, false);
+    std::function<void (std::size_t)> recurse
+      ( [&] (std::size_t bone)
+        {
+          if (calc[bone])
+          {
+            return;
+          }
+          if (parents[bone] >= 0)
+          {
+            recurse (parents[bone]);
+            expected[bone] = expected[parents[bone]] * local[bone];
+          }
+          else
+          {
+            expected[bone] = local[bone];
+          }
+          calc[bone] = true;
+        }
+      );
+    for (std::size_t bone (0); bone < count; ++bone)
+    {
+      recurse (bone);
+    }
+
+    std::vector<math::matrix_4x4> result (count, math::matrix_4x4::unit);
+    for (std::size_t bone : parent_first_order (parents))
+    {
+      result[bone] = parents[bone] >= 0 ? affine_product (result[parents[bone]], local[bone]) : local[bone];
+    }
+
+    for (std::size_t bone (0); bone < count; ++bone)
+    {
+      require_close (result[bone], expected[bone], 1e-2f);
+    }
+  }
+}
@@ -0,0 +1,257 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/chunk_edit.hpp>
+#include <noggit/job_scheduler.hpp>
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    float const unit_size (100.f / 3.f / 8.f);
+    float const chunk_size (unit_size * 8.f);
+
+    // the vertices of a chunk as far as the height brushes care
+    struct chunk
+    {
+      std::array<float, 145> x;
+      std::array<float, 145> y;
+      std::array<float, 145> z;
+      int posts = 0;
+    };
+
+    std::vector<chunk> make_chunks (unsigned seed)
+    {
+      std::mt19937 engine (seed);
+      std::uniform_real_distribution<float> height (-50.f, 50.f);
+
+      std::vector<chunk> chunks (16 * 16);
+      for (int py (0); py < 16; ++py)
+      {
+        for (int px (0); px < 16; ++px)
+        {
+          chunk& c (chunks[py * 16 + px]);
+          int v (0);
+          for (int j (0); j < 17; ++j)
+          {
+            for (int i (0); i < ((j % 2) ? 8 : 9); ++i, ++v)
+            {
+              c.x[v] = px * chunk_size + i * unit_size + ((j % 2) ? unit_size * 0.5f : 0.f);
+              c.z[v] = py * chunk_size + j * 0.5f * unit_size;
+              c.y[v] = height (engine);
+            }
+          }
+        }
+      }
+
+      return chunks;
+    }
+
+    // MapChunk::changeTerrain with the linear brush
+    bool raise (chunk& c, float px, float pz, float change, float radius, float inner_radius)
+    {
+      bool changed (false);
+      for (std::size_t i (0); i < c.y.size(); ++i)
+      {
+        float const xdiff (c.x[i] - px);
+        float const zdiff (c.z[i] - pz);
+        float const dist (std::sqrt (xdiff * xdiff + zdiff * zdiff));
+        if (dist < radius)
+        {
+          c.y[i] += change * (1.0f - dist * (1.0f - inner_radius) / radius);
+          changed = true;
+        }
+      }
+      return changed;
+    }
+
+    // MapChunk::flattenTerrain with the smooth brush towards a flat plane
+    bool flatten (chunk& c, float px, float pz, float target, float remain, float radius)
+    {
+      bool changed (false);
+      for (std::size_t i (0); i < c.y.size(); ++i)
+      {
+        float const xdiff (c.x[i] - px);
+        float const zdiff (c.z[i] - pz);
+        float const dist (std::sqrt (xdiff * xdiff + zdiff * zdiff));
+        if (dist < radius)
+        {
+          float const t (std::pow (remain, 1.f + dist / radius));
+          c.y[i] = target * (1.f - t) + c.y[i] * t;
+          changed = true;
+        }
+      }
+      return changed;
+    }
+
+    struct stroke
+    {
+      float x, z, radius;
+    };
+
+    std::vector<stroke> make_strokes (unsigned seed)
+    {
+      std::mt19937 engine (seed);
+      std::uniform_real_distribution<float> position (0.f, 16.f * chunk_size);
+      std::uniform_real_distribution<float> radius (10.f, 400.f);
+
+      std::vector<stroke> strokes;
+      for (int i (0); i < 40; ++i)
+      {
+        strokes.push_back ({position (engine), position (engine), radius (engine)});
+      }
+      return strokes;
+    }
+
+    // what World::edit_chunks_in_range does, on the fake chunks in range
+    std::vector<chunk> apply (job_scheduler* scheduler, unsigned seed, std::vector<std::size_t>* order)
+    {
+      std::vector<chunk> chunks (make_chunks (seed));
+
+      for (stroke const& s : make_strokes (seed))
+      {
+        std::vector<chunk*> in_range;
+        for (chunk& c : chunks)
+        {
+          float const cx (c.x[0] + chunk_size / 2.f - s.x);
+          float const cz (c.z[0] + chunk_size / 2.f - s.z);
+          if (std::sqrt (cx * cx + cz * cz) < s.radius + chunk_size)
+          {
+            in_range.push_back (&c);
+          }
+        }
+
+        edit_chunks
+          ( scheduler
+          , in_range
+          , [&] (chunk* c)
+            {
+              bool const raised (raise (*c, s.x, s.z, 3.f, s.radius, 0.5f));
+              return flatten (*c, s.x, s.z, 10.f, 0.7f, s.radius / 2.f) || raised;
+            }
+          , [&] (chunk* c)
+            {
+              ++c->posts;
+              order->push_back (c - chunks.data());
+            }
+          );
+      }
+
+      return chunks;
+    }
+
+    bool same_bits (std::vector<chunk> const& lhs, std::vector<chunk> const& rhs)
+    {
+      for (std::size_t i (0); i < lhs.size(); ++i)
+      {
+        if ( std::memcmp (lhs[i].y.data(), rhs[i].y.data(), sizeof (lhs[i].y))
+          || lhs[i].posts != rhs[i].posts
+           )
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_edits_give_the_same_heights_as_serial_ones)
+  {
+    job_scheduler scheduler (7, 1);
+
+    for (unsigned seed (0); seed < 5; ++seed)
+    {
+      std::vector<std::size_t> serial_order;
+      std::vector<std::size_t> parallel_order;
+
+      auto const serial (apply (nullptr, seed, &serial_order));
+      auto const parallel (apply (&scheduler, seed, &parallel_order));
+
+      BOOST_REQUIRE (same_bits (serial, parallel));
+      BOOST_REQUIRE (serial_order == parallel_order);
+      BOOST_REQUIRE (!serial_order.empty());
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (changed_runs_on_the_calling_thread_in_the_order_of_the_items)
+  {
+    job_scheduler scheduler (3, 1);
+
+    std::vector<int> items;
+    for (int i (0); i < 1000; ++i)
+    {
+      items.push_back (i);
+    }
+
+    std::atomic<std::size_t> edits (0);
+    std::vector<int> changed;
+    std::thread::id const caller (std::this_thread::get_id());
+
+    bool const any
+      ( edit_chunks ( &scheduler
+                    , items
+                    , [&] (int i)
+                      {
+                        ++edits;
+                        return i % 3 == 0;
+                      }
+                    , [&] (int i)
+                      {
+                        BOOST_REQUIRE (std::this_thread::get_id() == caller);
+                        changed.push_back (i);
+                      }
+                    )
+      );
+
+    BOOST_REQUIRE (any);
+    BOOST_REQUIRE_EQUAL (edits.load(), items.size());
+    BOOST_REQUIRE_EQUAL (changed.size(), 334);
+    for (std::size_t i (0); i < changed.size(); ++i)
+    {
+      BOOST_REQUIRE_EQUAL (changed[i], static_cast<int> (i * 3));
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (nothing_changed_is_reported_as_such)
+  {
+    job_scheduler scheduler (2, 1);
+    std::vector<int> const items (50, 0);
+
+    BOOST_REQUIRE (!edit_chunks (&scheduler, items, [] (int) { return false; }, [] (int) { BOOST_FAIL ("unchanged"); }));
+    BOOST_REQUIRE (!edit_chunks (nullptr, std::vector<int>(), [] (int) { return true; }, [] (int) {}));
+  }
+
+  BOOST_AUTO_TEST_CASE (an_exception_in_an_edit_reaches_the_caller)
+  {
+    job_scheduler scheduler (3, 1);
+    std::vector<int> items (100);
+    for (int i (0); i < 100; ++i)
+    {
+      items[i] = i;
+    }
+
+    BOOST_REQUIRE_THROW
+      ( edit_chunks ( &scheduler
+                    , items
+                    , [] (int i) -> bool
+                      {
+                        if (i == 57)
+                        {
+                          throw std::logic_error ("bad brush type");
+                        }
+                        return true;
+                      }
+                    , [] (int) {}
+                    )
+      , std::logic_error
+      );
+  }
+}
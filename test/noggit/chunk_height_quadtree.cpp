@@ -0,0 +1,171 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/chunk_height_quadtree.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    using hit = std::tuple<float, int, int, int>;
+
+    struct chunk
+    {
+      std::array<math::vector_3d, 145> vertices;
+      std::uint32_t holes = 0;
+
+      bool is_hole (int row, int column) const
+      {
+        return holes & (1 << ((row / 2) * 4 + column / 2));
+      }
+
+      // MapChunk::initStrip's lod 0 strip with MapChunk::intersect's loop
+      std::vector<hit> brute_force (math::ray const& ray, bool ignore_holes) const
+      {
+        std::vector<hit> result;
+        for (int x (0); x < 8; ++x)
+        {
+          for (int y (0); y < 8; ++y)
+          {
+            if (!ignore_holes && is_hole (y, x))
+            {
+              continue;
+            }
+
+            int const start (chunk_height_quadtree::outer_vertex (y, x));
+            for (auto const& triangle : {std::array<int, 3> {{9, 0, 17}}, {{9, 17, 18}}, {{9, 18, 1}}, {{9, 1, 0}}})
+            {
+              if ( auto distance = ray.intersect_triangle ( vertices[start + triangle[0]]
+                                                          , vertices[start + triangle[1]]
+                                                          , vertices[start + triangle[2]]
+                                                          )
+                 )
+              {
+                result.emplace_back (*distance, start + triangle[0], start + triangle[1], start + triangle[2]);
+              }
+            }
+          }
+        }
+        std::sort (result.begin(), result.end());
+        return result;
+      }
+
+      std::vector<hit> with (chunk_height_quadtree const& quadtree, math::ray const& ray, bool ignore_holes) const
+      {
+        std::vector<hit> result;
+        quadtree.intersect ( ray
+                           , [&] (int vertex) -> math::vector_3d const& { return vertices[vertex]; }
+                           , [&] (int row, int column) { return !ignore_holes && is_hole (row, column); }
+                           , [&] (float distance, int a, int b, int c) { result.emplace_back (distance, a, b, c); }
+                           );
+        std::sort (result.begin(), result.end());
+        return result;
+      }
+    };
+
+    struct random_chunks
+    {
+      random_chunks (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+
+      // laid out like MapChunk's constructor does from MCVT
+      chunk terrain (bool flat)
+      {
+        chunk result;
+        math::vector_3d const base (real (0.f, 30000.f), real (-100.f, 100.f), real (0.f, 30000.f));
+        auto vertex (result.vertices.begin());
+
+        for (int j (0); j < 17; ++j)
+        {
+          for (int i (0); i < ((j % 2) ? 8 : 9); ++i)
+          {
+            float const x (i * UNITSIZE + ((j % 2) ? UNITSIZE * 0.5f : 0.f));
+            *vertex++ = base + math::vector_3d (x, flat ? 0.f : real (-20.f, 20.f), j * 0.5f * UNITSIZE);
+          }
+        }
+
+        result.holes = std::uniform_int_distribution<std::uint32_t> (0, 0xFFFF) (engine) & std::uniform_int_distribution<std::uint32_t> (0, 0xFFFF) (engine);
+        return result;
+      }
+
+      // aimed somewhere at the chunk, from around above it
+      math::ray ray (chunk const& terrain)
+      {
+        math::vector_3d const target ( terrain.vertices[0].x + real (-2.f, CHUNKSIZE + 2.f)
+                                     , terrain.vertices[0].y + real (-20.f, 20.f)
+                                     , terrain.vertices[0].z + real (-2.f, CHUNKSIZE + 2.f)
+                                     );
+        math::vector_3d const origin (target + math::vector_3d (real (-300.f, 300.f), real (-50.f, 300.f), real (-300.f, 300.f)));
+
+        return {origin, target - origin};
+      }
+    };
+  }
+
+  BOOST_AUTO_TEST_CASE (chunk_height_quadtree_finds_the_same_hits_as_the_index_strip)
+  {
+    for (unsigned seed (0); seed < 40; ++seed)
+    {
+      random_chunks generator (seed);
+      chunk const terrain (generator.terrain (seed % 4 == 0));
+
+      chunk_height_quadtree quadtree;
+      quadtree.refit ([&] (int vertex) { return terrain.vertices[vertex]; });
+
+      std::size_t hit_count (0);
+      for (int i (0); i < 200; ++i)
+      {
+        math::ray const ray (generator.ray (terrain));
+        bool const ignore_holes (i % 2);
+        auto const expected (terrain.brute_force (ray, ignore_holes));
+
+        BOOST_REQUIRE (terrain.with (quadtree, ray, ignore_holes) == expected);
+        hit_count += expected.size();
+      }
+
+      BOOST_REQUIRE_GT (hit_count, 0);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (chunk_height_quadtree_follows_moved_vertices)
+  {
+    random_chunks generator (5);
+    chunk terrain (generator.terrain (true));
+    terrain.holes = 0;
+
+    chunk_height_quadtree quadtree;
+    quadtree.refit ([&] (int vertex) { return terrain.vertices[vertex]; });
+
+    // e.g. the chunk mover
+    for (auto& vertex : terrain.vertices)
+    {
+      vertex.x += CHUNKSIZE;
+    }
+
+    math::ray const down ( terrain.vertices[0] + math::vector_3d (10.f, 100.f, 10.f)
+                         , {0.f, -1.f, 0.f}
+                         );
+
+    BOOST_REQUIRE (terrain.with (quadtree, down, false).empty());
+
+    quadtree.refit ([&] (int vertex) { return terrain.vertices[vertex]; });
+
+    BOOST_REQUIRE_EQUAL (terrain.with (quadtree, down, false).size(), 1);
+    BOOST_REQUIRE (terrain.with (quadtree, down, false) == terrain.brute_force (down, false));
+  }
+}
@@ -0,0 +1,259 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/file_save_batch.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct temporary_folder
+    {
+      temporary_folder()
+        : path (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+      {
+        boost::filesystem::create_directories (path);
+      }
+      ~temporary_folder()
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all (path, ec);
+      }
+
+      boost::filesystem::path const path;
+    };
+
+    std::vector<char> contents_of (boost::filesystem::path const& path)
+    {
+      std::ifstream input (path.string(), std::ios_base::binary);
+      return {std::istreambuf_iterator<char> (input), std::istreambuf_iterator<char>()};
+    }
+
+    std::size_t files_in (boost::filesystem::path const& folder)
+    {
+      std::size_t count (0);
+      for (auto const& entry : boost::filesystem::recursive_directory_iterator (folder))
+      {
+        count += boost::filesystem::is_regular_file (entry.path());
+      }
+      return count;
+    }
+
+    //! stand-in for a tile: deterministic, differently sized contents
+    std::vector<char> fake_tile (std::size_t index)
+    {
+      std::vector<char> data ((index * 7919) % (256 * 1024));
+      std::uint32_t state (static_cast<std::uint32_t> (index) * 2654435761u + 1);
+      for (char& c : data)
+      {
+        state = state * 1664525u + 1013904223u;
+        c = static_cast<char> (state >> 24);
+      }
+      return data;
+    }
+
+    std::string tile_name (std::size_t index)
+    {
+      return "world/maps/test/test_" + std::to_string (index % 64) + "_" + std::to_string (index / 64) + ".adt";
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_saving_matches_sequential_saving)
+  {
+    std::size_t const count (150);
+    temporary_folder const sequential;
+    temporary_folder const parallel;
+
+    // every third tile also has an export variant, like the MCLQ one
+    auto const tile_files
+      ( [] (boost::filesystem::path const& folder, std::size_t i)
+        {
+          std::vector<serialized_file> files;
+          files.push_back ({folder / tile_name (i), fake_tile (i)});
+          if (i % 3 == 0)
+          {
+            files.push_back ({folder / "export" / tile_name (i), fake_tile (i + 1000)});
+          }
+          return files;
+        }
+      );
+
+    for (std::size_t i (0); i < count; ++i)
+    {
+      for (auto const& file : tile_files (sequential.path, i))
+      {
+        write_file_atomically (file.destination, file.data.data(), file.data.size());
+      }
+    }
+
+    job_scheduler scheduler (8, 2);
+    file_save_batch batch (scheduler);
+
+    for (std::size_t i (0); i < count; ++i)
+    {
+      batch.add (tile_name (i), [&, i] { return tile_files (parallel.path, i); });
+    }
+
+    batch.wait_serialized();
+
+    std::size_t last_done (0);
+    auto const result
+      ( batch.wait ( [&] (file_save_batch::progress const& progress)
+                     {
+                       std::size_t const done (progress.saved + progress.failed + progress.cancelled);
+                       BOOST_REQUIRE_GE (done, last_done);
+                       BOOST_REQUIRE_EQUAL (progress.total, count);
+                       last_done = done;
+                       return true;
+                     }
+                   )
+      );
+
+    BOOST_REQUIRE_EQUAL (result.saved, count);
+    BOOST_REQUIRE_EQUAL (result.failed, 0);
+    BOOST_REQUIRE_EQUAL (last_done, count);
+    BOOST_REQUIRE_EQUAL (files_in (parallel.path), files_in (sequential.path));
+
+    for (std::size_t i (0); i < count; ++i)
+    {
+      BOOST_REQUIRE (batch.saved (i));
+      for (auto const& file : tile_files (sequential.path, i))
+      {
+        auto const relative (file.destination.lexically_relative (sequential.path));
+        BOOST_REQUIRE (contents_of (file.destination) == contents_of (parallel.path / relative));
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (failing_serializers_only_fail_their_file)
+  {
+    temporary_folder const folder;
+    auto const existing (folder.path / "existing.adt");
+    write_file_atomically (existing, "old", 3);
+
+    job_scheduler scheduler (4, 2);
+    file_save_batch batch (scheduler);
+
+    auto const single_file
+      ( [&] (std::string name, char fill)
+        {
+          return std::vector<serialized_file> ({{folder.path / name, std::vector<char> (100, fill)}});
+        }
+      );
+
+    batch.add ("first", [&] { return single_file ("first.adt", 'a'); });
+    std::size_t const failing
+      (batch.add ("existing", []() -> std::vector<serialized_file> { throw std::runtime_error ("broken tile"); }));
+    batch.add ("second", [&] { return single_file ("second.adt", 'b'); });
+
+    auto const result (batch.wait());
+
+    BOOST_REQUIRE_EQUAL (result.saved, 2);
+    BOOST_REQUIRE_EQUAL (result.failed, 1);
+    BOOST_REQUIRE (!batch.saved (failing));
+
+    auto const failures (batch.failures());
+    BOOST_REQUIRE_EQUAL (failures.size(), 1);
+    BOOST_REQUIRE_EQUAL (failures[0].first, "existing");
+    BOOST_REQUIRE_EQUAL (failures[0].second, "broken tile");
+
+    BOOST_REQUIRE (contents_of (existing) == std::vector<char> ({'o', 'l', 'd'}));
+    BOOST_REQUIRE_EQUAL (files_in (folder.path), 3);
+  }
+
+  BOOST_AUTO_TEST_CASE (cancelling_drops_files_not_yet_written)
+  {
+    temporary_folder const folder;
+
+    std::mutex gate_guard;
+    std::condition_variable gate_opened;
+    bool gate_open (false);
+    std::atomic<std::size_t> started (0);
+
+    job_scheduler scheduler (2, 2);
+    std::size_t const count (50);
+
+    file_save_batch::progress result;
+    {
+      file_save_batch batch (scheduler);
+
+      for (std::size_t i (0); i < count; ++i)
+      {
+        batch.add ( tile_name (i)
+                  , [&, i]
+                    {
+                      ++started;
+                      std::unique_lock<std::mutex> lock (gate_guard);
+                      gate_opened.wait (lock, [&] { return gate_open; });
+                      return std::vector<serialized_file> ({{folder.path / tile_name (i), fake_tile (i)}});
+                    }
+                  );
+      }
+
+      while (started.load() < 2)
+      {
+        std::this_thread::yield();
+      }
+
+      batch.cancel();
+      {
+        std::lock_guard<std::mutex> const lock (gate_guard);
+        gate_open = true;
+      }
+      gate_opened.notify_all();
+
+      // too late for this one
+      batch.add ("late", [&] { return std::vector<serialized_file> ({{folder.path / "late.adt", {'x'}}}); });
+
+      result = batch.wait();
+    }
+
+    BOOST_REQUIRE (result.finished());
+    BOOST_REQUIRE_EQUAL (result.failed, 0);
+    BOOST_REQUIRE_EQUAL (result.total, count + 1);
+    BOOST_REQUIRE_GE (result.cancelled, count - 1);
+    BOOST_REQUIRE_EQUAL (files_in (folder.path), result.saved);
+  }
+
+  BOOST_AUTO_TEST_CASE (progress_callbacks_can_cancel)
+  {
+    temporary_folder const folder;
+    job_scheduler scheduler (1, 2);
+    file_save_batch batch (scheduler);
+    std::size_t const count (50);
+
+    for (std::size_t i (0); i < count; ++i)
+    {
+      batch.add ( tile_name (i)
+                , [&, i]
+                  {
+                    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+                    return std::vector<serialized_file> ({{folder.path / tile_name (i), fake_tile (i)}});
+                  }
+                );
+    }
+
+    std::size_t calls (0);
+    auto const result
+      (batch.wait ([&] (file_save_batch::progress const&) { ++calls; return false; }));
+
+    BOOST_REQUIRE (result.finished());
+    BOOST_REQUIRE_GE (calls, 1);
+    BOOST_REQUIRE_GE (result.cancelled, 1);
+    BOOST_REQUIRE_EQUAL (files_in (folder.path), result.saved);
+  }
+}
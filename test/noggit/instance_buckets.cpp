@@ -0,0 +1,182 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/instance_buckets.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct model {};
+
+    struct instance
+    {
+      model* m;
+    };
+
+    using buckets = instance_buckets<model, instance>;
+    using sorted_buckets = std::map<model*, std::vector<instance*>>;
+
+    // what World::update_models_by_filename used to build from scratch
+    sorted_buckets rebuilt (std::unordered_map<std::uint32_t, std::unique_ptr<instance>> const& storage)
+    {
+      sorted_buckets result;
+      for (auto const& it : storage)
+      {
+        result[it.second->m].push_back (it.second.get());
+      }
+      for (auto& it : result)
+      {
+        std::sort (it.second.begin(), it.second.end());
+      }
+      return result;
+    }
+
+    // the order inside a bucket doesn't matter for drawing
+    sorted_buckets sorted (buckets const& incremental)
+    {
+      sorted_buckets result;
+      for (auto const& it : incremental)
+      {
+        BOOST_REQUIRE (!it.second.empty());
+        result[it.first] = it.second;
+        std::sort (result[it.first].begin(), result[it.first].end());
+      }
+      return result;
+    }
+
+    struct random_edits
+    {
+      random_edits (unsigned seed)
+        : engine (seed)
+        , models (20)
+      {}
+
+      std::mt19937 engine;
+      std::vector<model> models;
+      std::unordered_map<std::uint32_t, std::unique_ptr<instance>> storage;
+      std::uint32_t next_uid = 0;
+      buckets incremental;
+
+      std::size_t index (std::size_t count)
+      {
+        return std::uniform_int_distribution<std::size_t> (0, count - 1) (engine);
+      }
+
+      std::uint32_t random_uid()
+      {
+        auto it (storage.begin());
+        std::advance (it, index (storage.size()));
+        return it->first;
+      }
+
+      void add()
+      {
+        auto& stored (storage[next_uid++]);
+        stored.reset (new instance {&models[index (models.size())]});
+        incremental.add (stored->m, stored.get());
+      }
+
+      // the instance is destroyed before the buckets hear about it
+      void remove()
+      {
+        std::uint32_t const uid (random_uid());
+        instance* removed (storage.at (uid).get());
+        storage.erase (uid);
+        incremental.remove (removed);
+      }
+
+      // a wmo doodad getting another model when its doodad set changes
+      void change_model()
+      {
+        instance& changed (*storage.at (random_uid()));
+        changed.m = &models[index (models.size())];
+        incremental.add (changed.m, &changed);
+      }
+
+      void edit()
+      {
+        std::size_t const kind (index (10));
+
+        if (storage.empty() || kind < 5)
+        {
+          add();
+        }
+        else if (kind < 9)
+        {
+          remove();
+        }
+        else
+        {
+          change_model();
+        }
+      }
+    };
+  }
+
+  BOOST_AUTO_TEST_CASE (buckets_match_a_full_rebuild_after_random_edits)
+  {
+    for (unsigned seed (0); seed < 10; ++seed)
+    {
+      random_edits edits (seed);
+
+      for (std::size_t i (0); i < 5000; ++i)
+      {
+        edits.edit();
+
+        if (i % 100 == 0)
+        {
+          BOOST_REQUIRE (sorted (edits.incremental) == rebuilt (edits.storage));
+        }
+      }
+
+      BOOST_REQUIRE (sorted (edits.incremental) == rebuilt (edits.storage));
+      BOOST_REQUIRE_EQUAL (edits.incremental.size(), edits.storage.size());
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (removing_everything_drops_every_bucket)
+  {
+    random_edits edits (42);
+
+    for (std::size_t i (0); i < 1000; ++i)
+    {
+      edits.add();
+    }
+    while (!edits.storage.empty())
+    {
+      edits.remove();
+    }
+
+    BOOST_REQUIRE (edits.incremental.empty());
+    BOOST_REQUIRE (edits.incremental.buckets().empty());
+  }
+
+  BOOST_AUTO_TEST_CASE (adding_twice_or_removing_unknown_instances_changes_nothing)
+  {
+    model a;
+    model b;
+    instance first {&a};
+    instance second {&a};
+    instance unknown {&b};
+
+    buckets incremental;
+    incremental.add (&a, &first);
+    incremental.add (&a, &second);
+    incremental.add (&a, &first);
+    incremental.remove (&unknown);
+
+    BOOST_REQUIRE_EQUAL (incremental.size(), 2);
+    BOOST_REQUIRE_EQUAL (incremental.buckets().size(), 1);
+    BOOST_REQUIRE_EQUAL (incremental.buckets().at (&a).size(), 2);
+    BOOST_REQUIRE (incremental.contains (&first));
+    BOOST_REQUIRE (!incremental.contains (&unknown));
+  }
+}
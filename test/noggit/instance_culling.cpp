@@ -0,0 +1,222 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/instance_culling.hpp>
+#include <noggit/job_scheduler.hpp>
+
+#include <math/frustum.hpp>
+#include <math/projection.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct instance
+    {
+      math::vector_3d pos;
+      float radius;
+      float size_cat;
+      math::matrix_4x4 transform = math::matrix_4x4::unit;
+    };
+
+    // ModelInstance::is_visible
+    bool model_is_visible ( instance const& i
+                          , math::frustum const& frustum
+                          , const float& cull_distance
+                          , const math::vector_3d& camera
+                          , display_mode display
+                          )
+    {
+      float dist;
+
+      if (display == display_mode::in_3D)
+      {
+        dist = (i.pos - camera).length() - i.radius;
+      }
+      else
+      {
+        dist = std::abs(i.pos.y - camera.y) - i.radius;
+      }
+
+      if (dist >= cull_distance)
+      {
+        return false;
+      }
+
+      if (i.size_cat < 1.f && dist > 30.f)
+      {
+        return false;
+      }
+      else if (i.size_cat < 4.f && dist > 150.f)
+      {
+        return false;
+      }
+      else if (i.size_cat < 25.f && dist > 300.f)
+      {
+        return false;
+      }
+
+      return frustum.intersectsSphere(i.pos, i.radius);
+    }
+
+    // WMOInstance::is_visible
+    bool wmo_is_visible ( instance const& i
+                        , math::frustum const& frustum
+                        , float const& cull_distance
+                        , math::vector_3d const& camera
+                        , display_mode display
+                        )
+    {
+      if (!frustum.intersectsSphere(i.pos, i.radius))
+      {
+        return false;
+      }
+
+      float dist = display == display_mode::in_3D
+        ? (i.pos - camera).length() - i.radius
+        : std::abs(i.pos.y - camera.y) - i.radius;
+
+      return (dist < cull_distance);
+    }
+
+    std::vector<std::vector<instance>> random_groups (std::mt19937& engine)
+    {
+      std::uniform_real_distribution<float> position (-800.f, 800.f);
+      std::uniform_real_distribution<float> size (0.f, 40.f);
+      std::uniform_int_distribution<int> count (0, 300);
+
+      std::vector<std::vector<instance>> groups (120);
+      for (auto& group : groups)
+      {
+        float const radius (size (engine));
+        group.resize (count (engine));
+        for (auto& i : group)
+        {
+          i.pos = {position (engine), position (engine) * 0.1f, position (engine)};
+          i.radius = radius * std::uniform_real_distribution<float> (0.5f, 2.f) (engine);
+          i.size_cat = size (engine);
+          i.transform (0, 3, i.pos.x);
+          i.transform (1, 3, i.pos.y);
+          i.transform (2, 3, i.pos.z);
+        }
+      }
+      return groups;
+    }
+
+    void check_against_instances ( bool models
+                                 , std::vector<std::vector<instance>> const& groups
+                                 , instance_culling& culling
+                                 , job_scheduler& scheduler
+                                 , std::mt19937& engine
+                                 )
+    {
+      std::vector<std::size_t> sizes;
+      for (auto const& group : groups)
+      {
+        sizes.push_back (group.size());
+      }
+      culling.reset (sizes);
+
+      for (std::size_t g (0); g < groups.size(); ++g)
+      {
+        for (std::size_t i (0); i < groups[g].size(); ++i)
+        {
+          instance const& in (groups[g][i]);
+          culling.set (culling.group_begin (g) + i, in.pos, in.radius, in.size_cat, in.transform);
+        }
+      }
+
+      std::uniform_real_distribution<float> position (-500.f, 500.f);
+      math::vector_3d const camera (position (engine), 50.f, position (engine));
+      math::vector_3d const target (position (engine), 0.f, position (engine));
+      math::frustum const frustum
+        ( math::perspective (math::degrees (54.f), 1.6f, 1.f, 2048.f)
+        * math::look_at (camera, target, {0.f, 1.f, 0.f})
+        );
+
+      for (display_mode display : {display_mode::in_3D, display_mode::in_2D})
+      {
+        float const cull_distance (display == display_mode::in_3D ? 384.f : 1000.f);
+        culling.cull (scheduler, frustum, cull_distance, camera, display);
+
+        std::size_t visible_count (0);
+        for (std::size_t g (0); g < groups.size(); ++g)
+        {
+          std::vector<math::matrix_4x4> expected;
+          for (std::size_t i (0); i < groups[g].size(); ++i)
+          {
+            instance const& in (groups[g][i]);
+            bool const visible
+              ( models ? model_is_visible (in, frustum, cull_distance, camera, display)
+                       : wmo_is_visible (in, frustum, cull_distance, camera, display)
+              );
+
+            BOOST_REQUIRE_EQUAL (culling.visible (culling.group_begin (g) + i), visible);
+            if (visible)
+            {
+              expected.push_back (in.transform);
+            }
+          }
+
+          std::vector<math::matrix_4x4> const& result (culling.visible_transforms (g));
+          BOOST_REQUIRE_EQUAL (result.size(), expected.size());
+          for (std::size_t i (0); i < result.size(); ++i)
+          {
+            for (std::size_t element (0); element < 16; ++element)
+            {
+              BOOST_REQUIRE_EQUAL (result[i][element], expected[i][element]);
+            }
+          }
+          visible_count += result.size();
+        }
+
+        // make sure the camera saw something, or the test tells nothing
+        if (display == display_mode::in_2D)
+        {
+          BOOST_REQUIRE_GT (visible_count, 0);
+        }
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (culls_models_like_their_instances)
+  {
+    std::mt19937 engine (3);
+    job_scheduler scheduler (3, 1);
+    instance_culling culling (true);
+
+    for (int round (0); round < 10; ++round)
+    {
+      check_against_instances (true, random_groups (engine), culling, scheduler, engine);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (culls_wmos_like_their_instances)
+  {
+    std::mt19937 engine (4);
+    job_scheduler scheduler (3, 1);
+    instance_culling culling (false);
+
+    for (int round (0); round < 10; ++round)
+    {
+      check_against_instances (false, random_groups (engine), culling, scheduler, engine);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (culling_without_instances_gives_no_groups)
+  {
+    job_scheduler scheduler (1, 1);
+    instance_culling culling (true);
+    culling.reset ({});
+    culling.cull ( scheduler
+                 , math::frustum (math::matrix_4x4 (math::matrix_4x4::unit))
+                 , 100.f, {0.f, 0.f, 0.f}, display_mode::in_3D
+                 );
+
+    BOOST_REQUIRE_EQUAL (culling.size(), 0);
+    BOOST_REQUIRE_EQUAL (culling.group_count(), 0);
+  }
+}
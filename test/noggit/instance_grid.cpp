@@ -0,0 +1,266 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/instance_grid.hpp>
+#include <noggit/MapHeaders.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct stored_instance
+    {
+      math::vector_3d pos;
+      boost::optional<instance_grid::bounds> bounds;
+    };
+
+    struct random_instances
+    {
+      random_instances (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+      std::unordered_map<std::uint32_t, stored_instance> instances;
+      instance_grid grid;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+      bool chance (std::uint32_t percent)
+      {
+        return std::uniform_int_distribution<std::uint32_t> (0, 99) (engine) < percent;
+      }
+
+      // a few tiles, with positions right on chunk borders now and then
+      float coordinate()
+      {
+        float const value (real (30.f * TILESIZE, 33.f * TILESIZE));
+        return chance (10) ? std::round (value / CHUNKSIZE) * CHUNKSIZE : value;
+      }
+
+      stored_instance instance()
+      {
+        stored_instance result;
+        result.pos = {coordinate(), real (-100.f, 300.f), coordinate()};
+
+        if (!chance (10))
+        {
+          // wmos can be a lot bigger than the chunk they are in
+          float const size (chance (5) ? real (100.f, 800.f) : real (0.5f, 30.f));
+          result.bounds = instance_grid::bounds
+            { result.pos - math::vector_3d (size, size, size) * real (0.f, 1.f)
+            , result.pos + math::vector_3d (size, size, size) * real (0.f, 1.f)
+            };
+        }
+
+        return result;
+      }
+
+      void fill (std::size_t count)
+      {
+        for (std::uint32_t uid (0); uid < count; ++uid)
+        {
+          instances[uid] = instance();
+          grid.insert (uid, instances[uid].pos, instances[uid].bounds);
+        }
+      }
+
+      void shuffle (std::size_t changes)
+      {
+        for (std::size_t i (0); i < changes; ++i)
+        {
+          std::uint32_t const uid (std::uniform_int_distribution<std::uint32_t> (0, instances.size() + 10) (engine));
+
+          if (chance (30))
+          {
+            instances.erase (uid);
+            grid.remove (uid);
+          }
+          else
+          {
+            instances[uid] = instance();
+            grid.update (uid, instances[uid].pos, instances[uid].bounds);
+          }
+        }
+      }
+
+      template<typename Pred>
+        std::vector<std::uint32_t> brute_force (Pred&& pred) const
+      {
+        std::vector<std::uint32_t> uids;
+        for (auto const& it : instances)
+        {
+          if (pred (it.second))
+          {
+            uids.push_back (it.first);
+          }
+        }
+        std::sort (uids.begin(), uids.end());
+        return uids;
+      }
+
+      template<typename Pred>
+        std::vector<std::uint32_t> filter (std::vector<std::uint32_t> candidates, Pred&& pred) const
+      {
+        std::vector<std::uint32_t> uids;
+        for (std::uint32_t uid : candidates)
+        {
+          if (pred (instances.at (uid)))
+          {
+            uids.push_back (uid);
+          }
+        }
+        std::sort (uids.begin(), uids.end());
+        return uids;
+      }
+    };
+
+    struct ray
+    {
+      math::vector_3d origin;
+      math::vector_3d direction;
+
+      bool hits (math::vector_3d const& min, math::vector_3d const& max) const
+      {
+        float tmin (std::numeric_limits<float>::lowest());
+        float tmax (std::numeric_limits<float>::max());
+
+        for (int i (0); i < 3; ++i)
+        {
+          if (direction[i] != 0.f)
+          {
+            float const t1 ((min[i] - origin[i]) / direction[i]);
+            float const t2 ((max[i] - origin[i]) / direction[i]);
+            tmin = std::max (tmin, std::min (t1, t2));
+            tmax = std::min (tmax, std::max (t1, t2));
+          }
+        }
+
+        return tmax >= tmin;
+      }
+    };
+
+    bool in_chunk (stored_instance const& instance, float x, float z)
+    {
+      return instance.pos.x >= x && instance.pos.x < x + CHUNKSIZE
+        && instance.pos.z >= z && instance.pos.z < z + CHUNKSIZE;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (instance_grid_finds_the_instances_on_a_chunk)
+  {
+    for (unsigned seed (0); seed < 10; ++seed)
+    {
+      random_instances world (seed);
+      world.fill (3000);
+      world.shuffle (seed * 200);
+
+      for (int i (0); i < 100; ++i)
+      {
+        float const x (std::floor (world.coordinate() / CHUNKSIZE) * CHUNKSIZE);
+        float const z (std::floor (world.coordinate() / CHUNKSIZE) * CHUNKSIZE);
+        auto const on_chunk ([&] (stored_instance const& instance) { return in_chunk (instance, x, z); });
+
+        auto const candidates (world.grid.in_rect (x, z, x + CHUNKSIZE, z + CHUNKSIZE));
+
+        BOOST_REQUIRE (world.filter (candidates, on_chunk) == world.brute_force (on_chunk));
+        BOOST_REQUIRE_LT (candidates.size(), world.instances.size() / 10);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (instance_grid_finds_the_instances_in_range)
+  {
+    for (unsigned seed (0); seed < 10; ++seed)
+    {
+      random_instances world (seed);
+      world.fill (3000);
+      world.shuffle (seed * 200);
+
+      for (int i (0); i < 100; ++i)
+      {
+        math::vector_3d const pos (world.coordinate(), 0.f, world.coordinate());
+        float const radius (world.chance (10) ? world.real (500.f, 3000.f) : world.real (0.f, 100.f));
+        auto const in_range
+          ( [&] (stored_instance const& instance)
+            {
+              return (math::vector_3d (instance.pos.x, 0.f, instance.pos.z) - pos).length() < radius;
+            }
+          );
+
+        auto const candidates
+          (world.grid.in_rect (pos.x - radius, pos.z - radius, pos.x + radius, pos.z + radius));
+
+        BOOST_REQUIRE (world.filter (candidates, in_range) == world.brute_force (in_range));
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (instance_grid_finds_the_instances_a_ray_may_hit)
+  {
+    for (unsigned seed (0); seed < 10; ++seed)
+    {
+      random_instances world (seed);
+      world.fill (3000);
+      world.shuffle (seed * 200);
+
+      for (int i (0); i < 100; ++i)
+      {
+        ray const mouse
+          { {world.coordinate(), world.real (100.f, 500.f), world.coordinate()}
+          , {world.real (-1.f, 1.f), world.real (-1.f, 0.f), world.real (-1.f, 1.f)}
+          };
+        auto const hits
+          ( [&] (math::vector_3d const& min, math::vector_3d const& max)
+            {
+              return mouse.hits (min, max);
+            }
+          );
+        auto const may_be_hit
+          ( [&] (stored_instance const& instance)
+            {
+              return !instance.bounds || mouse.hits (instance.bounds->min, instance.bounds->max);
+            }
+          );
+
+        auto const candidates (world.grid.hit_candidates (hits));
+
+        BOOST_REQUIRE (world.filter (candidates, may_be_hit) == world.brute_force (may_be_hit));
+        BOOST_REQUIRE_EQUAL (candidates.size(), world.brute_force (may_be_hit).size());
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (instance_grid_forgets_removed_instances)
+  {
+    instance_grid grid;
+    grid.insert (1, {10.f, 0.f, 10.f}, instance_grid::bounds {{0.f, 0.f, 0.f}, {20.f, 20.f, 20.f}});
+    grid.insert (2, {12.f, 0.f, 12.f}, boost::none);
+    grid.insert (2, {5000.f, 0.f, 5000.f}, boost::none);
+
+    BOOST_REQUIRE_EQUAL (grid.size(), 2);
+    BOOST_REQUIRE_EQUAL (grid.in_rect (0.f, 0.f, 20.f, 20.f).size(), 2);
+
+    grid.update (2, {5000.f, 0.f, 5000.f}, boost::none);
+    BOOST_REQUIRE_EQUAL (grid.in_rect (0.f, 0.f, 20.f, 20.f).size(), 1);
+
+    grid.remove (1);
+    grid.remove (1);
+    BOOST_REQUIRE (!grid.contains (1));
+    BOOST_REQUIRE (grid.in_rect (0.f, 0.f, 20.f, 20.f).empty());
+    BOOST_REQUIRE_EQUAL (grid.hit_candidates ([] (math::vector_3d const&, math::vector_3d const&) { return true; }).size(), 1);
+
+    grid.clear();
+    BOOST_REQUIRE_EQUAL (grid.size(), 0);
+    BOOST_REQUIRE (grid.hit_candidates ([] (math::vector_3d const&, math::vector_3d const&) { return true; }).empty());
+  }
+}
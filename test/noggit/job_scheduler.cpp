@@ -0,0 +1,154 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/job_scheduler.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace noggit
+{
+  BOOST_AUTO_TEST_CASE (runs_every_job)
+  {
+    std::atomic<int> count (0);
+    {
+      job_scheduler scheduler (4, 3);
+      for (int i (0); i < 1000; ++i)
+      {
+        scheduler.schedule ([&] { ++count; }, i % 3);
+      }
+      scheduler.wait_idle();
+      BOOST_REQUIRE_EQUAL (count.load(), 1000);
+      BOOST_REQUIRE_EQUAL (scheduler.unfinished(), 0);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (cancelled_jobs_never_run)
+  {
+    job_scheduler scheduler (1, 1);
+
+    std::mutex blocker;
+    std::unique_lock<std::mutex> block (blocker);
+    scheduler.schedule ([&] { std::lock_guard<std::mutex> const wait (blocker); }, 0);
+
+    std::atomic<bool> ran (false);
+    auto const job (scheduler.schedule ([&] { ran = true; }, 0));
+
+    BOOST_REQUIRE (scheduler.cancel (job));
+    BOOST_REQUIRE (!scheduler.cancel (job));
+    BOOST_REQUIRE (job->current_state() == job_scheduler::job::state::cancelled);
+
+    block.unlock();
+    scheduler.wait_idle();
+    BOOST_REQUIRE (!ran);
+  }
+
+  BOOST_AUTO_TEST_CASE (finished_jobs_can_not_be_cancelled)
+  {
+    job_scheduler scheduler (2, 1);
+    auto const job (scheduler.schedule ([] {}, 0));
+    scheduler.wait (job);
+
+    BOOST_REQUIRE (job->current_state() == job_scheduler::job::state::done);
+    BOOST_REQUIRE (!scheduler.cancel (job));
+  }
+
+  BOOST_AUTO_TEST_CASE (higher_priorities_run_first)
+  {
+    job_scheduler scheduler (1, 3);
+
+    std::mutex blocker;
+    std::unique_lock<std::mutex> block (blocker);
+    scheduler.schedule ([&] { std::lock_guard<std::mutex> const wait (blocker); }, 0);
+
+    std::mutex order_guard;
+    std::vector<int> order;
+    auto const record ([&] (int priority) { std::lock_guard<std::mutex> const lock (order_guard); order.push_back (priority); });
+
+    scheduler.schedule ([&] { record (2); }, 2);
+    scheduler.schedule ([&] { record (1); }, 1);
+    scheduler.schedule ([&] { record (0); }, 0);
+    scheduler.schedule ([&] { record (2); }, 2);
+
+    block.unlock();
+    scheduler.wait_idle();
+
+    BOOST_REQUIRE_EQUAL (order.size(), 4);
+    BOOST_REQUIRE_EQUAL (order[0], 0);
+    BOOST_REQUIRE_EQUAL (order[1], 1);
+    BOOST_REQUIRE_EQUAL (order[2], 2);
+    BOOST_REQUIRE_EQUAL (order[3], 2);
+  }
+
+  BOOST_AUTO_TEST_CASE (jobs_can_schedule_dependents)
+  {
+    job_scheduler scheduler (3, 2);
+    std::atomic<int> count (0);
+
+    for (int i (0); i < 100; ++i)
+    {
+      scheduler.schedule
+        ( [&]
+          {
+            for (int j (0); j < 10; ++j)
+            {
+              scheduler.schedule ([&] { ++count; }, 1);
+            }
+          }
+        , 0
+        );
+    }
+
+    scheduler.wait_idle();
+    BOOST_REQUIRE_EQUAL (count.load(), 1000);
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_for_visits_every_index_once)
+  {
+    job_scheduler scheduler (4, 1);
+    std::vector<std::atomic<int>> visits (1027);
+
+    scheduler.parallel_for (0, visits.size(), [&] (std::size_t i) { ++visits[i]; });
+
+    for (auto const& visit : visits)
+    {
+      BOOST_REQUIRE_EQUAL (visit.load(), 1);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_for_nests_without_deadlock)
+  {
+    job_scheduler scheduler (2, 1);
+    std::atomic<int> count (0);
+
+    scheduler.parallel_for
+      ( 0, 8
+      , [&] (std::size_t)
+        {
+          scheduler.parallel_for (0, 8, [&] (std::size_t) { ++count; });
+        }
+      );
+
+    BOOST_REQUIRE_EQUAL (count.load(), 64);
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_for_rethrows)
+  {
+    job_scheduler scheduler (2, 1);
+
+    BOOST_REQUIRE_THROW
+      ( scheduler.parallel_for
+          ( 0, 100
+          , [] (std::size_t i)
+            {
+              if (i == 42)
+              {
+                throw std::runtime_error ("42");
+              }
+            }
+          )
+      , std::runtime_error
+      );
+  }
+}
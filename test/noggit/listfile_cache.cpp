@@ -0,0 +1,150 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/listfile_cache.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct temporary_folder
+    {
+      temporary_folder()
+        : path (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+      {
+        boost::filesystem::create_directories (path);
+      }
+      ~temporary_folder()
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all (path, ec);
+      }
+
+      boost::filesystem::path write (std::string const& name, std::string const& contents) const
+      {
+        auto const file (path / name);
+        std::ofstream (file.string(), std::ios_base::binary).write (contents.data(), contents.size());
+        return file;
+      }
+
+      boost::filesystem::path const path;
+    };
+
+    archive_listfile listfile_of (std::string const& text)
+    {
+      return parse_listfile (text.data(), text.size());
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parsing_normalizes_names)
+  {
+    auto const listfile (listfile_of ("World\\Maps\\Azeroth.WDT\r\n\r\nfoo/BAR.blp\nlast.m2"));
+
+    BOOST_REQUIRE (listfile.has_listfile);
+    BOOST_REQUIRE_EQUAL (listfile.names.size(), 3);
+    BOOST_REQUIRE_EQUAL (listfile.names[0], "world/maps/azeroth.wdt");
+    BOOST_REQUIRE_EQUAL (listfile.names[1], "foo/bar.blp");
+    BOOST_REQUIRE_EQUAL (listfile.names[2], "last.m2");
+    BOOST_REQUIRE_EQUAL (listfile.present.size(), 3);
+  }
+
+  BOOST_AUTO_TEST_CASE (cached_indices_round_trip)
+  {
+    temporary_folder const folder;
+    auto const first (folder.write ("first.mpq", "first archive"));
+    auto const second (folder.write ("second.mpq", "second archive"));
+    auto const cache_file (folder.path / "cache" / "listfile.cache");
+
+    archive_index const index ({{"a.blp", "b.blp"}, {}});
+    listfile_cache::write (cache_file, {{first, true}, {second, false}}, index);
+    BOOST_REQUIRE (!boost::filesystem::exists (cache_file.string() + ".tmp"));
+
+    listfile_cache const cache (cache_file);
+    BOOST_REQUIRE_EQUAL (cache.size(), 2);
+    BOOST_REQUIRE (cache.has (0, first));
+    BOOST_REQUIRE (cache.has (1, second));
+    BOOST_REQUIRE (!cache.has (0, second));
+    BOOST_REQUIRE (!cache.has (2, first));
+
+    auto const cached (cache.find ({first, second}));
+    BOOST_REQUIRE (cached);
+    BOOST_REQUIRE (cached->has_listfile == std::vector<bool> ({true, false}));
+    BOOST_REQUIRE_EQUAL (cached->index.size(), 2);
+    BOOST_REQUIRE_EQUAL (cached->index.find ("B.blp"), 0);
+
+    // only ever the index of exactly the same archives
+    BOOST_REQUIRE (!cache.find ({first}));
+    BOOST_REQUIRE (!cache.find ({second, first}));
+    BOOST_REQUIRE (!cache.find ({first, second, folder.write ("third.mpq", "third archive")}));
+  }
+
+  BOOST_AUTO_TEST_CASE (changed_archives_are_not_taken_from_the_cache)
+  {
+    temporary_folder const folder;
+    auto const resized (folder.write ("resized.mpq", "archive"));
+    auto const touched (folder.write ("touched.mpq", "archive"));
+    auto const kept (folder.write ("kept.mpq", "archive"));
+    auto const cache_file (folder.path / "listfile.cache");
+
+    listfile_cache::write (cache_file, {{resized, true}, {touched, true}, {kept, true}}, archive_index ({{"a.blp"}, {}, {}}));
+
+    folder.write ("resized.mpq", "larger archive");
+    boost::filesystem::last_write_time (touched, boost::filesystem::last_write_time (touched) - 10);
+
+    listfile_cache const cache (cache_file);
+    BOOST_REQUIRE_EQUAL (cache.size(), 3);
+    BOOST_REQUIRE (!cache.has (0, resized));
+    BOOST_REQUIRE (!cache.has (1, touched));
+    BOOST_REQUIRE (cache.has (2, kept));
+    BOOST_REQUIRE (!cache.find ({resized, touched, kept}));
+  }
+
+  BOOST_AUTO_TEST_CASE (unusable_cache_files_are_ignored)
+  {
+    temporary_folder const folder;
+    auto const archive (folder.write ("archive.mpq", "archive"));
+    auto const cache_file (folder.path / "listfile.cache");
+
+    BOOST_REQUIRE_EQUAL (listfile_cache (cache_file).size(), 0);
+
+    folder.write ("listfile.cache", "not a cache at all");
+    BOOST_REQUIRE_EQUAL (listfile_cache (cache_file).size(), 0);
+
+    std::vector<std::vector<std::string>> const listfiles ({{"a.blp", "b.blp"}});
+    listfile_cache::write (cache_file, {{archive, true}}, archive_index (listfiles));
+
+    std::string contents;
+    {
+      std::ifstream input (cache_file.string(), std::ios_base::binary);
+      contents.assign (std::istreambuf_iterator<char> (input), std::istreambuf_iterator<char>());
+    }
+
+    // a different format version
+    std::string other_version (contents);
+    other_version[8] = static_cast<char> (other_version[8] + 1);
+    folder.write ("listfile.cache", other_version);
+    BOOST_REQUIRE_EQUAL (listfile_cache (cache_file).size(), 0);
+
+    // cut off in the middle of the index
+    folder.write ("listfile.cache", contents.substr (0, contents.size() - 3));
+    BOOST_REQUIRE_EQUAL (listfile_cache (cache_file).size(), 0);
+
+    // an index that doesn't make sense
+    std::string damaged (contents);
+    std::size_t const index_start (contents.size() - archive_index (listfiles).serialized().size());
+    damaged[index_start] = static_cast<char> (damaged[index_start] + 1);
+    folder.write ("listfile.cache", damaged);
+    BOOST_REQUIRE (!listfile_cache (cache_file).find ({archive}));
+
+    folder.write ("listfile.cache", contents);
+    BOOST_REQUIRE_EQUAL (listfile_cache (cache_file).size(), 1);
+    BOOST_REQUIRE (listfile_cache (cache_file).find ({archive}));
+  }
+}
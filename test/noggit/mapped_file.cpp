@@ -0,0 +1,174 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/mapped_file.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct temporary_file
+    {
+      temporary_file (std::size_t size)
+        : path (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+      {
+        for (std::size_t i (0); i < size; ++i)
+        {
+          contents.push_back (static_cast<char> (i * 7 + i / 251));
+        }
+        std::ofstream (path.string(), std::ios_base::binary).write (contents.data(), contents.size());
+      }
+      ~temporary_file()
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove (path, ec);
+      }
+
+      boost::filesystem::path const path;
+      std::vector<char> contents;
+    };
+
+    struct temporary_folder
+    {
+      temporary_folder()
+        : path (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+      {
+        boost::filesystem::create_directories (path);
+      }
+      ~temporary_folder()
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all (path, ec);
+      }
+
+      boost::filesystem::path const path;
+    };
+
+    void require_same (file_contents const& actual, std::vector<char> const& expected)
+    {
+      BOOST_REQUIRE_EQUAL (actual.size, expected.size());
+      BOOST_REQUIRE (std::equal (expected.begin(), expected.end(), actual.data.get()));
+    }
+
+    std::vector<char> contents_of (boost::filesystem::path const& path)
+    {
+      std::ifstream input (path.string(), std::ios_base::binary);
+      return {std::istreambuf_iterator<char> (input), std::istreambuf_iterator<char>()};
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (missing_files_are_none)
+  {
+    BOOST_REQUIRE (!read_file_contents (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()));
+    BOOST_REQUIRE (!read_file_contents (boost::filesystem::temp_directory_path()));
+  }
+
+  BOOST_AUTO_TEST_CASE (small_files_are_copied)
+  {
+    temporary_file const file (minimum_mapped_file_size - 1);
+    auto const contents (read_file_contents (file.path));
+
+    BOOST_REQUIRE (contents);
+    BOOST_REQUIRE (!contents->mapped);
+    require_same (*contents, file.contents);
+  }
+
+  BOOST_AUTO_TEST_CASE (empty_files_are_empty)
+  {
+    temporary_file const file (0);
+    auto const contents (read_file_contents (file.path));
+
+    BOOST_REQUIRE (contents);
+    BOOST_REQUIRE_EQUAL (contents->size, 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (large_files_are_mapped)
+  {
+    temporary_file const file (3 * minimum_mapped_file_size + 17);
+    auto const contents (read_file_contents (file.path));
+
+    BOOST_REQUIRE (contents);
+    BOOST_REQUIRE (contents->mapped);
+    require_same (*contents, file.contents);
+  }
+
+  BOOST_AUTO_TEST_CASE (borrowed_data_outlives_the_contents)
+  {
+    temporary_file const file (2 * minimum_mapped_file_size);
+    std::shared_ptr<char const> borrowed;
+    {
+      auto const contents (read_file_contents (file.path));
+      BOOST_REQUIRE (contents);
+      borrowed = std::shared_ptr<char const> (contents->data, contents->data.get() + 100);
+    }
+
+    BOOST_REQUIRE (std::equal (file.contents.begin() + 100, file.contents.end(), borrowed.get()));
+  }
+
+  BOOST_AUTO_TEST_CASE (mapped_contents_survive_replacing_the_file)
+  {
+    temporary_folder const folder;
+    temporary_file const file (4 * minimum_mapped_file_size);
+    auto const path (folder.path / "file.adt");
+    boost::filesystem::copy_file (file.path, path);
+
+    auto contents (read_file_contents (path));
+    BOOST_REQUIRE (contents);
+    BOOST_REQUIRE (contents->mapped);
+    auto second_mapping (read_file_contents (path));
+    BOOST_REQUIRE (second_mapping);
+
+    std::vector<char> const shorter (100, 'x');
+    write_file_atomically (path, shorter.data(), shorter.size());
+    BOOST_REQUIRE (contents_of (path) == shorter);
+
+    // truncating the file in place would make this fault
+    require_same (*contents, file.contents);
+    require_same (*second_mapping, file.contents);
+
+    // the mappings are of the old file, whatever replaces path next
+    write_file_atomically (path, file.contents.data(), file.contents.size());
+    BOOST_REQUIRE (contents_of (path) == file.contents);
+    require_same (*contents, file.contents);
+
+    // which is gone once nothing maps it any longer
+    contents = boost::none;
+    second_mapping = boost::none;
+    BOOST_REQUIRE_EQUAL (std::distance ( boost::filesystem::directory_iterator (folder.path)
+                                       , boost::filesystem::directory_iterator()
+                                       )
+                        , 1
+                        );
+  }
+
+  BOOST_AUTO_TEST_CASE (atomic_writes_replace_the_whole_file)
+  {
+    temporary_folder const folder;
+    auto const path (folder.path / "nested" / "file.adt");
+
+    write_file_atomically (path, "a long first version", 20);
+    write_file_atomically (path, "short", 5);
+
+    BOOST_REQUIRE (contents_of (path) == std::vector<char> ({'s', 'h', 'o', 'r', 't'}));
+    BOOST_REQUIRE (!boost::filesystem::exists (path.string() + ".tmp"));
+    BOOST_REQUIRE_EQUAL (std::distance ( boost::filesystem::directory_iterator (path.parent_path())
+                                       , boost::filesystem::directory_iterator()
+                                       )
+                        , 1
+                        );
+
+    BOOST_REQUIRE_THROW ( write_file_atomically (folder.path / "nested" / "file.adt" / "not a folder", "x", 1)
+                        , std::runtime_error
+                        );
+    BOOST_REQUIRE (contents_of (path) == std::vector<char> ({'s', 'h', 'o', 'r', 't'}));
+  }
+}
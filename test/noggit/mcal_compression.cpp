@@ -0,0 +1,423 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/mcal_compression.hpp>
+
+#include <boost/optional/optional.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    using alphamap = std::array<std::uint8_t, 64 * 64>;
+
+    struct compressed_mcal_entry
+    {
+      enum mode_t
+      {
+        copy = 0,              // append value[0..count - 1]
+        fill = 1,              // append value[0] count times
+      };
+      uint8_t count : 7;
+      uint8_t mode : 1;
+
+      uint8_t value[];
+    };
+
+    // Alphamap::compress before mcal::compress
+    std::vector<uint8_t> legacy_compress (alphamap const& amap)
+    {
+      std::vector<uint8_t> data(amap.data(), amap.data() + 4096);
+      auto current (data.begin());
+      auto const end (data.end());
+      int column_pos = 0;
+
+      auto const consume_fill
+      (
+        [&]
+        {
+          int8_t count (0);
+          column_pos %= 64;
+
+          while ((current + 1 < end) && *current == *(current + 1) && column_pos < 63)
+          {
+            ++current;
+            ++count;
+            ++column_pos;
+          }
+
+          // include current (current is incremented in the for loop)
+          if (count)
+          {
+            ++count;
+            ++column_pos;
+          }
+
+          return count;
+        }
+      );
+
+      std::vector<uint8_t> result;
+      boost::optional<std::size_t> current_copy_entry_offset (boost::none);
+      auto const current_copy_entry
+      (
+        [&]
+        {
+          return reinterpret_cast<compressed_mcal_entry*> (&*(result.begin() + *current_copy_entry_offset));
+        }
+      );
+
+      for (; current != end; ++current)
+      {
+        auto const fill (consume_fill());
+        if (fill)
+        {
+          current_copy_entry_offset = boost::none;
+
+          result.emplace_back();
+          result.emplace_back(*current);
+
+          compressed_mcal_entry* e (reinterpret_cast<compressed_mcal_entry*> (&*(result.rbegin() + 1)));
+          e->mode = compressed_mcal_entry::fill;
+          e->count = fill;
+
+          column_pos %= 64;
+        }
+        else
+        {
+          if ( current_copy_entry_offset == boost::none
+              || column_pos == 64
+              )
+          {
+            current_copy_entry_offset = result.size();
+            result.emplace_back();
+            result.emplace_back(*current);
+            current_copy_entry()->mode = compressed_mcal_entry::copy;
+            current_copy_entry()->count = 1;
+
+            column_pos %= 64;
+          }
+          else
+          {
+            result.emplace_back(*current);
+            current_copy_entry()->count++;
+          }
+
+          column_pos++;
+        }
+      }
+
+      return result;
+    }
+
+    struct legacy_result
+    {
+      std::size_t bytes_read;
+      bool too_big;
+    };
+
+    // Alphamap::readCompressed before mcal::decompress, reading as far as
+    // the entries tell it to
+    legacy_result legacy_decompress (std::uint8_t const* data, alphamap& amap)
+    {
+      char const* const begin (reinterpret_cast<char const*> (data));
+      char const* input = begin;
+      bool too_big (false);
+
+      for (std::size_t offset_output(0); offset_output < 4096;)
+      {
+        compressed_mcal_entry const* e = reinterpret_cast<compressed_mcal_entry const*>(input);
+
+        int count = e->count;
+
+        if (offset_output + count > 4096)
+        {
+          too_big = true;
+          count = 4096 - offset_output;
+        }
+
+        ++input;
+
+        if (count == 0)
+        {
+          continue;
+        }
+
+        if (e->mode == compressed_mcal_entry::fill)
+        {
+          memset(&amap[offset_output], e->value[0], count);
+          ++input;
+        }
+        else
+        {
+          memcpy(&amap[offset_output], e->value, count);
+          input += count;
+        }
+
+        offset_output += count;
+      }
+
+      return {static_cast<std::size_t> (input - begin), too_big};
+    }
+
+    // runs of random length, mostly short ones, with the occasional
+    // stretch of noise or of alternating values
+    alphamap random_alphamap (std::mt19937& engine)
+    {
+      std::uniform_int_distribution<int> value (0, 255);
+      std::uniform_int_distribution<int> kind (0, 9);
+      std::geometric_distribution<int> length (0.08);
+
+      alphamap alphas;
+      for (std::size_t i (0); i < alphas.size();)
+      {
+        std::size_t const n (std::min<std::size_t> (alphas.size() - i, length (engine) + 1));
+        int const k (kind (engine));
+        std::uint8_t const a (static_cast<std::uint8_t> (value (engine)));
+        std::uint8_t const b (static_cast<std::uint8_t> (value (engine)));
+
+        for (std::size_t j (0); j < n; ++j, ++i)
+        {
+          alphas[i] = k < 6 ? a
+                    : k < 8 ? static_cast<std::uint8_t> (value (engine))
+                    : k < 9 ? (j % 3 ? a : b)
+                    : static_cast<std::uint8_t> (a + j)
+                    ;
+        }
+      }
+      return alphas;
+    }
+
+    std::vector<alphamap> test_alphamaps (std::mt19937& engine, std::size_t random_count)
+    {
+      std::vector<alphamap> alphamaps;
+
+      alphamap alphas;
+      alphas.fill (0);
+      alphamaps.push_back (alphas);
+      alphas.fill (255);
+      alphamaps.push_back (alphas);
+
+      // a copy of one alpha and a fill of two, over and over
+      for (std::size_t i (0); i < alphas.size(); ++i)
+      {
+        alphas[i] = i % 3 ? 7 : 3;
+      }
+      alphamaps.push_back (alphas);
+
+      // rows alike but for their last alpha
+      for (std::size_t i (0); i < alphas.size(); ++i)
+      {
+        alphas[i] = i % 64 == 63 ? static_cast<std::uint8_t> (i / 64) : 100;
+      }
+      alphamaps.push_back (alphas);
+
+      std::uniform_int_distribution<int> value (0, 255);
+      for (auto& a : alphas)
+      {
+        a = static_cast<std::uint8_t> (value (engine));
+      }
+      alphamaps.push_back (alphas);
+
+      for (std::size_t i (0); i < random_count; ++i)
+      {
+        alphamaps.push_back (random_alphamap (engine));
+      }
+      return alphamaps;
+    }
+
+    // whatever the old decoder reads past the end fills what is left
+    std::vector<std::uint8_t> padded (std::vector<std::uint8_t> data)
+    {
+      data.resize (data.size() + 2 * 4096, 0xc0);
+      return data;
+    }
+
+    std::vector<std::uint8_t> compressed (alphamap const& alphas)
+    {
+      std::vector<std::uint8_t> output (mcal::max_compressed_size);
+      output.resize (mcal::compress (alphas.data(), output.data()));
+      return output;
+    }
+
+    template<typename Fun>
+      double seconds (Fun&& fun)
+    {
+      auto const start (std::chrono::steady_clock::now());
+      fun();
+      return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (compresses_like_before_where_that_round_trips)
+  {
+    std::mt19937 engine (1);
+    std::size_t same (0);
+    std::size_t fixed (0);
+
+    for (alphamap const& alphas : test_alphamaps (engine, 5000))
+    {
+      std::vector<std::uint8_t> const output (compressed (alphas));
+      std::vector<std::uint8_t> scalar_output (mcal::max_compressed_size);
+      scalar_output.resize (mcal::compress_scalar (alphas.data(), scalar_output.data()));
+      BOOST_REQUIRE (output == scalar_output);
+
+      std::vector<std::uint8_t> legacy (padded (legacy_compress (alphas)));
+      alphamap legacy_alphas;
+      legacy_decompress (legacy.data(), legacy_alphas);
+
+      // copies of more than 127 alphas overflowed into the mode bit
+      if (legacy_alphas == alphas)
+      {
+        legacy.resize (output.size());
+        BOOST_REQUIRE (output == legacy);
+        ++same;
+      }
+      else
+      {
+        ++fixed;
+      }
+    }
+
+    BOOST_REQUIRE_GT (same, 1000);
+    BOOST_REQUIRE_GT (fixed, 10);
+  }
+
+  BOOST_AUTO_TEST_CASE (compressed_alphamaps_round_trip)
+  {
+    std::mt19937 engine (2);
+
+    for (alphamap const& alphas : test_alphamaps (engine, 5000))
+    {
+      std::vector<std::uint8_t> const output (compressed (alphas));
+      BOOST_REQUIRE_LE (output.size(), mcal::max_compressed_size);
+
+      alphamap result;
+      auto const r (mcal::decompress (output.data(), output.size(), result.data()));
+      BOOST_REQUIRE (r.valid);
+      BOOST_REQUIRE_EQUAL (r.bytes_read, output.size());
+      BOOST_REQUIRE (result == alphas);
+
+      alphamap legacy_result;
+      BOOST_REQUIRE_EQUAL (legacy_decompress (padded (output).data(), legacy_result).bytes_read, output.size());
+      BOOST_REQUIRE (legacy_result == alphas);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (arbitrary_input_decompresses_like_before)
+  {
+    std::mt19937 engine (3);
+    std::uniform_int_distribution<int> byte (0, 255);
+    std::uniform_int_distribution<std::size_t> size (0, 2 * 4096);
+    std::size_t compared (0);
+
+    for (int round (0); round < 5000; ++round)
+    {
+      std::size_t const input_size (size (engine));
+      // the old decoder reads as far as the entries say, let it
+      std::vector<std::uint8_t> input (input_size + 3 * 4096);
+      for (auto& b : input)
+      {
+        b = static_cast<std::uint8_t> (byte (engine));
+      }
+
+      alphamap alphas;
+      auto const r (mcal::decompress (input.data(), input_size, alphas.data()));
+      BOOST_REQUIRE_LE (r.bytes_read, input_size);
+
+      alphamap legacy_alphas;
+      auto const legacy (legacy_decompress (input.data(), legacy_alphas));
+
+      if (legacy.bytes_read <= input_size)
+      {
+        BOOST_REQUIRE_EQUAL (r.bytes_read, legacy.bytes_read);
+        BOOST_REQUIRE_EQUAL (r.valid, !legacy.too_big);
+        BOOST_REQUIRE (alphas == legacy_alphas);
+        ++compared;
+      }
+      else
+      {
+        BOOST_REQUIRE (!r.valid);
+      }
+    }
+
+    BOOST_REQUIRE_GT (compared, 1000);
+  }
+
+  BOOST_AUTO_TEST_CASE (truncated_input_is_not_read_past)
+  {
+    std::mt19937 engine (4);
+
+    for (alphamap const& alphas : test_alphamaps (engine, 50))
+    {
+      std::vector<std::uint8_t> const output (compressed (alphas));
+
+      for (std::size_t size (0); size < output.size(); size += 1 + size / 8)
+      {
+        std::vector<std::uint8_t> const truncated (output.begin(), output.begin() + size);
+        alphamap result;
+        auto const r (mcal::decompress (truncated.data(), truncated.size(), result.data()));
+        BOOST_REQUIRE (!r.valid);
+        BOOST_REQUIRE_LE (r.bytes_read, size);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (throughput)
+  {
+    std::mt19937 engine (5);
+    std::vector<alphamap> const alphamaps (test_alphamaps (engine, 2000));
+    std::vector<std::vector<std::uint8_t>> outputs;
+    std::vector<std::vector<std::uint8_t>> legacy_outputs;
+
+    double const legacy_compress_time
+      (seconds ([&] { for (auto const& a : alphamaps) { legacy_outputs.push_back (legacy_compress (a)); } }));
+    double const compress_time
+      (seconds ([&] { for (auto const& a : alphamaps) { outputs.push_back (compressed (a)); } }));
+
+    alphamap result;
+    std::size_t checksum (0);
+    double const decompress_time
+      ( seconds ( [&]
+                  {
+                    for (auto const& output : outputs)
+                    {
+                      checksum += mcal::decompress (output.data(), output.size(), result.data()).bytes_read;
+                    }
+                  }
+                )
+      );
+
+    for (auto& output : legacy_outputs)
+    {
+      output = padded (output);
+    }
+    std::size_t legacy_checksum (0);
+    double const legacy_decompress_time
+      ( seconds ( [&]
+                  {
+                    for (auto const& output : legacy_outputs)
+                    {
+                      legacy_checksum += legacy_decompress (output.data(), result).bytes_read;
+                    }
+                  }
+                )
+      );
+
+    double const megabytes (alphamaps.size() * 4096 / 1e6);
+    BOOST_TEST_MESSAGE ( "compress " << megabytes / compress_time << " MB/s, before "
+                      << megabytes / legacy_compress_time << " MB/s"
+                       );
+    BOOST_TEST_MESSAGE ( "decompress " << megabytes / decompress_time << " MB/s, before "
+                      << megabytes / legacy_decompress_time << " MB/s"
+                       );
+    BOOST_REQUIRE_GT (checksum, 0);
+    BOOST_REQUIRE_GT (legacy_checksum, 0);
+  }
+}
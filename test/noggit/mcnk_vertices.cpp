@@ -0,0 +1,246 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/job_scheduler.hpp>
+#include <noggit/MapHeaders.h>
+#include <noggit/mcnk_vertices.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct vertex
+    {
+      math::vector_3d position;
+      math::vector_3d normal;
+      math::vector_3d color;
+    };
+
+    using vertices = std::array<vertex, mcnk_vertices::vertex_count>;
+    // map_chunk_headers.hpp's, which needs more than noggit::core
+    int const mapbufsize = 9 * 9 + 8 * 8;
+
+    constexpr std::size_t chunk_size
+      (mcnk_vertices::mcvt_size + mcnk_vertices::mcnr_size + mcnk_vertices::mccv_size);
+
+    // MPQFile::read, which MapChunk called for every value
+    struct legacy_file
+    {
+      void read (void* dest, std::size_t bytes)
+      {
+        std::memcpy (dest, data + position, bytes);
+        position += bytes;
+      }
+
+      char const* data;
+      std::size_t position;
+    };
+
+    // MapChunk's constructor reading MCVT, MCNR and MCCV
+    void legacy_read ( legacy_file* f
+                     , float xbase
+                     , float ybase
+                     , float zbase
+                     , vertex* vertices
+                     , math::vector_3d& vmin
+                     , math::vector_3d& vmax
+                     )
+    {
+      vmin = math::vector_3d(9999999.0f, 9999999.0f, 9999999.0f);
+      vmax = math::vector_3d(-9999999.0f, -9999999.0f, -9999999.0f);
+
+      vertex* cv_ptr = vertices;
+
+      for (int j = 0; j < 17; ++j)
+      {
+        for (int i = 0; i < ((j % 2) ? 8 : 9); ++i)
+        {
+          float h, xpos, zpos;
+          f->read(&h, 4);
+          xpos = i * UNITSIZE;
+          zpos = j * 0.5f * UNITSIZE;
+          if (j % 2)
+          {
+            xpos += UNITSIZE * 0.5f;
+          }
+          cv_ptr->position = math::vector_3d(xbase + xpos, ybase + h, zbase + zpos);
+
+          vmin.y = std::min(vmin.y, cv_ptr->position.y);
+          vmax.y = std::max(vmax.y, cv_ptr->position.y);
+
+          cv_ptr++;
+        }
+      }
+
+      char nor[3];
+      cv_ptr = vertices;
+      for (int i = 0; i< mapbufsize; ++i)
+      {
+        f->read(nor, 3);
+        cv_ptr->normal = math::vector_3d(nor[0] / 127.0f, nor[2] / 127.0f, nor[1] / 127.0f);
+        cv_ptr++;
+      }
+
+      unsigned char t[4];
+      for (int i = 0; i < mapbufsize; ++i)
+      {
+        f->read(t, 4);
+        vertices[i].color = math::vector_3d((float)t[2] / 127.0f, (float)t[1] / 127.0f, (float)t[0] / 127.0f);
+      }
+    }
+
+    mcnk_vertices::height_range read (char const* data, math::vector_3d const& origin, vertex* vertices)
+    {
+      auto const range (mcnk_vertices::read_heights (data, origin, vertices));
+      data += mcnk_vertices::mcvt_size;
+      mcnk_vertices::read_normals (data, vertices);
+      data += mcnk_vertices::mcnr_size;
+      mcnk_vertices::read_colors (data, vertices);
+      return range;
+    }
+
+    std::vector<char> random_chunks (std::mt19937& engine, std::size_t count)
+    {
+      std::vector<char> data (count * chunk_size);
+      std::uniform_real_distribution<float> height (-500.f, 1500.f);
+      std::uniform_int_distribution<int> byte (0, 255);
+
+      for (std::size_t chunk (0); chunk < count; ++chunk)
+      {
+        char* const mcvt (data.data() + chunk * chunk_size);
+        for (std::size_t i (0); i < mcnk_vertices::vertex_count; ++i)
+        {
+          float const h (height (engine));
+          std::memcpy (mcvt + i * sizeof (float), &h, sizeof (float));
+        }
+        for (std::size_t i (mcnk_vertices::mcvt_size); i < chunk_size; ++i)
+        {
+          mcvt[i] = static_cast<char> (byte (engine));
+        }
+      }
+
+      return data;
+    }
+
+    math::vector_3d chunk_origin (std::size_t tile_x, std::size_t tile_z, std::size_t chunk, float base_height)
+    {
+      return { tile_x * TILESIZE + (chunk % 16) * CHUNKSIZE
+             , base_height
+             , tile_z * TILESIZE + (chunk / 16) * CHUNKSIZE
+             };
+    }
+
+    void require_same (vertices const& expected, vertices const& actual)
+    {
+      for (std::size_t i (0); i < expected.size(); ++i)
+      {
+        BOOST_REQUIRE_EQUAL (std::memcmp (&expected[i], &actual[i], sizeof (vertex)), 0);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (vertices_are_laid_out_in_rows_of_9_and_8)
+  {
+    auto const& offsets (mcnk_vertices::offsets());
+
+    BOOST_REQUIRE_EQUAL (offsets[0].x, 0.f);
+    BOOST_REQUIRE_EQUAL (offsets[0].z, 0.f);
+    BOOST_REQUIRE_EQUAL (offsets[8].x, 8 * UNITSIZE);
+    BOOST_REQUIRE_EQUAL (offsets[8].z, 0.f);
+    BOOST_REQUIRE_EQUAL (offsets[9].x, UNITSIZE * 0.5f);
+    BOOST_REQUIRE_EQUAL (offsets[9].z, 0.5f * UNITSIZE);
+    BOOST_REQUIRE_EQUAL (offsets[17].x, 0.f);
+    BOOST_REQUIRE_EQUAL (offsets[17].z, UNITSIZE);
+    BOOST_REQUIRE_EQUAL (offsets[144].x, 8 * UNITSIZE);
+    BOOST_REQUIRE_EQUAL (offsets[144].z, 8 * UNITSIZE);
+  }
+
+  BOOST_AUTO_TEST_CASE (every_component_byte_matches_single_reads)
+  {
+    // every byte value in every component of some vertex
+    std::vector<char> data (chunk_size, 0);
+    for (std::size_t i (0); i < mcnk_vertices::mcnr_size + mcnk_vertices::mccv_size; ++i)
+    {
+      data[mcnk_vertices::mcvt_size + i] = static_cast<char> (i * 7);
+    }
+
+    vertices expected;
+    vertices actual;
+    math::vector_3d vmin;
+    math::vector_3d vmax;
+    legacy_file file {data.data(), 0};
+    legacy_read (&file, 1.f, 2.f, 3.f, expected.data(), vmin, vmax);
+    read (data.data(), {1.f, 2.f, 3.f}, actual.data());
+
+    require_same (expected, actual);
+  }
+
+  BOOST_AUTO_TEST_CASE (random_chunks_match_single_reads)
+  {
+    std::mt19937 engine (42);
+    std::vector<char> const data (random_chunks (engine, 64));
+    std::uniform_int_distribution<std::size_t> tile (0, 63);
+    std::uniform_real_distribution<float> base_height (-1000.f, 1000.f);
+
+    for (std::size_t chunk (0); chunk < 64; ++chunk)
+    {
+      math::vector_3d const origin (chunk_origin (tile (engine), tile (engine), chunk, base_height (engine)));
+      char const* const chunk_data (data.data() + chunk * chunk_size);
+
+      vertices expected;
+      vertices actual;
+      math::vector_3d vmin;
+      math::vector_3d vmax;
+      legacy_file file {chunk_data, 0};
+      legacy_read (&file, origin.x, origin.y, origin.z, expected.data(), vmin, vmax);
+      auto const range (read (chunk_data, origin, actual.data()));
+
+      require_same (expected, actual);
+      BOOST_REQUIRE_EQUAL (range.min, vmin.y);
+      BOOST_REQUIRE_EQUAL (range.max, vmax.y);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (tile_read_in_parallel_matches_serial_loading)
+  {
+    std::mt19937 engine (7);
+    std::vector<char> const data (random_chunks (engine, 256));
+
+    std::vector<vertices> serial (256);
+    std::vector<mcnk_vertices::height_range> serial_ranges (256);
+    legacy_file file {data.data(), 0};
+    for (std::size_t chunk (0); chunk < 256; ++chunk)
+    {
+      math::vector_3d const origin (chunk_origin (31, 17, chunk, 12.5f));
+      math::vector_3d vmin;
+      math::vector_3d vmax;
+      legacy_read (&file, origin.x, origin.y, origin.z, serial[chunk].data(), vmin, vmax);
+      serial_ranges[chunk] = {vmin.y, vmax.y};
+    }
+
+    job_scheduler scheduler (3, 1);
+    std::vector<vertices> parallel (256);
+    std::vector<mcnk_vertices::height_range> parallel_ranges (256);
+    scheduler.parallel_for
+      ( 0, 256
+      , [&] (std::size_t chunk)
+        {
+          parallel_ranges[chunk] = read
+            (data.data() + chunk * chunk_size, chunk_origin (31, 17, chunk, 12.5f), parallel[chunk].data());
+        }
+      );
+
+    for (std::size_t chunk (0); chunk < 256; ++chunk)
+    {
+      require_same (serial[chunk], parallel[chunk]);
+      BOOST_REQUIRE_EQUAL (serial_ranges[chunk].min, parallel_ranges[chunk].min);
+      BOOST_REQUIRE_EQUAL (serial_ranges[chunk].max, parallel_ranges[chunk].max);
+    }
+  }
+}
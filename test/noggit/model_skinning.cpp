@@ -0,0 +1,163 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/model_skinning.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct random_skeleton
+    {
+      random_skeleton (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+
+      math::matrix_4x4 bone()
+      {
+        math::matrix_4x4 result (math::matrix_4x4::unit);
+        for (std::size_t row (0); row < 3; ++row)
+        {
+          for (std::size_t column (0); column < 3; ++column)
+          {
+            result (row, column, (row == column ? 1.f : 0.f) + real (-0.5f, 0.5f));
+          }
+          result (row, 3, real (-10.f, 10.f));
+        }
+        return result;
+      }
+
+      std::vector<ModelVertex> vertices (std::size_t count, std::uint8_t bone_count)
+      {
+        std::vector<ModelVertex> result (count);
+        for (auto& vertex : result)
+        {
+          vertex.position = {real (-5.f, 5.f), real (-5.f, 5.f), real (-5.f, 5.f)};
+          vertex.normal = math::vector_3d (real (-1.f, 1.f), real (-1.f, 1.f), real (1.f, 2.f)).normalized();
+          vertex.texcoords[0] = {real (0.f, 1.f), real (0.f, 1.f)};
+          vertex.texcoords[1] = {real (0.f, 1.f), real (0.f, 1.f)};
+
+          // like in models: weights of 0 to 4 bones summing up to 255
+          int left (255);
+          for (std::size_t b (0); b < 4; ++b)
+          {
+            int const weight (b == 3 ? left : std::uniform_int_distribution<int> (0, left) (engine));
+            vertex.weights[b] = weight;
+            vertex.bones[b] = std::uniform_int_distribution<int> (0, bone_count - 1) (engine);
+            left -= weight;
+          }
+        }
+        return result;
+      }
+    };
+
+    // Model::animate's loop before model_skinning
+    std::vector<ModelVertex> reference ( std::vector<ModelVertex> vertices
+                                       , std::vector<math::matrix_4x4> const& mat
+                                       , std::vector<math::matrix_4x4> const& mrot
+                                       )
+    {
+      for (auto& vertex : vertices)
+      {
+        ::math::vector_3d v(0, 0, 0), n(0, 0, 0);
+
+        for (size_t b (0); b < 4; ++b)
+        {
+          if (vertex.weights[b] <= 0)
+            continue;
+
+          ::math::vector_3d tv = mat[vertex.bones[b]] * vertex.position;
+          ::math::vector_3d tn = mrot[vertex.bones[b]] * vertex.normal;
+
+          v += tv * (static_cast<float> (vertex.weights[b]) / 255.0f);
+          n += tn * (static_cast<float> (vertex.weights[b]) / 255.0f);
+        }
+
+        vertex.position = v;
+        vertex.normal = n.normalized();
+      }
+      return vertices;
+    }
+
+    void require_close (math::vector_3d const& lhs, math::vector_3d const& rhs, float tolerance)
+    {
+      for (std::size_t axis (0); axis < 3; ++axis)
+      {
+        BOOST_REQUIRE_SMALL (lhs[axis] - rhs[axis], tolerance);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (model_skinning_matches_the_per_vertex_loop)
+  {
+    for (unsigned seed (0); seed < 20; ++seed)
+    {
+      random_skeleton generator (seed);
+      std::uint8_t const bone_count (1 + seed * 7);
+
+      std::vector<math::matrix_4x4> mat, mrot;
+      for (std::size_t bone (0); bone < bone_count; ++bone)
+      {
+        mat.push_back (generator.bone());
+        mrot.push_back (generator.bone());
+      }
+
+      // also sizes that are no multiple of the kernels' width
+      auto const bind_pose (generator.vertices (seed * 13 + seed % 4, bone_count));
+      auto const expected (reference (bind_pose, mat, mrot));
+
+      model_skinning skinning (bind_pose);
+      BOOST_REQUIRE_EQUAL (skinning.size(), bind_pose.size());
+
+      for (auto kernel : {skinning_kernel::scalar, skinning_kernel::sse})
+      {
+        auto output (bind_pose);
+        skinning.skin (mat, mrot, output.data(), kernel);
+
+        for (std::size_t i (0); i < output.size(); ++i)
+        {
+          require_close (output[i].position, expected[i].position, 1e-3f);
+          require_close (output[i].normal, expected[i].normal, 1e-4f);
+
+          BOOST_REQUIRE_EQUAL (output[i].texcoords[1].x, bind_pose[i].texcoords[1].x);
+          BOOST_REQUIRE_EQUAL (output[i].weights[2], bind_pose[i].weights[2]);
+        }
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (model_skinning_scalar_kernel_is_the_per_vertex_loop)
+  {
+    random_skeleton generator (99);
+    std::vector<math::matrix_4x4> const mat {generator.bone(), generator.bone(), generator.bone()};
+    std::vector<math::matrix_4x4> const mrot {generator.bone(), generator.bone(), generator.bone()};
+    auto const bind_pose (generator.vertices (101, 3));
+    auto const expected (reference (bind_pose, mat, mrot));
+
+    auto output (bind_pose);
+    model_skinning (bind_pose).skin (mat, mrot, output.data(), skinning_kernel::scalar);
+
+    for (std::size_t i (0); i < output.size(); ++i)
+    {
+      BOOST_REQUIRE (output[i].position == expected[i].position);
+      BOOST_REQUIRE (output[i].normal == expected[i].normal);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (model_skinning_falls_back_to_scalar)
+  {
+    BOOST_REQUIRE (skinning_kernel_available (skinning_kernel::scalar));
+    BOOST_REQUIRE (skinning_kernel_available (default_skinning_kernel()));
+  }
+}
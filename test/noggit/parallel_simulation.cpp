@@ -0,0 +1,336 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/bone_animation.hpp>
+#include <noggit/job_scheduler.hpp>
+#include <noggit/model_skinning.hpp>
+#include <noggit/parallel_simulation.hpp>
+#include <noggit/particle_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    // an emitter as ParticleSystem has one: spawning from its own
+    // generator, then moving its particles
+    struct emitter
+    {
+      emitter (unsigned seed)
+        : random (seed)
+        , particles (10000)
+      {}
+
+      std::minstd_rand random;
+      particle_pool particles;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (random);
+      }
+
+      void update (float dt)
+      {
+        int const spawn (static_cast<int> (dt * 400.f));
+        for (int i (0); i < spawn; ++i)
+        {
+          Particle p;
+          p.pos = p.origin = {real (-1.f, 1.f), real (-1.f, 1.f), real (-1.f, 1.f)};
+          p.speed = {real (-3.f, 3.f), real (0.f, 3.f), real (-3.f, 3.f)};
+          p.down = {0.f, -1.f, 0.f};
+          p.dir = p.speed;
+          for (auto& corner : p.corners)
+          {
+            corner = {real (-1.f, 1.f), real (-1.f, 1.f), 0.f};
+          }
+          p.size = p.life = 0.f;
+          p.maxlife = real (0.2f, 2.f);
+          p.tile = std::uniform_int_distribution<unsigned int> (0, 15) (random);
+          particles.add (p);
+        }
+
+        particles.update ( dt, 9.8f, 0.5f, 0.3f
+                         , { 0.4f
+                           , {{0.1f, 1.f, 0.2f}}
+                           , {{ math::vector_4d (1.f, 0.f, 0.f, 1.f)
+                              , math::vector_4d (0.f, 1.f, 0.f, 1.f)
+                              , math::vector_4d (0.f, 0.f, 1.f, 0.f)
+                             }}
+                           }
+                         );
+      }
+    };
+
+    // a model as Model::animate animates it: bones evaluated parents
+    // first, some of them billboarded, then the vertices skinned
+    struct animated_model
+    {
+      animated_model (unsigned seed, bool billboarded)
+      {
+        std::mt19937 engine (seed);
+        auto const real
+          ([&] (float min, float max) { return std::uniform_real_distribution<float> (min, max) (engine); });
+
+        std::size_t const bone_count (12);
+        for (std::size_t bone (0); bone < bone_count; ++bone)
+        {
+          parents.push_back (bone == 0 ? -1 : std::uniform_int_distribution<int> (-1, bone - 1) (engine));
+          pivots.emplace_back (real (-2.f, 2.f), real (-2.f, 2.f), real (-2.f, 2.f));
+          axes.push_back (math::vector_3d (real (-1.f, 1.f), real (-1.f, 1.f), real (0.5f, 1.f)).normalized());
+          speeds.push_back (real (0.001f, 0.01f));
+          billboard.push_back (billboarded && bone % 4 == 3);
+        }
+        order = parent_first_order (parents);
+
+        std::vector<ModelVertex> bind_pose (300);
+        for (auto& vertex : bind_pose)
+        {
+          vertex.position = {real (-5.f, 5.f), real (-5.f, 5.f), real (-5.f, 5.f)};
+          vertex.normal = math::vector_3d (real (-1.f, 1.f), real (-1.f, 1.f), real (1.f, 2.f)).normalized();
+          int left (255);
+          for (std::size_t b (0); b < 4; ++b)
+          {
+            int const weight (b == 3 ? left : std::uniform_int_distribution<int> (0, left) (engine));
+            vertex.weights[b] = weight;
+            vertex.bones[b] = std::uniform_int_distribution<int> (0, bone_count - 1) (engine);
+            left -= weight;
+          }
+        }
+        skinning = model_skinning (bind_pose);
+        vertices = bind_pose;
+        matrices.resize (bone_count, math::matrix_4x4::unit);
+        normal_matrices.resize (bone_count, math::matrix_4x4::unit);
+      }
+
+      std::vector<int> parents;
+      std::vector<std::size_t> order;
+      std::vector<math::vector_3d> pivots;
+      std::vector<math::vector_3d> axes;
+      std::vector<float> speeds;
+      std::vector<bool> billboard;
+
+      model_skinning skinning;
+      std::vector<ModelVertex> vertices;
+      std::vector<math::matrix_4x4> matrices;
+      std::vector<math::matrix_4x4> normal_matrices;
+
+      //! Model::_per_instance_animation
+      bool per_instance() const
+      {
+        return std::find (billboard.begin(), billboard.end(), true) != billboard.end();
+      }
+
+      void animate (math::matrix_4x4 const& model_view, int time)
+      {
+        for (std::size_t bone : order)
+        {
+          float const angle (speeds[bone] * time);
+          math::vector_3d const axis (axes[bone] * std::sin (angle / 2.f));
+          math::quaternion const q (axis.x, axis.y, axis.z, std::cos (angle / 2.f));
+
+          math::matrix_4x4 m (affine_transform (pivots[bone], q, {1.f, 1.f, 1.f}));
+          if (billboard[bone])
+          {
+            noggit::billboard (m, model_view);
+          }
+          affine_translate (m, -pivots[bone]);
+
+          math::matrix_4x4 const rotation (math::matrix_4x4::rotation, q);
+          if (parents[bone] >= 0)
+          {
+            matrices[bone] = affine_product (matrices[parents[bone]], m);
+            normal_matrices[bone] = affine_product (normal_matrices[parents[bone]], rotation);
+          }
+          else
+          {
+            matrices[bone] = m;
+            normal_matrices[bone] = rotation;
+          }
+        }
+
+        skinning.skin (matrices, normal_matrices, vertices.data());
+      }
+    };
+
+    math::matrix_4x4 camera (float yaw)
+    {
+      return math::matrix_4x4 ( std::cos (yaw), 0.f, std::sin (yaw), 3.f
+                              , 0.f, 1.f, 0.f, -2.f
+                              , -std::sin (yaw), 0.f, std::cos (yaw), -30.f
+                              , 0.f, 0.f, 0.f, 1.f
+                              );
+    }
+
+    std::vector<std::unique_ptr<animated_model>> make_models (std::size_t count)
+    {
+      std::vector<std::unique_ptr<animated_model>> models;
+      for (std::size_t i (0); i < count; ++i)
+      {
+        models.emplace_back (std::make_unique<animated_model> (static_cast<unsigned> (i + 1), i % 3 == 0));
+      }
+      return models;
+    }
+
+    void require_same_vertices (animated_model const& result, animated_model const& expected)
+    {
+      BOOST_REQUIRE_EQUAL (result.vertices.size(), expected.vertices.size());
+      for (std::size_t v (0); v < result.vertices.size(); ++v)
+      {
+        for (std::size_t axis (0); axis < 3; ++axis)
+        {
+          BOOST_REQUIRE_EQUAL (result.vertices[v].position[axis], expected.vertices[v].position[axis]);
+          BOOST_REQUIRE_EQUAL (result.vertices[v].normal[axis], expected.vertices[v].normal[axis]);
+        }
+      }
+    }
+
+    std::vector<std::unique_ptr<emitter>> make_emitters (std::size_t count)
+    {
+      std::vector<std::unique_ptr<emitter>> emitters;
+      for (std::size_t i (0); i < count; ++i)
+      {
+        emitters.emplace_back (std::make_unique<emitter> (static_cast<unsigned> (i + 1)));
+      }
+      return emitters;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (simulation_steps_cut_dt_like_the_emitter_update_loop)
+  {
+    for (float dt : {0.f, 0.05f, 0.1f, 0.25f, 1.3f})
+    {
+      std::vector<float> expected;
+      float left (dt);
+      while (left > 0.1f)
+      {
+        expected.push_back (0.1f);
+        left -= 0.1f;
+      }
+      expected.push_back (left);
+
+      std::vector<float> const steps (simulation_steps (dt, 0.1f));
+      BOOST_REQUIRE_EQUAL_COLLECTIONS (steps.begin(), steps.end(), expected.begin(), expected.end());
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_simulation_matches_the_serial_one)
+  {
+    std::size_t const count (57);
+    auto serial (make_emitters (count));
+    auto parallel (make_emitters (count));
+
+    std::vector<emitter*> parallel_pointers;
+    for (auto& e : parallel)
+    {
+      parallel_pointers.push_back (e.get());
+    }
+
+    job_scheduler scheduler (4, 1);
+
+    for (float dt : {0.016f, 0.033f, 0.35f, 0.016f, 0.2f, 0.016f, 0.05f})
+    {
+      // the former World::update_models_emitters: all emitters per step
+      for (float step : simulation_steps (dt, 0.1f))
+      {
+        for (auto& e : serial)
+        {
+          e->update (step);
+        }
+      }
+
+      simulate_parallel ( scheduler, parallel_pointers, dt, 0.1f
+                        , [] (emitter& e, float step) { e.update (step); }
+                        );
+    }
+
+    for (std::size_t i (0); i < count; ++i)
+    {
+      particle_pool const& expected (serial[i]->particles);
+      particle_pool const& result (parallel[i]->particles);
+
+      BOOST_REQUIRE_EQUAL (result.size(), expected.size());
+      BOOST_REQUIRE_GT (result.size(), 0);
+      for (std::size_t p (0); p < result.size(); ++p)
+      {
+        BOOST_REQUIRE (result.position (p) == expected.position (p));
+        BOOST_REQUIRE_EQUAL (result.particle_size (p), expected.particle_size (p));
+        BOOST_REQUIRE_EQUAL (result.tile (p), expected.tile (p));
+        for (std::size_t component (0); component < 4; ++component)
+        {
+          BOOST_REQUIRE_EQUAL (result.color (p)[component], expected.color (p)[component]);
+        }
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (parallel_model_animation_matches_the_serial_one)
+  {
+    std::size_t const count (41);
+    auto serial (make_models (count));
+    auto parallel (make_models (count));
+
+    job_scheduler scheduler (4, 1);
+
+    int time (0);
+    for (float yaw : {0.f, 0.3f, 1.2f, -2.f})
+    {
+      math::matrix_4x4 const model_view (camera (yaw));
+      time += 370;
+
+      // what the draw did when it animated the models lazily
+      for (auto& model : serial)
+      {
+        model->animate (model_view, time);
+      }
+
+      // World::draw: Model::prepare_animation over the compute scheduler,
+      // which leaves the billboarded models to the draw, then the draw
+      scheduler.parallel_for
+        ( 0, parallel.size()
+        , [&] (std::size_t i)
+          {
+            if (!parallel[i]->per_instance())
+            {
+              parallel[i]->animate (model_view, time);
+            }
+          }
+        );
+      for (auto& model : parallel)
+      {
+        if (model->per_instance())
+        {
+          model->animate (model_view, time);
+        }
+      }
+
+      for (std::size_t i (0); i < count; ++i)
+      {
+        require_same_vertices (*parallel[i], *serial[i]);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (billboarded_models_depend_on_the_model_view)
+  {
+    auto billboarded (make_models (1));
+    auto again (make_models (1));
+    BOOST_REQUIRE (billboarded[0]->per_instance());
+
+    // animated for one view, they are wrong for the next one
+    billboarded[0]->animate (camera (0.f), 100);
+    again[0]->animate (camera (1.f), 100);
+
+    bool differs (false);
+    for (std::size_t v (0); v < billboarded[0]->vertices.size(); ++v)
+    {
+      differs = differs || !(billboarded[0]->vertices[v].position == again[0]->vertices[v].position);
+    }
+    BOOST_REQUIRE (differs);
+  }
+}
@@ -0,0 +1,186 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/particle_pool.hpp>
+
+#include <math/interpolation.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <random>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    // ParticleSystem::update's simulation before particle_pool
+    template<class T>
+    T lifeRamp(float life, float mid, const T &a, const T &b, const T &c)
+    {
+      if (life <= mid) return math::interpolation::linear(life / mid, a, b);
+      else return math::interpolation::linear((life - mid) / (1.0f - mid), b, c);
+    }
+
+    void legacy_update ( std::list<Particle>& particles, float dt, float grav, float deaccel, float slowdown
+                       , particle_ramp const& ramp
+                       )
+    {
+      float mspeed = 1.0f;
+
+      for (std::list<Particle>::iterator it = particles.begin(); it != particles.end();) {
+        Particle &p = *it;
+        p.speed += p.down * grav * dt - p.dir * deaccel * dt;
+
+        if (slowdown>0) {
+          mspeed = expf(-1.0f * slowdown * p.life);
+        }
+        p.pos += p.speed * mspeed * dt;
+
+        p.life += dt;
+        float rlife = p.life / p.maxlife;
+        // calculate size and color based on lifetime
+        p.size = lifeRamp<float>(rlife, ramp.mid, ramp.sizes[0], ramp.sizes[1], ramp.sizes[2]);
+        p.color = lifeRamp<math::vector_4d>(rlife, ramp.mid, ramp.colors[0], ramp.colors[1], ramp.colors[2]);
+
+        // kill off old particles
+        if (rlife >= 1.0f)
+        {
+          it = particles.erase (it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+
+    struct random_emitter
+    {
+      random_emitter (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+      unsigned int spawned = 0;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+
+      math::vector_3d vector (float extent)
+      {
+        return {real (-extent, extent), real (-extent, extent), real (-extent, extent)};
+      }
+
+      Particle particle()
+      {
+        Particle p;
+        p.pos = p.origin = vector (10.f);
+        p.speed = vector (3.f);
+        p.down = {0.f, -1.f, 0.f};
+        p.dir = vector (1.f);
+        for (auto& corner : p.corners)
+        {
+          corner = vector (1.f);
+        }
+        p.size = 0.f;
+        p.life = 0.f;
+        p.maxlife = real (0.2f, 3.f);
+        // unique, to find the particle again after the pool reordered them
+        p.tile = spawned++;
+        return p;
+      }
+
+      particle_ramp ramp()
+      {
+        return { real (0.1f, 0.9f)
+               , {{real (0.f, 2.f), real (0.f, 2.f), real (0.f, 2.f)}}
+               , {{ math::vector_4d (real (0.f, 1.f), real (0.f, 1.f), real (0.f, 1.f), real (0.f, 1.f))
+                  , math::vector_4d (real (0.f, 1.f), real (0.f, 1.f), real (0.f, 1.f), real (0.f, 1.f))
+                  , math::vector_4d (real (0.f, 1.f), real (0.f, 1.f), real (0.f, 1.f), real (0.f, 1.f))
+                 }}
+               };
+      }
+    };
+
+    void require_equal (Particle const& lhs, Particle const& rhs)
+    {
+      BOOST_REQUIRE_EQUAL (lhs.tile, rhs.tile);
+      BOOST_REQUIRE (lhs.pos == rhs.pos);
+      BOOST_REQUIRE (lhs.speed == rhs.speed);
+      BOOST_REQUIRE (lhs.origin == rhs.origin);
+      BOOST_REQUIRE (lhs.corners[3] == rhs.corners[3]);
+      BOOST_REQUIRE_EQUAL (lhs.life, rhs.life);
+      BOOST_REQUIRE_EQUAL (lhs.maxlife, rhs.maxlife);
+      BOOST_REQUIRE_EQUAL (lhs.size, rhs.size);
+      BOOST_REQUIRE_EQUAL (lhs.color.x, rhs.color.x);
+      BOOST_REQUIRE_EQUAL (lhs.color.w, rhs.color.w);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (particle_pool_simulates_like_the_particle_list)
+  {
+    for (unsigned seed (0); seed < 12; ++seed)
+    {
+      random_emitter emitter (seed);
+      particle_ramp const ramp (emitter.ramp());
+      float const gravity (emitter.real (0.f, 5.f));
+      float const deceleration (emitter.real (0.f, 2.f));
+      float const slowdown (seed % 3 ? emitter.real (0.f, 1.f) : 0.f);
+
+      std::list<Particle> expected;
+      particle_pool pool (10000);
+
+      for (int frame (0); frame < 300; ++frame)
+      {
+        int const spawn (std::uniform_int_distribution<int> (0, 9) (emitter.engine));
+        for (int i (0); i < spawn; ++i)
+        {
+          Particle const p (emitter.particle());
+          expected.push_back (p);
+          BOOST_REQUIRE (pool.add (p));
+        }
+
+        float const dt (emitter.real (0.005f, 0.05f));
+        legacy_update (expected, dt, gravity, deceleration, slowdown, ramp);
+        pool.update (dt, gravity, deceleration, slowdown, ramp);
+
+        BOOST_REQUIRE_EQUAL (pool.size(), expected.size());
+      }
+
+      std::vector<Particle> result;
+      for (std::size_t i (0); i < pool.size(); ++i)
+      {
+        result.push_back (pool.get (i));
+      }
+      std::sort ( result.begin(), result.end()
+                , [] (Particle const& lhs, Particle const& rhs) { return lhs.tile < rhs.tile; }
+                );
+
+      auto it (expected.begin());
+      for (auto const& p : result)
+      {
+        require_equal (p, *it++);
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (particle_pool_is_bounded_by_its_capacity)
+  {
+    random_emitter emitter (1);
+    particle_pool pool (5);
+
+    for (int i (0); i < 5; ++i)
+    {
+      BOOST_REQUIRE (pool.add (emitter.particle()));
+    }
+    BOOST_REQUIRE (!pool.add (emitter.particle()));
+    BOOST_REQUIRE_EQUAL (pool.size(), 5);
+
+    pool.clear();
+    BOOST_REQUIRE (pool.empty());
+    BOOST_REQUIRE (pool.add (emitter.particle()));
+  }
+}
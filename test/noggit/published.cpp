@@ -0,0 +1,175 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/editor_settings.hpp>
+#include <noggit/published.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    // every field has to come from the same publish
+    struct values
+    {
+      values (int generation_)
+        : generation (generation_)
+        , name (std::to_string (generation_))
+      {
+        fields.fill (generation_);
+      }
+
+      bool consistent() const
+      {
+        for (int field : fields)
+        {
+          if (field != generation)
+          {
+            return false;
+          }
+        }
+        return name == std::to_string (generation);
+      }
+
+      int generation;
+      std::array<int, 64> fields;
+      std::string name;
+    };
+  }
+
+  BOOST_AUTO_TEST_CASE (published_starts_with_the_initial_value)
+  {
+    published<values> value (values (3));
+    BOOST_REQUIRE_EQUAL (value.current().generation, 3);
+    BOOST_REQUIRE (value.current().consistent());
+  }
+
+  BOOST_AUTO_TEST_CASE (published_values_stay_valid_after_being_replaced)
+  {
+    published<editor_settings> settings ((editor_settings()));
+    editor_settings const& old (settings.current());
+
+    editor_settings changed;
+    changed.view_distance = 3000.f;
+    changed.mclq_liquids_path = "liquids/";
+    settings.publish (changed);
+
+    BOOST_REQUIRE_EQUAL (old.view_distance, editor_settings().view_distance);
+    BOOST_REQUIRE_EQUAL (old.mclq_liquids_path, "");
+    BOOST_REQUIRE_EQUAL (settings.current().view_distance, 3000.f);
+    BOOST_REQUIRE_EQUAL (settings.current().mclq_liquids_path, "liquids/");
+  }
+
+  BOOST_AUTO_TEST_CASE (published_tells_listeners_until_unsubscribed)
+  {
+    published<values> value (values (0));
+    std::vector<int> seen;
+
+    {
+      auto subscription
+        (value.subscribe ([&] (values const& v) { seen.push_back (v.generation); }));
+      value.publish (values (1));
+      value.publish (values (2));
+
+      auto moved (std::move (subscription));
+      value.publish (values (3));
+    }
+
+    value.publish (values (4));
+
+    BOOST_REQUIRE ((seen == std::vector<int> {1, 2, 3}));
+  }
+
+  BOOST_AUTO_TEST_CASE (published_listeners_see_the_new_value_as_current)
+  {
+    published<values> value (values (0));
+    bool matched (false);
+
+    auto subscription
+      ( value.subscribe
+          ( [&] (values const& v)
+            {
+              matched = &v == &value.current() && v.generation == 5;
+            }
+          )
+      );
+    value.publish (values (5));
+
+    BOOST_REQUIRE (matched);
+  }
+
+  BOOST_AUTO_TEST_CASE (published_readers_never_see_a_mix_of_two_values)
+  {
+    published<values> value (values (0));
+    int const generations (2000);
+
+    std::atomic<bool> done (false);
+    std::atomic<std::size_t> inconsistent (0);
+    std::atomic<std::size_t> backwards (0);
+    std::atomic<std::size_t> reads (0);
+    std::atomic<std::size_t> started (0);
+    std::size_t const reader_count (4);
+
+    std::vector<std::thread> readers;
+    for (std::size_t i (0); i < reader_count; ++i)
+    {
+      readers.emplace_back
+        ( [&]
+          {
+            int last (0);
+            std::vector<values const*> kept;
+            while (!done)
+            {
+              values const& current (value.current());
+              inconsistent += !current.consistent();
+              backwards += current.generation < last;
+              last = current.generation;
+              kept.push_back (&current);
+              ++reads;
+              if (kept.size() == 1)
+              {
+                ++started;
+              }
+            }
+            // what a reader got earlier is still there
+            for (values const* v : kept)
+            {
+              inconsistent += !v->consistent();
+            }
+          }
+        );
+    }
+
+    std::size_t notified (0);
+    auto subscription (value.subscribe ([&] (values const&) { ++notified; }));
+
+    // publishing before every reader got going could end the test
+    // before some of them read anything
+    while (started < reader_count)
+    {
+      std::this_thread::yield();
+    }
+
+    for (int generation (1); generation <= generations; ++generation)
+    {
+      value.publish (values (generation));
+    }
+    done = true;
+
+    for (auto& reader : readers)
+    {
+      reader.join();
+    }
+
+    BOOST_REQUIRE_EQUAL (inconsistent, 0);
+    BOOST_REQUIRE_EQUAL (backwards, 0);
+    BOOST_REQUIRE_GE (reads, reader_count);
+    BOOST_REQUIRE_EQUAL (notified, generations);
+    BOOST_REQUIRE_EQUAL (value.current().generation, generations);
+  }
+}
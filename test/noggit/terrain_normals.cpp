@@ -0,0 +1,245 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/terrain_normals.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct vertex
+    {
+      math::vector_3d position;
+      math::vector_3d normal;
+    };
+
+    using chunk = std::array<vertex, chunk_normals::vertex_count>;
+
+    // two by two tiles around a tile corner, each with 16 by 16 chunks laid
+    // out like MapChunk does, with random heights which don't always match
+    // on the borders of chunks
+    struct terrain
+    {
+      terrain (unsigned seed, bool last_tile_loaded)
+        : engine (seed)
+      {
+        for (int tile_z (31); tile_z <= 32; ++tile_z)
+        {
+          for (int tile_x (31); tile_x <= 32; ++tile_x)
+          {
+            if (!last_tile_loaded && tile_x == 32 && tile_z == 32)
+            {
+              continue;
+            }
+
+            auto& chunks (tiles[{tile_x, tile_z}]);
+            chunks.resize (256);
+
+            for (int py (0); py < 16; ++py)
+            {
+              for (int px (0); px < 16; ++px)
+              {
+                float const zbase (tile_z * TILESIZE + py * CHUNKSIZE);
+                float const xbase (tile_x * TILESIZE + px * CHUNKSIZE);
+                float const ybase (real (-100.f, 100.f));
+
+                vertex* v (chunks[py * 16 + px].data());
+                for (int j (0); j < 17; ++j)
+                {
+                  for (int i (0); i < ((j % 2) ? 8 : 9); ++i)
+                  {
+                    float xpos (i * UNITSIZE);
+                    float const zpos (j * 0.5f * UNITSIZE);
+                    if (j % 2)
+                    {
+                      xpos += UNITSIZE * 0.5f;
+                    }
+                    // flat areas now and then, for normals with zeros
+                    float const h (chance (20) ? 0.f : real (-20.f, 20.f));
+                    v->position = math::vector_3d (xbase + xpos, ybase + h, zbase + zpos);
+                    ++v;
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+      bool chance (int percent)
+      {
+        return std::uniform_int_distribution<int> (0, 99) (engine) < percent;
+      }
+
+      // World::GetVertex, MapTile::GetVertex then MapChunk::GetVertex
+      bool get_vertex (float x, float z, math::vector_3d* V)
+      {
+        auto const tile (tiles.find ({static_cast<int> (std::floor (x / TILESIZE)), static_cast<int> (std::floor (z / TILESIZE))}));
+        if (tile == tiles.end())
+        {
+          return false;
+        }
+
+        float const tile_xbase (tile->first.first * TILESIZE);
+        float const tile_zbase (tile->first.second * TILESIZE);
+        int xcol = (int)((x - tile_xbase) / CHUNKSIZE);
+        int ycol = (int)((z - tile_zbase) / CHUNKSIZE);
+
+        if (!(xcol >= 0 && xcol <= 15 && ycol >= 0 && ycol <= 15))
+        {
+          return false;
+        }
+
+        float const xbase (tile_xbase + xcol * CHUNKSIZE);
+        float const zbase (tile_zbase + ycol * CHUNKSIZE);
+        chunk const& vertices (tile->second[ycol * 16 + xcol]);
+
+        float xdiff, zdiff;
+
+        xdiff = x - xbase;
+        zdiff = z - zbase;
+
+        const int row = static_cast<int>(zdiff / (UNITSIZE * 0.5f) + 0.5f);
+        const int column = static_cast<int>((xdiff - UNITSIZE * 0.5f * (row % 2)) / UNITSIZE + 0.5f);
+        if ((row < 0) || (column < 0) || (row > 16) || (column >((row % 2) ? 8 : 9)))
+          return false;
+
+        *V = vertices[17 * (row / 2) + ((row % 2) ? 9 : 0) + column].position;
+        return true;
+      }
+
+      boost::optional<float> height (float x, float z)
+      {
+        math::vector_3d vec;
+        auto res (get_vertex (x, z, &vec));
+        return boost::make_optional (res, vec.y);
+      }
+
+      std::mt19937 engine;
+      std::map<std::pair<int, int>, std::vector<chunk>> tiles;
+    };
+
+    // MapChunk::recalcNorms before chunk_normals
+    void legacy_normals (chunk& vertices, std::function<boost::optional<float> (float, float)> height)
+    {
+      auto point
+      (
+        [&] (math::vector_3d& v, float xdiff, float zdiff)
+        {
+          return math::vector_3d
+                 ( v.x + xdiff
+                 , height (v.x + xdiff, v.z + zdiff).get_value_or (v.y)
+                 , v.z + zdiff
+                 );
+        }
+      );
+
+      float const half_unit = UNITSIZE / 2.f;
+
+      for (std::size_t i = 0; i < vertices.size(); ++i)
+      {
+        math::vector_3d const P1 (point(vertices[i].position, -half_unit, -half_unit));
+        math::vector_3d const P2 (point(vertices[i].position,  half_unit, -half_unit));
+        math::vector_3d const P3 (point(vertices[i].position,  half_unit,  half_unit));
+        math::vector_3d const P4 (point(vertices[i].position, -half_unit,  half_unit));
+
+        math::vector_3d const N1 ((P2 - vertices[i].position) % (P1 - vertices[i].position));
+        math::vector_3d const N2 ((P3 - vertices[i].position) % (P2 - vertices[i].position));
+        math::vector_3d const N3 ((P4 - vertices[i].position) % (P3 - vertices[i].position));
+        math::vector_3d const N4 ((P1 - vertices[i].position) % (P4 - vertices[i].position));
+
+        math::vector_3d Norm (N1 + N2 + N3 + N4);
+        Norm.normalize();
+
+        Norm.x = std::floor(Norm.x * 127) / 127;
+        Norm.y = std::floor(Norm.y * 127) / 127;
+        Norm.z = std::floor(Norm.z * 127) / 127;
+
+        vertices[i].normal = {-Norm.z, Norm.y, -Norm.x};
+      }
+    }
+
+    bool same_bits (math::vector_3d const& lhs, math::vector_3d const& rhs)
+    {
+      return std::memcmp (&lhs, &rhs, sizeof (math::vector_3d)) == 0;
+    }
+
+    void check_every_chunk (terrain& world)
+    {
+      chunk_normals normals;
+      std::array<math::vector_3d, chunk_normals::vertex_count> computed;
+      std::array<math::vector_3d, chunk_normals::vertex_count> computed_scalar;
+
+      for (auto& tile : world.tiles)
+      {
+        for (chunk& vertices : tile.second)
+        {
+          legacy_normals (vertices, [&] (float x, float z) { return world.height (x, z); });
+
+          normals.gather (vertices, [&] (float x, float z) { return world.height (x, z); });
+          normals.compute (computed.data());
+          normals.compute_scalar (computed_scalar.data());
+
+          for (std::size_t i (0); i < vertices.size(); ++i)
+          {
+            BOOST_REQUIRE (same_bits (computed[i], vertices[i].normal));
+            BOOST_REQUIRE (same_bits (computed_scalar[i], vertices[i].normal));
+          }
+        }
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (normals_are_the_same_bits_as_with_a_lookup_per_point)
+  {
+    for (unsigned seed (0); seed < 3; ++seed)
+    {
+      terrain world (seed, true);
+      check_every_chunk (world);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (points_on_missing_tiles_keep_the_vertex_height)
+  {
+    terrain world (7, false);
+    check_every_chunk (world);
+  }
+
+  BOOST_AUTO_TEST_CASE (points_inside_the_chunk_resolve_to_the_same_vertex_as_a_lookup)
+  {
+    terrain world (11, true);
+    chunk const& vertices (world.tiles.at ({31, 31})[5 * 16 + 7]);
+    auto const& inside (chunk_normals::inside_vertices());
+
+    for (std::size_t i (0); i < chunk_normals::vertex_count; ++i)
+    {
+      for (std::size_t corner (0); corner < 4; ++corner)
+      {
+        if (inside[i][corner] < 0)
+        {
+          continue;
+        }
+
+        math::vector_3d looked_up;
+        BOOST_REQUIRE ( world.get_vertex ( vertices[i].position.x + chunk_normals::corner_x[corner]
+                                         , vertices[i].position.z + chunk_normals::corner_z[corner]
+                                         , &looked_up
+                                         )
+                      );
+        BOOST_REQUIRE (same_bits (looked_up, vertices[inside[i][corner]].position));
+      }
+    }
+  }
+}
@@ -0,0 +1,440 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/mcal_compression.hpp>
+#include <noggit/mcnk_vertices.hpp>
+#include <noggit/tile_cache.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct temporary_directory
+    {
+      temporary_directory()
+        : path ( boost::filesystem::temp_directory_path()
+               / boost::filesystem::unique_path ("noggit-tile-cache-%%%%-%%%%")
+               )
+      {}
+      ~temporary_directory()
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all (path, ec);
+      }
+
+      boost::filesystem::path const path;
+    };
+
+    std::vector<char> random_adt (std::mt19937& engine, std::size_t size)
+    {
+      std::uniform_int_distribution<int> byte (0, 255);
+      std::vector<char> adt (size);
+      for (char& c : adt)
+      {
+        c = static_cast<char> (byte (engine));
+      }
+      return adt;
+    }
+
+    tile_cache::tile_contents random_tile (std::mt19937& engine)
+    {
+      std::uniform_real_distribution<float> value (-1000.f, 1000.f);
+      std::uniform_int_distribution<int> byte (0, 255);
+      std::uniform_int_distribution<int> layers (0, 3);
+
+      tile_cache::tile_contents tile;
+      tile.textures = {"tileset/elwynn/elwynngrassbase.blp", "tileset/elwynn/elwynndirtbase.blp"};
+      tile.models = {"world/azeroth/elwynn/passivedoodads/trees/elwynntreecanopy01.m2"};
+      tile.objects = {};
+
+      tile.chunks.resize (256);
+      for (auto& chunk : tile.chunks)
+      {
+        for (auto& vertex : chunk.vertices)
+        {
+          vertex.position = {value (engine), value (engine), value (engine)};
+          vertex.normal = {value (engine), value (engine), value (engine)};
+          vertex.color = {value (engine), value (engine), value (engine)};
+        }
+        chunk.min_height = value (engine);
+        chunk.max_height = value (engine);
+
+        int const alphamaps (layers (engine));
+        for (int layer (0); layer < alphamaps; ++layer)
+        {
+          chunk.alphamaps[layer].resize (tile_cache::alphamap_size);
+          for (auto& alpha : chunk.alphamaps[layer])
+          {
+            alpha = static_cast<std::uint8_t> (byte (engine));
+          }
+        }
+      }
+
+      return tile;
+    }
+
+    void require_same (tile_cache::tile_contents const& expected, tile_cache::cached_tile const& actual)
+    {
+      BOOST_REQUIRE (expected.textures == actual.textures());
+      BOOST_REQUIRE (expected.models == actual.models());
+      BOOST_REQUIRE (expected.objects == actual.objects());
+      BOOST_REQUIRE_EQUAL (expected.chunks.size(), actual.chunk_count());
+
+      for (std::size_t i (0); i < expected.chunks.size(); ++i)
+      {
+        auto const& chunk (expected.chunks[i]);
+        auto const& cached (actual.chunk (i));
+
+        std::array<tile_cache::vertex, tile_cache::vertex_count> vertices;
+        cached.copy_vertices (vertices.data());
+        BOOST_REQUIRE_EQUAL
+          (std::memcmp (vertices.data(), chunk.vertices.data(), sizeof (vertices)), 0);
+        BOOST_REQUIRE_EQUAL (cached.min_height, chunk.min_height);
+        BOOST_REQUIRE_EQUAL (cached.max_height, chunk.max_height);
+
+        for (std::size_t layer (0); layer < 3; ++layer)
+        {
+          if (chunk.alphamaps[layer].empty())
+          {
+            BOOST_REQUIRE (!cached.alphamaps[layer]);
+          }
+          else
+          {
+            BOOST_REQUIRE (cached.alphamaps[layer]);
+            BOOST_REQUIRE_EQUAL
+              ( std::memcmp (cached.alphamaps[layer], chunk.alphamaps[layer].data(), tile_cache::alphamap_size)
+              , 0
+              );
+          }
+        }
+      }
+    }
+
+    // laid out like chunk_vertex
+    struct chunk_vertex
+    {
+      math::vector_3d position;
+      math::vector_3d normal;
+      math::vector_3d color;
+    };
+
+    // the parts of an MCNK that are cached
+    struct synthetic_chunk
+    {
+      math::vector_3d origin;
+      std::vector<char> mcvt;
+      std::vector<char> mcnr;
+      //! empty if the chunk has no MCCV
+      std::vector<char> mccv;
+      //! the MCAL of the layers but the first, empty for layers without
+      //! an alphamap
+      std::array<std::vector<std::uint8_t>, 3> mcal;
+      std::array<bool, 3> compressed;
+    };
+
+    synthetic_chunk random_chunk (std::mt19937& engine, std::size_t index)
+    {
+      std::uniform_real_distribution<float> height (-500.f, 500.f);
+      std::uniform_int_distribution<int> byte (0, 255);
+      std::uniform_int_distribution<int> run (1, 40);
+
+      synthetic_chunk chunk;
+      chunk.origin = {height (engine) * 30.f, height (engine), height (engine) * 30.f};
+
+      std::array<float, mcnk_vertices::vertex_count> heights;
+      for (float& h : heights)
+      {
+        h = height (engine);
+      }
+      chunk.mcvt.resize (mcnk_vertices::mcvt_size);
+      std::memcpy (chunk.mcvt.data(), heights.data(), mcnk_vertices::mcvt_size);
+
+      chunk.mcnr.resize (mcnk_vertices::mcnr_size);
+      for (char& c : chunk.mcnr)
+      {
+        c = static_cast<char> (byte (engine));
+      }
+
+      if (index % 3)
+      {
+        chunk.mccv.resize (mcnk_vertices::mccv_size);
+        for (char& c : chunk.mccv)
+        {
+          c = static_cast<char> (byte (engine));
+        }
+      }
+
+      for (std::size_t layer (0); layer < index % 4; ++layer)
+      {
+        // runs of the same alpha, like painted alphamaps have
+        std::array<std::uint8_t, mcal::alphamap_size> alphas;
+        for (std::size_t i (0); i < alphas.size();)
+        {
+          std::uint8_t const alpha (static_cast<std::uint8_t> (byte (engine)));
+          for (int n (run (engine)); n > 0 && i < alphas.size(); --n, ++i)
+          {
+            alphas[i] = alpha;
+          }
+        }
+
+        chunk.compressed[layer] = (index + layer) % 2;
+        if (chunk.compressed[layer])
+        {
+          chunk.mcal[layer].resize (mcal::max_compressed_size);
+          chunk.mcal[layer].resize (mcal::compress (alphas.data(), chunk.mcal[layer].data()));
+        }
+        else
+        {
+          chunk.mcal[layer].assign (alphas.begin(), alphas.end());
+        }
+      }
+
+      return chunk;
+    }
+
+    struct loaded_chunk
+    {
+      std::array<chunk_vertex, mcnk_vertices::vertex_count> vertices;
+      float min_height;
+      float max_height;
+      std::array<std::vector<std::uint8_t>, 3> alphamaps;
+    };
+
+    // MapChunk and TextureSet (with Alphamap) without a cache, for a
+    // tile using big alphamaps
+    loaded_chunk load_from_adt (synthetic_chunk const& chunk)
+    {
+      loaded_chunk loaded;
+
+      auto const heights
+        (mcnk_vertices::read_heights (chunk.mcvt.data(), chunk.origin, loaded.vertices.data()));
+      loaded.min_height = heights.min;
+      loaded.max_height = heights.max;
+
+      mcnk_vertices::read_normals (chunk.mcnr.data(), loaded.vertices.data());
+
+      if (!chunk.mccv.empty())
+      {
+        mcnk_vertices::read_colors (chunk.mccv.data(), loaded.vertices.data());
+      }
+      else
+      {
+        for (auto& vertex : loaded.vertices)
+        {
+          vertex.color = {1.f, 1.f, 1.f};
+        }
+      }
+
+      for (std::size_t layer (0); layer < 3; ++layer)
+      {
+        if (chunk.mcal[layer].empty())
+        {
+          continue;
+        }
+
+        if (chunk.compressed[layer])
+        {
+          loaded.alphamaps[layer].resize (mcal::alphamap_size);
+          BOOST_REQUIRE ( mcal::decompress ( chunk.mcal[layer].data(), chunk.mcal[layer].size()
+                                           , loaded.alphamaps[layer].data()
+                                           ).valid
+                        );
+        }
+        else
+        {
+          loaded.alphamaps[layer] = chunk.mcal[layer];
+        }
+      }
+
+      return loaded;
+    }
+
+    // MapTile::write_cache
+    tile_cache::chunk_contents cache_contents (loaded_chunk const& loaded)
+    {
+      tile_cache::chunk_contents contents;
+      std::memcpy (static_cast<void*> (contents.vertices.data()), loaded.vertices.data(), sizeof (contents.vertices));
+      contents.min_height = loaded.min_height;
+      contents.max_height = loaded.max_height;
+      contents.alphamaps = loaded.alphamaps;
+      return contents;
+    }
+
+    // MapChunk and TextureSet given the chunk's cache
+    loaded_chunk load_from_cache (tile_cache::cached_chunk const& cached)
+    {
+      loaded_chunk loaded;
+      cached.copy_vertices (loaded.vertices.data());
+      loaded.min_height = cached.min_height;
+      loaded.max_height = cached.max_height;
+
+      for (std::size_t layer (0); layer < 3; ++layer)
+      {
+        if (cached.alphamaps[layer])
+        {
+          loaded.alphamaps[layer].assign (cached.alphamaps[layer], cached.alphamaps[layer] + tile_cache::alphamap_size);
+        }
+      }
+
+      return loaded;
+    }
+
+    std::vector<char> contents_of (boost::filesystem::path const& path)
+    {
+      std::ifstream input (path.string(), std::ios_base::binary);
+      return {std::istreambuf_iterator<char> (input), std::istreambuf_iterator<char>()};
+    }
+
+    void overwrite (boost::filesystem::path const& path, std::vector<char> const& contents)
+    {
+      std::ofstream output (path.string(), std::ios_base::binary | std::ios_base::trunc);
+      output.write (contents.data(), contents.size());
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (tile_cache_reads_back_what_was_written)
+  {
+    temporary_directory directory;
+    boost::filesystem::path const file (directory.path / "world/maps/azeroth/azeroth_32_48.adt.cache");
+
+    std::mt19937 engine (42);
+    std::vector<char> const adt (random_adt (engine, 100003));
+    auto const source (tile_cache::identify (adt.data(), adt.size(), true));
+    auto const tile (random_tile (engine));
+
+    BOOST_REQUIRE (tile_cache::write (file, source, tile));
+
+    auto const cached (tile_cache::cached_tile::open (file, source));
+    BOOST_REQUIRE (cached);
+    require_same (tile, *cached);
+
+    // no temporary file left behind
+    std::size_t files (0);
+    for (auto it = boost::filesystem::directory_iterator (file.parent_path()); it != boost::filesystem::directory_iterator(); ++it)
+    {
+      ++files;
+    }
+    BOOST_REQUIRE_EQUAL (files, 1);
+  }
+
+  BOOST_AUTO_TEST_CASE (tile_cache_is_only_used_for_the_adt_it_was_written_for)
+  {
+    temporary_directory directory;
+    boost::filesystem::path const file (directory.path / "tile.cache");
+
+    std::mt19937 engine (7);
+    std::vector<char> adt (random_adt (engine, 4096));
+    auto const source (tile_cache::identify (adt.data(), adt.size(), false));
+    BOOST_REQUIRE (tile_cache::write (file, source, random_tile (engine)));
+    BOOST_REQUIRE (tile_cache::cached_tile::open (file, source));
+
+    // same bytes, other alphamap format
+    BOOST_REQUIRE (!tile_cache::cached_tile::open (file, tile_cache::identify (adt.data(), adt.size(), true)));
+    // one byte less
+    BOOST_REQUIRE (!tile_cache::cached_tile::open (file, tile_cache::identify (adt.data(), adt.size() - 1, false)));
+
+    // a single bit flipped anywhere
+    for (std::size_t i : {std::size_t (0), std::size_t (1234), adt.size() - 1})
+    {
+      adt[i] ^= 0x10;
+      BOOST_REQUIRE (!tile_cache::cached_tile::open (file, tile_cache::identify (adt.data(), adt.size(), false)));
+      adt[i] ^= 0x10;
+    }
+
+    BOOST_REQUIRE (tile_cache::cached_tile::open (file, tile_cache::identify (adt.data(), adt.size(), false)));
+  }
+
+  BOOST_AUTO_TEST_CASE (tile_cache_ignores_damaged_and_foreign_files)
+  {
+    temporary_directory directory;
+    boost::filesystem::path const file (directory.path / "tile.cache");
+
+    std::mt19937 engine (3);
+    std::vector<char> const adt (random_adt (engine, 1000));
+    auto const source (tile_cache::identify (adt.data(), adt.size(), true));
+
+    BOOST_REQUIRE (!tile_cache::cached_tile::open (file, source));
+
+    BOOST_REQUIRE (tile_cache::write (file, source, random_tile (engine)));
+    std::vector<char> const valid (contents_of (file));
+
+    // other magic
+    std::vector<char> damaged (valid);
+    damaged[7] = 'X';
+    overwrite (file, damaged);
+    BOOST_REQUIRE (!tile_cache::cached_tile::open (file, source));
+
+    // other format version
+    damaged = valid;
+    damaged[8] ^= 0xff;
+    overwrite (file, damaged);
+    BOOST_REQUIRE (!tile_cache::cached_tile::open (file, source));
+
+    // cut short anywhere, or with something behind it
+    for (std::size_t size : {std::size_t (4), std::size_t (20), valid.size() / 2, valid.size() - 1})
+    {
+      overwrite (file, {valid.begin(), valid.begin() + size});
+      BOOST_REQUIRE (!tile_cache::cached_tile::open (file, source));
+    }
+    damaged = valid;
+    damaged.push_back (0);
+    overwrite (file, damaged);
+    BOOST_REQUIRE (!tile_cache::cached_tile::open (file, source));
+
+    overwrite (file, valid);
+    BOOST_REQUIRE (tile_cache::cached_tile::open (file, source));
+  }
+
+  BOOST_AUTO_TEST_CASE (chunks_loaded_from_the_cache_are_the_ones_loaded_from_the_adt)
+  {
+    temporary_directory directory;
+    boost::filesystem::path const file (directory.path / "tile.cache");
+
+    std::mt19937 engine (11);
+    std::vector<char> const adt (random_adt (engine, 5000));
+    auto const source (tile_cache::identify (adt.data(), adt.size(), true));
+
+    std::vector<synthetic_chunk> chunks;
+    tile_cache::tile_contents tile;
+    for (std::size_t i (0); i < 256; ++i)
+    {
+      chunks.emplace_back (random_chunk (engine, i));
+      tile.chunks.emplace_back (cache_contents (load_from_adt (chunks.back())));
+    }
+
+    BOOST_REQUIRE (tile_cache::write (file, source, tile));
+    auto const cached (tile_cache::cached_tile::open (file, source));
+    BOOST_REQUIRE (cached);
+
+    for (std::size_t i (0); i < chunks.size(); ++i)
+    {
+      loaded_chunk const expected (load_from_adt (chunks[i]));
+      loaded_chunk const actual (load_from_cache (cached->chunk (i)));
+
+      BOOST_REQUIRE_EQUAL
+        (std::memcmp (actual.vertices.data(), expected.vertices.data(), sizeof (expected.vertices)), 0);
+      BOOST_REQUIRE_EQUAL (actual.min_height, expected.min_height);
+      BOOST_REQUIRE_EQUAL (actual.max_height, expected.max_height);
+      BOOST_REQUIRE (actual.alphamaps == expected.alphamaps);
+
+      // what MapChunk takes vmin and vmax from
+      float const lowest
+        ( std::min_element ( expected.vertices.begin(), expected.vertices.end()
+                           , [] (chunk_vertex const& a, chunk_vertex const& b) { return a.position.y < b.position.y; }
+                           )->position.y
+        );
+      BOOST_REQUIRE_EQUAL (actual.min_height, lowest);
+    }
+  }
+}
@@ -0,0 +1,264 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/MapHeaders.h>
+#include <noggit/tile_dirty_set.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    struct vertex
+    {
+      float values[10];
+    };
+
+    // records what would have been uploaded instead of uploading it
+    struct fake_gl
+    {
+      struct vertices_call
+      {
+        std::size_t offset;
+        std::size_t size;
+      };
+      struct alpha_shadow_map_call
+      {
+        texel_rect rect;
+        int layer;
+        std::vector<std::uint8_t> texels;
+      };
+
+      tile_upload_functions functions()
+      {
+        tile_upload_functions upload;
+        upload.vertices = [this] (std::size_t offset, std::size_t size, void const*)
+        {
+          vertices_calls.push_back ({offset, size});
+        };
+        upload.alpha_shadow_map = [this] (texel_rect const& rect, int layer, std::uint8_t const* texels)
+        {
+          // what the context reads with a row length of a whole layer
+          std::vector<std::uint8_t> read;
+          for (int y (0); y < rect.height(); ++y)
+          {
+            std::uint8_t const* row (texels + y * texel_rect::side * 4);
+            read.insert (read.end(), row, row + rect.width() * 4);
+          }
+          alpha_shadow_map_calls.push_back ({rect, layer, read});
+        };
+        return upload;
+      }
+
+      std::vector<vertices_call> vertices_calls;
+      std::vector<alpha_shadow_map_call> alpha_shadow_map_calls;
+    };
+
+    std::vector<std::pair<std::size_t, vertex_range>> drained (tile_dirty_set& dirty)
+    {
+      std::vector<std::pair<std::size_t, vertex_range>> chunks;
+      dirty.drain ([&] (std::size_t chunk, vertex_range const& vertices) { chunks.emplace_back (chunk, vertices); });
+      return chunks;
+    }
+
+    std::uint8_t texel_value (int x, int y, int component)
+    {
+      return static_cast<std::uint8_t> (x * 3 + y * 5 + component);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (tile_dirty_set_drains_only_the_marked_chunks)
+  {
+    tile_dirty_set dirty;
+    BOOST_REQUIRE (dirty.empty());
+
+    dirty.mark_vertices (200, {10, 20});
+    dirty.mark (3);
+    dirty.mark_vertices (200, {40, 50});
+    dirty.mark_vertices (64, vertex_range::whole());
+
+    BOOST_REQUIRE (!dirty.empty());
+
+    auto const chunks (drained (dirty));
+    BOOST_REQUIRE_EQUAL (chunks.size(), 3);
+    BOOST_REQUIRE_EQUAL (chunks[0].first, 3);
+    BOOST_REQUIRE (chunks[0].second.empty());
+    BOOST_REQUIRE_EQUAL (chunks[1].first, 64);
+    BOOST_REQUIRE_EQUAL (chunks[1].second.size(), vertex_range::chunk_vertices);
+    BOOST_REQUIRE_EQUAL (chunks[2].first, 200);
+    BOOST_REQUIRE_EQUAL (chunks[2].second.first, 10);
+    BOOST_REQUIRE_EQUAL (chunks[2].second.last, 50);
+
+    BOOST_REQUIRE (dirty.empty());
+    BOOST_REQUIRE (drained (dirty).empty());
+
+    dirty.mark_all();
+    auto const all (drained (dirty));
+    BOOST_REQUIRE_EQUAL (all.size(), tile_dirty_set::chunk_count);
+    for (std::size_t i (0); i < all.size(); ++i)
+    {
+      BOOST_REQUIRE_EQUAL (all[i].first, i);
+      BOOST_REQUIRE (all[i].second.empty());
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (tile_dirty_set_keeps_the_marks_of_concurrent_edits)
+  {
+    tile_dirty_set dirty;
+
+    // like parallel chunk edits: every thread its own chunks
+    std::vector<std::thread> editors;
+    for (std::size_t t (0); t < 4; ++t)
+    {
+      editors.emplace_back
+        ( [&dirty, t]
+          {
+            for (std::size_t chunk (t); chunk < tile_dirty_set::chunk_count; chunk += 8)
+            {
+              for (std::size_t vertex (0); vertex < 5; ++vertex)
+              {
+                dirty.mark_vertices (chunk, {chunk % 100 + vertex, chunk % 100 + vertex + 1});
+              }
+            }
+          }
+        );
+    }
+    for (auto& editor : editors)
+    {
+      editor.join();
+    }
+
+    auto const chunks (drained (dirty));
+    BOOST_REQUIRE_EQUAL (chunks.size(), tile_dirty_set::chunk_count / 2);
+    for (auto const& chunk : chunks)
+    {
+      BOOST_REQUIRE_LT (chunk.first % 8, 4);
+      BOOST_REQUIRE_EQUAL (chunk.second.first, chunk.first % 100);
+      BOOST_REQUIRE_EQUAL (chunk.second.size(), 5);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (upload_vertices_uploads_only_the_edited_range)
+  {
+    fake_gl gl;
+    tile_upload_functions const upload (gl.functions());
+    upload_counters counters;
+
+    std::vector<vertex> const tile (tile_dirty_set::chunk_count * vertex_range::chunk_vertices);
+    tile_dirty_set dirty;
+
+    // a brush touching the corner of four chunks
+    dirty.mark_vertices (17, {0, 12});
+    dirty.mark_vertices (18, {120, 145});
+    dirty.mark_vertices (33, {8, 9});
+    dirty.mark_vertices (34, {130, 140});
+    // a chunk whose shader data changed only
+    dirty.mark (100);
+
+    dirty.drain
+      ( [&] (std::size_t chunk, vertex_range const& vertices)
+        {
+          std::size_t const first_vertex (chunk * vertex_range::chunk_vertices);
+          upload_vertices (upload, counters, first_vertex, vertices, sizeof (vertex), &tile[first_vertex]);
+        }
+      );
+
+    BOOST_REQUIRE_EQUAL (gl.vertices_calls.size(), 4);
+    BOOST_REQUIRE_EQUAL (counters.calls, 4);
+    BOOST_REQUIRE_EQUAL (counters.bytes, (12 + 25 + 1 + 10) * sizeof (vertex));
+
+    BOOST_REQUIRE_EQUAL (gl.vertices_calls[1].offset, (18 * vertex_range::chunk_vertices + 120) * sizeof (vertex));
+    BOOST_REQUIRE_EQUAL (gl.vertices_calls[1].size, 25 * sizeof (vertex));
+
+    // nothing left for the next frame
+    dirty.drain
+      ( [&] (std::size_t chunk, vertex_range const& vertices)
+        {
+          upload_vertices (upload, counters, chunk * vertex_range::chunk_vertices, vertices, sizeof (vertex), tile.data());
+        }
+      );
+    BOOST_REQUIRE_EQUAL (counters.calls, 4);
+  }
+
+  BOOST_AUTO_TEST_CASE (upload_alpha_shadow_map_uploads_only_the_rect)
+  {
+    fake_gl gl;
+    tile_upload_functions const upload (gl.functions());
+    upload_counters counters;
+
+    std::vector<std::uint8_t> texels (texel_rect::side * texel_rect::side * 4);
+    for (int y (0); y < texel_rect::side; ++y)
+    {
+      for (int x (0); x < texel_rect::side; ++x)
+      {
+        for (int c (0); c < 4; ++c)
+        {
+          texels[(y * texel_rect::side + x) * 4 + c] = texel_value (x, y, c);
+        }
+      }
+    }
+
+    texel_rect const rect {5, 40, 17, 47};
+    upload_alpha_shadow_map (upload, counters, 21, rect, texels.data());
+
+    BOOST_REQUIRE_EQUAL (gl.alpha_shadow_map_calls.size(), 1);
+    auto const& call (gl.alpha_shadow_map_calls[0]);
+    BOOST_REQUIRE_EQUAL (call.layer, 21);
+    BOOST_REQUIRE_EQUAL (call.rect.x0, 5);
+    BOOST_REQUIRE_EQUAL (call.rect.y1, 47);
+    BOOST_REQUIRE_EQUAL (counters.bytes, 12 * 7 * 4);
+
+    for (int y (0); y < rect.height(); ++y)
+    {
+      for (int x (0); x < rect.width(); ++x)
+      {
+        for (int c (0); c < 4; ++c)
+        {
+          BOOST_REQUIRE_EQUAL
+            (call.texels[(y * rect.width() + x) * 4 + c], texel_value (rect.x0 + x, rect.y0 + y, c));
+        }
+      }
+    }
+
+    upload_alpha_shadow_map (upload, counters, 21, texel_rect(), texels.data());
+    BOOST_REQUIRE_EQUAL (counters.calls, 1);
+
+    upload_alpha_shadow_map (upload, counters, 3, texel_rect::whole(), texels.data());
+    BOOST_REQUIRE_EQUAL (counters.calls, 2);
+    BOOST_REQUIRE_EQUAL (counters.bytes, 12 * 7 * 4 + 64 * 64 * 4);
+  }
+
+  BOOST_AUTO_TEST_CASE (texels_in_range_covers_the_brush)
+  {
+    float const xbase (3 * CHUNKSIZE);
+    float const zbase (5 * CHUNKSIZE);
+
+    texel_rect const small
+      (texels_in_range (xbase, zbase, xbase + 20.5f * TEXDETAILSIZE, zbase + 30.5f * TEXDETAILSIZE, 2.f * TEXDETAILSIZE));
+    BOOST_REQUIRE_EQUAL (small.x0, 17);
+    BOOST_REQUIRE_EQUAL (small.x1, 24);
+    BOOST_REQUIRE_EQUAL (small.y0, 27);
+    BOOST_REQUIRE_EQUAL (small.y1, 34);
+
+    // from the next chunk, only its border
+    texel_rect const border
+      (texels_in_range (xbase, zbase, xbase + CHUNKSIZE + 1.f, zbase + 10.f, 2.f * TEXDETAILSIZE));
+    BOOST_REQUIRE_EQUAL (border.x1, texel_rect::side);
+    BOOST_REQUIRE_GE (border.x0, texel_rect::side - 4);
+
+    BOOST_REQUIRE (texels_in_range (xbase, zbase, xbase + 2.f * CHUNKSIZE, zbase, 10.f).empty());
+    BOOST_REQUIRE (texels_in_range (xbase, zbase, xbase, zbase, 2.f * CHUNKSIZE).is_whole());
+
+    texel_rect merged (small);
+    merged.merge (texel_rect());
+    merged.merge ({60, 0, 64, 2});
+    BOOST_REQUIRE_EQUAL (merged.x0, 17);
+    BOOST_REQUIRE_EQUAL (merged.y0, 0);
+    BOOST_REQUIRE_EQUAL (merged.x1, 64);
+    BOOST_REQUIRE_EQUAL (merged.y1, 34);
+  }
+}
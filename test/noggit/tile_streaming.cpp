@@ -0,0 +1,397 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/tile_streaming.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    float const frame = 1.f / 60.f;
+
+    std::size_t slot (tile_index const& tile)
+    {
+      return tile.z * 64 + tile.x;
+    }
+
+    math::vector_3d tile_center (std::size_t x, std::size_t z)
+    {
+      return {(x + 0.5f) * TILESIZE, 0.f, (z + 0.5f) * TILESIZE};
+    }
+
+    // loads one tile at a time, each taking load_updates ticks, like the
+    // single AsyncLoader thread
+    class stub_store : public tile_store
+    {
+    public:
+      stub_store (int load_updates_, std::size_t bytes_per_tile_)
+        : load_updates (load_updates_)
+        , bytes_per_tile (bytes_per_tile_)
+      {
+        exists.fill (true);
+        loaded.fill (false);
+        modified.fill (false);
+        broken.fill (false);
+      }
+
+      void tick()
+      {
+        if (!queue.empty() && --queue.front().second == 0)
+        {
+          loaded[slot (queue.front().first)] = true;
+          queue.pop_front();
+        }
+      }
+
+      bool queued (tile_index const& tile) const
+      {
+        return std::any_of ( queue.begin(), queue.end()
+                           , [&] (std::pair<tile_index, int> const& q) { return q.first == tile; }
+                           );
+      }
+
+      std::size_t loaded_bytes() const
+      {
+        return std::count (loaded.begin(), loaded.end(), true) * bytes_per_tile;
+      }
+
+      bool has_tile (tile_index const& tile) const override
+      {
+        return exists[slot (tile)];
+      }
+      bool tile_loaded (tile_index const& tile) const override
+      {
+        return loaded[slot (tile)];
+      }
+      bool load_tile (tile_index const& tile) override
+      {
+        ++loads_requested;
+        if (broken[slot (tile)])
+        {
+          return false;
+        }
+        if (!loaded[slot (tile)] && !queued (tile))
+        {
+          queue.emplace_back (tile, load_updates);
+        }
+        return true;
+      }
+      bool cancel_tile_load (tile_index const& tile) override
+      {
+        auto const it
+          ( std::find_if ( queue.begin(), queue.end()
+                         , [&] (std::pair<tile_index, int> const& q) { return q.first == tile; }
+                         )
+          );
+        if (it == queue.end())
+        {
+          return true;
+        }
+        if (it == queue.begin() && it->second < load_updates)
+        {
+          return false;
+        }
+        queue.erase (it);
+        cancelled.push_back (tile);
+        return true;
+      }
+      void unload_tile (tile_index const& tile) override
+      {
+        loaded[slot (tile)] = false;
+        unloaded.push_back (tile);
+      }
+      bool can_unload_tile (tile_index const& tile) const override
+      {
+        return !modified[slot (tile)];
+      }
+      std::size_t tile_memory_usage (tile_index const&) const override
+      {
+        return bytes_per_tile;
+      }
+
+      int load_updates;
+      std::size_t bytes_per_tile;
+      std::array<bool, 64 * 64> exists;
+      std::array<bool, 64 * 64> loaded;
+      std::array<bool, 64 * 64> modified;
+      std::array<bool, 64 * 64> broken;
+      std::deque<std::pair<tile_index, int>> queue;
+      std::vector<tile_index> cancelled;
+      std::vector<tile_index> unloaded;
+      std::size_t loads_requested = 0;
+    };
+
+    // straight flight, looking where it goes, returns where it ended
+    math::vector_3d fly ( tile_streaming& streaming
+                        , stub_store& store
+                        , math::vector_3d position
+                        , math::vector_3d const& velocity
+                        , float seconds
+                        , std::function<void (math::vector_3d const&)> const& each_frame = {}
+                        )
+    {
+      math::vector_3d const direction
+        (velocity.length() > 0.f ? velocity * (1.f / velocity.length()) : math::vector_3d (1.f, 0.f, 0.f));
+
+      for (int i (0); i < static_cast<int> (std::lround (seconds / frame)); ++i)
+      {
+        store.tick();
+        position += velocity * frame;
+        streaming.update (position, direction, 0.8f, frame);
+        if (each_frame)
+        {
+          each_frame (position);
+        }
+      }
+
+      return position;
+    }
+
+    // frames times tiles within the loading radius that weren't loaded
+    std::size_t holes_flying_with (float lookahead)
+    {
+      stub_store store (6, 1);
+      tile_streaming::settings settings;
+      settings.lookahead = lookahead;
+      tile_streaming streaming (store, settings);
+
+      math::vector_3d const start (tile_center (10, 32));
+      fly (streaming, store, start, {}, 1.f);
+
+      std::size_t holes (0);
+      fly ( streaming, store, start, {2.f * TILESIZE, 0.f, 0.f}, 10.f
+          , [&] (math::vector_3d const& position)
+            {
+              tile_index const camera (position);
+              for (std::size_t z (camera.z - 1); z <= camera.z + 1; ++z)
+              {
+                for (std::size_t x (camera.x - 1); x <= camera.x + 1; ++x)
+                {
+                  holes += !store.tile_loaded (tile_index (x, z));
+                }
+              }
+            }
+          );
+      return holes;
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (standing_still_loads_the_loading_radius)
+  {
+    stub_store store (3, 1);
+    tile_streaming streaming (store, {});
+
+    fly (streaming, store, tile_center (32, 32), {}, 1.f);
+
+    for (std::size_t z (0); z < 64; ++z)
+    {
+      for (std::size_t x (0); x < 64; ++x)
+      {
+        bool const around (std::max (x, std::size_t (32)) - std::min (x, std::size_t (32)) <= 1
+                          && std::max (z, std::size_t (32)) - std::min (z, std::size_t (32)) <= 1
+                          );
+        BOOST_REQUIRE_EQUAL (store.tile_loaded (tile_index (x, z)), around);
+      }
+    }
+    BOOST_REQUIRE_EQUAL (streaming.pending_loads(), 0);
+    BOOST_REQUIRE_EQUAL (streaming.resident_bytes(), 9);
+    BOOST_REQUIRE (store.unloaded.empty());
+  }
+
+  BOOST_AUTO_TEST_CASE (missing_tiles_and_map_edges_are_skipped)
+  {
+    stub_store store (1, 1);
+    store.exists[slot (tile_index (1, 0))] = false;
+    tile_streaming streaming (store, {});
+
+    fly (streaming, store, tile_center (0, 0), {}, 1.f);
+
+    BOOST_REQUIRE (store.tile_loaded (tile_index (0, 0)));
+    BOOST_REQUIRE (store.tile_loaded (tile_index (0, 1)));
+    BOOST_REQUIRE (store.tile_loaded (tile_index (1, 1)));
+    BOOST_REQUIRE (!store.tile_loaded (tile_index (1, 0)));
+    BOOST_REQUIRE_EQUAL (streaming.resident_bytes(), 3);
+  }
+
+  BOOST_AUTO_TEST_CASE (tiles_failing_to_load_are_asked_for_once)
+  {
+    stub_store store (1, 1);
+    store.broken[slot (tile_index (33, 32))] = true;
+    tile_streaming streaming (store, {});
+
+    fly (streaming, store, tile_center (32, 32), {}, 1.f);
+
+    BOOST_REQUIRE_EQUAL (store.loads_requested, 9);
+    BOOST_REQUIRE_EQUAL (streaming.pending_loads(), 0);
+    BOOST_REQUIRE_EQUAL (streaming.resident_bytes(), 8);
+  }
+
+  BOOST_AUTO_TEST_CASE (velocity_follows_the_camera_and_resets_on_teleport)
+  {
+    stub_store store (1, 1);
+    tile_streaming streaming (store, {});
+
+    math::vector_3d const position
+      (fly (streaming, store, tile_center (20, 20), {300.f, 50.f, -100.f}, 2.f));
+
+    BOOST_REQUIRE_CLOSE (streaming.velocity().x, 300.f, 1.f);
+    BOOST_REQUIRE_CLOSE (streaming.velocity().z, -100.f, 1.f);
+    BOOST_REQUIRE_EQUAL (streaming.velocity().y, 0.f);
+
+    streaming.update (position + math::vector_3d (10.f * TILESIZE, 0.f, 0.f), {1.f, 0.f, 0.f}, 0.8f, frame);
+    BOOST_REQUIRE_EQUAL (streaming.velocity().length(), 0.f);
+  }
+
+  BOOST_AUTO_TEST_CASE (flying_loads_ahead_of_the_camera)
+  {
+    std::size_t const without (holes_flying_with (0.f));
+    std::size_t const with (holes_flying_with (3.f));
+
+    BOOST_TEST_MESSAGE ("holes without lookahead " << without << ", with " << with);
+    BOOST_REQUIRE_LT (with, without / 2);
+  }
+
+  BOOST_AUTO_TEST_CASE (lookahead_prefers_the_tiles_in_view)
+  {
+    stub_store store (1000, 1);
+    tile_streaming::settings settings;
+    settings.max_pending_loads = 64;
+    tile_streaming streaming (store, settings);
+
+    // heading diagonally, looking along x: the tiles mirrored on the
+    // diagonal are as far ahead, only one of them is in view
+    math::vector_3d position (tile_center (32, 32));
+    for (int i (0); i < 30; ++i)
+    {
+      position += math::vector_3d (600.f, 0.f, 600.f) * frame;
+      streaming.update (position, {1.f, 0.f, 0.f}, 0.4f, frame);
+    }
+
+    tile_index const camera (position);
+    std::size_t preferred (0);
+    for (std::size_t ahead (2); ahead <= 8; ++ahead)
+    {
+      bool const in_view (streaming.load_pending (tile_index (camera.x + ahead, camera.z)));
+      bool const out_of_view (streaming.load_pending (tile_index (camera.x, camera.z + ahead)));
+      BOOST_REQUIRE (in_view || !out_of_view);
+      preferred += in_view && !out_of_view;
+
+      BOOST_REQUIRE (!streaming.load_pending (tile_index (camera.x - ahead, camera.z)));
+    }
+    BOOST_REQUIRE_GT (preferred, 0);
+  }
+
+  BOOST_AUTO_TEST_CASE (turning_around_cancels_queued_loads)
+  {
+    stub_store store (30, 1);
+    tile_streaming::settings settings;
+    settings.max_pending_loads = 8;
+    tile_streaming streaming (store, settings);
+
+    math::vector_3d position
+      (fly (streaming, store, tile_center (32, 32), {2.f * TILESIZE, 0.f, 0.f}, 1.f));
+    BOOST_REQUIRE (store.queue.size() > 4);
+
+    position = fly (streaming, store, position, {-2.f * TILESIZE, 0.f, 0.f}, 1.f);
+
+    std::size_t const camera_x (tile_index (position).x);
+    BOOST_REQUIRE ( std::any_of ( store.cancelled.begin(), store.cancelled.end()
+                                , [&] (tile_index const& tile) { return tile.x > camera_x + 1; }
+                                )
+                  );
+    // only the one being loaded is left from the way there
+    std::size_t ahead_of_old_heading (0);
+    for (auto const& queued : store.queue)
+    {
+      ahead_of_old_heading += queued.first.x > camera_x + 1;
+    }
+    BOOST_REQUIRE_LE (ahead_of_old_heading, 1);
+  }
+
+  BOOST_AUTO_TEST_CASE (memory_budget_is_respected)
+  {
+    stub_store store (2, 1000);
+    tile_streaming::settings settings;
+    settings.memory_budget = 30 * 1000;
+    tile_streaming streaming (store, settings);
+
+    std::size_t most (0);
+    math::vector_3d const position
+      ( fly ( streaming, store, tile_center (5, 5), {1.f * TILESIZE, 0.f, 1.f * TILESIZE}, 40.f
+            , [&] (math::vector_3d const&)
+              {
+                BOOST_REQUIRE_EQUAL (streaming.resident_bytes(), store.loaded_bytes());
+                most = std::max (most, store.loaded_bytes());
+              }
+            )
+      );
+
+    BOOST_REQUIRE_LE (most, settings.memory_budget);
+    BOOST_REQUIRE (!store.unloaded.empty());
+
+    tile_index const camera (position);
+    for (std::size_t z (camera.z - 1); z <= camera.z + 1; ++z)
+    {
+      for (std::size_t x (camera.x - 1); x <= camera.x + 1; ++x)
+      {
+        BOOST_REQUIRE (store.tile_loaded (tile_index (x, z)));
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (least_recently_wanted_tiles_are_unloaded_first)
+  {
+    stub_store store (1, 1);
+    tile_streaming::settings settings;
+    settings.memory_budget = 18;
+    tile_streaming streaming (store, settings);
+
+    fly (streaming, store, tile_center (10, 10), {}, 1.f);
+    streaming.reset_motion();
+    fly (streaming, store, tile_center (30, 30), {}, 1.f);
+    streaming.reset_motion();
+    fly (streaming, store, tile_center (50, 50), {}, 1.f);
+
+    for (std::size_t z (0); z < 64; ++z)
+    {
+      for (std::size_t x (0); x < 64; ++x)
+      {
+        bool const first (x >= 9 && x <= 11 && z >= 9 && z <= 11);
+        bool const second (x >= 29 && x <= 31 && z >= 29 && z <= 31);
+        bool const third (x >= 49 && x <= 51 && z >= 49 && z <= 51);
+        BOOST_REQUIRE_EQUAL (store.tile_loaded (tile_index (x, z)), second || third);
+        BOOST_REQUIRE_EQUAL ( std::count (store.unloaded.begin(), store.unloaded.end(), tile_index (x, z))
+                            , first ? 1 : 0
+                            );
+      }
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (modified_tiles_are_never_unloaded)
+  {
+    stub_store store (1, 1);
+    tile_streaming::settings settings;
+    settings.lookahead = 0.f;
+    settings.memory_budget = 9;
+    tile_streaming streaming (store, settings);
+
+    fly (streaming, store, tile_center (10, 10), {}, 1.f);
+    store.modified[slot (tile_index (10, 10))] = true;
+    store.modified[slot (tile_index (11, 11))] = true;
+
+    fly (streaming, store, tile_center (10, 10), {0.5f * TILESIZE, 0.f, 0.f}, 30.f);
+
+    BOOST_REQUIRE (store.tile_loaded (tile_index (10, 10)));
+    BOOST_REQUIRE (store.tile_loaded (tile_index (11, 11)));
+    BOOST_REQUIRE (!store.tile_loaded (tile_index (9, 9)));
+    BOOST_REQUIRE_EQUAL (store.loaded_bytes(), 11);
+  }
+}
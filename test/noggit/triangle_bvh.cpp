@@ -0,0 +1,198 @@
+#include <boost/test/unit_test.hpp>
+
+#include <noggit/triangle_bvh.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace noggit
+{
+  namespace
+  {
+    using hits = std::vector<std::pair<float, std::uint32_t>>;
+
+    struct mesh
+    {
+      std::vector<math::vector_3d> vertices;
+      std::vector<std::uint16_t> indices;
+
+      math::vector_3d const& position (std::uint32_t vertex) const
+      {
+        return vertices[vertex];
+      }
+
+      hits brute_force (math::ray const& ray) const
+      {
+        hits result;
+        for (std::size_t i (0); i + 2 < indices.size(); i += 3)
+        {
+          if ( auto distance = ray.intersect_triangle
+                 (vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]])
+             )
+          {
+            result.emplace_back (*distance, i / 3);
+          }
+        }
+        std::sort (result.begin(), result.end());
+        return result;
+      }
+
+      hits with (triangle_bvh const& bvh, math::ray const& ray) const
+      {
+        hits result;
+        bvh.intersect ( ray
+                      , [&] (std::uint32_t vertex) -> math::vector_3d const& { return position (vertex); }
+                      , [&] (float distance, std::uint32_t triangle) { result.emplace_back (distance, triangle); }
+                      );
+        std::sort (result.begin(), result.end());
+        return result;
+      }
+    };
+
+    struct random_meshes
+    {
+      random_meshes (unsigned seed)
+        : engine (seed)
+      {}
+
+      std::mt19937 engine;
+
+      float real (float min, float max)
+      {
+        return std::uniform_real_distribution<float> (min, max) (engine);
+      }
+
+      math::vector_3d point (float extent)
+      {
+        return {real (-extent, extent), real (-extent, extent), real (-extent, extent)};
+      }
+
+      // small triangles scattered around, like a doodad's
+      mesh soup (std::size_t triangles)
+      {
+        mesh result;
+        for (std::size_t i (0); i < triangles; ++i)
+        {
+          math::vector_3d const center (point (20.f));
+          for (int corner (0); corner < 3; ++corner)
+          {
+            result.indices.push_back (result.vertices.size());
+            result.vertices.push_back (center + point (1.5f));
+          }
+        }
+        return result;
+      }
+
+      // a flat, shared vertex floor like the ones of wmo groups
+      mesh floor (int size)
+      {
+        mesh result;
+        float const height (real (-5.f, 5.f));
+        for (int z (0); z <= size; ++z)
+        {
+          for (int x (0); x <= size; ++x)
+          {
+            result.vertices.emplace_back (x * 2.f, height, z * 2.f);
+          }
+        }
+        for (int z (0); z < size; ++z)
+        {
+          for (int x (0); x < size; ++x)
+          {
+            std::uint16_t const corner (z * (size + 1) + x);
+            for (int offset : {0, size + 1, size + 2, 0, size + 2, 1})
+            {
+              result.indices.push_back (corner + offset);
+            }
+          }
+        }
+        return result;
+      }
+
+      // most of them pass close to some vertex
+      math::ray ray (mesh const& model, float extent)
+      {
+        std::uniform_int_distribution<std::size_t> vertex (0, model.vertices.size() - 1);
+        math::vector_3d const origin (point (extent));
+        math::vector_3d const target (model.vertices[vertex (engine)] + point (0.5f));
+
+        return {origin, real (0.f, 1.f) < 0.9f ? target - origin : point (1.f)};
+      }
+    };
+  }
+
+  BOOST_AUTO_TEST_CASE (triangle_bvh_finds_the_same_hits_as_brute_force)
+  {
+    for (unsigned seed (0); seed < 20; ++seed)
+    {
+      random_meshes generator (seed);
+      mesh const model (seed % 2 ? generator.soup (1 + seed * 97) : generator.floor (1 + seed * 3));
+      triangle_bvh const bvh (model.indices, [&] (std::uint32_t vertex) { return model.position (vertex); });
+
+      BOOST_REQUIRE_EQUAL (bvh.triangle_count(), model.indices.size() / 3);
+
+      std::size_t hit_count (0);
+      for (int i (0); i < 200; ++i)
+      {
+        math::ray const ray (generator.ray (model, 30.f));
+        auto const expected (model.brute_force (ray));
+
+        BOOST_REQUIRE (model.with (bvh, ray) == expected);
+        hit_count += expected.size();
+      }
+
+      BOOST_REQUIRE_GT (hit_count, 0);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (triangle_bvh_hits_a_floor_from_straight_above)
+  {
+    random_meshes generator (7);
+    mesh const model (generator.floor (16));
+    triangle_bvh const bvh (model.indices, [&] (std::uint32_t vertex) { return model.position (vertex); });
+
+    // straight down onto the floor, whose nodes have no height at all
+    for (int i (0); i < 200; ++i)
+    {
+      math::ray const ray ({generator.real (0.f, 32.f), 50.f, generator.real (0.f, 32.f)}, {0.f, -1.f, 0.f});
+      auto const expected (model.brute_force (ray));
+
+      BOOST_REQUIRE (!expected.empty());
+      BOOST_REQUIRE (model.with (bvh, ray) == expected);
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (triangle_bvh_follows_moved_vertices_when_refit)
+  {
+    random_meshes generator (3);
+    mesh model (generator.soup (500));
+    triangle_bvh bvh (model.indices, [&] (std::uint32_t vertex) { return model.position (vertex); });
+
+    for (auto& vertex : model.vertices)
+    {
+      vertex = vertex * 1.5f + math::vector_3d (3.f, -2.f, 1.f);
+    }
+    bvh.refit ([&] (std::uint32_t vertex) { return model.position (vertex); });
+
+    for (int i (0); i < 200; ++i)
+    {
+      math::ray const ray (generator.ray (model, 40.f));
+      BOOST_REQUIRE (model.with (bvh, ray) == model.brute_force (ray));
+    }
+  }
+
+  BOOST_AUTO_TEST_CASE (triangle_bvh_of_nothing_hits_nothing)
+  {
+    std::vector<std::uint16_t> const indices;
+    triangle_bvh const bvh (indices, [] (std::uint32_t) { return math::vector_3d(); });
+
+    BOOST_REQUIRE (bvh.empty());
+    bvh.intersect ( math::ray ({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f})
+                  , [] (std::uint32_t) { return math::vector_3d(); }
+                  , [] (float, std::uint32_t) { BOOST_FAIL ("hit nothing"); }
+                  );
+  }
+}